@@ -25,6 +25,7 @@ struct GlobalInfo
     matrix invViewProjMatrix;
     matrix invViewMatrix;
     matrix invProjMatrix;
+    matrix prevViewProjMatrix; // View projection of the frame that the cascade history was gathered in.
     float3 cameraPos;
     float padding;
     bool useSkybox;
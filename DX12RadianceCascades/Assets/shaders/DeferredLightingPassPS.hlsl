@@ -120,7 +120,9 @@ float4 main(Interpolators i) : SV_TARGET
                         
                         if (rcGlobals.usePreAveraging)
                         {
-                            radianceSample = cascade0RadianceBuffer[probeIndex + (rayIndex / 2) * probeCounts];
+                            // Each texel of a pre-averaged cascade 0 holds rayScalingDim x rayScalingDim rays.
+                            int rayScalingDim = sqrt(rcGlobals.rayScalingFactor);
+                            radianceSample = cascade0RadianceBuffer[probeIndex + (rayIndex / rayScalingDim) * probeCounts];
                         }
                         else
                         {
@@ -12,6 +12,8 @@
 struct DestInfo
 {
     uint2 destResolution;
+    float2 sourceUVOffset; // Allows copying a sub rect of the source, like a single cascade of the cascade atlas.
+    float2 sourceUVScale;
 };
 
 ConstantBuffer<DestInfo> destInfo : register(b0);
@@ -30,7 +32,9 @@ void main(uint3 DTid : SV_DispatchThreadID)
     {
         float2 relative = pixelPos / float2(destInfo.destResolution);
 
-        float4 sampledColor = sourceTex.SampleLevel(linearSampler, relative, 0.0f);
+        float2 sourceUV = destInfo.sourceUVOffset + relative * destInfo.sourceUVScale;
+
+        float4 sampledColor = sourceTex.SampleLevel(linearSampler, sourceUV, 0.0f);
         destTex[pixelPos] = float4(sampledColor.rgb, 1.0f);
     }
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "Common.hlsli"
 
-// The purpose of this shader is to calculate how many texels are to be sampled by the merge step (value of 1). With this information,
-// it is possible to calculate how many texels were NOT sampled (value of 0) by subtracting the sum from the total texel count.
+// The purpose of this shader is to calculate how many texels are to be sampled by the merge step (bit set). With this information,
+// it is possible to calculate how many texels were NOT sampled (bit not set) by subtracting the sum from the total texel count.
+// Gather filters are bit packed (see GetGatherFilterBit() in RCCommon3D.hlsli) so the reduction is a popcount over the words of the buffer.
+// Bits past the last texel are never set by the gather step, which means that whole words can be counted without masking.
 // Because each texel corresponds to one CPU ray dispatch (4 GPU ray dispatches if pre-averaging is enabled), the result 
 // gives the number of rays that were not processed during the gather step.
 
@@ -22,12 +24,11 @@ struct FilterInfo
     uint filterIndex;
 };
 
-#define GROUP_SIZE_1D 16 // 16x16 = 256 threads per group
-#define GROUP_SIZE (GROUP_SIZE_1D * GROUP_SIZE_1D)
-#define TILE_SIZE_1D 4 // Each thread samples a 4x4 = 16 texel tile
+#define GROUP_SIZE 256
+#define WORDS_PER_THREAD 4 // Each thread counts 4 x 32 = 128 texels.
 #define WAVES_PER_GROUP (GROUP_SIZE / WaveGetLaneCount())
 
-Texture2D<float> gatherFilter : register(t0);
+ByteAddressBuffer gatherFilter : register(t0);
 
 ConstantBuffer<FilterInfo> filterInfoBuffer : register(b0);
 
@@ -35,31 +36,28 @@ RWByteAddressBuffer resultBuffer : register(u0);
 
 // Reserves the max amount of registers to comply with worst case scenario.
 // Although, 1kb of shared memory is well below the maximum allowed for most GPUs that support DX11+.
-groupshared float gsGroupSharedMem[GROUP_SIZE];
+groupshared uint gsGroupSharedMem[GROUP_SIZE];
 
-[numthreads(GROUP_SIZE_1D, GROUP_SIZE_1D, 1)]
+[numthreads(GROUP_SIZE, 1, 1)]
 void main( uint3 DTid : SV_DispatchThreadID, uint GroupIndex : SV_GroupIndex)
 {
-    uint2 baseSamplePos = DTid.xy * TILE_SIZE_1D;
+    uint wordCount = (filterInfoBuffer.width * filterInfoBuffer.height + 31) / 32;
+    uint baseWord = DTid.x * WORDS_PER_THREAD;
     
-    float threadSum = 0.0f;
+    uint threadSum = 0;
     
     [unroll]
-    for (int i = 0; i < TILE_SIZE_1D; i++)
+    for (int i = 0; i < WORDS_PER_THREAD; i++)
     {
-        [unroll]
-        for (int k = 0; k < TILE_SIZE_1D; k++)
+        uint wordIndex = baseWord + i;
+        if (wordIndex < wordCount)
         {
-            uint2 samplePos = baseSamplePos + int2(i, k);
-            if (!OUT_OF_BOUNDS(samplePos, uint2(filterInfoBuffer.width, filterInfoBuffer.height)))
-            {
-                threadSum += gatherFilter.Load(int3(samplePos, 0));
-            }
+            threadSum += countbits(gatherFilter.Load(wordIndex * 4));
         }
     }
 
     // Sum of the current wave.
-    float waveSum = WaveActiveSum(threadSum);
+    uint waveSum = WaveActiveSum(threadSum);
     
     // Gets what wave a thread inside a group would land in.
     int waveIdx = GroupIndex / WaveGetLaneCount();
@@ -76,16 +74,16 @@ void main( uint3 DTid : SV_DispatchThreadID, uint GroupIndex : SV_GroupIndex)
     // Will filter out all threads in the same wave that can index within the shared memory.
     if (GroupIndex < WAVES_PER_GROUP)
     {
-        float groupVal = gsGroupSharedMem[GroupIndex];
+        uint groupVal = gsGroupSharedMem[GroupIndex];
         
         // Sums the previously calculated result from each wave into a single group sum.
-        float groupSum = WaveActiveSum(groupVal);
+        uint groupSum = WaveActiveSum(groupVal);
         
         // Let the first thread in each group write to global memory. 
         if (GroupIndex == 0)
         {
             // Writes 4 bytes.
-            resultBuffer.InterlockedAdd(filterInfoBuffer.filterIndex * 4, (uint)groupSum);
+            resultBuffer.InterlockedAdd(filterInfoBuffer.filterIndex * 4, groupSum);
         }
     }
 }
\ No newline at end of file
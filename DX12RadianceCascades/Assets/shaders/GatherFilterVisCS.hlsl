@@ -0,0 +1,32 @@
+#include "RCCommon3D.hlsli"
+
+// Unpacks a bit packed gather filter into a color buffer for visualization.
+// Stretches the filter over the whole destination, equivalent to a point sampled DirectCopyCS.
+
+struct GatherFilterVisInfo
+{
+    uint2 destResolution;
+    uint2 filterResolution;
+};
+
+ConstantBuffer<GatherFilterVisInfo> visInfo : register(b0);
+
+ByteAddressBuffer gatherFilter : register(t0);
+RWTexture2D<float4> destTex : register(u0);
+
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    uint2 pixelPos = DTid.xy;
+    
+    if (!OUT_OF_BOUNDS(pixelPos, visInfo.destResolution))
+    {
+        float2 relative = pixelPos / float2(visInfo.destResolution);
+        uint2 filterPos = min(uint2(relative * visInfo.filterResolution), visInfo.filterResolution - 1);
+        
+        GatherFilterBit filterBit = GetGatherFilterBit(filterPos, visInfo.filterResolution.x);
+        float filterVal = (gatherFilter.Load(filterBit.byteOffset) & filterBit.mask) != 0 ? 1.0f : 0.0f;
+        
+        destTex[pixelPos] = float4(filterVal, 0.0f, 0.0f, 1.0f);
+    }
+}
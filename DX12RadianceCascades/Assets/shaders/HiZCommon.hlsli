@@ -0,0 +1,32 @@
+#ifndef HIZCOMMON_H
+#define HIZCOMMON_H
+
+#include "Common.hlsli"
+
+// Shared by the per mip and single pass Hi-Z builds, see CPUReference/HiZPyramid.h for the CPU side.
+// Mip dims are max(1, dims >> mip) like D3D12. The last texel of a mip also takes the extra row or column of an odd sized mip above it,
+// so every depth texel is covered by exactly one texel of each mip and the last mip holds the min and max depth of the whole buffer.
+
+#define HIZ_EMPTY_MIN_MAX float2(FLT_MAX, 0.0f)
+
+uint2 GetHiZMipDims(uint2 dims, uint mip)
+{
+    return max(dims >> mip, 1);
+}
+
+// Children of a texel are [texel * 2, GetHiZLastChild()] in the mip above it.
+uint2 GetHiZLastChild(uint2 texel, uint2 mipDims, uint2 sourceMipDims)
+{
+    return uint2(
+        texel.x == mipDims.x - 1 ? sourceMipDims.x - 1 : texel.x * 2 + 1,
+        texel.y == mipDims.y - 1 ? sourceMipDims.y - 1 : texel.y * 2 + 1
+    );
+}
+
+// Red channel is min, green channel is max.
+float2 CombineMinMax(float2 a, float2 b)
+{
+    return float2(min(a.r, b.r), max(a.g, b.g));
+}
+
+#endif // HIZCOMMON_H
@@ -1,4 +1,4 @@
-#include "Common.hlsli"
+#include "HiZCommon.hlsli"
 
 struct SourceInfo
 {
@@ -29,37 +29,25 @@ void main(uint3 DTid : SV_DispatchThreadID)
     }
     else
     {
-        uint2 sourcePixelIndex = targetPixelIndex * 2; // Each thread looks at a 2x2 area.
+        // Each thread looks at a 2x2 area, or up to 3x3 on the last row and column of an odd sized source.
+        uint2 targetDims = GetHiZMipDims(sourceInfo.dims, 1);
         
-        if (!OUT_OF_BOUNDS(sourcePixelIndex, sourceInfo.dims))
+        if (!OUT_OF_BOUNDS(targetPixelIndex, targetDims))
         {
-            float min = FLT_MAX;
-            float max = 0.0f;
+            uint2 firstSourcePixel = targetPixelIndex * 2;
+            uint2 lastSourcePixel = GetHiZLastChild(targetPixelIndex, targetDims, sourceInfo.dims);
             
-            for (int i = 0; i < 2; i++)
+            float2 minMax = HIZ_EMPTY_MIN_MAX;
+            
+            for (uint y = firstSourcePixel.y; y <= lastSourcePixel.y; y++)
             {
-                for (int k = 0; k < 2; k++)
+                for (uint x = firstSourcePixel.x; x <= lastSourcePixel.x; x++)
                 {
-                    int2 pixelOffset = int2(i, k);
-                
-                    int2 sourceSamplingPixel = int2(sourcePixelIndex) + pixelOffset;
-                    float2 sourceMinMax = sourceDepth.Load(int3(sourceSamplingPixel, 0)).rg;
-
-                     // Red channel is min.
-                    if (sourceMinMax.r < min)
-                    {
-                        min = sourceMinMax.r;
-                    }
-                
-                    // Green channel is max.
-                    if (sourceMinMax.g > max)
-                    {
-                        max = sourceMinMax.g;
-                    }
+                    minMax = CombineMinMax(minMax, sourceDepth.Load(int3(x, y, 0)).rg);
                 }
             }
         
-            targetDepth[targetPixelIndex] = float2(min, max);
+            targetDepth[targetPixelIndex] = minMax;
         }
     }
     
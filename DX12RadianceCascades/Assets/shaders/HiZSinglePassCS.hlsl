@@ -0,0 +1,215 @@
+#include "HiZCommon.hlsli"
+
+// Builds every mip of the Hi-Z buffer in one dispatch, with the same results as one HiZMipGenerationCS.hlsl dispatch per mip.
+// Each group reduces a 64x64 tile of depth down to mip 6 (one texel) through groupshared memory, and the last group to finish
+// reduces mip 6 down to 1x1. The last tile of a row or column also takes the texels past the last full tile, so that the odd size rule
+// of HiZCommon.hlsli never needs texels of another tile. Should be dispatched with max(1, dims / 64) groups per axis.
+
+#define GROUP_DIM 16
+#define GROUP_SIZE (GROUP_DIM * GROUP_DIM)
+#define TILE_SIZE 64
+#define TILE_MIP_COUNT 6
+#define HIZ_MAX_MIP_COUNT 12 // MiniEngine color buffers have UAVs for up to 12 mips.
+
+// Mip 2 of a tile is at most 31x31 texels (last tiles) and mip 3 at most 15x15. Even mips are stored first, odd mips after them.
+#define GS_EVEN_MIP_DIM 32
+#define GS_ODD_MIP_DIM 16
+
+struct HiZInfo
+{
+    uint2 dims;
+    uint mipCount;
+    uint groupCount;
+};
+
+ConstantBuffer<HiZInfo> hiZInfo : register(b0);
+
+Texture2D<float> depthBuffer : register(t0);
+
+// Mips past hiZInfo.mipCount are bound to the last mip and never written. The last group reads mips other groups wrote,
+// so they have to be globally coherent.
+globallycoherent RWTexture2D<float2> hiZMips[HIZ_MAX_MIP_COUNT] : register(u0);
+
+// Has to be cleared to 0 before the dispatch.
+globallycoherent RWByteAddressBuffer groupCounter : register(u12);
+
+groupshared float2 gsMinMax[GS_EVEN_MIP_DIM * GS_EVEN_MIP_DIM + GS_ODD_MIP_DIM * GS_ODD_MIP_DIM];
+groupshared uint gsFinishedGroupCount;
+
+uint GetGroupSharedIndex(uint2 tileTexel, uint mip)
+{
+    return (mip & 1) == 0 ?
+        tileTexel.y * GS_EVEN_MIP_DIM + tileTexel.x :
+        GS_EVEN_MIP_DIM * GS_EVEN_MIP_DIM + tileTexel.y * GS_ODD_MIP_DIM + tileTexel.x;
+}
+
+// Texels of the tile in a mip, from tileStart up to but not including tileEnd.
+void GetTileRect(uint2 tile, uint2 tileCount, uint mip, out uint2 tileStart, out uint2 tileEnd)
+{
+    uint2 tileOrigin = tile * TILE_SIZE;
+    uint2 mipDims = GetHiZMipDims(hiZInfo.dims, mip);
+
+    tileStart = tileOrigin >> mip;
+    tileEnd = uint2(
+        tile.x == tileCount.x - 1 ? mipDims.x : (tileOrigin.x + TILE_SIZE) >> mip,
+        tile.y == tileCount.y - 1 ? mipDims.y : (tileOrigin.y + TILE_SIZE) >> mip
+    );
+}
+
+void StoreMip(uint mip, uint2 texel, float2 minMax)
+{
+    if (mip < hiZInfo.mipCount)
+    {
+        hiZMips[mip][texel] = minMax;
+    }
+}
+
+// Writes the depth texels of a mip 1 texel to mip 0 on the way, so that mip 0 is never read back.
+float2 ReduceDepth(uint2 texel)
+{
+    uint2 firstChild = texel * 2;
+    uint2 lastChild = GetHiZLastChild(texel, GetHiZMipDims(hiZInfo.dims, 1), hiZInfo.dims);
+
+    float2 minMax = HIZ_EMPTY_MIN_MAX;
+    for (uint y = firstChild.y; y <= lastChild.y; y++)
+    {
+        for (uint x = firstChild.x; x <= lastChild.x; x++)
+        {
+            // Start with min and max equal.
+            float depth = depthBuffer.Load(int3(x, y, 0));
+            hiZMips[0][uint2(x, y)] = float2(depth, depth);
+
+            minMax = CombineMinMax(minMax, float2(depth, depth));
+        }
+    }
+
+    return minMax;
+}
+
+float2 ReduceMip2Texel(uint2 texel)
+{
+    uint2 firstChild = texel * 2;
+    uint2 lastChild = GetHiZLastChild(texel, GetHiZMipDims(hiZInfo.dims, 2), GetHiZMipDims(hiZInfo.dims, 1));
+
+    float2 minMax = HIZ_EMPTY_MIN_MAX;
+    for (uint y = firstChild.y; y <= lastChild.y; y++)
+    {
+        for (uint x = firstChild.x; x <= lastChild.x; x++)
+        {
+            float2 mip1MinMax = ReduceDepth(uint2(x, y));
+            StoreMip(1, uint2(x, y), mip1MinMax);
+
+            minMax = CombineMinMax(minMax, mip1MinMax);
+        }
+    }
+
+    return minMax;
+}
+
+[numthreads(GROUP_DIM, GROUP_DIM, 1)]
+void main(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint GroupIndex : SV_GroupIndex)
+{
+    uint2 tileCount = max(hiZInfo.dims / TILE_SIZE, 1);
+
+    // Mips 0 to 2. Each thread reduces one texel of mip 2, up to 2x2 on the last tiles.
+    {
+        uint2 tileStart, tileEnd;
+        GetTileRect(Gid.xy, tileCount, 2, tileStart, tileEnd);
+
+        for (uint y = GTid.y; y < tileEnd.y - tileStart.y; y += GROUP_DIM)
+        {
+            for (uint x = GTid.x; x < tileEnd.x - tileStart.x; x += GROUP_DIM)
+            {
+                uint2 texel = tileStart + uint2(x, y);
+                float2 minMax = ReduceMip2Texel(texel);
+
+                StoreMip(2, texel, minMax);
+                gsMinMax[GetGroupSharedIndex(uint2(x, y), 2)] = minMax;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Mips 3 to 6 from groupshared memory, one thread per texel.
+    [unroll]
+    for (uint mip = 3; mip <= TILE_MIP_COUNT; mip++)
+    {
+        uint2 tileStart, tileEnd;
+        GetTileRect(Gid.xy, tileCount, mip, tileStart, tileEnd);
+
+        uint2 tileDims = tileEnd - tileStart;
+        if (GroupIndex < tileDims.x * tileDims.y)
+        {
+            uint2 tileTexel = uint2(GroupIndex % tileDims.x, GroupIndex / tileDims.x);
+            uint2 texel = tileStart + tileTexel;
+
+            uint2 firstChild = texel * 2;
+            uint2 lastChild = GetHiZLastChild(texel, GetHiZMipDims(hiZInfo.dims, mip), GetHiZMipDims(hiZInfo.dims, mip - 1));
+
+            // Tiles start on multiples of 64, so the tile starts twice as far in the mip above.
+            float2 minMax = HIZ_EMPTY_MIN_MAX;
+            for (uint y = firstChild.y; y <= lastChild.y; y++)
+            {
+                for (uint x = firstChild.x; x <= lastChild.x; x++)
+                {
+                    minMax = CombineMinMax(minMax, gsMinMax[GetGroupSharedIndex(uint2(x, y) - tileStart * 2, mip - 1)]);
+                }
+            }
+
+            StoreMip(mip, texel, minMax);
+            gsMinMax[GetGroupSharedIndex(tileTexel, mip)] = minMax;
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (hiZInfo.mipCount <= TILE_MIP_COUNT + 1)
+    {
+        return;
+    }
+
+    // Mip 6 of this tile has to be visible to the last group before the group counts itself as finished.
+    DeviceMemoryBarrierWithGroupSync();
+
+    if (GroupIndex == 0)
+    {
+        uint finishedGroupCount = 0;
+        groupCounter.InterlockedAdd(0, 1, finishedGroupCount);
+        gsFinishedGroupCount = finishedGroupCount;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (gsFinishedGroupCount != hiZInfo.groupCount - 1)
+    {
+        return;
+    }
+
+    // Last group: mip 7 and up, read back from the mip above.
+    for (uint mip = TILE_MIP_COUNT + 1; mip < hiZInfo.mipCount; mip++)
+    {
+        uint2 mipDims = GetHiZMipDims(hiZInfo.dims, mip);
+        uint2 sourceMipDims = GetHiZMipDims(hiZInfo.dims, mip - 1);
+
+        for (uint i = GroupIndex; i < mipDims.x * mipDims.y; i += GROUP_SIZE)
+        {
+            uint2 texel = uint2(i % mipDims.x, i / mipDims.x);
+            uint2 firstChild = texel * 2;
+            uint2 lastChild = GetHiZLastChild(texel, mipDims, sourceMipDims);
+
+            float2 minMax = HIZ_EMPTY_MIN_MAX;
+            for (uint y = firstChild.y; y <= lastChild.y; y++)
+            {
+                for (uint x = firstChild.x; x <= lastChild.x; x++)
+                {
+                    minMax = CombineMinMax(minMax, hiZMips[mip - 1][uint2(x, y)]);
+                }
+            }
+
+            hiZMips[mip][texel] = minMax;
+        }
+
+        DeviceMemoryBarrierWithGroupSync();
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef RCCASCADEDISPATCH_H
+#define RCCASCADEDISPATCH_H
+
+// Shared between HLSL and C++ (GPUStructs.h and the CPU reference), _HLSL is only defined when compiling shaders.
+// Maps the linear index of a single DispatchRays covering every cascade to a cascade and a texel inside of that cascade.
+
+#define RC_MAX_CASCADE_COUNT 10
+
+#if defined(_HLSL)
+#define RC_SHARED_INLINE
+#else
+#include <cassert>
+#include <cstdint>
+
+#define RC_SHARED_INLINE inline
+
+namespace RCShaderShared
+{
+typedef uint32_t uint;
+
+struct uint2
+{
+    uint x;
+    uint y;
+};
+#endif
+
+struct CascadeDispatchRange
+{
+    uint firstLinearIndex; // Exclusive prefix sum of the texel counts of all previous cascades.
+    uint width;
+    uint height;
+    uint padding;
+};
+
+struct CascadeDispatchTable
+{
+    CascadeDispatchRange cascades[RC_MAX_CASCADE_COUNT];
+    uint cascadeCount;
+    uint texelCount; // Width of the dispatch, sum of the texel counts of all cascades.
+    uint2 padding;
+};
+
+// Cascade counts are small, a linear search is cheaper than a binary one and keeps the loop uniform across a wave.
+RC_SHARED_INLINE uint GetDispatchCascadeIndex(CascadeDispatchTable table, uint linearIndex)
+{
+    uint cascadeIndex = 0;
+    for (uint i = 1; i < table.cascadeCount; i++)
+    {
+        if (linearIndex >= table.cascades[i].firstLinearIndex)
+        {
+            cascadeIndex = i;
+        }
+    }
+
+    return cascadeIndex;
+}
+
+RC_SHARED_INLINE uint2 GetDispatchCascadeTexel(CascadeDispatchTable table, uint cascadeIndex, uint linearIndex)
+{
+    CascadeDispatchRange range = table.cascades[cascadeIndex];
+    uint localIndex = linearIndex - range.firstLinearIndex;
+
+    uint2 texel;
+    texel.x = localIndex % range.width;
+    texel.y = localIndex / range.width;
+
+    return texel;
+}
+
+// Active probe-direction lists of all cascades share one buffer, laid out in cascade order like the single dispatch.
+// Cascade 0 is never filtered and has no list, so the buffer starts at cascade 1.
+RC_SHARED_INLINE uint GetActiveProbeDirectionListOffset(CascadeDispatchTable table, uint cascadeIndex)
+{
+    return table.cascades[cascadeIndex].firstLinearIndex - table.cascades[1].firstLinearIndex;
+}
+
+#if !defined(_HLSL)
+// cascadeDims holds the width and height of every cascade in cascade order.
+inline CascadeDispatchTable BuildCascadeDispatchTable(const uint2* cascadeDims, uint cascadeCount)
+{
+    assert(cascadeCount <= RC_MAX_CASCADE_COUNT);
+
+    CascadeDispatchTable table = {};
+    table.cascadeCount = cascadeCount;
+
+    uint texelCount = 0;
+    for (uint i = 0; i < cascadeCount; i++)
+    {
+        table.cascades[i].firstLinearIndex = texelCount;
+        table.cascades[i].width = cascadeDims[i].x;
+        table.cascades[i].height = cascadeDims[i].y;
+
+        texelCount += cascadeDims[i].x * cascadeDims[i].y;
+    }
+
+    table.texelCount = texelCount;
+
+    return table;
+}
+}
+#endif
+
+#endif // RCCASCADEDISPATCH_H
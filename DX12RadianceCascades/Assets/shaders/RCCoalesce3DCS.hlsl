@@ -2,6 +2,7 @@
 
 // Output tex should have a resolution where each pixel corresponds to one probe in cascade 0, i.e. ProbeCountPerDim0 x ProbeCountPerDim0 
 // The dispatch should be made with this resolution.
+// RCMergeCoalesce3DCS.hlsl does the same while merging cascade 0, both sum the rays in the same order.
 
 Texture2D<float4> cascade0Tex : register(t0);
 RWTexture2D<float4> outputTex : register(u0);
@@ -18,30 +19,25 @@ void main( uint3 DTid : SV_DispatchThreadID )
     if (!OUT_OF_BOUNDS(pixelPos, outputDims))
     {
         int2 probePos = pixelPos;
-        float3 radiance = 0.0f;
+        int2 probeCounts = int2(rcGlobals.probeCount0X, rcGlobals.probeCount0Y);
 
-        uint rayCount = rcGlobals.rayCount0;
-        // If the merge has been pre-averaged it means that each original ray has 
-        // casted a ray equal to its ray scaling factor. 
-        if(rcGlobals.usePreAveraging)
-        {
-            rayCount /= rcGlobals.rayScalingFactor; 
-        }
-        
+        uint rayCount = GetCoalesceRayCount(rcGlobals);
         uint rayCount0Sqrt = sqrt(rayCount);
-        float4 summedRadiance = 0.0f;        
-        for (int i = 0; i < rayCount0Sqrt; i++)
+        
+        float3 summedRadiance = 0.0f;
+        for (uint slot = 0; slot < RC_COALESCE_RAY_SLOTS; slot++)
         {
-            for (int k = 0; k < rayCount0Sqrt; k++)
+            float3 slotRadiance = 0.0f;
+            for (uint i = slot; i < rayCount; i += RC_COALESCE_RAY_SLOTS)
             {
-                int2 rayOffset = int2(rcGlobals.probeCount0X, rcGlobals.probeCount0Y) * int2(i, k);
-                int2 samplePoint = probePos + rayOffset;
-                
-                summedRadiance += cascade0Tex[samplePoint];
+                int2 samplePoint = probePos + probeCounts * GetCoalesceRayIndex(i, rayCount0Sqrt);
+                slotRadiance += cascade0Tex[GetCascadeTexelPos(samplePoint, 0, rcGlobals)].rgb;
             }
+            
+            summedRadiance += slotRadiance;
         }
 
-        radiance = summedRadiance.rgb / rayCount; 
+        float3 radiance = summedRadiance / rayCount; 
         outputTex[pixelPos] = float4(radiance, 1.0f);
     }
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #define RCCOMMON_H
 
 #include "Common.hlsli"
+#include "RCCascadeDispatch.hlsli"
 
 #define RAYS_PER_PROBE(cascadeIndex, scalingFactor, rayCount0) (rayCount0 * pow(scalingFactor, cascadeIndex))
 #define PROBES_PER_DIM(cascadeIndex, scalingFactor, probeDim0) (probeDim0 / pow(scalingFactor, cascadeIndex))
@@ -26,11 +27,22 @@ struct RCGlobals
     uint probeCount0X;
     uint probeCount0Y;
     uint probeSpacing0; // Spacing between probes in pixels.
+    bool useCascadeAtlas;
+    bool usePrecomputedMergeWeights; // Depth aware merge weights are loaded from the buffer written by RCMergeWeights3DCS.hlsl.
+    bool useVisibilityPlane; // Cascade intervals have no alpha, visibility is stored in a separate texture with the same layout.
+    uint tileOriginX; // Screen pixel of the top left corner of the cascades when the screen is processed in tiles, 0 otherwise.
+    uint tileOriginY; // The depth buffer always covers the whole screen, see CPUReference/CascadeTiling.h.
+    uint4 cascadeAtlasRects[RC_MAX_CASCADE_COUNT]; // Offset (xy) and extent (zw) of each cascade inside the atlas. Only set if the atlas is used.
 };
 
 struct CascadeInfo
 {
     uint cascadeIndex;
+    bool useCascadeDispatchTable; // Cascade index comes from the dispatch table instead, see RCCascadeDispatch.hlsli.
+    bool useActiveProbeDirectionLists; // Cascades above 0 are dispatched over the probe-directions flagged by the previous cascade.
+    uint mergeWeightsOffset; // First element of the cascade in the merge weights buffer, see RCMergeWeights3DCS.hlsl.
+    bool ignoreGatherFilter; // Set when the gather filter of the cascade is incomplete or the cascade is reprojected in later frames.
+    uint dispatchOffsetY; // First row of the cascade that is gathered, for staggered updates that only gather a band of rows.
 };
 
 struct ProbeInfo3D
@@ -42,6 +54,8 @@ struct ProbeInfo3D
     int2 probesPerDim; // Clamped value
     int2 probeIndex; // Also relative pixel position inside a direction group.
     uint2 probeSpacing;
+    int2 texelPos; // Texel of the probe-direction in the cascade resource, offset into the cascade atlas if it is used.
+    int2 tileOrigin; // Screen pixel of probe index 0, see RCGlobals::tileOriginX.
 };
 
 struct DepthTile
@@ -51,7 +65,7 @@ struct DepthTile
 };
 
 // TODO: Rename this to something more general.
-DepthTile GetDepthTile(uint2 pixelSize)
+DepthTile GetDepthTile(uint2 pixelSize, int2 tileOrigin)
 {
     DepthTile depthTile;
     
@@ -59,7 +73,7 @@ DepthTile GetDepthTile(uint2 pixelSize)
     depthTile.stride = int2(pixelSize);
     // The offset of each tile from top left (0,0). 
     // Set to half the stride (rounded down) to represent the middle of the tile.
-    depthTile.offset = int2(pixelSize / 2);
+    depthTile.offset = tileOrigin + int2(pixelSize / 2);
     
     return depthTile;
 }
@@ -82,6 +96,14 @@ float2 GetTileProbeScreenPos(DepthTile depthTile, float2 probeIndex, uint2 baseD
     return probeUV;
 }
 
+// Inverse of GetTileProbeScreenPos, fractional probe index of a UV coord.
+float2 GetTileProbeIndex(DepthTile depthTile, float2 probeUV, uint2 baseDims)
+{
+    float2 probeOffset = float2(depthTile.offset) + 0.5f;
+
+    return (probeUV * baseDims - probeOffset) / float2(depthTile.stride);
+}
+
 // Calculates: a + ar^2 + ar^3 + ... + ar^(n - 1)
 float GeometricSeriesSum(float a, float r, float n)
 {
@@ -125,6 +147,23 @@ float3 OctToFloat3EqualArea(float2 e)
     return float3(cos_phi * r_scl, sin_phi * r_scl, z);
 }
 
+uint4 GetCascadeAtlasRect(uint cascadeIndex, RCGlobals rcGlobals)
+{
+    return rcGlobals.cascadeAtlasRects[min(cascadeIndex, RC_MAX_CASCADE_COUNT - 1)];
+}
+
+// Turns a texel position local to a cascade into a texel position of the resource that the cascade is stored in.
+int2 GetCascadeTexelPos(int2 localPos, uint cascadeIndex, RCGlobals rcGlobals)
+{
+    if (rcGlobals.useCascadeAtlas)
+    {
+        return localPos + int2(GetCascadeAtlasRect(cascadeIndex, rcGlobals).xy);
+    }
+    
+    return localPos;
+}
+
+// Pixel pos is local to the cascade, also when the cascade atlas is used.
 ProbeInfo3D BuildProbeInfo3DDirFirst(uint2 pixelPos, uint cascadeIndex, RCGlobals rcGlobals)
 {
     ProbeInfo3D probeInfo3D;
@@ -143,6 +182,9 @@ ProbeInfo3D BuildProbeInfo3DDirFirst(uint2 pixelPos, uint cascadeIndex, RCGlobal
     probeInfo3D.startDistance = abs(GeometricSeriesSum(rcGlobals.rayLength0, rcGlobals.rayScalingFactor, cascadeIndex));
     probeInfo3D.range = rcGlobals.rayLength0 * pow(rcGlobals.rayScalingFactor, cascadeIndex);
     
+    probeInfo3D.texelPos = GetCascadeTexelPos(pixelPos, cascadeIndex, rcGlobals);
+    probeInfo3D.tileOrigin = int2(rcGlobals.tileOriginX, rcGlobals.tileOriginY);
+    
     return probeInfo3D;
 }
 
@@ -164,7 +206,7 @@ float3 GetProbeWorldPos(ProbeInfo3D probeInfo3D, TexType depthTex, float4x4 invP
     uint2 depthDims;
     GetDims(depthTex, depthDims);
         
-    DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing);
+    DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
     uint2 samplePos = GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depthDims);
         
     float depthVal = depthTex.Load(int3(samplePos, 0));
@@ -179,15 +221,108 @@ float3 GetProbeWorldPos(ProbeInfo3D probeInfo3D, TexType depthTex, float4x4 invP
     return worldPos;
 }
 
-float2 GetCascadeN1SamplePosition(ProbeInfo3D probeInfoN, ProbeInfo3D probeInfoN1, int2 rayOffset)
+// Texture dimensions of a cascade interval, matches the sizes set in RadianceCascadeManager3D::Generate().
+uint2 GetCascadeDims(uint cascadeIndex, RCGlobals rcGlobals)
+{
+    uint probesX = PROBES_PER_DIM(cascadeIndex, rcGlobals.probeScalingFactor, rcGlobals.probeCount0X);
+    uint probesY = PROBES_PER_DIM(cascadeIndex, rcGlobals.probeScalingFactor, rcGlobals.probeCount0Y);
+
+    uint rayCount = RAYS_PER_PROBE(cascadeIndex, rcGlobals.rayScalingFactor, rcGlobals.rayCount0);
+    if (rcGlobals.usePreAveraging)
+    {
+        rayCount /= rcGlobals.rayScalingFactor;
+    }
+
+    uint raysPerDim = sqrt(rayCount);
+
+    return uint2(probesX, probesY) * raysPerDim;
+}
+
+// Gather filters store one bit per probe-direction, packed row by row into 32 bit words of a raw buffer.
+struct GatherFilterBit
+{
+    uint byteOffset;
+    uint mask;
+};
+
+GatherFilterBit GetGatherFilterBit(uint2 texelPos, uint filterWidth)
 {
-    // -0.5 to get in the middle of texel in cascade N.
-    float2 probeN1Index = float2(probeInfoN.probeIndex - 0.5f) / 2.0f; // TODO: Replace hardcoded 2 with probescalingfactor (per dim)
+    uint bitIndex = texelPos.y * filterWidth + texelPos.x;
+
+    GatherFilterBit filterBit;
+    filterBit.byteOffset = (bitIndex >> 5) * 4;
+    filterBit.mask = 1u << (bitIndex & 31);
+
+    return filterBit;
+}
+
+// Rays of a cascade 0 probe are coalesced into this many interleaved partial sums, which are then added in order.
+// Shared by RCCoalesce3DCS.hlsl and RCMergeCoalesce3DCS.hlsl so that both give the exact same result.
+#define RC_COALESCE_RAY_SLOTS 4
+
+// Amount of cascade 0 texels per probe.
+uint GetCoalesceRayCount(RCGlobals rcGlobals)
+{
+    uint rayCount = rcGlobals.rayCount0;
+    // If the merge has been pre-averaged it means that each original ray has 
+    // casted a ray equal to its ray scaling factor. 
+    if (rcGlobals.usePreAveraging)
+    {
+        rayCount /= rcGlobals.rayScalingFactor;
+    }
+    
+    return rayCount;
+}
+
+// Ray (direction group) of the coalesced ray index, stepping along y first.
+int2 GetCoalesceRayIndex(uint coalesceRayIndex, uint raysPerDim)
+{
+    return int2(coalesceRayIndex / raysPerDim, coalesceRayIndex % raysPerDim);
+}
+
+// Probe scaling factor is per dim and ray scaling dim is the square root of the ray scaling factor.
+// Both are passed in so that specialized merge kernels can use compile time constants, see RCMerge3D.hlsli.
+float2 GetCascadeN1SamplePosition(ProbeInfo3D probeInfoN, ProbeInfo3D probeInfoN1, int2 rayOffset, uint probeScalingFactor, uint rayScalingDim)
+{
+    // Probe centers of cascade N in probe index space of cascade N + 1: (i + 0.5) / factor - 0.5.
+    float2 probeN1Index = (float2(probeInfoN.probeIndex) + (0.5f - 0.5f * probeScalingFactor)) / probeScalingFactor;
     // Clamp to avoid sampling over edges of probe groups.
     float2 clampedProbeN1Index = clamp(probeN1Index, 0.0f, float2(probeInfoN1.probesPerDim) - 2.0f);
-    float2 rayN1Index = probeInfoN.rayIndex * 2.0f; // TODO: Replace hardcoded 2 with sqrt(rayscalingfactor)
+    float2 rayN1Index = probeInfoN.rayIndex * float(rayScalingDim);
         
     return clampedProbeN1Index + probeInfoN1.probesPerDim * (rayN1Index + rayOffset);
 }
 
+// Bilinear weights of the 4 cascade N + 1 probes that a cascade N probe merges with, adjusted to the world positions of the probes.
+// Only depends on the probe and not on the ray direction, so it is the same for every probe-direction of the probe.
+template <typename TexType>
+float4 GetDepthAwareMergeWeights(ProbeInfo3D probeInfoN, ProbeInfo3D probeInfoN1, uint probeScalingFactor, TexType depthTex, float4x4 invProjMatrix, float4x4 invViewMatrix)
+{
+    int2 depthResolution;
+    GetDims(depthTex, depthResolution);
+    float2 depthTexelSize = 1.0f / depthResolution;
+    
+    float2 probeN1Index = float2(probeInfoN.probeIndex) / probeScalingFactor;
+    // Clamp so sampling doesnt happen between probe groups.
+    float2 clampedProbeN1Index = clamp(probeN1Index, 1.0f, probeInfoN1.probesPerDim - 1);
+    float2 ratios = frac(clampedProbeN1Index);
+    
+    float3 cascadeNWorldPos = GetProbeWorldPos(probeInfoN, depthTex, invProjMatrix, invViewMatrix);
+    
+    DepthTile depthTileN1 = GetDepthTile(probeInfoN1.probeSpacing, probeInfoN1.tileOrigin);
+    uint2 cascadeN1SamplePosOrigin = GetDepthSamplePos(depthTileN1, clampedProbeN1Index, depthResolution);
+    
+    float3 sourcePoints[4];
+    for (int i = 0; i < 4; i++)
+    {
+        int2 offset = TranslateCoord4x1To2x2(i);
+        uint2 depthSamplePosN1 = ClampPixelPos(cascadeN1SamplePosOrigin + offset, depthResolution);
+        
+        float cascadeN1Depth = depthTex.Load(int3(depthSamplePosN1, 0));
+        sourcePoints[i] = WorldPosFromDepth(cascadeN1Depth, (float2(depthSamplePosN1)) * depthTexelSize, invProjMatrix, invViewMatrix);
+    }
+    
+    return GetBilinearSampleWeights(GetBilinear3dRatioIter(sourcePoints, cascadeNWorldPos, ratios, 2));
+}
+
 #endif // RCCOMMON_H
\ No newline at end of file
@@ -0,0 +1,194 @@
+#ifndef RCMERGE3D_H
+#define RCMERGE3D_H
+
+#include "RCCommon3D.hlsli"
+
+// Resources and per probe-direction logic of the merge, shared by RCMerge3DCS.hlsl and RCMergeCoalesce3DCS.hlsl.
+
+// Both kernels are compiled once per supported pair of scaling factors with RC_PROBE_SCALING_FACTOR and RC_RAY_SCALING_DIM defined,
+// see CPUReference/ScalingPermutations.h. The loops over the merged rays then have a constant trip count and are unrolled.
+// Without the defines the factors are read from rcGlobals, which is used for factors that have no permutation.
+#if defined(RC_PROBE_SCALING_FACTOR) && defined(RC_RAY_SCALING_DIM)
+#define MERGE_PROBE_SCALING_FACTOR RC_PROBE_SCALING_FACTOR
+#define MERGE_RAY_SCALING_DIM RC_RAY_SCALING_DIM
+#else
+#define MERGE_PROBE_SCALING_FACTOR rcGlobals.probeScalingFactor
+#define MERGE_RAY_SCALING_DIM uint(sqrt(rcGlobals.rayScalingFactor))
+#endif
+
+#define MERGE_RAY_SCALING_FACTOR (MERGE_RAY_SCALING_DIM * MERGE_RAY_SCALING_DIM)
+
+// Needs to be a bilinear sampler with borders set to black with alpha of 1.0
+SamplerState linearSampler : register(s0);
+
+// If the cascade atlas is used, cascadeN is the atlas and cascadeN1 is not read from.
+Texture2D<float4> cascadeN1 : register(t0);
+RWTexture2D<float4> cascadeN : register(u0);
+
+ConstantBuffer<RCGlobals> rcGlobals : register(b0);
+ConstantBuffer<CascadeInfo> cascadeInfo : register(b1);
+
+Texture2D<float> depthBuffer : register(t1);
+
+ConstantBuffer<GlobalInfo> globalInfo : register(b2);
+
+// Written by RCMergeWeights3DCS.hlsl, only read if rcGlobals.usePrecomputedMergeWeights is set.
+StructuredBuffer<float4> mergeWeights : register(t2);
+
+// Only read if rcGlobals.useVisibilityPlane is set, the cascades then have no alpha channel. Bound the same way as cascadeN1 and cascadeN.
+Texture2D<float> cascadeN1Visibility : register(t3);
+RWTexture2D<float> cascadeNVisibility : register(u2);
+
+float4 ReadRadianceN1(float2 probeIndex, float2 rayIndex, float2 probeCountPerDimN1, float2 texDims)
+{
+    float2 sampleTexel = rayIndex * probeCountPerDimN1 + probeIndex + 1.0f;
+    float2 sampleUV = sampleTexel / texDims;
+
+    return cascadeN1.SampleLevel(linearSampler, sampleUV, 0);
+}
+
+float4 LoadCascadeN1(int2 texelPos, int2 sourceDims)
+{
+    if (rcGlobals.useCascadeAtlas)
+    {
+        // Texels outside of cascade N1 belong to other cascades in the atlas, they are read as zero like a load outside of a texture.
+        if (OUT_OF_BOUNDS(texelPos, sourceDims))
+        {
+            return 0.0f;
+        }
+        
+        int2 atlasTexelPos = GetCascadeTexelPos(texelPos, cascadeInfo.cascadeIndex + 1, rcGlobals);
+        float4 radiance = cascadeN[atlasTexelPos];
+        if (rcGlobals.useVisibilityPlane)
+        {
+            radiance.a = cascadeNVisibility[atlasTexelPos];
+        }
+        
+        return radiance;
+    }
+    
+    float4 radiance = cascadeN1.Load(int3(texelPos, 0));
+    if (rcGlobals.useVisibilityPlane)
+    {
+        radiance.a = cascadeN1Visibility.Load(int3(texelPos, 0));
+    }
+    
+    return radiance;
+}
+
+float4 LoadCascadeN(int2 texelPos)
+{
+    float4 radiance = cascadeN[texelPos];
+    if (rcGlobals.useVisibilityPlane)
+    {
+        radiance.a = cascadeNVisibility[texelPos];
+    }
+    
+    return radiance;
+}
+
+void StoreCascadeN(int2 texelPos, float4 radiance)
+{
+    cascadeN[texelPos] = radiance;
+    if (rcGlobals.useVisibilityPlane)
+    {
+        cascadeNVisibility[texelPos] = radiance.a;
+    }
+}
+
+// Dimensions of cascade N (target) and cascade N + 1 (source).
+void GetMergeDims(out int2 targetDims, out int2 sourceDims)
+{
+    if (rcGlobals.useCascadeAtlas)
+    {
+        targetDims = GetCascadeAtlasRect(cascadeInfo.cascadeIndex, rcGlobals).zw;
+        sourceDims = GetCascadeAtlasRect(cascadeInfo.cascadeIndex + 1, rcGlobals).zw;
+    }
+    else
+    {
+        GetDims(cascadeN, targetDims);
+        GetDims(cascadeN1, sourceDims);
+    }
+}
+
+// Near radiance is the gathered radiance of the probe-direction in cascade N. It should not be obscured (a == 0),
+// as the higher cascades should not carry over any information in that case.
+float4 MergeProbeDirection(ProbeInfo3D probeInfoN, ProbeInfo3D probeInfoN1, float4 nearRadiance, int2 sourceDims)
+{
+    float4 normalizedFarRadiance = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    
+    const uint probeScalingFactor = MERGE_PROBE_SCALING_FACTOR;
+    const int rayScalingDim = MERGE_RAY_SCALING_DIM;
+    const int raysToMerge = MERGE_RAY_SCALING_FACTOR;
+    
+    float2 probeN1Index = float2(probeInfoN.probeIndex) / probeScalingFactor;
+
+    if (rcGlobals.depthAwareMerging)
+    {
+        float4 weights3D = 0.0f;
+        if (rcGlobals.usePrecomputedMergeWeights)
+        {
+            weights3D = mergeWeights[cascadeInfo.mergeWeightsOffset + probeInfoN.probeIndex.y * probeInfoN.probesPerDim.x + probeInfoN.probeIndex.x];
+        }
+        else
+        {
+            weights3D = GetDepthAwareMergeWeights(probeInfoN, probeInfoN1, probeScalingFactor, depthBuffer, globalInfo.invProjMatrix, globalInfo.invViewMatrix);
+        }
+        
+        for (int i = 0; i < 4; i++)
+        {
+            int2 probeOffset = TranslateCoord4x1To2x2(i);
+            float2 cascadeN1ProbeIndex = probeN1Index + probeOffset;
+            cascadeN1ProbeIndex = clamp(cascadeN1ProbeIndex, 1.0f, probeInfoN1.probesPerDim - 1);
+            
+            float4 farRadianceSum = 0.0f;
+            for (int k = 0; k < raysToMerge; k++)
+            {
+                int2 rayOffset = Translate1DTo2D(k, rayScalingDim);
+                float2 cascadeN1RayIndex = probeInfoN.rayIndex * float(rayScalingDim) + rayOffset;
+
+                float2 cascadeN1PixelPos = cascadeN1RayIndex * probeInfoN1.probesPerDim + cascadeN1ProbeIndex;
+                cascadeN1PixelPos = ClampPixelPos(cascadeN1PixelPos, sourceDims);
+                float4 farRadiance = LoadCascadeN1(cascadeN1PixelPos - 0.5, sourceDims);
+            
+                float3 radiance = nearRadiance.a * farRadiance.rgb; // Radiance is only carried if near field is visible.
+                float visibility = nearRadiance.a * farRadiance.a; // Make sure visibility is updated if near field is not visible.
+        
+                farRadianceSum += float4(radiance, visibility);
+            }
+            
+            normalizedFarRadiance += farRadianceSum * weights3D[i] / raysToMerge;
+        }
+    }
+    else
+    {
+        float4 farRadianceSum = 0.0f;
+    
+        for (int i = 0; i < raysToMerge; i++)
+        {
+            int2 rayOffset = Translate1DTo2D(i, rayScalingDim);
+
+            float2 sampleTexelPos = GetCascadeN1SamplePosition(probeInfoN, probeInfoN1, rayOffset, probeScalingFactor, rayScalingDim);
+            
+            float4 samples[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int2 texelCoord = floor(sampleTexelPos) + TranslateCoord4x1To2x2(k);
+                samples[k] = LoadCascadeN1(texelCoord, sourceDims);
+            }
+            
+            float4 farRadiance = BilinearInterpolation(samples[0], samples[1], samples[2], samples[3], frac(sampleTexelPos));
+            
+            float3 radiance = nearRadiance.a * farRadiance.rgb; // Radiance is only carried if near field is visible.
+            float visibility = nearRadiance.a * farRadiance.a; // Make sure visibility is updated if near field is not visible.
+        
+            farRadianceSum += float4(radiance, visibility);
+        }
+    
+        normalizedFarRadiance = farRadianceSum / raysToMerge;
+    }
+
+    return nearRadiance + normalizedFarRadiance;
+}
+
+#endif // RCMERGE3D_H
@@ -0,0 +1,68 @@
+#include "RCMerge3D.hlsli"
+
+// Merge of cascade 0 that also writes the coalesced result, replacing the merge of cascade 0 followed by RCCoalesce3DCS.hlsl.
+// Each group covers 8 x 8 probes, the rays of each probe are split over RC_COALESCE_RAY_SLOTS threads
+// and their partial sums are reduced in groupshared memory. The dispatch should be made with the cascade 0 probe counts.
+
+RWTexture2D<float4> coalesceOutput : register(u1);
+
+#define PROBE_GROUP_DIM 8
+
+groupshared float3 gsSlotRadiance[RC_COALESCE_RAY_SLOTS][PROBE_GROUP_DIM * PROBE_GROUP_DIM];
+
+[numthreads(PROBE_GROUP_DIM, PROBE_GROUP_DIM, RC_COALESCE_RAY_SLOTS)]
+void main( uint3 DTid : SV_DispatchThreadID, uint3 GTid : SV_GroupThreadID )
+{
+    int2 targetDims = 0;
+    int2 sourceDims = 0;
+    GetMergeDims(targetDims, sourceDims);
+    
+    int2 probeIndex = DTid.xy;
+    int2 probeCounts = int2(rcGlobals.probeCount0X, rcGlobals.probeCount0Y);
+    uint groupProbeIndex = GTid.y * PROBE_GROUP_DIM + GTid.x;
+    uint slot = GTid.z;
+    
+    uint rayCount = GetCoalesceRayCount(rcGlobals);
+    uint rayCount0Sqrt = sqrt(rayCount);
+    
+    // No early out, every thread has to reach the group sync.
+    bool isProbeInBounds = !OUT_OF_BOUNDS(probeIndex, probeCounts);
+    
+    float3 slotRadiance = 0.0f;
+    if (isProbeInBounds)
+    {
+        for (uint i = slot; i < rayCount; i += RC_COALESCE_RAY_SLOTS)
+        {
+            int2 pixelPos = probeIndex + probeCounts * GetCoalesceRayIndex(i, rayCount0Sqrt);
+            
+            ProbeInfo3D probeInfoN = BuildProbeInfo3DDirFirst(pixelPos, cascadeInfo.cascadeIndex, rcGlobals);
+            ProbeInfo3D probeInfoN1 = BuildProbeInfo3DDirFirst(pixelPos, cascadeInfo.cascadeIndex + 1, rcGlobals);
+            
+            float4 radiance = LoadCascadeN(probeInfoN.texelPos);
+            
+            // If this ray is obscured (a == 0), the higher cascades should not carry over any information.
+            if (!IsZero(radiance.a))
+            {
+                radiance = MergeProbeDirection(probeInfoN, probeInfoN1, radiance, sourceDims);
+                StoreCascadeN(probeInfoN.texelPos, radiance);
+            }
+            
+            slotRadiance += radiance.rgb;
+        }
+    }
+    
+    gsSlotRadiance[slot][groupProbeIndex] = slotRadiance;
+    
+    GroupMemoryBarrierWithGroupSync();
+    
+    if (slot == 0 && isProbeInBounds)
+    {
+        float3 summedRadiance = 0.0f;
+        for (uint k = 0; k < RC_COALESCE_RAY_SLOTS; k++)
+        {
+            summedRadiance += gsSlotRadiance[k][groupProbeIndex];
+        }
+        
+        coalesceOutput[probeIndex] = float4(summedRadiance / rayCount, 1.0f);
+    }
+}
@@ -0,0 +1,30 @@
+#include "RCCommon3D.hlsli"
+
+// One set of depth aware bilinear weights per probe of cascade N, shared by every ray direction of the probe during the merge.
+// Probes of every cascade but the last one are stored one after another, starting at cascadeInfo.mergeWeightsOffset.
+RWStructuredBuffer<float4> mergeWeights : register(u0);
+
+ConstantBuffer<RCGlobals> rcGlobals : register(b0);
+ConstantBuffer<CascadeInfo> cascadeInfo : register(b1);
+
+Texture2D<float> depthBuffer : register(t0);
+
+ConstantBuffer<GlobalInfo> globalInfo : register(b2);
+
+[numthreads(8, 8, 1)]
+void main( uint3 DTid : SV_DispatchThreadID )
+{
+    uint2 probeIndex = DTid.xy;
+
+    // Probe index is the pixel position of the probe in the first direction group.
+    ProbeInfo3D probeInfoN = BuildProbeInfo3DDirFirst(probeIndex, cascadeInfo.cascadeIndex, rcGlobals);
+    ProbeInfo3D probeInfoN1 = BuildProbeInfo3DDirFirst(probeIndex, cascadeInfo.cascadeIndex + 1, rcGlobals);
+
+    if (OUT_OF_BOUNDS(probeIndex, probeInfoN.probesPerDim))
+    {
+        return;
+    }
+
+    uint weightIndex = cascadeInfo.mergeWeightsOffset + probeIndex.y * probeInfoN.probesPerDim.x + probeIndex.x;
+    mergeWeights[weightIndex] = GetDepthAwareMergeWeights(probeInfoN, probeInfoN1, rcGlobals.probeScalingFactor, depthBuffer, globalInfo.invProjMatrix, globalInfo.invViewMatrix);
+}
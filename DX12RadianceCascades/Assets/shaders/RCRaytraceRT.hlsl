@@ -43,11 +43,23 @@ ConstantBuffer<GeometryOffsets> geomOffsets : register(b0, space1);
 // RC Related Buffers
 ConstantBuffer<RCGlobals> rcGlobals : register(b1);
 ConstantBuffer<CascadeInfo> cascadeInfo : register(b2);
+// Only bound when every cascade is gathered by a single dispatch, see CascadeInfo::useCascadeDispatchTable.
+ConstantBuffer<CascadeDispatchTable> cascadeDispatchTable : register(b3);
 
-RWTexture2D<float> gatherFilterTexN : register(u1);
-RWTexture2D<float> gatherFilterTexN1 : register(u2);
+// Bit packed, see GetGatherFilterBit().
+RWByteAddressBuffer gatherFilterBufferN : register(u1);
+RWByteAddressBuffer gatherFilterBufferN1 : register(u2);
 RWTexture2D<float> depthTex : register(u3);
 
+// Only bound if CascadeInfo::useActiveProbeDirectionLists is set.
+// Texel indices (y * width + x) of the probe-directions to gather, one list per cascade, see GetActiveProbeDirectionListOffset().
+RWByteAddressBuffer activeProbeDirections : register(u4);
+// One counter per cascade, becomes the width of the indirect dispatch of that cascade.
+RWByteAddressBuffer activeProbeDirectionCounts : register(u5);
+
+// Only bound if rcGlobals.useVisibilityPlane is set, renderOutput then has no alpha channel to store visibility in.
+RWTexture2D<float> renderVisibility : register(u6);
+
 float3 GetBarycentrics(float2 inputBarycentrics)
 {
     return float3(1.0 - inputBarycentrics.x - inputBarycentrics.y, inputBarycentrics.x, inputBarycentrics.y);
@@ -96,8 +108,33 @@ struct RayPayload
 {
     int2 probeIndex;
     float4 result;
+    uint cascadeIndex; // Needed by miss and hit shaders as a single dispatch can cover several cascades.
 };
 
+// Called by every thread that was first to set a bit in the gather filter of cascadeIndex, so each probe-direction is added once.
+void AppendActiveProbeDirection(uint cascadeIndex, uint texelIndex)
+{
+    // One atomic per wave instead of one per thread.
+    uint waveAppendCount = WaveActiveCountBits(true);
+    uint waveLaneOffset = WavePrefixCountBits(true);
+    
+    uint waveBaseIndex = 0;
+    if (WaveIsFirstLane())
+    {
+        activeProbeDirectionCounts.InterlockedAdd(cascadeIndex * 4, waveAppendCount, waveBaseIndex);
+    }
+    waveBaseIndex = WaveReadLaneFirst(waveBaseIndex);
+    
+    uint listIndex = GetActiveProbeDirectionListOffset(cascadeDispatchTable, cascadeIndex) + waveBaseIndex + waveLaneOffset;
+    activeProbeDirections.Store(listIndex * 4, texelIndex);
+}
+
+// Instances only have the bits of the cascades that can hit them, see CPUReference/InstanceMasks.h. Cascades past the last bit share it.
+inline uint GetCascadeInstanceMask(uint cascadeIndex)
+{
+    return 1u << min(cascadeIndex, 6u);
+}
+
 // Direction is filled outside of this function.
 inline RayDesc GenerateProbeRay(ProbeInfo3D probeInfo3D)
 {
@@ -116,6 +153,28 @@ inline RayDesc GenerateProbeRay(ProbeInfo3D probeInfo3D)
 void RayGenerationShader()
 {
     uint2 pixelPos = DispatchRaysIndex().xy;
+    uint cascadeIndex = cascadeInfo.cascadeIndex;
+    
+    if (cascadeInfo.useCascadeDispatchTable)
+    {
+        // One dimensional dispatch over all cascades.
+        uint linearIndex = DispatchRaysIndex().x;
+        cascadeIndex = GetDispatchCascadeIndex(cascadeDispatchTable, linearIndex);
+        pixelPos = GetDispatchCascadeTexel(cascadeDispatchTable, cascadeIndex, linearIndex);
+    }
+    else if (cascadeInfo.useActiveProbeDirectionLists && cascadeIndex > 0)
+    {
+        // Dispatch is as wide as the list, filled by the previous cascade in AppendActiveProbeDirection().
+        uint listIndex = GetActiveProbeDirectionListOffset(cascadeDispatchTable, cascadeIndex) + DispatchRaysIndex().x;
+        uint texelIndex = activeProbeDirections.Load(listIndex * 4);
+        uint cascadeWidth = cascadeDispatchTable.cascades[cascadeIndex].width;
+        pixelPos = uint2(texelIndex % cascadeWidth, texelIndex / cascadeWidth);
+    }
+    else
+    {
+        // Staggered updates can dispatch a band of rows instead of the whole cascade.
+        pixelPos.y += cascadeInfo.dispatchOffsetY;
+    }
     
     /*
         TODO:
@@ -129,31 +188,34 @@ void RayGenerationShader()
         This should only really apply for cascade 0 as any higher level might actually need this emission information. This is an imperfect solution though.
     */
     
-    ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(pixelPos, cascadeInfo.cascadeIndex, rcGlobals);
+    ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex, rcGlobals);
     
-    if(rcGlobals.useGatherFiltering)
+    // Probe-directions from an active list are already known to be flagged.
+    if (rcGlobals.useGatherFiltering && !cascadeInfo.useActiveProbeDirectionLists && !cascadeInfo.ignoreGatherFilter)
     {
         // This does not need to follow the clamping rules that sampling in the gather stage 
         // uses (clamping probe indices at borders). The data written to the gather filter follows those rules.
         // Probe-dirs naively check if they will be used in sampling during gathering or not. 
         uint2 probeNSampleIndex = probeInfo3D.probeIndex + probeInfo3D.rayIndex * probeInfo3D.probesPerDim;
+        GatherFilterBit filterBitN = GetGatherFilterBit(probeNSampleIndex, GetCascadeDims(cascadeIndex, rcGlobals).x);
         
         // The 0th cascade does not have any filtering information to read from.
-        if (cascadeInfo.cascadeIndex > 0 && IsZero(gatherFilterTexN[probeNSampleIndex]))
+        if (cascadeIndex > 0 && (gatherFilterBufferN.Load(filterBitN.byteOffset) & filterBitN.mask) == 0)
         {
             // This line can be removed if clear color is assumed to have alpha 0
-            //renderOutput[DispatchRaysIndex().xy] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+            //renderOutput[probeInfo3D.texelPos] = float4(0.0f, 0.0f, 0.0f, 0.0f);
             
             return; // Return early as these rays will not be used by any lower cascade.
         }
     }
     
-    ProbeInfo3D probeInfo3DN1 = BuildProbeInfo3DDirFirst(pixelPos, cascadeInfo.cascadeIndex + 1, rcGlobals);
+    ProbeInfo3D probeInfo3DN1 = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex + 1, rcGlobals);
     RayDesc ray = GenerateProbeRay(probeInfo3D);
     
-    DrawProbe(cascadeInfo.cascadeIndex, probeInfo3D.probeIndex, ray.Origin, ray.TMin);
+    DrawProbe(cascadeIndex, probeInfo3D.probeIndex, ray.Origin, ray.TMin);
     
     uint rayFlags = RAY_FLAG_NONE;
+    uint instanceMask = GetCascadeInstanceMask(cascadeIndex);
     
     int sqrtRayCount = sqrt(probeInfo3D.rayCount);
     float4 radianceOutput = float4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -162,23 +224,19 @@ void RayGenerationShader()
         int2 translationDims = sqrt(rcGlobals.rayScalingFactor);
         int2 baseRayIndex = probeInfo3D.rayIndex * translationDims;
         
-        RayPayload rayPayloads[4];
-        
         // Pre-averaging is done by sampling all upper rays at once.
+        // Results are summed as each ray returns, so a single payload works for any ray scaling factor.
+        float4 summedRadiance = 0.0f;
         for (int i = 0; i < rcGlobals.rayScalingFactor; i++)
         {
             int2 rayIndexOffset = Translate1DTo2D(i, translationDims);
-            rayPayloads[i].probeIndex = probeInfo3D.probeIndex;
+            RayPayload payload = { probeInfo3D.probeIndex, float4(0.0f, 0.0f, 0.0f, 0.0f), cascadeIndex };
 
             // Scale with sqrtRayCount to get the correct ray index.
             ray.Direction = GetRCRayDir(baseRayIndex + rayIndexOffset, sqrtRayCount);
-            TraceRay(Scene, rayFlags, ~0, 0, 1, 0, ray, rayPayloads[i]);
-        }
-        
-        float4 summedRadiance = 0.0f;
-        for (int i = 0; i < rcGlobals.rayScalingFactor; i++)
-        {
-            summedRadiance += rayPayloads[i].result;
+            TraceRay(Scene, rayFlags, instanceMask, 0, 1, 0, ray, payload);
+            
+            summedRadiance += payload.result;
         }
         
         // Normalized sum.
@@ -186,10 +244,10 @@ void RayGenerationShader()
     }
     else
     {
-        RayPayload payload = { probeInfo3D.probeIndex, float4(0.0f, 0.0f, 0.0f, 0.0f) };
+        RayPayload payload = { probeInfo3D.probeIndex, float4(0.0f, 0.0f, 0.0f, 0.0f), cascadeIndex };
         
         ray.Direction = GetRCRayDir(probeInfo3D.rayIndex, sqrtRayCount);
-        TraceRay(Scene, rayFlags, ~0, 0, 1, 0, ray, payload);
+        TraceRay(Scene, rayFlags, instanceMask, 0, 1, 0, ray, payload);
         
         radianceOutput = payload.result;
     }
@@ -198,27 +256,45 @@ void RayGenerationShader()
     {
         // If gather rays are not full occluded, they will be used in cascade merging: write a flag telling next cascade that it should not ignore gathering.
         // Because the last cascade will not be included in the filtering step, the last upper cascade to be filtered should be the one before it.
-        if (radianceOutput.a > 0.0f && cascadeInfo.cascadeIndex < (rcGlobals.cascadeCount - 1))
+        if (radianceOutput.a > 0.0f && cascadeIndex < (rcGlobals.cascadeCount - 1))
         { 
             int2 translationDims = sqrt(rcGlobals.rayScalingFactor);
+            uint2 filterDimsN1 = GetCascadeDims(cascadeIndex + 1, rcGlobals);
             for (int i = 0; i < rcGlobals.rayScalingFactor; i++)
             {
                 int2 rayIndexOffset = Translate1DTo2D(i, translationDims);
                 
-                float2 cascadeN1SamplePos = GetCascadeN1SamplePosition(probeInfo3D, probeInfo3DN1, rayIndexOffset);
+                float2 cascadeN1SamplePos = GetCascadeN1SamplePosition(probeInfo3D, probeInfo3DN1, rayIndexOffset, rcGlobals.probeScalingFactor, translationDims.x);
                 
                 // Flag Bilinear sampling points that they will be used in merging.
                 for (int k = 0; k < 4; k++)
                 {
                     int2 sampleOffset = TranslateCoord4x1To2x2(k);
+                    int2 flagPos = floor(cascadeN1SamplePos) + sampleOffset;
                     
-                    gatherFilterTexN1[floor(cascadeN1SamplePos) + sampleOffset] = 1.0f;
+                    // Texture writes outside of the resource were dropped, bits have to be checked manually as they would otherwise wrap into the next row.
+                    if (!OUT_OF_BOUNDS(flagPos, int2(filterDimsN1)))
+                    {
+                        GatherFilterBit filterBitN1 = GetGatherFilterBit(flagPos, filterDimsN1.x);
+                        uint previousFilterWord = 0;
+                        gatherFilterBufferN1.InterlockedOr(filterBitN1.byteOffset, filterBitN1.mask, previousFilterWord);
+                        
+                        if (cascadeInfo.useActiveProbeDirectionLists && (previousFilterWord & filterBitN1.mask) == 0)
+                        {
+                            AppendActiveProbeDirection(cascadeIndex + 1, flagPos.y * filterDimsN1.x + flagPos.x);
+                        }
+                    }
                 }
             }
         }
     }
     
-    renderOutput[DispatchRaysIndex().xy] = radianceOutput;
+    renderOutput[probeInfo3D.texelPos] = radianceOutput;
+    
+    if (rcGlobals.useVisibilityPlane)
+    {
+        renderVisibility[probeInfo3D.texelPos] = radianceOutput.a;
+    }
 }
 
 [shader("anyhit")]
@@ -230,7 +306,7 @@ void AnyHitShader(inout RayPayload payload, in BuiltInTriangleIntersectionAttrib
 [shader("closesthit")]
 void ClosestHitShader(inout RayPayload payload, in BuiltInTriangleIntersectionAttributes attr)
 {
-    DrawCascadeRay(float3(1.0f, 0.0f, 0.0f), 0.5f, cascadeInfo.cascadeIndex, payload.probeIndex);
+    DrawCascadeRay(float3(1.0f, 0.0f, 0.0f), 0.5f, payload.cascadeIndex, payload.probeIndex);
     
     float3 barycentrics = GetBarycentrics(attr.barycentrics);
     
@@ -261,10 +337,10 @@ void ClosestHitShader(inout RayPayload payload, in BuiltInTriangleIntersectionAt
 [shader("miss")]
 void MissShader(inout RayPayload payload)
 {
-    //DrawCascadeRay(float3(0.0f, 1.0f, 0.0f), 0.0f, cascadeInfo.cascadeIndex, payload.probeIndex);
+    //DrawCascadeRay(float3(0.0f, 1.0f, 0.0f), 0.0f, payload.cascadeIndex, payload.probeIndex);
     
     float3 missColor = 0.0f;
-    if (cascadeInfo.cascadeIndex == (rcGlobals.cascadeCount - 1))
+    if (payload.cascadeIndex == (rcGlobals.cascadeCount - 1))
     {
         if(globalInfo.useSkybox)
         {
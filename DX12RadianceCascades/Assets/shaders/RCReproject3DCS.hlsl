@@ -0,0 +1,144 @@
+#include "RCCommon3D.hlsli"
+
+// Writes the intervals of a cascade that is not gathered this frame from the intervals it had last frame, see CPUReference/CascadeUpdateScheduler.h.
+// Every probe is moved to where it was on screen with globalInfo.prevViewProjMatrix and blends the four closest probes of the same direction there.
+// Taps whose depth last frame does not match the depth the probe reprojects to are rejected, so radiance does not bleed over depth edges
+// that the camera moved across. Probes that were off screen take the closest probe on the edge.
+
+// Stored before the merge of last frame. If the cascade atlas is used, both are atlases and the cascade is read and written at its atlas rect.
+Texture2D<float4> cascadeHistory : register(t0);
+RWTexture2D<float4> cascadeOutput : register(u0);
+
+// Depth of the current frame.
+Texture2D<float> depthBuffer : register(t1);
+
+// Only read and written if rcGlobals.useVisibilityPlane is set, the cascades then have no alpha channel.
+Texture2D<float> cascadeVisibilityHistory : register(t2);
+RWTexture2D<float> cascadeVisibilityOutput : register(u1);
+
+// Depth the history was gathered with.
+Texture2D<float> depthHistory : register(t3);
+
+ConstantBuffer<RCGlobals> rcGlobals : register(b0);
+ConstantBuffer<CascadeInfo> cascadeInfo : register(b1);
+ConstantBuffer<GlobalInfo> globalInfo : register(b2);
+
+// Largest difference of the view depths of a tap and the reprojected probe, relative to the view depth of the probe.
+static const float DepthRejectionTolerance = 0.1f;
+// Projections do not round trip exactly. Probes that land this close to a history probe read only it, otherwise a camera that does not
+// move would blur the history a little more every frame.
+static const float ProbeSnapDistance = 1e-3f;
+
+float4 LoadHistory(int2 texelPos)
+{
+    int2 historyTexelPos = GetCascadeTexelPos(texelPos, cascadeInfo.cascadeIndex, rcGlobals);
+
+    float4 radiance = cascadeHistory.Load(int3(historyTexelPos, 0));
+    if (rcGlobals.useVisibilityPlane)
+    {
+        radiance.a = cascadeVisibilityHistory.Load(int3(historyTexelPos, 0));
+    }
+
+    return radiance;
+}
+
+// The lens is assumed to be the same as last frame.
+float ViewDepthFromDepth(float depthVal)
+{
+    float4 viewPos = mul(float4(0.0f, 0.0f, depthVal, 1.0f), globalInfo.invProjMatrix);
+    return -viewPos.z / viewPos.w;
+}
+
+// Relative difference of the view depths, infinite if only one of them is on the far plane. Sky probes match sky taps.
+float GetTapDepthDifference(float expectedViewDepth, bool isSky, float tapDepth)
+{
+    if (isSky || IsZero(tapDepth))
+    {
+        return isSky == IsZero(tapDepth) ? 0.0f : FLT_MAX;
+    }
+
+    return abs(ViewDepthFromDepth(tapDepth) - expectedViewDepth) / expectedViewDepth;
+}
+
+[numthreads(8, 8, 1)]
+void main( uint3 DTid : SV_DispatchThreadID )
+{
+    uint2 pixelPos = DTid.xy;
+
+    if (OUT_OF_BOUNDS(pixelPos, GetCascadeDims(cascadeInfo.cascadeIndex, rcGlobals)))
+    {
+        return;
+    }
+
+    ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(pixelPos, cascadeInfo.cascadeIndex, rcGlobals);
+
+    uint2 depthDims;
+    GetDims(depthBuffer, depthDims);
+
+    DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+    uint2 samplePos = GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depthDims);
+
+    // Probes on the far plane are reprojected as directions, so only the rotation of the camera moves them.
+    float4 probeWorldPos = float4(GetProbeWorldPos(probeInfo3D, depthBuffer, globalInfo.invProjMatrix, globalInfo.invViewMatrix), 1.0f);
+    bool isSky = IsZero(depthBuffer.Load(int3(samplePos, 0)));
+    if (isSky)
+    {
+        float2 uv = (float2(samplePos) + 0.5f) / depthDims;
+        float3 nearPlanePos = WorldPosFromDepth(1.0f, uv, globalInfo.invProjMatrix, globalInfo.invViewMatrix);
+        probeWorldPos = float4(nearPlanePos - globalInfo.cameraPos, 0.0f);
+    }
+
+    float2 prevProbeIndex = probeInfo3D.probeIndex;
+    float4 prevClipPos = mul(probeWorldPos, globalInfo.prevViewProjMatrix);
+    if (prevClipPos.w > 0.0f)
+    {
+        float2 prevUV = prevClipPos.xy / prevClipPos.w * float2(0.5f, -0.5f) + 0.5f;
+        prevProbeIndex = GetTileProbeIndex(depthTile, prevUV, depthDims);
+    }
+
+    prevProbeIndex = clamp(prevProbeIndex, 0.0f, float2(probeInfo3D.probesPerDim - 1));
+    float2 closestProbeIndex = round(prevProbeIndex);
+    prevProbeIndex.x = abs(prevProbeIndex.x - closestProbeIndex.x) < ProbeSnapDistance ? closestProbeIndex.x : prevProbeIndex.x;
+    prevProbeIndex.y = abs(prevProbeIndex.y - closestProbeIndex.y) < ProbeSnapDistance ? closestProbeIndex.y : prevProbeIndex.y;
+
+    int2 baseProbeIndex = int2(floor(prevProbeIndex));
+    int2 directionOffset = probeInfo3D.rayIndex * probeInfo3D.probesPerDim;
+
+    // View depth of the probe in the history, w is the view depth for a perspective projection.
+    float expectedViewDepth = prevClipPos.w;
+
+    // Samples stay inside the direction group of the texel. Each tap is a probe of the history and has its depth there.
+    float4 bilinearWeights = GetBilinearSampleWeights(frac(prevProbeIndex));
+    float4 radiance = 0.0f;
+    float weightSum = 0.0f;
+    float4 closestSample = 0.0f;
+    float closestDepthDifference = FLT_MAX;
+    for (int i = 0; i < 4; i++)
+    {
+        int2 sampleProbeIndex = min(baseProbeIndex + TranslateCoord4x1To2x2(i), probeInfo3D.probesPerDim - 1);
+        float4 historySample = LoadHistory(directionOffset + sampleProbeIndex);
+
+        uint2 tapSamplePos = GetDepthSamplePos(depthTile, sampleProbeIndex, depthDims);
+        float depthDifference = GetTapDepthDifference(expectedViewDepth, isSky, depthHistory.Load(int3(tapSamplePos, 0)));
+        if (depthDifference <= DepthRejectionTolerance)
+        {
+            radiance += historySample * bilinearWeights[i];
+            weightSum += bilinearWeights[i];
+        }
+
+        if (i == 0 || depthDifference < closestDepthDifference)
+        {
+            closestSample = historySample;
+            closestDepthDifference = depthDifference;
+        }
+    }
+
+    // Every tap is rejected where the probe was disoccluded, the surface closest in depth is the best guess left.
+    radiance = weightSum > 0.0f ? radiance / weightSum : closestSample;
+
+    cascadeOutput[probeInfo3D.texelPos] = radiance;
+    if (rcGlobals.useVisibilityPlane)
+    {
+        cascadeVisibilityOutput[probeInfo3D.texelPos] = radiance.a;
+    }
+}
@@ -0,0 +1,77 @@
+#include "BLASBuildPlan.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace CPUReference
+{
+	BLASBuildPlan PlanBLASBuilds(const std::vector<BLASPrebuildSizes>& sizes, const BLASBuildPlanDesc& desc)
+	{
+		BLASBuildPlan plan;
+		plan.entries.resize(sizes.size());
+
+		uint64_t batchScratchBytes = 0u;
+		for (size_t i = 0; i < sizes.size(); i++)
+		{
+			const uint64_t scratchBytes = AlignAccelerationStructureBytes(sizes[i].scratchBytes);
+
+			const bool isBatchEmpty = batchScratchBytes == 0u;
+			if (plan.batchCount == 0u || (desc.maxScratchBytes > 0u && !isBatchEmpty && batchScratchBytes + scratchBytes > desc.maxScratchBytes))
+			{
+				plan.batchCount++;
+				batchScratchBytes = 0u;
+			}
+
+			BLASBuildEntry& entry = plan.entries[i];
+			entry.batchIndex = plan.batchCount - 1u;
+			entry.scratchOffset = batchScratchBytes;
+			entry.resultOffset = plan.resultBytes;
+
+			batchScratchBytes += scratchBytes;
+			plan.scratchBytes = (std::max)(plan.scratchBytes, batchScratchBytes);
+			plan.resultBytes += AlignAccelerationStructureBytes(sizes[i].resultBytes);
+		}
+
+		return plan;
+	}
+
+	BLASPoolPlan PackBLASPool(const std::vector<uint64_t>& compactedBytes, const BLASPoolDesc& desc)
+	{
+		BLASPoolPlan plan;
+		plan.entries.resize(compactedBytes.size());
+
+		std::vector<uint32_t> order(compactedBytes.size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return compactedBytes[a] > compactedBytes[b]; });
+
+		const uint64_t pageBytes = AlignAccelerationStructureBytes((std::max)(desc.pageBytes, AccelerationStructureAlignment));
+
+		// Pages are filled from the start, so the used bytes are also where the next BLAS goes.
+		std::vector<uint64_t>& usedBytes = plan.pageBytes;
+		std::vector<uint64_t> capacities;
+		for (uint32_t blasIndex : order)
+		{
+			const uint64_t byteCount = AlignAccelerationStructureBytes(compactedBytes[blasIndex]);
+
+			uint32_t pageIndex = 0u;
+			for (; pageIndex < (uint32_t)usedBytes.size(); pageIndex++)
+			{
+				if (usedBytes[pageIndex] + byteCount <= capacities[pageIndex])
+				{
+					break;
+				}
+			}
+
+			if (pageIndex == (uint32_t)usedBytes.size())
+			{
+				usedBytes.push_back(0u);
+				capacities.push_back((std::max)(pageBytes, byteCount));
+			}
+
+			plan.entries[blasIndex] = { pageIndex, usedBytes[pageIndex] };
+			usedBytes[pageIndex] += byteCount;
+		}
+
+		return plan;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// Planning of batched BLAS builds, see BLASPool in RaytracingBuffers.h. Every pending BLAS is built in one command list with its
+// own range of one pooled scratch buffer, so builds in the same batch run without barriers between them. If the scratch of every
+// BLAS does not fit in the budget, they are split into batches that reuse the same scratch one after another. Uncompacted results
+// all live in one buffer until their compacted sizes are known, then they are copied compacted into pages of a pool and both the
+// uncompacted results and the scratch are released.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Same as D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, which is checked where the plans are used.
+	// Results, scratch and compacted copies all have to start on it.
+	constexpr uint64_t AccelerationStructureAlignment = 256u;
+
+	inline uint64_t AlignAccelerationStructureBytes(uint64_t byteCount)
+	{
+		return (byteCount + AccelerationStructureAlignment - 1u) & ~(AccelerationStructureAlignment - 1u);
+	}
+
+	// D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO of one BLAS.
+	struct BLASPrebuildSizes
+	{
+		uint64_t resultBytes = 0u;
+		uint64_t scratchBytes = 0u;
+	};
+
+	struct BLASBuildPlanDesc
+	{
+		// Budget of the pooled scratch, 0 builds everything in one batch. A BLAS that needs more on its own still gets built, in a batch of its own.
+		uint64_t maxScratchBytes = 0u;
+	};
+
+	struct BLASBuildEntry
+	{
+		uint32_t batchIndex = 0u;
+		uint64_t scratchOffset = 0u;
+		uint64_t resultOffset = 0u;
+	};
+
+	struct BLASBuildPlan
+	{
+		// One per BLAS, in the order they were passed in.
+		std::vector<BLASBuildEntry> entries;
+		uint32_t batchCount = 0u;
+		// Size of the pooled scratch, the largest batch.
+		uint64_t scratchBytes = 0u;
+		// Size of the buffer holding every uncompacted result.
+		uint64_t resultBytes = 0u;
+	};
+
+	// BLASes are put into batches in order, a batch is closed once the next one does not fit in the scratch budget.
+	BLASBuildPlan PlanBLASBuilds(const std::vector<BLASPrebuildSizes>& sizes, const BLASBuildPlanDesc& desc);
+
+	struct BLASPoolDesc
+	{
+		// Compacted BLASes are packed into pages of this size. BLASes larger than a page get a page of their own that fits them exactly.
+		uint64_t pageBytes = 16ull * 1024ull * 1024ull;
+	};
+
+	struct BLASPoolEntry
+	{
+		uint32_t pageIndex = 0u;
+		uint64_t offset = 0u;
+	};
+
+	struct BLASPoolPlan
+	{
+		// One per BLAS, in the order they were passed in.
+		std::vector<BLASPoolEntry> entries;
+		// Bytes of every page, trimmed to what is used.
+		std::vector<uint64_t> pageBytes;
+	};
+
+	// First fit decreasing, largest BLAS first into the first page it fits in.
+	BLASPoolPlan PackBLASPool(const std::vector<uint64_t>& compactedBytes, const BLASPoolDesc& desc);
+
+	// Memory of one BLAS before and after compaction. Before, every BLAS kept its uncompacted result and its own scratch.
+	struct BLASMemoryReport
+	{
+		uint64_t uncompactedBytes = 0u;
+		uint64_t scratchBytes = 0u;
+		uint64_t compactedBytes = 0u;
+
+		uint64_t GetSavedBytes() const { return uncompactedBytes + scratchBytes - compactedBytes; }
+	};
+}
@@ -0,0 +1,285 @@
+#include "BilateralUpsample.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPUREF_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CPUREF_USE_SSE2 0
+#endif
+
+namespace CPUReference
+{
+	namespace
+	{
+		// Below this the depth and normal terms are taken to have rejected every probe.
+		constexpr float MinWeightSum = 1.0e-4f;
+
+		// View depth and normal at the depth texel of every probe, one array per component so that 4 probes load into one register each.
+		struct ProbeGuide
+		{
+			uint32_t probeCountX = 0u;
+			uint32_t probeCountY = 0u;
+			// Infinite for probes on the sky, which gives them a depth weight of 0.
+			std::vector<float> viewDepths;
+			std::vector<float> normalsX;
+			std::vector<float> normalsY;
+			std::vector<float> normalsZ;
+		};
+
+		// The 2x2 probes around a pixel in the order of TranslateCoord4x1To2x2(), with their bilinear weights.
+		struct PixelTaps
+		{
+			uint32_t probeIndices[4];
+			float bilinearWeights[4];
+		};
+
+		int2 GetProbeOffset(const ProbePlacement& placement)
+		{
+			const int32_t halfSpacing = (int32_t)(placement.probeSpacing / 2u);
+			return int2(placement.tileOrigin.x + halfSpacing, placement.tileOrigin.y + halfSpacing);
+		}
+
+		ProbeGuide BuildProbeGuide(const ProbePlacement& placement, uint32_t probeCountX, uint32_t probeCountY, const DepthTexture& depth, const NormalTexture& normals, const ReferenceCamera& camera)
+		{
+			ProbeGuide guide;
+			guide.probeCountX = probeCountX;
+			guide.probeCountY = probeCountY;
+
+			const size_t probeCount = size_t(probeCountX) * probeCountY;
+			guide.viewDepths.resize(probeCount);
+			guide.normalsX.resize(probeCount);
+			guide.normalsY.resize(probeCount);
+			guide.normalsZ.resize(probeCount);
+
+			const int2 offset = GetProbeOffset(placement);
+			const int32_t spacing = (int32_t)placement.probeSpacing;
+			for (uint32_t y = 0; y < probeCountY; y++)
+			{
+				for (uint32_t x = 0; x < probeCountX; x++)
+				{
+					// Same clamp as GetDepthSamplePos().
+					const uint32_t sampleX = (uint32_t)std::clamp(offset.x + spacing * (int32_t)x, 0, (int32_t)depth.GetWidth() - 1);
+					const uint32_t sampleY = (uint32_t)std::clamp(offset.y + spacing * (int32_t)y, 0, (int32_t)depth.GetHeight() - 1);
+
+					const float sampleDepth = depth.At(sampleX, sampleY);
+					const float3& sampleNormal = normals.At(sampleX, sampleY);
+
+					const size_t probeIndex = size_t(y) * probeCountX + x;
+					guide.viewDepths[probeIndex] = sampleDepth > 0.0f ? camera.ViewDepthFromDepth(sampleDepth) : std::numeric_limits<float>::infinity();
+					guide.normalsX[probeIndex] = sampleNormal.x;
+					guide.normalsY[probeIndex] = sampleNormal.y;
+					guide.normalsZ[probeIndex] = sampleNormal.z;
+				}
+			}
+
+			return guide;
+		}
+
+		PixelTaps GetPixelTaps(uint32_t x, uint32_t y, const int2& offset, float invSpacing, uint32_t probeCountX, uint32_t probeCountY)
+		{
+			// Probe i sits on the center of depth texel offset + i * spacing.
+			const float probeX = float((int32_t)x - offset.x) * invSpacing;
+			const float probeY = float((int32_t)y - offset.y) * invSpacing;
+			const float floorX = std::floor(probeX);
+			const float floorY = std::floor(probeY);
+			const float ratioX = probeX - floorX;
+			const float ratioY = probeY - floorY;
+
+			const uint32_t x0 = (uint32_t)std::clamp((int32_t)floorX, 0, (int32_t)probeCountX - 1);
+			const uint32_t x1 = (uint32_t)std::clamp((int32_t)floorX + 1, 0, (int32_t)probeCountX - 1);
+			const uint32_t y0 = (uint32_t)std::clamp((int32_t)floorY, 0, (int32_t)probeCountY - 1);
+			const uint32_t y1 = (uint32_t)std::clamp((int32_t)floorY + 1, 0, (int32_t)probeCountY - 1);
+
+			PixelTaps taps;
+			taps.probeIndices[0] = y0 * probeCountX + x0;
+			taps.probeIndices[1] = y0 * probeCountX + x1;
+			taps.probeIndices[2] = y1 * probeCountX + x0;
+			taps.probeIndices[3] = y1 * probeCountX + x1;
+			taps.bilinearWeights[0] = (1.0f - ratioX) * (1.0f - ratioY);
+			taps.bilinearWeights[1] = ratioX * (1.0f - ratioY);
+			taps.bilinearWeights[2] = (1.0f - ratioX) * ratioY;
+			taps.bilinearWeights[3] = ratioX * ratioY;
+			return taps;
+		}
+
+		float4 BlendTaps(const float4* probeRadiance, const PixelTaps& taps, const float weights[4])
+		{
+			float4 radiance = probeRadiance[taps.probeIndices[0]] * weights[0];
+			radiance += probeRadiance[taps.probeIndices[1]] * weights[1];
+			radiance += probeRadiance[taps.probeIndices[2]] * weights[2];
+			radiance += probeRadiance[taps.probeIndices[3]] * weights[3];
+			return radiance;
+		}
+
+		// Bilateral weights of the 4 probes of a pixel, and the depth term alone for the fallback.
+		void GetBilateralWeightsScalar(const ProbeGuide& guide, const PixelTaps& taps, float pixelViewDepth, const float3& pixelNormal, float depthScale, uint32_t normalPower,
+			float weightsOut[4], float depthWeightsOut[4])
+		{
+			for (uint32_t i = 0; i < 4u; i++)
+			{
+				const uint32_t probeIndex = taps.probeIndices[i];
+
+				const float depthDifference = std::abs(pixelViewDepth - guide.viewDepths[probeIndex]) * depthScale;
+				const float depthWeight = 1.0f / (1.0f + depthDifference * depthDifference);
+
+				float cosine = (pixelNormal.x * guide.normalsX[probeIndex] + pixelNormal.y * guide.normalsY[probeIndex]) + pixelNormal.z * guide.normalsZ[probeIndex];
+				cosine = (std::min)((std::max)(cosine, 0.0f), 1.0f);
+
+				float normalWeight = 1.0f;
+				for (uint32_t p = 0; p < normalPower; p++)
+				{
+					normalWeight *= cosine;
+				}
+
+				weightsOut[i] = (taps.bilinearWeights[i] * depthWeight) * normalWeight;
+				depthWeightsOut[i] = depthWeight;
+			}
+		}
+
+#if CPUREF_USE_SSE2
+		__m128 GatherProbes(const std::vector<float>& values, const PixelTaps& taps)
+		{
+			return _mm_setr_ps(values[taps.probeIndices[0]], values[taps.probeIndices[1]], values[taps.probeIndices[2]], values[taps.probeIndices[3]]);
+		}
+
+		// Same operations in the same order as GetBilateralWeightsScalar(), one probe per lane.
+		void GetBilateralWeightsSSE2(const ProbeGuide& guide, const PixelTaps& taps, float pixelViewDepth, const float3& pixelNormal, float depthScale, uint32_t normalPower,
+			float weightsOut[4], float depthWeightsOut[4])
+		{
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(INT32_MAX));
+
+			const __m128 depthDifference = _mm_mul_ps(_mm_and_ps(_mm_sub_ps(_mm_set1_ps(pixelViewDepth), GatherProbes(guide.viewDepths, taps)), absMask), _mm_set1_ps(depthScale));
+			const __m128 depthWeight = _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(depthDifference, depthDifference)));
+
+			__m128 cosine = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pixelNormal.x), GatherProbes(guide.normalsX, taps)), _mm_mul_ps(_mm_set1_ps(pixelNormal.y), GatherProbes(guide.normalsY, taps))),
+				_mm_mul_ps(_mm_set1_ps(pixelNormal.z), GatherProbes(guide.normalsZ, taps)));
+			cosine = _mm_min_ps(_mm_max_ps(cosine, _mm_setzero_ps()), one);
+
+			__m128 normalWeight = one;
+			for (uint32_t p = 0; p < normalPower; p++)
+			{
+				normalWeight = _mm_mul_ps(normalWeight, cosine);
+			}
+
+			_mm_storeu_ps(weightsOut, _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(taps.bilinearWeights), depthWeight), normalWeight));
+			_mm_storeu_ps(depthWeightsOut, depthWeight);
+		}
+#endif
+
+		template<bool UseSSE2>
+		void BilateralUpsampleImpl(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, const NormalTexture& normals,
+			const ReferenceCamera& camera, const BilateralUpsampleDesc& desc, TaskPool& taskPool, RadianceTexture& output)
+		{
+			const uint32_t width = depth.GetWidth();
+			const uint32_t height = depth.GetHeight();
+			if (output.GetWidth() != width || output.GetHeight() != height)
+			{
+				output.Create(width, height);
+			}
+
+			const uint32_t probeCountX = probeRadiance.GetWidth();
+			const uint32_t probeCountY = probeRadiance.GetHeight();
+			const ProbeGuide guide = BuildProbeGuide(placement, probeCountX, probeCountY, depth, normals, camera);
+
+			const int2 offset = GetProbeOffset(placement);
+			const float invSpacing = 1.0f / (float)placement.probeSpacing;
+			const float4* radiance = probeRadiance.GetData();
+
+			// One task per row, same as the software render passes.
+			taskPool.ParallelFor(height, [&](uint32_t y)
+				{
+					for (uint32_t x = 0; x < width; x++)
+					{
+						const float pixelDepth = depth.At(x, y);
+						if (pixelDepth <= 0.0f)
+						{
+							output.At(x, y) = float4(0.0f, 0.0f, 0.0f, 0.0f);
+							continue;
+						}
+
+						const float pixelViewDepth = camera.ViewDepthFromDepth(pixelDepth);
+						const float depthScale = 1.0f / (desc.depthTolerance * pixelViewDepth);
+						const PixelTaps taps = GetPixelTaps(x, y, offset, invSpacing, probeCountX, probeCountY);
+
+						float weights[4];
+						float depthWeights[4];
+#if CPUREF_USE_SSE2
+						if constexpr (UseSSE2)
+						{
+							GetBilateralWeightsSSE2(guide, taps, pixelViewDepth, normals.At(x, y), depthScale, desc.normalPower, weights, depthWeights);
+						}
+						else
+#endif
+						{
+							GetBilateralWeightsScalar(guide, taps, pixelViewDepth, normals.At(x, y), depthScale, desc.normalPower, weights, depthWeights);
+						}
+
+						const float weightSum = ((weights[0] + weights[1]) + weights[2]) + weights[3];
+						if (weightSum > MinWeightSum)
+						{
+							output.At(x, y) = BlendTaps(radiance, taps, weights) / weightSum;
+							continue;
+						}
+
+						const uint32_t closestTap = uint32_t(std::max_element(depthWeights, depthWeights + 4) - depthWeights);
+						if (depthWeights[closestTap] > 0.0f)
+						{
+							output.At(x, y) = radiance[taps.probeIndices[closestTap]];
+						}
+						else
+						{
+							output.At(x, y) = BlendTaps(radiance, taps, taps.bilinearWeights);
+						}
+					}
+				});
+		}
+	}
+
+	void BilinearUpsample(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, TaskPool& taskPool, RadianceTexture& output)
+	{
+		const uint32_t width = depth.GetWidth();
+		const uint32_t height = depth.GetHeight();
+		if (output.GetWidth() != width || output.GetHeight() != height)
+		{
+			output.Create(width, height);
+		}
+
+		const int2 offset = GetProbeOffset(placement);
+		const float invSpacing = 1.0f / (float)placement.probeSpacing;
+		const float4* radiance = probeRadiance.GetData();
+
+		taskPool.ParallelFor(height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					if (depth.At(x, y) <= 0.0f)
+					{
+						output.At(x, y) = float4(0.0f, 0.0f, 0.0f, 0.0f);
+						continue;
+					}
+
+					const PixelTaps taps = GetPixelTaps(x, y, offset, invSpacing, probeRadiance.GetWidth(), probeRadiance.GetHeight());
+					output.At(x, y) = BlendTaps(radiance, taps, taps.bilinearWeights);
+				}
+			});
+	}
+
+	void BilateralUpsample(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, const NormalTexture& normals,
+		const ReferenceCamera& camera, const BilateralUpsampleDesc& desc, TaskPool& taskPool, RadianceTexture& output)
+	{
+		BilateralUpsampleImpl<CPUREF_USE_SSE2 != 0>(probeRadiance, placement, depth, normals, camera, desc, taskPool, output);
+	}
+
+	void BilateralUpsampleScalar(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, const NormalTexture& normals,
+		const ReferenceCamera& camera, const BilateralUpsampleDesc& desc, TaskPool& taskPool, RadianceTexture& output)
+	{
+		BilateralUpsampleImpl<false>(probeRadiance, placement, depth, normals, camera, desc, taskPool, output);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Joint bilateral upsampling of the coalesced result, which has one texel per cascade 0 probe, to the resolution of the depth buffer.
+// Every pixel blends the 2x2 probes around it with their bilinear weights, scaled by how close the view depth and normal at the depth
+// texel each probe was placed on are to those of the pixel. Light then does not bleed across depth and normal edges, which is what
+// keeps a probe spacing above 1 close to one probe per pixel.
+
+#include "ReferenceScene.h"
+#include "ReferenceTexture.h"
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	struct BilateralUpsampleDesc
+	{
+		// View depth difference, relative to the view depth of the pixel, at which a probe keeps half its weight.
+		float depthTolerance = 0.05f;
+		// Exponent of the clamped cosine between the normals of the pixel and the probe.
+		uint32_t normalPower = 8u;
+	};
+
+	// Where the probes of cascade 0 sample the depth buffer, same as GetDepthTile() in RCCommon3D.hlsli.
+	struct ProbePlacement
+	{
+		uint32_t probeSpacing = 1u;
+		int2 tileOrigin = int2(0, 0);
+	};
+
+	// Same weights as sampling the coalesced result with a linear sampler between the probe positions. Sky pixels are written as zero.
+	void BilinearUpsample(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, TaskPool& taskPool, RadianceTexture& output);
+
+	// SSE2 if available, computing the weights of the 4 probes of a pixel at once. Results are identical to BilateralUpsampleScalar().
+	// Falls back to the probe with the closest depth if the depth and normal terms reject all 4, and to bilinear weights if all 4 are sky.
+	// Sky pixels are written as zero. The output takes the size of the depth buffer.
+	void BilateralUpsample(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, const NormalTexture& normals,
+		const ReferenceCamera& camera, const BilateralUpsampleDesc& desc, TaskPool& taskPool, RadianceTexture& output);
+	void BilateralUpsampleScalar(const RadianceTexture& probeRadiance, const ProbePlacement& placement, const DepthTexture& depth, const NormalTexture& normals,
+		const ReferenceCamera& camera, const BilateralUpsampleDesc& desc, TaskPool& taskPool, RadianceTexture& output);
+}
@@ -0,0 +1,148 @@
+#include "CascadeAtlasLayout.h"
+#include "CascadeLayout.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace CPUReference
+{
+	namespace
+	{
+		bool IsOverlapping(const CascadeAtlasRect& a, const CascadeAtlasRect& b)
+		{
+			return a.offsetX < b.offsetX + b.width && b.offsetX < a.offsetX + a.width &&
+				a.offsetY < b.offsetY + b.height && b.offsetY < a.offsetY + a.height;
+		}
+	}
+
+	bool CascadeAtlasLayout::Generate(const std::vector<CascadeExtent>& cascadeExtents, uint32_t maxDimension /*= MaxCascadeAtlasDimension*/)
+	{
+		m_rects.clear();
+		m_width = 0u;
+		m_height = 0u;
+
+		std::vector<CascadeAtlasRect> rects;
+		rects.reserve(cascadeExtents.size());
+
+		uint32_t atlasWidth = 0u;
+		uint32_t atlasHeight = 0u;
+
+		uint32_t columnX = 0u;
+		uint32_t columnY = 0u;
+		uint32_t columnWidth = 0u;
+		for (const CascadeExtent& extent : cascadeExtents)
+		{
+			if (extent.width > maxDimension || extent.height > maxDimension)
+			{
+				return false;
+			}
+
+			// Start a new column if the cascade does not fit below the previous one.
+			if (columnY + extent.height > maxDimension)
+			{
+				columnX += columnWidth;
+				columnY = 0u;
+				columnWidth = 0u;
+			}
+
+			rects.push_back({ columnX, columnY, extent.width, extent.height });
+
+			columnY += extent.height;
+			columnWidth = (std::max)(columnWidth, extent.width);
+
+			atlasWidth = (std::max)(atlasWidth, columnX + columnWidth);
+			atlasHeight = (std::max)(atlasHeight, columnY);
+
+			if (atlasWidth > maxDimension)
+			{
+				return false;
+			}
+		}
+
+		m_rects = std::move(rects);
+		m_width = atlasWidth;
+		m_height = atlasHeight;
+
+		return true;
+	}
+
+	bool CascadeAtlasLayout::Generate(const CascadeLayout& cascadeLayout, uint32_t maxDimension /*= MaxCascadeAtlasDimension*/)
+	{
+		std::vector<CascadeExtent> cascadeExtents(cascadeLayout.GetCascadeCount());
+		for (uint32_t i = 0; i < cascadeLayout.GetCascadeCount(); i++)
+		{
+			const CascadeLevel& level = cascadeLayout.GetLevel(i);
+			cascadeExtents[i] = { level.textureWidth, level.textureHeight };
+		}
+
+		return Generate(cascadeExtents, maxDimension);
+	}
+
+	bool CascadeAtlasLayout::Validate() const
+	{
+		uint32_t maxRight = 0u;
+		uint32_t maxBottom = 0u;
+
+		uint32_t columnX = 0u;
+		uint32_t columnWidth = 0u;
+		uint32_t nextY = 0u;
+		for (uint32_t i = 0; i < GetCascadeCount(); i++)
+		{
+			const CascadeAtlasRect& rect = m_rects[i];
+
+			if (rect.offsetX + rect.width > m_width || rect.offsetY + rect.height > m_height)
+			{
+				return false;
+			}
+
+			for (uint32_t k = 0; k < i; k++)
+			{
+				if (IsOverlapping(rect, m_rects[k]))
+				{
+					return false;
+				}
+			}
+
+			// A cascade either continues the current column right below the previous one or starts the next column at the top.
+			const bool continuesColumn = i > 0 && rect.offsetX == columnX && rect.offsetY == nextY;
+			const bool startsColumn = rect.offsetY == 0u && rect.offsetX == columnX + columnWidth;
+			if (!continuesColumn && !startsColumn)
+			{
+				return false;
+			}
+
+			if (startsColumn && !continuesColumn)
+			{
+				columnX = rect.offsetX;
+				columnWidth = 0u;
+			}
+
+			columnWidth = (std::max)(columnWidth, rect.width);
+			nextY = rect.offsetY + rect.height;
+
+			maxRight = (std::max)(maxRight, rect.offsetX + rect.width);
+			maxBottom = (std::max)(maxBottom, rect.offsetY + rect.height);
+		}
+
+		// The atlas itself should be no larger than what the cascades need.
+		return maxRight == m_width && maxBottom == m_height;
+	}
+
+	const CascadeAtlasRect& CascadeAtlasLayout::GetRect(uint32_t cascadeIndex) const
+	{
+		assert(cascadeIndex < GetCascadeCount());
+		return m_rects[cascadeIndex];
+	}
+
+	uint64_t CascadeAtlasLayout::GetUnusedTexelCount() const
+	{
+		uint64_t usedTexelCount = 0u;
+		for (const CascadeAtlasRect& rect : m_rects)
+		{
+			usedTexelCount += uint64_t(rect.width) * rect.height;
+		}
+
+		return uint64_t(m_width) * m_height - usedTexelCount;
+	}
+}
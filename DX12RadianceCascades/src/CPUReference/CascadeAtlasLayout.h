@@ -0,0 +1,59 @@
+#pragma once
+
+// Packing of every cascade interval into a single texture, shared by RadianceCascadeManager3D and the CPU reference.
+// The resulting rects are uploaded as the cascade atlas table of RCGlobals.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	class CascadeLayout;
+
+	// Largest texture dimension allowed by D3D12 (D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION).
+	constexpr uint32_t MaxCascadeAtlasDimension = 16384u;
+
+	struct CascadeExtent
+	{
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+	};
+
+	struct CascadeAtlasRect
+	{
+		uint32_t offsetX = 0u;
+		uint32_t offsetY = 0u;
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+	};
+
+	// Cascades are stacked top to bottom in cascade order. When the next cascade would not fit below the previous one,
+	// a new column is started directly to the right of the widest cascade in the current column.
+	class CascadeAtlasLayout
+	{
+	public:
+		CascadeAtlasLayout() = default;
+
+		// Returns false and leaves the layout empty if the cascades do not fit inside maxDimension x maxDimension.
+		bool Generate(const std::vector<CascadeExtent>& cascadeExtents, uint32_t maxDimension = MaxCascadeAtlasDimension);
+		bool Generate(const CascadeLayout& cascadeLayout, uint32_t maxDimension = MaxCascadeAtlasDimension);
+
+		// Checks that every rect is inside the atlas, that no two rects overlap and that there are no gaps between
+		// consecutive cascades of a column or between consecutive columns.
+		bool Validate() const;
+
+		const CascadeAtlasRect& GetRect(uint32_t cascadeIndex) const;
+		uint32_t GetCascadeCount() const { return (uint32_t)m_rects.size(); }
+		uint32_t GetWidth() const { return m_width; }
+		uint32_t GetHeight() const { return m_height; }
+		bool IsEmpty() const { return m_rects.empty(); }
+
+		// Texels of the atlas not covered by any cascade, caused by cascades of different sizes sharing a column.
+		uint64_t GetUnusedTexelCount() const;
+
+	private:
+		std::vector<CascadeAtlasRect> m_rects;
+		uint32_t m_width = 0u;
+		uint32_t m_height = 0u;
+	};
+}
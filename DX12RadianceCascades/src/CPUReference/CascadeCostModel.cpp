@@ -0,0 +1,235 @@
+#include "CascadeCostModel.h"
+#include "CascadeAtlasLayout.h"
+#include "GatherFilterBits.h"
+#include "ScalingPermutations.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace CPUReference
+{
+	namespace
+	{
+		// Sizes of the resources Generate() allocates next to the cascades.
+		constexpr uint64_t MaxCascadeCount = 10u; // RC_MAX_CASCADE_COUNT
+		constexpr uint64_t DispatchRaysDescBytes = 104u; // sizeof(D3D12_DISPATCH_RAYS_DESC)
+		constexpr uint64_t MergeWeightBytes = 16u; // One float4 per probe.
+		constexpr uint64_t CoalescedTexelBytes = 8u; // R16G16B16A16_FLOAT
+		constexpr uint64_t ReadbackSlotCount = 4u; // ReadbackRingBuffer::DefaultSlotCount
+		constexpr uint64_t ReadbackSlotAlignment = 512u; // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+
+		uint64_t AlignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1u) / alignment * alignment;
+		}
+	}
+
+	CascadeCost ComputeCascadeCost(const CascadeCostDesc& desc)
+	{
+		CascadeCost cost;
+
+		CascadeLayout layout;
+		layout.Generate(desc.layout);
+
+		const uint32_t cascadeCount = layout.GetCascadeCount();
+		const uint64_t texelBytes = GetIntervalTexelBytes(desc.intervalFormat);
+		const uint64_t raysPerTexel = desc.layout.isUsingPreAveragedIntervals ? desc.layout.rayScalingFactor : 1u;
+
+		CascadeAtlasLayout atlasLayout;
+		const bool useCascadeAtlas = desc.useCascadeAtlas && atlasLayout.Generate(layout);
+		cost.isAtlasFallback = desc.useCascadeAtlas && !useCascadeAtlas;
+
+		const bool hasHistory = desc.useStaggeredUpdates && cascadeCount > 1u;
+
+		cost.levels.resize(cascadeCount);
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			CascadeLevelCost& levelCost = cost.levels[i];
+			levelCost.level = layout.GetLevel(i);
+			levelCost.texelCount = uint64_t(levelCost.level.textureWidth) * levelCost.level.textureHeight;
+			levelCost.tracedRays = levelCost.texelCount * raysPerTexel;
+			levelCost.intervalBytes = levelCost.texelCount * texelBytes;
+
+			if (i > 0u)
+			{
+				levelCost.gatherFilterBytes = uint64_t(GetGatherFilterWordCount(levelCost.level.textureWidth, levelCost.level.textureHeight)) * sizeof(uint32_t);
+				levelCost.historyBytes = hasHistory ? levelCost.intervalBytes : 0u;
+				levelCost.mergeReadTexels = cost.levels[i - 1].texelCount * desc.layout.rayScalingFactor * 4u;
+				levelCost.mergeReadBytes = levelCost.mergeReadTexels * texelBytes;
+			}
+
+			cost.tracedRays += levelCost.tracedRays;
+			cost.texelCount += levelCost.texelCount;
+			cost.gatherFilterBytes += levelCost.gatherFilterBytes;
+			cost.historyBytes += levelCost.historyBytes;
+			cost.mergeReadBytes += levelCost.mergeReadBytes;
+
+			if (i + 1u < cascadeCount)
+			{
+				cost.mergeWeightBytes += uint64_t(levelCost.level.probesX) * levelCost.level.probesY * MergeWeightBytes;
+			}
+		}
+
+		if (useCascadeAtlas)
+		{
+			const uint64_t atlasBytes = uint64_t(atlasLayout.GetWidth()) * atlasLayout.GetHeight() * texelBytes;
+			cost.intervalBytes = atlasBytes;
+			cost.historyBytes = hasHistory ? atlasBytes : 0u;
+		}
+		else
+		{
+			for (const CascadeLevelCost& levelCost : cost.levels)
+			{
+				cost.intervalBytes += levelCost.intervalBytes;
+			}
+		}
+
+		if (desc.useActiveProbeDirectionLists && cascadeCount > 1u)
+		{
+			cost.activeProbeDirectionBytes = (cost.texelCount - cost.levels[0].texelCount) * sizeof(uint32_t) + MaxCascadeCount * (sizeof(uint32_t) + DispatchRaysDescBytes);
+		}
+
+		const uint64_t gatherFilterCountBytes = uint64_t(layout.GetGatherFilterCount()) * sizeof(uint32_t);
+		cost.otherBytes = uint64_t(layout.GetProbeCount0X()) * layout.GetProbeCount0Y() * CoalescedTexelBytes
+			+ gatherFilterCountBytes
+			+ ReadbackSlotCount * AlignUp(gatherFilterCountBytes, ReadbackSlotAlignment);
+
+		cost.totalBytes = cost.intervalBytes + cost.gatherFilterBytes + cost.historyBytes + cost.mergeWeightBytes + cost.activeProbeDirectionBytes + cost.otherBytes;
+
+		if (cascadeCount > 0u)
+		{
+			const CascadeLevel& lastLevel = cost.levels.back().level;
+			cost.reach = lastLevel.startT + lastLevel.rayLength;
+		}
+
+		return cost;
+	}
+
+	std::vector<CascadeBudgetCandidate> SolveCascadeBudget(const CascadeCostDesc& baseDesc, const CascadeBudgetConstraints& constraints, const CascadeBudgetSearchSpace& searchSpace)
+	{
+		std::vector<CascadeBudgetCandidate> candidates;
+
+		const CascadeLayoutDesc& baseLayout = baseDesc.layout;
+		const uint32_t rayCountStep = baseLayout.isUsingPreAveragedIntervals ? baseLayout.rayScalingFactor : 1u;
+
+		for (uint32_t probeSpacing0 : searchSpace.probeSpacings0)
+		{
+			for (uint32_t raysPerProbe0 = rayCountStep; raysPerProbe0 <= searchSpace.maxRaysPerProbe0; raysPerProbe0 += rayCountStep)
+			{
+				if (probeSpacing0 == 0u || !IsValidRayCount0(raysPerProbe0, baseLayout.rayScalingFactor, baseLayout.isUsingPreAveragedIntervals))
+				{
+					continue;
+				}
+
+				for (IntervalFormat intervalFormat : searchSpace.intervalFormats)
+				{
+					CascadeBudgetCandidate candidate;
+					candidate.desc = baseDesc;
+					candidate.desc.layout.probeSpacing0 = probeSpacing0;
+					candidate.desc.layout.raysPerProbe0 = raysPerProbe0;
+					candidate.desc.layout.rayLength0 = (std::max)(baseLayout.rayLength0, constraints.minRayLength0);
+					candidate.desc.intervalFormat = intervalFormat;
+
+					candidate.cost = ComputeCascadeCost(candidate.desc);
+					if (candidate.cost.levels.empty())
+					{
+						continue;
+					}
+
+					if ((constraints.maxTracedRays > 0u && candidate.cost.tracedRays > constraints.maxTracedRays) ||
+						(constraints.maxBytes > 0u && candidate.cost.totalBytes > constraints.maxBytes))
+					{
+						continue;
+					}
+
+					candidate.rayDensity0 = raysPerProbe0 / float(probeSpacing0 * probeSpacing0);
+					candidates.push_back(candidate);
+				}
+			}
+		}
+
+		std::stable_sort(candidates.begin(), candidates.end(), [](const CascadeBudgetCandidate& a, const CascadeBudgetCandidate& b)
+		{
+			if (a.rayDensity0 != b.rayDensity0) { return a.rayDensity0 > b.rayDensity0; }
+			if (a.cost.levels.size() != b.cost.levels.size()) { return a.cost.levels.size() > b.cost.levels.size(); }
+			if (a.cost.totalBytes != b.cost.totalBytes) { return a.cost.totalBytes < b.cost.totalBytes; }
+			return a.cost.tracedRays < b.cost.tracedRays;
+		});
+
+		return candidates;
+	}
+
+	bool WriteCascadeBudgetCSV(const std::string& filePath, const std::vector<CascadeBudgetCandidate>& candidates, bool perCascade)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		if (perCascade)
+		{
+			file << "Rank,Cascade,Probes X,Probes Y,Rays Per Probe,Texture Width,Texture Height,Texels,Traced Rays,Interval Bytes,Gather Filter Bytes,History Bytes,Merge Read Texels,Merge Read Bytes,Start,Length\n";
+		}
+		else
+		{
+			file << "Rank,Width,Height,Probe Spacing,Rays Per Probe 0,Ray Length 0,Format,Cascades,Ray Density 0,Traced Rays,Texels,Interval Bytes,Gather Filter Bytes,History Bytes,Merge Weight Bytes,Active List Bytes,Other Bytes,Total Bytes,Merge Read Bytes,Reach\n";
+		}
+
+		for (size_t rank = 0; rank < candidates.size(); rank++)
+		{
+			const CascadeBudgetCandidate& candidate = candidates[rank];
+			const CascadeLayoutDesc& layout = candidate.desc.layout;
+			const CascadeCost& cost = candidate.cost;
+
+			if (perCascade)
+			{
+				for (size_t i = 0; i < cost.levels.size(); i++)
+				{
+					const CascadeLevelCost& levelCost = cost.levels[i];
+					file << rank << ","
+						<< i << ","
+						<< levelCost.level.probesX << ","
+						<< levelCost.level.probesY << ","
+						<< levelCost.level.raysPerProbe << ","
+						<< levelCost.level.textureWidth << ","
+						<< levelCost.level.textureHeight << ","
+						<< levelCost.texelCount << ","
+						<< levelCost.tracedRays << ","
+						<< levelCost.intervalBytes << ","
+						<< levelCost.gatherFilterBytes << ","
+						<< levelCost.historyBytes << ","
+						<< levelCost.mergeReadTexels << ","
+						<< levelCost.mergeReadBytes << ","
+						<< levelCost.level.startT << ","
+						<< levelCost.level.rayLength << "\n";
+				}
+
+				continue;
+			}
+
+			file << rank << ","
+				<< layout.width << ","
+				<< layout.height << ","
+				<< layout.probeSpacing0 << ","
+				<< layout.raysPerProbe0 << ","
+				<< layout.rayLength0 << ","
+				<< GetIntervalFormatName(candidate.desc.intervalFormat) << ","
+				<< cost.levels.size() << ","
+				<< candidate.rayDensity0 << ","
+				<< cost.tracedRays << ","
+				<< cost.texelCount << ","
+				<< cost.intervalBytes << ","
+				<< cost.gatherFilterBytes << ","
+				<< cost.historyBytes << ","
+				<< cost.mergeWeightBytes << ","
+				<< cost.activeProbeDirectionBytes << ","
+				<< cost.otherBytes << ","
+				<< cost.totalBytes << ","
+				<< cost.mergeReadBytes << ","
+				<< cost.reach << "\n";
+		}
+
+		return file.good();
+	}
+}
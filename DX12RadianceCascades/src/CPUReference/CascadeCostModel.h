@@ -0,0 +1,97 @@
+#pragma once
+
+// Device independent cost of a cascade setup, with the sizing rules of RadianceCascadeManager3D::Generate() through CascadeLayout.
+// Bytes are what Generate() asks for, without the alignment and padding a driver adds to textures, so the measured VRAM of
+// RadianceCascadeManager3D::GetTotalVRAMUsage() is somewhat higher. SolveCascadeBudget() ranks the setups that fit a budget,
+// see Tools/RCBudgetCLI.cpp for the command line tool.
+
+#include "CascadeLayout.h"
+#include "IntervalEncoding.h"
+
+#include <string>
+#include <vector>
+
+namespace CPUReference
+{
+	// Mirrors the static parameters of RC3DSettings that change the resources Generate() allocates.
+	struct CascadeCostDesc
+	{
+		CascadeLayoutDesc layout;
+		IntervalFormat intervalFormat = IntervalFormatFP16;
+		bool useCascadeAtlas = false;
+		bool useStaggeredUpdates = false;
+		bool useActiveProbeDirectionLists = false;
+	};
+
+	struct CascadeLevelCost
+	{
+		CascadeLevel level;
+		uint64_t texelCount = 0u;
+		// Every texel traces rayScalingFactor rays with pre-averaged intervals, one otherwise.
+		uint64_t tracedRays = 0u;
+		uint64_t intervalBytes = 0u;
+		// Gather filter of the cascade below that flags the texels of this one, 0 for cascade 0.
+		uint64_t gatherFilterBytes = 0u;
+		// 0 for cascade 0 and without staggered updates.
+		uint64_t historyBytes = 0u;
+		// Texels of this cascade read by the merge into the cascade below, rayScalingFactor x 4 per texel below. 0 for cascade 0.
+		uint64_t mergeReadTexels = 0u;
+		uint64_t mergeReadBytes = 0u;
+	};
+
+	struct CascadeCost
+	{
+		std::vector<CascadeLevelCost> levels;
+
+		uint64_t tracedRays = 0u;
+		uint64_t texelCount = 0u;
+		// Allocated texels of the intervals, larger than texelCount if the atlas has unused texels.
+		uint64_t intervalBytes = 0u;
+		uint64_t gatherFilterBytes = 0u;
+		uint64_t historyBytes = 0u;
+		uint64_t mergeWeightBytes = 0u;
+		uint64_t activeProbeDirectionBytes = 0u;
+		// Coalesced result, gather filter reduction and its readback ring.
+		uint64_t otherBytes = 0u;
+		uint64_t totalBytes = 0u;
+		uint64_t mergeReadBytes = 0u;
+		// Distance the last cascade reaches.
+		float reach = 0.0f;
+		// The atlas did not fit and Generate() falls back to one texture per cascade.
+		bool isAtlasFallback = false;
+	};
+
+	CascadeCost ComputeCascadeCost(const CascadeCostDesc& desc);
+
+	// Zero means unconstrained.
+	struct CascadeBudgetConstraints
+	{
+		uint64_t maxTracedRays = 0u;
+		uint64_t maxBytes = 0u;
+		float minRayLength0 = 0.0f;
+	};
+
+	struct CascadeBudgetSearchSpace
+	{
+		std::vector<uint32_t> probeSpacings0 = { 1u, 2u, 3u, 4u, 6u, 8u };
+		// Every valid ray count of cascade 0 up to this one is tried, see IsValidRayCount0().
+		uint32_t maxRaysPerProbe0 = 256u;
+		// RGB9E5 is left out by default as it is not a UAV format.
+		std::vector<IntervalFormat> intervalFormats = { IntervalFormatFP16, IntervalFormatR11G11B10 };
+	};
+
+	struct CascadeBudgetCandidate
+	{
+		CascadeCostDesc desc;
+		CascadeCost cost;
+		// Cascade 0 rays per screen pixel, the ranking key, see SolveCascadeBudget().
+		float rayDensity0 = 0.0f;
+	};
+
+	// Every setup of the search space on top of baseDesc that fits the constraints. The ray length of cascade 0 is raised to
+	// minRayLength0 where it is shorter. Ranked by rayDensity0, then by cascade count for reach, then by fewer bytes and rays.
+	std::vector<CascadeBudgetCandidate> SolveCascadeBudget(const CascadeCostDesc& baseDesc, const CascadeBudgetConstraints& constraints, const CascadeBudgetSearchSpace& searchSpace);
+
+	// One row per candidate, or one row per cascade of every candidate with perCascade.
+	bool WriteCascadeBudgetCSV(const std::string& filePath, const std::vector<CascadeBudgetCandidate>& candidates, bool perCascade);
+}
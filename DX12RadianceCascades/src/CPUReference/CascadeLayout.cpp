@@ -0,0 +1,62 @@
+#include "CascadeLayout.h"
+#include "ReferenceMath.h"
+
+#include <cassert>
+
+namespace CPUReference
+{
+	void CascadeLayout::Generate(const CascadeLayoutDesc& desc)
+	{
+		assert(desc.probeSpacing0 > 0u && desc.probeScalingFactor > 1u && desc.rayScalingFactor > 1u);
+
+		m_desc = desc;
+
+		// Same rounding rules as the GPU path: probe counts are floored so that higher cascades never place probes outside of the screen.
+		m_probeCount0X = uint32_t(std::floor(desc.width / (float)desc.probeSpacing0));
+		m_probeCount0Y = uint32_t(std::floor(desc.height / (float)desc.probeSpacing0));
+
+		const uint32_t minCount = m_probeCount0Y < m_probeCount0X ? m_probeCount0Y : m_probeCount0X;
+		uint32_t cascadeCount = minCount > 0u ? uint32_t(std::floor(std::log((float)minCount) / std::log((float)desc.probeScalingFactor))) : 0u;
+		if (cascadeCount > desc.maxCascadeCount)
+		{
+			cascadeCount = desc.maxCascadeCount;
+		}
+
+		m_levels.resize(cascadeCount);
+
+		uint32_t raysPerProbe = desc.raysPerProbe0;
+		uint32_t probesX = m_probeCount0X;
+		uint32_t probesY = m_probeCount0Y;
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			CascadeLevel& level = m_levels[i];
+
+			level.probesX = probesX;
+			level.probesY = probesY;
+			level.raysPerProbe = raysPerProbe;
+			level.raysPerProbeDim = desc.isUsingPreAveragedIntervals ? (uint32_t)std::sqrt(raysPerProbe / desc.rayScalingFactor) : (uint32_t)std::sqrt(raysPerProbe);
+			level.textureWidth = probesX * level.raysPerProbeDim;
+			level.textureHeight = probesY * level.raysPerProbeDim;
+
+			float startT = GeometricSeriesSum(desc.rayLength0, (float)desc.rayScalingFactor, (float)i);
+			level.startT = startT == -0.0f ? -startT : startT;
+			level.rayLength = desc.rayLength0 * std::pow((float)desc.rayScalingFactor, (float)i);
+
+			probesX /= desc.probeScalingFactor;
+			probesY /= desc.probeScalingFactor;
+			raysPerProbe *= desc.rayScalingFactor;
+		}
+	}
+
+	const CascadeLevel& CascadeLayout::GetLevel(uint32_t cascadeIndex) const
+	{
+		assert(cascadeIndex < GetCascadeCount());
+		return m_levels[cascadeIndex];
+	}
+
+	uint64_t CascadeLayout::GetTotalRays(uint32_t cascadeIndex) const
+	{
+		const CascadeLevel& level = GetLevel(cascadeIndex);
+		return uint64_t(level.probesX) * level.probesY * level.raysPerProbe;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Mirrors the static parameters of RC3DSettings together with the scaling factors of RadianceCascadeManager3D.
+	struct CascadeLayoutDesc
+	{
+		uint32_t width = 1920u;
+		uint32_t height = 1080u;
+
+		uint32_t probeSpacing0 = 2u;
+		uint32_t raysPerProbe0 = 16u;
+		uint32_t maxCascadeCount = 8u;
+		float rayLength0 = 5.0f;
+
+		uint32_t probeScalingFactor = 2u;
+		uint32_t rayScalingFactor = 4u; // This needs to be a perfect square.
+
+		// Signifies that the cascade textures will be 1 / rayscalingfactor of the original size.
+		bool isUsingPreAveragedIntervals = true;
+	};
+
+	struct CascadeLevel
+	{
+		uint32_t probesX = 0u;
+		uint32_t probesY = 0u;
+		uint32_t raysPerProbe = 0u;
+		uint32_t raysPerProbeDim = 0u; // Per dim of the cascade texture, accounts for pre-averaging.
+		uint32_t textureWidth = 0u;
+		uint32_t textureHeight = 0u;
+		float startT = 0.0f;
+		float rayLength = 0.0f;
+	};
+
+	// CPU side equivalent of RadianceCascadeManager3D::Generate() without any GPU resources.
+	class CascadeLayout
+	{
+	public:
+		CascadeLayout() = default;
+
+		void Generate(const CascadeLayoutDesc& desc);
+
+		const CascadeLayoutDesc& GetDesc() const { return m_desc; }
+		const CascadeLevel& GetLevel(uint32_t cascadeIndex) const;
+
+		uint32_t GetCascadeCount() const { return (uint32_t)m_levels.size(); }
+		// Always one less than cascade count.
+		uint32_t GetGatherFilterCount() const { return GetCascadeCount() > 0u ? GetCascadeCount() - 1u : 0u; }
+		uint32_t GetProbeCount0X() const { return m_probeCount0X; }
+		uint32_t GetProbeCount0Y() const { return m_probeCount0Y; }
+
+		uint64_t GetTotalRays(uint32_t cascadeIndex) const;
+
+	private:
+		CascadeLayoutDesc m_desc = {};
+		std::vector<CascadeLevel> m_levels;
+
+		uint32_t m_probeCount0X = 0u;
+		uint32_t m_probeCount0Y = 0u;
+	};
+}
@@ -0,0 +1,154 @@
+#include "CascadeTiling.h"
+#include "ReferenceMath.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CPUReference
+{
+	namespace
+	{
+		uint32_t GetProbeSpacing(const CascadeLayoutDesc& desc, uint32_t cascadeIndex)
+		{
+			return desc.probeSpacing0 * IntegerPow(desc.probeScalingFactor, cascadeIndex);
+		}
+
+		// Distance from a probe of the cascade below to the probes of this cascade it reads or flags.
+		uint32_t GetMergeReach(const CascadeLayoutDesc& desc, uint32_t cascadeIndex)
+		{
+			return 2u * GetProbeSpacing(desc, cascadeIndex);
+		}
+
+		uint32_t AlignUp(uint32_t value, uint32_t alignment)
+		{
+			return (value + alignment - 1u) / alignment * alignment;
+		}
+	}
+
+	uint32_t GetCascadeTileHalo(const CascadeLayout& screenLayout, const CascadeTilingDesc& desc)
+	{
+		const uint32_t cascadeCount = screenLayout.GetCascadeCount();
+		if (cascadeCount == 0u)
+		{
+			return 0u;
+		}
+
+		const CascadeLayoutDesc& layoutDesc = screenLayout.GetDesc();
+
+		// Distance from a cut tile edge after which the gather filter of each cascade flags the same probe-directions as the screen layout.
+		// Only matters if a merge reads probe-directions it did not flag itself.
+		std::vector<uint32_t> filterMargins(cascadeCount, 0u);
+		if (desc.useGatherFiltering && desc.useDepthAwareMerging)
+		{
+			for (uint32_t i = 1; i < cascadeCount; i++)
+			{
+				const uint32_t reach = GetMergeReach(layoutDesc, i);
+				filterMargins[i] = (std::max)(filterMargins[i - 1], reach) + reach;
+			}
+		}
+
+		// Same for the merged cascades, from the top down. The top cascade is not merged.
+		uint32_t margin = filterMargins[cascadeCount - 1];
+		for (int32_t i = int32_t(cascadeCount) - 2; i >= 0; i--)
+		{
+			margin = (std::max)(filterMargins[i], margin + GetMergeReach(layoutDesc, uint32_t(i) + 1u));
+		}
+
+		return AlignUp(margin, GetProbeSpacing(layoutDesc, cascadeCount - 1));
+	}
+
+	bool CascadeTiling::Generate(const CascadeLayout& screenLayout, const CascadeTilingDesc& desc)
+	{
+		m_tiles.clear();
+		m_maxTileWidth = 0u;
+		m_maxTileHeight = 0u;
+
+		const uint32_t cascadeCount = screenLayout.GetCascadeCount();
+		if (cascadeCount == 0u)
+		{
+			return false;
+		}
+
+		m_screenDesc = screenLayout.GetDesc();
+		m_alignment = GetProbeSpacing(m_screenDesc, cascadeCount - 1);
+		m_halo = GetCascadeTileHalo(screenLayout, desc);
+
+		const uint32_t coreSize = AlignUp((std::max)(desc.tileSize, 1u), m_alignment);
+		const uint32_t screenWidth = m_screenDesc.width;
+		const uint32_t screenHeight = m_screenDesc.height;
+
+		for (uint32_t coreY = 0; coreY < screenHeight; coreY += coreSize)
+		{
+			for (uint32_t coreX = 0; coreX < screenWidth; coreX += coreSize)
+			{
+				CascadeTile& tile = m_tiles.emplace_back();
+				tile.coreX = coreX;
+				tile.coreY = coreY;
+				tile.coreWidth = (std::min)(coreSize, screenWidth - coreX);
+				tile.coreHeight = (std::min)(coreSize, screenHeight - coreY);
+
+				// Core and halo are multiples of the alignment, so the clipped origin is as well.
+				tile.x = coreX - (std::min)(coreX, m_halo);
+				tile.y = coreY - (std::min)(coreY, m_halo);
+				tile.width = (std::min)(coreX + tile.coreWidth + m_halo, screenWidth) - tile.x;
+				tile.height = (std::min)(coreY + tile.coreHeight + m_halo, screenHeight) - tile.y;
+
+				m_maxTileWidth = (std::max)(m_maxTileWidth, tile.width);
+				m_maxTileHeight = (std::max)(m_maxTileHeight, tile.height);
+			}
+		}
+
+		// Small tiles end up with fewer cascades, which would change what the top cascade covers.
+		for (uint32_t i = 0; i < GetTileCount(); i++)
+		{
+			CascadeLayout tileLayout;
+			tileLayout.Generate(GetTileLayoutDesc(i));
+
+			if (tileLayout.GetCascadeCount() != cascadeCount)
+			{
+				m_tiles.clear();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const CascadeTile& CascadeTiling::GetTile(uint32_t tileIndex) const
+	{
+		assert(tileIndex < GetTileCount());
+		return m_tiles[tileIndex];
+	}
+
+	CascadeLayoutDesc CascadeTiling::GetTileLayoutDesc(uint32_t tileIndex) const
+	{
+		const CascadeTile& tile = GetTile(tileIndex);
+
+		CascadeLayoutDesc tileDesc = m_screenDesc;
+		tileDesc.width = tile.width;
+		tileDesc.height = tile.height;
+
+		return tileDesc;
+	}
+
+	CascadeLayoutDesc CascadeTiling::GetMaxTileLayoutDesc() const
+	{
+		CascadeLayoutDesc tileDesc = m_screenDesc;
+		tileDesc.width = m_maxTileWidth;
+		tileDesc.height = m_maxTileHeight;
+
+		return tileDesc;
+	}
+
+	void CascadeTiling::GetTileCoreProbes0(uint32_t tileIndex, uint32_t& beginXOut, uint32_t& beginYOut, uint32_t& endXOut, uint32_t& endYOut) const
+	{
+		const CascadeTile& tile = GetTile(tileIndex);
+		const uint32_t probeSpacing0 = m_screenDesc.probeSpacing0;
+
+		// Pixels past the last probe of the screen are part of the last core, the tile has no probe for them either.
+		beginXOut = (tile.coreX - tile.x) / probeSpacing0;
+		beginYOut = (tile.coreY - tile.y) / probeSpacing0;
+		endXOut = (std::min)((tile.coreX + tile.coreWidth - tile.x) / probeSpacing0, tile.width / probeSpacing0);
+		endYOut = (std::min)((tile.coreY + tile.coreHeight - tile.y) / probeSpacing0, tile.height / probeSpacing0);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+// Splits the screen into tiles that are processed one after another with a single set of tile sized cascades,
+// for resolutions where the screen sized cascades do not fit in memory (see TiledReferencePipeline).
+// Each tile covers its core plus a halo. The halo holds the probes that the merges of the core read, so the core ends up with
+// the same cascades as the screen layout. Tile origins are aligned to the probe spacing of the top cascade, which keeps every
+// cascade on the probe positions of the screen layout (RCGlobals::tileOriginX offsets the depth samples of the probes).
+
+#include "CascadeLayout.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	struct CascadeTilingDesc
+	{
+		// Side of the square tile cores in pixels, rounded up to a multiple of the tile alignment.
+		uint32_t tileSize = 1024u;
+		// Depth aware merges read probes that their own probe-directions did not flag in the gather filter, so with both
+		// the gather filter of the neighbours has to match the screen layout as well, which needs a larger halo.
+		bool useGatherFiltering = true;
+		bool useDepthAwareMerging = false;
+	};
+
+	struct CascadeTile
+	{
+		// Screen pixels covered by the cascades of the tile, the core plus the halo clipped to the screen.
+		uint32_t x = 0u;
+		uint32_t y = 0u;
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+		// Screen pixels whose probes are taken from this tile. Cores do not overlap and cover the whole screen.
+		uint32_t coreX = 0u;
+		uint32_t coreY = 0u;
+		uint32_t coreWidth = 0u;
+		uint32_t coreHeight = 0u;
+	};
+
+	class CascadeTiling
+	{
+	public:
+		CascadeTiling() = default;
+
+		// Returns false and leaves the tiling empty if a tile is too small to hold as many cascades as the screen layout.
+		bool Generate(const CascadeLayout& screenLayout, const CascadeTilingDesc& desc);
+
+		const CascadeTile& GetTile(uint32_t tileIndex) const;
+		uint32_t GetTileCount() const { return (uint32_t)m_tiles.size(); }
+		bool IsEmpty() const { return m_tiles.empty(); }
+
+		// Probe spacing of the top cascade, tile origins and the halo are multiples of it.
+		uint32_t GetAlignment() const { return m_alignment; }
+		uint32_t GetHalo() const { return m_halo; }
+
+		// Layout of the cascades of a tile, the screen layout with the size of the tile.
+		CascadeLayoutDesc GetTileLayoutDesc(uint32_t tileIndex) const;
+		// Smallest layout every tile fits in, the size the shared cascades are allocated with.
+		CascadeLayoutDesc GetMaxTileLayoutDesc() const;
+
+		// Probes of cascade 0 of the tile that belong to its core, [beginOut, endOut) per axis.
+		void GetTileCoreProbes0(uint32_t tileIndex, uint32_t& beginXOut, uint32_t& beginYOut, uint32_t& endXOut, uint32_t& endYOut) const;
+
+	private:
+		CascadeLayoutDesc m_screenDesc = {};
+		std::vector<CascadeTile> m_tiles;
+		uint32_t m_alignment = 0u;
+		uint32_t m_halo = 0u;
+		uint32_t m_maxTileWidth = 0u;
+		uint32_t m_maxTileHeight = 0u;
+	};
+
+	// Pixels around a tile core that are needed for the core to match the screen layout. A merge reads the probes of the
+	// cascade above within two of their probe spacings, and clamps its reads to the probes of the tile. So every cascade
+	// below the top one adds the reach of the cascade above to the halo, and with depth aware merges and gather filtering
+	// the flags of the neighbouring probe-directions add the same again. Rounded up to the probe spacing of the top cascade.
+	uint32_t GetCascadeTileHalo(const CascadeLayout& screenLayout, const CascadeTilingDesc& desc);
+}
@@ -0,0 +1,42 @@
+#include "CascadeUpdateScheduler.h"
+
+#include <algorithm>
+
+namespace CPUReference
+{
+	uint32_t CascadeUpdateScheduler::GetRefreshPeriod(uint32_t cascadeIndex) const
+	{
+		// Done in 64 bits so that large steps do not overflow before they are capped.
+		const uint64_t periodLog2 = (std::min)(uint64_t(cascadeIndex) * m_desc.periodLog2Step, uint64_t(m_desc.maxPeriodLog2));
+		return 1u << (uint32_t)(std::min)(periodLog2, uint64_t(31u));
+	}
+
+	CascadeUpdate CascadeUpdateScheduler::GetCascadeUpdate(uint32_t cascadeIndex, uint32_t cascadeHeight) const
+	{
+		CascadeUpdate update;
+		update.rowCount = cascadeHeight;
+
+		const uint32_t period = GetRefreshPeriod(cascadeIndex);
+		if (m_frameIndex == 0u || period == 1u)
+		{
+			return update;
+		}
+
+		const uint32_t phase = uint32_t(m_frameIndex % period);
+		if (!m_desc.useRoundRobinRows)
+		{
+			update.type = phase == 0u ? CascadeUpdateFull : CascadeUpdateReproject;
+			return update;
+		}
+
+		// Bands cover every row exactly once per period, some are empty if the cascade has fewer rows than the period.
+		const uint32_t rowStart = uint32_t(uint64_t(cascadeHeight) * phase / period);
+		const uint32_t rowEnd = uint32_t(uint64_t(cascadeHeight) * (phase + 1u) / period);
+
+		update.type = rowEnd > rowStart ? CascadeUpdateRows : CascadeUpdateReproject;
+		update.rowOffset = rowStart;
+		update.rowCount = rowEnd - rowStart;
+
+		return update;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Staggered updates of the upper cascades, shared by RadianceCascadeManager3D and the CPU reference.
+// Cascades that are not gathered in a frame are reprojected from their intervals of the previous frame instead,
+// see RCReproject3DCS.hlsl. Upper cascades change slowly and trace the most rays per probe, so they are refreshed the least.
+
+#include <cstdint>
+
+namespace CPUReference
+{
+	struct CascadeUpdateScheduleDesc
+	{
+		// Cascade N is refreshed every 2^(N * periodLog2Step) frames, capped at 2^maxPeriodLog2. Cascade 0 is refreshed every frame.
+		uint32_t periodLog2Step = 1u;
+		uint32_t maxPeriodLog2 = 3u;
+		// Gathers 1 / period of the texel rows of a cascade every frame instead of the whole cascade once per period.
+		// Spreads the rays evenly over frames, but the partially gathered cascades can not use the gather filter.
+		bool useRoundRobinRows = false;
+	};
+
+	enum CascadeUpdateType : uint32_t
+	{
+		CascadeUpdateFull = 0, // Every texel is gathered.
+		CascadeUpdateRows, // Reprojected, then the rows of the update are gathered on top.
+		CascadeUpdateReproject, // Every texel is reprojected.
+
+		CascadeUpdateTypeCount // Keep last!
+	};
+
+	struct CascadeUpdate
+	{
+		CascadeUpdateType type = CascadeUpdateFull;
+		// Rows of the cascade texture that are gathered, the whole texture for CascadeUpdateFull.
+		uint32_t rowOffset = 0u;
+		uint32_t rowCount = 0u;
+	};
+
+	// Refreshes are aligned to multiples of the period, which are powers of two that grow with the cascade index.
+	// So whenever a cascade is fully gathered so is the one below it, and the gather filter written by it stays valid.
+	class CascadeUpdateScheduler
+	{
+	public:
+		CascadeUpdateScheduler() = default;
+
+		void SetDesc(const CascadeUpdateScheduleDesc& desc) { m_desc = desc; }
+		const CascadeUpdateScheduleDesc& GetDesc() const { return m_desc; }
+
+		// Every cascade is fully gathered in the next frame, for when there is no history to reproject from.
+		void Reset() { m_frameIndex = 0u; }
+		void AdvanceFrame() { m_frameIndex++; }
+		// Frames since the last Reset().
+		uint64_t GetFrameIndex() const { return m_frameIndex; }
+
+		uint32_t GetRefreshPeriod(uint32_t cascadeIndex) const;
+		CascadeUpdate GetCascadeUpdate(uint32_t cascadeIndex, uint32_t cascadeHeight) const;
+
+	private:
+		CascadeUpdateScheduleDesc m_desc;
+		uint64_t m_frameIndex = 0u;
+	};
+}
@@ -0,0 +1,51 @@
+#include "DeferredReleaseQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace CPUReference
+{
+	void DeferredReleaseQueue::Retire(uint64_t fenceValue, ReleaseFunc release)
+	{
+		assert(release);
+
+		m_entries.push_back({ fenceValue, std::move(release) });
+	}
+
+	uint32_t DeferredReleaseQueue::ReleaseCompleted(const ReadbackFence& fence)
+	{
+		// Taken out first, a release may retire something else.
+		std::vector<Entry> completedEntries;
+		auto pendingEnd = std::stable_partition(m_entries.begin(), m_entries.end(), [&fence](const Entry& entry) { return !fence.IsFenceComplete(entry.fenceValue); });
+		std::move(pendingEnd, m_entries.end(), std::back_inserter(completedEntries));
+		m_entries.erase(pendingEnd, m_entries.end());
+
+		for (Entry& entry : completedEntries)
+		{
+			entry.release();
+		}
+
+		m_releasedCount += completedEntries.size();
+		return (uint32_t)completedEntries.size();
+	}
+
+	uint32_t DeferredReleaseQueue::ReleaseAll()
+	{
+		std::vector<Entry> entries;
+		entries.swap(m_entries);
+
+		for (Entry& entry : entries)
+		{
+			entry.release();
+		}
+
+		m_releasedCount += entries.size();
+		return (uint32_t)entries.size();
+	}
+
+	bool DeferredReleaseQueue::IsPending(uint64_t fenceValue) const
+	{
+		return std::any_of(m_entries.begin(), m_entries.end(), [fenceValue](const Entry& entry) { return entry.fenceValue == fenceValue; });
+	}
+}
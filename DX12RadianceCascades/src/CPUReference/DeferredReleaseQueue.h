@@ -0,0 +1,43 @@
+#pragma once
+
+// Resources that are replaced while the GPU may still use them are retired with the fence value of the last work that could use them,
+// and released once that fence completes instead of waiting for the GPU to go idle. See RadianceCascadeManager3D::Generate().
+
+#include "ReadbackRing.h"
+
+#include <functional>
+#include <vector>
+
+namespace CPUReference
+{
+	class DeferredReleaseQueue
+	{
+	public:
+		using ReleaseFunc = std::function<void()>;
+
+		DeferredReleaseQueue() = default;
+
+		// release is called by ReleaseCompleted() once fenceValue has completed. Fence values of different queues can be mixed,
+		// every entry is checked on its own.
+		void Retire(uint64_t fenceValue, ReleaseFunc release);
+
+		// Releases every entry whose fence has completed, in the order they were retired. Returns how many were released.
+		uint32_t ReleaseCompleted(const ReadbackFence& fence);
+		// Releases every entry without checking its fence, for when the GPU is known to be idle.
+		uint32_t ReleaseAll();
+
+		bool IsPending(uint64_t fenceValue) const;
+		uint32_t GetPendingCount() const { return (uint32_t)m_entries.size(); }
+		uint64_t GetReleasedCount() const { return m_releasedCount; }
+
+	private:
+		struct Entry
+		{
+			uint64_t fenceValue = 0u;
+			ReleaseFunc release;
+		};
+
+		std::vector<Entry> m_entries;
+		uint64_t m_releasedCount = 0u;
+	};
+}
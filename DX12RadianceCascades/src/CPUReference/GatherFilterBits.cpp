@@ -0,0 +1,88 @@
+#include "GatherFilterBits.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace CPUReference
+{
+	uint64_t PopCount(const uint32_t* words, size_t wordCount)
+	{
+		uint64_t setBitCount = 0u;
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			setBitCount += (uint64_t)std::popcount(words[i]);
+		}
+
+		return setBitCount;
+	}
+
+	void PackedGatherFilter::Create(uint32_t width, uint32_t height)
+	{
+		m_width = width;
+		m_height = height;
+		m_words.assign(GetGatherFilterWordCount(width, height), 0u);
+	}
+
+	void PackedGatherFilter::Clear()
+	{
+		std::fill(m_words.begin(), m_words.end(), 0u);
+	}
+
+	void PackedGatherFilter::Set(int32_t x, int32_t y)
+	{
+		// Without this check texels outside of a row would wrap into the next one instead of being dropped.
+		if (!IsInBounds(x, y))
+		{
+			return;
+		}
+
+		GatherFilterBit filterBit = GetGatherFilterBit((uint32_t)x, (uint32_t)y, m_width);
+		std::atomic_ref<uint32_t>(m_words[filterBit.wordIndex]).fetch_or(filterBit.mask, std::memory_order_relaxed);
+	}
+
+	bool PackedGatherFilter::Test(int32_t x, int32_t y) const
+	{
+		if (!IsInBounds(x, y))
+		{
+			return false;
+		}
+
+		GatherFilterBit filterBit = GetGatherFilterBit((uint32_t)x, (uint32_t)y, m_width);
+		return (m_words[filterBit.wordIndex] & filterBit.mask) != 0u;
+	}
+
+	PackedGatherFilter PackedGatherFilter::Pack(const GatherFilterTexture& byteFilter)
+	{
+		PackedGatherFilter packedFilter(byteFilter.GetWidth(), byteFilter.GetHeight());
+
+		for (uint32_t y = 0; y < byteFilter.GetHeight(); y++)
+		{
+			for (uint32_t x = 0; x < byteFilter.GetWidth(); x++)
+			{
+				if (byteFilter.At(x, y) != 0u)
+				{
+					GatherFilterBit filterBit = GetGatherFilterBit(x, y, packedFilter.m_width);
+					packedFilter.m_words[filterBit.wordIndex] |= filterBit.mask;
+				}
+			}
+		}
+
+		return packedFilter;
+	}
+
+	GatherFilterTexture PackedGatherFilter::Unpack() const
+	{
+		GatherFilterTexture byteFilter(m_width, m_height);
+
+		for (uint32_t y = 0; y < m_height; y++)
+		{
+			for (uint32_t x = 0; x < m_width; x++)
+			{
+				byteFilter.At(x, y) = Test((int32_t)x, (int32_t)y) ? 1u : 0u;
+			}
+		}
+
+		return byteFilter;
+	}
+}
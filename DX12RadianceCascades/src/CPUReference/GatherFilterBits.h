@@ -0,0 +1,66 @@
+#pragma once
+
+// Bit packed gather filter layout shared by the GPU (GetGatherFilterBit() in RCCommon3D.hlsli) and the CPU reference.
+// One bit per probe-direction texel, texels are linearized row by row and packed into 32 bit words.
+
+#include "ReferenceTexture.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	constexpr uint32_t GatherFilterBitsPerWord = 32u;
+
+	struct GatherFilterBit
+	{
+		uint32_t wordIndex;
+		uint32_t mask;
+	};
+
+	inline uint32_t GetGatherFilterWordCount(uint32_t width, uint32_t height)
+	{
+		return uint32_t((uint64_t(width) * height + GatherFilterBitsPerWord - 1u) / GatherFilterBitsPerWord);
+	}
+
+	inline GatherFilterBit GetGatherFilterBit(uint32_t x, uint32_t y, uint32_t width)
+	{
+		const uint32_t bitIndex = y * width + x;
+		return { bitIndex / GatherFilterBitsPerWord, 1u << (bitIndex % GatherFilterBitsPerWord) };
+	}
+
+	uint64_t PopCount(const uint32_t* words, size_t wordCount);
+
+	class PackedGatherFilter
+	{
+	public:
+		PackedGatherFilter() = default;
+		PackedGatherFilter(uint32_t width, uint32_t height) { Create(width, height); }
+
+		void Create(uint32_t width, uint32_t height);
+		void Clear();
+
+		// Out of bounds texels are ignored, same as a write to a texture outside of its dimensions.
+		// Safe to call concurrently as the word is updated with an atomic or, equivalent of InterlockedOr on the GPU.
+		void Set(int32_t x, int32_t y);
+		bool Test(int32_t x, int32_t y) const;
+
+		// Number of set texels, equivalent of GatherFilterReduceCS.
+		uint64_t PopCount() const { return CPUReference::PopCount(m_words.data(), m_words.size()); }
+
+		// Conversion from and to the previous R8 layout, where any non zero texel counts as set.
+		static PackedGatherFilter Pack(const GatherFilterTexture& byteFilter);
+		GatherFilterTexture Unpack() const;
+
+		bool IsInBounds(int32_t x, int32_t y) const { return x >= 0 && y >= 0 && x < (int32_t)m_width && y < (int32_t)m_height; }
+
+		uint32_t GetWidth() const { return m_width; }
+		uint32_t GetHeight() const { return m_height; }
+		const std::vector<uint32_t>& GetWords() const { return m_words; }
+
+	private:
+		uint32_t m_width = 0u;
+		uint32_t m_height = 0u;
+		std::vector<uint32_t> m_words;
+	};
+}
@@ -0,0 +1,317 @@
+#include "HiZPyramid.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPUREF_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CPUREF_USE_SSE2 0
+#endif
+
+namespace CPUReference
+{
+	namespace
+	{
+		// Tiles of the single pass build, see HiZSinglePassCS.hlsl. Mip 6 is the last mip reduced per tile (64 >> 6 = 1).
+		constexpr uint32_t HiZTileHeight = 64u;
+		constexpr uint32_t HiZTileMipCount = 6u;
+
+		// Same start values as the shaders, depth is never negative.
+		constexpr float2 EmptyMinMax = float2(std::numeric_limits<float>::max(), 0.0f);
+
+		float2 CombineMinMax(const float2& a, const float2& b) { return float2((std::min)(a.x, b.x), (std::max)(a.y, b.y)); }
+
+		uint32_t GetLastChild(uint32_t texel, uint32_t dim, uint32_t sourceDim) { return texel == dim - 1u ? sourceDim - 1u : texel * 2u + 1u; }
+
+		// Rect of a mip. Tiles are reduced through views of the full mips, dims and the odd size rule are local to the view.
+		struct MipView
+		{
+			float2* texels = nullptr;
+			uint32_t stride = 0u;
+			uint32_t width = 0u;
+			uint32_t height = 0u;
+
+			float2* Row(uint32_t y) const { return texels + size_t(y) * stride; }
+		};
+
+		struct DepthView
+		{
+			const float* texels = nullptr;
+			uint32_t stride = 0u;
+			uint32_t width = 0u;
+			uint32_t height = 0u;
+
+			const float* Row(uint32_t y) const { return texels + size_t(y) * stride; }
+		};
+
+		MipView GetMipView(MinMaxDepthTexture& mip, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+		{
+			return { &mip.At(x, y), mip.GetWidth(), width, height };
+		}
+
+		MipView GetMipView(MinMaxDepthTexture& mip)
+		{
+			return GetMipView(mip, 0u, 0u, mip.GetWidth(), mip.GetHeight());
+		}
+
+		float2 ReduceTexelScalar(const MipView& source, uint32_t firstX, uint32_t lastX, uint32_t firstY, uint32_t lastY)
+		{
+			float2 minMax = EmptyMinMax;
+			for (uint32_t y = firstY; y <= lastY; y++)
+			{
+				for (uint32_t x = firstX; x <= lastX; x++)
+				{
+					minMax = CombineMinMax(minMax, source.Row(y)[x]);
+				}
+			}
+
+			return minMax;
+		}
+
+		void ReduceMipScalar(const MipView& source, const MipView& dest)
+		{
+			for (uint32_t y = 0; y < dest.height; y++)
+			{
+				const uint32_t lastY = GetLastChild(y, dest.height, source.height);
+				for (uint32_t x = 0; x < dest.width; x++)
+				{
+					dest.Row(y)[x] = ReduceTexelScalar(source, x * 2u, GetLastChild(x, dest.width, source.width), y * 2u, lastY);
+				}
+			}
+		}
+
+		float2 ReduceDepthTexelScalar(const DepthView& depth, uint32_t firstX, uint32_t lastX, uint32_t firstY, uint32_t lastY)
+		{
+			float2 minMax = EmptyMinMax;
+			for (uint32_t y = firstY; y <= lastY; y++)
+			{
+				for (uint32_t x = firstX; x <= lastX; x++)
+				{
+					minMax = CombineMinMax(minMax, float2(depth.Row(y)[x], depth.Row(y)[x]));
+				}
+			}
+
+			return minMax;
+		}
+
+#if CPUREF_USE_SSE2
+		// Max lanes are negated on load and store, so that both channels reduce with min.
+		__m128 FlipMaxLanes(__m128 texels) { return _mm_xor_ps(texels, _mm_castsi128_ps(_mm_set_epi32(INT32_MIN, 0, INT32_MIN, 0))); }
+
+		// Two dest texels from four texels of each source row. The last row of an odd sized source is passed as a third row,
+		// rows are repeated when there is no third.
+		void ReduceTexelPair(const float2* row0, const float2* row1, const float2* row2, float2* destOut)
+		{
+			const __m128 texels01 = _mm_min_ps(_mm_min_ps(FlipMaxLanes(_mm_loadu_ps(&row0[0].x)), FlipMaxLanes(_mm_loadu_ps(&row1[0].x))), FlipMaxLanes(_mm_loadu_ps(&row2[0].x)));
+			const __m128 texels23 = _mm_min_ps(_mm_min_ps(FlipMaxLanes(_mm_loadu_ps(&row0[2].x)), FlipMaxLanes(_mm_loadu_ps(&row1[2].x))), FlipMaxLanes(_mm_loadu_ps(&row2[2].x)));
+
+			// (texel 0, texel 2) against (texel 1, texel 3).
+			const __m128 evenTexels = _mm_shuffle_ps(texels01, texels23, _MM_SHUFFLE(1, 0, 1, 0));
+			const __m128 oddTexels = _mm_shuffle_ps(texels01, texels23, _MM_SHUFFLE(3, 2, 3, 2));
+			_mm_storeu_ps(&destOut[0].x, FlipMaxLanes(_mm_min_ps(evenTexels, oddTexels)));
+		}
+
+		// Same as ReduceTexelPair() for single channel depth rows, min and max are reduced separately and interleaved on store.
+		void ReduceDepthTexelPair(const float* row0, const float* row1, const float* row2, float2* destOut)
+		{
+			const __m128 depth0 = _mm_loadu_ps(row0);
+			const __m128 depth1 = _mm_loadu_ps(row1);
+			const __m128 depth2 = _mm_loadu_ps(row2);
+			const __m128 minDepth = _mm_min_ps(_mm_min_ps(depth0, depth1), depth2);
+			const __m128 maxDepth = _mm_max_ps(_mm_max_ps(depth0, depth1), depth2);
+
+			const __m128 pairMin = _mm_min_ps(_mm_shuffle_ps(minDepth, minDepth, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(minDepth, minDepth, _MM_SHUFFLE(3, 1, 3, 1)));
+			const __m128 pairMax = _mm_max_ps(_mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_ps(&destOut[0].x, _mm_unpacklo_ps(pairMin, pairMax));
+		}
+#endif
+
+		void CopyDepthRow(const float* depthRow, uint32_t width, float2* mip0Row)
+		{
+			uint32_t x = 0;
+#if CPUREF_USE_SSE2
+			for (; x + 4u <= width; x += 4u)
+			{
+				const __m128 depth = _mm_loadu_ps(depthRow + x);
+				_mm_storeu_ps(&mip0Row[x].x, _mm_unpacklo_ps(depth, depth));
+				_mm_storeu_ps(&mip0Row[x + 2u].x, _mm_unpackhi_ps(depth, depth));
+			}
+#endif
+
+			for (; x < width; x++)
+			{
+				// Start with min and max equal.
+				mip0Row[x] = float2(depthRow[x], depthRow[x]);
+			}
+		}
+
+		// Writes mip 0 and reduces mip 1 straight from depth, so that mip 0 is only written and never read back.
+		void ReduceDepth(const DepthView& depth, const MipView& mip0, const MipView& mip1)
+		{
+			for (uint32_t y = 0; y < mip1.height; y++)
+			{
+				const uint32_t lastY = GetLastChild(y, mip1.height, depth.height);
+				for (uint32_t row = y * 2u; row <= lastY; row++)
+				{
+					CopyDepthRow(depth.Row(row), depth.width, mip0.Row(row));
+				}
+
+				uint32_t x = 0;
+#if CPUREF_USE_SSE2
+				const float* row0 = depth.Row(y * 2u);
+				const float* row1 = depth.Row((std::min)(y * 2u + 1u, lastY));
+				const float* row2 = depth.Row(lastY);
+				for (; x + 2u < mip1.width; x += 2u)
+				{
+					ReduceDepthTexelPair(row0 + x * 2u, row1 + x * 2u, row2 + x * 2u, mip1.Row(y) + x);
+				}
+#endif
+
+				for (; x < mip1.width; x++)
+				{
+					mip1.Row(y)[x] = ReduceDepthTexelScalar(depth, x * 2u, GetLastChild(x, mip1.width, depth.width), y * 2u, lastY);
+				}
+			}
+		}
+
+		void ReduceMip(const MipView& source, const MipView& dest)
+		{
+#if CPUREF_USE_SSE2
+			for (uint32_t y = 0; y < dest.height; y++)
+			{
+				const uint32_t lastY = GetLastChild(y, dest.height, source.height);
+				const float2* row0 = source.Row(y * 2u);
+				const float2* row1 = source.Row((std::min)(y * 2u + 1u, lastY));
+				const float2* row2 = source.Row(lastY);
+				float2* destRow = dest.Row(y);
+
+				// Pairs that do not include the last texel only read two source columns each.
+				uint32_t x = 0;
+				for (; x + 2u < dest.width; x += 2u)
+				{
+					ReduceTexelPair(row0 + x * 2u, row1 + x * 2u, row2 + x * 2u, destRow + x);
+				}
+
+				for (; x < dest.width; x++)
+				{
+					destRow[x] = ReduceTexelScalar(source, x * 2u, GetLastChild(x, dest.width, source.width), y * 2u, lastY);
+				}
+			}
+#else
+			ReduceMipScalar(source, dest);
+#endif
+		}
+
+		// Every texel is written by the builds, so mips that already have the right dims are reused as they are.
+		void CreateMips(uint32_t width, uint32_t height, std::vector<MinMaxDepthTexture>& mipsOut)
+		{
+			mipsOut.resize(GetHiZMipCount(width, height));
+			for (uint32_t i = 0; i < (uint32_t)mipsOut.size(); i++)
+			{
+				const uint32_t mipWidth = GetHiZMipDim(width, i);
+				const uint32_t mipHeight = GetHiZMipDim(height, i);
+				if (mipsOut[i].GetWidth() != mipWidth || mipsOut[i].GetHeight() != mipHeight)
+				{
+					mipsOut[i].Create(mipWidth, mipHeight);
+				}
+			}
+		}
+	}
+
+	uint32_t GetHiZMipCount(uint32_t width, uint32_t height)
+	{
+		return (uint32_t)std::bit_width(width | height);
+	}
+
+	uint32_t GetHiZMipDim(uint32_t dim, uint32_t mip)
+	{
+		return (std::max)(dim >> mip, 1u);
+	}
+
+	void BuildHiZPyramidPerMip(const DepthTexture& depth, std::vector<MinMaxDepthTexture>& mipsOut)
+	{
+		CreateMips(depth.GetWidth(), depth.GetHeight(), mipsOut);
+		if (mipsOut.empty())
+		{
+			return;
+		}
+
+		for (uint32_t y = 0; y < depth.GetHeight(); y++)
+		{
+			for (uint32_t x = 0; x < depth.GetWidth(); x++)
+			{
+				// Start with min and max equal.
+				const float depthValue = depth.At(x, y);
+				mipsOut[0].At(x, y) = float2(depthValue, depthValue);
+			}
+		}
+
+		for (uint32_t i = 1; i < (uint32_t)mipsOut.size(); i++)
+		{
+			ReduceMipScalar(GetMipView(mipsOut[i - 1]), GetMipView(mipsOut[i]));
+		}
+	}
+
+	void BuildHiZPyramid(const DepthTexture& depth, std::vector<MinMaxDepthTexture>& mipsOut, uint32_t tileWidth)
+	{
+		const uint32_t width = depth.GetWidth();
+		const uint32_t height = depth.GetHeight();
+
+		CreateMips(width, height, mipsOut);
+		if (mipsOut.empty())
+		{
+			return;
+		}
+
+		const uint32_t mipCount = (uint32_t)mipsOut.size();
+		const uint32_t tileMipCount = (std::min)(HiZTileMipCount, mipCount - 1u);
+
+		// The last tile of a row or column also takes the texels past the last full tile, which keeps the odd size rule inside one tile.
+		tileWidth = tileWidth == 0u ? width : tileWidth;
+		const uint32_t tileCountX = (std::max)(width / tileWidth, 1u);
+		const uint32_t tileCountY = (std::max)(height / HiZTileHeight, 1u);
+
+		for (uint32_t tileY = 0; tileY < tileCountY; tileY++)
+		{
+			for (uint32_t tileX = 0; tileX < tileCountX; tileX++)
+			{
+				const uint32_t originX = tileX * tileWidth;
+				const uint32_t originY = tileY * HiZTileHeight;
+				const bool isLastTileX = tileX == tileCountX - 1u;
+				const bool isLastTileY = tileY == tileCountY - 1u;
+
+				auto getTileView = [&](uint32_t mip)
+				{
+					const uint32_t viewX = originX >> mip;
+					const uint32_t viewY = originY >> mip;
+					const uint32_t viewEndX = isLastTileX ? GetHiZMipDim(width, mip) : (originX + tileWidth) >> mip;
+					const uint32_t viewEndY = isLastTileY ? GetHiZMipDim(height, mip) : (originY + HiZTileHeight) >> mip;
+					return GetMipView(mipsOut[mip], viewX, viewY, viewEndX - viewX, viewEndY - viewY);
+				};
+
+				const MipView mip0View = getTileView(0u);
+				const DepthView depthView = { &depth.At(originX, originY), width, mip0View.width, mip0View.height };
+				if (mipCount == 1u)
+				{
+					CopyDepthRow(depthView.Row(0u), depthView.width, mip0View.Row(0u));
+					continue;
+				}
+
+				ReduceDepth(depthView, mip0View, getTileView(1u));
+
+				for (uint32_t mip = 2; mip <= tileMipCount; mip++)
+				{
+					ReduceMip(getTileView(mip - 1u), getTileView(mip));
+				}
+			}
+		}
+
+		for (uint32_t mip = tileMipCount + 1u; mip < mipCount; mip++)
+		{
+			ReduceMip(GetMipView(mipsOut[mip - 1u]), GetMipView(mipsOut[mip]));
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Min max depth pyramid, the CPU side of HiZMipGenerationCS.hlsl (one pass per mip) and HiZSinglePassCS.hlsl (all mips in one pass).
+// Mip dims are max(1, dims >> mip) like D3D12. The last texel of a mip also takes the extra row or column of an odd sized mip above it,
+// so every depth texel is covered by exactly one texel of each mip and the last mip holds the min and max depth of the whole buffer.
+
+#include "ReferenceTexture.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	// Min depth in x, max depth in y. Same layout as the R32G32 Hi-Z buffer.
+	typedef ReferenceTexture<float2> MinMaxDepthTexture;
+
+	// Mips down to 1x1, same as ColorBuffer::ComputeNumMips().
+	uint32_t GetHiZMipCount(uint32_t width, uint32_t height);
+	uint32_t GetHiZMipDim(uint32_t dim, uint32_t mip);
+
+	// Mirrors the per mip dispatches of RadianceCascades::BuildHiZBuffer(), scalar.
+	void BuildHiZPyramidPerMip(const DepthTexture& depth, std::vector<MinMaxDepthTexture>& mipsOut);
+
+	// Mirrors HiZSinglePassCS.hlsl: mips 0 to 6 are written one tile of 64 rows at a time while the tile is in cache, the rest from mip 6.
+	// A tile width of 64 gives the tiles of the shader. The default spans the whole width so that rows are read linearly,
+	// which is worth more on the CPU than keeping a tile in L1 (about 3x at 1080p).
+	// Reductions are SSE2 if available with a scalar tail. Min and max are exact, so the result is identical to BuildHiZPyramidPerMip().
+	void BuildHiZPyramid(const DepthTexture& depth, std::vector<MinMaxDepthTexture>& mipsOut, uint32_t tileWidth = 0u);
+}
@@ -0,0 +1,467 @@
+#include "HiZRayMarch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace CPUReference
+{
+	namespace
+	{
+		constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+		float GetRayDepth(const HiZMarchRay& ray, float s)
+		{
+			return lerp(ray.startDepth, ray.endDepth, s);
+		}
+
+		float GetRayViewDepth(const HiZMarchRay& ray, float s)
+		{
+			return 1.0f / lerp(1.0f / ray.startViewDepth, 1.0f / ray.endViewDepth, s);
+		}
+
+		// Screen space s to the distance along the world space ray, undoes the perspective divide.
+		float GetRayT(const HiZMarchRay& ray, float s)
+		{
+			const float u = s * ray.startViewDepth / ((1.0f - s) * ray.endViewDepth + s * ray.startViewDepth);
+			return lerp(ray.tMin, ray.tMax, u);
+		}
+
+		float2 GetRayPixel(const HiZMarchRay& ray, float s)
+		{
+			return lerp(ray.startPixel, ray.endPixel, s);
+		}
+
+		// Part of the segment inside the rect [minX, maxX) x [minY, maxY). False if it is empty or a single point.
+		bool ClipSegmentToRect(const HiZMarchRay& ray, float minX, float minY, float maxX, float maxY, float& sAOut, float& sBOut)
+		{
+			const float rectMin[2] = { minX, minY };
+			const float rectMax[2] = { maxX, maxY };
+
+			float sA = 0.0f;
+			float sB = 1.0f;
+			for (int32_t axis = 0; axis < 2; axis++)
+			{
+				const float start = ray.startPixel[axis];
+				const float delta = ray.endPixel[axis] - start;
+				if (delta == 0.0f)
+				{
+					// Half open, same as the pixel a point is floored to.
+					if (start < rectMin[axis] || start >= rectMax[axis])
+					{
+						return false;
+					}
+
+					continue;
+				}
+
+				float s0 = (rectMin[axis] - start) / delta;
+				float s1 = (rectMax[axis] - start) / delta;
+				if (s0 > s1)
+				{
+					std::swap(s0, s1);
+				}
+
+				sA = (std::max)(sA, s0);
+				sB = (std::min)(sB, s1);
+			}
+
+			sAOut = sA;
+			sBOut = sB;
+			return sB > sA;
+		}
+
+		// Depth of the neighbour on the side that continues the surface of the center best, 0 if both are on the far plane.
+		template<typename DepthFunc>
+		float GetClosestNeighbourDepth(float centerDepth, int32_t x, int32_t y, int32_t offsetX, int32_t offsetY, int32_t width, int32_t height, int32_t& offsetSignOut, const DepthFunc& loadDepth)
+		{
+			const bool hasNext = x + offsetX < width && y + offsetY < height;
+			const bool hasPrevious = x - offsetX >= 0 && y - offsetY >= 0;
+			const float nextDepth = hasNext ? loadDepth(x + offsetX, y + offsetY) : 0.0f;
+			const float previousDepth = hasPrevious ? loadDepth(x - offsetX, y - offsetY) : 0.0f;
+
+			const bool useNext = nextDepth > 0.0f && (previousDepth <= 0.0f || std::abs(nextDepth - centerDepth) <= std::abs(previousDepth - centerDepth));
+			offsetSignOut = useNext ? 1 : -1;
+			return useNext ? nextDepth : previousDepth;
+		}
+
+		// Plane of the start pixel, reconstructed from its depth and that of its neighbours.
+		struct StartSurface
+		{
+			// Only if the ray starts on it.
+			bool isValid = false;
+			float3 position;
+			// Faces the camera, which sees the surface.
+			float3 normal;
+		};
+
+		template<typename DepthFunc>
+		StartSurface GetStartSurface(const HiZMarchRay& ray, const int2& startPixel, int32_t width, int32_t height, const ReferenceCamera& camera, const HiZMarchDesc& desc, const DepthFunc& loadDepth)
+		{
+			StartSurface startSurface;
+
+			const float centerDepth = loadDepth(startPixel.x, startPixel.y);
+			if (centerDepth <= 0.0f || std::abs(ray.startViewDepth - camera.ViewDepthFromDepth(centerDepth)) > desc.thickness)
+			{
+				return startSurface;
+			}
+
+			int32_t signX;
+			int32_t signY;
+			const float depthX = GetClosestNeighbourDepth(centerDepth, startPixel.x, startPixel.y, 1, 0, width, height, signX, loadDepth);
+			const float depthY = GetClosestNeighbourDepth(centerDepth, startPixel.x, startPixel.y, 0, 1, width, height, signY, loadDepth);
+			if (depthX <= 0.0f || depthY <= 0.0f)
+			{
+				return startSurface;
+			}
+
+			const float2 invDims = float2(1.0f / width, 1.0f / height);
+			auto getWorldPos = [&](float depthVal, int32_t x, int32_t y) { return camera.WorldPosFromDepth(depthVal, float2((x + 0.5f) * invDims.x, (y + 0.5f) * invDims.y)); };
+
+			const float3 center = getWorldPos(centerDepth, startPixel.x, startPixel.y);
+			const float3 tangentX = (getWorldPos(depthX, startPixel.x + signX, startPixel.y) - center) * (float)signX;
+			const float3 tangentY = (getWorldPos(depthY, startPixel.x, startPixel.y + signY) - center) * (float)signY;
+
+			float3 normal = normalize(cross(tangentX, tangentY));
+			if (dot(normal, camera.GetPosition() - center) < 0.0f)
+			{
+				normal = -normal;
+			}
+
+			startSurface.isValid = IsFinite(normal);
+			startSurface.position = center;
+			startSurface.normal = normal;
+			return startSurface;
+		}
+
+		// A ray that starts on its surface and points into it hits it right away.
+		bool TestStartSurface(const HiZMarchRay& ray, const int2& startPixel, const StartSurface& startSurface, HiZMarchOutput& outputOut)
+		{
+			if (!startSurface.isValid || dot(ray.direction, startSurface.normal) >= 0.0f)
+			{
+				return false;
+			}
+
+			outputOut.result = HiZMarchResultHit;
+			outputOut.hitPixel = startPixel;
+			outputOut.hitT = ray.tMin;
+			return true;
+		}
+
+		// Shared by both marchers. [sA, sB] is the part of the segment inside the pixel, returns true if the pixel ends the march.
+		// Rays that reach it leave the start surface, so pixels on its plane are not hit. Flat pixels would report them right next to the start
+		// on any surface that is not facing the camera.
+		bool TestPixel(const HiZMarchRay& ray, const int2& pixel, float pixelDepth, float sA, float sB, const StartSurface& startSurface, const float2& invDims,
+			const ReferenceCamera& camera, const HiZMarchDesc& desc, HiZMarchOutput& outputOut)
+		{
+			// Nothing to hit on the far plane.
+			if (pixelDepth <= 0.0f || sB <= sA)
+			{
+				return false;
+			}
+
+			const float depthA = GetRayDepth(ray, sA);
+			const float depthB = GetRayDepth(ray, sB);
+			if ((std::min)(depthA, depthB) > pixelDepth)
+			{
+				return false; // In front of the pixel the whole way.
+			}
+
+			if (startSurface.isValid)
+			{
+				const float3 pixelPos = camera.WorldPosFromDepth(pixelDepth, float2((pixel.x + 0.5f) * invDims.x, (pixel.y + 0.5f) * invDims.y));
+				if (std::abs(dot(pixelPos - startSurface.position, startSurface.normal)) <= desc.startSurfaceTolerance)
+				{
+					return false;
+				}
+			}
+
+			float hitS = sA;
+			if (depthA >= pixelDepth)
+			{
+				// Enters in front and crosses the pixel depth inside the pixel.
+				const float depthDelta = ray.endDepth - ray.startDepth;
+				if (depthDelta != 0.0f)
+				{
+					hitS = std::clamp((pixelDepth - ray.startDepth) / depthDelta, sA, sB);
+				}
+			}
+			else if (GetRayViewDepth(ray, sA) - camera.ViewDepthFromDepth(pixelDepth) > desc.thickness)
+			{
+				outputOut.result = HiZMarchResultOccluded;
+				return true;
+			}
+
+			outputOut.result = HiZMarchResultHit;
+			outputOut.hitPixel = pixel;
+			outputOut.hitT = GetRayT(ray, hitS);
+			return true;
+		}
+
+		HiZMarchResult GetEndResult(const HiZMarchRay& ray)
+		{
+			return ray.isClipped ? HiZMarchResultOffScreen : HiZMarchResultMiss;
+		}
+
+		bool IsSamePixel(const int2& a, const int2& b) { return a.x == b.x && a.y == b.y; }
+
+		int2 GetStartPixel(const HiZMarchRay& ray)
+		{
+			return int2((int32_t)std::floor(ray.startPixel.x), (int32_t)std::floor(ray.startPixel.y));
+		}
+	}
+
+	const char* GetHiZMarchResultName(HiZMarchResult result)
+	{
+		switch (result)
+		{
+		case HiZMarchResultMiss: return "Miss";
+		case HiZMarchResultHit: return "Hit";
+		case HiZMarchResultOffScreen: return "OffScreen";
+		case HiZMarchResultOccluded: return "Occluded";
+		case HiZMarchResultOutOfSteps: return "OutOfSteps";
+		default: return "Unknown";
+		}
+	}
+
+	bool SetupHiZMarchRay(const ReferenceCamera& camera, uint32_t width, uint32_t height, const float3& origin, const float3& direction, float tMin, float tMax, HiZMarchRay& rayOut)
+	{
+		const float nearClip = camera.GetNearClip();
+
+		const float3 start = origin + direction * tMin;
+		const float startViewDepth = camera.GetViewDepth(start);
+		// Also rejects non finite origins, like probes on the far plane.
+		if (!(startViewDepth > nearClip))
+		{
+			return false;
+		}
+
+		HiZMarchRay ray;
+		ray.tMin = tMin;
+		ray.tMax = tMax;
+		ray.direction = direction;
+
+		float3 end = origin + direction * tMax;
+		float endViewDepth = camera.GetViewDepth(end);
+		if (!(endViewDepth > nearClip))
+		{
+			// Ends on the near plane instead, it has no projection past it.
+			ray.tMax = lerp(tMin, tMax, (startViewDepth - nearClip) / (startViewDepth - endViewDepth));
+			ray.isClipped = true;
+
+			end = origin + direction * ray.tMax;
+			endViewDepth = nearClip;
+		}
+
+		float2 startUV;
+		float2 endUV;
+		if (!camera.ProjectToUV(float4(start, 1.0f), startUV) || !camera.ProjectToUV(float4(end, 1.0f), endUV))
+		{
+			return false;
+		}
+
+		const float2 screenDims = float2((float)width, (float)height);
+		ray.startPixel = startUV * screenDims;
+		ray.endPixel = endUV * screenDims;
+		if (ray.startPixel.x < 0.0f || ray.startPixel.y < 0.0f || ray.startPixel.x >= screenDims.x || ray.startPixel.y >= screenDims.y)
+		{
+			return false;
+		}
+
+		ray.startDepth = camera.DepthFromViewDepth(startViewDepth);
+		ray.endDepth = camera.DepthFromViewDepth(endViewDepth);
+		ray.startViewDepth = startViewDepth;
+		ray.endViewDepth = endViewDepth;
+
+		// Ends on the edge of the screen if it leaves it.
+		float sEnd = 1.0f;
+		for (int32_t axis = 0; axis < 2; axis++)
+		{
+			const float delta = ray.endPixel[axis] - ray.startPixel[axis];
+			if (ray.endPixel[axis] < 0.0f)
+			{
+				sEnd = (std::min)(sEnd, -ray.startPixel[axis] / delta);
+			}
+			else if (ray.endPixel[axis] > screenDims[axis])
+			{
+				sEnd = (std::min)(sEnd, (screenDims[axis] - ray.startPixel[axis]) / delta);
+			}
+		}
+
+		if (sEnd < 1.0f)
+		{
+			// Uses the unclipped ends, so everything has to be computed before any of them is written.
+			const float2 endPixel = GetRayPixel(ray, sEnd);
+			const float endDepth = GetRayDepth(ray, sEnd);
+			const float clippedViewDepth = GetRayViewDepth(ray, sEnd);
+			const float clippedTMax = GetRayT(ray, sEnd);
+
+			ray.endPixel = endPixel;
+			ray.endDepth = endDepth;
+			ray.endViewDepth = clippedViewDepth;
+			ray.tMax = clippedTMax;
+			ray.isClipped = true;
+		}
+
+		rayOut = ray;
+		return true;
+	}
+
+	HiZMarchOutput MarchHiZ(const HiZMarchRay& ray, const std::vector<MinMaxDepthTexture>& hiZMips, const ReferenceCamera& camera, const HiZMarchDesc& desc)
+	{
+		assert(!hiZMips.empty());
+
+		const int32_t width = (int32_t)hiZMips[0].GetWidth();
+		const int32_t height = (int32_t)hiZMips[0].GetHeight();
+		const uint32_t maxLevel = (uint32_t)hiZMips.size() - 1u;
+
+		const float2 delta = ray.endPixel - ray.startPixel;
+		const int2 startPixel = GetStartPixel(ray);
+
+		HiZMarchOutput output;
+
+		const float2 invDims = float2(1.0f / width, 1.0f / height);
+		const StartSurface startSurface = GetStartSurface(ray, startPixel, width, height, camera, desc, [&](int32_t x, int32_t y) { return hiZMips[0].At(x, y).y; });
+		if (TestStartSurface(ray, startPixel, startSurface, output))
+		{
+			output.stepCount = 1u;
+			return output;
+		}
+
+		// Pixel the ray is in at s, tracked explicitly so that cells are never looked up from a position on their edge.
+		int2 pixel = int2(std::clamp(startPixel.x, 0, width - 1), std::clamp(startPixel.y, 0, height - 1));
+		float s = 0.0f;
+		uint32_t level = 0u;
+		while (output.stepCount < desc.maxStepCount)
+		{
+			output.stepCount++;
+
+			const MinMaxDepthTexture& mip = hiZMips[level];
+			const int32_t mipWidth = (int32_t)mip.GetWidth();
+			const int32_t mipHeight = (int32_t)mip.GetHeight();
+			const int32_t cellX = (std::min)(pixel.x >> level, mipWidth - 1);
+			const int32_t cellY = (std::min)(pixel.y >> level, mipHeight - 1);
+
+			// The last cell of a mip also covers the odd row or column of the mips above it.
+			const int32_t minX = cellX << level;
+			const int32_t minY = cellY << level;
+			const int32_t maxX = cellX == mipWidth - 1 ? width : (cellX + 1) << level;
+			const int32_t maxY = cellY == mipHeight - 1 ? height : (cellY + 1) << level;
+
+			const float exitSX = delta.x > 0.0f ? (maxX - ray.startPixel.x) / delta.x : delta.x < 0.0f ? (minX - ray.startPixel.x) / delta.x : Infinity;
+			const float exitSY = delta.y > 0.0f ? (maxY - ray.startPixel.y) / delta.y : delta.y < 0.0f ? (minY - ray.startPixel.y) / delta.y : Infinity;
+			const bool isLastCell = (std::min)(exitSX, exitSY) >= 1.0f;
+			const float exitS = (std::max)(s, (std::min)((std::min)(exitSX, exitSY), 1.0f));
+
+			// Depth is linear along the segment, so its ends bound the ray inside the cell.
+			const bool isInFront = (std::min)(GetRayDepth(ray, s), GetRayDepth(ray, exitS)) > mip.At(cellX, cellY).y;
+			if (!isInFront && level > 0u)
+			{
+				level--;
+				continue;
+			}
+
+			if (!isInFront && !IsSamePixel(pixel, startPixel) && TestPixel(ray, pixel, mip.At(cellX, cellY).y, s, exitS, startSurface, invDims, camera, desc, output))
+			{
+				return output;
+			}
+
+			if (isLastCell)
+			{
+				output.result = GetEndResult(ray);
+				return output;
+			}
+
+			// Step into the neighbour across the face the segment leaves through.
+			const float2 exitPixel = GetRayPixel(ray, exitS);
+			if (exitSX <= exitSY)
+			{
+				pixel.x = delta.x > 0.0f ? maxX : minX - 1;
+				pixel.y = std::clamp((int32_t)std::floor(exitPixel.y), minY, maxY - 1);
+			}
+			else
+			{
+				pixel.x = std::clamp((int32_t)std::floor(exitPixel.x), minX, maxX - 1);
+				pixel.y = delta.y > 0.0f ? maxY : minY - 1;
+			}
+
+			if (pixel.x < 0 || pixel.y < 0 || pixel.x >= width || pixel.y >= height)
+			{
+				output.result = GetEndResult(ray);
+				return output;
+			}
+
+			s = exitS;
+			if (isInFront)
+			{
+				level = (std::min)(level + 1u, maxLevel);
+			}
+		}
+
+		output.result = HiZMarchResultOutOfSteps;
+		return output;
+	}
+
+	HiZMarchOutput MarchBruteForce(const HiZMarchRay& ray, const DepthTexture& depth, const ReferenceCamera& camera, const HiZMarchDesc& desc)
+	{
+		const int32_t width = (int32_t)depth.GetWidth();
+		const int32_t height = (int32_t)depth.GetHeight();
+		const int2 startPixel = GetStartPixel(ray);
+
+		HiZMarchOutput output;
+
+		const float2 invDims = float2(1.0f / width, 1.0f / height);
+		const StartSurface startSurface = GetStartSurface(ray, startPixel, width, height, camera, desc, [&](int32_t x, int32_t y) { return depth.At(x, y); });
+		if (TestStartSurface(ray, startPixel, startSurface, output))
+		{
+			output.stepCount = 1u;
+			return output;
+		}
+
+		output.result = GetEndResult(ray);
+
+		float firstEventS = Infinity;
+
+		const int32_t minY = (std::max)((int32_t)std::floor((std::min)(ray.startPixel.y, ray.endPixel.y)), 0);
+		const int32_t maxY = (std::min)((int32_t)std::floor((std::max)(ray.startPixel.y, ray.endPixel.y)), height - 1);
+		for (int32_t y = minY; y <= maxY; y++)
+		{
+			float rowSA;
+			float rowSB;
+			if (!ClipSegmentToRect(ray, -Infinity, (float)y, Infinity, (float)(y + 1), rowSA, rowSB))
+			{
+				continue;
+			}
+
+			// One extra pixel on either side, the rect test below decides.
+			const float rowStartX = GetRayPixel(ray, rowSA).x;
+			const float rowEndX = GetRayPixel(ray, rowSB).x;
+			const int32_t minX = (std::max)((int32_t)std::floor((std::min)(rowStartX, rowEndX)) - 1, 0);
+			const int32_t maxX = (std::min)((int32_t)std::floor((std::max)(rowStartX, rowEndX)) + 1, width - 1);
+			for (int32_t x = minX; x <= maxX; x++)
+			{
+				const int2 pixel = int2(x, y);
+
+				float sA;
+				float sB;
+				if (IsSamePixel(pixel, startPixel) || !ClipSegmentToRect(ray, (float)x, (float)y, (float)(x + 1), (float)(y + 1), sA, sB))
+				{
+					continue;
+				}
+
+				output.stepCount++;
+
+				HiZMarchOutput pixelOutput;
+				if (sA < firstEventS && TestPixel(ray, pixel, depth.At(x, y), sA, sB, startSurface, invDims, camera, desc, pixelOutput))
+				{
+					firstEventS = sA;
+					output.result = pixelOutput.result;
+					output.hitPixel = pixelOutput.hitPixel;
+					output.hitT = pixelOutput.hitT;
+				}
+			}
+		}
+
+		return output;
+	}
+}
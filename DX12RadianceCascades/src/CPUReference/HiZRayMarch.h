@@ -0,0 +1,84 @@
+#pragma once
+
+// Screen space ray march against the min max depth pyramid of HiZPyramid.h, meant to answer the short rays of the lowest cascades
+// without tracing them through the TLAS. Only rays the depth buffer can not answer fall back to the ray tracer: rays that leave the
+// screen or cross the near plane before tMax, and rays that pass behind a surface by more than the thickness.
+//
+// The ray is projected to a segment in pixels. Reverse-Z depth and 1 / viewDepth are both linear along it, so the depth of the ray
+// over any part of the segment is bounded by its two ends. A cell of the pyramid is skipped if the ray stays in front of the closest
+// depth in it, every other cell is descended into until single pixels are tested. Depth pixels are flat, a pixel is hit if the ray
+// crosses its depth inside it, or is behind it by at most the thickness where it enters it.
+// The pixel that holds the start of the ray is the surface the probe sits on, its plane is reconstructed from the depth around it.
+// A ray that starts on it and points into it hits it right away, like a traced ray hits the surface it starts on. Any other ray leaves
+// the plane and does not hit pixels on it, which flat pixels would otherwise report next to the start of every grazing ray.
+
+#include "HiZPyramid.h"
+#include "ReferenceScene.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	enum HiZMarchResult : uint32_t
+	{
+		HiZMarchResultMiss = 0, // The whole ray is on screen and in front of the depth buffer, nothing can be hit.
+		HiZMarchResultHit, // Hits a depth pixel, its radiance is the radiance of the ray.
+		HiZMarchResultOffScreen, // Leaves the screen or crosses the near plane before it could hit anything.
+		HiZMarchResultOccluded, // Passes behind a depth pixel by more than the thickness, what it hits there is not on screen.
+		HiZMarchResultOutOfSteps, // Ran out of steps before the end of the ray.
+
+		HiZMarchResultCount // Keep last!
+	};
+
+	const char* GetHiZMarchResultName(HiZMarchResult result);
+	// Misses and hits are answered by the march, everything else has to be traced.
+	inline bool IsHiZMarchResolved(HiZMarchResult result) { return result == HiZMarchResultMiss || result == HiZMarchResultHit; }
+
+	struct HiZMarchDesc
+	{
+		// View space depth a pixel is assumed to extend behind itself.
+		float thickness = 0.25f;
+		// Distance from the plane of the start pixel below which pixels count as the surface the ray starts on.
+		float startSurfaceTolerance = 0.05f;
+		uint32_t maxStepCount = 128u;
+	};
+
+	// Ray projected to the screen, in pixels with (0, 0) in the top left corner of the depth buffer.
+	struct HiZMarchRay
+	{
+		float2 startPixel;
+		float2 endPixel;
+		// Reverse-Z depth of the ends. Not saturated, so it stays linear along the segment.
+		float startDepth = 0.0f;
+		float endDepth = 0.0f;
+		float startViewDepth = 0.0f;
+		float endViewDepth = 0.0f;
+		// Distances along the world space ray of the ends.
+		float tMin = 0.0f;
+		float tMax = 0.0f;
+		// World space, only used by the start pixel test.
+		float3 direction;
+		// Whether the end was moved to the edge of the screen or the near plane. A clipped ray that reaches its end is off screen, not a miss.
+		bool isClipped = false;
+	};
+
+	struct HiZMarchOutput
+	{
+		HiZMarchResult result = HiZMarchResultMiss;
+		// Only valid for hits.
+		int2 hitPixel = int2(-1, -1);
+		float hitT = 0.0f;
+		// Cells visited by MarchHiZ(), pixels tested by MarchBruteForce().
+		uint32_t stepCount = 0u;
+	};
+
+	// Projects [tMin, tMax] of the ray onto a screen of the given size. Returns false if the start of the ray is in front of the near plane
+	// or off screen, those rays have to be traced.
+	bool SetupHiZMarchRay(const ReferenceCamera& camera, uint32_t width, uint32_t height, const float3& origin, const float3& direction, float tMin, float tMax, HiZMarchRay& rayOut);
+
+	// Hierarchical march over the mips of BuildHiZPyramid().
+	HiZMarchOutput MarchHiZ(const HiZMarchRay& ray, const std::vector<MinMaxDepthTexture>& hiZMips, const ReferenceCamera& camera, const HiZMarchDesc& desc);
+	// Tests every pixel the segment crosses with the same pixel test and keeps the first event along the ray. Ignores maxStepCount.
+	// Reference for MarchHiZ(), which has to return the same result and hit pixel.
+	HiZMarchOutput MarchBruteForce(const HiZMarchRay& ray, const DepthTexture& depth, const ReferenceCamera& camera, const HiZMarchDesc& desc);
+}
@@ -0,0 +1,67 @@
+#include "InstanceMasks.h"
+
+#include <cassert>
+
+namespace CPUReference
+{
+	BoxBounds IntersectBounds(const BoxBounds& a, const BoxBounds& b)
+	{
+		BoxBounds intersection;
+		intersection.minPos = (max)(a.minPos, b.minPos);
+		intersection.maxPos = (min)(a.maxPos, b.maxPos);
+		return intersection;
+	}
+
+	float GetMinDistance(const BoxBounds& box, const float3& point)
+	{
+		return length(point - clamp(point, box.minPos, box.maxPos));
+	}
+
+	float GetMaxDistance(const BoxBounds& box, const float3& point)
+	{
+		// The corner furthest away, per axis.
+		return length((max)(abs(point - box.minPos), abs(point - box.maxPos)));
+	}
+
+	uint8_t ComputeInstanceMask(const InstanceMaskInput& instance, const BoxBounds& probeVolume, const std::vector<CascadeInterval>& intervals, const InstanceMaskDesc& desc)
+	{
+		assert(!probeVolume.IsEmpty());
+
+		const SphereBounds& bounds = instance.bounds;
+
+		// Range of distances from any probe to any point of the instance.
+		const float minDistance = (std::max)(GetMinDistance(probeVolume, bounds.center) - bounds.radius, 0.0f);
+		const float maxDistance = GetMaxDistance(probeVolume, bounds.center) + bounds.radius;
+
+		uint8_t mask = InstanceMaskAlwaysBit;
+		for (uint32_t cascadeIndex = 0; cascadeIndex < (uint32_t)intervals.size(); cascadeIndex++)
+		{
+			const CascadeInterval& interval = intervals[cascadeIndex];
+			const float endT = interval.startT + interval.range;
+			if (minDistance > endT || maxDistance < interval.startT)
+			{
+				continue;
+			}
+
+			const float closestHitDistance = (std::max)(minDistance, interval.startT);
+			if (!instance.isEmissive && bounds.radius < desc.smallInstanceRatio * closestHitDistance)
+			{
+				continue;
+			}
+
+			mask |= GetCascadeInstanceMask(cascadeIndex);
+		}
+
+		return mask;
+	}
+
+	void ComputeInstanceMasks(const std::vector<InstanceMaskInput>& instances, const BoxBounds& probeVolume, const std::vector<CascadeInterval>& intervals,
+		const InstanceMaskDesc& desc, std::vector<uint8_t>& masksOut)
+	{
+		masksOut.resize(instances.size());
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			masksOut[i] = ComputeInstanceMask(instances[i], probeVolume, intervals, desc);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Instance masks that keep the rays of a cascade from traversing instances they can not hit. Rays of a cascade start on probes inside
+// the probe volume and only cover [startT, startT + range] from them, so an instance whose bounds are nowhere inside that shell around
+// the volume is left out of the cascade's mask without changing a single hit. On top of that, instances that do not emit light and are
+// small against the closest distance the cascade can hit them at are left out of it too. That does change the result, but they only
+// cover a sliver of a ray's cone there. Cascades past the last cascade bit share it and the top bit is set on every instance, so traces
+// that do not cull can keep using a mask of ~0.
+
+#include "ReferenceMath.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	constexpr uint32_t InstanceMaskCascadeBitCount = 7u;
+	constexpr uint8_t InstanceMaskAlwaysBit = 0x80u;
+	// What every instance has without culling.
+	constexpr uint8_t InstanceMaskAll = 0xffu;
+
+	// Has to match GetCascadeInstanceMask() in RCRaytraceRT.hlsl.
+	inline uint8_t GetCascadeInstanceMask(uint32_t cascadeIndex)
+	{
+		return uint8_t(1u << (std::min)(cascadeIndex, InstanceMaskCascadeBitCount - 1u));
+	}
+
+	// Same as Math::BoundingSphere and Math::AxisAlignedBox, which need DirectXMath.
+	struct SphereBounds
+	{
+		float3 center;
+		float radius = 0.0f;
+	};
+
+	struct BoxBounds
+	{
+		// Empty until something is added.
+		float3 minPos = float3(FloatMax);
+		float3 maxPos = float3(-FloatMax);
+
+		void AddPoint(const float3& point) { minPos = (min)(minPos, point); maxPos = (max)(maxPos, point); }
+		void AddSphere(const SphereBounds& sphere) { AddPoint(sphere.center - float3(sphere.radius)); AddPoint(sphere.center + float3(sphere.radius)); }
+		bool IsEmpty() const { return minPos.x > maxPos.x || minPos.y > maxPos.y || minPos.z > maxPos.z; }
+	};
+
+	BoxBounds IntersectBounds(const BoxBounds& a, const BoxBounds& b);
+	// Distance from the point to the closest and the furthest point of a box that is not empty.
+	float GetMinDistance(const BoxBounds& box, const float3& point);
+	float GetMaxDistance(const BoxBounds& box, const float3& point);
+
+	// GetStartT() and GetRayLength() of a cascade in RadianceCascadeManager3D.
+	struct CascadeInterval
+	{
+		float startT = 0.0f;
+		float range = 0.0f;
+	};
+
+	struct InstanceMaskDesc
+	{
+		// Instances that do not emit light are left out of a cascade if their radius is less than this fraction of the closest distance
+		// the cascade can hit them at. 0 only culls by distance, which never changes a hit.
+		float smallInstanceRatio = 0.02f;
+	};
+
+	struct InstanceMaskInput
+	{
+		// World space.
+		SphereBounds bounds;
+		bool isEmissive = true;
+	};
+
+	// The probe volume must not be empty.
+	uint8_t ComputeInstanceMask(const InstanceMaskInput& instance, const BoxBounds& probeVolume, const std::vector<CascadeInterval>& intervals, const InstanceMaskDesc& desc);
+	void ComputeInstanceMasks(const std::vector<InstanceMaskInput>& instances, const BoxBounds& probeVolume, const std::vector<CascadeInterval>& intervals,
+		const InstanceMaskDesc& desc, std::vector<uint8_t>& masksOut);
+}
@@ -0,0 +1,195 @@
+#include "InstanceRegistry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <functional>
+
+namespace CPUReference
+{
+	namespace
+	{
+		constexpr uint32_t DirtyBitsPerWord = 64u;
+	}
+
+	uint32_t InstanceRegistry::Add(const InstanceTransform& transform, uint64_t blasAddress, uint32_t hitGroupOffset, uint8_t instanceMask /*= 1u*/, uint8_t flags /*= 0u*/)
+	{
+		uint32_t slot = InvalidSlot;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = GetSlotCount();
+			m_transforms.emplace_back();
+			m_blasAddresses.push_back(0u);
+			m_hitGroupOffsets.push_back(0u);
+			m_instanceMasks.push_back(0u);
+			m_flags.push_back(0u);
+			m_isActive.push_back(0u);
+
+			if (slot / DirtyBitsPerWord >= m_dirtyWords.size())
+			{
+				m_dirtyWords.push_back(0u);
+			}
+		}
+
+		m_transforms[slot] = transform;
+		m_blasAddresses[slot] = blasAddress;
+		m_hitGroupOffsets[slot] = hitGroupOffset;
+		m_instanceMasks[slot] = instanceMask;
+		m_flags[slot] = flags;
+		m_isActive[slot] = 1u;
+
+		m_hasActivationChanges = true;
+		MarkDirty(slot);
+
+		return slot;
+	}
+
+	void InstanceRegistry::Remove(uint32_t slot)
+	{
+		assert(IsActive(slot));
+
+		m_blasAddresses[slot] = 0u;
+		m_hitGroupOffsets[slot] = 0u;
+		m_instanceMasks[slot] = 0u;
+		m_flags[slot] = 0u;
+		m_isActive[slot] = 0u;
+
+		m_freeSlots.insert(std::lower_bound(m_freeSlots.begin(), m_freeSlots.end(), slot, std::greater<uint32_t>()), slot);
+
+		m_hasActivationChanges = true;
+		MarkDirty(slot);
+	}
+
+	void InstanceRegistry::Clear()
+	{
+		*this = InstanceRegistry();
+	}
+
+	void InstanceRegistry::SetTransform(uint32_t slot, const InstanceTransform& transform)
+	{
+		assert(IsActive(slot));
+
+		// Bitwise, a transform that is recomputed to the same value every frame stays clean.
+		if (std::memcmp(&m_transforms[slot], &transform, sizeof(InstanceTransform)) != 0)
+		{
+			m_transforms[slot] = transform;
+			MarkDirty(slot);
+		}
+	}
+
+	void InstanceRegistry::SetBLAS(uint32_t slot, uint64_t blasAddress, uint32_t hitGroupOffset)
+	{
+		assert(IsActive(slot));
+
+		if (m_blasAddresses[slot] != blasAddress || m_hitGroupOffsets[slot] != hitGroupOffset)
+		{
+			m_blasAddresses[slot] = blasAddress;
+			m_hitGroupOffsets[slot] = hitGroupOffset;
+			MarkDirty(slot);
+		}
+	}
+
+	void InstanceRegistry::SetInstanceMask(uint32_t slot, uint8_t instanceMask)
+	{
+		assert(IsActive(slot));
+
+		if (m_instanceMasks[slot] != instanceMask)
+		{
+			m_instanceMasks[slot] = instanceMask;
+			MarkDirty(slot);
+		}
+	}
+
+	void InstanceRegistry::GetDirtyRanges(std::vector<InstanceRange>& rangesOut, uint32_t maxGap /*= 0u*/) const
+	{
+		rangesOut.clear();
+
+		for (uint32_t wordIndex = 0; wordIndex < (uint32_t)m_dirtyWords.size(); wordIndex++)
+		{
+			uint64_t word = m_dirtyWords[wordIndex];
+			while (word != 0u)
+			{
+				// Run of set bits starting at the lowest one.
+				const uint32_t runBegin = (uint32_t)std::countr_zero(word);
+				const uint32_t runLength = (uint32_t)std::countr_one(word >> runBegin);
+				word = runBegin + runLength < DirtyBitsPerWord ? word & ~(((1ull << runLength) - 1u) << runBegin) : 0u;
+
+				const uint32_t begin = wordIndex * DirtyBitsPerWord + runBegin;
+				const uint32_t end = begin + runLength;
+
+				// Runs that continue in the next word, or are close enough, extend the previous range.
+				if (!rangesOut.empty() && begin - rangesOut.back().end <= maxGap)
+				{
+					rangesOut.back().end = end;
+				}
+				else
+				{
+					rangesOut.push_back({ begin, end });
+				}
+			}
+		}
+	}
+
+	void InstanceRegistry::EncodeInstanceDesc(uint32_t slot, RaytracingInstanceDesc& descOut) const
+	{
+		std::memcpy(descOut.transform, m_transforms[slot].rows, sizeof(descOut.transform));
+		descOut.instanceID = 0u;
+		descOut.instanceMask = m_instanceMasks[slot];
+		descOut.instanceContributionToHitGroupIndex = m_hitGroupOffsets[slot];
+		descOut.flags = m_flags[slot];
+		descOut.accelerationStructure = m_blasAddresses[slot];
+	}
+
+	uint32_t InstanceRegistry::WriteDirtyDescs(RaytracingInstanceDesc* descs, uint32_t maxGap /*= 0u*/)
+	{
+		GetDirtyRanges(m_dirtyRanges, maxGap);
+
+		uint32_t writtenCount = 0u;
+		for (const InstanceRange& range : m_dirtyRanges)
+		{
+			for (uint32_t slot = range.begin; slot < range.end; slot++)
+			{
+				EncodeInstanceDesc(slot, descs[slot]);
+			}
+
+			writtenCount += range.end - range.begin;
+		}
+
+		ClearDirty();
+		return writtenCount;
+	}
+
+	void InstanceRegistry::WriteAllDescs(RaytracingInstanceDesc* descs)
+	{
+		for (uint32_t slot = 0; slot < GetSlotCount(); slot++)
+		{
+			EncodeInstanceDesc(slot, descs[slot]);
+		}
+
+		ClearDirty();
+	}
+
+	void InstanceRegistry::ClearDirty()
+	{
+		std::fill(m_dirtyWords.begin(), m_dirtyWords.end(), 0u);
+		m_dirtyCount = 0u;
+		m_hasActivationChanges = false;
+	}
+
+	void InstanceRegistry::MarkDirty(uint32_t slot)
+	{
+		uint64_t& word = m_dirtyWords[slot / DirtyBitsPerWord];
+		const uint64_t mask = 1ull << (slot % DirtyBitsPerWord);
+		if ((word & mask) == 0u)
+		{
+			word |= mask;
+			m_dirtyCount++;
+		}
+	}
+}
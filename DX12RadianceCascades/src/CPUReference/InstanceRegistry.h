@@ -0,0 +1,98 @@
+#pragma once
+
+// Persistent registry of the TLAS instances, see TLASBuffers::UpdateTLASInstances(). Every instance keeps the slot it was added in,
+// which is also its index in the instance desc buffer, so a frame only rewrites the descs of the instances that changed.
+// Fields are stored in one array each and changes are tracked with one dirty bit per slot. Setting a field to the value it already
+// has does not dirty the slot, so the scene can push every transform every frame and only the moving instances are written.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Same layout as D3D12_RAYTRACING_INSTANCE_DESC, which is checked where the descs are written for the GPU.
+	struct RaytracingInstanceDesc
+	{
+		float transform[3][4];
+		uint32_t instanceID : 24;
+		uint32_t instanceMask : 8;
+		uint32_t instanceContributionToHitGroupIndex : 24;
+		uint32_t flags : 8;
+		uint64_t accelerationStructure;
+	};
+	static_assert(sizeof(RaytracingInstanceDesc) == 64u, "RaytracingInstanceDesc has to match D3D12_RAYTRACING_INSTANCE_DESC.");
+
+	// Object to world, the first 3 rows of the row major matrix like D3D12_RAYTRACING_INSTANCE_DESC::Transform.
+	struct InstanceTransform
+	{
+		float rows[3][4];
+	};
+
+	struct InstanceRange
+	{
+		uint32_t begin = 0u;
+		uint32_t end = 0u;
+	};
+
+	class InstanceRegistry
+	{
+	public:
+		static constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+		InstanceRegistry() = default;
+
+		// Takes the lowest free slot.
+		uint32_t Add(const InstanceTransform& transform, uint64_t blasAddress, uint32_t hitGroupOffset, uint8_t instanceMask = 1u, uint8_t flags = 0u);
+		// The slot is written as an inactive desc, a null BLAS and a mask of 0, and reused by the next Add().
+		void Remove(uint32_t slot);
+		void Clear();
+
+		void SetTransform(uint32_t slot, const InstanceTransform& transform);
+		void SetBLAS(uint32_t slot, uint64_t blasAddress, uint32_t hitGroupOffset);
+		void SetInstanceMask(uint32_t slot, uint8_t instanceMask);
+
+		bool IsActive(uint32_t slot) const { return slot < GetSlotCount() && m_isActive[slot] != 0u; }
+		const InstanceTransform& GetTransform(uint32_t slot) const { return m_transforms[slot]; }
+
+		// Every slot that was ever used, the TLAS has to be built over this many descs.
+		uint32_t GetSlotCount() const { return (uint32_t)m_transforms.size(); }
+		uint32_t GetActiveCount() const { return GetSlotCount() - (uint32_t)m_freeSlots.size(); }
+
+		bool HasChanges() const { return m_dirtyCount > 0u; }
+		uint32_t GetDirtyCount() const { return m_dirtyCount; }
+		// An instance was added or removed, or the slot count changed. A TLAS update can not do that, it has to be rebuilt.
+		bool HasActivationChanges() const { return m_hasActivationChanges; }
+
+		// Dirty slots as sorted ranges. Ranges closer than maxGap slots are joined, so the clean slots between them count as written.
+		void GetDirtyRanges(std::vector<InstanceRange>& rangesOut, uint32_t maxGap = 0u) const;
+
+		void EncodeInstanceDesc(uint32_t slot, RaytracingInstanceDesc& descOut) const;
+		// Encodes the dirty slots into descs, which has GetSlotCount() entries, and clears every dirty bit. Returns the amount of descs written.
+		uint32_t WriteDirtyDescs(RaytracingInstanceDesc* descs, uint32_t maxGap = 0u);
+		// Encodes every slot and clears every dirty bit.
+		void WriteAllDescs(RaytracingInstanceDesc* descs);
+		void ClearDirty();
+
+	private:
+		void MarkDirty(uint32_t slot);
+
+	private:
+		std::vector<InstanceTransform> m_transforms;
+		std::vector<uint64_t> m_blasAddresses;
+		std::vector<uint32_t> m_hitGroupOffsets;
+		std::vector<uint8_t> m_instanceMasks;
+		std::vector<uint8_t> m_flags;
+		std::vector<uint8_t> m_isActive;
+
+		// Sorted high to low, so that the lowest free slot is at the back.
+		std::vector<uint32_t> m_freeSlots;
+
+		// One bit per slot.
+		std::vector<uint64_t> m_dirtyWords;
+		uint32_t m_dirtyCount = 0u;
+		bool m_hasActivationChanges = false;
+
+		// Scratch of WriteDirtyDescs().
+		std::vector<InstanceRange> m_dirtyRanges;
+	};
+}
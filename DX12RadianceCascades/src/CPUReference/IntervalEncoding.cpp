@@ -0,0 +1,574 @@
+#include "IntervalEncoding.h"
+
+#include <bit>
+#include <cstring>
+#include <limits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPUREF_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CPUREF_USE_SSE2 0
+#endif
+
+namespace CPUReference
+{
+	namespace
+	{
+		// Half, float11 and float10 all have a 5 bit exponent with a bias of 15, they only differ in mantissa bits.
+		constexpr uint32_t SmallFloatExponentBias = 15u;
+		constexpr float SmallFloatMinNormal = 1.0f / 16384.0f; // 2^-14
+		// Values of the largest exponent are inf or NaN, every value from 2^16 and up decodes to one of them.
+		constexpr float SmallFloatInfThreshold = 65536.0f;
+
+		template<uint32_t MantissaBits>
+		constexpr float GetSmallFloatMax() { return float((2u << MantissaBits) - 1u) * float(1u << (15u - MantissaBits)); }
+
+		template<uint32_t MantissaBits>
+		constexpr uint32_t GetSmallFloatNaN() { return (0x1Fu << MantissaBits) | (1u << (MantissaBits - 1u)); }
+
+		// Adding a denormal to this lines its lowest mantissa bit up with the lowest bit of the small float denormal,
+		// so the FPU does the rounding to nearest even.
+		template<uint32_t MantissaBits>
+		constexpr uint32_t GetDenormMagicBits() { return ((127u - SmallFloatExponentBias) + (23u - MantissaBits) + 1u) << 23u; }
+
+		// Moves the exponent bias from 127 to 15, plus the rounding bias for the dropped mantissa bits.
+		template<uint32_t MantissaBits>
+		constexpr uint32_t GetRebiasBits() { return ((SmallFloatExponentBias - 127u) << 23u) + (1u << (22u - MantissaBits)) - 1u; }
+
+		// 2^(127 - 15), moves the exponent of a small float shifted into the float bits to the float bias.
+		constexpr uint32_t SmallFloatDecodeMagicBits = (254u - SmallFloatExponentBias) << 23u;
+
+		template<uint32_t MantissaBits>
+		uint32_t EncodeUnsignedSmallFloat(float value)
+		{
+			if (std::isnan(value))
+			{
+				return GetSmallFloatNaN<MantissaBits>();
+			}
+
+			value = (std::min)((std::max)(value, 0.0f), GetSmallFloatMax<MantissaBits>());
+
+			if (value < SmallFloatMinNormal)
+			{
+				const float denormMagic = std::bit_cast<float>(GetDenormMagicBits<MantissaBits>());
+				return std::bit_cast<uint32_t>(value + denormMagic) - GetDenormMagicBits<MantissaBits>();
+			}
+
+			uint32_t bits = std::bit_cast<uint32_t>(value);
+			const uint32_t mantissaOdd = (bits >> (23u - MantissaBits)) & 1u;
+			bits += GetRebiasBits<MantissaBits>() + mantissaOdd;
+
+			return bits >> (23u - MantissaBits);
+		}
+
+		template<uint32_t MantissaBits>
+		float DecodeUnsignedSmallFloat(uint32_t value)
+		{
+			const uint32_t exponentMantissa = value & ((1u << (5u + MantissaBits)) - 1u);
+			float result = std::bit_cast<float>(exponentMantissa << (23u - MantissaBits)) * std::bit_cast<float>(SmallFloatDecodeMagicBits);
+
+			if (result >= SmallFloatInfThreshold)
+			{
+				result = std::bit_cast<float>(std::bit_cast<uint32_t>(result) | 0x7F800000u);
+			}
+
+			return result;
+		}
+
+		constexpr float RGB9E5Max = 65408.0f; // (511 / 512) * 2^16
+		constexpr int32_t RGB9E5ExponentBias = 15;
+		constexpr int32_t RGB9E5MantissaBits = 9;
+		constexpr int32_t RGB9E5MinExponent = -RGB9E5ExponentBias - 1;
+
+		// 2^exponent for exponents that stay within the normal float range.
+		inline float Exp2(int32_t exponent) { return std::bit_cast<float>(uint32_t(exponent + 127) << 23u); }
+
+		uint32_t QuantizeRGB9E5Channel(float value, float scale) { return (uint32_t)(int32_t)(value * scale + 0.5f); }
+
+		void EncodeIntervalsFP16Scalar(const float4* texels, size_t count, uint8_t* colorOut)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint64_t packed =
+					uint64_t(EncodeHalf(texels[i].x)) |
+					uint64_t(EncodeHalf(texels[i].y)) << 16u |
+					uint64_t(EncodeHalf(texels[i].z)) << 32u |
+					uint64_t(EncodeHalf(texels[i].w)) << 48u;
+
+				std::memcpy(colorOut + i * sizeof(packed), &packed, sizeof(packed));
+			}
+		}
+
+		void DecodeIntervalsFP16Scalar(const uint8_t* color, size_t count, float4* texelsOut)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				uint64_t packed = 0u;
+				std::memcpy(&packed, color + i * sizeof(packed), sizeof(packed));
+
+				texelsOut[i] = float4(
+					DecodeHalf(uint16_t(packed)),
+					DecodeHalf(uint16_t(packed >> 16u)),
+					DecodeHalf(uint16_t(packed >> 32u)),
+					DecodeHalf(uint16_t(packed >> 48u))
+				);
+			}
+		}
+
+		template<uint32_t(*EncodeColor)(const float3&)>
+		void EncodePackedIntervalsScalar(const float4* texels, size_t count, uint8_t* colorOut, uint8_t* visibilityOut)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				const uint32_t packed = EncodeColor(texels[i].rgb());
+				std::memcpy(colorOut + i * sizeof(packed), &packed, sizeof(packed));
+				visibilityOut[i] = EncodeUnorm8(texels[i].w);
+			}
+		}
+
+		template<float3(*DecodeColor)(uint32_t)>
+		void DecodePackedIntervalsScalar(const uint8_t* color, const uint8_t* visibility, size_t count, float4* texelsOut)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				uint32_t packed = 0u;
+				std::memcpy(&packed, color + i * sizeof(packed), sizeof(packed));
+				texelsOut[i] = float4(DecodeColor(packed), DecodeUnorm8(visibility[i]));
+			}
+		}
+
+#if CPUREF_USE_SSE2
+		// Four texels at a time in structure of arrays form, one register per channel.
+		struct Texels4
+		{
+			__m128 r;
+			__m128 g;
+			__m128 b;
+			__m128 a;
+		};
+
+		Texels4 LoadTexels4(const float4* texels)
+		{
+			Texels4 result = {
+				_mm_loadu_ps(&texels[0].x),
+				_mm_loadu_ps(&texels[1].x),
+				_mm_loadu_ps(&texels[2].x),
+				_mm_loadu_ps(&texels[3].x)
+			};
+
+			_MM_TRANSPOSE4_PS(result.r, result.g, result.b, result.a);
+			return result;
+		}
+
+		void StoreTexels4(Texels4 texels, float4* texelsOut)
+		{
+			_MM_TRANSPOSE4_PS(texels.r, texels.g, texels.b, texels.a);
+
+			_mm_storeu_ps(&texelsOut[0].x, texels.r);
+			_mm_storeu_ps(&texelsOut[1].x, texels.g);
+			_mm_storeu_ps(&texelsOut[2].x, texels.b);
+			_mm_storeu_ps(&texelsOut[3].x, texels.a);
+		}
+
+		__m128i Select(__m128i mask, __m128i a, __m128i b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+		// Same steps as EncodeUnsignedSmallFloat(), the denormal and normal results are both computed and selected per lane.
+		template<uint32_t MantissaBits>
+		__m128i EncodeUnsignedSmallFloat4(__m128 value)
+		{
+			const __m128i nanMask = _mm_castps_si128(_mm_cmpunord_ps(value, value));
+			// Max returns the second operand for NaN lanes, those are overwritten below.
+			value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(GetSmallFloatMax<MantissaBits>()));
+
+			const __m128i denormMask = _mm_castps_si128(_mm_cmplt_ps(value, _mm_set1_ps(SmallFloatMinNormal)));
+			const __m128i denormMagicBits = _mm_set1_epi32((int32_t)GetDenormMagicBits<MantissaBits>());
+			const __m128i denormResult = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, _mm_castsi128_ps(denormMagicBits))), denormMagicBits);
+
+			__m128i bits = _mm_castps_si128(value);
+			const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 23 - MantissaBits), _mm_set1_epi32(1));
+			bits = _mm_add_epi32(bits, _mm_set1_epi32((int32_t)GetRebiasBits<MantissaBits>()));
+			const __m128i normalResult = _mm_srli_epi32(_mm_add_epi32(bits, mantissaOdd), 23 - MantissaBits);
+
+			const __m128i result = Select(denormMask, denormResult, normalResult);
+			return Select(nanMask, _mm_set1_epi32((int32_t)GetSmallFloatNaN<MantissaBits>()), result);
+		}
+
+		template<uint32_t MantissaBits>
+		__m128 DecodeUnsignedSmallFloat4(__m128i value)
+		{
+			const __m128i exponentMantissa = _mm_and_si128(value, _mm_set1_epi32((1 << (5 + MantissaBits)) - 1));
+			__m128 result = _mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 23 - MantissaBits));
+			result = _mm_mul_ps(result, _mm_castsi128_ps(_mm_set1_epi32((int32_t)SmallFloatDecodeMagicBits)));
+
+			const __m128 infMask = _mm_cmpge_ps(result, _mm_set1_ps(SmallFloatInfThreshold));
+			return _mm_or_ps(result, _mm_and_ps(infMask, _mm_castsi128_ps(_mm_set1_epi32(0x7F800000))));
+		}
+
+		__m128i EncodeHalf4(__m128 value)
+		{
+			const __m128i signMask = _mm_set1_epi32((int32_t)0x80000000u);
+			const __m128i sign = _mm_and_si128(_mm_castps_si128(value), signMask);
+			const __m128 absValue = _mm_castsi128_ps(_mm_andnot_si128(signMask, _mm_castps_si128(value)));
+
+			return _mm_or_si128(EncodeUnsignedSmallFloat4<10>(absValue), _mm_srli_epi32(sign, 16));
+		}
+
+		__m128 DecodeHalf4(__m128i value)
+		{
+			const __m128i sign = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x8000)), 16);
+			return _mm_or_ps(DecodeUnsignedSmallFloat4<10>(value), _mm_castsi128_ps(sign));
+		}
+
+		__m128i EncodeR11G11B10x4(const Texels4& texels)
+		{
+			const __m128i r = EncodeUnsignedSmallFloat4<6>(texels.r);
+			const __m128i g = EncodeUnsignedSmallFloat4<6>(texels.g);
+			const __m128i b = EncodeUnsignedSmallFloat4<5>(texels.b);
+
+			return _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 11), _mm_slli_epi32(b, 22)));
+		}
+
+		void DecodeR11G11B10x4(__m128i packed, Texels4& texelsOut)
+		{
+			texelsOut.r = DecodeUnsignedSmallFloat4<6>(packed);
+			texelsOut.g = DecodeUnsignedSmallFloat4<6>(_mm_srli_epi32(packed, 11));
+			texelsOut.b = DecodeUnsignedSmallFloat4<5>(_mm_srli_epi32(packed, 22));
+		}
+
+		// 2^exponent per lane, the exponents have to stay within the normal float range.
+		__m128 Exp2x4(__m128i exponent) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23)); }
+
+		__m128i QuantizeRGB9E5Channel4(__m128 value, __m128 scale) { return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), _mm_set1_ps(0.5f))); }
+
+		__m128i EncodeRGB9E5x4(const Texels4& texels)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 maxValue = _mm_set1_ps(RGB9E5Max);
+			const __m128 r = _mm_min_ps(_mm_max_ps(texels.r, zero), maxValue);
+			const __m128 g = _mm_min_ps(_mm_max_ps(texels.g, zero), maxValue);
+			const __m128 b = _mm_min_ps(_mm_max_ps(texels.b, zero), maxValue);
+			const __m128 maxChannel = _mm_max_ps(r, _mm_max_ps(g, b));
+
+			// floor(log2()) of the largest channel from its exponent bits, clamped to the smallest shared exponent. SSE2 has no max_epi32.
+			__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), _mm_set1_epi32(127));
+			const __m128i minExponent = _mm_set1_epi32(RGB9E5MinExponent);
+			exponent = Select(_mm_cmplt_epi32(exponent, minExponent), minExponent, exponent);
+
+			__m128i sharedExponent = _mm_add_epi32(exponent, _mm_set1_epi32(RGB9E5ExponentBias + 1));
+			const __m128i scaleBias = _mm_set1_epi32(RGB9E5ExponentBias + RGB9E5MantissaBits);
+			__m128 scale = Exp2x4(_mm_sub_epi32(scaleBias, sharedExponent));
+
+			// Rounding can carry the largest channel into a 10th bit, it then needs the next exponent.
+			const __m128i carryMask = _mm_cmpeq_epi32(QuantizeRGB9E5Channel4(maxChannel, scale), _mm_set1_epi32(1 << RGB9E5MantissaBits));
+			sharedExponent = _mm_sub_epi32(sharedExponent, carryMask);
+			scale = Exp2x4(_mm_sub_epi32(scaleBias, sharedExponent));
+
+			const __m128i rm = QuantizeRGB9E5Channel4(r, scale);
+			const __m128i gm = QuantizeRGB9E5Channel4(g, scale);
+			const __m128i bm = QuantizeRGB9E5Channel4(b, scale);
+
+			return _mm_or_si128(_mm_or_si128(rm, _mm_slli_epi32(gm, 9)), _mm_or_si128(_mm_slli_epi32(bm, 18), _mm_slli_epi32(sharedExponent, 27)));
+		}
+
+		void DecodeRGB9E5x4(__m128i packed, Texels4& texelsOut)
+		{
+			const __m128i mantissaMask = _mm_set1_epi32((1 << RGB9E5MantissaBits) - 1);
+			const __m128 scale = Exp2x4(_mm_sub_epi32(_mm_srli_epi32(packed, 27), _mm_set1_epi32(RGB9E5ExponentBias + RGB9E5MantissaBits)));
+
+			texelsOut.r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mantissaMask)), scale);
+			texelsOut.g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 9), mantissaMask)), scale);
+			texelsOut.b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 18), mantissaMask)), scale);
+		}
+
+		// Writes 4 bytes.
+		void EncodeUnorm8x4(__m128 value, uint8_t* out)
+		{
+			value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			const __m128i quantized = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+			const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(quantized, quantized), _mm_setzero_si128());
+
+			const int32_t bytes = _mm_cvtsi128_si32(packed);
+			std::memcpy(out, &bytes, sizeof(bytes));
+		}
+
+		// Reads 4 bytes.
+		__m128 DecodeUnorm8x4(const uint8_t* value)
+		{
+			int32_t bytes = 0;
+			std::memcpy(&bytes, value, sizeof(bytes));
+
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+			return _mm_div_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(255.0f));
+		}
+
+		// Returns the amount of texels written, the rest is left to the scalar path.
+		size_t EncodeIntervalsFP16SSE2(const float4* texels, size_t count, uint8_t* colorOut)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const Texels4 texels4 = LoadTexels4(texels + i);
+
+				const __m128i rg = _mm_or_si128(EncodeHalf4(texels4.r), _mm_slli_epi32(EncodeHalf4(texels4.g), 16));
+				const __m128i ba = _mm_or_si128(EncodeHalf4(texels4.b), _mm_slli_epi32(EncodeHalf4(texels4.a), 16));
+
+				_mm_storeu_si128((__m128i*)(colorOut + i * sizeof(uint64_t)), _mm_unpacklo_epi32(rg, ba));
+				_mm_storeu_si128((__m128i*)(colorOut + (i + 2) * sizeof(uint64_t)), _mm_unpackhi_epi32(rg, ba));
+			}
+
+			return i;
+		}
+
+		size_t DecodeIntervalsFP16SSE2(const uint8_t* color, size_t count, float4* texelsOut)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				// Texels 0, 1 and 2, 3 as rg, ba pairs, reordered to rg0 rg1 ba0 ba1 before splitting into rg and ba.
+				const __m128i texels01 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(color + i * sizeof(uint64_t))), _MM_SHUFFLE(3, 1, 2, 0));
+				const __m128i texels23 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(color + (i + 2) * sizeof(uint64_t))), _MM_SHUFFLE(3, 1, 2, 0));
+				const __m128i rg = _mm_unpacklo_epi64(texels01, texels23);
+				const __m128i ba = _mm_unpackhi_epi64(texels01, texels23);
+
+				const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+				Texels4 texels4 = {
+					DecodeHalf4(_mm_and_si128(rg, lowMask)),
+					DecodeHalf4(_mm_srli_epi32(rg, 16)),
+					DecodeHalf4(_mm_and_si128(ba, lowMask)),
+					DecodeHalf4(_mm_srli_epi32(ba, 16))
+				};
+
+				StoreTexels4(texels4, texelsOut + i);
+			}
+
+			return i;
+		}
+
+		template<__m128i(*EncodeColor4)(const Texels4&)>
+		size_t EncodePackedIntervalsSSE2(const float4* texels, size_t count, uint8_t* colorOut, uint8_t* visibilityOut)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const Texels4 texels4 = LoadTexels4(texels + i);
+
+				_mm_storeu_si128((__m128i*)(colorOut + i * sizeof(uint32_t)), EncodeColor4(texels4));
+				EncodeUnorm8x4(texels4.a, visibilityOut + i);
+			}
+
+			return i;
+		}
+
+		template<void(*DecodeColor4)(__m128i, Texels4&)>
+		size_t DecodePackedIntervalsSSE2(const uint8_t* color, const uint8_t* visibility, size_t count, float4* texelsOut)
+		{
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				Texels4 texels4 = {};
+				DecodeColor4(_mm_loadu_si128((const __m128i*)(color + i * sizeof(uint32_t))), texels4);
+				texels4.a = DecodeUnorm8x4(visibility + i);
+
+				StoreTexels4(texels4, texelsOut + i);
+			}
+
+			return i;
+		}
+#endif
+	}
+
+	const char* GetIntervalFormatName(IntervalFormat format)
+	{
+		switch (format)
+		{
+		case IntervalFormatFP16: return "FP16";
+		case IntervalFormatR11G11B10: return "R11G11B10";
+		case IntervalFormatRGB9E5: return "RGB9E5";
+		default: return "Unknown";
+		}
+	}
+
+	uint32_t GetIntervalColorBytes(IntervalFormat format)
+	{
+		return format == IntervalFormatFP16 ? 8u : 4u;
+	}
+
+	uint32_t GetIntervalVisibilityBytes(IntervalFormat format)
+	{
+		return format == IntervalFormatFP16 ? 0u : 1u;
+	}
+
+	uint16_t EncodeHalf(float value)
+	{
+		const uint32_t sign = std::bit_cast<uint32_t>(value) & 0x80000000u;
+		return uint16_t(EncodeUnsignedSmallFloat<10>(std::fabs(value)) | (sign >> 16u));
+	}
+
+	float DecodeHalf(uint16_t value)
+	{
+		const uint32_t sign = uint32_t(value & 0x8000u) << 16u;
+		return std::bit_cast<float>(std::bit_cast<uint32_t>(DecodeUnsignedSmallFloat<10>(value)) | sign);
+	}
+
+	uint32_t EncodeR11G11B10(const float3& value)
+	{
+		return EncodeUnsignedSmallFloat<6>(value.x) | (EncodeUnsignedSmallFloat<6>(value.y) << 11u) | (EncodeUnsignedSmallFloat<5>(value.z) << 22u);
+	}
+
+	float3 DecodeR11G11B10(uint32_t value)
+	{
+		return float3(DecodeUnsignedSmallFloat<6>(value), DecodeUnsignedSmallFloat<6>(value >> 11u), DecodeUnsignedSmallFloat<5>(value >> 22u));
+	}
+
+	uint32_t EncodeRGB9E5(const float3& value)
+	{
+		// Max with 0 first so that NaN becomes 0.
+		const float r = (std::min)((std::max)(0.0f, value.x), RGB9E5Max);
+		const float g = (std::min)((std::max)(0.0f, value.y), RGB9E5Max);
+		const float b = (std::min)((std::max)(0.0f, value.z), RGB9E5Max);
+		const float maxChannel = (std::max)(r, (std::max)(g, b));
+
+		const int32_t exponent = (std::max)(int32_t(std::bit_cast<uint32_t>(maxChannel) >> 23u) - 127, RGB9E5MinExponent);
+		int32_t sharedExponent = exponent + RGB9E5ExponentBias + 1;
+		float scale = Exp2(RGB9E5ExponentBias + RGB9E5MantissaBits - sharedExponent);
+
+		// Rounding can carry the largest channel into a 10th bit, it then needs the next exponent.
+		if (QuantizeRGB9E5Channel(maxChannel, scale) == (1u << RGB9E5MantissaBits))
+		{
+			sharedExponent++;
+			scale = Exp2(RGB9E5ExponentBias + RGB9E5MantissaBits - sharedExponent);
+		}
+
+		return QuantizeRGB9E5Channel(r, scale) | (QuantizeRGB9E5Channel(g, scale) << 9u) | (QuantizeRGB9E5Channel(b, scale) << 18u) | (uint32_t(sharedExponent) << 27u);
+	}
+
+	float3 DecodeRGB9E5(uint32_t value)
+	{
+		const uint32_t mantissaMask = (1u << RGB9E5MantissaBits) - 1u;
+		const float scale = Exp2(int32_t(value >> 27u) - RGB9E5ExponentBias - RGB9E5MantissaBits);
+
+		return float3(float(value & mantissaMask) * scale, float((value >> 9u) & mantissaMask) * scale, float((value >> 18u) & mantissaMask) * scale);
+	}
+
+	uint8_t EncodeUnorm8(float value)
+	{
+		value = (std::min)((std::max)(0.0f, value), 1.0f);
+		return uint8_t(value * 255.0f + 0.5f);
+	}
+
+	float DecodeUnorm8(uint8_t value)
+	{
+		return float(value) / 255.0f;
+	}
+
+	void EncodeIntervals(IntervalFormat format, const float4* texels, size_t count, void* colorOut, uint8_t* visibilityOut)
+	{
+		uint8_t* colorBytes = (uint8_t*)colorOut;
+		const size_t colorStride = GetIntervalColorBytes(format);
+
+		size_t i = 0;
+		switch (format)
+		{
+		case IntervalFormatFP16:
+#if CPUREF_USE_SSE2
+			i = EncodeIntervalsFP16SSE2(texels, count, colorBytes);
+#endif
+			EncodeIntervalsFP16Scalar(texels + i, count - i, colorBytes + i * colorStride);
+			break;
+		case IntervalFormatR11G11B10:
+#if CPUREF_USE_SSE2
+			i = EncodePackedIntervalsSSE2<EncodeR11G11B10x4>(texels, count, colorBytes, visibilityOut);
+#endif
+			EncodePackedIntervalsScalar<EncodeR11G11B10>(texels + i, count - i, colorBytes + i * colorStride, visibilityOut + i);
+			break;
+		case IntervalFormatRGB9E5:
+#if CPUREF_USE_SSE2
+			i = EncodePackedIntervalsSSE2<EncodeRGB9E5x4>(texels, count, colorBytes, visibilityOut);
+#endif
+			EncodePackedIntervalsScalar<EncodeRGB9E5>(texels + i, count - i, colorBytes + i * colorStride, visibilityOut + i);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void DecodeIntervals(IntervalFormat format, const void* color, const uint8_t* visibility, size_t count, float4* texelsOut)
+	{
+		const uint8_t* colorBytes = (const uint8_t*)color;
+		const size_t colorStride = GetIntervalColorBytes(format);
+
+		size_t i = 0;
+		switch (format)
+		{
+		case IntervalFormatFP16:
+#if CPUREF_USE_SSE2
+			i = DecodeIntervalsFP16SSE2(colorBytes, count, texelsOut);
+#endif
+			DecodeIntervalsFP16Scalar(colorBytes + i * colorStride, count - i, texelsOut + i);
+			break;
+		case IntervalFormatR11G11B10:
+#if CPUREF_USE_SSE2
+			i = DecodePackedIntervalsSSE2<DecodeR11G11B10x4>(colorBytes, visibility, count, texelsOut);
+#endif
+			DecodePackedIntervalsScalar<DecodeR11G11B10>(colorBytes + i * colorStride, visibility + i, count - i, texelsOut + i);
+			break;
+		case IntervalFormatRGB9E5:
+#if CPUREF_USE_SSE2
+			i = DecodePackedIntervalsSSE2<DecodeRGB9E5x4>(colorBytes, visibility, count, texelsOut);
+#endif
+			DecodePackedIntervalsScalar<DecodeRGB9E5>(colorBytes + i * colorStride, visibility + i, count - i, texelsOut + i);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void QuantizeIntervals(IntervalFormat format, float4* texels, size_t count)
+	{
+		// Large enough for any format, small enough to stay on the stack.
+		constexpr size_t ChunkSize = 256u;
+		uint64_t color[ChunkSize];
+		uint8_t visibility[ChunkSize];
+
+		for (size_t i = 0; i < count; i += ChunkSize)
+		{
+			const size_t chunkCount = (std::min)(ChunkSize, count - i);
+			EncodeIntervals(format, texels + i, chunkCount, color, visibility);
+			DecodeIntervals(format, color, visibility, chunkCount, texels + i);
+		}
+	}
+
+	double ComputePSNR(const float4* reference, const float4* test, size_t count)
+	{
+		double squaredErrorSum = 0.0;
+		double peak = 0.0;
+		size_t channelCount = 0u;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int32_t c = 0; c < 3; c++)
+			{
+				const double referenceValue = reference[i][c];
+				if (!std::isfinite(referenceValue))
+				{
+					continue;
+				}
+
+				const double error = referenceValue - test[i][c];
+				squaredErrorSum += error * error;
+				peak = (std::max)(peak, std::fabs(referenceValue));
+				channelCount++;
+			}
+		}
+
+		if (channelCount == 0u || squaredErrorSum == 0.0)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+
+		const double meanSquaredError = squaredErrorSum / channelCount;
+		return 10.0 * std::log10(peak * peak / meanSquaredError);
+	}
+}
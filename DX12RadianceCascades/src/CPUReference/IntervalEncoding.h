@@ -0,0 +1,51 @@
+#pragma once
+
+// Storage formats for cascade intervals, shared by the GPU (see RC3DSettings::StaticParameters) and the CPU reference.
+// The packed formats only store radiance in their 32 bit word, visibility (alpha) goes to a separate 8 bit unorm plane.
+// Visibility is not 1 bit: with pre-averaged intervals it is the fraction of unoccluded rays of a texel.
+
+#include "ReferenceMath.h"
+
+#include <cstdint>
+
+namespace CPUReference
+{
+	enum IntervalFormat : uint32_t
+	{
+		IntervalFormatFP16 = 0, // R16G16B16A16_FLOAT, 8 bytes per probe-direction.
+		IntervalFormatR11G11B10, // R11G11B10_FLOAT + R8_UNORM visibility, 5 bytes per probe-direction.
+		IntervalFormatRGB9E5, // R9G9B9E5_SHAREDEXP + R8_UNORM visibility, 5 bytes per probe-direction. Not a UAV format, CPU only.
+
+		IntervalFormatCount // Keep last!
+	};
+
+	const char* GetIntervalFormatName(IntervalFormat format);
+	// Bytes of the color word, including alpha for formats without a visibility plane.
+	uint32_t GetIntervalColorBytes(IntervalFormat format);
+	uint32_t GetIntervalVisibilityBytes(IntervalFormat format);
+	inline uint32_t GetIntervalTexelBytes(IntervalFormat format) { return GetIntervalColorBytes(format) + GetIntervalVisibilityBytes(format); }
+	inline bool HasVisibilityPlane(IntervalFormat format) { return GetIntervalVisibilityBytes(format) > 0u; }
+
+	// Scalar conversions. Floats are rounded to nearest even and clamped to the largest finite value of the format,
+	// negative values become 0 in the unsigned formats. NaN stays NaN, except in RGB9E5 and unorm which have no NaN and store 0.
+	uint16_t EncodeHalf(float value);
+	float DecodeHalf(uint16_t value);
+	uint32_t EncodeR11G11B10(const float3& value);
+	float3 DecodeR11G11B10(uint32_t value);
+	// Same algorithm as the D3D conversion to R9G9B9E5_SHAREDEXP, the exponent comes from the largest channel.
+	uint32_t EncodeRGB9E5(const float3& value);
+	float3 DecodeRGB9E5(uint32_t value);
+	uint8_t EncodeUnorm8(float value);
+	float DecodeUnorm8(uint8_t value);
+
+	// Batch conversions of count texels, SSE2 if available with a scalar tail. Results are identical to the scalar functions.
+	// colorOut holds GetIntervalColorBytes() per texel and visibilityOut one byte per texel, it is not written for IntervalFormatFP16.
+	void EncodeIntervals(IntervalFormat format, const float4* texels, size_t count, void* colorOut, uint8_t* visibilityOut);
+	void DecodeIntervals(IntervalFormat format, const void* color, const uint8_t* visibility, size_t count, float4* texelsOut);
+	// Encodes and decodes in place, which is what a store to and a load from a cascade in the format does to the texels.
+	void QuantizeIntervals(IntervalFormat format, float4* texels, size_t count);
+
+	// Peak signal to noise ratio of the rgb channels of test against reference, with the largest reference channel as the peak.
+	// Returns infinity if they are equal. Non finite reference texels are skipped.
+	double ComputePSNR(const float4* reference, const float4* test, size_t count);
+}
@@ -0,0 +1,115 @@
+#include "MultiViewReferencePipeline.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CPUReference
+{
+	MultiViewReferencePipeline::MultiViewReferencePipeline(TaskPool& taskPool) : m_taskPool(taskPool), m_sharedPipeline(taskPool)
+	{
+	}
+
+	void MultiViewReferencePipeline::Generate(const ReferenceSettings& settings, uint32_t viewCount, uint32_t sharedCascadeBegin)
+	{
+		assert(!settings.useStaggeredUpdates);
+		assert(sharedCascadeBegin > 0u);
+
+		m_layout.Generate(settings.layoutDesc);
+		m_sharedCascadeBegin = (std::min)(sharedCascadeBegin, m_layout.GetCascadeCount());
+
+		if (IsSharingCascades())
+		{
+			m_sharedPipeline.Generate(settings);
+		}
+
+		m_viewPipelines.clear();
+		for (uint32_t i = 0; i < viewCount; i++)
+		{
+			m_viewPipelines.push_back(std::make_unique<ReferencePipeline>(m_taskPool));
+			m_viewPipelines.back()->Generate(settings);
+		}
+	}
+
+	void MultiViewReferencePipeline::Run(const RayTracer& tracer, const ReferenceView& sharedView, const std::vector<ReferenceView>& views)
+	{
+		assert(views.size() == m_viewPipelines.size());
+
+		for (uint32_t i = 0; i < GetViewCount(); i++)
+		{
+			m_viewPipelines[i]->RunGatherCascades(0u, m_sharedCascadeBegin, nullptr, tracer, views[i].camera, views[i].depth);
+		}
+
+		if (IsSharingCascades())
+		{
+			// The lowest shared cascade is only gathered where the merge of any view needs it.
+			const bool useGatherFiltering = m_sharedPipeline.GetSettings().useGatherFiltering;
+			if (useGatherFiltering)
+			{
+				const CascadeLevel& sharedLevel = m_layout.GetLevel(m_sharedCascadeBegin);
+				m_sharedGatherFilter.Create(sharedLevel.textureWidth, sharedLevel.textureHeight);
+				for (uint32_t i = 0; i < GetViewCount(); i++)
+				{
+					m_viewPipelines[i]->ReprojectGatherFilterTo(m_sharedCascadeBegin, views[i].camera, views[i].depth, sharedView.camera, m_sharedGatherFilter);
+				}
+			}
+
+			m_sharedPipeline.RunGatherCascades(m_sharedCascadeBegin, m_layout.GetCascadeCount(), useGatherFiltering ? &m_sharedGatherFilter : nullptr,
+				tracer, sharedView.camera, sharedView.depth);
+		}
+
+		for (uint32_t i = 0; i < GetViewCount(); i++)
+		{
+			ReferencePipeline& viewPipeline = *m_viewPipelines[i];
+			const ReferenceView& view = views[i];
+
+			if (IsSharingCascades())
+			{
+				viewPipeline.ReprojectCascadesFrom(m_sharedPipeline, sharedView.camera, sharedView.depth, m_sharedCascadeBegin, view.camera, view.depth);
+			}
+
+			viewPipeline.RunMerge(view.camera, view.depth);
+
+			// Otherwise written by the merge of cascade 0.
+			if (!viewPipeline.UsesFusedMergeCoalesce())
+			{
+				viewPipeline.RunCoalesce();
+			}
+		}
+	}
+
+	uint64_t MultiViewReferencePipeline::GetViewTracedRayCount(uint32_t viewIndex) const
+	{
+		uint64_t tracedRayCount = 0u;
+		for (uint32_t i = 0; i < m_sharedCascadeBegin; i++)
+		{
+			tracedRayCount += m_viewPipelines[viewIndex]->GetTracedRayCount(i);
+		}
+
+		return tracedRayCount;
+	}
+
+	uint64_t MultiViewReferencePipeline::GetSharedTracedRayCount() const
+	{
+		uint64_t tracedRayCount = 0u;
+		if (IsSharingCascades())
+		{
+			for (uint32_t i = m_sharedCascadeBegin; i < m_layout.GetCascadeCount(); i++)
+			{
+				tracedRayCount += m_sharedPipeline.GetTracedRayCount(i);
+			}
+		}
+
+		return tracedRayCount;
+	}
+
+	uint64_t MultiViewReferencePipeline::GetTracedRayCount() const
+	{
+		uint64_t tracedRayCount = GetSharedTracedRayCount();
+		for (uint32_t i = 0; i < GetViewCount(); i++)
+		{
+			tracedRayCount += GetViewTracedRayCount(i);
+		}
+
+		return tracedRayCount;
+	}
+}
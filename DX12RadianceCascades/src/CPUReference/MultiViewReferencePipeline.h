@@ -0,0 +1,64 @@
+#pragma once
+
+// Runs the reference pipeline for several views of the same scene, like the two eyes of a headset or split screen, while gathering the
+// upper cascades only once. Cascades below the shared cascade begin are gathered by every view. The ones above cover long intervals
+// far from the probe and are close to view independent, they are gathered once from a shared view and reprojected to the probes of
+// every view before it merges, same as the history of staggered updates. The gather filters the views write for the lowest shared cascade
+// are reprojected to the shared view and combined, so the shared probes only trace what at least one view merges. The shared view should see everything the views see,
+// e.g. a camera between the eyes with a slightly wider field of view. Views whose probes fall outside of it take the closest probe on the edge.
+
+#include "ReferencePipeline.h"
+
+#include <memory>
+#include <vector>
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	struct ReferenceView
+	{
+		ReferenceCamera camera;
+		// Rendered from the camera, has the size of the layout.
+		DepthTexture depth;
+	};
+
+	class MultiViewReferencePipeline
+	{
+	public:
+		explicit MultiViewReferencePipeline(TaskPool& taskPool);
+
+		// Cascades from sharedCascadeBegin up are shared, it has to be at least 1 as cascade 0 is the most view dependent.
+		// A begin of at least the cascade count shares nothing and every view runs the whole pipeline. Staggered updates are not supported.
+		void Generate(const ReferenceSettings& settings, uint32_t viewCount, uint32_t sharedCascadeBegin);
+
+		// The shared view is ignored if nothing is shared.
+		void Run(const RayTracer& tracer, const ReferenceView& sharedView, const std::vector<ReferenceView>& views);
+
+		const CascadeLayout& GetLayout() const { return m_layout; }
+		uint32_t GetViewCount() const { return (uint32_t)m_viewPipelines.size(); }
+		uint32_t GetSharedCascadeBegin() const { return m_sharedCascadeBegin; }
+		bool IsSharingCascades() const { return m_sharedCascadeBegin < m_layout.GetCascadeCount(); }
+
+		const RadianceTexture& GetCoalescedResult(uint32_t viewIndex) const { return m_viewPipelines[viewIndex]->GetCoalescedResult(); }
+
+		// Rays traced during the last run by the view itself, counts every pre-averaged sub ray.
+		uint64_t GetViewTracedRayCount(uint32_t viewIndex) const;
+		// Rays traced once for the shared cascades during the last run.
+		uint64_t GetSharedTracedRayCount() const;
+		uint64_t GetTracedRayCount() const;
+
+	private:
+		TaskPool& m_taskPool;
+
+		CascadeLayout m_layout;
+		// Only generated if cascades are shared.
+		ReferencePipeline m_sharedPipeline;
+		// ReferencePipeline can not be moved, as it holds atomics.
+		std::vector<std::unique_ptr<ReferencePipeline>> m_viewPipelines;
+		// Gather filter of the lowest shared cascade, the texels the views need reprojected to the shared view.
+		PackedGatherFilter m_sharedGatherFilter;
+
+		uint32_t m_sharedCascadeBegin = 0u;
+	};
+}
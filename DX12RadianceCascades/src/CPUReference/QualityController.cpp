@@ -0,0 +1,149 @@
+#include "QualityController.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CPUReference
+{
+	void QualityController::SetDesc(const QualityControllerDesc& desc, uint32_t staticStep)
+	{
+		assert(!desc.staticSteps.empty());
+
+		m_desc = desc;
+		m_staticStep = (std::min)(staticStep, (uint32_t)m_desc.staticSteps.size() - 1u);
+
+		BuildLevels();
+		m_level = 0u;
+
+		m_staticPressureFrameCount = 0;
+		m_framesSinceStaticChange = 0u;
+		BeginSettling();
+	}
+
+	QualityUpdate QualityController::Update(float gatherMs, float mergeMs)
+	{
+		QualityUpdate update;
+
+		m_framesSinceStaticChange = (std::min)(m_framesSinceStaticChange + 1u, m_desc.staticCooldownFrameCount);
+
+		if (m_settleFramesLeft > 0u)
+		{
+			m_settleFramesLeft--;
+			return update;
+		}
+
+		const float frameMs = gatherMs + mergeMs;
+		m_smoothedMs = m_smoothedSampleCount > 0u ? m_smoothedMs + (frameMs - m_smoothedMs) * m_desc.smoothingFactor : frameMs;
+		m_smoothedSampleCount++;
+
+		if (m_smoothedSampleCount < m_desc.settleFrameCount)
+		{
+			return update;
+		}
+
+		const bool isOverBudget = m_smoothedMs > m_desc.budgetMs * (1.0f + m_desc.overBudgetMargin);
+		const bool isUnderBudget = m_smoothedMs < m_desc.budgetMs * (1.0f - m_desc.underBudgetMargin);
+		const uint32_t lowestLevel = GetLevelCount() - 1u;
+
+		if ((isOverBudget && m_level < lowestLevel) || (isUnderBudget && m_level > 0u))
+		{
+			// Short spikes are left alone.
+			m_staticPressureFrameCount = 0;
+			if (++m_levelPressureFrameCount < m_desc.levelChangeFrameCount)
+			{
+				return update;
+			}
+
+			m_level = isOverBudget ? m_level + 1u : m_level - 1u;
+			BeginSettling();
+
+			update.knobsChanged = true;
+			return update;
+		}
+
+		m_levelPressureFrameCount = 0u;
+
+		// Only once the runtime settings are out of room in the direction the time is pushing.
+		if (isOverBudget && m_level == lowestLevel)
+		{
+			m_staticPressureFrameCount = (std::max)(m_staticPressureFrameCount, 0) + 1;
+		}
+		else if (m_smoothedMs < m_desc.budgetMs * (1.0f - m_desc.staticUnderBudgetMargin) && m_level == 0u)
+		{
+			m_staticPressureFrameCount = (std::min)(m_staticPressureFrameCount, 0) - 1;
+		}
+		else
+		{
+			m_staticPressureFrameCount = 0;
+		}
+
+		if (m_framesSinceStaticChange < m_desc.staticCooldownFrameCount)
+		{
+			return update;
+		}
+
+		const int32_t staticChangeFrameCount = (int32_t)m_desc.staticChangeFrameCount;
+		if (m_staticPressureFrameCount >= staticChangeFrameCount && m_staticStep + 1u < (uint32_t)m_desc.staticSteps.size())
+		{
+			m_staticStep++;
+			update.staticParamsChanged = true;
+		}
+		else if (m_staticPressureFrameCount <= -staticChangeFrameCount && m_staticStep > 0u)
+		{
+			m_staticStep--;
+			update.staticParamsChanged = true;
+		}
+
+		if (update.staticParamsChanged)
+		{
+			m_staticPressureFrameCount = 0;
+			m_framesSinceStaticChange = 0u;
+			BeginSettling();
+		}
+
+		return update;
+	}
+
+	void QualityController::BuildLevels()
+	{
+		QualityKnobs knobs = m_desc.maxKnobs;
+		m_levels.assign(1u, knobs);
+
+		if (!knobs.useGatherFiltering)
+		{
+			knobs.useGatherFiltering = true;
+			m_levels.push_back(knobs);
+		}
+
+		if (m_desc.canStaggerUpdates)
+		{
+			while (knobs.updatePeriodLog2 < m_desc.maxUpdatePeriodLog2)
+			{
+				knobs.updatePeriodLog2++;
+				m_levels.push_back(knobs);
+			}
+		}
+
+		if (m_desc.rayLengthStep > 0.0f && m_desc.rayLengthStep < 1.0f)
+		{
+			while (knobs.rayLength0 * m_desc.rayLengthStep >= m_desc.minRayLength0)
+			{
+				knobs.rayLength0 *= m_desc.rayLengthStep;
+				m_levels.push_back(knobs);
+			}
+		}
+
+		while (knobs.activeCascadeCount > (std::max)(m_desc.minActiveCascadeCount, 1u))
+		{
+			knobs.activeCascadeCount--;
+			m_levels.push_back(knobs);
+		}
+	}
+
+	void QualityController::BeginSettling()
+	{
+		m_settleFramesLeft = m_desc.settleFrameCount;
+		m_smoothedSampleCount = 0u;
+		m_levelPressureFrameCount = 0u;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+// Holds the GPU time of the radiance cascades to a budget by stepping through quality levels of cheap runtime settings.
+// Settings that need the cascades to be regenerated, which idles the GPU, are only changed after the time has been out of budget
+// for a long while with every runtime setting at its limit, and not again until a cooldown has passed. See Tests/QualityControllerTests.cpp.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Runtime settings, changing them costs nothing.
+	struct QualityKnobs
+	{
+		bool useGatherFiltering = true;
+		// Max refresh period log2 of the upper cascades with staggered updates, see CascadeUpdateScheduleDesc.
+		// Together with round robin rows only a subset of the probe rows of the upper cascades is gathered each frame.
+		uint32_t updatePeriodLog2 = 0u;
+		float rayLength0 = 5.0f;
+		// Cascades above are not gathered or merged, the last active one samples the sky on a miss instead.
+		uint32_t activeCascadeCount = 1u;
+	};
+
+	// Settings that need the cascades to be regenerated.
+	struct QualityStaticParams
+	{
+		uint32_t raysPerProbe0 = 16u;
+		uint32_t probeSpacing0 = 2u;
+	};
+
+	struct QualityControllerDesc
+	{
+		float budgetMs = 4.0f;
+		// Steps down a level above budget * (1 + overBudgetMargin) and up a level below budget * (1 - underBudgetMargin).
+		// The gap between the two keeps levels from flipping back and forth around the budget.
+		float overBudgetMargin = 0.0f;
+		float underBudgetMargin = 0.2f;
+		// Frames in a row out of budget before a level change.
+		uint32_t levelChangeFrameCount = 8u;
+		// Weight of a new sample in the smoothed time.
+		float smoothingFactor = 0.1f;
+		// Samples skipped after a change, until the GPU times show it. The smoothed time starts over after them
+		// and is acted on once it has as many samples again.
+		uint32_t settleFrameCount = 8u;
+
+		// Level 0, the lower levels are built from it in the order the settings below are listed.
+		QualityKnobs maxKnobs;
+		bool canStaggerUpdates = false;
+		uint32_t maxUpdatePeriodLog2 = 3u;
+		// Each level shortens the rays of cascade 0 by rayLengthStep, the other cascades follow.
+		float rayLengthStep = 0.8f;
+		float minRayLength0 = 1.0f;
+		uint32_t minActiveCascadeCount = 3u;
+
+		// From most to least expensive, the controller moves one step at a time.
+		std::vector<QualityStaticParams> staticSteps;
+		// Frames in a row over budget at the lowest level, or below budget * (1 - staticUnderBudgetMargin) at level 0, before a static step.
+		uint32_t staticChangeFrameCount = 120u;
+		float staticUnderBudgetMargin = 0.5f;
+		// Frames after a static step before the next one.
+		uint32_t staticCooldownFrameCount = 600u;
+	};
+
+	struct QualityUpdate
+	{
+		bool knobsChanged = false;
+		// The cascades have to be regenerated with GetStaticParams().
+		bool staticParamsChanged = false;
+	};
+
+	class QualityController
+	{
+	public:
+		QualityController() = default;
+
+		// Builds the levels and starts over at level 0 with the given static step.
+		void SetDesc(const QualityControllerDesc& desc, uint32_t staticStep);
+		const QualityControllerDesc& GetDesc() const { return m_desc; }
+
+		// GPU times of the last frame, called once per frame.
+		QualityUpdate Update(float gatherMs, float mergeMs);
+
+		const QualityKnobs& GetKnobs() const { return m_levels[m_level]; }
+		const QualityStaticParams& GetStaticParams() const { return m_desc.staticSteps[m_staticStep]; }
+
+		uint32_t GetLevel() const { return m_level; }
+		uint32_t GetLevelCount() const { return (uint32_t)m_levels.size(); }
+		uint32_t GetStaticStep() const { return m_staticStep; }
+		// 0 until there have been samples since the last change.
+		float GetSmoothedMs() const { return m_smoothedSampleCount > 0u ? m_smoothedMs : 0.0f; }
+
+	private:
+		void BuildLevels();
+		// Skips the samples of the next settleFrameCount frames and starts the smoothed time over.
+		void BeginSettling();
+
+	private:
+		QualityControllerDesc m_desc;
+		std::vector<QualityKnobs> m_levels;
+
+		uint32_t m_level = 0u;
+		uint32_t m_staticStep = 0u;
+
+		float m_smoothedMs = 0.0f;
+		uint32_t m_smoothedSampleCount = 0u;
+		uint32_t m_settleFramesLeft = 0u;
+		uint32_t m_levelPressureFrameCount = 0u;
+
+		// Frames in a row that count towards a static step, negative below budget and positive above.
+		int32_t m_staticPressureFrameCount = 0;
+		uint32_t m_framesSinceStaticChange = 0u;
+	};
+}
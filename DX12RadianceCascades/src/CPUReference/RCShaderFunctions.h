@@ -0,0 +1,291 @@
+#pragma once
+
+// CPU ports of the helpers in Common.hlsli and RCCommon3D.hlsli.
+// Keep these in sync with the shaders, the reference pipeline is only useful as long as it computes the same thing as the GPU.
+
+#include "CascadeAtlasLayout.h"
+#include "ReferenceMath.h"
+#include "ScalingPermutations.h"
+
+#include "../../Assets/shaders/RCCascadeDispatch.hlsli"
+
+namespace CPUReference
+{
+	// Offset to ensure that probes dont spawn inside walls. Same value as in RCCommon3D.hlsli.
+	constexpr float ProbeDepthOffset = 0.0000005f;
+	constexpr uint32_t MaxCascadeCount = RC_MAX_CASCADE_COUNT;
+	// Same as RC_COALESCE_RAY_SLOTS in RCCommon3D.hlsli.
+	constexpr uint32_t CoalesceRaySlotCount = 4u;
+
+	// Same layout as the RCGlobals cbuffer.
+	struct RCGlobals
+	{
+		uint32_t probeScalingFactor;
+		uint32_t rayScalingFactor;
+		uint32_t rayCount0;
+		float rayLength0;
+		uint32_t cascadeCount;
+		uint32_t gatherFilterCount;
+		bool usePreAveraging;
+		bool depthAwareMerging;
+		bool useGatherFiltering;
+		uint32_t probeCount0X;
+		uint32_t probeCount0Y;
+		uint32_t probeSpacing0;
+		bool useCascadeAtlas;
+		bool usePrecomputedMergeWeights;
+		// Screen pixel of the top left corner of the cascades with tiled processing, see CascadeTiling.h.
+		uint32_t tileOriginX;
+		uint32_t tileOriginY;
+		CascadeAtlasRect cascadeAtlasRects[MaxCascadeCount];
+	};
+
+	struct ProbeInfo3D
+	{
+		float rayCount;
+		int2 rayIndex;
+		float startDistance; // In world-units.
+		float range; // In world-units.
+		int2 probesPerDim; // Clamped value
+		int2 probeIndex; // Also relative pixel position inside a direction group.
+		int2 probeSpacing;
+		int2 texelPos; // Offset into the cascade atlas if it is used.
+		int2 tileOrigin; // Screen pixel of probe index 0.
+	};
+
+	struct DepthTile
+	{
+		int2 stride;
+		int2 offset;
+	};
+
+	inline float2 ToFloat2(const int2& v) { return float2((float)v.x, (float)v.y); }
+	// Float to int conversion follows HLSL rules, i.e. truncation towards zero.
+	inline int2 ToInt2(const float2& v) { return int2((int32_t)v.x, (int32_t)v.y); }
+
+	inline int2 Translate1DTo2D(int coord1D, int2 dims)
+	{
+		return int2(coord1D % dims.x, coord1D / dims.x);
+	}
+
+	// Order: (0, 0), (1, 0), (0, 1), (1, 1)
+	inline int2 TranslateCoord4x1To2x2(int coord4x1)
+	{
+		return int2(coord4x1 & 1, coord4x1 >> 1);
+	}
+
+	inline float2 ClampPixelPos(const float2& pixelPos, const int2& dims)
+	{
+		return clamp(pixelPos, float2(0.0f, 0.0f), ToFloat2(dims));
+	}
+
+	// Weights taken from: https://en.wikipedia.org/wiki/Bilinear_interpolation#On_the_unit_square
+	inline float4 GetBilinearSampleWeights(const float2& ratios)
+	{
+		return float4(
+			(1.0f - ratios.x) * (1.0f - ratios.y), // Top left.
+			ratios.x * (1.0f - ratios.y), // Top right.
+			(1.0f - ratios.x) * ratios.y, // Bottom left.
+			ratios.x * ratios.y // Bottom right.
+		);
+	}
+
+	// t = texel, 00 = top left, 11 = bottom right
+	inline float4 BilinearInterpolation(const float4& t00, const float4& t10, const float4& t01, const float4& t11, const float2& fraction)
+	{
+		float2 negFrac = float2(1.0f, 1.0f) - fraction;
+
+		return t00 * negFrac.x * negFrac.y +
+			t10 * fraction.x * negFrac.y +
+			t01 * negFrac.x * fraction.y +
+			t11 * fraction.x * fraction.y;
+	}
+
+	inline float ProjectLinePerpendicular(const float3& A, const float3& B, const float3& p)
+	{
+		float3 BA = B - A;
+		return dot(p - A, BA) / dot(BA, BA);
+	}
+
+	// Adapted from a shadertoy project by Alexander Sannikov on depth aware upscaling: https://www.shadertoy.com/view/4XXSWS
+	inline float2 GetBilinear3dRatioIter(const float3 srcPoints[4], const float3& dstPoint, const float2& initRatio, int iterationCount)
+	{
+		float2 ratio = initRatio;
+		for (int i = 0; i < iterationCount; i++)
+		{
+			ratio.x = saturate(ProjectLinePerpendicular(lerp(srcPoints[0], srcPoints[2], ratio.y), lerp(srcPoints[1], srcPoints[3], ratio.y), dstPoint));
+			ratio.y = saturate(ProjectLinePerpendicular(lerp(srcPoints[0], srcPoints[1], ratio.x), lerp(srcPoints[2], srcPoints[3], ratio.x), dstPoint));
+		}
+
+		return ratio;
+	}
+
+	inline DepthTile GetDepthTile(const int2& pixelSize, const int2& tileOrigin)
+	{
+		DepthTile depthTile;
+
+		// Stride between each neighboring tile.
+		depthTile.stride = pixelSize;
+		// Set to half the stride (rounded down) to represent the middle of the tile.
+		depthTile.offset = int2(tileOrigin.x + pixelSize.x / 2, tileOrigin.y + pixelSize.y / 2);
+
+		return depthTile;
+	}
+
+	inline int2 GetDepthSamplePos(const DepthTile& depthTile, const int2& probeIndex, const int2& depthDims)
+	{
+		float2 samplePos = ToFloat2(int2(depthTile.offset.x + depthTile.stride.x * probeIndex.x, depthTile.offset.y + depthTile.stride.y * probeIndex.y));
+		return ToInt2(ClampPixelPos(samplePos, int2(depthDims.x - 1, depthDims.y - 1)));
+	}
+
+	// Inverse of GetTileProbeScreenPos, fractional probe index of a UV coord.
+	inline float2 GetTileProbeIndex(const DepthTile& depthTile, const float2& probeUV, const int2& baseDims)
+	{
+		float2 probeOffset = ToFloat2(depthTile.offset) + float2(0.5f, 0.5f);
+		return (probeUV * ToFloat2(baseDims) - probeOffset) / ToFloat2(depthTile.stride);
+	}
+
+	/* Decode UV coordinates with interval [-1, 1] into a direction (point on a sphere). */
+	inline float3 OctToFloat3EqualArea(const float2& e)
+	{
+		/* Equal-Area Mapping <https://pbr-book.org/4ed/Geometry_and_Transformations/Spherical_Geometry#x3-Equal-AreaMapping> */
+		float2 v = abs(e);
+		float sdist = 1.0f - (v.x + v.y);
+		float r = 1.0f - std::fabs(sdist);
+		float phi = ((v.y - v.x) / r + 1.0f) * 0.785398f; // Magic number is PI / 4
+		float rSqr = r * r;
+		float z = sign(sdist) * (1.0f - rSqr);
+		float cosPhi = sign(e.x) * std::cos(phi);
+		float sinPhi = sign(e.y) * std::sin(phi);
+		float rScl = r * std::sqrt(2.0f - rSqr);
+
+		return float3(cosPhi * rScl, sinPhi * rScl, z);
+	}
+
+	inline int2 GetCascadeTexelPos(const int2& localPos, uint32_t cascadeIndex, const RCGlobals& rcGlobals)
+	{
+		if (rcGlobals.useCascadeAtlas)
+		{
+			const CascadeAtlasRect& atlasRect = rcGlobals.cascadeAtlasRects[(std::min)(cascadeIndex, MaxCascadeCount - 1u)];
+			return int2(localPos.x + (int32_t)atlasRect.offsetX, localPos.y + (int32_t)atlasRect.offsetY);
+		}
+
+		return localPos;
+	}
+
+	inline ProbeInfo3D BuildProbeInfo3DDirFirst(const int2& pixelPos, uint32_t cascadeIndex, const RCGlobals& rcGlobals)
+	{
+		ProbeInfo3D probeInfo3D;
+
+		const uint32_t probeDivisor = IntegerPow(rcGlobals.probeScalingFactor, cascadeIndex);
+		probeInfo3D.probesPerDim = int2(int32_t(rcGlobals.probeCount0X / probeDivisor), int32_t(rcGlobals.probeCount0Y / probeDivisor));
+
+		// Cascades past the last one can have zero probes, the modulo is guarded to avoid UB (the GPU returns garbage instead).
+		int2 safeProbesPerDim = int2((std::max)(probeInfo3D.probesPerDim.x, 1), (std::max)(probeInfo3D.probesPerDim.y, 1));
+		probeInfo3D.probeIndex = int2(pixelPos.x % safeProbesPerDim.x, pixelPos.y % safeProbesPerDim.y);
+		probeInfo3D.probeSpacing = int2(int32_t(rcGlobals.probeSpacing0 * probeDivisor));
+
+		probeInfo3D.rayCount = float(rcGlobals.rayCount0 * IntegerPow(rcGlobals.rayScalingFactor, cascadeIndex));
+		probeInfo3D.rayIndex = int2(pixelPos.x / safeProbesPerDim.x, pixelPos.y / safeProbesPerDim.y);
+
+		// Abs is used to avoid the case where result is -0.0f, which messes up some RC calculations.
+		probeInfo3D.startDistance = std::fabs(GeometricSeriesSum(rcGlobals.rayLength0, (float)rcGlobals.rayScalingFactor, (float)cascadeIndex));
+		probeInfo3D.range = rcGlobals.rayLength0 * std::pow((float)rcGlobals.rayScalingFactor, (float)cascadeIndex);
+
+		probeInfo3D.texelPos = GetCascadeTexelPos(pixelPos, cascadeIndex, rcGlobals);
+		probeInfo3D.tileOrigin = int2((int32_t)rcGlobals.tileOriginX, (int32_t)rcGlobals.tileOriginY);
+
+		return probeInfo3D;
+	}
+
+	inline float3 GetRCRayDir(const int2& rayIndex, int raysPerDim)
+	{
+		float2 rayIndexFloat = ToFloat2(rayIndex) + float2(0.5f, 0.5f); // Middle of pixel.
+
+		// Remap a ray index from [0, raysPerDim] -> [-1, 1].
+		float2 uvCoord = float2(
+			lerp(-1.0f, 1.0f, saturate(rayIndexFloat.x / raysPerDim)),
+			lerp(-1.0f, 1.0f, saturate(rayIndexFloat.y / raysPerDim))
+		);
+
+		return normalize(OctToFloat3EqualArea(uvCoord));
+	}
+
+	inline float2 GetCascadeN1SamplePosition(const ProbeInfo3D& probeInfoN, const ProbeInfo3D& probeInfoN1, const int2& rayOffset, uint32_t probeScalingFactor, uint32_t rayScalingDim)
+	{
+		// Probe centers of cascade N in probe index space of cascade N + 1: (i + 0.5) / factor - 0.5.
+		const float probeCenterOffset = 0.5f - 0.5f * (float)probeScalingFactor;
+		float2 probeN1Index = (ToFloat2(probeInfoN.probeIndex) + float2(probeCenterOffset, probeCenterOffset)) / (float)probeScalingFactor;
+		// Clamp to avoid sampling over edges of probe groups.
+		float2 clampedProbeN1Index = clamp(probeN1Index, float2(0.0f, 0.0f), ToFloat2(probeInfoN1.probesPerDim) - float2(2.0f, 2.0f));
+		float2 rayN1Index = ToFloat2(probeInfoN.rayIndex) * (float)rayScalingDim;
+
+		return clampedProbeN1Index + ToFloat2(probeInfoN1.probesPerDim) * (rayN1Index + ToFloat2(rayOffset));
+	}
+
+	// Scaling factors of a merge, equivalent of RC_PROBE_SCALING_FACTOR and RC_RAY_SCALING_DIM in RCMerge3D.hlsli.
+	// A factor of 0 is read from RCGlobals at runtime instead, same as the merge kernels compiled without the defines.
+	template<uint32_t ProbeScalingFactor, uint32_t RayScalingDim>
+	struct MergeScaling
+	{
+		static uint32_t GetProbeScalingFactor(const RCGlobals& rcGlobals)
+		{
+			if constexpr (ProbeScalingFactor == 0u) { return rcGlobals.probeScalingFactor; }
+			else { return ProbeScalingFactor; }
+		}
+
+		static uint32_t GetRayScalingDim(const RCGlobals& rcGlobals)
+		{
+			if constexpr (RayScalingDim == 0u) { return (uint32_t)std::sqrt((float)rcGlobals.rayScalingFactor); }
+			else { return RayScalingDim; }
+		}
+	};
+
+	typedef MergeScaling<0u, 0u> RuntimeMergeScaling;
+
+	inline uint32_t GetCoalesceRayCount(const RCGlobals& rcGlobals)
+	{
+		uint32_t rayCount = rcGlobals.rayCount0;
+		// If the merge has been pre-averaged it means that each original ray has casted a ray equal to its ray scaling factor.
+		if (rcGlobals.usePreAveraging)
+		{
+			rayCount /= rcGlobals.rayScalingFactor;
+		}
+
+		return rayCount;
+	}
+
+	inline int2 GetCoalesceRayIndex(uint32_t coalesceRayIndex, uint32_t raysPerDim)
+	{
+		return int2(int32_t(coalesceRayIndex / raysPerDim), int32_t(coalesceRayIndex % raysPerDim));
+	}
+
+	inline float3 SimpleSunsetSky(float3 viewDir, float3 sunDir)
+	{
+		viewDir = normalize(viewDir);
+		sunDir = normalize(sunDir);
+
+		// Calculate height factor (up direction)
+		float height = viewDir.y * 0.5f + 0.5f;
+
+		// Create sky gradient
+		float3 skyBaseColor = lerp(
+			float3(0.8f, 0.4f, 0.2f) * 2.0f, // Warm orange at horizon
+			float3(0.1f, 0.2f, 0.4f) * 1.0f, // Deep blue at zenith
+			std::pow(height, 0.5f)
+		);
+
+		// Sun calculation
+		float sunDot = (std::max)(dot(viewDir, sunDir), 0.0f);
+		float sunT = saturate((sunDot - 0.96f) / (0.9997f - 0.96f));
+		float sunDisc = sunT * sunT * (3.0f - 2.0f * sunT);
+		float sunGlow = std::pow(sunDot, 8.0f);
+
+		// Add sun and glow
+		float3 sunColor = float3(1.0f, 0.6f, 0.3f) * 25.0f; // HDR sun
+		skyBaseColor += sunColor * sunDisc;
+		skyBaseColor += float3(0.8f, 0.5f, 0.3f) * (sunGlow * (1.0f - height) * 0.8f);
+
+		return skyBaseColor;
+	}
+}
@@ -0,0 +1,220 @@
+#include "RadianceHashCache.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CPUReference
+{
+	namespace
+	{
+		constexpr uint32_t SlotWordCount = RadianceCacheSlotSize / 4u;
+		// Slots aged per task.
+		constexpr uint32_t AgeChunkSize = 4096u;
+
+		uint32_t RoundUpToPowerOfTwo(uint32_t value)
+		{
+			uint32_t powerOfTwo = 1u;
+			while (powerOfTwo < value)
+			{
+				powerOfTwo <<= 1u;
+			}
+
+			return powerOfTwo;
+		}
+	}
+
+	void RadianceHashCache::Create(const RadianceCacheInfo& info)
+	{
+		m_info = info;
+		m_info.capacity = info.capacity > 0u ? RoundUpToPowerOfTwo(info.capacity) : 0u;
+		m_info.minSampleCount = (std::min)(info.minSampleCount, RadianceCacheMaxSampleCount);
+
+		m_words = std::make_unique<std::atomic<uint32_t>[]>(size_t(m_info.capacity) * SlotWordCount);
+		Clear();
+	}
+
+	void RadianceHashCache::Clear()
+	{
+		const size_t wordCount = size_t(m_info.capacity) * SlotWordCount;
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			m_words[i].store(0u, std::memory_order_relaxed);
+		}
+	}
+
+	RadianceCacheKey RadianceHashCache::GetKey(const float3& worldPos, uint32_t cascadeIndex) const
+	{
+		return GetRadianceCacheKey(worldPos, cascadeIndex, m_info);
+	}
+
+	uint32_t RadianceHashCache::FindSlot(const RadianceCacheKey& key) const
+	{
+		for (uint32_t i = 0; i < RadianceCacheProbeCount; i++)
+		{
+			const uint32_t slotIndex = GetRadianceCacheProbeSlot(key, i, m_info);
+			if (GetWord(slotIndex, RadianceCacheChecksumOffset).load(std::memory_order_acquire) == key.checksum)
+			{
+				return slotIndex;
+			}
+		}
+
+		return InvalidSlot;
+	}
+
+	uint32_t RadianceHashCache::FindOrInsertSlot(const RadianceCacheKey& key)
+	{
+		const uint32_t foundSlot = FindSlot(key);
+		if (foundSlot != InvalidSlot)
+		{
+			return foundSlot;
+		}
+
+		// Slots only go from empty to claimed while inserting, see FindOrInsertRadianceCacheSlot().
+		for (uint32_t i = 0; i < RadianceCacheProbeCount; i++)
+		{
+			const uint32_t slotIndex = GetRadianceCacheProbeSlot(key, i, m_info);
+
+			uint32_t previousChecksum = RadianceCacheEmptyChecksum;
+			GetWord(slotIndex, RadianceCacheChecksumOffset).compare_exchange_strong(previousChecksum, key.checksum, std::memory_order_acq_rel);
+
+			if (previousChecksum == RadianceCacheEmptyChecksum || previousChecksum == key.checksum)
+			{
+				return slotIndex;
+			}
+		}
+
+		return InvalidSlot;
+	}
+
+	bool RadianceHashCache::Lookup(const RadianceCacheKey& key, float3& radianceOut)
+	{
+		radianceOut = float3(0.0f);
+
+		const uint32_t slotIndex = FindSlot(key);
+		if (slotIndex == InvalidSlot)
+		{
+			return false;
+		}
+
+		GetWord(slotIndex, RadianceCacheLastUsedOffset).store(m_info.frameIndex, std::memory_order_relaxed);
+
+		const uint32_t sampleCount = GetWord(slotIndex, RadianceCacheSampleCountOffset).load(std::memory_order_relaxed);
+		if (sampleCount < m_info.minSampleCount)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			const uint32_t radianceSum = GetWord(slotIndex, RadianceCacheRadianceOffset + 4u * i).load(std::memory_order_relaxed);
+			radianceOut[i] = DecodeRadianceCacheChannel(radianceSum, sampleCount);
+		}
+
+		return true;
+	}
+
+	bool RadianceHashCache::Accumulate(const RadianceCacheKey& key, const float3& radiance)
+	{
+		const uint32_t slotIndex = FindOrInsertSlot(key);
+		if (slotIndex == InvalidSlot)
+		{
+			return false;
+		}
+
+		GetWord(slotIndex, RadianceCacheLastUsedOffset).store(m_info.frameIndex, std::memory_order_relaxed);
+
+		// The count is raised first so that no more than RadianceCacheMaxSampleCount samples end up in the sums.
+		const uint32_t previousSampleCount = GetWord(slotIndex, RadianceCacheSampleCountOffset).fetch_add(1u, std::memory_order_relaxed);
+		if (previousSampleCount < RadianceCacheMaxSampleCount)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				GetWord(slotIndex, RadianceCacheRadianceOffset + 4u * i).fetch_add(EncodeRadianceCacheChannel(radiance[i]), std::memory_order_relaxed);
+			}
+		}
+
+		return true;
+	}
+
+	uint32_t RadianceHashCache::Age(TaskPool* taskPool /*= nullptr*/)
+	{
+		if (taskPool == nullptr)
+		{
+			uint32_t evictedCount = 0u;
+			for (uint32_t slotIndex = 0; slotIndex < m_info.capacity; slotIndex++)
+			{
+				evictedCount += AgeSlot(slotIndex) ? 1u : 0u;
+			}
+
+			return evictedCount;
+		}
+
+		std::atomic<uint32_t> evictedCount = 0u;
+		const uint32_t chunkCount = (m_info.capacity + AgeChunkSize - 1u) / AgeChunkSize;
+		taskPool->ParallelFor(chunkCount, [&](uint32_t chunkIndex)
+			{
+				const uint32_t beginSlot = chunkIndex * AgeChunkSize;
+				const uint32_t endSlot = (std::min)(beginSlot + AgeChunkSize, m_info.capacity);
+
+				uint32_t chunkEvictedCount = 0u;
+				for (uint32_t slotIndex = beginSlot; slotIndex < endSlot; slotIndex++)
+				{
+					chunkEvictedCount += AgeSlot(slotIndex) ? 1u : 0u;
+				}
+
+				evictedCount.fetch_add(chunkEvictedCount, std::memory_order_relaxed);
+			});
+
+		return evictedCount.load();
+	}
+
+	RadianceCacheSlot RadianceHashCache::GetSlot(uint32_t slotIndex) const
+	{
+		assert(slotIndex < m_info.capacity);
+
+		RadianceCacheSlot slot;
+		slot.checksum = GetWord(slotIndex, RadianceCacheChecksumOffset).load();
+		slot.lastUsedFrame = GetWord(slotIndex, RadianceCacheLastUsedOffset).load();
+		slot.sampleCount = GetWord(slotIndex, RadianceCacheSampleCountOffset).load();
+		for (int i = 0; i < 3; i++)
+		{
+			slot.radiance[i] = DecodeRadianceCacheChannel(GetWord(slotIndex, RadianceCacheRadianceOffset + 4u * i).load(), slot.sampleCount);
+		}
+
+		return slot;
+	}
+
+	uint32_t RadianceHashCache::GetOccupiedSlotCount() const
+	{
+		uint32_t occupiedCount = 0u;
+		for (uint32_t slotIndex = 0; slotIndex < m_info.capacity; slotIndex++)
+		{
+			occupiedCount += GetWord(slotIndex, RadianceCacheChecksumOffset).load(std::memory_order_relaxed) != RadianceCacheEmptyChecksum ? 1u : 0u;
+		}
+
+		return occupiedCount;
+	}
+
+	std::atomic<uint32_t>& RadianceHashCache::GetWord(uint32_t slotIndex, uint32_t byteOffset) const
+	{
+		return m_words[size_t(slotIndex) * SlotWordCount + byteOffset / 4u];
+	}
+
+	bool RadianceHashCache::AgeSlot(uint32_t slotIndex)
+	{
+		if (GetWord(slotIndex, RadianceCacheChecksumOffset).load(std::memory_order_relaxed) == RadianceCacheEmptyChecksum ||
+			!IsRadianceCacheSlotExpired(GetWord(slotIndex, RadianceCacheLastUsedOffset).load(std::memory_order_relaxed), m_info))
+		{
+			return false;
+		}
+
+		// A cell inserted into the slot later starts from zero.
+		for (uint32_t i = 0; i < SlotWordCount; i++)
+		{
+			m_words[size_t(slotIndex) * SlotWordCount + i].store(0u, std::memory_order_relaxed);
+		}
+
+		return true;
+	}
+}
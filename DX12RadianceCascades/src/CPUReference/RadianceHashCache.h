@@ -0,0 +1,173 @@
+#pragma once
+
+// World space hash grid of surface radiance that hits can read instead of shading again. CPU reference only: the closest hit shader of
+// RCRaytraceRT.hlsl shades with a single emissive sample, which is cheaper than searching the probe window of a cell.
+// Each cell is a cube whose size grows with the cascade index, upper cascades hit surfaces further away and can use coarser cells.
+// Cells are hashed into a fixed number of slots and found by linear probing within a window of RadianceCacheProbeCount slots.
+// A slot is claimed with a compare exchange of its checksum, radiance is accumulated with atomic adds of fixed point values,
+// so lookups and inserts can run from every thread of the task pool at once. Age() evicts expired slots and must not run alongside them.
+
+#include "ReferenceMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	// Slot layout, in bytes.
+	constexpr uint32_t RadianceCacheSlotSize = 24u;
+	constexpr uint32_t RadianceCacheChecksumOffset = 0u;
+	constexpr uint32_t RadianceCacheLastUsedOffset = 4u; // Frame index of the last lookup or insert.
+	constexpr uint32_t RadianceCacheSampleCountOffset = 8u;
+	constexpr uint32_t RadianceCacheRadianceOffset = 12u; // Fixed point sums of red, green and blue.
+
+	constexpr uint32_t RadianceCacheEmptyChecksum = 0u;
+	constexpr uint32_t RadianceCacheProbeCount = 8u;
+
+	// Only the first RadianceCacheMaxSampleCount samples of a cell are summed, which together with the largest
+	// radiance keeps the fixed point sums within 32 bits: 64 * 65535 * 1024 < 2^32.
+	constexpr uint32_t RadianceCacheMaxSampleCount = 64u;
+	constexpr float RadianceCacheMaxRadiance = 65535.0f;
+	constexpr float RadianceCacheFixedPointScale = 1024.0f;
+
+	struct RadianceCacheInfo
+	{
+		uint32_t capacity; // Slot count, a power of two. 0 if the cache is not used.
+		uint32_t frameIndex;
+		uint32_t maxAge; // Frames a slot is kept without being used.
+		uint32_t minCascade; // Cascades below are shaded on every hit, their rays are short and mostly land on surfaces close to the probe.
+		uint32_t minSampleCount; // Samples a cell needs before lookups return it, at most RadianceCacheMaxSampleCount.
+		float cellSize0; // World space side of the cells of cascade 0.
+		float cellScalingFactor; // Cell size grows by this factor per cascade.
+	};
+
+	struct RadianceCacheKey
+	{
+		uint32_t slot; // First slot of the probe window.
+		uint32_t checksum; // Tells cells apart that share a slot, never RadianceCacheEmptyChecksum.
+	};
+
+	// PCG hash, a permutation of all 32 bit values.
+	inline uint32_t RadianceCacheHash(uint32_t value)
+	{
+		const uint32_t state = value * 747796405u + 2891336453u;
+		const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	inline float GetRadianceCacheCellSize(const RadianceCacheInfo& info, uint32_t cascadeIndex)
+	{
+		float cellSize = info.cellSize0;
+		for (uint32_t i = 0; i < cascadeIndex; i++)
+		{
+			cellSize *= info.cellScalingFactor;
+		}
+
+		return cellSize;
+	}
+
+	inline RadianceCacheKey GetRadianceCacheKey(const float3& worldPos, uint32_t cascadeIndex, const RadianceCacheInfo& info)
+	{
+		const float cellSize = GetRadianceCacheCellSize(info, cascadeIndex);
+		const int32_t cellX = int32_t(std::floor(worldPos.x / cellSize));
+		const int32_t cellY = int32_t(std::floor(worldPos.y / cellSize));
+		const int32_t cellZ = int32_t(std::floor(worldPos.z / cellSize));
+
+		// Cascades have their own cells, so the cascade is hashed along with the cell.
+		const uint32_t hash = RadianceCacheHash(cascadeIndex + RadianceCacheHash(uint32_t(cellZ) + RadianceCacheHash(uint32_t(cellY) + RadianceCacheHash(uint32_t(cellX)))));
+
+		// As the hash is a permutation, cells only end up with the same checksum if their whole hash is the same (or 0 and 1 collide).
+		const uint32_t checksum = RadianceCacheHash(hash);
+
+		RadianceCacheKey key;
+		key.slot = hash & (info.capacity - 1u);
+		key.checksum = checksum == RadianceCacheEmptyChecksum ? 1u : checksum;
+
+		return key;
+	}
+
+	inline uint32_t GetRadianceCacheProbeSlot(const RadianceCacheKey& key, uint32_t probeIndex, const RadianceCacheInfo& info)
+	{
+		return (key.slot + probeIndex) & (info.capacity - 1u);
+	}
+
+	inline uint32_t EncodeRadianceCacheChannel(float radiance)
+	{
+		// Also catches NaN, which fails both comparisons.
+		const float clampedRadiance = radiance > 0.0f ? (radiance < RadianceCacheMaxRadiance ? radiance : RadianceCacheMaxRadiance) : 0.0f;
+		return uint32_t(clampedRadiance * RadianceCacheFixedPointScale + 0.5f);
+	}
+
+	inline float DecodeRadianceCacheChannel(uint32_t radianceSum, uint32_t sampleCount)
+	{
+		const uint32_t summedCount = (std::min)(sampleCount, RadianceCacheMaxSampleCount);
+		return summedCount > 0u ? float(radianceSum) / (RadianceCacheFixedPointScale * float(summedCount)) : 0.0f;
+	}
+
+	inline bool IsRadianceCacheSlotExpired(uint32_t lastUsedFrame, const RadianceCacheInfo& info)
+	{
+		// Wraps around along with the frame index.
+		return info.frameIndex - lastUsedFrame > info.maxAge;
+	}
+
+	// Decoded copy of a slot.
+	struct RadianceCacheSlot
+	{
+		uint32_t checksum = RadianceCacheEmptyChecksum;
+		uint32_t lastUsedFrame = 0u;
+		uint32_t sampleCount = 0u;
+		float3 radiance;
+	};
+
+	class RadianceHashCache
+	{
+	public:
+		static constexpr uint32_t InvalidSlot = 0xFFFFFFFFu;
+
+		RadianceHashCache() = default;
+
+		RadianceHashCache(const RadianceHashCache&) = delete;
+		RadianceHashCache& operator=(const RadianceHashCache&) = delete;
+
+		// Rounds the capacity up to a power of two and clamps the minimum sample count. Every slot starts out empty.
+		void Create(const RadianceCacheInfo& info);
+		void Clear();
+
+		const RadianceCacheInfo& GetInfo() const { return m_info; }
+		uint32_t GetCapacity() const { return m_info.capacity; }
+		uint64_t GetByteSize() const { return uint64_t(m_info.capacity) * RadianceCacheSlotSize; }
+		bool IsEmpty() const { return m_info.capacity == 0u; }
+
+		// Lookups and inserts stamp slots with the current frame, Age() evicts relative to it.
+		void SetFrameIndex(uint32_t frameIndex) { m_info.frameIndex = frameIndex; }
+		uint32_t GetFrameIndex() const { return m_info.frameIndex; }
+
+		RadianceCacheKey GetKey(const float3& worldPos, uint32_t cascadeIndex) const;
+
+		// Safe to call from multiple threads at once.
+		uint32_t FindSlot(const RadianceCacheKey& key) const;
+		uint32_t FindOrInsertSlot(const RadianceCacheKey& key);
+		bool Lookup(const RadianceCacheKey& key, float3& radianceOut);
+		// Returns false if the sample was dropped because every slot of the probe window holds another cell.
+		bool Accumulate(const RadianceCacheKey& key, const float3& radiance);
+
+		// Empties every slot that was not used for maxAge frames and returns how many there were. The task pool is optional.
+		uint32_t Age(TaskPool* taskPool = nullptr);
+
+		RadianceCacheSlot GetSlot(uint32_t slotIndex) const;
+		uint32_t GetOccupiedSlotCount() const;
+
+	private:
+		std::atomic<uint32_t>& GetWord(uint32_t slotIndex, uint32_t byteOffset) const;
+		bool AgeSlot(uint32_t slotIndex);
+
+	private:
+		RadianceCacheInfo m_info = {};
+		// RadianceCacheSlotSize / 4 words per slot.
+		std::unique_ptr<std::atomic<uint32_t>[]> m_words;
+	};
+}
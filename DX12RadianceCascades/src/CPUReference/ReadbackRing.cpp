@@ -0,0 +1,168 @@
+#include "ReadbackRing.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace CPUReference
+{
+	void ReadbackRing::Reset(uint32_t slotCount)
+	{
+		m_slots.assign(slotCount, Slot());
+		m_latestSlot = InvalidSlot;
+		m_droppedFrameCount = 0u;
+	}
+
+	uint32_t ReadbackRing::BeginWrite(const ReadbackFence& fence, uint64_t frameIndex)
+	{
+		PollInFlightSlots(fence);
+
+		// Empty slots first, then the oldest complete slot that has been replaced by a newer result.
+		uint32_t writeSlot = InvalidSlot;
+		for (uint32_t i = 0; i < GetSlotCount(); i++)
+		{
+			const Slot& slot = m_slots[i];
+			assert(slot.state != SlotStateWriting);
+
+			if (slot.state == SlotStateEmpty)
+			{
+				writeSlot = i;
+				break;
+			}
+
+			if (slot.state == SlotStateComplete && i != m_latestSlot && (writeSlot == InvalidSlot || slot.frameIndex < m_slots[writeSlot].frameIndex))
+			{
+				writeSlot = i;
+			}
+		}
+
+		if (writeSlot == InvalidSlot)
+		{
+			m_droppedFrameCount++;
+			return InvalidSlot;
+		}
+
+		m_slots[writeSlot].state = SlotStateWriting;
+		m_slots[writeSlot].frameIndex = frameIndex;
+		m_slots[writeSlot].fenceValue = 0u;
+
+		return writeSlot;
+	}
+
+	void ReadbackRing::EndWrite(uint32_t slotIndex, uint64_t fenceValue)
+	{
+		assert(slotIndex < GetSlotCount() && m_slots[slotIndex].state == SlotStateWriting);
+
+		m_slots[slotIndex].state = SlotStateInFlight;
+		m_slots[slotIndex].fenceValue = fenceValue;
+	}
+
+	bool ReadbackRing::GetLatestResult(const ReadbackFence& fence, uint64_t currentFrameIndex, ReadbackRingResult& resultOut)
+	{
+		PollInFlightSlots(fence);
+
+		if (m_latestSlot == InvalidSlot)
+		{
+			return false;
+		}
+
+		const Slot& slot = m_slots[m_latestSlot];
+		resultOut.slotIndex = m_latestSlot;
+		resultOut.frameIndex = slot.frameIndex;
+		resultOut.frameAge = currentFrameIndex > slot.frameIndex ? currentFrameIndex - slot.frameIndex : 0u;
+
+		return true;
+	}
+
+	void ReadbackRing::PollInFlightSlots(const ReadbackFence& fence)
+	{
+		for (uint32_t i = 0; i < GetSlotCount(); i++)
+		{
+			Slot& slot = m_slots[i];
+			if (slot.state != SlotStateInFlight || !fence.IsFenceComplete(slot.fenceValue))
+			{
+				continue;
+			}
+
+			slot.state = SlotStateComplete;
+
+			// Copies can complete out of frame order if they were submitted on different queues.
+			if (m_latestSlot == InvalidSlot || slot.frameIndex > m_slots[m_latestSlot].frameIndex)
+			{
+				m_latestSlot = i;
+			}
+		}
+	}
+
+	void ReadbackProfileSamples::Reset(uint32_t slotCount)
+	{
+		m_frames.assign(slotCount, ResolvedProfiles());
+		m_currentFrameIndex = 0u;
+		m_lastReadFrameIndex = UINT64_MAX;
+		m_sampledMask = 0u;
+	}
+
+	void ReadbackProfileSamples::BeginFrame(uint64_t frameIndex)
+	{
+		assert(!m_frames.empty());
+
+		m_currentFrameIndex = frameIndex;
+
+		ResolvedProfiles& resolvedProfiles = m_frames[frameIndex % m_frames.size()];
+		resolvedProfiles.frameIndex = frameIndex;
+		resolvedProfiles.profileMask = 0u;
+	}
+
+	void ReadbackProfileSamples::MarkResolved(uint32_t profileIndex)
+	{
+		assert(profileIndex < MaxProfileCount);
+
+		m_frames[m_currentFrameIndex % m_frames.size()].profileMask |= 1u << profileIndex;
+	}
+
+	uint32_t ReadbackProfileSamples::ReadFrame(uint64_t frameIndex, const uint64_t* timestamps, uint32_t profileCount, double timestampFrequency)
+	{
+		// The latest result stays the same until a newer frame completes, it is only sampled once.
+		if (frameIndex == m_lastReadFrameIndex)
+		{
+			return 0u;
+		}
+
+		m_lastReadFrameIndex = frameIndex;
+
+		// Too old to still know which profiles it holds, only happens after frames were dropped.
+		const ResolvedProfiles& resolvedProfiles = m_frames[frameIndex % m_frames.size()];
+		if (resolvedProfiles.frameIndex != frameIndex)
+		{
+			return 0u;
+		}
+
+		// Slots keep the timestamps of older frames for profiles that were not resolved in this one.
+		uint32_t sampledMask = 0u;
+		for (uint32_t i = 0; i < (std::min)(profileCount, MaxProfileCount); i++)
+		{
+			if ((resolvedProfiles.profileMask & (1u << i)) == 0u)
+			{
+				continue;
+			}
+
+			const uint64_t startTime = timestamps[i * 2u];
+			const uint64_t endTime = timestamps[i * 2u + 1u];
+			m_lastSamples[i] = float(double(endTime - startTime) / timestampFrequency * 1000.0);
+			sampledMask |= 1u << i;
+		}
+
+		m_sampledMask |= sampledMask;
+		return sampledMask;
+	}
+
+	bool ReadbackProfileSamples::GetLastSample(uint32_t profileIndex, float& sampleMsOut) const
+	{
+		if (profileIndex >= MaxProfileCount || (m_sampledMask & (1u << profileIndex)) == 0u)
+		{
+			return false;
+		}
+
+		sampleMsOut = m_lastSamples[profileIndex];
+		return true;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+// Slot bookkeeping of a readback buffer that is copied into by the GPU every frame and read on the CPU a few frames later, see ReadbackRingBuffer.h.
+// The CPU only ever reads slots whose copy has completed, so reading never waits on the GPU. The price is that results are a few frames old.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Completion of submitted GPU work. Implemented on top of the command queues for the app and by ManualReadbackFence on the CPU.
+	class ReadbackFence
+	{
+	public:
+		virtual ~ReadbackFence() = default;
+
+		virtual bool IsFenceComplete(uint64_t fenceValue) const = 0;
+	};
+
+	// Fence values complete when told to, in order like a command queue fence.
+	class ManualReadbackFence : public ReadbackFence
+	{
+	public:
+		bool IsFenceComplete(uint64_t fenceValue) const override { return fenceValue <= m_completedValue; }
+
+		void SetCompletedValue(uint64_t completedValue) { m_completedValue = completedValue; }
+		uint64_t GetCompletedValue() const { return m_completedValue; }
+
+	private:
+		uint64_t m_completedValue = 0u;
+	};
+
+	struct ReadbackRingResult
+	{
+		uint32_t slotIndex = 0u;
+		// Frame the slot was written in and how many frames ago that was.
+		uint64_t frameIndex = 0u;
+		uint64_t frameAge = 0u;
+	};
+
+	class ReadbackRing
+	{
+	public:
+		static constexpr uint32_t InvalidSlot = UINT32_MAX;
+
+		ReadbackRing() = default;
+
+		// Forgets every result. Slots that are still in flight have to be finished with before, as they are handed out again right away.
+		// No frame is dropped with at least the GPU latency in frames + 2 slots, one for the frame being written and one for the latest result.
+		void Reset(uint32_t slotCount);
+		uint32_t GetSlotCount() const { return (uint32_t)m_slots.size(); }
+
+		// Slot to copy the results of frameIndex into, InvalidSlot if every slot is in flight or holds the latest result.
+		// The frame is dropped in that case instead of waiting for a slot to free up.
+		uint32_t BeginWrite(const ReadbackFence& fence, uint64_t frameIndex);
+		// Fence value that signals once the copy into slotIndex has completed.
+		void EndWrite(uint32_t slotIndex, uint64_t fenceValue);
+
+		// Most recent result whose copy has completed, false if there is none yet. The slot stays valid until a newer result completes.
+		bool GetLatestResult(const ReadbackFence& fence, uint64_t currentFrameIndex, ReadbackRingResult& resultOut);
+
+		// Frames dropped by BeginWrite() since the last Reset().
+		uint64_t GetDroppedFrameCount() const { return m_droppedFrameCount; }
+
+	private:
+		enum SlotState : uint32_t
+		{
+			SlotStateEmpty = 0,
+			SlotStateWriting, // Between BeginWrite() and EndWrite().
+			SlotStateInFlight,
+			SlotStateComplete,
+
+			SlotStateCount // Keep last!
+		};
+
+		struct Slot
+		{
+			SlotState state = SlotStateEmpty;
+			uint64_t frameIndex = 0u;
+			uint64_t fenceValue = 0u;
+		};
+
+		// Moves every in flight slot whose fence has completed to complete and updates m_latestSlot.
+		void PollInFlightSlots(const ReadbackFence& fence);
+
+	private:
+		std::vector<Slot> m_slots;
+		uint32_t m_latestSlot = InvalidSlot;
+		uint64_t m_droppedFrameCount = 0u;
+	};
+
+	// Timestamp pairs of profiles resolved into the slots of a ReadbackRing, the CPU side of GPUProfiler. Which profiles were resolved is
+	// tracked per frame, so a completed slot only adds samples to the profiles written in the frame it holds. Every other profile, and
+	// every profile while no newer frame has completed, keeps its last sample.
+	class ReadbackProfileSamples
+	{
+	public:
+		// Resolved profiles of a frame are tracked in a 32 bit mask.
+		static constexpr uint32_t MaxProfileCount = 32u;
+
+		ReadbackProfileSamples() = default;
+
+		// Frames are remembered for as many frames as the ring has slots, which is as old as a result can get.
+		void Reset(uint32_t slotCount);
+
+		// Call for every frame, also the ones the ring drops, before its profiles are resolved.
+		void BeginFrame(uint64_t frameIndex);
+		void MarkResolved(uint32_t profileIndex);
+
+		// Reads the start and end timestamp of every profile from the latest completed result. Only the first read of a frame adds
+		// samples, the returned mask has a bit for every profile that got one.
+		uint32_t ReadFrame(uint64_t frameIndex, const uint64_t* timestamps, uint32_t profileCount, double timestampFrequency);
+
+		// False if the profile has never been sampled.
+		bool GetLastSample(uint32_t profileIndex, float& sampleMsOut) const;
+
+	private:
+		struct ResolvedProfiles
+		{
+			uint64_t frameIndex = UINT64_MAX;
+			uint32_t profileMask = 0u;
+		};
+
+	private:
+		std::vector<ResolvedProfiles> m_frames;
+		uint64_t m_currentFrameIndex = 0u;
+		uint64_t m_lastReadFrameIndex = UINT64_MAX;
+
+		float m_lastSamples[MaxProfileCount] = {};
+		uint32_t m_sampledMask = 0u;
+	};
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+// Small vector math library for the CPU reference implementation.
+// DirectXMath (and by extension Math::Vector3) is not available on every platform the reference path has to run on,
+// so this mirrors the subset of HLSL vector types and intrinsics that the RC shaders use.
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+namespace CPUReference
+{
+	constexpr float FloatMax = 3.40282347e+38F;
+	constexpr float Epsilon = 1.0e-5f;
+	constexpr float Pi = 3.1415926535897932384f;
+
+	struct float2
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+
+		float2() = default;
+		explicit constexpr float2(float v) : x(v), y(v) {}
+		constexpr float2(float _x, float _y) : x(_x), y(_y) {}
+
+		float& operator[](int i) { return (&x)[i]; }
+		float operator[](int i) const { return (&x)[i]; }
+	};
+
+	struct int2
+	{
+		int32_t x = 0;
+		int32_t y = 0;
+
+		int2() = default;
+		explicit constexpr int2(int32_t v) : x(v), y(v) {}
+		constexpr int2(int32_t _x, int32_t _y) : x(_x), y(_y) {}
+
+		explicit operator float2() const { return float2((float)x, (float)y); }
+	};
+
+	struct float3
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+
+		float3() = default;
+		explicit constexpr float3(float v) : x(v), y(v), z(v) {}
+		constexpr float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+		float& operator[](int i) { return (&x)[i]; }
+		float operator[](int i) const { return (&x)[i]; }
+	};
+
+	struct float4
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+		float w = 0.0f;
+
+		float4() = default;
+		explicit constexpr float4(float v) : x(v), y(v), z(v), w(v) {}
+		constexpr float4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr float4(const float3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+
+		float3 rgb() const { return float3(x, y, z); }
+		float& operator[](int i) { return (&x)[i]; }
+		float operator[](int i) const { return (&x)[i]; }
+	};
+
+// Component wise operators and intrinsics. clamp() follows HLSL and is min(max(x, lo), hi) so that lo > hi is well defined.
+#define CPUREF_VECTOR_OPS(type) \
+	inline type operator+(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] += b[i]; } return r; } \
+	inline type operator-(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] -= b[i]; } return r; } \
+	inline type operator*(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] *= b[i]; } return r; } \
+	inline type operator/(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] /= b[i]; } return r; } \
+	inline type operator*(const type& a, float s) { return a * type(s); } \
+	inline type operator*(float s, const type& a) { return a * type(s); } \
+	inline type operator/(const type& a, float s) { return a / type(s); } \
+	inline type operator-(const type& a) { return a * -1.0f; } \
+	inline type& operator+=(type& a, const type& b) { a = a + b; return a; } \
+	inline type& operator-=(type& a, const type& b) { a = a - b; return a; } \
+	inline type& operator*=(type& a, const type& b) { a = a * b; return a; } \
+	inline type& operator/=(type& a, const type& b) { a = a / b; return a; } \
+	inline float dot(const type& a, const type& b) { float d = 0.0f; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { d += a[i] * b[i]; } return d; } \
+	inline type lerp(const type& a, const type& b, float t) { return a + (b - a) * t; } \
+	inline type floor(const type& a) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = std::floor(r[i]); } return r; } \
+	inline type frac(const type& a) { return a - floor(a); } \
+	inline type saturate(const type& a) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = std::clamp(r[i], 0.0f, 1.0f); } return r; } \
+	inline type clamp(const type& a, const type& lo, const type& hi) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = (std::min)((std::max)(r[i], lo[i]), hi[i]); } return r; } \
+	inline type (min)(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = (std::min)(a[i], b[i]); } return r; } \
+	inline type (max)(const type& a, const type& b) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = (std::max)(a[i], b[i]); } return r; } \
+	inline type abs(const type& a) { type r = a; for (int i = 0; i < int(sizeof(type) / sizeof(float)); i++) { r[i] = std::fabs(r[i]); } return r; } \
+	inline float length(const type& a) { return std::sqrt(dot(a, a)); } \
+	inline type normalize(const type& a) { return a / length(a); }
+
+	CPUREF_VECTOR_OPS(float2)
+	CPUREF_VECTOR_OPS(float3)
+	CPUREF_VECTOR_OPS(float4)
+
+#undef CPUREF_VECTOR_OPS
+
+	inline float saturate(float a) { return std::clamp(a, 0.0f, 1.0f); }
+	inline float frac(float a) { return a - std::floor(a); }
+	inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+	inline float sign(float a) { return float((a > 0.0f) - (a < 0.0f)); }
+	inline float2 sign(const float2& a) { return float2(sign(a.x), sign(a.y)); }
+
+	inline float3 cross(const float3& a, const float3& b)
+	{
+		return float3(
+			a.y * b.z - a.z * b.y,
+			a.z * b.x - a.x * b.z,
+			a.x * b.y - a.y * b.x
+		);
+	}
+
+	inline bool IsZero(float x) { return std::fabs(x) < Epsilon; }
+	inline bool IsZero(const float3& v) { return length(v) < Epsilon; }
+
+	inline bool IsFinite(const float3& v) { return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z); }
+
+	// Calculates: a + ar^2 + ar^3 + ... + ar^(n - 1)
+	inline float GeometricSeriesSum(float a, float r, float n)
+	{
+		return a * (1.0f - std::pow(r, n)) / (1.0f - r);
+	}
+
+	inline uint32_t IntegerPow(uint32_t base, uint32_t exponent)
+	{
+		uint32_t result = 1u;
+		for (uint32_t i = 0; i < exponent; i++)
+		{
+			result *= base;
+		}
+
+		return result;
+	}
+}
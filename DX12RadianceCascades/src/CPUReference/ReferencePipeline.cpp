@@ -0,0 +1,1048 @@
+#include "ReferencePipeline.h"
+#include "RadianceHashCache.h"
+#include "StreamCompaction.h"
+#include "TaskPool.h"
+
+#include <atomic>
+#include <cassert>
+#include <filesystem>
+#include <utility>
+
+namespace CPUReference
+{
+	float3 GetProbeWorldPos(const ProbeInfo3D& probeInfo3D, const DepthTexture& depth, const ReferenceCamera& camera)
+	{
+		const int2 depthDims = depth.GetDims();
+
+		DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+		int2 samplePos = GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depthDims);
+
+		float depthVal = depth.Load(samplePos);
+		if (!IsZero(depthVal))
+		{
+			depthVal += ProbeDepthOffset;
+		}
+
+		float2 uv = (ToFloat2(samplePos) + float2(0.5f, 0.5f)) / ToFloat2(depthDims);
+		return camera.WorldPosFromDepth(depthVal, uv);
+	}
+
+	float4 GetDepthAwareMergeWeights(const ProbeInfo3D& probeInfoN, const ProbeInfo3D& probeInfoN1, uint32_t probeScalingFactor, const DepthTexture& depth, const ReferenceCamera& camera)
+	{
+		const int2 depthResolution = depth.GetDims();
+		const float2 depthTexelSize = float2(1.0f, 1.0f) / ToFloat2(depthResolution);
+
+		float2 probeN1Index = ToFloat2(probeInfoN.probeIndex) / (float)probeScalingFactor;
+		// Clamp so sampling doesnt happen between probe groups.
+		float2 clampedProbeN1Index = clamp(probeN1Index, float2(1.0f, 1.0f), ToFloat2(probeInfoN1.probesPerDim) - float2(1.0f, 1.0f));
+		float2 ratios = frac(clampedProbeN1Index);
+
+		float3 cascadeNWorldPos = GetProbeWorldPos(probeInfoN, depth, camera);
+
+		DepthTile depthTileN1 = GetDepthTile(probeInfoN1.probeSpacing, probeInfoN1.tileOrigin);
+		int2 cascadeN1SamplePosOrigin = GetDepthSamplePos(depthTileN1, ToInt2(clampedProbeN1Index), depthResolution);
+
+		float3 sourcePoints[4];
+		for (int32_t i = 0; i < 4; i++)
+		{
+			int2 offset = TranslateCoord4x1To2x2(i);
+			int2 depthSamplePosN1 = ToInt2(ClampPixelPos(ToFloat2(int2(cascadeN1SamplePosOrigin.x + offset.x, cascadeN1SamplePosOrigin.y + offset.y)), depthResolution));
+
+			float cascadeN1Depth = depth.Load(depthSamplePosN1);
+			sourcePoints[i] = camera.WorldPosFromDepth(cascadeN1Depth, ToFloat2(depthSamplePosN1) * depthTexelSize);
+		}
+
+		return GetBilinearSampleWeights(GetBilinear3dRatioIter(sourcePoints, cascadeNWorldPos, ratios, 2));
+	}
+
+	namespace
+	{
+		// Calls func with the MergeScaling of the permutation, or with RuntimeMergeScaling if the permutation is invalid.
+		template<typename ScalingFunc, uint32_t... PermutationIndices>
+		void DispatchMergeScaling(uint32_t permutationIndex, const ScalingFunc& func, std::integer_sequence<uint32_t, PermutationIndices...>)
+		{
+			const bool isSpecialized = ((permutationIndex == PermutationIndices ?
+				(func(MergeScaling<GetPermutationProbeScalingFactor(PermutationIndices), GetPermutationRayScalingDim(PermutationIndices)>{}), true) : false) || ...);
+
+			if (!isSpecialized)
+			{
+				func(RuntimeMergeScaling{});
+			}
+		}
+
+		// Same as RCReproject3DCS.hlsl.
+		constexpr float DepthRejectionTolerance = 0.1f;
+		constexpr float ProbeSnapDistance = 1e-3f;
+
+		// Equivalent of GetTapDepthDifference in RCReproject3DCS.hlsl.
+		float GetTapDepthDifference(float expectedViewDepth, bool isSky, float tapDepth, const ReferenceCamera& historyCamera)
+		{
+			if (isSky || IsZero(tapDepth))
+			{
+				return isSky == IsZero(tapDepth) ? 0.0f : FloatMax;
+			}
+
+			return std::abs(historyCamera.ViewDepthFromDepth(tapDepth) - expectedViewDepth) / expectedViewDepth;
+		}
+	}
+
+	ReferencePipeline::ReferencePipeline(TaskPool& taskPool) : m_taskPool(taskPool)
+	{
+	}
+
+	void ReferencePipeline::Generate(const ReferenceSettings& settings)
+	{
+		assert(settings.tileSize > 0u);
+
+		m_settings = settings;
+		m_layout.Generate(settings.layoutDesc);
+
+		const uint32_t cascadeCount = m_layout.GetCascadeCount();
+		m_cascadeIntervals.resize(cascadeCount);
+		m_gatherFilters.resize(m_layout.GetGatherFilterCount());
+		// The last cascade has nothing to merge with.
+		m_mergeWeights.resize(m_layout.GetGatherFilterCount());
+		m_tracedRayCounts.assign(cascadeCount, 0u);
+		m_cascadeHistory.resize(settings.useStaggeredUpdates ? m_layout.GetGatherFilterCount() : 0u);
+
+		m_updateScheduler.SetDesc(settings.updateSchedule);
+		m_updateScheduler.Reset();
+
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			const CascadeLevel& level = m_layout.GetLevel(i);
+
+			// Alpha of 0.0, same clear color as the GPU: each cascade assumes that its rays are obscured.
+			m_cascadeIntervals[i].Create(level.textureWidth, level.textureHeight);
+
+			if (i > 0)
+			{
+				m_gatherFilters[i - 1].Create(level.textureWidth, level.textureHeight);
+			}
+
+			if (i < m_mergeWeights.size())
+			{
+				m_mergeWeights[i].Create(level.probesX, level.probesY);
+			}
+
+			if (i > 0 && !m_cascadeHistory.empty())
+			{
+				m_cascadeHistory[i - 1].Create(level.textureWidth, level.textureHeight);
+			}
+		}
+
+		// Coalesced result has one pixel per probe0.
+		m_coalescedResult.Create(m_layout.GetProbeCount0X(), m_layout.GetProbeCount0Y());
+	}
+
+	void ReferencePipeline::Run(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RunGather(tracer, camera, depth);
+		RunMerge(camera, depth);
+
+		// Otherwise written by the merge of cascade 0.
+		if (!UsesFusedMergeCoalesce())
+		{
+			RunCoalesce();
+		}
+	}
+
+	void ReferencePipeline::RunStaggered(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(m_settings.useStaggeredUpdates);
+
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		const uint32_t cascadeCount = m_layout.GetCascadeCount();
+
+		std::vector<CascadeUpdate> cascadeUpdates(cascadeCount);
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			cascadeUpdates[i] = m_updateScheduler.GetCascadeUpdate(i, m_cascadeIntervals[i].GetHeight());
+		}
+
+		for (PackedGatherFilter& gatherFilter : m_gatherFilters)
+		{
+			gatherFilter.Clear();
+		}
+
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			if (cascadeUpdates[i].type == CascadeUpdateFull)
+			{
+				m_cascadeIntervals[i].Clear();
+			}
+			else
+			{
+				// Gathered rows are written on top of the reprojected intervals.
+				ReprojectCascade(i, m_cascadeHistory[i - 1], m_historyCamera, m_historyDepth, rcGlobals, camera, depth);
+			}
+		}
+
+		// Same as BuildHiZBuffer() running before the gather every frame.
+		if (UsesHiZMarch())
+		{
+			BuildHiZPyramid(depth, m_hiZMips);
+		}
+
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			const CascadeUpdate& cascadeUpdate = cascadeUpdates[i];
+			if (cascadeUpdate.type == CascadeUpdateReproject)
+			{
+				m_tracedRayCounts[i] = 0u;
+				ResetGatherCounts(i);
+				continue;
+			}
+
+			// The gather filter is only complete if the cascade below was fully gathered. Cascades that are reprojected in later frames
+			// also gather everything, as texels skipped by the filter now could be needed by the merge then.
+			const bool isPreviousCascadeFull = i == 0 || cascadeUpdates[i - 1].type == CascadeUpdateFull;
+			const bool ignoreGatherFilter = !isPreviousCascadeFull || m_updateScheduler.GetRefreshPeriod(i) > 1u;
+
+			if (i > 0 && rcGlobals.useGatherFiltering && m_settings.useActiveProbeDirectionLists && !ignoreGatherFilter)
+			{
+				GatherCascadeCompacted(i, rcGlobals, tracer, camera, depth);
+			}
+			else
+			{
+				GatherCascade(i, cascadeUpdate.rowOffset, cascadeUpdate.rowCount, ignoreGatherFilter, rcGlobals, tracer, camera, depth);
+			}
+		}
+
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			QuantizeCascadeInterval(i);
+		}
+
+		// Stored before merging, so that the history only holds the intervals of each cascade itself.
+		for (uint32_t i = 1; i < cascadeCount; i++)
+		{
+			m_cascadeHistory[i - 1] = m_cascadeIntervals[i];
+		}
+
+		m_historyCamera = camera;
+		m_historyDepth = depth;
+		m_updateScheduler.AdvanceFrame();
+
+		RunMerge(camera, depth);
+
+		if (!UsesFusedMergeCoalesce())
+		{
+			RunCoalesce();
+		}
+	}
+
+	void ReferencePipeline::RunGather(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RunGatherCascades(0u, m_layout.GetCascadeCount(), nullptr, tracer, camera, depth);
+	}
+
+	void ReferencePipeline::RunGatherCascades(uint32_t cascadeBegin, uint32_t cascadeEnd, const PackedGatherFilter* lowerGatherFilter, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(cascadeBegin <= cascadeEnd && cascadeEnd <= m_layout.GetCascadeCount());
+
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		for (RadianceTexture& cascadeInterval : m_cascadeIntervals)
+		{
+			cascadeInterval.Clear();
+		}
+
+		for (PackedGatherFilter& gatherFilter : m_gatherFilters)
+		{
+			gatherFilter.Clear();
+		}
+
+		const bool hasLowerGatherFilter = lowerGatherFilter != nullptr && cascadeBegin > 0u && cascadeBegin < cascadeEnd;
+		if (hasLowerGatherFilter)
+		{
+			m_gatherFilters[cascadeBegin - 1] = *lowerGatherFilter;
+		}
+
+		if (UsesHiZMarch())
+		{
+			BuildHiZPyramid(depth, m_hiZMips);
+		}
+
+		const bool isGatheringEveryCascade = cascadeBegin == 0u && cascadeEnd == m_layout.GetCascadeCount();
+		if (isGatheringEveryCascade && m_settings.useSingleGatherDispatch && !rcGlobals.useGatherFiltering)
+		{
+			GatherAllCascades(rcGlobals, tracer, camera, depth);
+		}
+		else
+		{
+			// Cascades have to be gathered in order as cascade N writes the gather filter read by cascade N + 1.
+			for (uint32_t i = 0; i < m_layout.GetCascadeCount(); i++)
+			{
+				if (i < cascadeBegin || i >= cascadeEnd)
+				{
+					m_tracedRayCounts[i] = 0u;
+					ResetGatherCounts(i);
+					continue;
+				}
+
+				// The gather filter of the lowest cascade is empty unless the cascade below it was gathered or it was passed in.
+				const bool ignoreGatherFilter = i == cascadeBegin && i > 0 && !hasLowerGatherFilter;
+
+				// Cascade 0 has no gather filter to build a list from.
+				if (i > 0 && rcGlobals.useGatherFiltering && m_settings.useActiveProbeDirectionLists && !ignoreGatherFilter)
+				{
+					GatherCascadeCompacted(i, rcGlobals, tracer, camera, depth);
+				}
+				else
+				{
+					GatherCascade(i, 0u, m_cascadeIntervals[i].GetHeight(), ignoreGatherFilter, rcGlobals, tracer, camera, depth);
+				}
+			}
+		}
+
+		// Gathering only reads the gather filters, so every cascade can be stored at once.
+		for (uint32_t i = cascadeBegin; i < cascadeEnd; i++)
+		{
+			QuantizeCascadeInterval(i);
+		}
+	}
+
+	void ReferencePipeline::ReprojectCascadesFrom(const ReferencePipeline& source, const ReferenceCamera& sourceCamera, const DepthTexture& sourceDepth, uint32_t cascadeBegin, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(source.m_layout.GetCascadeCount() == m_layout.GetCascadeCount());
+
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		for (uint32_t i = cascadeBegin; i < m_layout.GetCascadeCount(); i++)
+		{
+			assert(source.m_cascadeIntervals[i].GetWidth() == m_cascadeIntervals[i].GetWidth() && source.m_cascadeIntervals[i].GetHeight() == m_cascadeIntervals[i].GetHeight());
+
+			ReprojectCascade(i, source.m_cascadeIntervals[i], sourceCamera, sourceDepth, rcGlobals, camera, depth);
+			QuantizeCascadeInterval(i);
+		}
+	}
+
+	void ReferencePipeline::RunMerge(const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		const uint32_t cascadeCount = m_layout.GetCascadeCount();
+		if (cascadeCount < 2u)
+		{
+			return;
+		}
+
+		// Weights only depend on depth, so every cascade is done before the first merge like on the GPU.
+		if (rcGlobals.usePrecomputedMergeWeights)
+		{
+			for (uint32_t i = 0; i < cascadeCount - 1; i++)
+			{
+				ComputeMergeWeights(i, rcGlobals, camera, depth);
+			}
+		}
+
+		DispatchMergeScaling(GetMergeScalingPermutation(), [&]<typename Scaling>(Scaling)
+			{
+				// Merged from the top, the last cascade has nothing to merge with.
+				for (int32_t i = int32_t(cascadeCount) - 2; i >= 0; i--)
+				{
+					if (i == 0 && UsesFusedMergeCoalesce())
+					{
+						MergeCoalesceCascade0<Scaling>(rcGlobals, camera, depth);
+					}
+					else
+					{
+						MergeCascade<Scaling>(uint32_t(i), rcGlobals, camera, depth);
+					}
+
+					// Read by the merge of the cascade below.
+					QuantizeCascadeInterval(uint32_t(i));
+				}
+			}, std::make_integer_sequence<uint32_t, ScalingPermutationCount>{});
+	}
+
+	void ReferencePipeline::RunCoalesce()
+	{
+		if (m_cascadeIntervals.empty())
+		{
+			return;
+		}
+
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		const RadianceTexture& cascade0 = m_cascadeIntervals[0];
+		const int32_t probeCount0X = (int32_t)rcGlobals.probeCount0X;
+		const int32_t probeCount0Y = (int32_t)rcGlobals.probeCount0Y;
+
+		const uint32_t rayCount = GetCoalesceRayCount(rcGlobals);
+		const uint32_t rayCount0Sqrt = (uint32_t)std::sqrt((float)rayCount);
+
+		ForEachPixelTiled(m_coalescedResult.GetWidth(), m_coalescedResult.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				float3 summedRadiance = float3(0.0f, 0.0f, 0.0f);
+				for (uint32_t slot = 0; slot < CoalesceRaySlotCount; slot++)
+				{
+					float3 slotRadiance = float3(0.0f, 0.0f, 0.0f);
+					for (uint32_t i = slot; i < rayCount; i += CoalesceRaySlotCount)
+					{
+						const int2 rayIndex = GetCoalesceRayIndex(i, rayCount0Sqrt);
+						slotRadiance += cascade0.Load(x + probeCount0X * rayIndex.x, y + probeCount0Y * rayIndex.y).rgb();
+					}
+
+					summedRadiance += slotRadiance;
+				}
+
+				m_coalescedResult.At(x, y) = float4(summedRadiance / (float)rayCount, 1.0f);
+			});
+	}
+
+	bool ReferencePipeline::WriteOutputs(const std::string& directory) const
+	{
+		std::error_code errorCode;
+		std::filesystem::create_directories(directory, errorCode);
+		if (errorCode)
+		{
+			return false;
+		}
+
+		const std::filesystem::path directoryPath(directory);
+
+		bool success = true;
+		for (uint32_t i = 0; i < (uint32_t)m_cascadeIntervals.size(); i++)
+		{
+			const std::string cascadeName = "cascade_" + std::to_string(i);
+			success &= WritePFM((directoryPath / (cascadeName + ".pfm")).string(), m_cascadeIntervals[i]);
+			success &= WriteAlphaPFM((directoryPath / (cascadeName + "_alpha.pfm")).string(), m_cascadeIntervals[i]);
+		}
+
+		for (uint32_t i = 0; i < (uint32_t)m_gatherFilters.size(); i++)
+		{
+			success &= WritePFM((directoryPath / ("gather_filter_" + std::to_string(i) + ".pfm")).string(), m_gatherFilters[i].Unpack());
+		}
+
+		success &= WritePFM((directoryPath / "coalesced.pfm").string(), m_coalescedResult);
+
+		return success;
+	}
+
+	uint32_t ReferencePipeline::GetMergeScalingPermutation() const
+	{
+		if (!m_settings.useSpecializedMerge)
+		{
+			return InvalidScalingPermutation;
+		}
+
+		const CascadeLayoutDesc& desc = m_layout.GetDesc();
+		return GetScalingPermutationIndex(desc.probeScalingFactor, desc.rayScalingFactor);
+	}
+
+	void ReferencePipeline::FillRCGlobals(RCGlobals& rcGlobalsOut) const
+	{
+		const CascadeLayoutDesc& desc = m_layout.GetDesc();
+
+		rcGlobalsOut.rayCount0 = desc.raysPerProbe0;
+		rcGlobalsOut.rayLength0 = desc.rayLength0;
+
+		rcGlobalsOut.probeScalingFactor = desc.probeScalingFactor;
+		rcGlobalsOut.rayScalingFactor = desc.rayScalingFactor;
+
+		rcGlobalsOut.cascadeCount = m_layout.GetCascadeCount();
+		rcGlobalsOut.gatherFilterCount = m_layout.GetGatherFilterCount();
+
+		rcGlobalsOut.usePreAveraging = desc.isUsingPreAveragedIntervals;
+		rcGlobalsOut.depthAwareMerging = m_settings.useDepthAwareMerging;
+		rcGlobalsOut.usePrecomputedMergeWeights = m_settings.useDepthAwareMerging && m_settings.usePrecomputedMergeWeights;
+
+		rcGlobalsOut.probeCount0X = m_layout.GetProbeCount0X();
+		rcGlobalsOut.probeCount0Y = m_layout.GetProbeCount0Y();
+		rcGlobalsOut.probeSpacing0 = desc.probeSpacing0;
+
+		rcGlobalsOut.useGatherFiltering = m_settings.useGatherFiltering;
+
+		rcGlobalsOut.tileOriginX = m_settings.tileOriginX;
+		rcGlobalsOut.tileOriginY = m_settings.tileOriginY;
+	}
+
+	void ReferencePipeline::ResetGatherCounts(uint32_t cascadeIndex)
+	{
+		m_radianceCacheHitCounts[cascadeIndex] = 0u;
+		for (std::atomic<uint64_t>& hiZMarchCount : m_hiZMarchCounts[cascadeIndex])
+		{
+			hiZMarchCount = 0u;
+		}
+	}
+
+	void ReferencePipeline::GatherCascade(uint32_t cascadeIndex, uint32_t rowOffset, uint32_t rowCount, bool ignoreGatherFilter, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		const RadianceTexture& renderOutput = m_cascadeIntervals[cascadeIndex];
+		assert(rowOffset + rowCount <= renderOutput.GetHeight());
+
+		std::atomic<uint64_t> tracedRayCount = 0u;
+		ResetGatherCounts(cascadeIndex);
+
+		ForEachPixelTiled(renderOutput.GetWidth(), rowCount, [&](int32_t x, int32_t y)
+			{
+				const uint32_t tracedRays = GatherProbeDirection(cascadeIndex, int2(x, y + (int32_t)rowOffset), ignoreGatherFilter, rcGlobals, tracer, camera, depth);
+				tracedRayCount.fetch_add(tracedRays, std::memory_order_relaxed);
+			});
+
+		m_tracedRayCounts[cascadeIndex] = tracedRayCount.load();
+	}
+
+	void ReferencePipeline::GatherCascadeCompacted(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(cascadeIndex > 0 && rcGlobals.useGatherFiltering);
+
+		CompactGatherFilter(m_gatherFilters[cascadeIndex - 1], m_taskPool, m_activeProbeDirections);
+		const uint32_t cascadeWidth = m_cascadeIntervals[cascadeIndex].GetWidth();
+
+		std::atomic<uint64_t> tracedRayCount = 0u;
+		ResetGatherCounts(cascadeIndex);
+
+		ForEachIndexChunked((uint32_t)m_activeProbeDirections.size(), [&](uint32_t listIndex)
+			{
+				const uint32_t texelIndex = m_activeProbeDirections[listIndex];
+				const int2 pixelPos = int2(int32_t(texelIndex % cascadeWidth), int32_t(texelIndex / cascadeWidth));
+
+				const uint32_t tracedRays = GatherProbeDirection(cascadeIndex, pixelPos, false, rcGlobals, tracer, camera, depth);
+				tracedRayCount.fetch_add(tracedRays, std::memory_order_relaxed);
+			});
+
+		m_tracedRayCounts[cascadeIndex] = tracedRayCount.load();
+	}
+
+	void ReferencePipeline::GatherAllCascades(const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(!rcGlobals.useGatherFiltering);
+
+		const uint32_t cascadeCount = m_layout.GetCascadeCount();
+
+		RCShaderShared::uint2 cascadeDims[MaxCascadeCount] = {};
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			cascadeDims[i] = { m_cascadeIntervals[i].GetWidth(), m_cascadeIntervals[i].GetHeight() };
+		}
+
+		const RCShaderShared::CascadeDispatchTable cascadeDispatchTable = RCShaderShared::BuildCascadeDispatchTable(cascadeDims, cascadeCount);
+
+		std::vector<std::atomic<uint64_t>> tracedRayCounts(cascadeCount);
+		for (uint32_t i = 0; i < MaxCascadeCount; i++)
+		{
+			ResetGatherCounts(i);
+		}
+
+		// Chunks run along the linear dispatch index and can span several cascades.
+		ForEachIndexChunked(cascadeDispatchTable.texelCount, [&](uint32_t linearIndex)
+			{
+				const uint32_t cascadeIndex = RCShaderShared::GetDispatchCascadeIndex(cascadeDispatchTable, linearIndex);
+				const RCShaderShared::uint2 texel = RCShaderShared::GetDispatchCascadeTexel(cascadeDispatchTable, cascadeIndex, linearIndex);
+
+				const uint32_t tracedRays = GatherProbeDirection(cascadeIndex, int2((int32_t)texel.x, (int32_t)texel.y), false, rcGlobals, tracer, camera, depth);
+				tracedRayCounts[cascadeIndex].fetch_add(tracedRays, std::memory_order_relaxed);
+			});
+
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			m_tracedRayCounts[i] = tracedRayCounts[i].load();
+		}
+	}
+
+	uint32_t ReferencePipeline::GatherProbeDirection(uint32_t cascadeIndex, const int2& pixelPos, bool ignoreGatherFilter, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RadianceTexture& renderOutput = m_cascadeIntervals[cascadeIndex];
+		const bool isLastCascade = cascadeIndex == (rcGlobals.cascadeCount - 1);
+
+		// The 0th cascade does not have any filtering information to read from, and the last one does not write any.
+		const PackedGatherFilter* gatherFilterN = cascadeIndex > 0 ? &m_gatherFilters[cascadeIndex - 1] : nullptr;
+		PackedGatherFilter* gatherFilterN1 = !isLastCascade ? &m_gatherFilters[cascadeIndex] : nullptr;
+
+		const int32_t translationDim = (int32_t)std::sqrt((float)rcGlobals.rayScalingFactor);
+		const int2 translationDims = int2(translationDim, translationDim);
+
+		const bool useRadianceCache = m_radianceCache != nullptr && !m_radianceCache->IsEmpty() && cascadeIndex >= m_radianceCache->GetInfo().minCascade;
+		const bool useHiZMarch = UsesHiZMarch() && cascadeIndex < m_settings.hiZMarchCascadeCount;
+
+		auto getMissColor = [&](const float3& direction)
+			{
+				if (isLastCascade && m_settings.useSkybox)
+				{
+					return tracer.GetSkyRadiance(direction);
+				}
+
+				return float3(0.0f, 0.0f, 0.0f);
+			};
+
+		auto traceRay = [&](const float3& origin, const float3& direction, float tMin, float tMax) -> float4
+			{
+				// Misses and hits of the march are final, hits take the radiance of the pixel. Screen space hits do not use the radiance cache.
+				if (useHiZMarch)
+				{
+					HiZMarchOutput marchOutput;
+					marchOutput.result = HiZMarchResultOffScreen;
+
+					HiZMarchRay marchRay;
+					if (SetupHiZMarchRay(camera, depth.GetWidth(), depth.GetHeight(), origin, direction, tMin, tMax, marchRay))
+					{
+						marchOutput = MarchHiZ(marchRay, m_hiZMips, camera, m_settings.hiZMarchDesc);
+					}
+
+					m_hiZMarchCounts[cascadeIndex][marchOutput.result].fetch_add(1u, std::memory_order_relaxed);
+
+					if (marchOutput.result == HiZMarchResultHit)
+					{
+						const float4 pixelRadiance = m_sceneRadiance->Load(marchOutput.hitPixel);
+						return float4(pixelRadiance.x, pixelRadiance.y, pixelRadiance.z, 0.0f);
+					}
+					else if (marchOutput.result == HiZMarchResultMiss)
+					{
+						return float4(getMissColor(direction), 1.0f);
+					}
+				}
+
+				RayHit hit;
+				// Probes placed on the far plane end up at FLT_MAX, treat them as misses instead of tracing with a non finite origin.
+				if (IsFinite(origin) && tracer.TraceClosest(origin, direction, tMin, tMax, hit))
+				{
+					// Hits on a cell with enough samples skip shading.
+					if (useRadianceCache)
+					{
+						const RadianceCacheKey key = m_radianceCache->GetKey(origin + direction * hit.t, cascadeIndex);
+
+						float3 cachedRadiance;
+						if (m_radianceCache->Lookup(key, cachedRadiance))
+						{
+							m_radianceCacheHitCounts[cascadeIndex].fetch_add(1u, std::memory_order_relaxed);
+							return float4(cachedRadiance, 0.0f);
+						}
+
+						m_radianceCache->Accumulate(key, hit.emissive);
+					}
+
+					return float4(hit.emissive, 0.0f);
+				}
+
+				return float4(getMissColor(direction), 1.0f);
+			};
+
+		ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex, rcGlobals);
+
+		if (rcGlobals.useGatherFiltering && !ignoreGatherFilter && gatherFilterN != nullptr)
+		{
+			int2 probeNSampleIndex = int2(
+				probeInfo3D.probeIndex.x + probeInfo3D.rayIndex.x * probeInfo3D.probesPerDim.x,
+				probeInfo3D.probeIndex.y + probeInfo3D.rayIndex.y * probeInfo3D.probesPerDim.y
+			);
+
+			if (!gatherFilterN->Test(probeNSampleIndex.x, probeNSampleIndex.y))
+			{
+				return 0u; // These rays will not be used by any lower cascade.
+			}
+		}
+
+		ProbeInfo3D probeInfo3DN1 = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex + 1, rcGlobals);
+
+		const float3 rayOrigin = GetProbeWorldPos(probeInfo3D, depth, camera);
+		const float tMin = probeInfo3D.startDistance;
+		const float tMax = probeInfo3D.startDistance + probeInfo3D.range;
+
+		const int32_t sqrtRayCount = (int32_t)std::sqrt(probeInfo3D.rayCount);
+		uint32_t tracedRayCount = 0u;
+		float4 radianceOutput = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		if (rcGlobals.usePreAveraging)
+		{
+			int2 baseRayIndex = int2(probeInfo3D.rayIndex.x * translationDim, probeInfo3D.rayIndex.y * translationDim);
+
+			// Pre-averaging is done by sampling all upper rays at once.
+			float4 summedRadiance = float4(0.0f, 0.0f, 0.0f, 0.0f);
+			for (int32_t i = 0; i < (int32_t)rcGlobals.rayScalingFactor; i++)
+			{
+				int2 rayIndexOffset = Translate1DTo2D(i, translationDims);
+				int2 rayIndex = int2(baseRayIndex.x + rayIndexOffset.x, baseRayIndex.y + rayIndexOffset.y);
+
+				// Scale with sqrtRayCount to get the correct ray index.
+				summedRadiance += traceRay(rayOrigin, GetRCRayDir(rayIndex, sqrtRayCount), tMin, tMax);
+			}
+
+			// Normalized sum.
+			radianceOutput = summedRadiance / (float)rcGlobals.rayScalingFactor;
+			tracedRayCount = rcGlobals.rayScalingFactor;
+		}
+		else
+		{
+			radianceOutput = traceRay(rayOrigin, GetRCRayDir(probeInfo3D.rayIndex, sqrtRayCount), tMin, tMax);
+			tracedRayCount = 1u;
+		}
+
+		// If gather rays are not fully occluded, they will be used in cascade merging: flag them in the filter of the next cascade.
+		if (rcGlobals.useGatherFiltering && gatherFilterN1 != nullptr && radianceOutput.w > 0.0f)
+		{
+			for (int32_t i = 0; i < (int32_t)rcGlobals.rayScalingFactor; i++)
+			{
+				int2 rayIndexOffset = Translate1DTo2D(i, translationDims);
+				int2 cascadeN1SampleBase = ToInt2(floor(GetCascadeN1SamplePosition(probeInfo3D, probeInfo3DN1, rayIndexOffset, rcGlobals.probeScalingFactor, (uint32_t)translationDim)));
+
+				// Flag bilinear sampling points that they will be used in merging.
+				for (int32_t k = 0; k < 4; k++)
+				{
+					int2 sampleOffset = TranslateCoord4x1To2x2(k);
+					int2 flagPos = int2(cascadeN1SampleBase.x + sampleOffset.x, cascadeN1SampleBase.y + sampleOffset.y);
+
+					// Several tiles can flag texels in the same word, Set() is atomic.
+					gatherFilterN1->Set(flagPos.x, flagPos.y);
+				}
+			}
+		}
+
+		renderOutput.At((uint32_t)pixelPos.x, (uint32_t)pixelPos.y) = radianceOutput;
+
+		return tracedRayCount;
+	}
+
+	template<typename Scaling>
+	void ReferencePipeline::MergeCascade(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RadianceTexture& cascadeN = m_cascadeIntervals[cascadeIndex];
+
+		ForEachPixelTiled(cascadeN.GetWidth(), cascadeN.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				const int2 pixelPos = int2(x, y);
+				ProbeInfo3D probeInfoN = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex, rcGlobals);
+				ProbeInfo3D probeInfoN1 = BuildProbeInfo3DDirFirst(pixelPos, cascadeIndex + 1, rcGlobals);
+
+				float4 nearRadiance = cascadeN.At(x, y);
+
+				// If this ray is obscured (a == 0), the higher cascades should not carry over any information.
+				if (IsZero(nearRadiance.w))
+				{
+					return;
+				}
+
+				cascadeN.At(x, y) = MergeProbeDirection<Scaling>(cascadeIndex, probeInfoN, probeInfoN1, nearRadiance, rcGlobals, camera, depth);
+			});
+	}
+
+	template<typename Scaling>
+	void ReferencePipeline::MergeCoalesceCascade0(const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RadianceTexture& cascade0 = m_cascadeIntervals[0];
+		const int2 probeCounts = int2((int32_t)rcGlobals.probeCount0X, (int32_t)rcGlobals.probeCount0Y);
+
+		const uint32_t rayCount = GetCoalesceRayCount(rcGlobals);
+		const uint32_t rayCount0Sqrt = (uint32_t)std::sqrt((float)rayCount);
+
+		ForEachPixelTiled(m_coalescedResult.GetWidth(), m_coalescedResult.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				// The threads of one probe in a group, each writes its partial sum to groupshared memory.
+				float3 slotRadiance[CoalesceRaySlotCount] = {};
+				for (uint32_t slot = 0; slot < CoalesceRaySlotCount; slot++)
+				{
+					for (uint32_t i = slot; i < rayCount; i += CoalesceRaySlotCount)
+					{
+						const int2 rayIndex = GetCoalesceRayIndex(i, rayCount0Sqrt);
+						const int2 pixelPos = int2(x + probeCounts.x * rayIndex.x, y + probeCounts.y * rayIndex.y);
+
+						ProbeInfo3D probeInfoN = BuildProbeInfo3DDirFirst(pixelPos, 0, rcGlobals);
+						ProbeInfo3D probeInfoN1 = BuildProbeInfo3DDirFirst(pixelPos, 1, rcGlobals);
+
+						float4 radiance = cascade0.Load(pixelPos);
+
+						// If this ray is obscured (a == 0), the higher cascades should not carry over any information.
+						if (!IsZero(radiance.w))
+						{
+							radiance = MergeProbeDirection<Scaling>(0, probeInfoN, probeInfoN1, radiance, rcGlobals, camera, depth);
+							cascade0.Store(pixelPos, radiance);
+						}
+
+						slotRadiance[slot] += radiance.rgb();
+					}
+				}
+
+				// Reduction after the group sync.
+				float3 summedRadiance = float3(0.0f, 0.0f, 0.0f);
+				for (uint32_t k = 0; k < CoalesceRaySlotCount; k++)
+				{
+					summedRadiance += slotRadiance[k];
+				}
+
+				m_coalescedResult.At(x, y) = float4(summedRadiance / (float)rayCount, 1.0f);
+			});
+	}
+
+	template<typename Scaling>
+	float4 ReferencePipeline::MergeProbeDirection(uint32_t cascadeIndex, const ProbeInfo3D& probeInfoN, const ProbeInfo3D& probeInfoN1, const float4& nearRadiance, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth) const
+	{
+		const RadianceTexture& cascadeN1 = m_cascadeIntervals[cascadeIndex + 1];
+		const int2 sourceDims = cascadeN1.GetDims();
+
+		const uint32_t probeScalingFactor = Scaling::GetProbeScalingFactor(rcGlobals);
+		const int32_t rayScalingDim = (int32_t)Scaling::GetRayScalingDim(rcGlobals);
+		const int32_t raysToMerge = rayScalingDim * rayScalingDim;
+		const int2 rayScalingDims = int2(rayScalingDim, rayScalingDim);
+
+		const float2 probesPerDimN1 = ToFloat2(probeInfoN1.probesPerDim);
+		const float2 probeN1ClampMin = float2(1.0f, 1.0f);
+		const float2 probeN1ClampMax = probesPerDimN1 - float2(1.0f, 1.0f);
+
+		float4 normalizedFarRadiance = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		float2 probeN1Index = ToFloat2(probeInfoN.probeIndex) / (float)probeScalingFactor;
+
+		if (rcGlobals.depthAwareMerging)
+		{
+			float4 weights3D = rcGlobals.usePrecomputedMergeWeights ?
+				m_mergeWeights[cascadeIndex].At(probeInfoN.probeIndex.x, probeInfoN.probeIndex.y) :
+				GetDepthAwareMergeWeights(probeInfoN, probeInfoN1, probeScalingFactor, depth, camera);
+
+			for (int32_t i = 0; i < 4; i++)
+			{
+				float2 cascadeN1ProbeIndex = clamp(probeN1Index + ToFloat2(TranslateCoord4x1To2x2(i)), probeN1ClampMin, probeN1ClampMax);
+
+				float4 farRadianceSum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+				for (int32_t k = 0; k < raysToMerge; k++)
+				{
+					float2 cascadeN1RayIndex = ToFloat2(probeInfoN.rayIndex) * (float)rayScalingDim + ToFloat2(Translate1DTo2D(k, rayScalingDims));
+
+					float2 cascadeN1PixelPos = ClampPixelPos(cascadeN1RayIndex * probesPerDimN1 + cascadeN1ProbeIndex, sourceDims);
+					float4 farRadiance = cascadeN1.Load(ToInt2(cascadeN1PixelPos - float2(0.5f, 0.5f)));
+
+					// Radiance is only carried if near field is visible.
+					farRadianceSum += float4(farRadiance.rgb() * nearRadiance.w, nearRadiance.w * farRadiance.w);
+				}
+
+				normalizedFarRadiance += farRadianceSum * (weights3D[i] / raysToMerge);
+			}
+		}
+		else
+		{
+			float4 farRadianceSum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+			for (int32_t i = 0; i < raysToMerge; i++)
+			{
+				int2 rayOffset = Translate1DTo2D(i, rayScalingDims);
+				float2 sampleTexelPos = GetCascadeN1SamplePosition(probeInfoN, probeInfoN1, rayOffset, probeScalingFactor, (uint32_t)rayScalingDim);
+				int2 baseTexel = ToInt2(floor(sampleTexelPos));
+
+				float4 samples[4];
+				for (int32_t k = 0; k < 4; k++)
+				{
+					int2 texelOffset = TranslateCoord4x1To2x2(k);
+					samples[k] = cascadeN1.Load(baseTexel.x + texelOffset.x, baseTexel.y + texelOffset.y);
+				}
+
+				float4 farRadiance = BilinearInterpolation(samples[0], samples[1], samples[2], samples[3], frac(sampleTexelPos));
+
+				// Radiance is only carried if near field is visible.
+				farRadianceSum += float4(farRadiance.rgb() * nearRadiance.w, nearRadiance.w * farRadiance.w);
+			}
+
+			normalizedFarRadiance = farRadianceSum / (float)raysToMerge;
+		}
+
+		return nearRadiance + normalizedFarRadiance;
+	}
+
+	float2 ReferencePipeline::GetHistoryProbeIndex(const ProbeInfo3D& probeInfo3D, const ReferenceCamera& historyCamera, const ReferenceCamera& camera, const DepthTexture& depth) const
+	{
+		const int2 depthDims = depth.GetDims();
+
+		DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+		int2 samplePos = GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depthDims);
+		float2 uv = (ToFloat2(samplePos) + float2(0.5f, 0.5f)) / ToFloat2(depthDims);
+
+		// Probes on the far plane are reprojected as directions, so only the rotation of the camera moves them.
+		float4 probeWorldPos = IsZero(depth.Load(samplePos)) ?
+			float4(camera.GetRayDirection(uv), 0.0f) :
+			float4(GetProbeWorldPos(probeInfo3D, depth, camera), 1.0f);
+
+		float2 prevProbeIndex = ToFloat2(probeInfo3D.probeIndex);
+		float2 prevUV;
+		if (historyCamera.ProjectToUV(probeWorldPos, prevUV))
+		{
+			prevProbeIndex = GetTileProbeIndex(depthTile, prevUV, depthDims);
+		}
+
+		// Probes that were off screen take the closest probe on the edge.
+		const float2 maxProbeIndex = ToFloat2(probeInfo3D.probesPerDim) - float2(1.0f, 1.0f);
+		prevProbeIndex = clamp(prevProbeIndex, float2(0.0f, 0.0f), maxProbeIndex);
+
+		// Projections do not round trip exactly, probes that land next to a history probe read only it. Otherwise a camera that does not
+		// move would blur the history a little more every frame.
+		const float2 closestProbeIndex = float2(std::round(prevProbeIndex.x), std::round(prevProbeIndex.y));
+		prevProbeIndex.x = std::abs(prevProbeIndex.x - closestProbeIndex.x) < ProbeSnapDistance ? closestProbeIndex.x : prevProbeIndex.x;
+		prevProbeIndex.y = std::abs(prevProbeIndex.y - closestProbeIndex.y) < ProbeSnapDistance ? closestProbeIndex.y : prevProbeIndex.y;
+
+		return prevProbeIndex;
+	}
+
+	void ReferencePipeline::ReprojectCascade(uint32_t cascadeIndex, const RadianceTexture& cascadeHistory, const ReferenceCamera& historyCamera, const DepthTexture& historyDepth, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(historyDepth.GetWidth() == depth.GetWidth() && historyDepth.GetHeight() == depth.GetHeight());
+
+		RadianceTexture& renderOutput = m_cascadeIntervals[cascadeIndex];
+		const int2 depthDims = depth.GetDims();
+
+		ForEachPixelTiled(renderOutput.GetWidth(), renderOutput.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(int2(x, y), cascadeIndex, rcGlobals);
+
+				const float2 prevProbeIndex = GetHistoryProbeIndex(probeInfo3D, historyCamera, camera, depth);
+				const int2 baseProbeIndex = ToInt2(floor(prevProbeIndex));
+				const int2 directionOffset = int2(probeInfo3D.rayIndex.x * probeInfo3D.probesPerDim.x, probeInfo3D.rayIndex.y * probeInfo3D.probesPerDim.y);
+
+				// View depth of the probe in the history, sky probes only match sky taps.
+				const DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+				const bool isSky = IsZero(depth.Load(GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depthDims)));
+				const float expectedViewDepth = isSky ? 0.0f : historyCamera.GetViewDepth(GetProbeWorldPos(probeInfo3D, depth, camera));
+
+				// Samples stay inside the direction group of the texel. Each tap is a probe of the history and has its depth there.
+				const float4 bilinearWeights = GetBilinearSampleWeights(frac(prevProbeIndex));
+				float4 radiance = float4(0.0f);
+				float weightSum = 0.0f;
+				float4 closestSample = float4(0.0f);
+				float closestDepthDifference = FloatMax;
+				for (int32_t i = 0; i < 4; i++)
+				{
+					int2 offset = TranslateCoord4x1To2x2(i);
+					int2 sampleProbeIndex = int2(
+						(std::min)(baseProbeIndex.x + offset.x, probeInfo3D.probesPerDim.x - 1),
+						(std::min)(baseProbeIndex.y + offset.y, probeInfo3D.probesPerDim.y - 1)
+					);
+
+					const float4 historySample = cascadeHistory.Load(directionOffset.x + sampleProbeIndex.x, directionOffset.y + sampleProbeIndex.y);
+					const float tapDepth = historyDepth.Load(GetDepthSamplePos(depthTile, sampleProbeIndex, depthDims));
+					const float depthDifference = GetTapDepthDifference(expectedViewDepth, isSky, tapDepth, historyCamera);
+					if (depthDifference <= DepthRejectionTolerance)
+					{
+						radiance += historySample * bilinearWeights[i];
+						weightSum += bilinearWeights[i];
+					}
+
+					if (i == 0 || depthDifference < closestDepthDifference)
+					{
+						closestSample = historySample;
+						closestDepthDifference = depthDifference;
+					}
+				}
+
+				// Every tap is rejected where the probe was disoccluded, the surface closest in depth is the best guess left.
+				renderOutput.At(x, y) = weightSum > 0.0f ? radiance / weightSum : closestSample;
+			});
+	}
+
+	void ReferencePipeline::ReprojectGatherFilterTo(uint32_t cascadeIndex, const ReferenceCamera& camera, const DepthTexture& depth, const ReferenceCamera& targetCamera, PackedGatherFilter& targetFilter)
+	{
+		assert(cascadeIndex > 0);
+
+		RCGlobals rcGlobals = {};
+		FillRCGlobals(rcGlobals);
+
+		const PackedGatherFilter& gatherFilter = m_gatherFilters[cascadeIndex - 1];
+		assert(targetFilter.GetWidth() == gatherFilter.GetWidth() && targetFilter.GetHeight() == gatherFilter.GetHeight());
+
+		ForEachPixelTiled(gatherFilter.GetWidth(), gatherFilter.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				if (!gatherFilter.Test(x, y))
+				{
+					return;
+				}
+
+				ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(int2(x, y), cascadeIndex, rcGlobals);
+
+				// Same 2x2 probes as ReprojectCascade() reads from the target.
+				const int2 baseProbeIndex = ToInt2(floor(GetHistoryProbeIndex(probeInfo3D, targetCamera, camera, depth)));
+				const int2 directionOffset = int2(probeInfo3D.rayIndex.x * probeInfo3D.probesPerDim.x, probeInfo3D.rayIndex.y * probeInfo3D.probesPerDim.y);
+
+				for (int32_t i = 0; i < 4; i++)
+				{
+					int2 offset = TranslateCoord4x1To2x2(i);
+					int2 sampleProbeIndex = int2(
+						(std::min)(baseProbeIndex.x + offset.x, probeInfo3D.probesPerDim.x - 1),
+						(std::min)(baseProbeIndex.y + offset.y, probeInfo3D.probesPerDim.y - 1)
+					);
+
+					// Set() is atomic, texels of different tiles can land on the same word.
+					targetFilter.Set(directionOffset.x + sampleProbeIndex.x, directionOffset.y + sampleProbeIndex.y);
+				}
+			});
+	}
+
+	void ReferencePipeline::QuantizeCascadeInterval(uint32_t cascadeIndex)
+	{
+		if (!m_settings.quantizeIntervals)
+		{
+			return;
+		}
+
+		RadianceTexture& cascadeInterval = m_cascadeIntervals[cascadeIndex];
+		const uint32_t texelCount = (uint32_t)cascadeInterval.GetTexelCount();
+
+		// Same amount of work per task as a tile, each chunk goes through the batch conversion at once.
+		const uint32_t chunkSize = m_settings.tileSize * m_settings.tileSize;
+		const uint32_t chunkCount = (texelCount + chunkSize - 1u) / chunkSize;
+
+		m_taskPool.ParallelFor(chunkCount, [&](uint32_t chunkIndex)
+			{
+				const uint32_t startIndex = chunkIndex * chunkSize;
+				QuantizeIntervals(m_settings.intervalFormat, cascadeInterval.GetData() + startIndex, (std::min)(chunkSize, texelCount - startIndex));
+			});
+	}
+
+	void ReferencePipeline::ComputeMergeWeights(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		MergeWeightTexture& mergeWeights = m_mergeWeights[cascadeIndex];
+
+		ForEachPixelTiled(mergeWeights.GetWidth(), mergeWeights.GetHeight(), [&](int32_t x, int32_t y)
+			{
+				// Probe index is the pixel position of the probe in the first direction group.
+				const int2 probeIndex = int2(x, y);
+				ProbeInfo3D probeInfoN = BuildProbeInfo3DDirFirst(probeIndex, cascadeIndex, rcGlobals);
+				ProbeInfo3D probeInfoN1 = BuildProbeInfo3DDirFirst(probeIndex, cascadeIndex + 1, rcGlobals);
+
+				mergeWeights.At(x, y) = GetDepthAwareMergeWeights(probeInfoN, probeInfoN1, rcGlobals.probeScalingFactor, depth, camera);
+			});
+	}
+
+	template<typename PixelFunc>
+	void ReferencePipeline::ForEachPixelTiled(uint32_t width, uint32_t height, const PixelFunc& func)
+	{
+		const uint32_t tileSize = m_settings.tileSize;
+		const uint32_t tilesX = (width + tileSize - 1u) / tileSize;
+		const uint32_t tilesY = (height + tileSize - 1u) / tileSize;
+
+		m_taskPool.ParallelFor(tilesX * tilesY, [&](uint32_t tileIndex)
+			{
+				const uint32_t startX = (tileIndex % tilesX) * tileSize;
+				const uint32_t startY = (tileIndex / tilesX) * tileSize;
+				const uint32_t endX = std::min(startX + tileSize, width);
+				const uint32_t endY = std::min(startY + tileSize, height);
+
+				for (uint32_t y = startY; y < endY; y++)
+				{
+					for (uint32_t x = startX; x < endX; x++)
+					{
+						func((int32_t)x, (int32_t)y);
+					}
+				}
+			});
+	}
+
+	template<typename IndexFunc>
+	void ReferencePipeline::ForEachIndexChunked(uint32_t count, const IndexFunc& func)
+	{
+		// Same amount of work per task as a tile.
+		const uint32_t chunkSize = m_settings.tileSize * m_settings.tileSize;
+		const uint32_t chunkCount = (count + chunkSize - 1u) / chunkSize;
+
+		m_taskPool.ParallelFor(chunkCount, [&](uint32_t chunkIndex)
+			{
+				const uint32_t startIndex = chunkIndex * chunkSize;
+				const uint32_t endIndex = std::min(startIndex + chunkSize, count);
+
+				for (uint32_t i = startIndex; i < endIndex; i++)
+				{
+					func(i);
+				}
+			});
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "CascadeLayout.h"
+#include "CascadeUpdateScheduler.h"
+#include "GatherFilterBits.h"
+#include "HiZRayMarch.h"
+#include "IntervalEncoding.h"
+#include "RCShaderFunctions.h"
+#include "ReferenceScene.h"
+#include "ReferenceTexture.h"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace CPUReference
+{
+	class RadianceHashCache;
+	class TaskPool;
+
+	struct ReferenceSettings
+	{
+		CascadeLayoutDesc layoutDesc;
+
+		bool useGatherFiltering = true;
+		bool useDepthAwareMerging = false;
+		bool useSkybox = true;
+		// Gathers every cascade in one pass over the linear dispatch index, same as the single DispatchRays on the GPU.
+		// Ignored with gather filtering as cascade N + 1 depends on the gather filter written by cascade N.
+		bool useSingleGatherDispatch = false;
+		// Gathers cascades above 0 over a compacted list of the probe-directions flagged in their gather filter,
+		// instead of testing the filter for every probe-direction. Only used with gather filtering.
+		bool useActiveProbeDirectionLists = false;
+		// Computes the depth aware merge weights once per probe before merging, same as RCMergeWeights3DCS.hlsl,
+		// instead of once per probe-direction inside the merge. Only used with depth aware merging.
+		bool usePrecomputedMergeWeights = true;
+		// Writes the coalesced result while merging cascade 0, same as RCMergeCoalesce3DCS.hlsl. RunCoalesce() is then skipped by Run().
+		bool useFusedMergeCoalesce = true;
+		// Merges with a template instance of the scaling factors if the pair is in CPUReference/ScalingPermutations.h,
+		// same as the specialized merge kernels on the GPU. Otherwise the factors are read at runtime.
+		bool useSpecializedMerge = true;
+		// Rounds every cascade to intervalFormat after it is gathered and after it is merged, like storing it in a cascade texture of that format.
+		// Off keeps full float precision.
+		bool quantizeIntervals = false;
+		IntervalFormat intervalFormat = IntervalFormatFP16;
+		// Keeps a history of every cascade above 0 so that RunStaggered() can reproject the cascades it does not gather.
+		bool useStaggeredUpdates = false;
+		CascadeUpdateScheduleDesc updateSchedule;
+		// Rays of the cascades below this count are marched against a Hi-Z pyramid of the depth buffer first, see HiZRayMarch.h.
+		// Only the rays the march can not answer are traced. Needs the scene radiance, see ReferencePipeline::SetSceneRadiance().
+		uint32_t hiZMarchCascadeCount = 0u;
+		HiZMarchDesc hiZMarchDesc;
+
+		// Side of the square pixel tiles that are handed out to the task pool.
+		uint32_t tileSize = 16u;
+
+		// Screen pixel of the top left corner of the cascades when the screen is processed in tiles, see TiledReferencePipeline.
+		// layoutDesc then has the size of the tile while the depth buffer still covers the whole screen.
+		uint32_t tileOriginX = 0u;
+		uint32_t tileOriginY = 0u;
+	};
+
+	// Headless CPU mirror of the RC3D pipeline: RCRaytraceRT.hlsl -> RCMerge3DCS.hlsl -> RCCoalesce3DCS.hlsl.
+	// Every stage runs the same per pixel logic as its shader, one tile of probe-directions per task.
+	class ReferencePipeline
+	{
+	public:
+		explicit ReferencePipeline(TaskPool& taskPool);
+
+		// Equivalent of RadianceCascadeManager3D::Generate(). Allocates all cascade, filter and coalesce textures.
+		void Generate(const ReferenceSettings& settings);
+
+		// Runs gather, merge and coalesce with a depth buffer rendered from the camera.
+		void Run(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Same as Run(), but only gathers what the update schedule asks for this frame and reprojects the rest of the cascades
+		// from the camera of the previous call. Requires ReferenceSettings::useStaggeredUpdates.
+		void RunStaggered(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Next RunStaggered() gathers every cascade, for camera cuts.
+		void ResetHistory() { m_updateScheduler.Reset(); }
+
+		// Hits of cascades from RadianceCacheInfo::minCascade up read the radiance of the cache instead of shading, on a miss they shade
+		// and accumulate into it. The cache is not owned and can be shared between pipelines, nullptr shades every hit.
+		void SetRadianceCache(RadianceHashCache* radianceCache) { m_radianceCache = radianceCache; }
+		// Radiance of the depth buffer pixels, read by rays that the Hi-Z march hits. Not owned, has to match the depth buffer passed to the runs.
+		void SetSceneRadiance(const RadianceTexture* sceneRadiance) { m_sceneRadiance = sceneRadiance; }
+		bool UsesHiZMarch() const { return m_settings.hiZMarchCascadeCount > 0u && m_sceneRadiance != nullptr; }
+
+		void RunGather(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Only gathers the cascades in [cascadeBegin, cascadeEnd), the others are cleared. The cascade below did not write the gather filter
+		// of the lowest gathered cascade, it reads lowerGatherFilter instead or gathers every texel if that is nullptr.
+		void RunGatherCascades(uint32_t cascadeBegin, uint32_t cascadeEnd, const PackedGatherFilter* lowerGatherFilter, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Overwrites the cascades from cascadeBegin up with the cascades of source, gathered from sourceCamera and sourceDepth, reprojected to the
+		// probes of this camera. Same reprojection as RunStaggered(), source has to have the same layout. Runs between the gather and the merge.
+		void ReprojectCascadesFrom(const ReferencePipeline& source, const ReferenceCamera& sourceCamera, const DepthTexture& sourceDepth, uint32_t cascadeBegin, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Sets the texels of targetFilter, a gather filter of the cascade in a pipeline gathered from targetCamera, that ReprojectCascadesFrom()
+		// reads for the texels set in the gather filter of the cascade after the last gather. ORs the needs of several views into one filter.
+		void ReprojectGatherFilterTo(uint32_t cascadeIndex, const ReferenceCamera& camera, const DepthTexture& depth, const ReferenceCamera& targetCamera, PackedGatherFilter& targetFilter);
+		// Also writes the coalesced result if UsesFusedMergeCoalesce().
+		void RunMerge(const ReferenceCamera& camera, const DepthTexture& depth);
+		void RunCoalesce();
+
+		// A single cascade is never merged, so it always needs the separate coalesce.
+		bool UsesFusedMergeCoalesce() const { return m_settings.useFusedMergeCoalesce && m_layout.GetCascadeCount() > 1u; }
+		// InvalidScalingPermutation if the merge reads the scaling factors at runtime.
+		uint32_t GetMergeScalingPermutation() const;
+
+		// Writes every cascade interval, gather filter and the coalesced result as .pfm files into the directory.
+		bool WriteOutputs(const std::string& directory) const;
+
+		void FillRCGlobals(RCGlobals& rcGlobalsOut) const;
+
+		const CascadeLayout& GetLayout() const { return m_layout; }
+		const ReferenceSettings& GetSettings() const { return m_settings; }
+		const RadianceTexture& GetCascadeInterval(uint32_t cascadeIndex) const { return m_cascadeIntervals[cascadeIndex]; }
+		// Writable so that the merge and coalesce can be run on other data than the last gather.
+		RadianceTexture& GetCascadeInterval(uint32_t cascadeIndex) { return m_cascadeIntervals[cascadeIndex]; }
+		// Filter index i belongs to cascade i + 1.
+		const PackedGatherFilter& GetGatherFilter(uint32_t filterIndex) const { return m_gatherFilters[filterIndex]; }
+		const RadianceTexture& GetCoalescedResult() const { return m_coalescedResult; }
+		// Weights written by the last merge with precomputed merge weights, one texture per cascade but the last one.
+		const MergeWeightTexture& GetMergeWeights(uint32_t cascadeIndex) const { return m_mergeWeights[cascadeIndex]; }
+
+		const CascadeUpdateScheduler& GetUpdateScheduler() const { return m_updateScheduler; }
+
+		// Rays traced during the last gather, counts every pre-averaged sub ray.
+		uint64_t GetTracedRayCount(uint32_t cascadeIndex) const { return m_tracedRayCounts[cascadeIndex]; }
+		// Hits of the last gather that were answered by the radiance cache.
+		uint64_t GetRadianceCacheHitCount(uint32_t cascadeIndex) const { return m_radianceCacheHitCounts[cascadeIndex].load(); }
+		// Rays of the last gather marched against the Hi-Z pyramid, per result. Rays whose start is not on screen count as off screen.
+		// Every result but misses and hits was traced after the march.
+		uint64_t GetHiZMarchCount(uint32_t cascadeIndex, HiZMarchResult result) const { return m_hiZMarchCounts[cascadeIndex][result].load(); }
+
+	private:
+		// Zeroes the radiance cache and Hi-Z march counts of the cascade before it is gathered.
+		void ResetGatherCounts(uint32_t cascadeIndex);
+		// Gathers the rows [rowOffset, rowOffset + rowCount) of the cascade.
+		void GatherCascade(uint32_t cascadeIndex, uint32_t rowOffset, uint32_t rowCount, bool ignoreGatherFilter, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		void GatherCascadeCompacted(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		void GatherAllCascades(const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Body of RayGenerationShader in RCRaytraceRT.hlsl. Returns the amount of rays traced.
+		uint32_t GatherProbeDirection(uint32_t cascadeIndex, const int2& pixelPos, bool ignoreGatherFilter, const RCGlobals& rcGlobals, const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+		// The merge functions are instanced per MergeScaling, like the merge kernel permutations.
+		template<typename Scaling>
+		void MergeCascade(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Body of RCMergeCoalesce3DCS.hlsl, one invocation per probe of cascade 0 that covers every ray slot of its group.
+		template<typename Scaling>
+		void MergeCoalesceCascade0(const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Equivalent of MergeProbeDirection in RCMerge3D.hlsli. Near radiance should not be obscured.
+		template<typename Scaling>
+		float4 MergeProbeDirection(uint32_t cascadeIndex, const ProbeInfo3D& probeInfoN, const ProbeInfo3D& probeInfoN1, const float4& nearRadiance, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth) const;
+		// Probe index in the history the probe reprojects to, clamped to the probes of the cascade.
+		float2 GetHistoryProbeIndex(const ProbeInfo3D& probeInfo3D, const ReferenceCamera& historyCamera, const ReferenceCamera& camera, const DepthTexture& depth) const;
+		// Body of RCReproject3DCS.hlsl, writes every texel of the cascade from its history gathered with historyCamera and historyDepth.
+		void ReprojectCascade(uint32_t cascadeIndex, const RadianceTexture& cascadeHistory, const ReferenceCamera& historyCamera, const DepthTexture& historyDepth, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth);
+		// Does nothing unless ReferenceSettings::quantizeIntervals is set.
+		void QuantizeCascadeInterval(uint32_t cascadeIndex);
+		// Body of RCMergeWeights3DCS.hlsl, one invocation per probe of the cascade.
+		void ComputeMergeWeights(uint32_t cascadeIndex, const RCGlobals& rcGlobals, const ReferenceCamera& camera, const DepthTexture& depth);
+
+		// Splits a width x height grid into tiles and runs func for every pixel, tiles are distributed over the task pool.
+		template<typename PixelFunc>
+		void ForEachPixelTiled(uint32_t width, uint32_t height, const PixelFunc& func);
+		// Splits [0, count) into chunks with as many indices as a tile has pixels, chunks are distributed over the task pool.
+		template<typename IndexFunc>
+		void ForEachIndexChunked(uint32_t count, const IndexFunc& func);
+
+	private:
+		TaskPool& m_taskPool;
+
+		ReferenceSettings m_settings;
+		CascadeLayout m_layout;
+
+		std::vector<RadianceTexture> m_cascadeIntervals;
+		std::vector<PackedGatherFilter> m_gatherFilters;
+		RadianceTexture m_coalescedResult;
+		std::vector<MergeWeightTexture> m_mergeWeights;
+		// Reused between cascades, see GatherCascadeCompacted().
+		std::vector<uint32_t> m_activeProbeDirections;
+
+		std::vector<uint64_t> m_tracedRayCounts;
+
+		RadianceHashCache* m_radianceCache = nullptr;
+		std::array<std::atomic<uint64_t>, MaxCascadeCount> m_radianceCacheHitCounts = {};
+
+		const RadianceTexture* m_sceneRadiance = nullptr;
+		// Rebuilt from the depth buffer by every run that marches.
+		std::vector<MinMaxDepthTexture> m_hiZMips;
+		std::array<std::array<std::atomic<uint64_t>, HiZMarchResultCount>, MaxCascadeCount> m_hiZMarchCounts = {};
+
+		// History index i belongs to cascade i + 1, cascade 0 is gathered every frame. Stored before the merge.
+		std::vector<RadianceTexture> m_cascadeHistory;
+		// Camera and depth buffer the history was gathered with.
+		ReferenceCamera m_historyCamera;
+		DepthTexture m_historyDepth;
+		CascadeUpdateScheduler m_updateScheduler;
+	};
+
+	// Equivalent of GetProbeWorldPos in RCCommon3D.hlsli.
+	float3 GetProbeWorldPos(const ProbeInfo3D& probeInfo3D, const DepthTexture& depth, const ReferenceCamera& camera);
+	// Equivalent of GetDepthAwareMergeWeights in RCCommon3D.hlsli.
+	float4 GetDepthAwareMergeWeights(const ProbeInfo3D& probeInfoN, const ProbeInfo3D& probeInfoN1, uint32_t probeScalingFactor, const DepthTexture& depth, const ReferenceCamera& camera);
+}
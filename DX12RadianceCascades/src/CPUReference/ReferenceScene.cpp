@@ -0,0 +1,301 @@
+#include "ReferenceScene.h"
+#include "RCShaderFunctions.h"
+#include "TaskPool.h"
+
+namespace CPUReference
+{
+	void ReferenceCamera::SetLookAt(const float3& eye, const float3& target, const float3& up)
+	{
+		m_position = eye;
+		m_forward = normalize(target - eye);
+		m_right = normalize(cross(m_forward, up));
+		m_up = cross(m_right, m_forward);
+	}
+
+	void ReferenceCamera::SetLens(float verticalFov, float aspectHeightOverWidth, float nearClip, float farClip)
+	{
+		m_projY = 1.0f / std::tan(verticalFov * 0.5f);
+		m_projX = m_projY * aspectHeightOverWidth;
+		m_nearClip = nearClip;
+		m_farClip = farClip;
+	}
+
+	float3 ReferenceCamera::GetRayDirection(const float2& uv) const
+	{
+		const float ndcX = uv.x * 2.0f - 1.0f;
+		const float ndcY = -(uv.y * 2.0f - 1.0f);
+
+		return normalize(m_right * (ndcX / m_projX) + m_up * (ndcY / m_projY) + m_forward);
+	}
+
+	float ReferenceCamera::DepthFromRayT(const float2& uv, float t) const
+	{
+		if (t >= FloatMax)
+		{
+			return 0.0f;
+		}
+
+		// View space looks down -Z.
+		const float viewZ = -t * dot(GetRayDirection(uv), m_forward);
+
+		// Reverse-Z, same as Math::Camera::UpdateProjMatrix() with finite Z.
+		const float q1 = m_nearClip / (m_farClip - m_nearClip);
+		const float q2 = q1 * m_farClip;
+
+		return saturate((q1 * viewZ + q2) / -viewZ);
+	}
+
+	float3 ReferenceCamera::WorldPosFromDepth(float depthVal, const float2& uv) const
+	{
+		if (IsZero(depthVal))
+		{
+			// Infinitely far away if furthest away.
+			return float3(FloatMax, FloatMax, FloatMax);
+		}
+
+		const float q1 = m_nearClip / (m_farClip - m_nearClip);
+		const float q2 = q1 * m_farClip;
+
+		const float viewZ = -q2 / (depthVal + q1);
+		const float viewX = (uv.x * 2.0f - 1.0f) * -viewZ / m_projX;
+		const float viewY = -(uv.y * 2.0f - 1.0f) * -viewZ / m_projY;
+
+		return m_position + m_right * viewX + m_up * viewY - m_forward * viewZ;
+	}
+
+	bool ReferenceCamera::ProjectToUV(const float4& worldPos, float2& uvOut) const
+	{
+		const float3 relativePos = float3(worldPos.x, worldPos.y, worldPos.z) - m_position * worldPos.w;
+
+		// Distance along the view direction, i.e. -viewZ.
+		const float viewDepth = dot(relativePos, m_forward);
+		if (viewDepth <= 0.0f)
+		{
+			return false;
+		}
+
+		const float ndcX = dot(relativePos, m_right) * m_projX / viewDepth;
+		const float ndcY = dot(relativePos, m_up) * m_projY / viewDepth;
+
+		uvOut = float2(ndcX * 0.5f + 0.5f, -ndcY * 0.5f + 0.5f);
+		return true;
+	}
+
+	float ReferenceCamera::DepthFromViewDepth(float viewDepth) const
+	{
+		const float q1 = m_nearClip / (m_farClip - m_nearClip);
+		const float q2 = q1 * m_farClip;
+
+		return q2 / viewDepth - q1;
+	}
+
+	float ReferenceCamera::ViewDepthFromDepth(float depthVal) const
+	{
+		const float q1 = m_nearClip / (m_farClip - m_nearClip);
+		const float q2 = q1 * m_farClip;
+
+		return q2 / (depthVal + q1);
+	}
+
+	void ReferenceScene::AddSphere(const float3& center, float radius, const float3& emissive)
+	{
+		m_spheres.push_back({ center, radius, emissive });
+	}
+
+	void ReferenceScene::AddTriangle(const float3& v0, const float3& v1, const float3& v2, const float3& emissive)
+	{
+		m_triangles.push_back({ v0, v1 - v0, v2 - v0, emissive });
+	}
+
+	void ReferenceScene::AddQuad(const float3& corner, const float3& edge0, const float3& edge1, const float3& emissive)
+	{
+		AddTriangle(corner, corner + edge0, corner + edge0 + edge1, emissive);
+		AddTriangle(corner, corner + edge0 + edge1, corner + edge1, emissive);
+	}
+
+	bool ReferenceScene::TraceClosest(const float3& origin, const float3& direction, float tMin, float tMax, RayHit& hitOut) const
+	{
+		float closestT = tMax;
+		const float3* closestEmissive = nullptr;
+		float3 closestNormal;
+
+		for (const Sphere& sphere : m_spheres)
+		{
+			float3 oc = origin - sphere.center;
+			float b = dot(oc, direction);
+			float c = dot(oc, oc) - sphere.radius * sphere.radius;
+			float h = b * b - c;
+			if (h < 0.0f)
+			{
+				continue;
+			}
+
+			h = std::sqrt(h);
+			float t = -b - h;
+			if (t < tMin)
+			{
+				t = -b + h;
+			}
+
+			if (t >= tMin && t <= closestT)
+			{
+				closestT = t;
+				closestEmissive = &sphere.emissive;
+				closestNormal = (oc + direction * t) / sphere.radius;
+			}
+		}
+
+		// Moller-Trumbore, triangles are double sided like the GPU path (no culling flags are used).
+		for (const Triangle& triangle : m_triangles)
+		{
+			float3 p = cross(direction, triangle.edge2);
+			float det = dot(triangle.edge1, p);
+			if (std::fabs(det) < 1.0e-8f)
+			{
+				continue;
+			}
+
+			float invDet = 1.0f / det;
+			float3 s = origin - triangle.v0;
+			float u = dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f)
+			{
+				continue;
+			}
+
+			float3 q = cross(s, triangle.edge1);
+			float v = dot(direction, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+			{
+				continue;
+			}
+
+			float t = dot(triangle.edge2, q) * invDet;
+			if (t >= tMin && t <= closestT)
+			{
+				closestT = t;
+				closestEmissive = &triangle.emissive;
+				closestNormal = normalize(cross(triangle.edge1, triangle.edge2));
+			}
+		}
+
+		if (closestEmissive == nullptr)
+		{
+			return false;
+		}
+
+		hitOut.t = closestT;
+		hitOut.emissive = *closestEmissive;
+		hitOut.normal = dot(closestNormal, direction) > 0.0f ? -closestNormal : closestNormal;
+		return true;
+	}
+
+	float3 ReferenceScene::GetSkyRadiance(const float3& direction) const
+	{
+		return SimpleSunsetSky(direction, m_sunDir);
+	}
+
+	void RenderDepth(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, DepthTexture& depthOut)
+	{
+		const uint32_t width = depthOut.GetWidth();
+		const uint32_t height = depthOut.GetHeight();
+
+		// One task per row is plenty for primary visibility.
+		taskPool.ParallelFor(height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					float2 uv = float2((x + 0.5f) / width, (y + 0.5f) / height);
+
+					RayHit hit;
+					float t = FloatMax;
+					if (tracer.TraceClosest(camera.GetPosition(), camera.GetRayDirection(uv), 0.0f, FloatMax, hit))
+					{
+						t = hit.t;
+					}
+
+					depthOut.At(x, y) = camera.DepthFromRayT(uv, t);
+				}
+			});
+	}
+
+	void RenderRadiance(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, RadianceTexture& radianceOut)
+	{
+		const uint32_t width = radianceOut.GetWidth();
+		const uint32_t height = radianceOut.GetHeight();
+
+		taskPool.ParallelFor(height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					float2 uv = float2((x + 0.5f) / width, (y + 0.5f) / height);
+
+					RayHit hit;
+					float4 radiance = float4(0.0f, 0.0f, 0.0f, 1.0f);
+					if (tracer.TraceClosest(camera.GetPosition(), camera.GetRayDirection(uv), 0.0f, FloatMax, hit))
+					{
+						radiance = float4(hit.emissive, 0.0f);
+					}
+
+					radianceOut.At(x, y) = radiance;
+				}
+			});
+	}
+
+	void RenderNormals(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, NormalTexture& normalsOut)
+	{
+		const uint32_t width = normalsOut.GetWidth();
+		const uint32_t height = normalsOut.GetHeight();
+
+		taskPool.ParallelFor(height, [&](uint32_t y)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					float2 uv = float2((x + 0.5f) / width, (y + 0.5f) / height);
+
+					RayHit hit;
+					float3 normal = float3(0.0f, 0.0f, 0.0f);
+					if (tracer.TraceClosest(camera.GetPosition(), camera.GetRayDirection(uv), 0.0f, FloatMax, hit))
+					{
+						normal = hit.normal;
+					}
+
+					normalsOut.At(x, y) = normal;
+				}
+			});
+	}
+
+	void CreateDefaultScene(ReferenceScene& sceneOut, ReferenceCamera& cameraOut, float aspectHeightOverWidth)
+	{
+		const float3 black = float3(0.0f, 0.0f, 0.0f);
+		const float roomSize = 20.0f;
+		const float roomHeight = 10.0f;
+		const float holeSize = 6.0f;
+
+		// Floor and walls.
+		sceneOut.AddQuad(float3(-roomSize, 0.0f, -roomSize), float3(2.0f * roomSize, 0.0f, 0.0f), float3(0.0f, 0.0f, 2.0f * roomSize), black);
+		sceneOut.AddQuad(float3(-roomSize, 0.0f, -roomSize), float3(2.0f * roomSize, 0.0f, 0.0f), float3(0.0f, roomHeight, 0.0f), black);
+		sceneOut.AddQuad(float3(-roomSize, 0.0f, roomSize), float3(2.0f * roomSize, 0.0f, 0.0f), float3(0.0f, roomHeight, 0.0f), black);
+		sceneOut.AddQuad(float3(-roomSize, 0.0f, -roomSize), float3(0.0f, 0.0f, 2.0f * roomSize), float3(0.0f, roomHeight, 0.0f), black);
+		sceneOut.AddQuad(float3(roomSize, 0.0f, -roomSize), float3(0.0f, 0.0f, 2.0f * roomSize), float3(0.0f, roomHeight, 0.0f), black);
+
+		// Ceiling with a square opening in the middle so the sky contributes to the upper cascades.
+		const float ceilingBand = roomSize - holeSize;
+		sceneOut.AddQuad(float3(-roomSize, roomHeight, -roomSize), float3(2.0f * roomSize, 0.0f, 0.0f), float3(0.0f, 0.0f, ceilingBand), black);
+		sceneOut.AddQuad(float3(-roomSize, roomHeight, holeSize), float3(2.0f * roomSize, 0.0f, 0.0f), float3(0.0f, 0.0f, ceilingBand), black);
+		sceneOut.AddQuad(float3(-roomSize, roomHeight, -holeSize), float3(ceilingBand, 0.0f, 0.0f), float3(0.0f, 0.0f, 2.0f * holeSize), black);
+		sceneOut.AddQuad(float3(holeSize, roomHeight, -holeSize), float3(ceilingBand, 0.0f, 0.0f), float3(0.0f, 0.0f, 2.0f * holeSize), black);
+
+		// Emitters.
+		sceneOut.AddSphere(float3(-8.0f, 2.0f, -6.0f), 2.0f, float3(8.0f, 3.0f, 0.5f));
+		sceneOut.AddSphere(float3(6.0f, 1.0f, 2.0f), 1.0f, float3(0.5f, 2.0f, 10.0f));
+		sceneOut.AddQuad(float3(roomSize - 0.01f, 2.0f, -4.0f), float3(0.0f, 0.0f, 8.0f), float3(0.0f, 3.0f, 0.0f), float3(1.0f, 6.0f, 1.0f));
+
+		// Occluders.
+		sceneOut.AddSphere(float3(0.0f, 3.0f, -2.0f), 3.0f, black);
+		sceneOut.AddQuad(float3(-4.0f, 0.0f, 6.0f), float3(8.0f, 0.0f, 0.0f), float3(0.0f, 4.0f, 0.0f), black);
+
+		cameraOut.SetLookAt(float3(0.0f, 7.0f, 18.0f), float3(0.0f, 1.0f, -4.0f), float3(0.0f, 1.0f, 0.0f));
+		cameraOut.SetLens(Pi / 3.0f, aspectHeightOverWidth, 1.0f, 1000.0f);
+	}
+}
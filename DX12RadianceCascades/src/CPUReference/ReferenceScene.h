@@ -0,0 +1,124 @@
+#pragma once
+
+#include "ReferenceMath.h"
+#include "ReferenceTexture.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	struct RayHit
+	{
+		float t = FloatMax;
+		float3 emissive;
+		// Unit length, faces the ray as every surface is double sided.
+		float3 normal;
+	};
+
+	// Anything the reference pipeline can trace rays against.
+	class RayTracer
+	{
+	public:
+		virtual ~RayTracer() = default;
+
+		// Closest hit in [tMin, tMax]. Must be safe to call from multiple threads at once.
+		virtual bool TraceClosest(const float3& origin, const float3& direction, float tMin, float tMax, RayHit& hitOut) const = 0;
+		// Radiance of rays that miss everything, equivalent of the skybox lookup in the miss shader.
+		virtual float3 GetSkyRadiance(const float3& direction) const = 0;
+	};
+
+	// Right handed camera looking down -Z in view space with a reverse-Z projection, same conventions as Math::Camera.
+	class ReferenceCamera
+	{
+	public:
+		ReferenceCamera() = default;
+
+		void SetLookAt(const float3& eye, const float3& target, const float3& up);
+		// Aspect ratio follows MiniEngine convention of height over width.
+		void SetLens(float verticalFov, float aspectHeightOverWidth, float nearClip, float farClip);
+
+		const float3& GetPosition() const { return m_position; }
+		const float3& GetForward() const { return m_forward; }
+
+		// UV is in [0, 1] with (0, 0) in the top left, same as screen space UVs on the GPU.
+		float3 GetRayDirection(const float2& uv) const;
+
+		// Reverse-Z depth value of a point at a distance t along a ray through the given UV. Returns 0 (far plane) for t = FloatMax.
+		float DepthFromRayT(const float2& uv, float t) const;
+		// Equivalent of WorldPosFromDepth in Common.hlsli.
+		float3 WorldPosFromDepth(float depthVal, const float2& uv) const;
+		// Inverse of WorldPosFromDepth, a w of 0 projects a direction instead of a point. The UV is not clamped to [0, 1].
+		// Returns false if the point is behind the camera, same as a clip space w <= 0 on the GPU.
+		bool ProjectToUV(const float4& worldPos, float2& uvOut) const;
+
+		// Distance of the point along the view direction, i.e. -viewZ.
+		float GetViewDepth(const float3& worldPos) const { return dot(worldPos - m_position, m_forward); }
+		// Reverse-Z depth of a view depth, not saturated so that it stays linear in screen space past the far plane.
+		float DepthFromViewDepth(float viewDepth) const;
+		float ViewDepthFromDepth(float depthVal) const;
+		float GetNearClip() const { return m_nearClip; }
+
+	private:
+		float3 m_position = float3(0.0f, 0.0f, 0.0f);
+		float3 m_forward = float3(0.0f, 0.0f, -1.0f);
+		float3 m_right = float3(1.0f, 0.0f, 0.0f);
+		float3 m_up = float3(0.0f, 1.0f, 0.0f);
+
+		float m_projX = 1.0f;
+		float m_projY = 1.0f;
+		float m_nearClip = 1.0f;
+		float m_farClip = 10000.0f;
+	};
+
+	// Analytic scene made out of spheres and triangles. Only emission is stored as that is all the gather stage reads on hit.
+	class ReferenceScene : public RayTracer
+	{
+	public:
+		ReferenceScene() = default;
+
+		void AddSphere(const float3& center, float radius, const float3& emissive);
+		void AddTriangle(const float3& v0, const float3& v1, const float3& v2, const float3& emissive);
+		// Adds a parallelogram spanned by edge0 and edge1 from corner as two triangles.
+		void AddQuad(const float3& corner, const float3& edge0, const float3& edge1, const float3& emissive);
+
+		void SetSunDirection(const float3& sunDir) { m_sunDir = normalize(sunDir); }
+
+		bool TraceClosest(const float3& origin, const float3& direction, float tMin, float tMax, RayHit& hitOut) const override;
+		float3 GetSkyRadiance(const float3& direction) const override;
+
+		uint32_t GetSphereCount() const { return (uint32_t)m_spheres.size(); }
+		uint32_t GetTriangleCount() const { return (uint32_t)m_triangles.size(); }
+
+	private:
+		struct Sphere
+		{
+			float3 center;
+			float radius;
+			float3 emissive;
+		};
+
+		struct Triangle
+		{
+			float3 v0;
+			float3 edge1;
+			float3 edge2;
+			float3 emissive;
+		};
+
+		std::vector<Sphere> m_spheres;
+		std::vector<Triangle> m_triangles;
+		float3 m_sunDir = normalize(float3(1.0f, 1.0f, 0.0f));
+	};
+
+	// Software depth buffer. Every pixel is traced through its center and stores a reverse-Z depth, 0 where nothing was hit.
+	void RenderDepth(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, DepthTexture& depthOut);
+	// Software scene color buffer, traced like RenderDepth(). Stores the emission of the primary hit with an alpha of 0, misses are (0, 0, 0, 1).
+	void RenderRadiance(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, RadianceTexture& radianceOut);
+	// Software normal buffer, traced like RenderDepth(). Misses are zero like the clear value of the scene normal buffer.
+	void RenderNormals(const ReferenceCamera& camera, const RayTracer& tracer, TaskPool& taskPool, NormalTexture& normalsOut);
+
+	// Closed room with a couple of emissive objects and an opening to the sky, similar in spirit to the test scenes used on the GPU.
+	void CreateDefaultScene(ReferenceScene& sceneOut, ReferenceCamera& cameraOut, float aspectHeightOverWidth);
+}
@@ -0,0 +1,97 @@
+#include "ReferenceTexture.h"
+
+#include <fstream>
+#include <functional>
+
+namespace CPUReference
+{
+	namespace
+	{
+		// PFM stores scanlines bottom to top and a negative scale signals little endian data.
+		bool WritePFMInternal(const std::string& filePath, uint32_t width, uint32_t height, uint32_t channelCount, const std::function<float(uint32_t x, uint32_t y, uint32_t channel)>& fetch)
+		{
+			std::ofstream file(filePath, std::ios::binary);
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			file << (channelCount == 3u ? "PF" : "Pf") << "\n" << width << " " << height << "\n-1.0\n";
+
+			std::vector<float> scanline(size_t(width) * channelCount);
+			for (uint32_t row = 0; row < height; row++)
+			{
+				const uint32_t y = height - 1u - row;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					for (uint32_t c = 0; c < channelCount; c++)
+					{
+						scanline[size_t(x) * channelCount + c] = fetch(x, y, c);
+					}
+				}
+
+				file.write(reinterpret_cast<const char*>(scanline.data()), scanline.size() * sizeof(float));
+			}
+
+			return file.good();
+		}
+	}
+
+	bool WritePFM(const std::string& filePath, const RadianceTexture& texture)
+	{
+		return WritePFMInternal(filePath, texture.GetWidth(), texture.GetHeight(), 3u, [&](uint32_t x, uint32_t y, uint32_t c) { return texture.At(x, y)[c]; });
+	}
+
+	bool WriteAlphaPFM(const std::string& filePath, const RadianceTexture& texture)
+	{
+		return WritePFMInternal(filePath, texture.GetWidth(), texture.GetHeight(), 1u, [&](uint32_t x, uint32_t y, uint32_t) { return texture.At(x, y).w; });
+	}
+
+	bool WritePFM(const std::string& filePath, const DepthTexture& texture)
+	{
+		return WritePFMInternal(filePath, texture.GetWidth(), texture.GetHeight(), 1u, [&](uint32_t x, uint32_t y, uint32_t) { return texture.At(x, y); });
+	}
+
+	bool WritePFM(const std::string& filePath, const GatherFilterTexture& texture)
+	{
+		return WritePFMInternal(filePath, texture.GetWidth(), texture.GetHeight(), 1u, [&](uint32_t x, uint32_t y, uint32_t) { return float(texture.At(x, y)); });
+	}
+
+	bool ReadPFM(const std::string& filePath, RadianceTexture& textureOut)
+	{
+		std::ifstream file(filePath, std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		std::string format;
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+		float scale = 0.0f;
+		file >> format >> width >> height >> scale;
+		file.get();
+
+		// Only what WritePFMInternal() writes, little endian rgb.
+		if (!file.good() || format != "PF" || scale >= 0.0f)
+		{
+			return false;
+		}
+
+		textureOut.Create(width, height);
+
+		std::vector<float> scanline(size_t(width) * 3u);
+		for (uint32_t row = 0; row < height; row++)
+		{
+			file.read(reinterpret_cast<char*>(scanline.data()), scanline.size() * sizeof(float));
+
+			const uint32_t y = height - 1u - row;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				textureOut.At(x, y) = float4(scanline[x * 3u], scanline[x * 3u + 1u], scanline[x * 3u + 2u], 0.0f);
+			}
+		}
+
+		return file.good();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ReferenceMath.h"
+
+#include <string>
+#include <vector>
+
+namespace CPUReference
+{
+	// Minimal 2D texture with the same out of bounds rules as a D3D12 UAV/SRV Load: reads return zero and writes are discarded.
+	template<typename TexelType>
+	class ReferenceTexture
+	{
+	public:
+		ReferenceTexture() = default;
+		ReferenceTexture(uint32_t width, uint32_t height) { Create(width, height); }
+
+		void Create(uint32_t width, uint32_t height)
+		{
+			m_width = width;
+			m_height = height;
+			m_texels.assign(size_t(width) * height, TexelType{});
+		}
+
+		void Clear(const TexelType& clearValue = TexelType{}) { std::fill(m_texels.begin(), m_texels.end(), clearValue); }
+
+		bool IsInBounds(int32_t x, int32_t y) const { return x >= 0 && y >= 0 && x < (int32_t)m_width && y < (int32_t)m_height; }
+
+		TexelType Load(int32_t x, int32_t y) const { return IsInBounds(x, y) ? m_texels[Index(x, y)] : TexelType{}; }
+		TexelType Load(const int2& pos) const { return Load(pos.x, pos.y); }
+
+		void Store(int32_t x, int32_t y, const TexelType& value)
+		{
+			if (IsInBounds(x, y))
+			{
+				m_texels[Index(x, y)] = value;
+			}
+		}
+		void Store(const int2& pos, const TexelType& value) { Store(pos.x, pos.y, value); }
+
+		TexelType& At(uint32_t x, uint32_t y) { return m_texels[Index(x, y)]; }
+		const TexelType& At(uint32_t x, uint32_t y) const { return m_texels[Index(x, y)]; }
+
+		uint32_t GetWidth() const { return m_width; }
+		uint32_t GetHeight() const { return m_height; }
+		int2 GetDims() const { return int2((int32_t)m_width, (int32_t)m_height); }
+
+		TexelType* GetData() { return m_texels.data(); }
+		const TexelType* GetData() const { return m_texels.data(); }
+		size_t GetTexelCount() const { return m_texels.size(); }
+
+	private:
+		size_t Index(uint32_t x, uint32_t y) const { return size_t(y) * m_width + x; }
+
+	private:
+		uint32_t m_width = 0u;
+		uint32_t m_height = 0u;
+		std::vector<TexelType> m_texels;
+	};
+
+	typedef ReferenceTexture<float4> RadianceTexture;
+	typedef ReferenceTexture<float> DepthTexture;
+	typedef ReferenceTexture<float3> NormalTexture;
+	// Byte per texel layout of a gather filter (R8 on the GPU). See PackedGatherFilter for the bit packed layout.
+	typedef ReferenceTexture<uint32_t> GatherFilterTexture;
+	// One float4 of depth aware merge weights per probe of a cascade.
+	typedef ReferenceTexture<float4> MergeWeightTexture;
+
+	// Writes the texture as a Portable Float Map (.pfm). Alpha is dropped as the format only supports 1 or 3 channels.
+	bool WritePFM(const std::string& filePath, const RadianceTexture& texture);
+	// Writes the alpha channel of the texture as a greyscale .pfm.
+	bool WriteAlphaPFM(const std::string& filePath, const RadianceTexture& texture);
+	bool WritePFM(const std::string& filePath, const DepthTexture& texture);
+	bool WritePFM(const std::string& filePath, const GatherFilterTexture& texture);
+
+	// Reads a 3 channel .pfm as written by WritePFM(), alpha is 0. False if the file is missing or not in that format.
+	bool ReadPFM(const std::string& filePath, RadianceTexture& textureOut);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Pairs of probe and ray scaling factors that the merge is specialized for, shared by the GPU and the CPU reference.
+// On the GPU each pair is a permutation of RCMerge3DCS.hlsl and RCMergeCoalesce3DCS.hlsl compiled with RC_PROBE_SCALING_FACTOR and RC_RAY_SCALING_DIM,
+// on the CPU a template instance of the merge in ReferencePipeline.cpp.
+
+#include <cmath>
+#include <cstdint>
+
+namespace CPUReference
+{
+	// Per dim, a probe of cascade N + 1 covers probeScalingFactor x probeScalingFactor probes of cascade N.
+	constexpr uint32_t SupportedProbeScalingFactors[] = { 2u, 3u, 4u };
+	// Per dim, a ray of cascade N is split into rayScalingDim x rayScalingDim rays in cascade N + 1.
+	constexpr uint32_t SupportedRayScalingDims[] = { 2u, 3u, 4u };
+
+	constexpr uint32_t SupportedProbeScalingFactorCount = sizeof(SupportedProbeScalingFactors) / sizeof(SupportedProbeScalingFactors[0]);
+	constexpr uint32_t SupportedRayScalingDimCount = sizeof(SupportedRayScalingDims) / sizeof(SupportedRayScalingDims[0]);
+	constexpr uint32_t ScalingPermutationCount = SupportedProbeScalingFactorCount * SupportedRayScalingDimCount;
+	// Returned for scaling factors without a specialized merge, which then read the factors at runtime.
+	constexpr uint32_t InvalidScalingPermutation = ScalingPermutationCount;
+
+	constexpr uint32_t GetPermutationProbeScalingFactor(uint32_t permutationIndex) { return SupportedProbeScalingFactors[permutationIndex / SupportedRayScalingDimCount]; }
+	constexpr uint32_t GetPermutationRayScalingDim(uint32_t permutationIndex) { return SupportedRayScalingDims[permutationIndex % SupportedRayScalingDimCount]; }
+	constexpr uint32_t GetPermutationRayScalingFactor(uint32_t permutationIndex) { return GetPermutationRayScalingDim(permutationIndex) * GetPermutationRayScalingDim(permutationIndex); }
+
+	// Ray scaling factors have to be perfect squares, returns 0 otherwise.
+	inline uint32_t GetRayScalingDim(uint32_t rayScalingFactor)
+	{
+		const uint32_t rayScalingDim = (uint32_t)std::lround(std::sqrt((double)rayScalingFactor));
+		return rayScalingDim * rayScalingDim == rayScalingFactor ? rayScalingDim : 0u;
+	}
+
+	inline uint32_t GetScalingPermutationIndex(uint32_t probeScalingFactor, uint32_t rayScalingFactor)
+	{
+		for (uint32_t i = 0; i < ScalingPermutationCount; i++)
+		{
+			if (GetPermutationProbeScalingFactor(i) == probeScalingFactor && GetPermutationRayScalingFactor(i) == rayScalingFactor)
+			{
+				return i;
+			}
+		}
+
+		return InvalidScalingPermutation;
+	}
+
+	// Rays per probe of cascade 0 has to be a perfect square. With pre-averaging every cascade 0 texel averages rayScalingFactor rays,
+	// so it also has to be rayScalingFactor times a perfect square.
+	inline bool IsValidRayCount0(uint32_t raysPerProbe0, uint32_t rayScalingFactor, bool isUsingPreAveragedIntervals)
+	{
+		if (isUsingPreAveragedIntervals)
+		{
+			return raysPerProbe0 % rayScalingFactor == 0u && GetRayScalingDim(raysPerProbe0 / rayScalingFactor) > 0u;
+		}
+
+		return GetRayScalingDim(raysPerProbe0) > 0u;
+	}
+
+	// Smallest valid ray count of cascade 0 that is not less than raysPerProbe0.
+	inline uint32_t GetValidRayCount0(uint32_t raysPerProbe0, uint32_t rayScalingFactor, bool isUsingPreAveragedIntervals)
+	{
+		const uint32_t rayCountStep = isUsingPreAveragedIntervals ? rayScalingFactor : 1u;
+
+		uint32_t raysPerDim = 1u;
+		while (rayCountStep * raysPerDim * raysPerDim < raysPerProbe0)
+		{
+			raysPerDim++;
+		}
+
+		return rayCountStep * raysPerDim * raysPerDim;
+	}
+}
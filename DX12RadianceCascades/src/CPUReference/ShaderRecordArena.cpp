@@ -0,0 +1,319 @@
+#include "ShaderRecordArena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace CPUReference
+{
+	namespace
+	{
+		uint64_t AlignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1u) / alignment * alignment;
+		}
+	}
+
+	ShaderRecordArena::ShaderRecordArena(uint32_t localDataSize)
+		: m_localDataSize(localDataSize), m_recordStride((uint32_t)AlignUp(ShaderIdentifierSize + localDataSize, ShaderRecordAlignment))
+	{
+	}
+
+	uint32_t ShaderRecordArena::AddIdentifierSlot(const ShaderIdentifier& identifier)
+	{
+		m_identifiers.push_back(identifier);
+		return (uint32_t)m_identifiers.size() - 1u;
+	}
+
+	uint32_t ShaderRecordArena::SetIdentifier(uint32_t slot, const ShaderIdentifier& identifier)
+	{
+		assert(slot < m_identifiers.size());
+
+		if (std::memcmp(m_identifiers[slot].data, identifier.data, ShaderIdentifierSize) == 0)
+		{
+			return 0u;
+		}
+
+		m_identifiers[slot] = identifier;
+
+		uint32_t patchedCount = 0u;
+		for (const Block& block : m_blocks)
+		{
+			if (block.refCount == 0u)
+			{
+				continue;
+			}
+
+			for (uint32_t recordIndex = 0; recordIndex < (uint32_t)block.identifierSlots.size(); recordIndex++)
+			{
+				if (block.identifierSlots[recordIndex] == slot)
+				{
+					const uint64_t recordOffset = block.offset + uint64_t(recordIndex) * m_recordStride;
+					std::memcpy(&m_data[recordOffset], identifier.data, ShaderIdentifierSize);
+					MarkDirty(recordOffset, ShaderIdentifierSize);
+					patchedCount++;
+				}
+			}
+		}
+
+		return patchedCount;
+	}
+
+	uint32_t ShaderRecordArena::AddTable(const std::vector<ShaderRecordDesc>& records)
+	{
+		Table table;
+		table.recordCount = (uint32_t)records.size();
+
+		if (!FindRun(records, table.blockIndex, table.firstRecord))
+		{
+			uint32_t blockIndex = 0u;
+			if (!m_freeBlocks.empty())
+			{
+				blockIndex = m_freeBlocks.back();
+				m_freeBlocks.pop_back();
+			}
+			else
+			{
+				blockIndex = (uint32_t)m_blocks.size();
+				m_blocks.emplace_back();
+			}
+
+			Block& block = m_blocks[blockIndex];
+			block.offset = Allocate((std::max)(uint64_t(records.size()) * m_recordStride, uint64_t(ShaderTableAlignment)));
+			block.identifierSlots.resize(records.size());
+			for (uint32_t recordIndex = 0; recordIndex < (uint32_t)records.size(); recordIndex++)
+			{
+				assert(records[recordIndex].identifierSlot < m_identifiers.size());
+
+				block.identifierSlots[recordIndex] = records[recordIndex].identifierSlot;
+				WriteRecord(block.offset + uint64_t(recordIndex) * m_recordStride, records[recordIndex]);
+			}
+
+			table.blockIndex = blockIndex;
+			table.firstRecord = 0u;
+		}
+
+		m_blocks[table.blockIndex].refCount++;
+
+		if (!m_freeTables.empty())
+		{
+			const uint32_t tableIndex = m_freeTables.back();
+			m_freeTables.pop_back();
+			m_tables[tableIndex] = table;
+			return tableIndex;
+		}
+
+		m_tables.push_back(table);
+		return (uint32_t)m_tables.size() - 1u;
+	}
+
+	void ShaderRecordArena::ReleaseTable(uint32_t table)
+	{
+		assert(table < m_tables.size() && m_tables[table].blockIndex != UINT32_MAX);
+
+		const uint32_t blockIndex = m_tables[table].blockIndex;
+		m_tables[table] = {};
+		m_freeTables.push_back(table);
+
+		Block& block = m_blocks[blockIndex];
+		assert(block.refCount > 0u);
+		if (--block.refCount == 0u)
+		{
+			Free(block.offset, (std::max)(uint64_t(block.identifierSlots.size()) * m_recordStride, uint64_t(ShaderTableAlignment)));
+			block.identifierSlots.clear();
+			m_freeBlocks.push_back(blockIndex);
+		}
+	}
+
+	uint64_t ShaderRecordArena::GetTableOffset(uint32_t table) const
+	{
+		const Table& tableData = m_tables[table];
+		return m_blocks[tableData.blockIndex].offset + uint64_t(tableData.firstRecord) * m_recordStride;
+	}
+
+	uint64_t ShaderRecordArena::GetStoredRecordCount() const
+	{
+		uint64_t recordCount = 0u;
+		for (const Block& block : m_blocks)
+		{
+			recordCount += block.refCount > 0u ? block.identifierSlots.size() : 0u;
+		}
+
+		return recordCount;
+	}
+
+	uint64_t ShaderRecordArena::GetTableRecordCountSum() const
+	{
+		uint64_t recordCount = 0u;
+		for (const Table& table : m_tables)
+		{
+			recordCount += table.recordCount;
+		}
+
+		return recordCount;
+	}
+
+	void ShaderRecordArena::TakeDirtyRanges(std::vector<ShaderRecordByteRange>& rangesOut, uint64_t maxGap)
+	{
+		rangesOut.clear();
+
+		std::sort(m_dirtyRanges.begin(), m_dirtyRanges.end(), [](const ShaderRecordByteRange& a, const ShaderRecordByteRange& b) { return a.offset < b.offset; });
+		for (ShaderRecordByteRange range : m_dirtyRanges)
+		{
+			// Ranges of records that were freed since, past the end of the arena.
+			if (range.offset >= (uint64_t)m_data.size())
+			{
+				continue;
+			}
+
+			range.byteCount = (std::min)(range.byteCount, (uint64_t)m_data.size() - range.offset);
+
+			if (!rangesOut.empty() && range.offset <= rangesOut.back().offset + rangesOut.back().byteCount + maxGap)
+			{
+				ShaderRecordByteRange& lastRange = rangesOut.back();
+				lastRange.byteCount = (std::max)(lastRange.byteCount, range.offset + range.byteCount - lastRange.offset);
+			}
+			else
+			{
+				rangesOut.push_back(range);
+			}
+		}
+
+		m_dirtyRanges.clear();
+	}
+
+	bool ShaderRecordArena::IsRecordEqual(const Block& block, uint32_t recordIndex, const ShaderRecordDesc& record) const
+	{
+		if (block.identifierSlots[recordIndex] != record.identifierSlot)
+		{
+			return false;
+		}
+
+		const uint8_t* localData = &m_data[block.offset + uint64_t(recordIndex) * m_recordStride + ShaderIdentifierSize];
+		if (record.localData != nullptr)
+		{
+			return std::memcmp(localData, record.localData, m_localDataSize) == 0;
+		}
+
+		return std::all_of(localData, localData + m_localDataSize, [](uint8_t byte) { return byte == 0u; });
+	}
+
+	bool ShaderRecordArena::FindRun(const std::vector<ShaderRecordDesc>& records, uint32_t& blockIndexOut, uint32_t& firstRecordOut) const
+	{
+		if (records.empty())
+		{
+			return false;
+		}
+
+		for (uint32_t blockIndex = 0; blockIndex < (uint32_t)m_blocks.size(); blockIndex++)
+		{
+			const Block& block = m_blocks[blockIndex];
+			const uint32_t blockRecordCount = (uint32_t)block.identifierSlots.size();
+			if (block.refCount == 0u || blockRecordCount < records.size())
+			{
+				continue;
+			}
+
+			// Tables have to start on ShaderTableAlignment, which records only do every few strides.
+			const uint32_t recordStep = (uint32_t)(std::max)(uint64_t(ShaderTableAlignment) / m_recordStride, uint64_t(1u));
+			for (uint32_t firstRecord = 0; firstRecord + records.size() <= blockRecordCount; firstRecord += recordStep)
+			{
+				if ((block.offset + uint64_t(firstRecord) * m_recordStride) % ShaderTableAlignment != 0u)
+				{
+					continue;
+				}
+
+				bool isRun = true;
+				for (uint32_t recordIndex = 0; recordIndex < (uint32_t)records.size() && isRun; recordIndex++)
+				{
+					isRun = IsRecordEqual(block, firstRecord + recordIndex, records[recordIndex]);
+				}
+
+				if (isRun)
+				{
+					blockIndexOut = blockIndex;
+					firstRecordOut = firstRecord;
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	uint64_t ShaderRecordArena::Allocate(uint64_t byteCount)
+	{
+		byteCount = AlignUp(byteCount, ShaderTableAlignment);
+
+		for (size_t i = 0; i < m_freeRanges.size(); i++)
+		{
+			ShaderRecordByteRange& range = m_freeRanges[i];
+			if (range.byteCount >= byteCount)
+			{
+				const uint64_t offset = range.offset;
+				range.offset += byteCount;
+				range.byteCount -= byteCount;
+				if (range.byteCount == 0u)
+				{
+					m_freeRanges.erase(m_freeRanges.begin() + i);
+				}
+
+				return offset;
+			}
+		}
+
+		const uint64_t offset = (uint64_t)m_data.size();
+		m_data.resize(offset + byteCount, 0u);
+		return offset;
+	}
+
+	void ShaderRecordArena::Free(uint64_t offset, uint64_t byteCount)
+	{
+		byteCount = AlignUp(byteCount, ShaderTableAlignment);
+
+		auto it = std::lower_bound(m_freeRanges.begin(), m_freeRanges.end(), offset, [](const ShaderRecordByteRange& range, uint64_t value) { return range.offset < value; });
+		it = m_freeRanges.insert(it, { offset, byteCount });
+
+		auto next = it + 1;
+		if (next != m_freeRanges.end() && it->offset + it->byteCount == next->offset)
+		{
+			it->byteCount += next->byteCount;
+			m_freeRanges.erase(next);
+		}
+
+		if (it != m_freeRanges.begin())
+		{
+			auto previous = it - 1;
+			if (previous->offset + previous->byteCount == it->offset)
+			{
+				previous->byteCount += it->byteCount;
+				it = m_freeRanges.erase(it) - 1;
+			}
+		}
+
+		// A free range at the end shrinks the arena, nothing past it has to be uploaded.
+		if (it->offset + it->byteCount == (uint64_t)m_data.size())
+		{
+			m_data.resize(it->offset);
+			m_freeRanges.erase(it);
+		}
+	}
+
+	void ShaderRecordArena::WriteRecord(uint64_t offset, const ShaderRecordDesc& record)
+	{
+		uint8_t* recordData = &m_data[offset];
+		std::memcpy(recordData, m_identifiers[record.identifierSlot].data, ShaderIdentifierSize);
+		std::memset(recordData + ShaderIdentifierSize, 0, m_recordStride - ShaderIdentifierSize);
+		if (record.localData != nullptr)
+		{
+			std::memcpy(recordData + ShaderIdentifierSize, record.localData, m_localDataSize);
+		}
+
+		MarkDirty(offset, m_recordStride);
+	}
+
+	void ShaderRecordArena::MarkDirty(uint64_t offset, uint64_t byteCount)
+	{
+		m_dirtyRanges.push_back({ offset, byteCount });
+	}
+}
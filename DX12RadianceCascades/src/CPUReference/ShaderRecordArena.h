@@ -0,0 +1,116 @@
+#pragma once
+
+// Every shader table of the app in one arena, see ShaderTableArena.h. Records do not hold their shader identifier, they reference an
+// identifier slot, one per export of a PSO, so when a PSO is recompiled only the records of its slots are patched and nothing is rebuilt.
+// Tables are deduplicated: a table whose records, slot and local data, match a run of records already stored shares them, so building
+// the same dispatch again or a dispatch over fewer models takes no space. Freed ranges are reused first fit.
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	// Same as D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT and
+	// D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT, which are checked where the arena is uploaded.
+	constexpr uint32_t ShaderIdentifierSize = 32u;
+	constexpr uint32_t ShaderRecordAlignment = 32u;
+	constexpr uint32_t ShaderTableAlignment = 64u;
+
+	struct ShaderIdentifier
+	{
+		uint8_t data[ShaderIdentifierSize] = {};
+	};
+
+	struct ShaderRecordDesc
+	{
+		uint32_t identifierSlot = 0u;
+		// Local root arguments of the arena's size, null for none. Bytes past them up to the stride are 0.
+		const void* localData = nullptr;
+	};
+
+	struct ShaderRecordByteRange
+	{
+		uint64_t offset = 0u;
+		uint64_t byteCount = 0u;
+	};
+
+	class ShaderRecordArena
+	{
+	public:
+		static constexpr uint32_t InvalidTable = UINT32_MAX;
+
+		explicit ShaderRecordArena(uint32_t localDataSize = 0u);
+
+		// The identifier followed by the local data, aligned to ShaderRecordAlignment.
+		uint32_t GetRecordStride() const { return m_recordStride; }
+		uint32_t GetLocalDataSize() const { return m_localDataSize; }
+
+		uint32_t AddIdentifierSlot(const ShaderIdentifier& identifier);
+		// Rewrites the identifier of every record using the slot, if it changed. Returns the amount of records patched.
+		uint32_t SetIdentifier(uint32_t slot, const ShaderIdentifier& identifier);
+		const ShaderIdentifier& GetIdentifier(uint32_t slot) const { return m_identifiers[slot]; }
+
+		// Records are laid out in order at GetRecordStride() from the start of the table, which is aligned to ShaderTableAlignment.
+		uint32_t AddTable(const std::vector<ShaderRecordDesc>& records);
+		// The records stay until every table sharing them is released.
+		void ReleaseTable(uint32_t table);
+
+		uint64_t GetTableOffset(uint32_t table) const;
+		uint32_t GetTableRecordCount(uint32_t table) const { return m_tables[table].recordCount; }
+		uint64_t GetTableByteCount(uint32_t table) const { return uint64_t(m_tables[table].recordCount) * m_recordStride; }
+
+		const uint8_t* GetData() const { return m_data.data(); }
+		// Up to the end of the last range in use, what has to be uploaded.
+		uint64_t GetByteCount() const { return (uint64_t)m_data.size(); }
+
+		// Records stored against records of every live table, less when tables share records.
+		uint64_t GetStoredRecordCount() const;
+		uint64_t GetTableRecordCountSum() const;
+
+		bool HasDirtyRanges() const { return !m_dirtyRanges.empty(); }
+		// Bytes written since the last call as sorted ranges inside GetByteCount(), and clears them. Ranges closer than maxGap bytes
+		// are joined, so the clean bytes between them count as written.
+		void TakeDirtyRanges(std::vector<ShaderRecordByteRange>& rangesOut, uint64_t maxGap = 0u);
+
+	private:
+		struct Block
+		{
+			uint64_t offset = 0u;
+			std::vector<uint32_t> identifierSlots;
+			uint32_t refCount = 0u;
+		};
+
+		struct Table
+		{
+			uint32_t blockIndex = UINT32_MAX;
+			uint32_t firstRecord = 0u;
+			uint32_t recordCount = 0u;
+		};
+
+		bool IsRecordEqual(const Block& block, uint32_t recordIndex, const ShaderRecordDesc& record) const;
+		// Returns the block and the record the run starts at, or false.
+		bool FindRun(const std::vector<ShaderRecordDesc>& records, uint32_t& blockIndexOut, uint32_t& firstRecordOut) const;
+
+		uint64_t Allocate(uint64_t byteCount);
+		void Free(uint64_t offset, uint64_t byteCount);
+
+		void WriteRecord(uint64_t offset, const ShaderRecordDesc& record);
+		void MarkDirty(uint64_t offset, uint64_t byteCount);
+
+	private:
+		uint32_t m_localDataSize = 0u;
+		uint32_t m_recordStride = 0u;
+
+		std::vector<uint8_t> m_data;
+		std::vector<ShaderIdentifier> m_identifiers;
+
+		std::vector<Block> m_blocks;
+		std::vector<uint32_t> m_freeBlocks;
+		std::vector<Table> m_tables;
+		std::vector<uint32_t> m_freeTables;
+
+		// Sorted by offset, never touching.
+		std::vector<ShaderRecordByteRange> m_freeRanges;
+		std::vector<ShaderRecordByteRange> m_dirtyRanges;
+	};
+}
@@ -0,0 +1,875 @@
+#include "SoftwareBVH.h"
+#include "RCShaderFunctions.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPUREF_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define CPUREF_USE_SSE2 0
+#endif
+
+namespace CPUReference
+{
+	namespace
+	{
+		// 3 entries per level at most, as every node pops one and pushes up to 4.
+		constexpr uint32_t MaxTraversalDepth = 80u;
+		constexpr uint32_t TraversalStackSize = MaxTraversalDepth * 3u + 1u;
+
+		struct BuildNode
+		{
+			BVHBounds bounds;
+			uint32_t left = 0u;
+			uint32_t right = 0u;
+			uint32_t first = 0u;
+			// Leaves have a count.
+			uint32_t count = 0u;
+		};
+
+		struct BuildBin
+		{
+			BVHBounds bounds;
+			uint32_t count = 0u;
+		};
+
+		// Ray prepared for slab tests against the children of a node.
+		struct NodeRay
+		{
+			float origin[3];
+			float invDirection[3];
+			// Plane of the near side of the bounds, 0 for the min and 1 for the max.
+			uint32_t nearPlane[3];
+		};
+
+		struct StackEntry
+		{
+			uint32_t child;
+			uint32_t rayMask;
+			float tNear;
+		};
+
+		double GetElapsedMs(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		float3 GetCentroid(const BVHBounds& bounds)
+		{
+			return (bounds.boundsMin + bounds.boundsMax) * 0.5f;
+		}
+
+		NodeRay SetupNodeRay(const float3& origin, const float3& direction)
+		{
+			NodeRay nodeRay;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				// Keeps 0 * inf out of the slab test for rays parallel to a plane.
+				const float d = std::fabs(direction[axis]) > 1.0e-20f ? direction[axis] : std::copysign(1.0e-20f, direction[axis]);
+				nodeRay.origin[axis] = origin[axis];
+				nodeRay.invDirection[axis] = 1.0f / d;
+				nodeRay.nearPlane[axis] = d < 0.0f ? 1u : 0u;
+			}
+
+			return nodeRay;
+		}
+
+		// Returns a bit per child the ray overlaps in [tMin, tMax], with the distance to each in tNearOut.
+		uint32_t IntersectNode(const BVH4Node& node, const NodeRay& ray, float tMin, float tMax, float tNearOut[4])
+		{
+			const float* const planes[2][3] = {
+				{ node.boundsMin[0], node.boundsMin[1], node.boundsMin[2] },
+				{ node.boundsMax[0], node.boundsMax[1], node.boundsMax[2] }
+			};
+
+#if CPUREF_USE_SSE2
+			__m128 tNear = _mm_set1_ps(tMin);
+			__m128 tFar = _mm_set1_ps(tMax);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const __m128 origin = _mm_set1_ps(ray.origin[axis]);
+				const __m128 invDirection = _mm_set1_ps(ray.invDirection[axis]);
+				const __m128 nearT = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(planes[ray.nearPlane[axis]][axis]), origin), invDirection);
+				const __m128 farT = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(planes[1u - ray.nearPlane[axis]][axis]), origin), invDirection);
+				tNear = _mm_max_ps(tNear, nearT);
+				tFar = _mm_min_ps(tFar, farT);
+			}
+
+			_mm_storeu_ps(tNearOut, tNear);
+			return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+#else
+			uint32_t hitMask = 0u;
+			for (uint32_t child = 0; child < 4u; child++)
+			{
+				float tNear = tMin;
+				float tFar = tMax;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					tNear = (std::max)(tNear, (planes[ray.nearPlane[axis]][axis][child] - ray.origin[axis]) * ray.invDirection[axis]);
+					tFar = (std::min)(tFar, (planes[1u - ray.nearPlane[axis]][axis][child] - ray.origin[axis]) * ray.invDirection[axis]);
+				}
+
+				tNearOut[child] = tNear;
+				hitMask |= tNear <= tFar ? (1u << child) : 0u;
+			}
+
+			return hitMask;
+#endif
+		}
+
+		// Pushes the children in hitMask so that the nearest one is popped first.
+		void PushChildren(const BVH4Node& node, uint32_t hitMask, const uint32_t rayMasks[4], const float tNear[4], StackEntry* stack, uint32_t& stackSize)
+		{
+			StackEntry entries[4];
+			uint32_t entryCount = 0u;
+			for (; hitMask != 0u; hitMask &= hitMask - 1u)
+			{
+				const uint32_t child = (uint32_t)std::countr_zero(hitMask);
+				StackEntry entry = { node.children[child], rayMasks[child], tNear[child] };
+
+				// Insertion sort, far to near.
+				uint32_t i = entryCount++;
+				for (; i > 0u && entries[i - 1u].tNear < entry.tNear; i--)
+				{
+					entries[i] = entries[i - 1u];
+				}
+				entries[i] = entry;
+			}
+
+			assert(stackSize + entryCount <= TraversalStackSize);
+			for (uint32_t i = 0; i < entryCount; i++)
+			{
+				stack[stackSize++] = entries[i];
+			}
+		}
+
+		// Calls leafFunc(first, count) for every leaf the ray reaches before tClosest, which leafFunc lowers on hits.
+		template<typename LeafFunc>
+		void TraverseClosest(const BVH4& bvh, const float3& origin, const float3& direction, float tMin, const float& tClosest, LeafFunc&& leafFunc)
+		{
+			if (bvh.IsEmpty())
+			{
+				return;
+			}
+
+			const std::vector<BVH4Node>& nodes = bvh.GetNodes();
+			const NodeRay nodeRay = SetupNodeRay(origin, direction);
+			static const uint32_t RayMasks[4] = { 1u, 1u, 1u, 1u };
+
+			StackEntry stack[TraversalStackSize];
+			uint32_t stackSize = 0u;
+			stack[stackSize++] = { 0u, 1u, tMin };
+
+			while (stackSize > 0u)
+			{
+				const StackEntry entry = stack[--stackSize];
+				if (entry.tNear > tClosest)
+				{
+					continue;
+				}
+
+				if (BVH4::IsLeaf(entry.child))
+				{
+					leafFunc(BVH4::GetLeafFirst(entry.child), BVH4::GetLeafCount(entry.child));
+					continue;
+				}
+
+				const BVH4Node& node = nodes[entry.child];
+				float tNear[4];
+				const uint32_t hitMask = IntersectNode(node, nodeRay, tMin, tClosest, tNear);
+				PushChildren(node, hitMask, RayMasks, tNear, stack, stackSize);
+			}
+		}
+
+		// Packet version of TraverseClosest(), calls leafFunc(first, count, rayMask) with the rays that reach the leaf.
+		// Children are ordered by the nearest ray.
+		template<typename LeafFunc>
+		void TraversePacket(const BVH4& bvh, const NodeRay* nodeRays, const float* tMin, const float* tClosest, uint32_t activeMask, LeafFunc&& leafFunc)
+		{
+			if (bvh.IsEmpty() || activeMask == 0u)
+			{
+				return;
+			}
+
+			const std::vector<BVH4Node>& nodes = bvh.GetNodes();
+
+			StackEntry stack[TraversalStackSize];
+			uint32_t stackSize = 0u;
+			stack[stackSize++] = { 0u, activeMask, 0.0f };
+
+			while (stackSize > 0u)
+			{
+				const StackEntry entry = stack[--stackSize];
+
+				// Rays that hit something closer than the nearest ray reaches the child are done with it.
+				uint32_t rayMask = entry.rayMask;
+				for (uint32_t rays = rayMask; rays != 0u; rays &= rays - 1u)
+				{
+					const uint32_t rayIndex = (uint32_t)std::countr_zero(rays);
+					if (entry.tNear > tClosest[rayIndex])
+					{
+						rayMask &= ~(1u << rayIndex);
+					}
+				}
+
+				if (rayMask == 0u)
+				{
+					continue;
+				}
+
+				if (BVH4::IsLeaf(entry.child))
+				{
+					leafFunc(BVH4::GetLeafFirst(entry.child), BVH4::GetLeafCount(entry.child), rayMask);
+					continue;
+				}
+
+				const BVH4Node& node = nodes[entry.child];
+
+				uint32_t childRayMasks[4] = {};
+				float childNear[4] = { FloatMax, FloatMax, FloatMax, FloatMax };
+				uint32_t childMask = 0u;
+				for (; rayMask != 0u; rayMask &= rayMask - 1u)
+				{
+					const uint32_t rayIndex = (uint32_t)std::countr_zero(rayMask);
+
+					float tNear[4];
+					uint32_t hitMask = IntersectNode(node, nodeRays[rayIndex], tMin[rayIndex], tClosest[rayIndex], tNear);
+					childMask |= hitMask;
+					for (; hitMask != 0u; hitMask &= hitMask - 1u)
+					{
+						const uint32_t child = (uint32_t)std::countr_zero(hitMask);
+						childRayMasks[child] |= 1u << rayIndex;
+						childNear[child] = (std::min)(childNear[child], tNear[child]);
+					}
+				}
+
+				PushChildren(node, childMask, childRayMasks, childNear, stack, stackSize);
+			}
+		}
+
+		uint32_t GetBinIndex(float centroid, float centroidMin, float binScale, uint32_t binCount)
+		{
+			return (std::min)((uint32_t)((centroid - centroidMin) * binScale), binCount - 1u);
+		}
+
+		// Normals go to world space with the inverse transpose, and face the ray like ReferenceScene::TraceClosest().
+		float3 GetWorldNormal(const InstanceTransform& worldToObject, const float3& objectNormal, const float3& direction)
+		{
+			const float3 normal = normalize(float3(
+				worldToObject.rows[0][0] * objectNormal.x + worldToObject.rows[1][0] * objectNormal.y + worldToObject.rows[2][0] * objectNormal.z,
+				worldToObject.rows[0][1] * objectNormal.x + worldToObject.rows[1][1] * objectNormal.y + worldToObject.rows[2][1] * objectNormal.z,
+				worldToObject.rows[0][2] * objectNormal.x + worldToObject.rows[1][2] * objectNormal.y + worldToObject.rows[2][2] * objectNormal.z
+			));
+
+			return dot(normal, direction) > 0.0f ? -normal : normal;
+		}
+
+		float3 ReadPosition(const uint8_t* vertexData, uint32_t vertexStride, uint32_t vertexIndex)
+		{
+			float position[3];
+			std::memcpy(position, vertexData + size_t(vertexIndex) * vertexStride, sizeof(position));
+			return float3(position[0], position[1], position[2]);
+		}
+	}
+
+	float BVHBounds::GetHalfArea() const
+	{
+		if (IsEmpty())
+		{
+			return 0.0f;
+		}
+
+		const float3 extent = boundsMax - boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	std::vector<uint32_t> BVH4::Build(const std::vector<BVHBounds>& primitiveBounds, const BVHBuildDesc& desc)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		m_nodes.clear();
+		m_bounds = BVHBounds();
+		m_stats = BVHStats();
+
+		const uint32_t primitiveCount = (uint32_t)primitiveBounds.size();
+		std::vector<uint32_t> primitiveOrder(primitiveCount);
+		if (primitiveCount == 0u)
+		{
+			return primitiveOrder;
+		}
+
+		assert(primitiveCount < (1u << (31u - LeafCountBits)));
+
+		const uint32_t binCount = (std::max)(desc.binCount, 2u);
+		const uint32_t maxLeafSize = std::clamp(desc.maxLeafSize, 1u, 1u << LeafCountBits);
+
+		std::vector<float3> centroids(primitiveCount);
+		for (uint32_t i = 0; i < primitiveCount; i++)
+		{
+			primitiveOrder[i] = i;
+			centroids[i] = GetCentroid(primitiveBounds[i]);
+		}
+
+		// Binary binned SAH build, top down.
+		std::vector<BuildNode> buildNodes;
+		buildNodes.reserve(size_t(primitiveCount) * 2u / maxLeafSize + 1u);
+		buildNodes.push_back({});
+		buildNodes[0].count = primitiveCount;
+
+		std::vector<BuildBin> bins(binCount);
+		std::vector<BVHBounds> rightBounds(binCount);
+		std::vector<uint32_t> splitStack = { 0u };
+		while (!splitStack.empty())
+		{
+			const uint32_t nodeIndex = splitStack.back();
+			splitStack.pop_back();
+
+			const uint32_t first = buildNodes[nodeIndex].first;
+			const uint32_t count = buildNodes[nodeIndex].count;
+
+			BVHBounds bounds;
+			BVHBounds centroidBounds;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				bounds.Grow(primitiveBounds[primitiveOrder[i]]);
+				centroidBounds.Grow(centroids[primitiveOrder[i]]);
+			}
+			buildNodes[nodeIndex].bounds = bounds;
+
+			if (count == 1u)
+			{
+				continue;
+			}
+
+			const float nodeArea = bounds.GetHalfArea();
+			float bestCost = FloatMax;
+			int bestAxis = -1;
+			uint32_t bestSplit = 0u;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const float centroidMin = centroidBounds.boundsMin[axis];
+				const float extent = centroidBounds.boundsMax[axis] - centroidMin;
+				if (extent <= 0.0f)
+				{
+					continue;
+				}
+
+				std::fill(bins.begin(), bins.end(), BuildBin());
+				const float binScale = float(binCount) / extent;
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					BuildBin& bin = bins[GetBinIndex(centroids[primitiveOrder[i]][axis], centroidMin, binScale, binCount)];
+					bin.bounds.Grow(primitiveBounds[primitiveOrder[i]]);
+					bin.count++;
+				}
+
+				BVHBounds sweepBounds;
+				for (uint32_t i = binCount - 1u; i > 0u; i--)
+				{
+					sweepBounds.Grow(bins[i].bounds);
+					rightBounds[i] = sweepBounds;
+				}
+
+				// Split i puts bins [0, i) on the left.
+				sweepBounds = BVHBounds();
+				uint32_t leftCount = 0u;
+				for (uint32_t i = 1u; i < binCount; i++)
+				{
+					sweepBounds.Grow(bins[i - 1u].bounds);
+					leftCount += bins[i - 1u].count;
+
+					const uint32_t rightCount = count - leftCount;
+					if (leftCount == 0u || rightCount == 0u)
+					{
+						continue;
+					}
+
+					const float cost = desc.traversalCost + (sweepBounds.GetHalfArea() * leftCount + rightBounds[i].GetHalfArea() * rightCount) / (std::max)(nodeArea, 1.0e-20f);
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = i;
+					}
+				}
+			}
+
+			if (count <= maxLeafSize && float(count) <= bestCost)
+			{
+				continue;
+			}
+
+			uint32_t leftCount = count / 2u;
+			if (bestAxis >= 0)
+			{
+				const float centroidMin = centroidBounds.boundsMin[bestAxis];
+				const float binScale = float(binCount) / (centroidBounds.boundsMax[bestAxis] - centroidMin);
+				auto middle = std::partition(primitiveOrder.begin() + first, primitiveOrder.begin() + first + count, [&](uint32_t primitiveIndex)
+					{
+						return GetBinIndex(centroids[primitiveIndex][bestAxis], centroidMin, binScale, binCount) < bestSplit;
+					});
+
+				leftCount = (uint32_t)(middle - (primitiveOrder.begin() + first));
+			}
+			// Every centroid is in the same spot, there is nothing better than splitting in the middle.
+			else if (count <= maxLeafSize)
+			{
+				continue;
+			}
+
+			assert(leftCount > 0u && leftCount < count);
+
+			const uint32_t leftIndex = (uint32_t)buildNodes.size();
+			buildNodes.push_back({});
+			buildNodes.push_back({});
+			buildNodes[leftIndex].first = first;
+			buildNodes[leftIndex].count = leftCount;
+			buildNodes[leftIndex + 1u].first = first + leftCount;
+			buildNodes[leftIndex + 1u].count = count - leftCount;
+
+			buildNodes[nodeIndex].left = leftIndex;
+			buildNodes[nodeIndex].right = leftIndex + 1u;
+			buildNodes[nodeIndex].count = 0u;
+
+			splitStack.push_back(leftIndex + 1u);
+			splitStack.push_back(leftIndex);
+		}
+
+		m_bounds = buildNodes[0].bounds;
+		const float rootArea = (std::max)(m_bounds.GetHalfArea(), 1.0e-20f);
+
+		// Collapse into 4 wide nodes, a node takes the children of its largest inner children until it has 4.
+		struct CollapseTask
+		{
+			uint32_t buildNodeIndex;
+			uint32_t nodeIndex;
+			uint32_t depth;
+		};
+
+		std::vector<CollapseTask> collapseStack = { { 0u, 0u, 1u } };
+		m_nodes.emplace_back();
+		while (!collapseStack.empty())
+		{
+			const CollapseTask task = collapseStack.back();
+			collapseStack.pop_back();
+
+			m_stats.innerNodeCount++;
+			m_stats.maxDepth = (std::max)(m_stats.maxDepth, task.depth);
+			m_stats.sahCost += desc.traversalCost * buildNodes[task.buildNodeIndex].bounds.GetHalfArea() / rootArea;
+
+			uint32_t children[4] = { task.buildNodeIndex };
+			uint32_t childCount = 1u;
+			// A leaf at the root still gets a node.
+			if (buildNodes[task.buildNodeIndex].count == 0u)
+			{
+				children[0] = buildNodes[task.buildNodeIndex].left;
+				children[1] = buildNodes[task.buildNodeIndex].right;
+				childCount = 2u;
+			}
+
+			while (childCount < 4u)
+			{
+				int largestChild = -1;
+				float largestArea = -1.0f;
+				for (uint32_t i = 0; i < childCount; i++)
+				{
+					const BuildNode& child = buildNodes[children[i]];
+					if (child.count == 0u && child.bounds.GetHalfArea() > largestArea)
+					{
+						largestChild = (int)i;
+						largestArea = child.bounds.GetHalfArea();
+					}
+				}
+
+				if (largestChild < 0)
+				{
+					break;
+				}
+
+				const BuildNode& child = buildNodes[children[largestChild]];
+				children[largestChild] = child.left;
+				children[childCount++] = child.right;
+			}
+
+			BVH4Node node = {};
+			for (uint32_t i = 0; i < 4u; i++)
+			{
+				if (i >= childCount)
+				{
+					for (int axis = 0; axis < 3; axis++)
+					{
+						node.boundsMin[axis][i] = FloatMax;
+						node.boundsMax[axis][i] = -FloatMax;
+					}
+
+					continue;
+				}
+
+				const BuildNode& child = buildNodes[children[i]];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					node.boundsMin[axis][i] = child.bounds.boundsMin[axis];
+					node.boundsMax[axis][i] = child.bounds.boundsMax[axis];
+				}
+
+				if (child.count > 0u)
+				{
+					node.children[i] = LeafFlag | (child.first << LeafCountBits) | (child.count - 1u);
+					m_stats.leafCount++;
+					m_stats.sahCost += float(child.count) * child.bounds.GetHalfArea() / rootArea;
+				}
+				else
+				{
+					node.children[i] = (uint32_t)m_nodes.size();
+					m_nodes.emplace_back();
+					collapseStack.push_back({ children[i], node.children[i], task.depth + 1u });
+				}
+			}
+
+			m_nodes[task.nodeIndex] = node;
+		}
+
+		assert(m_stats.maxDepth <= MaxTraversalDepth);
+
+		m_stats.buildMs = GetElapsedMs(start);
+		return primitiveOrder;
+	}
+
+	void SoftwareBLAS::Build(const std::vector<BVHMeshDesc>& meshes, const BVHBuildDesc& desc /*= BVHBuildDesc()*/)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		std::vector<Triangle> triangles;
+		std::vector<BVHBounds> triangleBounds;
+		m_meshEmissives.clear();
+
+		for (uint32_t meshIndex = 0; meshIndex < (uint32_t)meshes.size(); meshIndex++)
+		{
+			const BVHMeshDesc& mesh = meshes[meshIndex];
+			m_meshEmissives.push_back(mesh.emissive);
+
+			const uint8_t* vertexData = mesh.geometryData + mesh.vbOffset;
+			const uint8_t* indexData = mesh.geometryData + mesh.ibOffset;
+			auto readIndex = [&](uint32_t i)
+				{
+					if (mesh.uses32BitIndices)
+					{
+						uint32_t index;
+						std::memcpy(&index, indexData + size_t(i) * sizeof(uint32_t), sizeof(index));
+						return index;
+					}
+
+					uint16_t index;
+					std::memcpy(&index, indexData + size_t(i) * sizeof(uint16_t), sizeof(index));
+					return (uint32_t)index;
+				};
+
+			for (uint32_t i = 0; i + 2u < mesh.indexCount; i += 3u)
+			{
+				float3 vertices[3];
+				BVHBounds bounds;
+				for (uint32_t corner = 0; corner < 3u; corner++)
+				{
+					const uint32_t vertexIndex = readIndex(i + corner);
+					assert(vertexIndex < mesh.vertexCount);
+
+					vertices[corner] = TransformPoint(mesh.transform, ReadPosition(vertexData, mesh.vbStride, vertexIndex));
+					bounds.Grow(vertices[corner]);
+				}
+
+				triangles.push_back({ vertices[0], vertices[1] - vertices[0], vertices[2] - vertices[0], meshIndex });
+				triangleBounds.push_back(bounds);
+			}
+		}
+
+		const std::vector<uint32_t> triangleOrder = m_bvh.Build(triangleBounds, desc);
+
+		m_triangles.resize(triangles.size());
+		for (size_t i = 0; i < triangleOrder.size(); i++)
+		{
+			m_triangles[i] = triangles[triangleOrder[i]];
+		}
+
+		// Includes reading the geometry.
+		m_stats = m_bvh.GetStats();
+		m_stats.buildMs = GetElapsedMs(start);
+	}
+
+	bool SoftwareBLAS::IntersectTriangle(const Triangle& triangle, const float3& origin, const float3& direction, float tMin, float& tClosest) const
+	{
+		// Moller-Trumbore, double sided like ReferenceScene::TraceClosest().
+		float3 p = cross(direction, triangle.edge2);
+		float det = dot(triangle.edge1, p);
+		if (std::fabs(det) < 1.0e-8f)
+		{
+			return false;
+		}
+
+		float invDet = 1.0f / det;
+		float3 s = origin - triangle.v0;
+		float u = dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+
+		float3 q = cross(s, triangle.edge1);
+		float v = dot(direction, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+
+		float t = dot(triangle.edge2, q) * invDet;
+		if (t >= tMin && t <= tClosest)
+		{
+			tClosest = t;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool SoftwareBLAS::TraceClosest(const float3& origin, const float3& direction, float tMin, float& tClosest, float3& normalOut, float3& emissiveOut) const
+	{
+		const Triangle* closestTriangle = nullptr;
+		TraverseClosest(m_bvh, origin, direction, tMin, tClosest, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					if (IntersectTriangle(m_triangles[i], origin, direction, tMin, tClosest))
+					{
+						closestTriangle = &m_triangles[i];
+					}
+				}
+			});
+
+		if (closestTriangle == nullptr)
+		{
+			return false;
+		}
+
+		normalOut = cross(closestTriangle->edge1, closestTriangle->edge2);
+		emissiveOut = m_meshEmissives[closestTriangle->meshIndex];
+		return true;
+	}
+
+	uint32_t SoftwareBLAS::TraceClosestPacket(const RayPacket& packet, uint32_t activeMask, float* tClosest, float3* normalsOut, float3* emissivesOut) const
+	{
+		NodeRay nodeRays[RayPacketSize];
+		const Triangle* closestTriangles[RayPacketSize] = {};
+		for (uint32_t rays = activeMask; rays != 0u; rays &= rays - 1u)
+		{
+			const uint32_t rayIndex = (uint32_t)std::countr_zero(rays);
+			nodeRays[rayIndex] = SetupNodeRay(packet.origins[rayIndex], packet.directions[rayIndex]);
+		}
+
+		TraversePacket(m_bvh, nodeRays, packet.tMin, tClosest, activeMask, [&](uint32_t first, uint32_t count, uint32_t rayMask)
+			{
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					for (uint32_t rays = rayMask; rays != 0u; rays &= rays - 1u)
+					{
+						const uint32_t rayIndex = (uint32_t)std::countr_zero(rays);
+						if (IntersectTriangle(m_triangles[i], packet.origins[rayIndex], packet.directions[rayIndex], packet.tMin[rayIndex], tClosest[rayIndex]))
+						{
+							closestTriangles[rayIndex] = &m_triangles[i];
+						}
+					}
+				}
+			});
+
+		uint32_t hitMask = 0u;
+		for (uint32_t rays = activeMask; rays != 0u; rays &= rays - 1u)
+		{
+			const uint32_t rayIndex = (uint32_t)std::countr_zero(rays);
+			if (const Triangle* triangle = closestTriangles[rayIndex])
+			{
+				normalsOut[rayIndex] = cross(triangle->edge1, triangle->edge2);
+				emissivesOut[rayIndex] = m_meshEmissives[triangle->meshIndex];
+				hitMask |= 1u << rayIndex;
+			}
+		}
+
+		return hitMask;
+	}
+
+	void SoftwareTLAS::Build(const std::vector<SoftwareInstanceDesc>& instances, const BVHBuildDesc& desc /*= BVHBuildDesc()*/)
+	{
+		std::vector<Instance> validInstances;
+		std::vector<BVHBounds> instanceBounds;
+		for (const SoftwareInstanceDesc& instanceDesc : instances)
+		{
+			if (instanceDesc.blas == nullptr || instanceDesc.blas->GetBounds().IsEmpty())
+			{
+				continue;
+			}
+
+			const BVHBounds& blasBounds = instanceDesc.blas->GetBounds();
+			BVHBounds bounds;
+			for (uint32_t corner = 0; corner < 8u; corner++)
+			{
+				const float3 cornerPos = float3(
+					(corner & 1u) ? blasBounds.boundsMax.x : blasBounds.boundsMin.x,
+					(corner & 2u) ? blasBounds.boundsMax.y : blasBounds.boundsMin.y,
+					(corner & 4u) ? blasBounds.boundsMax.z : blasBounds.boundsMin.z
+				);
+				bounds.Grow(TransformPoint(instanceDesc.transform, cornerPos));
+			}
+
+			validInstances.push_back({ instanceDesc.blas, instanceDesc.transform, InverseTransform(instanceDesc.transform) });
+			instanceBounds.push_back(bounds);
+		}
+
+		const std::vector<uint32_t> instanceOrder = m_bvh.Build(instanceBounds, desc);
+
+		m_instances.resize(validInstances.size());
+		for (size_t i = 0; i < instanceOrder.size(); i++)
+		{
+			m_instances[i] = validInstances[instanceOrder[i]];
+		}
+	}
+
+	bool SoftwareTLAS::TraceClosest(const float3& origin, const float3& direction, float tMin, float tMax, RayHit& hitOut) const
+	{
+		float tClosest = tMax;
+		const Instance* closestInstance = nullptr;
+		float3 closestNormal;
+		float3 closestEmissive;
+
+		TraverseClosest(m_bvh, origin, direction, tMin, tClosest, [&](uint32_t first, uint32_t count)
+			{
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					// The direction is not normalized in model space, so t is the same in both spaces.
+					const Instance& instance = m_instances[i];
+					const float3 objectOrigin = TransformPoint(instance.worldToObject, origin);
+					const float3 objectDirection = TransformDirection(instance.worldToObject, direction);
+					if (instance.blas->TraceClosest(objectOrigin, objectDirection, tMin, tClosest, closestNormal, closestEmissive))
+					{
+						closestInstance = &instance;
+					}
+				}
+			});
+
+		if (closestInstance == nullptr)
+		{
+			return false;
+		}
+
+		hitOut.t = tClosest;
+		hitOut.emissive = closestEmissive;
+		hitOut.normal = GetWorldNormal(closestInstance->worldToObject, closestNormal, direction);
+		return true;
+	}
+
+	float3 SoftwareTLAS::GetSkyRadiance(const float3& direction) const
+	{
+		return SimpleSunsetSky(direction, m_sunDir);
+	}
+
+	uint32_t SoftwareTLAS::TraceClosestPacket(const RayPacket& packet, RayHit* hitsOut) const
+	{
+		assert(packet.rayCount <= RayPacketSize);
+		const uint32_t activeMask = packet.rayCount < 32u ? (1u << packet.rayCount) - 1u : UINT32_MAX;
+
+		NodeRay nodeRays[RayPacketSize];
+		float tClosest[RayPacketSize];
+		const Instance* closestInstances[RayPacketSize] = {};
+		float3 closestNormals[RayPacketSize];
+		float3 closestEmissives[RayPacketSize];
+		for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+		{
+			nodeRays[rayIndex] = SetupNodeRay(packet.origins[rayIndex], packet.directions[rayIndex]);
+			tClosest[rayIndex] = packet.tMax[rayIndex];
+		}
+
+		RayPacket objectPacket;
+		TraversePacket(m_bvh, nodeRays, packet.tMin, tClosest, activeMask, [&](uint32_t first, uint32_t count, uint32_t rayMask)
+			{
+				for (uint32_t i = first; i < first + count; i++)
+				{
+					const Instance& instance = m_instances[i];
+					for (uint32_t rays = rayMask; rays != 0u; rays &= rays - 1u)
+					{
+						const uint32_t rayIndex = (uint32_t)std::countr_zero(rays);
+						objectPacket.origins[rayIndex] = TransformPoint(instance.worldToObject, packet.origins[rayIndex]);
+						objectPacket.directions[rayIndex] = TransformDirection(instance.worldToObject, packet.directions[rayIndex]);
+						objectPacket.tMin[rayIndex] = packet.tMin[rayIndex];
+					}
+
+					uint32_t hitMask = instance.blas->TraceClosestPacket(objectPacket, rayMask, tClosest, closestNormals, closestEmissives);
+					for (; hitMask != 0u; hitMask &= hitMask - 1u)
+					{
+						closestInstances[std::countr_zero(hitMask)] = &instance;
+					}
+				}
+			});
+
+		uint32_t hitMask = 0u;
+		for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+		{
+			const Instance* instance = closestInstances[rayIndex];
+			if (instance == nullptr)
+			{
+				continue;
+			}
+
+			RayHit& hit = hitsOut[rayIndex];
+			hit.t = tClosest[rayIndex];
+			hit.emissive = closestEmissives[rayIndex];
+			hit.normal = GetWorldNormal(instance->worldToObject, closestNormals[rayIndex], packet.directions[rayIndex]);
+			hitMask |= 1u << rayIndex;
+		}
+
+		return hitMask;
+	}
+
+	float3 TransformPoint(const InstanceTransform& transform, const float3& point)
+	{
+		return TransformDirection(transform, point) + float3(transform.rows[0][3], transform.rows[1][3], transform.rows[2][3]);
+	}
+
+	float3 TransformDirection(const InstanceTransform& transform, const float3& direction)
+	{
+		return float3(
+			transform.rows[0][0] * direction.x + transform.rows[0][1] * direction.y + transform.rows[0][2] * direction.z,
+			transform.rows[1][0] * direction.x + transform.rows[1][1] * direction.y + transform.rows[1][2] * direction.z,
+			transform.rows[2][0] * direction.x + transform.rows[2][1] * direction.y + transform.rows[2][2] * direction.z
+		);
+	}
+
+	InstanceTransform InverseTransform(const InstanceTransform& transform)
+	{
+		const float (&m)[3][4] = transform.rows;
+
+		// Adjugate over the determinant.
+		float inverse[3][3] = {
+			{ m[1][1] * m[2][2] - m[1][2] * m[2][1], m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][1] * m[1][2] - m[0][2] * m[1][1] },
+			{ m[1][2] * m[2][0] - m[1][0] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][2] * m[1][0] - m[0][0] * m[1][2] },
+			{ m[1][0] * m[2][1] - m[1][1] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1], m[0][0] * m[1][1] - m[0][1] * m[1][0] }
+		};
+
+		const float det = m[0][0] * inverse[0][0] + m[0][1] * inverse[1][0] + m[0][2] * inverse[2][0];
+		assert(det != 0.0f);
+		const float invDet = 1.0f / det;
+
+		InstanceTransform result;
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				result.rows[row][column] = inverse[row][column] * invDet;
+			}
+
+			result.rows[row][3] = -(result.rows[row][0] * m[0][3] + result.rows[row][1] * m[1][3] + result.rows[row][2] * m[2][3]);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+// Two level software BVH, the CPU fallback of BLASBuffer and TLASBuffers for running RC without a raytracing GPU.
+// Both levels are built with binned SAH into a binary tree that is then collapsed into a 4 wide tree, so that one node holds the
+// bounds of 4 children and a ray tests all of them at once with SSE2. Single rays take the nearest child first. Packets of rays share
+// one traversal stack, every node is fetched once for the whole packet and only the rays that hit it go further down, which pays off
+// for coherent rays like the rays of one probe. SoftwareTLAS is a RayTracer, so the reference pipeline gathers against it as is.
+
+#include "InstanceRegistry.h"
+#include "ReferenceScene.h"
+
+#include <vector>
+
+namespace CPUReference
+{
+	inline constexpr InstanceTransform GetIdentityInstanceTransform()
+	{
+		return { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } } };
+	}
+
+	struct BVHBuildDesc
+	{
+		uint32_t binCount = 16u;
+		// At most 16.
+		uint32_t maxLeafSize = 4u;
+		// SAH cost of a node relative to the cost of intersecting one primitive.
+		float traversalCost = 1.0f;
+	};
+
+	// One mesh of a model, with the same layout as the geometry of a BLAS geometry desc: positions are the first 3 floats of every vertex.
+	struct BVHMeshDesc
+	{
+		// Contents of Model::m_DataBuffer, the offsets and sizes are the ones of Mesh.
+		const uint8_t* geometryData = nullptr;
+		uint32_t vbOffset = 0u;
+		uint32_t vbStride = 0u;
+		uint32_t vertexCount = 0u;
+		uint32_t ibOffset = 0u;
+		uint32_t indexCount = 0u;
+		bool uses32BitIndices = false;
+		// Mesh to model, like the Transform3x4 of the geometry desc.
+		InstanceTransform transform = GetIdentityInstanceTransform();
+		float3 emissive;
+	};
+
+	struct BVHBounds
+	{
+		float3 boundsMin = float3(FloatMax);
+		float3 boundsMax = float3(-FloatMax);
+
+		void Grow(const float3& point) { boundsMin = (min)(boundsMin, point); boundsMax = (max)(boundsMax, point); }
+		void Grow(const BVHBounds& bounds) { boundsMin = (min)(boundsMin, bounds.boundsMin); boundsMax = (max)(boundsMax, bounds.boundsMax); }
+		bool IsEmpty() const { return boundsMin.x > boundsMax.x; }
+		float GetHalfArea() const;
+	};
+
+	// Bounds of 4 children, one array per plane so that a ray tests all of them in one go. Empty children have inverted bounds, which no ray hits.
+	struct alignas(16) BVH4Node
+	{
+		float boundsMin[3][4];
+		float boundsMax[3][4];
+		// Index of an inner node, or a leaf if LeafFlag is set.
+		uint32_t children[4];
+	};
+
+	struct BVHStats
+	{
+		uint32_t innerNodeCount = 0u;
+		uint32_t leafCount = 0u;
+		uint32_t maxDepth = 0u;
+		// SAH cost of the tree, root area normalized.
+		float sahCost = 0.0f;
+		double buildMs = 0.0;
+	};
+
+	// Rays traced together by one packet traversal, they do not have to be coherent but benefit most when they are.
+	constexpr uint32_t RayPacketSize = 8u;
+
+	struct RayPacket
+	{
+		float3 origins[RayPacketSize];
+		float3 directions[RayPacketSize];
+		float tMin[RayPacketSize] = {};
+		float tMax[RayPacketSize] = {};
+		uint32_t rayCount = 0u;
+	};
+
+	// 4 wide BVH over the bounds of any kind of primitive, both levels use it.
+	class BVH4
+	{
+	public:
+		static constexpr uint32_t LeafFlag = 0x80000000u;
+		static constexpr uint32_t LeafCountBits = 4u;
+
+		// Primitive i is bounded by primitiveBounds[i]. Returns the order the leaves reference the primitives in.
+		std::vector<uint32_t> Build(const std::vector<BVHBounds>& primitiveBounds, const BVHBuildDesc& desc);
+
+		const std::vector<BVH4Node>& GetNodes() const { return m_nodes; }
+		const BVHBounds& GetBounds() const { return m_bounds; }
+		const BVHStats& GetStats() const { return m_stats; }
+		bool IsEmpty() const { return m_nodes.empty(); }
+
+		static bool IsLeaf(uint32_t child) { return (child & LeafFlag) != 0u; }
+		static uint32_t GetLeafFirst(uint32_t child) { return (child & ~LeafFlag) >> LeafCountBits; }
+		static uint32_t GetLeafCount(uint32_t child) { return (child & ((1u << LeafCountBits) - 1u)) + 1u; }
+
+	private:
+		std::vector<BVH4Node> m_nodes;
+		BVHBounds m_bounds;
+		BVHStats m_stats;
+	};
+
+	// Software BLAS over the triangles of every mesh of a model.
+	class SoftwareBLAS
+	{
+	public:
+		SoftwareBLAS() = default;
+
+		void Build(const std::vector<BVHMeshDesc>& meshes, const BVHBuildDesc& desc = BVHBuildDesc());
+
+		// Ray in model space, the direction does not have to be normalized. tClosest is both the max t and the t of the hit.
+		// The normal is in model space, not normalized and not facing the ray.
+		bool TraceClosest(const float3& origin, const float3& direction, float tMin, float& tClosest, float3& normalOut, float3& emissiveOut) const;
+		// Rays in activeMask of the packet. Rays that hit something get their tClosest, normal and emissive written.
+		// Returns the rays that hit.
+		uint32_t TraceClosestPacket(const RayPacket& packet, uint32_t activeMask, float* tClosest, float3* normalsOut, float3* emissivesOut) const;
+
+		const BVHBounds& GetBounds() const { return m_bvh.GetBounds(); }
+		const BVHStats& GetStats() const { return m_stats; }
+		uint32_t GetTriangleCount() const { return (uint32_t)m_triangles.size(); }
+
+	private:
+		struct Triangle
+		{
+			float3 v0;
+			float3 edge1;
+			float3 edge2;
+			uint32_t meshIndex;
+		};
+
+		bool IntersectTriangle(const Triangle& triangle, const float3& origin, const float3& direction, float tMin, float& tClosest) const;
+
+	private:
+		BVH4 m_bvh;
+		BVHStats m_stats;
+		// In leaf order.
+		std::vector<Triangle> m_triangles;
+		std::vector<float3> m_meshEmissives;
+	};
+
+	struct SoftwareInstanceDesc
+	{
+		const SoftwareBLAS* blas = nullptr;
+		// Model to world, like the transform of the instance desc.
+		InstanceTransform transform = GetIdentityInstanceTransform();
+	};
+
+	// Software TLAS over instances of software BLASes. The BLASes have to outlive it.
+	class SoftwareTLAS : public RayTracer
+	{
+	public:
+		SoftwareTLAS() = default;
+
+		void Build(const std::vector<SoftwareInstanceDesc>& instances, const BVHBuildDesc& desc = BVHBuildDesc());
+
+		void SetSunDirection(const float3& sunDir) { m_sunDir = normalize(sunDir); }
+
+		bool TraceClosest(const float3& origin, const float3& direction, float tMin, float tMax, RayHit& hitOut) const override;
+		float3 GetSkyRadiance(const float3& direction) const override;
+
+		// Same results as TraceClosest() for every ray of the packet, returns the rays that hit.
+		uint32_t TraceClosestPacket(const RayPacket& packet, RayHit* hitsOut) const;
+
+		const BVHStats& GetStats() const { return m_bvh.GetStats(); }
+		uint32_t GetInstanceCount() const { return (uint32_t)m_instances.size(); }
+
+	private:
+		struct Instance
+		{
+			const SoftwareBLAS* blas;
+			InstanceTransform objectToWorld;
+			InstanceTransform worldToObject;
+		};
+
+	private:
+		BVH4 m_bvh;
+		// In leaf order.
+		std::vector<Instance> m_instances;
+		float3 m_sunDir = normalize(float3(1.0f, 1.0f, 0.0f));
+	};
+
+	// Transforms a point, or a direction which ignores the translation.
+	float3 TransformPoint(const InstanceTransform& transform, const float3& point);
+	float3 TransformDirection(const InstanceTransform& transform, const float3& direction);
+	// Inverse of an affine transform, the upper 3x3 has to be invertible.
+	InstanceTransform InverseTransform(const InstanceTransform& transform);
+}
@@ -0,0 +1,83 @@
+#include "StreamCompaction.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace CPUReference
+{
+	namespace
+	{
+		// Words per task, large enough for the scatter to outweigh the cost of handing out a task.
+		constexpr uint32_t CompactionWordsPerTask = 4096u;
+
+		uint32_t* ScatterSetBits(const uint32_t* words, uint32_t firstWordIndex, uint32_t wordCount, uint32_t* activeTexelsOut)
+		{
+			for (uint32_t i = 0; i < wordCount; i++)
+			{
+				const uint32_t baseTexelIndex = (firstWordIndex + i) * GatherFilterBitsPerWord;
+
+				uint32_t word = words[firstWordIndex + i];
+				while (word != 0u)
+				{
+					*activeTexelsOut++ = baseTexelIndex + (uint32_t)std::countr_zero(word);
+					word &= word - 1u; // Clear lowest set bit.
+				}
+			}
+
+			return activeTexelsOut;
+		}
+	}
+
+	uint32_t ExclusivePrefixSum(const uint32_t* values, uint32_t* sumsOut, size_t count)
+	{
+		uint32_t sum = 0u;
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t value = values[i];
+			sumsOut[i] = sum;
+			sum += value;
+		}
+
+		return sum;
+	}
+
+	void CompactGatherFilter(const PackedGatherFilter& filter, std::vector<uint32_t>& activeTexelsOut)
+	{
+		const std::vector<uint32_t>& words = filter.GetWords();
+
+		activeTexelsOut.resize((size_t)filter.PopCount());
+		ScatterSetBits(words.data(), 0u, (uint32_t)words.size(), activeTexelsOut.data());
+	}
+
+	void CompactGatherFilter(const PackedGatherFilter& filter, TaskPool& taskPool, std::vector<uint32_t>& activeTexelsOut)
+	{
+		const std::vector<uint32_t>& words = filter.GetWords();
+		const uint32_t wordCount = (uint32_t)words.size();
+		const uint32_t taskCount = (wordCount + CompactionWordsPerTask - 1u) / CompactionWordsPerTask;
+
+		auto getWordRange = [&](uint32_t taskIndex, uint32_t& firstWordOut, uint32_t& wordCountOut)
+			{
+				firstWordOut = taskIndex * CompactionWordsPerTask;
+				wordCountOut = (std::min)(CompactionWordsPerTask, wordCount - firstWordOut);
+			};
+
+		std::vector<uint32_t> taskOffsets(taskCount);
+		taskPool.ParallelFor(taskCount, [&](uint32_t taskIndex)
+			{
+				uint32_t firstWord, taskWordCount;
+				getWordRange(taskIndex, firstWord, taskWordCount);
+				taskOffsets[taskIndex] = (uint32_t)PopCount(words.data() + firstWord, taskWordCount);
+			});
+
+		const uint32_t activeTexelCount = ExclusivePrefixSum(taskOffsets.data(), taskOffsets.data(), taskCount);
+		activeTexelsOut.resize(activeTexelCount);
+
+		taskPool.ParallelFor(taskCount, [&](uint32_t taskIndex)
+			{
+				uint32_t firstWord, taskWordCount;
+				getWordRange(taskIndex, firstWord, taskWordCount);
+				ScatterSetBits(words.data(), firstWord, taskWordCount, activeTexelsOut.data() + taskOffsets[taskIndex]);
+			});
+	}
+}
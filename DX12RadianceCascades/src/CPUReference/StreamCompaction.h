@@ -0,0 +1,22 @@
+#pragma once
+
+// CPU equivalent of the active probe-direction lists that RCRaytraceRT.hlsl builds with AppendActiveProbeDirection().
+// The GPU appends in whatever order its waves finish, these functions produce the same set of texels in ascending order.
+
+#include "GatherFilterBits.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	// Writes the exclusive prefix sum of values into sumsOut and returns the sum of all values. sumsOut may be the same array as values.
+	uint32_t ExclusivePrefixSum(const uint32_t* values, uint32_t* sumsOut, size_t count);
+
+	// Texel indices (y * width + x) of every set bit of the filter.
+	void CompactGatherFilter(const PackedGatherFilter& filter, std::vector<uint32_t>& activeTexelsOut);
+	// Same result as above. Ranges of words are counted, offset with a prefix sum over the range counts and then scattered, each step split over the task pool.
+	void CompactGatherFilter(const PackedGatherFilter& filter, TaskPool& taskPool, std::vector<uint32_t>& activeTexelsOut);
+}
@@ -0,0 +1,151 @@
+#include "TaskPool.h"
+
+#include <cassert>
+
+namespace CPUReference
+{
+	TaskPool::TaskPool(uint32_t threadCount /*= 0u*/)
+	{
+		if (threadCount == 0u)
+		{
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		// Last queue belongs to the thread calling ParallelFor().
+		m_queues.resize(threadCount);
+		for (std::unique_ptr<TaskQueue>& queue : m_queues)
+		{
+			queue = std::make_unique<TaskQueue>();
+		}
+
+		m_workers.reserve(threadCount - 1u);
+		for (uint32_t i = 0; i < threadCount - 1u; i++)
+		{
+			m_workers.emplace_back(&TaskPool::WorkerLoop, this, i);
+		}
+	}
+
+	TaskPool::~TaskPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_signalMutex);
+			m_isShuttingDown = true;
+		}
+		m_workAvailableCondition.notify_all();
+
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void TaskPool::ParallelFor(uint32_t taskCount, const TaskFunc& func)
+	{
+		if (taskCount == 0u)
+		{
+			return;
+		}
+
+		Job job;
+		job.func = &func;
+		job.remainingTasks.store(taskCount);
+
+		// Contiguous ranges per queue so that neighbouring tasks (usually neighbouring tiles) share a core.
+		const uint32_t queueCount = GetThreadCount();
+		for (uint32_t q = 0; q < queueCount; q++)
+		{
+			const uint32_t begin = uint32_t(uint64_t(taskCount) * q / queueCount);
+			const uint32_t end = uint32_t(uint64_t(taskCount) * (q + 1u) / queueCount);
+
+			std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+			// Pushed in reverse as owners pop from the back.
+			for (uint32_t i = end; i > begin; i--)
+			{
+				m_queues[q]->tasks.push_back({ &job, i - 1u });
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_signalMutex);
+			m_workGeneration++;
+		}
+		m_workAvailableCondition.notify_all();
+
+		const uint32_t ownQueueIndex = queueCount - 1u;
+		Task task;
+		while (TryPopTask(ownQueueIndex, task))
+		{
+			RunTask(task);
+		}
+
+		std::unique_lock<std::mutex> lock(m_signalMutex);
+		m_jobDoneCondition.wait(lock, [&job]() { return job.remainingTasks.load() == 0u; });
+	}
+
+	void TaskPool::WorkerLoop(uint32_t queueIndex)
+	{
+		uint64_t seenGeneration = 0u;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_signalMutex);
+				m_workAvailableCondition.wait(lock, [&]() { return m_isShuttingDown || m_workGeneration != seenGeneration; });
+
+				if (m_isShuttingDown)
+				{
+					return;
+				}
+
+				seenGeneration = m_workGeneration;
+			}
+
+			Task task;
+			while (TryPopTask(queueIndex, task))
+			{
+				RunTask(task);
+			}
+		}
+	}
+
+	bool TaskPool::TryPopTask(uint32_t queueIndex, Task& taskOut)
+	{
+		{
+			TaskQueue& ownQueue = *m_queues[queueIndex];
+			std::lock_guard<std::mutex> lock(ownQueue.mutex);
+			if (!ownQueue.tasks.empty())
+			{
+				taskOut = ownQueue.tasks.back();
+				ownQueue.tasks.pop_back();
+				return true;
+			}
+		}
+
+		// Own queue is empty, steal from the others starting with the closest neighbour.
+		const uint32_t queueCount = GetThreadCount();
+		for (uint32_t offset = 1u; offset < queueCount; offset++)
+		{
+			TaskQueue& victimQueue = *m_queues[(queueIndex + offset) % queueCount];
+			std::lock_guard<std::mutex> lock(victimQueue.mutex);
+			if (!victimQueue.tasks.empty())
+			{
+				taskOut = victimQueue.tasks.front();
+				victimQueue.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void TaskPool::RunTask(const Task& task)
+	{
+		(*task.job->func)(task.taskIndex);
+
+		// The job lives on the stack of ParallelFor() and can go out of scope as soon as the last task is counted, so it is not touched after this.
+		if (task.job->remainingTasks.fetch_sub(1u) == 1u)
+		{
+			std::lock_guard<std::mutex> lock(m_signalMutex);
+			m_jobDoneCondition.notify_all();
+		}
+	}
+}
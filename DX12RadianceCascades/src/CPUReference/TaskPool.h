@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CPUReference
+{
+	// Work stealing thread pool used to split probe-direction tiles across cores.
+	// Every worker (and the calling thread) owns a queue. Tasks are popped from the back of the own queue
+	// and stolen from the front of other queues, which keeps neighbouring tiles on the same core as long as possible.
+	class TaskPool
+	{
+	public:
+		typedef std::function<void(uint32_t taskIndex)> TaskFunc;
+
+		// A thread count of 0 uses all hardware threads. The calling thread always participates in the work.
+		explicit TaskPool(uint32_t threadCount = 0u);
+		~TaskPool();
+
+		TaskPool(const TaskPool&) = delete;
+		TaskPool& operator=(const TaskPool&) = delete;
+
+		// Runs func for every index in [0, taskCount) and blocks until all of them are done.
+		void ParallelFor(uint32_t taskCount, const TaskFunc& func);
+
+		// Includes the calling thread.
+		uint32_t GetThreadCount() const { return (uint32_t)m_queues.size(); }
+
+	private:
+		struct Job
+		{
+			const TaskFunc* func = nullptr;
+			std::atomic<uint32_t> remainingTasks = 0u;
+		};
+
+		struct Task
+		{
+			Job* job;
+			uint32_t taskIndex;
+		};
+
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void WorkerLoop(uint32_t queueIndex);
+		bool TryPopTask(uint32_t queueIndex, Task& taskOut);
+		void RunTask(const Task& task);
+
+	private:
+		std::vector<std::unique_ptr<TaskQueue>> m_queues;
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_signalMutex;
+		std::condition_variable m_workAvailableCondition;
+		std::condition_variable m_jobDoneCondition;
+		uint64_t m_workGeneration = 0u;
+		bool m_isShuttingDown = false;
+	};
+}
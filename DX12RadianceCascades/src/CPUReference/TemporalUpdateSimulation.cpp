@@ -0,0 +1,144 @@
+#include "TemporalUpdateSimulation.h"
+#include "IntervalEncoding.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace CPUReference
+{
+	namespace
+	{
+		uint64_t GetTotalTracedRayCount(const ReferencePipeline& pipeline)
+		{
+			uint64_t tracedRayCount = 0u;
+			for (uint32_t i = 0; i < pipeline.GetLayout().GetCascadeCount(); i++)
+			{
+				tracedRayCount += pipeline.GetTracedRayCount(i);
+			}
+
+			return tracedRayCount;
+		}
+	}
+
+	std::vector<CameraPathKey> CreateOrbitCameraPath(const float3& target, float radius, float height, float degreesPerFrame, uint32_t frameCount)
+	{
+		std::vector<CameraPathKey> path(frameCount);
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			const float angle = (float)i * degreesPerFrame * Pi / 180.0f;
+
+			path[i].eye = target + float3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+			path[i].target = target;
+		}
+
+		return path;
+	}
+
+	bool ReadCameraPathCSV(const std::string& filePath, std::vector<CameraPathKey>& pathOut)
+	{
+		std::ifstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		pathOut.clear();
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			// Commas are swapped for spaces so that the stream can read the values directly.
+			for (char& c : line)
+			{
+				c = c == ',' ? ' ' : c;
+			}
+
+			std::istringstream lineStream(line);
+			CameraPathKey key;
+			if (lineStream >> key.eye.x >> key.eye.y >> key.eye.z >> key.target.x >> key.target.y >> key.target.z)
+			{
+				pathOut.push_back(key);
+			}
+		}
+
+		return true;
+	}
+
+	bool WriteCameraPathCSV(const std::string& filePath, const std::vector<CameraPathKey>& path)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Eye X,Eye Y,Eye Z,Target X,Target Y,Target Z\n";
+		for (const CameraPathKey& key : path)
+		{
+			file << key.eye.x << "," << key.eye.y << "," << key.eye.z << ","
+				<< key.target.x << "," << key.target.y << "," << key.target.z << "\n";
+		}
+
+		return file.good();
+	}
+
+	std::vector<TemporalUpdateFrameResult> RunTemporalUpdateSimulation(TaskPool& taskPool, const ReferenceSettings& settings, const RayTracer& tracer, const ReferenceCamera& lensCamera, const std::vector<CameraPathKey>& path)
+	{
+		std::vector<TemporalUpdateFrameResult> results;
+
+		ReferenceSettings fullRefreshSettings = settings;
+		fullRefreshSettings.useStaggeredUpdates = false;
+
+		ReferenceSettings staggeredSettings = settings;
+		staggeredSettings.useStaggeredUpdates = true;
+
+		ReferencePipeline fullRefreshPipeline(taskPool);
+		fullRefreshPipeline.Generate(fullRefreshSettings);
+
+		ReferencePipeline staggeredPipeline(taskPool);
+		staggeredPipeline.Generate(staggeredSettings);
+
+		DepthTexture depth(settings.layoutDesc.width, settings.layoutDesc.height);
+		ReferenceCamera camera = lensCamera;
+
+		for (uint32_t i = 0; i < (uint32_t)path.size(); i++)
+		{
+			camera.SetLookAt(path[i].eye, path[i].target, float3(0.0f, 1.0f, 0.0f));
+			RenderDepth(camera, tracer, taskPool, depth);
+
+			fullRefreshPipeline.Run(tracer, camera, depth);
+			staggeredPipeline.RunStaggered(tracer, camera, depth);
+
+			const RadianceTexture& fullRefreshResult = fullRefreshPipeline.GetCoalescedResult();
+
+			TemporalUpdateFrameResult& result = results.emplace_back();
+			result.frameIndex = i;
+			result.tracedRayCount = GetTotalTracedRayCount(staggeredPipeline);
+			result.fullRefreshRayCount = GetTotalTracedRayCount(fullRefreshPipeline);
+			result.coalescedPSNR = ComputePSNR(fullRefreshResult.GetData(), staggeredPipeline.GetCoalescedResult().GetData(), fullRefreshResult.GetTexelCount());
+		}
+
+		return results;
+	}
+
+	bool WriteTemporalUpdateResultsCSV(const std::string& filePath, const std::vector<TemporalUpdateFrameResult>& results)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Frame,Traced Rays,Full Refresh Rays,Coalesced PSNR (dB)\n";
+		for (const TemporalUpdateFrameResult& result : results)
+		{
+			file << result.frameIndex << ","
+				<< result.tracedRayCount << ","
+				<< result.fullRefreshRayCount << ","
+				<< result.coalescedPSNR << "\n";
+		}
+
+		return file.good();
+	}
+}
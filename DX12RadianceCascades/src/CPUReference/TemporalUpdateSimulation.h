@@ -0,0 +1,43 @@
+#pragma once
+
+// Replays a camera path through the reference pipeline with and without staggered cascade updates, see CascadeUpdateScheduler.h.
+// Every frame is compared to a full refresh of all cascades from the same camera, which is what the GPU does without staggered updates.
+
+#include "ReferencePipeline.h"
+
+#include <string>
+#include <vector>
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	struct CameraPathKey
+	{
+		float3 eye;
+		float3 target;
+	};
+
+	struct TemporalUpdateFrameResult
+	{
+		uint32_t frameIndex = 0u;
+		// Rays traced by the staggered update and by the full refresh, counts every pre-averaged sub ray.
+		uint64_t tracedRayCount = 0u;
+		uint64_t fullRefreshRayCount = 0u;
+		// Coalesced result of the staggered update against the full refresh. Infinite if they match.
+		double coalescedPSNR = 0.0;
+	};
+
+	// One key per frame, circling target at the given radius and height above it.
+	std::vector<CameraPathKey> CreateOrbitCameraPath(const float3& target, float radius, float height, float degreesPerFrame, uint32_t frameCount);
+
+	// One key per line: eye x, y, z, target x, y, z. Lines that do not start with a number are skipped.
+	bool ReadCameraPathCSV(const std::string& filePath, std::vector<CameraPathKey>& pathOut);
+	bool WriteCameraPathCSV(const std::string& filePath, const std::vector<CameraPathKey>& path);
+
+	// Lens and resolution are taken from lensCamera and settings.layoutDesc. Staggered update settings in settings are overridden
+	// for the full refresh, and the depth buffer is rendered for every key.
+	std::vector<TemporalUpdateFrameResult> RunTemporalUpdateSimulation(TaskPool& taskPool, const ReferenceSettings& settings, const RayTracer& tracer, const ReferenceCamera& lensCamera, const std::vector<CameraPathKey>& path);
+
+	bool WriteTemporalUpdateResultsCSV(const std::string& filePath, const std::vector<TemporalUpdateFrameResult>& results);
+}
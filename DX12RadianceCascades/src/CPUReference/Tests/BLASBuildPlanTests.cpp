@@ -0,0 +1,171 @@
+#include "TestFramework.h"
+
+#include "BLASBuildPlan.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	struct ByteRange
+	{
+		// Batch or page.
+		uint32_t groupIndex = 0u;
+		uint64_t begin = 0u;
+		uint64_t end = 0u;
+	};
+
+	// Ranges that share a batch or page and overlap.
+	uint64_t CountOverlaps(std::vector<ByteRange> ranges)
+	{
+		std::sort(ranges.begin(), ranges.end(), [](const ByteRange& a, const ByteRange& b)
+			{
+				return a.groupIndex != b.groupIndex ? a.groupIndex < b.groupIndex : a.begin < b.begin;
+			});
+
+		uint64_t overlapCount = 0u;
+		for (size_t i = 1; i < ranges.size(); i++)
+		{
+			if (ranges[i].groupIndex == ranges[i - 1].groupIndex && ranges[i].begin < ranges[i - 1].end)
+			{
+				overlapCount++;
+			}
+		}
+
+		return overlapCount;
+	}
+
+	bool IsAligned(uint64_t offset)
+	{
+		return offset % AccelerationStructureAlignment == 0u;
+	}
+
+	uint64_t LerpBytes(uint64_t minBytes, uint64_t maxBytes, float t)
+	{
+		return minBytes + uint64_t(double(maxBytes - minBytes) * double(t));
+	}
+
+	// Made up sizes spread like the models of a scene, many small props and a few with 8 times the max size. Scratch is about as
+	// large as the result and compacted sizes are between 0.3 and 0.7 of it.
+	void CheckPlans(uint32_t blasCount, uint64_t minResultBytes, uint64_t maxResultBytes, const BLASBuildPlanDesc& buildDesc, const BLASPoolDesc& poolDesc)
+	{
+		TestRandom random(blasCount);
+
+		std::vector<BLASPrebuildSizes> sizes(blasCount);
+		std::vector<uint64_t> compactedBytes(blasCount);
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			const uint64_t blasMaxResultBytes = random.NextFloat() < 0.05f ? maxResultBytes * 8u : maxResultBytes;
+			sizes[i].resultBytes = LerpBytes(minResultBytes, blasMaxResultBytes, random.NextFloat());
+			sizes[i].scratchBytes = LerpBytes(sizes[i].resultBytes / 2u, sizes[i].resultBytes * 2u, random.NextFloat());
+			compactedBytes[i] = (std::max)(uint64_t(double(sizes[i].resultBytes) * double(random.NextFloat(0.3f, 0.7f))), uint64_t(1u));
+		}
+
+		const BLASBuildPlan buildPlan = PlanBLASBuilds(sizes, buildDesc);
+		const BLASPoolPlan poolPlan = PackBLASPool(compactedBytes, poolDesc);
+		CPUREF_CHECK_EQ((uint32_t)buildPlan.entries.size(), blasCount);
+		CPUREF_CHECK_EQ((uint32_t)poolPlan.entries.size(), blasCount);
+
+		uint64_t alignmentErrorCount = 0u;
+		uint64_t outOfBoundsCount = 0u;
+		uint64_t unbatchedBytes = 0u;
+
+		// Scratch ranges can only overlap within a batch, every batch reuses the same scratch. Results all live in one buffer.
+		std::vector<uint64_t> batchScratchBytes(buildPlan.batchCount, 0u);
+		std::vector<uint32_t> batchBLASCounts(buildPlan.batchCount, 0u);
+		std::vector<ByteRange> scratchRanges;
+		std::vector<ByteRange> resultRanges;
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			const BLASBuildEntry& entry = buildPlan.entries[i];
+			alignmentErrorCount += !IsAligned(entry.scratchOffset) || !IsAligned(entry.resultOffset) ? 1u : 0u;
+
+			const ByteRange scratchRange = { entry.batchIndex, entry.scratchOffset, entry.scratchOffset + sizes[i].scratchBytes };
+			const ByteRange resultRange = { 0u, entry.resultOffset, entry.resultOffset + sizes[i].resultBytes };
+			if (entry.batchIndex >= buildPlan.batchCount || scratchRange.end > buildPlan.scratchBytes || resultRange.end > buildPlan.resultBytes)
+			{
+				outOfBoundsCount++;
+				continue;
+			}
+
+			scratchRanges.push_back(scratchRange);
+			resultRanges.push_back(resultRange);
+
+			batchScratchBytes[entry.batchIndex] = (std::max)(batchScratchBytes[entry.batchIndex], scratchRange.end);
+			batchBLASCounts[entry.batchIndex]++;
+
+			unbatchedBytes += AlignAccelerationStructureBytes(sizes[i].resultBytes) + AlignAccelerationStructureBytes(sizes[i].scratchBytes);
+		}
+
+		// Only a batch of a single BLAS can go over the budget.
+		uint64_t overBudgetCount = 0u;
+		for (uint32_t batchIndex = 0; batchIndex < buildPlan.batchCount; batchIndex++)
+		{
+			if (buildDesc.maxScratchBytes > 0u && batchScratchBytes[batchIndex] > buildDesc.maxScratchBytes && batchBLASCounts[batchIndex] > 1u)
+			{
+				overBudgetCount++;
+			}
+		}
+
+		std::vector<ByteRange> poolRanges;
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			const BLASPoolEntry& entry = poolPlan.entries[i];
+			alignmentErrorCount += !IsAligned(entry.offset) ? 1u : 0u;
+
+			const ByteRange poolRange = { entry.pageIndex, entry.offset, entry.offset + compactedBytes[i] };
+			if (entry.pageIndex >= poolPlan.pageBytes.size() || poolRange.end > poolPlan.pageBytes[entry.pageIndex])
+			{
+				outOfBoundsCount++;
+				continue;
+			}
+
+			poolRanges.push_back(poolRange);
+		}
+
+		// Pages are trimmed to what is used, which is a sum of aligned sizes.
+		for (uint64_t pageBytes : poolPlan.pageBytes)
+		{
+			alignmentErrorCount += !IsAligned(pageBytes) ? 1u : 0u;
+		}
+
+		CPUREF_CHECK_EQ(alignmentErrorCount, 0ull);
+		CPUREF_CHECK_EQ(outOfBoundsCount, 0ull);
+		CPUREF_CHECK_EQ(overBudgetCount, 0ull);
+		CPUREF_CHECK_EQ(CountOverlaps(scratchRanges) + CountOverlaps(resultRanges) + CountOverlaps(poolRanges), 0ull);
+
+		// The pooled scratch and every uncompacted result never take more than every BLAS keeping its own.
+		CPUREF_CHECK(buildPlan.scratchBytes + buildPlan.resultBytes <= unbatchedBytes);
+		CPUREF_CHECK(buildDesc.maxScratchBytes > 0u || buildPlan.batchCount == 1u);
+	}
+}
+
+// Every plan is checked for misaligned ranges, overlapping ranges in the same batch or page, ranges past the end of their buffer and
+// scratch over budget.
+CPUREF_TEST(BLASBuildPlans)
+{
+	for (uint32_t blasCount : { 16u, 64u, 256u, 1024u })
+	{
+		for (uint64_t maxScratchBytes : { 0ull, 32ull * 1024ull * 1024ull })
+		{
+			for (uint64_t pageBytes : { 4ull * 1024ull * 1024ull, 64ull * 1024ull * 1024ull })
+			{
+				BLASBuildPlanDesc buildDesc;
+				buildDesc.maxScratchBytes = maxScratchBytes;
+				BLASPoolDesc poolDesc;
+				poolDesc.pageBytes = pageBytes;
+				CheckPlans(blasCount, 16ull * 1024ull, 4ull * 1024ull * 1024ull, buildDesc, poolDesc);
+			}
+		}
+	}
+
+	// Sizes that are not multiples of the alignment.
+	BLASBuildPlanDesc buildDesc;
+	buildDesc.maxScratchBytes = 16u * 1024u;
+	BLASPoolDesc poolDesc;
+	poolDesc.pageBytes = 8u * 1024u;
+	CheckPlans(64u, 1u, 4096u, buildDesc, poolDesc);
+}
@@ -0,0 +1,122 @@
+#include "TestFramework.h"
+#include "CascadeLayoutSweep.h"
+
+#include "CascadeAtlasLayout.h"
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	bool IsOverlapping(const CascadeAtlasRect& a, const CascadeAtlasRect& b)
+	{
+		const bool isOverlappingX = a.offsetX < b.offsetX + b.width && b.offsetX < a.offsetX + a.width;
+		const bool isOverlappingY = a.offsetY < b.offsetY + b.height && b.offsetY < a.offsetY + a.height;
+		return isOverlappingX && isOverlappingY;
+	}
+
+	void CheckAtlas(const CascadeLayout& cascadeLayout, const CascadeAtlasLayout& atlasLayout, uint32_t maxDimension)
+	{
+		CPUREF_CHECK(atlasLayout.Validate());
+		CPUREF_CHECK_EQ(atlasLayout.GetCascadeCount(), cascadeLayout.GetCascadeCount());
+		CPUREF_CHECK(atlasLayout.GetWidth() <= maxDimension);
+		CPUREF_CHECK(atlasLayout.GetHeight() <= maxDimension);
+
+		uint64_t usedTexelCount = 0u;
+		for (uint32_t i = 0; i < atlasLayout.GetCascadeCount(); i++)
+		{
+			const CascadeAtlasRect& rect = atlasLayout.GetRect(i);
+			const CascadeLevel& level = cascadeLayout.GetLevel(i);
+
+			// Every rect holds exactly its cascade texture, made of whole probe tiles.
+			CPUREF_CHECK_EQ(rect.width, level.textureWidth);
+			CPUREF_CHECK_EQ(rect.height, level.textureHeight);
+			CPUREF_CHECK_EQ(rect.width, level.probesX * level.raysPerProbeDim);
+			CPUREF_CHECK_EQ(rect.height, level.probesY * level.raysPerProbeDim);
+
+			CPUREF_CHECK(rect.offsetX + rect.width <= atlasLayout.GetWidth());
+			CPUREF_CHECK(rect.offsetY + rect.height <= atlasLayout.GetHeight());
+
+			// Cascades are stacked in order, so a rect starts right below the previous one or at the top of the next column.
+			if (i > 0u)
+			{
+				const CascadeAtlasRect& previousRect = atlasLayout.GetRect(i - 1u);
+				const bool continuesColumn = rect.offsetX == previousRect.offsetX && rect.offsetY == previousRect.offsetY + previousRect.height;
+				const bool startsColumn = rect.offsetY == 0u && rect.offsetX >= previousRect.offsetX + previousRect.width;
+				CPUREF_CHECK(continuesColumn || startsColumn);
+			}
+			else
+			{
+				CPUREF_CHECK_EQ(rect.offsetX, 0u);
+				CPUREF_CHECK_EQ(rect.offsetY, 0u);
+			}
+
+			for (uint32_t k = 0; k < i; k++)
+			{
+				CPUREF_CHECK(!IsOverlapping(rect, atlasLayout.GetRect(k)));
+			}
+
+			usedTexelCount += uint64_t(rect.width) * rect.height;
+		}
+
+		CPUREF_CHECK_EQ(atlasLayout.GetUnusedTexelCount(), uint64_t(atlasLayout.GetWidth()) * atlasLayout.GetHeight() - usedTexelCount);
+	}
+}
+
+CPUREF_TEST(CascadeAtlasLayoutSweep)
+{
+	uint32_t generatedCount = 0u;
+	uint32_t multiColumnCount = 0u;
+	for (const CascadeLayoutDesc& desc : GetCascadeLayoutSweep())
+	{
+		CascadeLayout cascadeLayout;
+		cascadeLayout.Generate(desc);
+
+		// The smaller limit forces cascades into several columns.
+		for (uint32_t maxDimension : { MaxCascadeAtlasDimension, 4096u })
+		{
+			CascadeAtlasLayout atlasLayout;
+			if (!atlasLayout.Generate(cascadeLayout, maxDimension))
+			{
+				CPUREF_CHECK(atlasLayout.IsEmpty());
+				CPUREF_CHECK_EQ(atlasLayout.GetWidth(), 0u);
+				CPUREF_CHECK_EQ(atlasLayout.GetHeight(), 0u);
+				continue;
+			}
+
+			CheckAtlas(cascadeLayout, atlasLayout, maxDimension);
+
+			generatedCount++;
+			multiColumnCount += atlasLayout.GetCascadeCount() > 1u && atlasLayout.GetRect(atlasLayout.GetCascadeCount() - 1u).offsetX > 0u ? 1u : 0u;
+		}
+	}
+
+	// Keeps the sweep from passing by generating nothing.
+	CPUREF_CHECK(generatedCount > 0u);
+	CPUREF_CHECK(multiColumnCount > 0u);
+
+	// The default settings always fit.
+	CascadeLayout defaultLayout;
+	defaultLayout.Generate(CascadeLayoutDesc());
+	CascadeAtlasLayout defaultAtlas;
+	CPUREF_CHECK(defaultAtlas.Generate(defaultLayout));
+}
+
+CPUREF_TEST(CascadeAtlasLayoutRejectsOversizedCascades)
+{
+	CascadeAtlasLayout atlasLayout;
+	CPUREF_CHECK(!atlasLayout.Generate({ { 64u, 64u }, { 65u, 16u } }, 64u));
+	CPUREF_CHECK(atlasLayout.IsEmpty());
+
+	// Every 64x64 cascade needs its own column, two columns are wider than the limit.
+	CPUREF_CHECK(!atlasLayout.Generate({ { 64u, 64u }, { 64u, 64u } }, 96u));
+	CPUREF_CHECK(atlasLayout.IsEmpty());
+
+	CPUREF_CHECK(atlasLayout.Generate({ { 64u, 64u }, { 32u, 64u }, { 64u, 32u } }, 128u));
+	CPUREF_CHECK(atlasLayout.Validate());
+	CPUREF_CHECK_EQ(atlasLayout.GetWidth(), 128u);
+	CPUREF_CHECK_EQ(atlasLayout.GetHeight(), 128u);
+	CPUREF_CHECK_EQ(atlasLayout.GetRect(2).offsetX, 64u);
+	CPUREF_CHECK_EQ(atlasLayout.GetRect(2).offsetY, 0u);
+	CPUREF_CHECK_EQ(atlasLayout.GetUnusedTexelCount(), uint64_t(128u * 128u - 64u * 64u - 32u * 64u - 64u * 32u));
+}
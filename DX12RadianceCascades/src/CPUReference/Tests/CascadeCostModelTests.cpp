@@ -0,0 +1,145 @@
+#include "TestFramework.h"
+
+#include "CascadeCostModel.h"
+#include "GatherFilterBits.h"
+
+using namespace CPUReference;
+
+namespace
+{
+	CascadeCostDesc GetCostDesc(uint32_t width, uint32_t height, uint32_t probeSpacing0, bool isUsingPreAveragedIntervals)
+	{
+		CascadeCostDesc desc;
+		desc.layout.width = width;
+		desc.layout.height = height;
+		desc.layout.probeSpacing0 = probeSpacing0;
+		desc.layout.isUsingPreAveragedIntervals = isUsingPreAveragedIntervals;
+		return desc;
+	}
+}
+
+// Every level of the cost has the texels and rays of the same level of CascadeLayout, and the bytes of its interval format and gather filter.
+CPUREF_TEST(CascadeCostMatchesLayout)
+{
+	const uint32_t resolutions[][2] = { { 1280u, 720u }, { 1366u, 768u }, { 1920u, 1080u }, { 3840u, 2160u } };
+	for (const uint32_t* resolution : resolutions)
+	{
+		for (uint32_t probeSpacing0 : { 1u, 2u, 3u, 4u })
+		{
+			for (bool isUsingPreAveragedIntervals : { true, false })
+			{
+				for (IntervalFormat format : { IntervalFormatFP16, IntervalFormatR11G11B10 })
+				{
+					CascadeCostDesc desc = GetCostDesc(resolution[0], resolution[1], probeSpacing0, isUsingPreAveragedIntervals);
+					desc.intervalFormat = format;
+
+					CascadeLayout layout;
+					layout.Generate(desc.layout);
+
+					const CascadeCost cost = ComputeCascadeCost(desc);
+					CPUREF_CHECK_EQ((uint32_t)cost.levels.size(), layout.GetCascadeCount());
+
+					const uint64_t texelBytes = GetIntervalTexelBytes(format);
+					uint64_t texelCount = 0u;
+					uint64_t tracedRays = 0u;
+					uint64_t intervalBytes = 0u;
+					uint64_t gatherFilterBytes = 0u;
+					uint64_t mergeReadBytes = 0u;
+					for (uint32_t i = 0; i < layout.GetCascadeCount(); i++)
+					{
+						const CascadeLevel& level = layout.GetLevel(i);
+						const CascadeLevelCost& levelCost = cost.levels[i];
+						const uint64_t levelTexelCount = uint64_t(level.textureWidth) * level.textureHeight;
+
+						CPUREF_CHECK_EQ(levelCost.texelCount, levelTexelCount);
+						CPUREF_CHECK_EQ(levelCost.intervalBytes, levelTexelCount * texelBytes);
+						// Pre-averaged texels trace rayScalingFactor rays each, so every ray of the layout is traced exactly once either way.
+						CPUREF_CHECK_EQ(levelCost.tracedRays, layout.GetTotalRays(i));
+
+						const uint64_t expectedGatherFilterBytes = i > 0u ? uint64_t(GetGatherFilterWordCount(level.textureWidth, level.textureHeight)) * 4u : 0u;
+						CPUREF_CHECK_EQ(levelCost.gatherFilterBytes, expectedGatherFilterBytes);
+						CPUREF_CHECK_EQ(levelCost.historyBytes, 0ull);
+
+						const uint64_t expectedMergeReadTexels = i > 0u ? uint64_t(layout.GetLevel(i - 1u).textureWidth) * layout.GetLevel(i - 1u).textureHeight * desc.layout.rayScalingFactor * 4u : 0u;
+						CPUREF_CHECK_EQ(levelCost.mergeReadTexels, expectedMergeReadTexels);
+						CPUREF_CHECK_EQ(levelCost.mergeReadBytes, expectedMergeReadTexels * texelBytes);
+
+						texelCount += levelTexelCount;
+						tracedRays += layout.GetTotalRays(i);
+						intervalBytes += levelTexelCount * texelBytes;
+						gatherFilterBytes += expectedGatherFilterBytes;
+						mergeReadBytes += expectedMergeReadTexels * texelBytes;
+					}
+
+					CPUREF_CHECK_EQ(cost.texelCount, texelCount);
+					CPUREF_CHECK_EQ(cost.tracedRays, tracedRays);
+					CPUREF_CHECK_EQ(cost.intervalBytes, intervalBytes);
+					CPUREF_CHECK_EQ(cost.gatherFilterBytes, gatherFilterBytes);
+					CPUREF_CHECK_EQ(cost.mergeReadBytes, mergeReadBytes);
+					CPUREF_CHECK_EQ(cost.historyBytes, 0ull);
+					CPUREF_CHECK_EQ(cost.activeProbeDirectionBytes, 0ull);
+					CPUREF_CHECK_EQ(cost.totalBytes, cost.intervalBytes + cost.gatherFilterBytes + cost.mergeWeightBytes + cost.otherBytes);
+
+					const CascadeLevel& lastLevel = layout.GetLevel(layout.GetCascadeCount() - 1u);
+					CPUREF_CHECK_EQ(cost.reach, lastLevel.startT + lastLevel.rayLength);
+				}
+			}
+		}
+	}
+}
+
+// Staggered updates keep a history of every cascade but the first, the atlas allocates at least the texels of every cascade.
+CPUREF_TEST(CascadeCostOptionalResources)
+{
+	for (uint32_t probeSpacing0 : { 1u, 2u, 4u })
+	{
+		const CascadeCostDesc baseDesc = GetCostDesc(1920u, 1080u, probeSpacing0, true);
+		const CascadeCost baseCost = ComputeCascadeCost(baseDesc);
+
+		CascadeCostDesc staggeredDesc = baseDesc;
+		staggeredDesc.useStaggeredUpdates = true;
+		const CascadeCost staggeredCost = ComputeCascadeCost(staggeredDesc);
+
+		CPUREF_CHECK_EQ(staggeredCost.historyBytes, baseCost.intervalBytes - baseCost.levels[0].intervalBytes);
+		CPUREF_CHECK_EQ(staggeredCost.totalBytes, baseCost.totalBytes + staggeredCost.historyBytes);
+
+		CascadeCostDesc atlasDesc = baseDesc;
+		atlasDesc.useCascadeAtlas = true;
+		const CascadeCost atlasCost = ComputeCascadeCost(atlasDesc);
+
+		if (!atlasCost.isAtlasFallback)
+		{
+			CPUREF_CHECK(atlasCost.intervalBytes >= baseCost.intervalBytes);
+		}
+		else
+		{
+			CPUREF_CHECK_EQ(atlasCost.intervalBytes, baseCost.intervalBytes);
+		}
+	}
+}
+
+// Every candidate of the solver fits the constraints and costs the same as computing its desc directly.
+CPUREF_TEST(CascadeBudgetCandidatesFitConstraints)
+{
+	const CascadeCostDesc baseDesc = GetCostDesc(1920u, 1080u, 2u, true);
+
+	CascadeBudgetConstraints constraints;
+	constraints.maxTracedRays = ComputeCascadeCost(baseDesc).tracedRays;
+	constraints.maxBytes = 128ull * 1024ull * 1024ull;
+
+	const std::vector<CascadeBudgetCandidate> candidates = SolveCascadeBudget(baseDesc, constraints, CascadeBudgetSearchSpace());
+	CPUREF_CHECK(!candidates.empty());
+
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const CascadeBudgetCandidate& candidate = candidates[i];
+		CPUREF_CHECK(candidate.cost.tracedRays <= constraints.maxTracedRays);
+		CPUREF_CHECK(candidate.cost.totalBytes <= constraints.maxBytes);
+		CPUREF_CHECK_EQ(candidate.cost.totalBytes, ComputeCascadeCost(candidate.desc).totalBytes);
+
+		if (i > 0u)
+		{
+			CPUREF_CHECK(candidates[i - 1u].rayDensity0 >= candidate.rayDensity0);
+		}
+	}
+}
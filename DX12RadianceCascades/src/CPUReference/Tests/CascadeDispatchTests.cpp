@@ -0,0 +1,161 @@
+#include "TestFramework.h"
+#include "CascadeLayoutSweep.h"
+
+// Included on its own, the same way GPUStructs.h does, instead of through RCShaderFunctions.h.
+#include "../../../Assets/shaders/RCCascadeDispatch.hlsli"
+
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Same limit as RadianceCascadeManager3D::CanUseSingleGatherDispatch(), D3D12_RAYTRACING_MAX_RAY_GENERATION_SHADER_THREADS.
+	constexpr uint64_t MaxSingleDispatchTexelCount = 1ull << 30u;
+	// Layouts with more texels are only checked at the cascade boundaries, which keeps the post-build run of the Debug tests short.
+	constexpr uint64_t MaxWalkedTexelCount = 1ull << 18u;
+
+	RCShaderShared::CascadeDispatchTable BuildTable(const CascadeLayout& cascadeLayout)
+	{
+		RCShaderShared::uint2 cascadeDims[RC_MAX_CASCADE_COUNT] = {};
+		for (uint32_t i = 0; i < cascadeLayout.GetCascadeCount(); i++)
+		{
+			cascadeDims[i] = { cascadeLayout.GetLevel(i).textureWidth, cascadeLayout.GetLevel(i).textureHeight };
+		}
+
+		return RCShaderShared::BuildCascadeDispatchTable(cascadeDims, cascadeLayout.GetCascadeCount());
+	}
+
+	// Maps the linear index like RayGenerationShader in RCRaytraceRT.hlsl and checks that it maps back to the same index.
+	void CheckLinearIndex(const RCShaderShared::CascadeDispatchTable& table, uint32_t linearIndex, uint32_t& cascadeIndexOut, uint32_t& localIndexOut)
+	{
+		const uint32_t cascadeIndex = RCShaderShared::GetDispatchCascadeIndex(table, linearIndex);
+		const RCShaderShared::uint2 texel = RCShaderShared::GetDispatchCascadeTexel(table, cascadeIndex, linearIndex);
+		const RCShaderShared::CascadeDispatchRange& range = table.cascades[cascadeIndex];
+
+		CPUREF_CHECK(cascadeIndex < table.cascadeCount);
+		CPUREF_CHECK(texel.x < range.width);
+		CPUREF_CHECK(texel.y < range.height);
+		CPUREF_CHECK_EQ(range.firstLinearIndex + texel.y * range.width + texel.x, linearIndex);
+
+		cascadeIndexOut = cascadeIndex;
+		localIndexOut = texel.y * range.width + texel.x;
+	}
+}
+
+CPUREF_TEST(CascadeDispatchTableSweep)
+{
+	uint32_t walkedLayoutCount = 0u;
+	for (const CascadeLayoutDesc& desc : GetCascadeLayoutSweep())
+	{
+		CascadeLayout cascadeLayout;
+		cascadeLayout.Generate(desc);
+		if (cascadeLayout.GetCascadeCount() < 2u)
+		{
+			continue;
+		}
+
+		uint64_t texelCount = 0u;
+		for (uint32_t i = 0; i < cascadeLayout.GetCascadeCount(); i++)
+		{
+			texelCount += uint64_t(cascadeLayout.GetLevel(i).textureWidth) * cascadeLayout.GetLevel(i).textureHeight;
+		}
+
+		// Too large for a single dispatch, the cascades are gathered one dispatch each.
+		if (texelCount > MaxSingleDispatchTexelCount)
+		{
+			continue;
+		}
+
+		const RCShaderShared::CascadeDispatchTable table = BuildTable(cascadeLayout);
+		CPUREF_CHECK_EQ(table.cascadeCount, cascadeLayout.GetCascadeCount());
+		CPUREF_CHECK_EQ((uint64_t)table.texelCount, texelCount);
+
+		uint64_t firstLinearIndex = 0u;
+		for (uint32_t i = 0; i < table.cascadeCount; i++)
+		{
+			const RCShaderShared::CascadeDispatchRange& range = table.cascades[i];
+			CPUREF_CHECK_EQ((uint64_t)range.firstLinearIndex, firstLinearIndex);
+			CPUREF_CHECK_EQ(range.width, cascadeLayout.GetLevel(i).textureWidth);
+			CPUREF_CHECK_EQ(range.height, cascadeLayout.GetLevel(i).textureHeight);
+
+			// Lists start at cascade 1 and follow each other without gaps.
+			if (i > 0u)
+			{
+				CPUREF_CHECK_EQ((uint64_t)RCShaderShared::GetActiveProbeDirectionListOffset(table, i), firstLinearIndex - table.cascades[1].firstLinearIndex);
+			}
+
+			// First and last texel of the cascade.
+			const uint64_t cascadeTexelCount = uint64_t(range.width) * range.height;
+			for (uint64_t linearIndex : { firstLinearIndex, firstLinearIndex + cascadeTexelCount - 1u })
+			{
+				uint32_t cascadeIndex = 0u;
+				uint32_t localIndex = 0u;
+				CheckLinearIndex(table, (uint32_t)linearIndex, cascadeIndex, localIndex);
+				CPUREF_CHECK_EQ(cascadeIndex, i);
+			}
+
+			firstLinearIndex += cascadeTexelCount;
+		}
+
+		if (texelCount > MaxWalkedTexelCount)
+		{
+			continue;
+		}
+
+		// Every linear index of the dispatch has to land on a different texel, and every texel of every cascade has to be reached.
+		std::vector<std::vector<bool>> isVisited(table.cascadeCount);
+		for (uint32_t i = 0; i < table.cascadeCount; i++)
+		{
+			isVisited[i].assign(size_t(table.cascades[i].width) * table.cascades[i].height, false);
+		}
+
+		uint64_t revisitedCount = 0u;
+		for (uint32_t linearIndex = 0; linearIndex < table.texelCount; linearIndex++)
+		{
+			uint32_t cascadeIndex = 0u;
+			uint32_t localIndex = 0u;
+			CheckLinearIndex(table, linearIndex, cascadeIndex, localIndex);
+
+			revisitedCount += isVisited[cascadeIndex][localIndex] ? 1u : 0u;
+			isVisited[cascadeIndex][localIndex] = true;
+		}
+
+		uint64_t skippedCount = 0u;
+		for (const std::vector<bool>& cascadeVisited : isVisited)
+		{
+			for (bool isTexelVisited : cascadeVisited)
+			{
+				skippedCount += isTexelVisited ? 0u : 1u;
+			}
+		}
+
+		CPUREF_CHECK_EQ(revisitedCount, 0ull);
+		CPUREF_CHECK_EQ(skippedCount, 0ull);
+		walkedLayoutCount++;
+	}
+
+	CPUREF_CHECK(walkedLayoutCount > 0u);
+}
+
+CPUREF_TEST(CascadeDispatchTableMapping)
+{
+	const RCShaderShared::uint2 cascadeDims[] = { { 4u, 2u }, { 3u, 1u }, { 1u, 2u } };
+	const RCShaderShared::CascadeDispatchTable table = RCShaderShared::BuildCascadeDispatchTable(cascadeDims, 3u);
+
+	CPUREF_CHECK_EQ(table.texelCount, 13u);
+	CPUREF_CHECK_EQ(table.cascades[1].firstLinearIndex, 8u);
+	CPUREF_CHECK_EQ(table.cascades[2].firstLinearIndex, 11u);
+	CPUREF_CHECK_EQ(RCShaderShared::GetActiveProbeDirectionListOffset(table, 2u), 3u);
+
+	const uint32_t expected[][4] = { { 0u, 0u, 0u, 0u }, { 5u, 0u, 1u, 1u }, { 7u, 0u, 3u, 1u }, { 8u, 1u, 0u, 0u }, { 10u, 1u, 2u, 0u }, { 12u, 2u, 0u, 1u } };
+	for (const uint32_t* mapping : expected)
+	{
+		const uint32_t cascadeIndex = RCShaderShared::GetDispatchCascadeIndex(table, mapping[0]);
+		const RCShaderShared::uint2 texel = RCShaderShared::GetDispatchCascadeTexel(table, cascadeIndex, mapping[0]);
+		CPUREF_CHECK_EQ(cascadeIndex, mapping[1]);
+		CPUREF_CHECK_EQ(texel.x, mapping[2]);
+		CPUREF_CHECK_EQ(texel.y, mapping[3]);
+	}
+}
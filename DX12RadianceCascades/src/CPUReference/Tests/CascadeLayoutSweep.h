@@ -0,0 +1,76 @@
+#pragma once
+
+// Cascade layouts the layout dependent tests run over: every supported pair of scaling factors, with and without pre-averaging,
+// at several screen sizes (odd ones included), probe spacings and valid ray counts of cascade 0. Layouts whose top cascade has 2^32 rays
+// per probe or more are left out, the ray count of a cascade is a uint on the GPU and in CascadeLevel.
+
+#include "CascadeLayout.h"
+#include "ScalingPermutations.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace CPUReference::Tests
+{
+	inline bool HasRayCountOverflow(const CascadeLayoutDesc& desc)
+	{
+		CascadeLayout cascadeLayout;
+		cascadeLayout.Generate(desc);
+
+		uint64_t raysPerProbe = desc.raysPerProbe0;
+		for (uint32_t i = 1; i < cascadeLayout.GetCascadeCount(); i++)
+		{
+			raysPerProbe *= desc.rayScalingFactor;
+		}
+
+		return raysPerProbe > UINT32_MAX;
+	}
+
+	inline std::vector<CascadeLayoutDesc> GetCascadeLayoutSweep()
+	{
+		const uint32_t resolutions[][2] = { { 1280u, 720u }, { 1366u, 768u }, { 1920u, 1080u }, { 2560u, 1440u }, { 3840u, 2160u } };
+
+		std::vector<CascadeLayoutDesc> descs;
+		for (const uint32_t* resolution : resolutions)
+		{
+			for (uint32_t probeSpacing0 : { 1u, 2u, 3u, 4u, 8u })
+			{
+				for (uint32_t permutationIndex = 0; permutationIndex < ScalingPermutationCount; permutationIndex++)
+				{
+					for (bool isUsingPreAveragedIntervals : { true, false })
+					{
+						const uint32_t rayScalingFactor = GetPermutationRayScalingFactor(permutationIndex);
+
+						std::vector<uint32_t> rayCounts;
+						for (uint32_t raysPerProbe0 : { 4u, 16u, 64u })
+						{
+							const uint32_t validRayCount = GetValidRayCount0(raysPerProbe0, rayScalingFactor, isUsingPreAveragedIntervals);
+							if (std::find(rayCounts.begin(), rayCounts.end(), validRayCount) == rayCounts.end())
+							{
+								rayCounts.push_back(validRayCount);
+							}
+						}
+
+						for (uint32_t raysPerProbe0 : rayCounts)
+						{
+							CascadeLayoutDesc desc;
+							desc.width = resolution[0];
+							desc.height = resolution[1];
+							desc.probeSpacing0 = probeSpacing0;
+							desc.raysPerProbe0 = raysPerProbe0;
+							desc.probeScalingFactor = GetPermutationProbeScalingFactor(permutationIndex);
+							desc.rayScalingFactor = rayScalingFactor;
+							desc.isUsingPreAveragedIntervals = isUsingPreAveragedIntervals;
+							if (!HasRayCountOverflow(desc))
+							{
+								descs.push_back(desc);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		return descs;
+	}
+}
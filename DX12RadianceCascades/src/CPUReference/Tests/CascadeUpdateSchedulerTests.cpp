@@ -0,0 +1,274 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "CascadeUpdateScheduler.h"
+#include "RCShaderFunctions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	constexpr uint32_t CascadeCount = 6u;
+
+	// Fills every texel of the cascades from cascadeBegin up with the view depth of its probe, 0 for probes on the sky.
+	void FillProbeViewDepths(ReferencePipeline& pipeline, uint32_t cascadeBegin, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		RCGlobals rcGlobals = {};
+		pipeline.FillRCGlobals(rcGlobals);
+
+		for (uint32_t i = cascadeBegin; i < pipeline.GetLayout().GetCascadeCount(); i++)
+		{
+			RadianceTexture& cascadeInterval = pipeline.GetCascadeInterval(i);
+			for (uint32_t y = 0; y < cascadeInterval.GetHeight(); y++)
+			{
+				for (uint32_t x = 0; x < cascadeInterval.GetWidth(); x++)
+				{
+					const ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(int2(x, y), i, rcGlobals);
+					const DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+					const bool isSky = IsZero(depth.Load(GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, depth.GetDims())));
+					const float viewDepth = isSky ? 0.0f : camera.GetViewDepth(GetProbeWorldPos(probeInfo3D, depth, camera));
+
+					cascadeInterval.At(x, y) = float4(viewDepth, 0.0f, 0.0f, 1.0f);
+				}
+			}
+		}
+	}
+}
+
+// Every cascade is fully gathered exactly on the multiples of its period, which never shrinks with the cascade index. So a cascade is only
+// fully gathered in frames where the cascade below it is too.
+CPUREF_TEST(CascadeUpdatePeriodsAreAligned)
+{
+	for (uint32_t periodLog2Step : { 1u, 2u })
+	{
+		for (uint32_t maxPeriodLog2 : { 0u, 2u, 3u })
+		{
+			CascadeUpdateScheduleDesc desc;
+			desc.periodLog2Step = periodLog2Step;
+			desc.maxPeriodLog2 = maxPeriodLog2;
+
+			CascadeUpdateScheduler scheduler;
+			scheduler.SetDesc(desc);
+			scheduler.Reset();
+
+			CPUREF_CHECK_EQ(scheduler.GetRefreshPeriod(0u), 1u);
+			for (uint32_t cascadeIndex = 1; cascadeIndex < CascadeCount; cascadeIndex++)
+			{
+				const uint32_t expectedPeriod = 1u << (std::min)(cascadeIndex * periodLog2Step, maxPeriodLog2);
+				CPUREF_CHECK_EQ(scheduler.GetRefreshPeriod(cascadeIndex), expectedPeriod);
+				CPUREF_CHECK(scheduler.GetRefreshPeriod(cascadeIndex) >= scheduler.GetRefreshPeriod(cascadeIndex - 1u));
+			}
+
+			for (uint32_t frame = 0; frame < 32u; frame++)
+			{
+				for (uint32_t cascadeIndex = 0; cascadeIndex < CascadeCount; cascadeIndex++)
+				{
+					const CascadeUpdate update = scheduler.GetCascadeUpdate(cascadeIndex, 64u);
+					const bool isFullExpected = frame % scheduler.GetRefreshPeriod(cascadeIndex) == 0u;
+					CPUREF_CHECK_EQ(update.type, isFullExpected ? CascadeUpdateFull : CascadeUpdateReproject);
+					CPUREF_CHECK_EQ(update.rowCount, 64u);
+
+					if (cascadeIndex > 0 && update.type == CascadeUpdateFull)
+					{
+						CPUREF_CHECK_EQ(scheduler.GetCascadeUpdate(cascadeIndex - 1u, 64u).type, CascadeUpdateFull);
+					}
+				}
+
+				scheduler.AdvanceFrame();
+			}
+
+			// A reset gathers everything in the next frame, whatever the phase was.
+			scheduler.AdvanceFrame();
+			scheduler.Reset();
+			for (uint32_t cascadeIndex = 0; cascadeIndex < CascadeCount; cascadeIndex++)
+			{
+				CPUREF_CHECK_EQ(scheduler.GetCascadeUpdate(cascadeIndex, 64u).type, CascadeUpdateFull);
+			}
+		}
+	}
+}
+
+// After the first frame, every period of frames gathers every row of a cascade exactly once, also if it has fewer rows than the period.
+CPUREF_TEST(RoundRobinRowsCoverEveryRow)
+{
+	CascadeUpdateScheduleDesc desc;
+	desc.periodLog2Step = 1u;
+	desc.maxPeriodLog2 = 3u;
+	desc.useRoundRobinRows = true;
+
+	for (uint32_t cascadeHeight : { 1u, 3u, 8u, 37u, 540u })
+	{
+		CascadeUpdateScheduler scheduler;
+		scheduler.SetDesc(desc);
+		scheduler.Reset();
+
+		// The first frame has no history, so it gathers every cascade completely.
+		for (uint32_t cascadeIndex = 0; cascadeIndex < CascadeCount; cascadeIndex++)
+		{
+			CPUREF_CHECK_EQ(scheduler.GetCascadeUpdate(cascadeIndex, cascadeHeight).type, CascadeUpdateFull);
+		}
+
+		scheduler.AdvanceFrame();
+
+		const uint32_t maxPeriod = 1u << desc.maxPeriodLog2;
+		std::vector<std::vector<uint32_t>> rowGatherCounts(CascadeCount, std::vector<uint32_t>(cascadeHeight, 0u));
+		for (uint32_t frame = 1; frame < 1u + 2u * maxPeriod; frame++)
+		{
+			for (uint32_t cascadeIndex = 0; cascadeIndex < CascadeCount; cascadeIndex++)
+			{
+				const CascadeUpdate update = scheduler.GetCascadeUpdate(cascadeIndex, cascadeHeight);
+				CPUREF_CHECK(update.rowOffset + update.rowCount <= cascadeHeight);
+
+				if (scheduler.GetRefreshPeriod(cascadeIndex) == 1u)
+				{
+					CPUREF_CHECK_EQ(update.type, CascadeUpdateFull);
+				}
+				else
+				{
+					CPUREF_CHECK_EQ(update.type, update.rowCount > 0u ? CascadeUpdateRows : CascadeUpdateReproject);
+				}
+
+				for (uint32_t row = update.rowOffset; row < update.rowOffset + update.rowCount; row++)
+				{
+					rowGatherCounts[cascadeIndex][row]++;
+				}
+			}
+
+			scheduler.AdvanceFrame();
+		}
+
+		// Two periods of the largest period were run, which is a whole number of periods of every cascade.
+		for (uint32_t cascadeIndex = 0; cascadeIndex < CascadeCount; cascadeIndex++)
+		{
+			const uint32_t expectedGatherCount = 2u * maxPeriod / scheduler.GetRefreshPeriod(cascadeIndex);
+			for (uint32_t row = 0; row < cascadeHeight; row++)
+			{
+				CPUREF_CHECK_EQ(rowGatherCounts[cascadeIndex][row], expectedGatherCount);
+			}
+		}
+	}
+}
+
+// With a camera that does not move, reprojecting the history returns it unchanged. So staggered updates have to produce the same result
+// as gathering every cascade every frame, while tracing fewer rays.
+CPUREF_TEST(StaggeredStaticCameraMatchesFullRefresh)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 4u;
+	settings.layoutDesc.raysPerProbe0 = 4u;
+
+	for (bool useRoundRobinRows : { false, true })
+	{
+		ReferencePipeline fullRefreshPipeline(fixture.taskPool);
+		fullRefreshPipeline.Generate(settings);
+		fullRefreshPipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+
+		ReferenceSettings staggeredSettings = settings;
+		staggeredSettings.useStaggeredUpdates = true;
+		staggeredSettings.updateSchedule.useRoundRobinRows = useRoundRobinRows;
+
+		ReferencePipeline staggeredPipeline(fixture.taskPool);
+		staggeredPipeline.Generate(staggeredSettings);
+
+		uint64_t fullRefreshRayCount = 0u;
+		uint64_t staggeredRayCount = 0u;
+		for (uint32_t frame = 0; frame < 9u; frame++)
+		{
+			staggeredPipeline.RunStaggered(fixture.scene, fixture.camera, fixture.depth);
+			CPUREF_CHECK_EQ(CountMismatchedTexels(staggeredPipeline.GetCoalescedResult(), fullRefreshPipeline.GetCoalescedResult()), 0ull);
+
+			for (uint32_t i = 0; i < settings.layoutDesc.maxCascadeCount; i++)
+			{
+				fullRefreshRayCount += fullRefreshPipeline.GetTracedRayCount(i);
+				staggeredRayCount += staggeredPipeline.GetTracedRayCount(i);
+			}
+		}
+
+		CPUREF_CHECK(staggeredRayCount < fullRefreshRayCount);
+	}
+}
+
+// The camera moves sideways a little, the history is filled with the view depth of every history probe. A reprojected probe has to keep
+// the depth of its own surface, so taps of other surfaces are rejected and never blended in. Probes that were disoccluded have no tap of
+// their surface and take a single tap whole, which the small move keeps to a few probes at depth edges.
+CPUREF_TEST(ReprojectionRejectsDisoccludedHistory)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 4u;
+	settings.layoutDesc.raysPerProbe0 = 4u;
+	settings.layoutDesc.probeSpacing0 = 4u;
+
+	// Camera of CreateDefaultScene() moved to the right.
+	const float3 historyOffset = float3(0.5f, 0.0f, 0.0f);
+	ReferenceCamera historyCamera = fixture.camera;
+	historyCamera.SetLookAt(float3(0.0f, 7.0f, 18.0f) + historyOffset, float3(0.0f, 1.0f, -4.0f) + historyOffset, float3(0.0f, 1.0f, 0.0f));
+	DepthTexture historyDepth(ReferenceFixture::Width, ReferenceFixture::Height);
+	RenderDepth(historyCamera, fixture.scene, fixture.taskPool, historyDepth);
+
+	ReferencePipeline historyPipeline(fixture.taskPool);
+	historyPipeline.Generate(settings);
+	FillProbeViewDepths(historyPipeline, 1u, historyCamera, historyDepth);
+
+	ReferencePipeline pipeline(fixture.taskPool);
+	pipeline.Generate(settings);
+	pipeline.ReprojectCascadesFrom(historyPipeline, historyCamera, historyDepth, 1u, fixture.camera, fixture.depth);
+
+	RCGlobals rcGlobals = {};
+	pipeline.FillRCGlobals(rcGlobals);
+
+	for (uint32_t i = 1; i < settings.layoutDesc.maxCascadeCount; i++)
+	{
+		const RadianceTexture& cascadeHistory = historyPipeline.GetCascadeInterval(i);
+		const RadianceTexture& cascadeInterval = pipeline.GetCascadeInterval(i);
+
+		uint64_t matchingTexelCount = 0u;
+		uint64_t disoccludedTexelCount = 0u;
+		uint64_t bleedingTexelCount = 0u;
+		for (uint32_t y = 0; y < cascadeInterval.GetHeight(); y++)
+		{
+			for (uint32_t x = 0; x < cascadeInterval.GetWidth(); x++)
+			{
+				const ProbeInfo3D probeInfo3D = BuildProbeInfo3DDirFirst(int2(x, y), i, rcGlobals);
+				const DepthTile depthTile = GetDepthTile(probeInfo3D.probeSpacing, probeInfo3D.tileOrigin);
+				const bool isSky = IsZero(fixture.depth.Load(GetDepthSamplePos(depthTile, probeInfo3D.probeIndex, fixture.depth.GetDims())));
+				const float expectedViewDepth = isSky ? 0.0f : historyCamera.GetViewDepth(GetProbeWorldPos(probeInfo3D, fixture.depth, fixture.camera));
+				const float reprojectedViewDepth = cascadeInterval.Load(int32_t(x), int32_t(y)).x;
+
+				if (std::abs(reprojectedViewDepth - expectedViewDepth) <= 0.1f * expectedViewDepth)
+				{
+					matchingTexelCount++;
+					continue;
+				}
+
+				// Otherwise it has to be one of the history probes around it, which the move keeps within two probes.
+				bool isSingleTap = false;
+				const int2 directionOffset = int2(probeInfo3D.rayIndex.x * probeInfo3D.probesPerDim.x, probeInfo3D.rayIndex.y * probeInfo3D.probesPerDim.y);
+				for (int32_t offsetY = -2; offsetY <= 2; offsetY++)
+				{
+					for (int32_t offsetX = -2; offsetX <= 2; offsetX++)
+					{
+						const int32_t tapX = std::clamp(probeInfo3D.probeIndex.x + offsetX, 0, probeInfo3D.probesPerDim.x - 1);
+						const int32_t tapY = std::clamp(probeInfo3D.probeIndex.y + offsetY, 0, probeInfo3D.probesPerDim.y - 1);
+						isSingleTap |= cascadeHistory.Load(directionOffset.x + tapX, directionOffset.y + tapY).x == reprojectedViewDepth;
+					}
+				}
+
+				disoccludedTexelCount += isSingleTap ? 1u : 0u;
+				bleedingTexelCount += isSingleTap ? 0u : 1u;
+			}
+		}
+
+		CPUREF_CHECK_EQ(bleedingTexelCount, 0ull);
+		CPUREF_CHECK(disoccludedTexelCount * 100u < cascadeInterval.GetTexelCount());
+		CPUREF_CHECK(matchingTexelCount > 0u);
+	}
+}
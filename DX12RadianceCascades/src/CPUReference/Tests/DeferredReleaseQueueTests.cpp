@@ -0,0 +1,174 @@
+#include "TestFramework.h"
+
+#include "DeferredReleaseQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	constexpr uint32_t ResourceSetCount = 2u;
+	constexpr uint64_t NoGeneration = UINT64_MAX;
+	constexpr uint32_t SimulatedFrameCount = 1000u;
+
+	// Regenerates the cascades the way RadianceCascadeManager3D does. Every frame uses the current of two resource sets, a regeneration
+	// builds the other set and retires the current one, waiting for the GPU only if the other set was retired so recently that it is
+	// still pending. Frames complete minLatency to maxLatency frames after they were submitted.
+	void CheckRegenerations(uint32_t regenerateInterval, uint32_t minLatency, uint32_t maxLatency)
+	{
+		TestRandom random(regenerateInterval * 16u + minLatency * 4u + maxLatency);
+		std::vector<uint32_t> latencies(SimulatedFrameCount);
+		for (uint32_t& latency : latencies)
+		{
+			latency = minLatency + random.NextUint() % (maxLatency - minLatency + 1u);
+		}
+
+		ManualReadbackFence fence;
+		DeferredReleaseQueue releaseQueue;
+
+		// Generation of the resources each set holds, a new one for every build so that frames can tell the builds of a set apart.
+		std::array<uint64_t, ResourceSetCount> setGenerations = { 0u, NoGeneration };
+		std::array<uint64_t, ResourceSetCount> setRetireFences = {};
+		std::array<bool, ResourceSetCount> isSetPending = {};
+		uint32_t currentSet = 0u;
+		uint64_t nextGeneration = 1u;
+
+		// The fence of frame N has the value N + 1, frames complete in order like on a queue. Frames before nextGPUFrame have completed.
+		std::vector<uint64_t> frameGenerations(SimulatedFrameCount, NoGeneration);
+		uint64_t submittedFrameCount = 0u;
+		uint64_t nextGPUFrame = 0u;
+		uint64_t currentFrame = 0u;
+
+		uint32_t regenerationCount = 0u;
+		uint32_t waitCount = 0u;
+		uint32_t useAfterReleaseCount = 0u;
+		uint64_t maxReleaseDelayFrames = 0u;
+
+		auto releaseCompleted = [&]()
+		{
+			fence.SetCompletedValue(nextGPUFrame);
+			releaseQueue.ReleaseCompleted(fence);
+		};
+
+		for (uint64_t frame = 0u; frame < SimulatedFrameCount; frame++)
+		{
+			currentFrame = frame;
+
+			if (frame > 0u && frame % regenerateInterval == 0u)
+			{
+				const uint32_t spareSet = (currentSet + 1u) % ResourceSetCount;
+				if (isSetPending[spareSet])
+				{
+					// Like waiting on the fence, the GPU finishes every frame up to the one the spare set was retired after.
+					waitCount++;
+					nextGPUFrame = (std::max)(nextGPUFrame, setRetireFences[spareSet]);
+					releaseCompleted();
+				}
+
+				// Building over a set that has not been released yet.
+				useAfterReleaseCount += isSetPending[spareSet] ? 1u : 0u;
+				setGenerations[spareSet] = nextGeneration++;
+
+				// Frame - 1 is the last frame submitted with the current set.
+				const uint32_t retiredSet = currentSet;
+				const uint64_t retiredGeneration = setGenerations[retiredSet];
+				const uint64_t retireFrame = frame;
+				isSetPending[retiredSet] = true;
+				setRetireFences[retiredSet] = frame;
+
+				releaseQueue.Retire(frame, [&, retiredSet, retiredGeneration, retireFrame]()
+				{
+					for (uint64_t inFlightFrame = nextGPUFrame; inFlightFrame < submittedFrameCount; inFlightFrame++)
+					{
+						useAfterReleaseCount += frameGenerations[inFlightFrame] == retiredGeneration ? 1u : 0u;
+					}
+
+					// A newer build of the set has nothing to do with this one.
+					if (setGenerations[retiredSet] == retiredGeneration)
+					{
+						setGenerations[retiredSet] = NoGeneration;
+						isSetPending[retiredSet] = false;
+					}
+
+					maxReleaseDelayFrames = (std::max)(maxReleaseDelayFrames, currentFrame - retireFrame);
+				});
+
+				currentSet = spareSet;
+				regenerationCount++;
+			}
+
+			frameGenerations[frame] = setGenerations[currentSet];
+			submittedFrameCount = frame + 1u;
+
+			while (nextGPUFrame <= frame && nextGPUFrame + latencies[nextGPUFrame] <= frame)
+			{
+				nextGPUFrame++;
+			}
+
+			releaseCompleted();
+		}
+
+		CPUREF_CHECK_EQ(regenerationCount, (SimulatedFrameCount - 1u) / regenerateInterval);
+		CPUREF_CHECK_EQ(useAfterReleaseCount, 0u);
+		// Released as soon as the frames that used the set complete, never later than the longest latency.
+		CPUREF_CHECK(maxReleaseDelayFrames <= maxLatency);
+		// Only regenerating faster than the GPU completes frames makes it wait.
+		if (regenerateInterval > maxLatency)
+		{
+			CPUREF_CHECK_EQ(waitCount, 0u);
+		}
+
+		// The GPU goes idle, nothing may be left behind.
+		nextGPUFrame = submittedFrameCount;
+		releaseCompleted();
+		CPUREF_CHECK_EQ(releaseQueue.GetPendingCount(), 0u);
+		CPUREF_CHECK_EQ(releaseQueue.GetReleasedCount(), (uint64_t)regenerationCount);
+	}
+}
+
+CPUREF_TEST(DeferredReleaseQueueOrder)
+{
+	ManualReadbackFence fence;
+	DeferredReleaseQueue releaseQueue;
+
+	std::vector<uint32_t> released;
+	releaseQueue.Retire(3u, [&]() { released.push_back(0u); });
+	releaseQueue.Retire(1u, [&]() { released.push_back(1u); });
+	releaseQueue.Retire(2u, [&]() { released.push_back(2u); });
+
+	CPUREF_CHECK_EQ(releaseQueue.ReleaseCompleted(fence), 0u);
+	CPUREF_CHECK(releaseQueue.IsPending(1u));
+
+	// Every entry is checked on its own, a later retire with an earlier fence does not wait for the ones before it.
+	fence.SetCompletedValue(2u);
+	CPUREF_CHECK_EQ(releaseQueue.ReleaseCompleted(fence), 2u);
+	CPUREF_CHECK(released == std::vector<uint32_t>({ 1u, 2u }));
+	CPUREF_CHECK(!releaseQueue.IsPending(1u));
+	CPUREF_CHECK(releaseQueue.IsPending(3u));
+	CPUREF_CHECK_EQ(releaseQueue.GetPendingCount(), 1u);
+
+	releaseQueue.Retire(100u, [&]() { released.push_back(3u); });
+	CPUREF_CHECK_EQ(releaseQueue.ReleaseAll(), 2u);
+	CPUREF_CHECK(released == std::vector<uint32_t>({ 1u, 2u, 0u, 3u }));
+	CPUREF_CHECK_EQ(releaseQueue.GetPendingCount(), 0u);
+	CPUREF_CHECK_EQ(releaseQueue.GetReleasedCount(), 4ull);
+}
+
+CPUREF_TEST(DeferredReleaseQueueRegenerations)
+{
+	for (uint32_t regenerateInterval : { 1u, 2u, 4u, 30u })
+	{
+		for (uint32_t latency = 0u; latency <= 3u; latency++)
+		{
+			CheckRegenerations(regenerateInterval, latency, latency);
+			if (latency > 0u)
+			{
+				CheckRegenerations(regenerateInterval, latency - 1u, latency + 1u);
+			}
+		}
+	}
+}
@@ -0,0 +1,188 @@
+#include "TestFramework.h"
+
+#include "GatherFilterBits.h"
+
+#include <cstring>
+
+using namespace CPUReference;
+
+namespace
+{
+	// RWByteAddressBuffer of RCRaytraceRT.hlsl, written the way it sets a texel of the gather filter:
+	// GetGatherFilterBit() in RCCommon3D.hlsli followed by InterlockedOr(filterBit.byteOffset, filterBit.mask).
+	class ByteAddressBufferEmulation
+	{
+	public:
+		explicit ByteAddressBufferEmulation(uint32_t byteSize) : m_bytes(byteSize, 0u) {}
+
+		void SetTexel(uint32_t x, uint32_t y, uint32_t filterWidth)
+		{
+			const uint32_t bitIndex = y * filterWidth + x;
+			const uint32_t byteOffset = (bitIndex >> 5) * 4;
+			const uint32_t mask = 1u << (bitIndex & 31);
+			InterlockedOr(byteOffset, mask);
+		}
+
+		uint32_t Load(uint32_t byteOffset) const
+		{
+			uint32_t value = 0u;
+			std::memcpy(&value, &m_bytes[byteOffset], sizeof(value));
+			return value;
+		}
+
+		uint32_t GetByteSize() const { return (uint32_t)m_bytes.size(); }
+
+	private:
+		void InterlockedOr(uint32_t byteOffset, uint32_t value)
+		{
+			const uint32_t original = Load(byteOffset);
+			const uint32_t result = original | value;
+			std::memcpy(&m_bytes[byteOffset], &result, sizeof(result));
+		}
+
+	private:
+		std::vector<uint8_t> m_bytes;
+	};
+
+	// Sets every texel the pattern selects in the R8 filter, the packed filter and the emulated GPU buffer.
+	template<typename PatternFunc>
+	void CheckPattern(uint32_t width, uint32_t height, const PatternFunc& isSet)
+	{
+		GatherFilterTexture byteFilter(width, height);
+		PackedGatherFilter packedFilter(width, height);
+		ByteAddressBufferEmulation gpuFilter(GetGatherFilterWordCount(width, height) * 4u);
+
+		uint64_t setCount = 0u;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				if (isSet(x, y))
+				{
+					byteFilter.At(x, y) = 1u;
+					packedFilter.Set((int32_t)x, (int32_t)y);
+					gpuFilter.SetTexel(x, y, width);
+					setCount++;
+				}
+			}
+		}
+
+		const std::vector<uint32_t>& words = packedFilter.GetWords();
+		CPUREF_CHECK_EQ((uint32_t)words.size() * 4u, gpuFilter.GetByteSize());
+		for (uint32_t wordIndex = 0; wordIndex < (uint32_t)words.size(); wordIndex++)
+		{
+			CPUREF_CHECK_EQ(words[wordIndex], gpuFilter.Load(wordIndex * 4u));
+		}
+
+		const PackedGatherFilter packedFromBytes = PackedGatherFilter::Pack(byteFilter);
+		CPUREF_CHECK(packedFromBytes.GetWords() == words);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				CPUREF_CHECK_EQ(packedFilter.Test((int32_t)x, (int32_t)y), isSet(x, y));
+			}
+		}
+
+		CPUREF_CHECK_EQ(packedFilter.PopCount(), setCount);
+
+		const GatherFilterTexture unpacked = packedFilter.Unpack();
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				CPUREF_CHECK_EQ(unpacked.At(x, y), byteFilter.At(x, y));
+			}
+		}
+
+		// Bits past the last texel of a partial last word are never set.
+		const uint32_t texelCount = width * height;
+		if (texelCount % GatherFilterBitsPerWord != 0u)
+		{
+			const uint32_t usedBitMask = (1u << (texelCount % GatherFilterBitsPerWord)) - 1u;
+			CPUREF_CHECK_EQ(words.back() & ~usedBitMask, 0u);
+		}
+	}
+}
+
+CPUREF_TEST(GatherFilterBitAddressing)
+{
+	CPUREF_CHECK_EQ(GetGatherFilterWordCount(0u, 0u), 0u);
+	CPUREF_CHECK_EQ(GetGatherFilterWordCount(32u, 1u), 1u);
+	CPUREF_CHECK_EQ(GetGatherFilterWordCount(33u, 1u), 2u);
+	CPUREF_CHECK_EQ(GetGatherFilterWordCount(33u, 3u), 4u);
+
+	// Texels are linearized row by row, bit 0 of word 0 is texel (0, 0). Texel (32, 2) is bit 98, the last one of a 33x3 filter.
+	CPUREF_CHECK_EQ(GetGatherFilterBit(0u, 0u, 33u).wordIndex, 0u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(0u, 0u, 33u).mask, 0x1u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(1u, 0u, 33u).mask, 0x2u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(31u, 0u, 33u).mask, 0x80000000u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(32u, 0u, 33u).wordIndex, 1u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(32u, 0u, 33u).mask, 0x1u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(0u, 1u, 33u).wordIndex, 1u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(0u, 1u, 33u).mask, 0x2u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(32u, 2u, 33u).wordIndex, 3u);
+	CPUREF_CHECK_EQ(GetGatherFilterBit(32u, 2u, 33u).mask, 0x4u);
+
+	PackedGatherFilter filter(33u, 3u);
+	filter.Set(1, 0);
+	filter.Set(0, 1);
+	filter.Set(32, 2);
+	CPUREF_CHECK_EQ(filter.GetWords()[0], 0x2u);
+	CPUREF_CHECK_EQ(filter.GetWords()[1], 0x2u);
+	CPUREF_CHECK_EQ(filter.GetWords()[2], 0x0u);
+	CPUREF_CHECK_EQ(filter.GetWords()[3], 0x4u);
+	CPUREF_CHECK_EQ(filter.PopCount(), 3ull);
+}
+
+CPUREF_TEST(GatherFilterBitsMatchInterlockedOr)
+{
+	// Widths below, at and above a word, with and without a partial last word.
+	const uint32_t dims[][2] = { { 1u, 1u }, { 7u, 5u }, { 32u, 4u }, { 33u, 3u }, { 64u, 2u }, { 100u, 37u } };
+	for (const uint32_t* dim : dims)
+	{
+		const uint32_t width = dim[0];
+		const uint32_t height = dim[1];
+
+		CheckPattern(width, height, [](uint32_t, uint32_t) { return false; });
+		CheckPattern(width, height, [](uint32_t, uint32_t) { return true; });
+		CheckPattern(width, height, [](uint32_t x, uint32_t y) { return ((x + y) & 1u) == 0u; });
+		CheckPattern(width, height, [width](uint32_t x, uint32_t) { return x == 0u || x + 1u == width; });
+		CheckPattern(width, height, [height](uint32_t, uint32_t y) { return y + 1u == height; });
+		CheckPattern(width, height, [width](uint32_t x, uint32_t y) { return ((y * width + x) * 2654435761u >> 28u) < 5u; });
+	}
+}
+
+CPUREF_TEST(GatherFilterBitsOutOfBounds)
+{
+	PackedGatherFilter filter(33u, 3u);
+	filter.Set(-1, 0);
+	filter.Set(0, -1);
+	filter.Set(33, 0);
+	filter.Set(0, 3);
+	CPUREF_CHECK_EQ(filter.PopCount(), 0ull);
+
+	// Would wrap into texel (0, 1) without the bounds check.
+	filter.Set(33, 0);
+	CPUREF_CHECK(!filter.Test(0, 1));
+
+	filter.Set(32, 2);
+	CPUREF_CHECK(filter.Test(32, 2));
+	CPUREF_CHECK(!filter.Test(33, 2));
+	CPUREF_CHECK(!filter.Test(32, 3));
+	CPUREF_CHECK(!filter.Test(-1, 2));
+
+	filter.Clear();
+	CPUREF_CHECK_EQ(filter.PopCount(), 0ull);
+	CPUREF_CHECK(!filter.Test(32, 2));
+}
+
+CPUREF_TEST(GatherFilterPopCountPartialWords)
+{
+	const uint32_t words[] = { 0xffffffffu, 0x0u, 0x80000001u, 0x1u };
+	CPUREF_CHECK_EQ(PopCount(words, 0u), 0ull);
+	CPUREF_CHECK_EQ(PopCount(words, 1u), 32ull);
+	CPUREF_CHECK_EQ(PopCount(words, 3u), 34ull);
+	CPUREF_CHECK_EQ(PopCount(words, 4u), 35ull);
+}
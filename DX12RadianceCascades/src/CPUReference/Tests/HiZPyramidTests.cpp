@@ -0,0 +1,145 @@
+#include "TestFramework.h"
+
+#include "HiZPyramid.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Tile width of HiZSinglePassCS.hlsl.
+	constexpr uint32_t HiZShaderTileSize = 64u;
+
+	// About one in eight texels is on the far plane.
+	void FillRandomDepth(uint32_t seed, DepthTexture& depth)
+	{
+		TestRandom random(seed);
+		for (size_t i = 0; i < depth.GetTexelCount(); i++)
+		{
+			const uint32_t value = random.NextUint();
+			depth.GetData()[i] = (value & 7u) == 0u ? 0.0f : float(value >> 8u) / float(1u << 24u);
+		}
+	}
+
+	uint64_t CountMismatchedTexels(const MinMaxDepthTexture& actual, const MinMaxDepthTexture& expected)
+	{
+		if (actual.GetWidth() != expected.GetWidth() || actual.GetHeight() != expected.GetHeight())
+		{
+			return (std::max)(actual.GetTexelCount(), expected.GetTexelCount());
+		}
+
+		uint64_t mismatchedTexelCount = 0u;
+		for (size_t i = 0; i < actual.GetTexelCount(); i++)
+		{
+			mismatchedTexelCount += actual.GetData()[i].x != expected.GetData()[i].x || actual.GetData()[i].y != expected.GetData()[i].y ? 1u : 0u;
+		}
+
+		return mismatchedTexelCount;
+	}
+
+	// Depth texels [x << mip, (x + 1) << mip) of a mip texel, the last texel of a mip reaches to the end of the depth buffer.
+	uint32_t GetCoveredEnd(uint32_t texel, uint32_t mipDim, uint32_t mip, uint32_t dim)
+	{
+		return texel + 1u == mipDim ? dim : (texel + 1u) << mip;
+	}
+
+	// Min and max over the depth texels every mip texel covers, straight from the depth buffer.
+	uint64_t CountMismatchedCoverage(const DepthTexture& depth, const std::vector<MinMaxDepthTexture>& mips)
+	{
+		uint64_t mismatchedTexelCount = 0u;
+		for (uint32_t mip = 0; mip < (uint32_t)mips.size(); mip++)
+		{
+			const MinMaxDepthTexture& mipTexture = mips[mip];
+			for (uint32_t y = 0; y < mipTexture.GetHeight(); y++)
+			{
+				for (uint32_t x = 0; x < mipTexture.GetWidth(); x++)
+				{
+					float2 expectedMinMax = float2(std::numeric_limits<float>::max(), 0.0f);
+					for (uint32_t depthY = y << mip; depthY < GetCoveredEnd(y, mipTexture.GetHeight(), mip, depth.GetHeight()); depthY++)
+					{
+						for (uint32_t depthX = x << mip; depthX < GetCoveredEnd(x, mipTexture.GetWidth(), mip, depth.GetWidth()); depthX++)
+						{
+							expectedMinMax.x = (std::min)(expectedMinMax.x, depth.At(depthX, depthY));
+							expectedMinMax.y = (std::max)(expectedMinMax.y, depth.At(depthX, depthY));
+						}
+					}
+
+					const float2 minMax = mipTexture.At(x, y);
+					mismatchedTexelCount += minMax.x != expectedMinMax.x || minMax.y != expectedMinMax.y ? 1u : 0u;
+				}
+			}
+		}
+
+		return mismatchedTexelCount;
+	}
+}
+
+CPUREF_TEST(HiZMipDims)
+{
+	CPUREF_CHECK_EQ(GetHiZMipCount(1u, 1u), 1u);
+	CPUREF_CHECK_EQ(GetHiZMipCount(64u, 64u), 7u);
+	CPUREF_CHECK_EQ(GetHiZMipCount(65u, 63u), 7u);
+	CPUREF_CHECK_EQ(GetHiZMipCount(1920u, 1080u), 11u);
+
+	CPUREF_CHECK_EQ(GetHiZMipDim(1080u, 3u), 135u);
+	CPUREF_CHECK_EQ(GetHiZMipDim(1080u, 4u), 67u);
+	CPUREF_CHECK_EQ(GetHiZMipDim(1080u, 10u), 1u);
+	CPUREF_CHECK_EQ(GetHiZMipDim(77u, 10u), 1u);
+}
+
+// Odd sizes are where the builds can differ, as the odd size rule has to carry across the tiles of the single pass build.
+CPUREF_TEST(HiZSinglePassMatchesPerMip)
+{
+	const uint32_t dims[][2] = {
+		{ 1u, 1u }, { 1u, 77u }, { 77u, 1u }, { 3u, 5u },
+		{ 63u, 65u }, { 64u, 64u }, { 65u, 63u }, { 127u, 129u },
+		{ 191u, 67u }, { 321u, 181u }, { 1023u, 575u }, { 1920u, 1080u }
+	};
+
+	for (uint32_t i = 0; i < (uint32_t)std::size(dims); i++)
+	{
+		DepthTexture depth(dims[i][0], dims[i][1]);
+		FillRandomDepth(i + 1u, depth);
+
+		std::vector<MinMaxDepthTexture> perMipMips;
+		std::vector<MinMaxDepthTexture> singlePassMips;
+		std::vector<MinMaxDepthTexture> shaderTileMips;
+		BuildHiZPyramidPerMip(depth, perMipMips);
+		BuildHiZPyramid(depth, singlePassMips);
+		BuildHiZPyramid(depth, shaderTileMips, HiZShaderTileSize);
+
+		const uint32_t mipCount = GetHiZMipCount(depth.GetWidth(), depth.GetHeight());
+		CPUREF_CHECK_EQ((uint32_t)perMipMips.size(), mipCount);
+		CPUREF_CHECK_EQ((uint32_t)singlePassMips.size(), mipCount);
+		CPUREF_CHECK_EQ((uint32_t)shaderTileMips.size(), mipCount);
+		if (perMipMips.size() != mipCount || singlePassMips.size() != mipCount || shaderTileMips.size() != mipCount)
+		{
+			continue;
+		}
+
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			CPUREF_CHECK_EQ(perMipMips[mip].GetWidth(), GetHiZMipDim(depth.GetWidth(), mip));
+			CPUREF_CHECK_EQ(perMipMips[mip].GetHeight(), GetHiZMipDim(depth.GetHeight(), mip));
+			CPUREF_CHECK_EQ(CountMismatchedTexels(singlePassMips[mip], perMipMips[mip]), 0ull);
+			CPUREF_CHECK_EQ(CountMismatchedTexels(shaderTileMips[mip], perMipMips[mip]), 0ull);
+		}
+
+		// Every depth texel has to be covered by exactly one texel of each mip, brute forced on the sizes where that is cheap.
+		if (depth.GetTexelCount() <= 321u * 181u)
+		{
+			CPUREF_CHECK_EQ(CountMismatchedCoverage(depth, singlePassMips), 0ull);
+		}
+		else
+		{
+			const float* depthBegin = depth.GetData();
+			const float* depthEnd = depthBegin + depth.GetTexelCount();
+			const float2 lastMinMax = singlePassMips.back().At(0u, 0u);
+			CPUREF_CHECK_EQ(lastMinMax.x, *std::min_element(depthBegin, depthEnd));
+			CPUREF_CHECK_EQ(lastMinMax.y, *std::max_element(depthBegin, depthEnd));
+		}
+	}
+}
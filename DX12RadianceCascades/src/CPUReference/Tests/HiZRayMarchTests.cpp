@@ -0,0 +1,202 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "HiZRayMarch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Hit t difference allowed between the two marches, relative to the ray length.
+	constexpr float HitTTolerance = 1.0e-3f;
+	constexpr float RadianceTolerance = 1.0e-4f;
+	// Origins are moved towards the camera by this much of their distance to it.
+	constexpr float OriginBias = 1.0e-4f;
+
+	struct MarchTestRay
+	{
+		float3 origin;
+		float3 direction;
+		float tMax = 0.0f;
+	};
+
+	// Rays start on random depth buffer pixels in random directions, like the rays of the lowest cascades. Reconstructed positions end up
+	// on either side of the surface, which the tracer would hit from behind at random. In front of it, the tracer hits it exactly for the
+	// rays that point into it.
+	std::vector<MarchTestRay> GenerateRays(uint32_t rayCount, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		TestRandom random(rayCount);
+		std::vector<MarchTestRay> rays;
+		while (rays.size() < rayCount)
+		{
+			const uint32_t x = random.NextUint() % depth.GetWidth();
+			const uint32_t y = random.NextUint() % depth.GetHeight();
+			if (depth.At(x, y) <= 0.0f)
+			{
+				continue;
+			}
+
+			// Uniform on the sphere, like the rays of a probe.
+			const float cosTheta = random.NextFloat(-1.0f, 1.0f);
+			const float sinTheta = std::sqrt((std::max)(1.0f - cosTheta * cosTheta, 0.0f));
+			const float phi = random.NextFloat(0.0f, 2.0f * Pi);
+
+			const float3 surfacePos = camera.WorldPosFromDepth(depth.At(x, y), float2((x + 0.5f) / depth.GetWidth(), (y + 0.5f) / depth.GetHeight()));
+
+			MarchTestRay ray;
+			ray.origin = surfacePos + (camera.GetPosition() - surfacePos) * OriginBias;
+			ray.direction = float3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+			ray.tMax = random.NextFloat(0.5f, 10.0f);
+			rays.push_back(ray);
+		}
+
+		return rays;
+	}
+
+	bool IsSameRadiance(const float3& a, const float3& b)
+	{
+		const float3 difference = abs(a - b);
+		return (std::max)((std::max)(difference.x, difference.y), difference.z) <= RadianceTolerance;
+	}
+}
+
+// MarchHiZ() has to agree with MarchBruteForce() on every ray it does not run out of steps on. Against the tracer the march is only an
+// approximation, as depth pixels are flat and the thickness is a guess, so only a share of mismatches is allowed there.
+CPUREF_TEST(HiZMarchMatchesBruteForce)
+{
+	ReferenceFixture fixture;
+	const uint32_t width = ReferenceFixture::Width;
+	const uint32_t height = ReferenceFixture::Height;
+
+	RadianceTexture sceneRadiance;
+	sceneRadiance.Create(width, height);
+	RenderRadiance(fixture.camera, fixture.scene, fixture.taskPool, sceneRadiance);
+
+	std::vector<MinMaxDepthTexture> hiZMips;
+	BuildHiZPyramid(fixture.depth, hiZMips);
+
+	const HiZMarchDesc marchDesc;
+	uint64_t resultCounts[HiZMarchResultCount] = {};
+	uint64_t resultMismatchCount = 0u;
+	uint64_t hitPixelMismatchCount = 0u;
+	uint64_t hitTMismatchCount = 0u;
+	uint64_t tracerMismatchCount = 0u;
+
+	for (const MarchTestRay& ray : GenerateRays(4096u, fixture.camera, fixture.depth))
+	{
+		HiZMarchRay marchRay;
+		if (!SetupHiZMarchRay(fixture.camera, width, height, ray.origin, ray.direction, 0.0f, ray.tMax, marchRay))
+		{
+			continue;
+		}
+
+		const HiZMarchOutput hiZOutput = MarchHiZ(marchRay, hiZMips, fixture.camera, marchDesc);
+		const HiZMarchOutput bruteForceOutput = MarchBruteForce(marchRay, fixture.depth, fixture.camera, marchDesc);
+		resultCounts[hiZOutput.result]++;
+
+		if (hiZOutput.result != HiZMarchResultOutOfSteps)
+		{
+			if (hiZOutput.result != bruteForceOutput.result)
+			{
+				resultMismatchCount++;
+			}
+			else if (hiZOutput.result == HiZMarchResultHit)
+			{
+				hitPixelMismatchCount += hiZOutput.hitPixel.x != bruteForceOutput.hitPixel.x || hiZOutput.hitPixel.y != bruteForceOutput.hitPixel.y ? 1u : 0u;
+				hitTMismatchCount += std::abs(hiZOutput.hitT - bruteForceOutput.hitT) > HitTTolerance * ray.tMax ? 1u : 0u;
+			}
+		}
+
+		// Misses the tracer hits something on, or hits where it misses or hits something with a different radiance than the pixel.
+		RayHit tracerHit;
+		const bool isTracerHit = fixture.scene.TraceClosest(ray.origin, ray.direction, 0.0f, ray.tMax, tracerHit);
+		if (hiZOutput.result == HiZMarchResultMiss)
+		{
+			tracerMismatchCount += isTracerHit ? 1u : 0u;
+		}
+		else if (hiZOutput.result == HiZMarchResultHit)
+		{
+			const float4 pixelRadiance = sceneRadiance.Load(hiZOutput.hitPixel);
+			tracerMismatchCount += !isTracerHit || !IsSameRadiance(float3(pixelRadiance.x, pixelRadiance.y, pixelRadiance.z), tracerHit.emissive) ? 1u : 0u;
+		}
+	}
+
+	CPUREF_CHECK_EQ(resultMismatchCount, 0ull);
+	CPUREF_CHECK_EQ(hitPixelMismatchCount, 0ull);
+	CPUREF_CHECK_EQ(hitTMismatchCount, 0ull);
+
+	const uint64_t resolvedCount = resultCounts[HiZMarchResultMiss] + resultCounts[HiZMarchResultHit];
+	CPUREF_CHECK(resultCounts[HiZMarchResultHit] > 0u && resultCounts[HiZMarchResultMiss] > 0u);
+	CPUREF_CHECK(tracerMismatchCount * 20u < resolvedCount);
+}
+
+// Rays the march resolves read the radiance of the depth buffer pixels instead of being traced, the rest fall back to the tracer.
+CPUREF_TEST(HiZMarchPipeline)
+{
+	ReferenceFixture fixture;
+
+	RadianceTexture sceneRadiance;
+	sceneRadiance.Create(ReferenceFixture::Width, ReferenceFixture::Height);
+	RenderRadiance(fixture.camera, fixture.scene, fixture.taskPool, sceneRadiance);
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 3u;
+
+	ReferencePipeline tracedPipeline(fixture.taskPool);
+	tracedPipeline.Generate(settings);
+	tracedPipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+
+	// Without marched cascades the scene radiance is never read.
+	{
+		ReferencePipeline pipeline(fixture.taskPool);
+		pipeline.Generate(settings);
+		pipeline.SetSceneRadiance(&sceneRadiance);
+		CPUREF_CHECK(!pipeline.UsesHiZMarch());
+
+		pipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+		CheckSameOutputs(pipeline, tracedPipeline);
+	}
+
+	settings.hiZMarchCascadeCount = 1u;
+
+	ReferencePipeline pipeline(fixture.taskPool);
+	pipeline.Generate(settings);
+	pipeline.SetSceneRadiance(&sceneRadiance);
+	CPUREF_CHECK(pipeline.UsesHiZMarch());
+	pipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+
+	uint64_t resolvedCount = 0u;
+	uint64_t fallbackCount = 0u;
+	for (uint32_t cascadeIndex = 0; cascadeIndex < pipeline.GetLayout().GetCascadeCount(); cascadeIndex++)
+	{
+		for (uint32_t resultIndex = 0; resultIndex < HiZMarchResultCount; resultIndex++)
+		{
+			const HiZMarchResult marchResult = (HiZMarchResult)resultIndex;
+			const uint64_t count = pipeline.GetHiZMarchCount(cascadeIndex, marchResult);
+			CPUREF_CHECK(cascadeIndex < settings.hiZMarchCascadeCount || count == 0u);
+
+			resolvedCount += IsHiZMarchResolved(marchResult) ? count : 0u;
+			fallbackCount += IsHiZMarchResolved(marchResult) ? 0u : count;
+		}
+	}
+
+	CPUREF_CHECK(resolvedCount > 0u && fallbackCount > 0u);
+	CPUREF_CHECK_EQ(resolvedCount + fallbackCount, pipeline.GetTracedRayCount(0u));
+
+	// Only rays of cascade 0 are marched, which are short and mostly hit the surfaces on screen.
+	const RadianceTexture& marchedResult = pipeline.GetCoalescedResult();
+	const RadianceTexture& tracedResult = tracedPipeline.GetCoalescedResult();
+	double differenceSum = 0.0;
+	for (size_t i = 0; i < marchedResult.GetTexelCount(); i++)
+	{
+		const float4 difference = marchedResult.GetData()[i] - tracedResult.GetData()[i];
+		differenceSum += (std::max)((std::max)(std::abs(difference.x), std::abs(difference.y)), std::abs(difference.z));
+	}
+
+	CPUREF_CHECK(differenceSum / double(marchedResult.GetTexelCount()) < 0.05);
+}
@@ -0,0 +1,177 @@
+#include "TestFramework.h"
+
+#include "InstanceMasks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Half the size of the scene box, which is centered on the origin.
+	constexpr float SceneExtent = 1000.0f;
+	// Intervals like RadianceCascadeManager3D with its default settings.
+	constexpr float RayLength0 = 5.0f;
+	constexpr float RayScalingFactor = 4.0f;
+
+	float3 NextRandomPoint(TestRandom& random, const BoxBounds& box)
+	{
+		const float3 t = float3(random.NextFloat(), random.NextFloat(), random.NextFloat());
+		return box.minPos + (box.maxPos - box.minPos) * t;
+	}
+
+	float3 NextRandomDirection(TestRandom& random)
+	{
+		const float z = random.NextFloat(-1.0f, 1.0f);
+		const float phi = random.NextFloat(0.0f, 2.0f * Pi);
+		const float r = std::sqrt((std::max)(1.0f - z * z, 0.0f));
+		return float3(r * std::cos(phi), r * std::sin(phi), z);
+	}
+
+	// If any part of the ray between tMin and tMax is inside the sphere.
+	bool IsSegmentInSphere(const float3& origin, const float3& direction, float tMin, float tMax, const SphereBounds& sphere)
+	{
+		const float3 toCenter = sphere.center - origin;
+		const float tCenter = dot(toCenter, direction);
+		const float distanceSq = dot(toCenter, toCenter) - tCenter * tCenter;
+		const float radiusSq = sphere.radius * sphere.radius;
+		if (distanceSq > radiusSq)
+		{
+			return false;
+		}
+
+		const float halfChord = std::sqrt(radiusSq - distanceSq);
+		return tCenter - halfChord <= tMax && tCenter + halfChord >= tMin;
+	}
+
+	// Spheres of random size, a few of them 10 times larger and a few emissive, are spread over the scene box with a smaller probe volume
+	// inside it. Rays are shot from probes in the volume, its corners included, for every cascade interval and tested against every sphere.
+	void CheckMasks(uint32_t instanceCount, float probeVolumeFraction, uint32_t cascadeCount, float smallInstanceRatio)
+	{
+		TestRandom random(instanceCount + cascadeCount);
+
+		BoxBounds sceneBox;
+		sceneBox.AddPoint(float3(-SceneExtent));
+		sceneBox.AddPoint(float3(SceneExtent));
+
+		const float3 probeVolumeSize = (sceneBox.maxPos - sceneBox.minPos) * probeVolumeFraction;
+		BoxBounds probeVolume;
+		probeVolume.AddPoint(sceneBox.minPos + (sceneBox.maxPos - sceneBox.minPos - probeVolumeSize) * float3(random.NextFloat(), random.NextFloat(), random.NextFloat()));
+		probeVolume.AddPoint(probeVolume.minPos + probeVolumeSize);
+
+		std::vector<InstanceMaskInput> instances(instanceCount);
+		for (InstanceMaskInput& instance : instances)
+		{
+			const float maxRadius = random.NextFloat() < 0.05f ? 500.0f : 50.0f;
+			instance.bounds.center = NextRandomPoint(random, sceneBox);
+			instance.bounds.radius = random.NextFloat(1.0f, maxRadius);
+			instance.isEmissive = random.NextFloat() < 0.1f;
+		}
+
+		std::vector<CascadeInterval> intervals(cascadeCount);
+		for (uint32_t cascadeIndex = 0; cascadeIndex < cascadeCount; cascadeIndex++)
+		{
+			intervals[cascadeIndex].startT = GeometricSeriesSum(RayLength0, RayScalingFactor, (float)cascadeIndex);
+			intervals[cascadeIndex].range = RayLength0 * std::pow(RayScalingFactor, (float)cascadeIndex);
+		}
+
+		InstanceMaskDesc maskDesc;
+		maskDesc.smallInstanceRatio = smallInstanceRatio;
+		std::vector<uint8_t> masks;
+		ComputeInstanceMasks(instances, probeVolume, intervals, maskDesc, masks);
+
+		InstanceMaskDesc distanceOnlyDesc = maskDesc;
+		distanceOnlyDesc.smallInstanceRatio = 0.0f;
+		std::vector<uint8_t> distanceMasks;
+		ComputeInstanceMasks(instances, probeVolume, intervals, distanceOnlyDesc, distanceMasks);
+
+		// Masks have the always bit, no bits the distance rule does not set, and are the same as it for emissive instances.
+		uint64_t maskErrorCount = 0u;
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const bool isMaskValid = (masks[i] & InstanceMaskAlwaysBit) != 0u && (masks[i] & ~distanceMasks[i]) == 0u && (!instances[i].isEmissive || masks[i] == distanceMasks[i]);
+			maskErrorCount += isMaskValid ? 0u : 1u;
+		}
+
+		std::vector<float3> probes;
+		for (uint32_t corner = 0; corner < 8u; corner++)
+		{
+			probes.push_back(float3(
+				(corner & 1u) != 0u ? probeVolume.maxPos.x : probeVolume.minPos.x,
+				(corner & 2u) != 0u ? probeVolume.maxPos.y : probeVolume.minPos.y,
+				(corner & 4u) != 0u ? probeVolume.maxPos.z : probeVolume.minPos.z));
+		}
+
+		while (probes.size() < 16u)
+		{
+			probes.push_back(NextRandomPoint(random, probeVolume));
+		}
+
+		// Every probe is a point of the volume, so its distance to an instance center has to be in the range of the volume.
+		uint64_t distanceErrorCount = 0u;
+		for (const InstanceMaskInput& instance : instances)
+		{
+			const float minDistance = GetMinDistance(probeVolume, instance.bounds.center);
+			const float maxDistance = GetMaxDistance(probeVolume, instance.bounds.center);
+			for (const float3& probe : probes)
+			{
+				const float distance = length(probe - instance.bounds.center);
+				distanceErrorCount += distance < minDistance - Epsilon * maxDistance || distance > maxDistance + Epsilon * maxDistance ? 1u : 0u;
+			}
+		}
+
+		// A sphere hit inside the interval of a cascade must have the cascade's bit when culling only by distance.
+		uint64_t sampledHitCount = 0u;
+		uint64_t missedHitCount = 0u;
+		for (uint32_t cascadeIndex = 0; cascadeIndex < cascadeCount; cascadeIndex++)
+		{
+			const uint8_t cascadeMask = GetCascadeInstanceMask(cascadeIndex);
+			const float tMin = intervals[cascadeIndex].startT;
+			const float tMax = tMin + intervals[cascadeIndex].range;
+
+			for (const float3& probe : probes)
+			{
+				for (uint32_t rayIndex = 0; rayIndex < 64u; rayIndex++)
+				{
+					const float3 direction = NextRandomDirection(random);
+					for (uint32_t i = 0; i < instanceCount; i++)
+					{
+						if (IsSegmentInSphere(probe, direction, tMin, tMax, instances[i].bounds))
+						{
+							sampledHitCount++;
+							missedHitCount += (distanceMasks[i] & cascadeMask) == 0u ? 1u : 0u;
+						}
+					}
+				}
+			}
+		}
+
+		CPUREF_CHECK_EQ(maskErrorCount, 0ull);
+		CPUREF_CHECK_EQ(distanceErrorCount, 0ull);
+		CPUREF_CHECK_EQ(missedHitCount, 0ull);
+		CPUREF_CHECK(sampledHitCount > 0u);
+	}
+}
+
+CPUREF_TEST(InstanceMasksKeepHits)
+{
+	for (uint32_t instanceCount : { 64u, 256u })
+	{
+		for (float probeVolumeFraction : { 0.05f, 0.5f })
+		{
+			for (uint32_t cascadeCount : { 6u, 8u })
+			{
+				for (float smallInstanceRatio : { 0.0f, 0.02f })
+				{
+					CheckMasks(instanceCount, probeVolumeFraction, cascadeCount, smallInstanceRatio);
+				}
+			}
+		}
+	}
+
+	// Probes that fill the whole scene, nothing can be culled by distance above the first cascades.
+	CheckMasks(256u, 1.0f, 6u, 0.0f);
+}
@@ -0,0 +1,190 @@
+#include "TestFramework.h"
+
+#include "InstanceRegistry.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	struct SceneInstance
+	{
+		uint32_t modelIndex = 0u;
+		InstanceTransform transform = {};
+		uint32_t slot = InstanceRegistry::InvalidSlot;
+		bool isMoving = false;
+	};
+
+	InstanceTransform GetTranslation(float x, float y, float z)
+	{
+		InstanceTransform transform = {};
+		transform.rows[0][0] = 1.0f;
+		transform.rows[1][1] = 1.0f;
+		transform.rows[2][2] = 1.0f;
+		transform.rows[0][3] = x;
+		transform.rows[1][3] = y;
+		transform.rows[2][3] = z;
+		return transform;
+	}
+
+	// Made up BLAS addresses, only compared and never dereferenced.
+	uint64_t GetBLASAddress(uint32_t modelIndex)
+	{
+		return 0x10000000ull + uint64_t(modelIndex) * 0x10000ull;
+	}
+
+	// Every model has as many geometries as its index + 1, the hit groups of the models follow each other.
+	uint32_t GetHitGroupOffset(uint32_t modelIndex)
+	{
+		return modelIndex * (modelIndex + 1u) / 2u;
+	}
+
+	// The scene pushes every transform every frame, a fraction of the instances moves and churnCount of them are removed and added again.
+	// After writing the dirty descs, the descs have to match encoding every slot.
+	void CheckFrames(uint32_t instanceCount, float movingFraction, uint32_t churnCount, uint32_t maxRangeGap)
+	{
+		TestRandom random(instanceCount + churnCount);
+
+		InstanceRegistry registry;
+		std::vector<SceneInstance> sceneInstances(instanceCount);
+		for (SceneInstance& sceneInstance : sceneInstances)
+		{
+			sceneInstance.modelIndex = random.NextUint() % 16u;
+			sceneInstance.transform = GetTranslation(random.NextFloat(0.0f, 1000.0f), 0.0f, random.NextFloat(0.0f, 1000.0f));
+			sceneInstance.isMoving = random.NextFloat() < movingFraction;
+			sceneInstance.slot = registry.Add(sceneInstance.transform, GetBLASAddress(sceneInstance.modelIndex), GetHitGroupOffset(sceneInstance.modelIndex));
+		}
+
+		std::vector<RaytracingInstanceDesc> descs(registry.GetSlotCount());
+		registry.WriteAllDescs(descs.data());
+		CPUREF_CHECK(!registry.HasChanges());
+
+		uint32_t movingCount = 0u;
+		for (const SceneInstance& sceneInstance : sceneInstances)
+		{
+			movingCount += sceneInstance.isMoving ? 1u : 0u;
+		}
+
+		uint64_t mismatchCount = 0u;
+		std::vector<InstanceRange> dirtyRanges;
+		for (uint32_t frameIndex = 0; frameIndex < 8u; frameIndex++)
+		{
+			for (uint32_t i = 0; i < instanceCount; i++)
+			{
+				SceneInstance& sceneInstance = sceneInstances[i];
+				if (sceneInstance.isMoving)
+				{
+					sceneInstance.transform.rows[1][3] = std::sin(float(frameIndex) * 0.1f + float(i)) + 2.0f;
+				}
+			}
+
+			for (uint32_t churnIndex = 0; churnIndex < churnCount; churnIndex++)
+			{
+				SceneInstance& sceneInstance = sceneInstances[random.NextUint() % instanceCount];
+				registry.Remove(sceneInstance.slot);
+				sceneInstance.slot = registry.Add(sceneInstance.transform, GetBLASAddress(sceneInstance.modelIndex), GetHitGroupOffset(sceneInstance.modelIndex));
+			}
+
+			// Every transform is pushed, only the ones that changed dirty their slot.
+			for (const SceneInstance& sceneInstance : sceneInstances)
+			{
+				registry.SetTransform(sceneInstance.slot, sceneInstance.transform);
+			}
+
+			// Removed slots are reused right away, so the slot count never grows.
+			CPUREF_CHECK_EQ(registry.GetSlotCount(), instanceCount);
+			CPUREF_CHECK_EQ(registry.HasActivationChanges(), churnCount > 0u);
+			if (churnCount == 0u)
+			{
+				CPUREF_CHECK_EQ(registry.GetDirtyCount(), movingCount);
+			}
+
+			registry.GetDirtyRanges(dirtyRanges, maxRangeGap);
+			uint32_t rangeSlotCount = 0u;
+			for (const InstanceRange& range : dirtyRanges)
+			{
+				rangeSlotCount += range.end - range.begin;
+			}
+
+			const uint32_t dirtyCount = registry.GetDirtyCount();
+			const uint32_t writtenDescCount = registry.WriteDirtyDescs(descs.data(), maxRangeGap);
+			CPUREF_CHECK_EQ(writtenDescCount, rangeSlotCount);
+			CPUREF_CHECK(maxRangeGap > 0u ? writtenDescCount >= dirtyCount : writtenDescCount == dirtyCount);
+			CPUREF_CHECK(!registry.HasChanges());
+
+			for (uint32_t slot = 0; slot < registry.GetSlotCount(); slot++)
+			{
+				RaytracingInstanceDesc expectedDesc;
+				registry.EncodeInstanceDesc(slot, expectedDesc);
+				mismatchCount += std::memcmp(&expectedDesc, &descs[slot], sizeof(RaytracingInstanceDesc)) != 0 ? 1u : 0u;
+			}
+		}
+
+		CPUREF_CHECK_EQ(mismatchCount, 0ull);
+	}
+}
+
+CPUREF_TEST(InstanceRegistrySlots)
+{
+	InstanceRegistry registry;
+	const InstanceTransform transform = GetTranslation(1.0f, 2.0f, 3.0f);
+	for (uint32_t i = 0; i < 4u; i++)
+	{
+		CPUREF_CHECK_EQ(registry.Add(transform, GetBLASAddress(i), GetHitGroupOffset(i)), i);
+	}
+
+	std::vector<RaytracingInstanceDesc> descs(registry.GetSlotCount());
+	registry.WriteAllDescs(descs.data());
+	CPUREF_CHECK(!registry.HasChanges() && !registry.HasActivationChanges());
+
+	// Setting a field to the value it already has does not dirty the slot.
+	registry.SetTransform(1u, transform);
+	registry.SetBLAS(1u, GetBLASAddress(1u), GetHitGroupOffset(1u));
+	CPUREF_CHECK(!registry.HasChanges());
+
+	// Removed slots are written as inactive descs and the lowest one is reused first.
+	registry.Remove(2u);
+	registry.Remove(1u);
+	CPUREF_CHECK(registry.HasActivationChanges());
+	CPUREF_CHECK_EQ(registry.GetActiveCount(), 2u);
+	CPUREF_CHECK_EQ(registry.GetSlotCount(), 4u);
+	CPUREF_CHECK(!registry.IsActive(1u) && registry.IsActive(3u));
+
+	RaytracingInstanceDesc removedDesc;
+	registry.EncodeInstanceDesc(2u, removedDesc);
+	CPUREF_CHECK_EQ(removedDesc.instanceMask, 0u);
+	CPUREF_CHECK_EQ(removedDesc.accelerationStructure, 0ull);
+
+	CPUREF_CHECK_EQ(registry.Add(transform, GetBLASAddress(5u), GetHitGroupOffset(5u)), 1u);
+	CPUREF_CHECK_EQ(registry.Add(transform, GetBLASAddress(6u), GetHitGroupOffset(6u)), 2u);
+	CPUREF_CHECK_EQ(registry.Add(transform, GetBLASAddress(7u), GetHitGroupOffset(7u)), 4u);
+
+	// Slots 1, 2 and 4 are dirty, a gap of 1 joins them into one range.
+	std::vector<InstanceRange> dirtyRanges;
+	registry.GetDirtyRanges(dirtyRanges);
+	CPUREF_CHECK_EQ((uint32_t)dirtyRanges.size(), 2u);
+	registry.GetDirtyRanges(dirtyRanges, 1u);
+	CPUREF_CHECK_EQ((uint32_t)dirtyRanges.size(), 1u);
+	CPUREF_CHECK(dirtyRanges[0].begin == 1u && dirtyRanges[0].end == 5u);
+
+	descs.resize(registry.GetSlotCount());
+	CPUREF_CHECK_EQ(registry.WriteDirtyDescs(descs.data(), 1u), 4u);
+	CPUREF_CHECK(!registry.HasChanges() && !registry.HasActivationChanges());
+}
+
+CPUREF_TEST(InstanceRegistryFrames)
+{
+	for (uint32_t instanceCount : { 1000u, 3000u })
+	{
+		for (float movingFraction : { 0.0f, 0.01f, 0.1f, 1.0f })
+		{
+			CheckFrames(instanceCount, movingFraction, 0u, 0u);
+		}
+
+		CheckFrames(instanceCount, 0.01f, instanceCount / 100u, 4u);
+	}
+}
@@ -0,0 +1,200 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "IntervalEncoding.h"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Random radiance over the whole range of the formats, with the values the conversions handle separately mixed in.
+	std::vector<float4> GetTestTexels(size_t count, uint32_t seed)
+	{
+		const float specialValues[] = { 0.0f, -1.0f, 1.0e-7f, 6.0e-5f, 65504.0f, 65520.0f, 1.0e9f,
+			std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN() };
+
+		TestRandom random(seed);
+		std::vector<float4> texels(count);
+		for (float4& texel : texels)
+		{
+			float channels[4] = {};
+			for (float& channel : channels)
+			{
+				const uint32_t choice = random.NextUint() % 16u;
+				channel = choice < std::size(specialValues) ? specialValues[choice] : std::exp2(random.NextFloat(-16.0f, 16.0f));
+			}
+
+			texel = float4(channels[0], channels[1], channels[2], random.NextFloat(-0.5f, 1.5f));
+		}
+
+		return texels;
+	}
+
+	void CheckRelativeError(float decoded, float value, uint32_t mantissaBits)
+	{
+		// Half an ulp of the mantissa after rounding to nearest.
+		CPUREF_CHECK_NEAR(decoded, value, value * std::exp2(-float(mantissaBits + 1u)));
+	}
+}
+
+CPUREF_TEST(IntervalFormatSizes)
+{
+	CPUREF_CHECK_EQ(GetIntervalTexelBytes(IntervalFormatFP16), 8u);
+	CPUREF_CHECK_EQ(GetIntervalTexelBytes(IntervalFormatR11G11B10), 5u);
+	CPUREF_CHECK_EQ(GetIntervalTexelBytes(IntervalFormatRGB9E5), 5u);
+
+	CPUREF_CHECK(!HasVisibilityPlane(IntervalFormatFP16));
+	CPUREF_CHECK(HasVisibilityPlane(IntervalFormatR11G11B10));
+	CPUREF_CHECK(HasVisibilityPlane(IntervalFormatRGB9E5));
+}
+
+CPUREF_TEST(IntervalScalarEncoding)
+{
+	CPUREF_CHECK_EQ(EncodeHalf(1.0f), uint16_t(0x3C00u));
+	CPUREF_CHECK_EQ(EncodeHalf(-2.0f), uint16_t(0xC000u));
+	CPUREF_CHECK_EQ(EncodeHalf(65504.0f), uint16_t(0x7BFFu));
+	CPUREF_CHECK_EQ(EncodeHalf(1.0e9f), uint16_t(0x7BFFu));
+	CPUREF_CHECK_EQ(DecodeHalf(0x3C00u), 1.0f);
+	CPUREF_CHECK(std::isnan(DecodeHalf(EncodeHalf(std::numeric_limits<float>::quiet_NaN()))));
+
+	CPUREF_CHECK_EQ(EncodeUnorm8(0.0f), uint8_t(0u));
+	CPUREF_CHECK_EQ(EncodeUnorm8(0.5f), uint8_t(128u));
+	CPUREF_CHECK_EQ(EncodeUnorm8(1.0f), uint8_t(255u));
+	CPUREF_CHECK_EQ(EncodeUnorm8(-1.0f), uint8_t(0u));
+	CPUREF_CHECK_EQ(EncodeUnorm8(2.0f), uint8_t(255u));
+	CPUREF_CHECK_EQ(EncodeUnorm8(std::numeric_limits<float>::quiet_NaN()), uint8_t(0u));
+	for (uint32_t i = 0; i < 256u; i++)
+	{
+		CPUREF_CHECK_EQ(uint32_t(EncodeUnorm8(DecodeUnorm8(uint8_t(i)))), i);
+	}
+
+	// The unsigned formats clamp negative values to 0 and large values to their largest finite value.
+	const float3 clamped = DecodeR11G11B10(EncodeR11G11B10(float3(-1.0f, 1.0e9f, 1.0f)));
+	CPUREF_CHECK_EQ(clamped.x, 0.0f);
+	CPUREF_CHECK_EQ(clamped.y, 65024.0f);
+	CPUREF_CHECK_EQ(clamped.z, 1.0f);
+
+	const float3 clampedRGB9E5 = DecodeRGB9E5(EncodeRGB9E5(float3(-1.0f, 1.0e9f, 1.0f)));
+	CPUREF_CHECK_EQ(clampedRGB9E5.x, 0.0f);
+	CPUREF_CHECK_EQ(clampedRGB9E5.y, 65408.0f);
+	CPUREF_CHECK_EQ(clampedRGB9E5.z, 0.0f);
+}
+
+CPUREF_TEST(IntervalScalarPrecision)
+{
+	TestRandom random(3u);
+	for (uint32_t i = 0; i < 10000u; i++)
+	{
+		// Normal range of every format.
+		const float3 value(std::exp2(random.NextFloat(-14.0f, 15.0f)), std::exp2(random.NextFloat(-14.0f, 15.0f)), std::exp2(random.NextFloat(-14.0f, 15.0f)));
+
+		CheckRelativeError(DecodeHalf(EncodeHalf(value.x)), value.x, 10u);
+
+		const float3 r11g11b10 = DecodeR11G11B10(EncodeR11G11B10(value));
+		CheckRelativeError(r11g11b10.x, value.x, 6u);
+		CheckRelativeError(r11g11b10.y, value.y, 6u);
+		CheckRelativeError(r11g11b10.z, value.z, 5u);
+
+		// The shared exponent comes from the largest channel, so the error of every channel is relative to it.
+		const float maxChannel = (std::max)({ value.x, value.y, value.z });
+		const float3 rgb9e5 = DecodeRGB9E5(EncodeRGB9E5(value));
+		CPUREF_CHECK_NEAR(rgb9e5.x, value.x, maxChannel * std::exp2(-9.0f));
+		CPUREF_CHECK_NEAR(rgb9e5.y, value.y, maxChannel * std::exp2(-9.0f));
+		CPUREF_CHECK_NEAR(rgb9e5.z, value.z, maxChannel * std::exp2(-9.0f));
+	}
+}
+
+CPUREF_TEST(IntervalBatchMatchesScalar)
+{
+	// Not a multiple of the SSE2 width, so the scalar tail runs as well.
+	const std::vector<float4> texels = GetTestTexels(1027u, 5u);
+
+	for (uint32_t formatIndex = 0; formatIndex < IntervalFormatCount; formatIndex++)
+	{
+		const IntervalFormat format = (IntervalFormat)formatIndex;
+		const uint32_t colorBytes = GetIntervalColorBytes(format);
+
+		std::vector<uint8_t> color(texels.size() * colorBytes);
+		std::vector<uint8_t> visibility(texels.size());
+		EncodeIntervals(format, texels.data(), texels.size(), color.data(), visibility.data());
+
+		std::vector<float4> decoded(texels.size());
+		DecodeIntervals(format, color.data(), visibility.data(), texels.size(), decoded.data());
+
+		std::vector<float4> quantized = texels;
+		QuantizeIntervals(format, quantized.data(), quantized.size());
+
+		uint64_t colorMismatchCount = 0u;
+		uint64_t visibilityMismatchCount = 0u;
+		uint64_t decodeMismatchCount = 0u;
+		for (size_t i = 0; i < texels.size(); i++)
+		{
+			const float4& texel = texels[i];
+
+			float4 expected;
+			if (format == IntervalFormatFP16)
+			{
+				const uint16_t halves[4] = { EncodeHalf(texel.x), EncodeHalf(texel.y), EncodeHalf(texel.z), EncodeHalf(texel.w) };
+				colorMismatchCount += std::memcmp(&color[i * colorBytes], halves, sizeof(halves)) != 0 ? 1u : 0u;
+				expected = float4(DecodeHalf(halves[0]), DecodeHalf(halves[1]), DecodeHalf(halves[2]), DecodeHalf(halves[3]));
+			}
+			else
+			{
+				const uint32_t packed = format == IntervalFormatR11G11B10 ? EncodeR11G11B10(texel.rgb()) : EncodeRGB9E5(texel.rgb());
+				colorMismatchCount += std::memcmp(&color[i * colorBytes], &packed, sizeof(packed)) != 0 ? 1u : 0u;
+				visibilityMismatchCount += visibility[i] != EncodeUnorm8(texel.w) ? 1u : 0u;
+
+				const float3 rgb = format == IntervalFormatR11G11B10 ? DecodeR11G11B10(packed) : DecodeRGB9E5(packed);
+				expected = float4(rgb.x, rgb.y, rgb.z, DecodeUnorm8(EncodeUnorm8(texel.w)));
+			}
+
+			decodeMismatchCount += std::memcmp(&decoded[i], &expected, sizeof(float4)) != 0 ? 1u : 0u;
+			decodeMismatchCount += std::memcmp(&quantized[i], &expected, sizeof(float4)) != 0 ? 1u : 0u;
+		}
+
+		CPUREF_CHECK_EQ(colorMismatchCount, 0ull);
+		CPUREF_CHECK_EQ(visibilityMismatchCount, 0ull);
+		CPUREF_CHECK_EQ(decodeMismatchCount, 0ull);
+	}
+}
+
+CPUREF_TEST(QuantizedMergeStaysCloseToFP16)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 3u;
+	settings.layoutDesc.probeSpacing0 = 4u;
+	settings.quantizeIntervals = true;
+
+	RadianceTexture baselineCoalescedResult;
+	for (uint32_t formatIndex = 0; formatIndex < IntervalFormatCount; formatIndex++)
+	{
+		settings.intervalFormat = (IntervalFormat)formatIndex;
+
+		ReferencePipeline pipeline(fixture.taskPool);
+		pipeline.Generate(settings);
+		FillRandomCascadeIntervals(pipeline, 7u);
+		pipeline.RunMerge(fixture.camera, fixture.depth);
+		if (!pipeline.UsesFusedMergeCoalesce())
+		{
+			pipeline.RunCoalesce();
+		}
+
+		if (settings.intervalFormat == IntervalFormatFP16)
+		{
+			baselineCoalescedResult = pipeline.GetCoalescedResult();
+			CPUREF_CHECK(std::isinf(ComputePSNR(baselineCoalescedResult.GetData(), baselineCoalescedResult.GetData(), baselineCoalescedResult.GetTexelCount())));
+			continue;
+		}
+
+		// The packed formats keep 5 to 9 mantissa bits, well above what banding in the coalesced result would need.
+		const double coalescedPSNR = ComputePSNR(baselineCoalescedResult.GetData(), pipeline.GetCoalescedResult().GetData(), baselineCoalescedResult.GetTexelCount());
+		CPUREF_CHECK(coalescedPSNR > 40.0);
+	}
+}
@@ -0,0 +1,114 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "CascadeLayout.h"
+#include "IntervalEncoding.h"
+#include "MultiViewReferencePipeline.h"
+
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Camera of CreateDefaultScene().
+	const float3 CenterEye = float3(0.0f, 7.0f, 18.0f);
+	const float3 CenterTarget = float3(0.0f, 1.0f, -4.0f);
+	constexpr float VerticalFov = Pi / 3.0f;
+
+	ReferenceView RenderView(const float3& eye, const float3& target, float verticalFov, ReferenceFixture& fixture)
+	{
+		ReferenceView view;
+		view.camera.SetLookAt(eye, target, float3(0.0f, 1.0f, 0.0f));
+		view.camera.SetLens(verticalFov, float(ReferenceFixture::Height) / float(ReferenceFixture::Width), 1.0f, 1000.0f);
+		view.depth.Create(ReferenceFixture::Width, ReferenceFixture::Height);
+		RenderDepth(view.camera, fixture.scene, fixture.taskPool, view.depth);
+		return view;
+	}
+
+	// Both views are compared as one image.
+	double MeasureViewsPSNR(const MultiViewReferencePipeline& actual, const MultiViewReferencePipeline& expected)
+	{
+		std::vector<float4> referenceTexels;
+		std::vector<float4> testTexels;
+		for (uint32_t i = 0; i < actual.GetViewCount(); i++)
+		{
+			const RadianceTexture& reference = expected.GetCoalescedResult(i);
+			const RadianceTexture& test = actual.GetCoalescedResult(i);
+			referenceTexels.insert(referenceTexels.end(), reference.GetData(), reference.GetData() + reference.GetTexelCount());
+			testTexels.insert(testTexels.end(), test.GetData(), test.GetData() + test.GetTexelCount());
+		}
+
+		return ComputePSNR(referenceTexels.data(), testTexels.data(), referenceTexels.size());
+	}
+
+	// Traced rays with the cascades from sharedCascadeBegin up shared against every view tracing all of them, from the ray counts of
+	// the layout. The shared view has the resolution of the other views. Gather filtering skips a few texels, so the traced ratio is close.
+	double GetExpectedTracedRayRatio(const CascadeLayoutDesc& layoutDesc, uint32_t viewCount, uint32_t sharedCascadeBegin)
+	{
+		CascadeLayout layout;
+		layout.Generate(layoutDesc);
+
+		uint64_t viewRayCount = 0u;
+		uint64_t sharedRayCount = 0u;
+		for (uint32_t i = 0; i < layout.GetCascadeCount(); i++)
+		{
+			(i < sharedCascadeBegin ? viewRayCount : sharedRayCount) += layout.GetTotalRays(i);
+		}
+
+		return double(viewCount * viewRayCount + sharedRayCount) / double(viewCount * (viewRayCount + sharedRayCount));
+	}
+}
+
+// A stereo pair around the center camera, which with a wider field of view is the shared view. Sharing the upper cascades has to trace
+// the fewer rays the layout predicts than every view running the whole pipeline, while staying close to it.
+CPUREF_TEST(MultiViewSharedCascades)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 4u;
+	settings.layoutDesc.raysPerProbe0 = 4u;
+	settings.layoutDesc.probeSpacing0 = 4u;
+
+	// Both views look parallel to the center camera, like the eyes of a headset.
+	const float3 right = normalize(cross(normalize(CenterTarget - CenterEye), float3(0.0f, 1.0f, 0.0f)));
+	const float3 offset = right * 0.25f;
+
+	const ReferenceView sharedView = RenderView(CenterEye, CenterTarget, VerticalFov * 1.1f, fixture);
+	std::vector<ReferenceView> views;
+	views.push_back(RenderView(CenterEye - offset, CenterTarget - offset, VerticalFov, fixture));
+	views.push_back(RenderView(CenterEye + offset, CenterTarget + offset, VerticalFov, fixture));
+
+	// A begin past the last cascade shares nothing, every view runs the whole pipeline on its own.
+	MultiViewReferencePipeline independentPipeline(fixture.taskPool);
+	independentPipeline.Generate(settings, (uint32_t)views.size(), UINT32_MAX);
+	CPUREF_CHECK(!independentPipeline.IsSharingCascades());
+	independentPipeline.Run(fixture.scene, sharedView, views);
+
+	for (uint32_t i = 0; i < (uint32_t)views.size(); i++)
+	{
+		ReferencePipeline viewPipeline(fixture.taskPool);
+		viewPipeline.Generate(settings);
+		viewPipeline.Run(fixture.scene, views[i].camera, views[i].depth);
+		CPUREF_CHECK_EQ(CountMismatchedTexels(independentPipeline.GetCoalescedResult(i), viewPipeline.GetCoalescedResult()), 0ull);
+	}
+
+	for (uint32_t sharedCascadeBegin : { 2u, 3u })
+	{
+		MultiViewReferencePipeline pipeline(fixture.taskPool);
+		pipeline.Generate(settings, (uint32_t)views.size(), sharedCascadeBegin);
+		CPUREF_CHECK(pipeline.IsSharingCascades());
+		CPUREF_CHECK_EQ(pipeline.GetSharedCascadeBegin(), sharedCascadeBegin);
+		pipeline.Run(fixture.scene, sharedView, views);
+
+		CPUREF_CHECK(pipeline.GetSharedTracedRayCount() > 0u);
+		CPUREF_CHECK(pipeline.GetTracedRayCount() < independentPipeline.GetTracedRayCount());
+
+		// About 0.76 of the rays when sharing from cascade 2 and 0.88 from cascade 3.
+		const double tracedRayRatio = double(pipeline.GetTracedRayCount()) / double(independentPipeline.GetTracedRayCount());
+		CPUREF_CHECK_NEAR(tracedRayRatio, GetExpectedTracedRayRatio(settings.layoutDesc, (uint32_t)views.size(), sharedCascadeBegin), 0.02);
+		CPUREF_CHECK(MeasureViewsPSNR(pipeline, independentPipeline) > 40.0);
+	}
+}
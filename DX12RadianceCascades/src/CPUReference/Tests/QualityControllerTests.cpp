@@ -0,0 +1,217 @@
+#include "TestFramework.h"
+
+#include "QualityController.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Share of the frame time of level 0 spent gathering, the rest is merging. Only the gather depends on the ray length.
+	constexpr float GatherShare = 0.7f;
+	// Part of the cost of a cascade that is left when it is reprojected instead of gathered.
+	constexpr float ReprojectCost = 0.05f;
+	// Part of the gather cost of an upper cascade that is left with gather filtering.
+	constexpr float GatherFilterCost = 0.6f;
+
+	constexpr uint32_t TraceFrameCount = 2400u;
+	constexpr uint32_t StepStart = TraceFrameCount / 4u;
+	constexpr uint32_t StepEnd = TraceFrameCount * 3u / 4u;
+	constexpr uint32_t SpikeInterval = 200u;
+	constexpr uint32_t SpikeLength = 5u;
+
+	enum TraceType : uint32_t
+	{
+		TraceSteady = 0, // Constant scene cost.
+		TraceStep, // Scene cost doubles between StepStart and StepEnd, like walking into a busy part of the scene.
+		TraceSpikes, // Short spikes to double the cost, which should not cause static steps.
+		TraceRamp, // Scene cost doubles slowly over the whole trace.
+	};
+
+	struct TraceResult
+	{
+		// Over the frames after the first settle, unsmoothed.
+		float averageMs = 0.0f;
+		uint32_t levelChangeCount = 0u;
+		uint32_t staticChangeCount = 0u;
+		uint32_t finalStaticStep = 0u;
+		// Frames from StepStart to the last change of settings before StepEnd.
+		uint32_t stepRecoveryFrameCount = 0u;
+	};
+
+	// Six cascades, staggered updates and static steps from 64 rays at a probe spacing of 2 down to 4 rays at a spacing of 4.
+	QualityControllerDesc GetControllerDesc()
+	{
+		QualityControllerDesc desc;
+		desc.budgetMs = 4.0f;
+		desc.maxKnobs.useGatherFiltering = true;
+		desc.maxKnobs.updatePeriodLog2 = 0u;
+		desc.maxKnobs.rayLength0 = 5.0f;
+		desc.maxKnobs.activeCascadeCount = 6u;
+		desc.canStaggerUpdates = true;
+		desc.staticSteps = { { 64u, 2u }, { 36u, 2u }, { 16u, 2u }, { 16u, 3u }, { 4u, 2u }, { 4u, 4u } };
+		return desc;
+	}
+
+	// The defaults of the app, 16 rays at a probe spacing of 2.
+	constexpr uint32_t StartStaticStep = 2u;
+
+	// 1 at 16 rays per probe with a probe spacing of 2, every cascade active, gathered every frame without gather filtering at full ray length.
+	float GetRelativeCost(const QualityControllerDesc& desc, const QualityKnobs& knobs, const QualityStaticParams& staticParams)
+	{
+		// Every cascade traces about as many rays as cascade 0, which scales with the rays and probes of cascade 0.
+		const float staticCost = (staticParams.raysPerProbe0 / 16.0f) * (4.0f / float(staticParams.probeSpacing0 * staticParams.probeSpacing0));
+		const float rayLengthScale = std::sqrt(knobs.rayLength0 / desc.maxKnobs.rayLength0);
+
+		float knobCost = 0.0f;
+		for (uint32_t i = 0; i < knobs.activeCascadeCount; i++)
+		{
+			float gatherCost = GatherShare * rayLengthScale;
+			if (i > 0u)
+			{
+				const float refreshPeriod = float(1u << (std::min)(i, knobs.updatePeriodLog2));
+				gatherCost = gatherCost / refreshPeriod + (refreshPeriod > 1.0f ? ReprojectCost : 0.0f);
+				gatherCost *= knobs.useGatherFiltering ? GatherFilterCost : 1.0f;
+			}
+
+			knobCost += (gatherCost + (1.0f - GatherShare)) / desc.maxKnobs.activeCascadeCount;
+		}
+
+		return staticCost * knobCost;
+	}
+
+	float GetSceneScale(TraceType type, uint32_t frame)
+	{
+		switch (type)
+		{
+		case TraceStep: return frame >= StepStart && frame < StepEnd ? 2.0f : 1.0f;
+		case TraceSpikes: return frame % SpikeInterval < SpikeLength && frame >= SpikeInterval ? 2.0f : 1.0f;
+		case TraceRamp: return 1.0f + float(frame) / float(TraceFrameCount - 1u);
+		default: return 1.0f;
+		}
+	}
+
+	// Frame times are the scene cost of the trace scaled by the cost of the current settings, with uniform noise of +-noiseFraction.
+	TraceResult RunTrace(TraceType type, float baseMs, float noiseFraction)
+	{
+		const QualityControllerDesc desc = GetControllerDesc();
+		QualityController controller;
+		controller.SetDesc(desc, StartStaticStep);
+
+		TestRandom random(2891336453u);
+		TraceResult result;
+		double msSum = 0.0;
+		const uint32_t measureStart = desc.settleFrameCount * 2u;
+
+		for (uint32_t frame = 0; frame < TraceFrameCount; frame++)
+		{
+			const float noise = random.NextFloat(-1.0f, 1.0f);
+			const float cost = GetRelativeCost(desc, controller.GetKnobs(), controller.GetStaticParams());
+			const float frameMs = baseMs * GetSceneScale(type, frame) * cost * (1.0f + noiseFraction * noise);
+			msSum += frame >= measureStart ? frameMs : 0.0f;
+
+			const QualityUpdate update = controller.Update(frameMs * GatherShare, frameMs * (1.0f - GatherShare));
+			result.levelChangeCount += update.knobsChanged ? 1u : 0u;
+			result.staticChangeCount += update.staticParamsChanged ? 1u : 0u;
+
+			if (type == TraceStep && frame >= StepStart && frame < StepEnd && (update.knobsChanged || update.staticParamsChanged))
+			{
+				result.stepRecoveryFrameCount = frame + 1u - StepStart;
+			}
+		}
+
+		result.averageMs = float(msSum / (TraceFrameCount - measureStart));
+		result.finalStaticStep = controller.GetStaticStep();
+		return result;
+	}
+}
+
+CPUREF_TEST(QualityControllerLevels)
+{
+	const QualityControllerDesc desc = GetControllerDesc();
+	QualityController controller;
+	controller.SetDesc(desc, StartStaticStep);
+
+	CPUREF_CHECK_EQ(controller.GetLevel(), 0u);
+	CPUREF_CHECK(controller.GetLevelCount() > 1u);
+	CPUREF_CHECK_EQ(controller.GetStaticStep(), StartStaticStep);
+	CPUREF_CHECK_EQ(controller.GetKnobs().activeCascadeCount, desc.maxKnobs.activeCascadeCount);
+	CPUREF_CHECK_EQ(controller.GetKnobs().rayLength0, desc.maxKnobs.rayLength0);
+
+	// Inside the gap between the margins nothing changes.
+	for (uint32_t frame = 0; frame < 1000u; frame++)
+	{
+		const QualityUpdate update = controller.Update(desc.budgetMs * 0.9f * GatherShare, desc.budgetMs * 0.9f * (1.0f - GatherShare));
+		CPUREF_CHECK(!update.knobsChanged && !update.staticParamsChanged);
+	}
+
+	// Far over budget, every level is cheaper than the one before and the level only moves down.
+	float previousCost = GetRelativeCost(desc, controller.GetKnobs(), controller.GetStaticParams());
+	uint32_t previousLevel = controller.GetLevel();
+	for (uint32_t frame = 0; frame < 500u && controller.GetLevel() + 1u < controller.GetLevelCount(); frame++)
+	{
+		const QualityUpdate update = controller.Update(desc.budgetMs * 4.0f, 0.0f);
+		CPUREF_CHECK(!update.staticParamsChanged);
+		if (update.knobsChanged)
+		{
+			const float cost = GetRelativeCost(desc, controller.GetKnobs(), controller.GetStaticParams());
+			CPUREF_CHECK(cost < previousCost);
+			CPUREF_CHECK_EQ(controller.GetLevel(), previousLevel + 1u);
+			previousCost = cost;
+			previousLevel = controller.GetLevel();
+		}
+	}
+
+	CPUREF_CHECK_EQ(controller.GetLevel(), controller.GetLevelCount() - 1u);
+	CPUREF_CHECK(controller.GetKnobs().rayLength0 >= desc.minRayLength0);
+	CPUREF_CHECK(controller.GetKnobs().activeCascadeCount >= desc.minActiveCascadeCount);
+
+	// Only with every runtime setting at its limit does it fall back to the next cheaper static step.
+	uint32_t framesToStaticChange = 0u;
+	while (framesToStaticChange < 1000u && !controller.Update(desc.budgetMs * 4.0f, 0.0f).staticParamsChanged)
+	{
+		framesToStaticChange++;
+	}
+
+	CPUREF_CHECK(framesToStaticChange + 1u >= desc.staticChangeFrameCount);
+	CPUREF_CHECK(framesToStaticChange < desc.staticChangeFrameCount + desc.settleFrameCount * 2u);
+	CPUREF_CHECK_EQ(controller.GetStaticStep(), StartStaticStep + 1u);
+}
+
+CPUREF_TEST(QualityControllerTraces)
+{
+	const QualityControllerDesc desc = GetControllerDesc();
+	const uint32_t maxStaticChangeCount = TraceFrameCount / desc.staticCooldownFrameCount;
+
+	for (float baseMs : { 2.0f, 4.0f, 8.0f })
+	{
+		const TraceResult steady = RunTrace(TraceSteady, baseMs, 0.1f);
+		const TraceResult step = RunTrace(TraceStep, baseMs, 0.1f);
+		const TraceResult spikes = RunTrace(TraceSpikes, baseMs, 0.1f);
+		const TraceResult ramp = RunTrace(TraceRamp, baseMs, 0.1f);
+
+		for (const TraceResult* result : { &steady, &step, &spikes, &ramp })
+		{
+			CPUREF_CHECK(result->averageMs <= desc.budgetMs);
+			CPUREF_CHECK(result->staticChangeCount <= maxStaticChangeCount);
+		}
+
+		// Spikes are absorbed by the runtime settings, the cascades are only regenerated where the steady trace does as well.
+		CPUREF_CHECK_EQ(spikes.staticChangeCount, steady.staticChangeCount);
+
+		// The step is over budget at every start, the controller has to have settled well before it ends.
+		CPUREF_CHECK(step.stepRecoveryFrameCount > 0u);
+		CPUREF_CHECK(step.stepRecoveryFrameCount < StepEnd - StepStart);
+	}
+
+	// Half the budget at the start leaves room for more rays.
+	CPUREF_CHECK(RunTrace(TraceSteady, 2.0f, 0.1f).finalStaticStep < StartStaticStep);
+
+	// Noise wider than the gap between the margins, around a time in budget, must not make the levels flip back and forth.
+	const TraceResult noisy = RunTrace(TraceSteady, 4.0f, 0.3f);
+	CPUREF_CHECK_EQ(noisy.levelChangeCount, 0u);
+	CPUREF_CHECK_EQ(noisy.staticChangeCount, 0u);
+}
@@ -0,0 +1,347 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "RadianceHashCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	constexpr uint32_t NoFrame = UINT32_MAX;
+	constexpr uint32_t AmbiguousCell = UINT32_MAX;
+	// Tasks per thread, so that threads finishing early steal work and the operations of different tasks interleave.
+	constexpr uint32_t TasksPerThread = 4u;
+
+	struct CacheCell
+	{
+		RadianceCacheKey key;
+		float3 radiance;
+	};
+
+	struct StressDesc
+	{
+		uint32_t capacity = 1u << 12;
+		// Cells cycled through by the sliding window. Every sample of a cell has the same radiance, which is unique to that cell.
+		uint32_t cellCount = 1u << 13;
+		// Cells touched per frame, the window moves by cellStride every frame.
+		uint32_t activeCellCount = 1u << 10;
+		uint32_t cellStride = 1u << 8;
+		uint32_t operationsPerFrame = 1u << 14;
+		// Share of the operations that are lookups, the rest are accumulates.
+		float lookupFraction = 0.5f;
+		uint32_t frameCount = 8u;
+	};
+
+	RadianceCacheInfo GetCacheInfo(uint32_t capacity)
+	{
+		RadianceCacheInfo info = {};
+		info.capacity = capacity;
+		info.maxAge = 2u;
+		info.minSampleCount = 4u;
+		info.cellSize0 = 1.0f;
+		info.cellScalingFactor = 2.0f;
+		return info;
+	}
+
+	// Cells of three cascades on a grid around the origin, so that negative cells and the cascade in the hash are covered.
+	std::vector<CacheCell> CreateCacheCells(const RadianceHashCache& cache, uint32_t cellCount)
+	{
+		std::vector<CacheCell> cells(cellCount);
+		for (uint32_t i = 0; i < cellCount; i++)
+		{
+			const uint32_t cascadeIndex = i % 3u;
+			const uint32_t gridIndex = i / 3u;
+			const float cellSize = GetRadianceCacheCellSize(cache.GetInfo(), cascadeIndex);
+
+			const float3 cellCenter = float3(
+				float(int32_t(gridIndex % 32u) - 16) + 0.5f,
+				float(int32_t((gridIndex / 32u) % 32u) - 16) + 0.5f,
+				float(int32_t(gridIndex / 1024u) - 4) + 0.5f
+			) * cellSize;
+
+			cells[i].key = cache.GetKey(cellCenter, cascadeIndex);
+			cells[i].radiance = float3(float(i % 251u) * 0.25f, float((i / 251u) % 241u) * 0.5f, 1.0f + float(i % 7u));
+		}
+
+		return cells;
+	}
+
+	// Mean of samples that all have the same radiance, exact as every sum fits in the mantissa of a float.
+	float3 GetStoredRadiance(const float3& radiance)
+	{
+		float3 storedRadiance;
+		for (int i = 0; i < 3; i++)
+		{
+			storedRadiance[i] = DecodeRadianceCacheChannel(EncodeRadianceCacheChannel(radiance[i]), 1u);
+		}
+
+		return storedRadiance;
+	}
+
+	// Hammers the cache from every thread of the task pool with lookups and inserts of a window of cells that slides every frame, so that
+	// cells age out while new ones are inserted. After each frame the whole table is checked against what the threads did: every cell in
+	// at most one slot, no sample lost, every slot holding the radiance of its own cell and aged correctly.
+	void CheckConcurrentOperations(TaskPool& taskPool, const StressDesc& desc)
+	{
+		RadianceHashCache cache;
+		cache.Create(GetCacheInfo(desc.capacity));
+
+		const std::vector<CacheCell> cells = CreateCacheCells(cache, desc.cellCount);
+
+		// Cells with the same checksum cannot be told apart in the table and are left out of the checks.
+		std::unordered_map<uint32_t, uint32_t> cellByChecksum;
+		for (uint32_t cellIndex = 0; cellIndex < desc.cellCount; cellIndex++)
+		{
+			auto insertResult = cellByChecksum.emplace(cells[cellIndex].key.checksum, cellIndex);
+			if (!insertResult.second)
+			{
+				insertResult.first->second = AmbiguousCell;
+			}
+		}
+
+		std::vector<std::atomic<uint32_t>> acceptedSampleCounts(desc.cellCount);
+		std::vector<std::atomic<uint32_t>> accumulateFrames(desc.cellCount);
+		for (std::atomic<uint32_t>& accumulateFrame : accumulateFrames)
+		{
+			accumulateFrame = NoFrame;
+		}
+
+		std::vector<uint32_t> cellSlots(desc.cellCount);
+		std::vector<uint32_t> lastUsedFrames(desc.cellCount);
+
+		const uint32_t taskCount = taskPool.GetThreadCount() * TasksPerThread;
+		const uint32_t operationsPerTask = desc.operationsPerFrame / taskCount;
+		const uint32_t lookupThreshold = uint32_t(desc.lookupFraction * 65536.0f);
+
+		uint32_t duplicateCount = 0u;
+		uint64_t lostSampleCount = 0u;
+		uint32_t wrongRadianceCount = 0u;
+		uint32_t unknownSlotCount = 0u;
+		uint32_t wrongAgeCount = 0u;
+		uint64_t evictedCount = 0u;
+
+		for (uint32_t frameIndex = 0; frameIndex < desc.frameCount; frameIndex++)
+		{
+			cache.SetFrameIndex(frameIndex);
+			const uint32_t windowStart = frameIndex * desc.cellStride;
+
+			taskPool.ParallelFor(taskCount, [&](uint32_t taskIndex)
+				{
+					TestRandom random(frameIndex * 65537u + taskIndex + 1u);
+					for (uint32_t i = 0; i < operationsPerTask; i++)
+					{
+						const uint32_t cellIndex = (windowStart + random.NextUint() % desc.activeCellCount) % desc.cellCount;
+						const CacheCell& cell = cells[cellIndex];
+
+						if ((random.NextUint() & 0xFFFFu) < lookupThreshold)
+						{
+							float3 radiance;
+							cache.Lookup(cell.key, radiance);
+						}
+						else if (cache.Accumulate(cell.key, cell.radiance))
+						{
+							acceptedSampleCounts[cellIndex].fetch_add(1u, std::memory_order_relaxed);
+							accumulateFrames[cellIndex].store(frameIndex, std::memory_order_relaxed);
+						}
+					}
+				});
+
+			std::fill(cellSlots.begin(), cellSlots.end(), RadianceHashCache::InvalidSlot);
+			for (uint32_t slotIndex = 0; slotIndex < cache.GetCapacity(); slotIndex++)
+			{
+				const RadianceCacheSlot slot = cache.GetSlot(slotIndex);
+				if (slot.checksum == RadianceCacheEmptyChecksum)
+				{
+					continue;
+				}
+
+				auto cellIt = cellByChecksum.find(slot.checksum);
+				if (cellIt == cellByChecksum.end())
+				{
+					unknownSlotCount++;
+					continue;
+				}
+
+				const uint32_t cellIndex = cellIt->second;
+				if (cellIndex == AmbiguousCell)
+				{
+					continue;
+				}
+
+				if (cellSlots[cellIndex] != RadianceHashCache::InvalidSlot)
+				{
+					duplicateCount++;
+					continue;
+				}
+
+				cellSlots[cellIndex] = slotIndex;
+
+				const uint32_t acceptedSampleCount = acceptedSampleCounts[cellIndex].load();
+				lostSampleCount += (std::max)(slot.sampleCount, acceptedSampleCount) - (std::min)(slot.sampleCount, acceptedSampleCount);
+
+				const float3 storedRadiance = GetStoredRadiance(cells[cellIndex].radiance);
+				wrongRadianceCount += slot.radiance.x != storedRadiance.x || slot.radiance.y != storedRadiance.y || slot.radiance.z != storedRadiance.z ? 1u : 0u;
+				wrongAgeCount += accumulateFrames[cellIndex].load() == frameIndex && slot.lastUsedFrame != frameIndex ? 1u : 0u;
+			}
+
+			for (uint32_t cellIndex = 0; cellIndex < desc.cellCount; cellIndex++)
+			{
+				if (cellSlots[cellIndex] == RadianceHashCache::InvalidSlot && cellByChecksum.at(cells[cellIndex].key.checksum) != AmbiguousCell)
+				{
+					lostSampleCount += acceptedSampleCounts[cellIndex].load();
+				}
+
+				lastUsedFrames[cellIndex] = cellSlots[cellIndex] != RadianceHashCache::InvalidSlot ? cache.GetSlot(cellSlots[cellIndex]).lastUsedFrame : NoFrame;
+			}
+
+			// Ages at the end of the frame, before the gather of the next one. Cells have to be kept exactly as long as their slot is not expired.
+			cache.SetFrameIndex(frameIndex + 1u);
+			evictedCount += cache.Age(&taskPool);
+
+			for (uint32_t cellIndex = 0; cellIndex < desc.cellCount; cellIndex++)
+			{
+				if (cellSlots[cellIndex] == RadianceHashCache::InvalidSlot)
+				{
+					continue;
+				}
+
+				const bool isExpired = IsRadianceCacheSlotExpired(lastUsedFrames[cellIndex], cache.GetInfo());
+				const bool isCached = cache.GetSlot(cellSlots[cellIndex]).checksum == cells[cellIndex].key.checksum;
+				wrongAgeCount += isCached == isExpired ? 1u : 0u;
+
+				if (!isCached)
+				{
+					acceptedSampleCounts[cellIndex] = 0u;
+				}
+			}
+		}
+
+		CPUREF_CHECK_EQ(duplicateCount, 0u);
+		CPUREF_CHECK_EQ(lostSampleCount, 0ull);
+		CPUREF_CHECK_EQ(wrongRadianceCount, 0u);
+		CPUREF_CHECK_EQ(unknownSlotCount, 0u);
+		CPUREF_CHECK_EQ(wrongAgeCount, 0u);
+		// The window slides past cells faster than maxAge, so some of them have to age out.
+		CPUREF_CHECK(evictedCount > 0ull);
+	}
+}
+
+CPUREF_TEST(RadianceCacheLookups)
+{
+	RadianceHashCache cache;
+	cache.Create(GetCacheInfo(1000u));
+	CPUREF_CHECK_EQ(cache.GetCapacity(), 1024u);
+
+	// Same cell for both positions, another one for the next cascade even though its cells are larger.
+	const RadianceCacheKey key = cache.GetKey(float3(-0.75f, 2.25f, 0.5f), 0u);
+	const RadianceCacheKey sameCellKey = cache.GetKey(float3(-0.25f, 2.75f, 0.0f), 0u);
+	const RadianceCacheKey upperCascadeKey = cache.GetKey(float3(-0.75f, 2.25f, 0.5f), 1u);
+	CPUREF_CHECK(key.slot == sameCellKey.slot && key.checksum == sameCellKey.checksum);
+	CPUREF_CHECK(key.checksum != upperCascadeKey.checksum);
+
+	// Lookups only return a cell once it has minSampleCount samples.
+	float3 radiance;
+	for (uint32_t i = 0; i < cache.GetInfo().minSampleCount; i++)
+	{
+		CPUREF_CHECK(!cache.Lookup(key, radiance));
+		CPUREF_CHECK(cache.Accumulate(key, float3(float(i), 1.0f, 2.0f)));
+	}
+
+	CPUREF_CHECK(cache.Lookup(key, radiance));
+	CPUREF_CHECK_NEAR(radiance.x, 1.5f, 1e-3f);
+	CPUREF_CHECK_NEAR(radiance.y, 1.0f, 1e-3f);
+	CPUREF_CHECK_NEAR(radiance.z, 2.0f, 1e-3f);
+	CPUREF_CHECK(!cache.Lookup(upperCascadeKey, radiance));
+	CPUREF_CHECK_EQ(cache.GetOccupiedSlotCount(), 1u);
+
+	// Kept for maxAge frames after the last lookup.
+	cache.SetFrameIndex(cache.GetInfo().maxAge);
+	CPUREF_CHECK_EQ(cache.Age(), 0u);
+	cache.SetFrameIndex(cache.GetInfo().maxAge + 1u);
+	CPUREF_CHECK_EQ(cache.Age(), 1u);
+	CPUREF_CHECK(!cache.Lookup(key, radiance));
+	CPUREF_CHECK_EQ(cache.GetOccupiedSlotCount(), 0u);
+}
+
+CPUREF_TEST(RadianceCacheConcurrentOperations)
+{
+	TaskPool taskPool(4u);
+
+	// Active cells fit in a quarter of the table.
+	CheckConcurrentOperations(taskPool, StressDesc());
+
+	// Four times as many active cells as slots, most probe windows are full and samples are dropped.
+	StressDesc overflowDesc;
+	overflowDesc.capacity = 1u << 8;
+	CheckConcurrentOperations(taskPool, overflowDesc);
+
+	// Every thread works on the same few cells, which maximizes the contention on their slots.
+	StressDesc contentionDesc;
+	contentionDesc.cellCount = 256u;
+	contentionDesc.activeCellCount = 64u;
+	contentionDesc.cellStride = 16u;
+	CheckConcurrentOperations(taskPool, contentionDesc);
+
+	// Mostly lookups, as once the cache is warm.
+	StressDesc lookupDesc;
+	lookupDesc.lookupFraction = 0.9f;
+	lookupDesc.cellStride = 1u << 6;
+	CheckConcurrentOperations(taskPool, lookupDesc);
+}
+
+// The cache carries over between frames, upper cascades start reading it once their cells have enough samples.
+CPUREF_TEST(RadianceCachePipeline)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 3u;
+
+	ReferencePipeline uncachedPipeline(fixture.taskPool);
+	uncachedPipeline.Generate(settings);
+	uncachedPipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+
+	RadianceCacheInfo cacheInfo = GetCacheInfo(1u << 16);
+	cacheInfo.maxAge = 8u;
+	cacheInfo.minCascade = 2u;
+	cacheInfo.cellSize0 = 0.25f;
+
+	RadianceHashCache cache;
+	cache.Create(cacheInfo);
+
+	ReferencePipeline pipeline(fixture.taskPool);
+	pipeline.Generate(settings);
+	pipeline.SetRadianceCache(&cache);
+
+	for (uint32_t frameIndex = 0; frameIndex < 2u; frameIndex++)
+	{
+		cache.SetFrameIndex(frameIndex);
+		cache.Age(&fixture.taskPool);
+		pipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+	}
+
+	for (uint32_t cascadeIndex = 0; cascadeIndex < pipeline.GetLayout().GetCascadeCount(); cascadeIndex++)
+	{
+		const uint64_t hitCount = pipeline.GetRadianceCacheHitCount(cascadeIndex);
+		CPUREF_CHECK(cascadeIndex < cacheInfo.minCascade ? hitCount == 0u : hitCount > 0u);
+	}
+
+	// Lower cascades shade every hit and the surfaces of the scene are large next to the cells, so the result stays close to the uncached one.
+	const RadianceTexture& cachedResult = pipeline.GetCoalescedResult();
+	const RadianceTexture& uncachedResult = uncachedPipeline.GetCoalescedResult();
+	double differenceSum = 0.0;
+	for (size_t i = 0; i < cachedResult.GetTexelCount(); i++)
+	{
+		const float4 difference = cachedResult.GetData()[i] - uncachedResult.GetData()[i];
+		differenceSum += (std::max)((std::max)(std::abs(difference.x), std::abs(difference.y)), std::abs(difference.z));
+	}
+
+	CPUREF_CHECK(differenceSum / double(cachedResult.GetTexelCount()) < 0.01);
+}
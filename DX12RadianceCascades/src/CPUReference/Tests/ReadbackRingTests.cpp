@@ -0,0 +1,196 @@
+#include "TestFramework.h"
+
+#include "ReadbackRing.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	constexpr uint64_t NoPendingFrame = UINT64_MAX;
+	constexpr uint32_t SimulatedFrameCount = 1000u;
+
+	// Runs the ring against a fence that completes every frame minLatency to maxLatency frames after it was submitted. The GPU side is
+	// simulated by writing the frame index into a slot when the fence of its copy completes, so a slot that is handed out or read before
+	// its copy has landed shows up as a wrong frame.
+	void CheckReadbackRing(uint32_t slotCount, uint32_t minLatency, uint32_t maxLatency)
+	{
+		TestRandom random(slotCount * 16u + minLatency * 4u + maxLatency);
+		std::vector<uint32_t> latencies(SimulatedFrameCount);
+		for (uint32_t& latency : latencies)
+		{
+			latency = minLatency + random.NextUint() % (maxLatency - minLatency + 1u);
+		}
+
+		ManualReadbackFence fence;
+		ReadbackRing ring;
+		ring.Reset(slotCount);
+
+		// What the GPU has copied into each slot, and the frame whose copy into it has not landed yet.
+		std::vector<uint64_t> slotData(slotCount, NoPendingFrame);
+		std::vector<uint64_t> slotPendingFrame(slotCount, NoPendingFrame);
+		std::vector<uint32_t> frameSlots(SimulatedFrameCount, ReadbackRing::InvalidSlot);
+
+		// The fence of frame N has the value N + 1, frames complete in order like on a queue.
+		uint64_t nextGPUFrame = 0u;
+		uint32_t framesWithoutResult = 0u;
+		uint64_t maxFrameAge = 0u;
+		uint32_t overwrittenPendingCount = 0u;
+		uint32_t wrongResultCount = 0u;
+
+		for (uint64_t frame = 0u; frame < SimulatedFrameCount; frame++)
+		{
+			const uint32_t writeSlot = ring.BeginWrite(fence, frame);
+			if (writeSlot != ReadbackRing::InvalidSlot)
+			{
+				overwrittenPendingCount += slotPendingFrame[writeSlot] != NoPendingFrame ? 1u : 0u;
+
+				slotPendingFrame[writeSlot] = frame;
+				frameSlots[frame] = writeSlot;
+				ring.EndWrite(writeSlot, frame + 1u);
+			}
+
+			while (nextGPUFrame <= frame && nextGPUFrame + latencies[nextGPUFrame] <= frame)
+			{
+				const uint32_t slot = frameSlots[nextGPUFrame];
+				if (slot != ReadbackRing::InvalidSlot && slotPendingFrame[slot] == nextGPUFrame)
+				{
+					slotData[slot] = nextGPUFrame;
+					slotPendingFrame[slot] = NoPendingFrame;
+				}
+
+				nextGPUFrame++;
+			}
+
+			fence.SetCompletedValue(nextGPUFrame);
+
+			ReadbackRingResult readback;
+			if (!ring.GetLatestResult(fence, frame, readback))
+			{
+				framesWithoutResult++;
+				continue;
+			}
+
+			wrongResultCount += slotData[readback.slotIndex] != readback.frameIndex || readback.frameIndex + readback.frameAge != frame ? 1u : 0u;
+			maxFrameAge = (std::max)(maxFrameAge, readback.frameAge);
+		}
+
+		CPUREF_CHECK_EQ(overwrittenPendingCount, 0u);
+		CPUREF_CHECK_EQ(wrongResultCount, 0u);
+
+		// See ReadbackRing::Reset(), with enough slots no frame is dropped and results are never older than the latency.
+		if (slotCount >= maxLatency + 2u)
+		{
+			CPUREF_CHECK_EQ(ring.GetDroppedFrameCount(), 0ull);
+			CPUREF_CHECK(framesWithoutResult <= maxLatency);
+			CPUREF_CHECK(maxFrameAge <= maxLatency);
+		}
+	}
+}
+
+CPUREF_TEST(ReadbackRingNeverReadsIncompleteSlots)
+{
+	for (uint32_t slotCount = 2u; slotCount <= 5u; slotCount++)
+	{
+		for (uint32_t latency = 0u; latency <= 3u; latency++)
+		{
+			CheckReadbackRing(slotCount, latency, latency);
+			if (latency > 0u)
+			{
+				CheckReadbackRing(slotCount, latency - 1u, latency + 1u);
+			}
+		}
+	}
+}
+
+CPUREF_TEST(ReadbackRingDropsFramesWhenFull)
+{
+	ManualReadbackFence fence;
+	ReadbackRing ring;
+	ring.Reset(2u);
+
+	// Nothing completes, so both slots stay in flight and the third frame has nowhere to go.
+	const uint32_t slot0 = ring.BeginWrite(fence, 0u);
+	ring.EndWrite(slot0, 1u);
+	const uint32_t slot1 = ring.BeginWrite(fence, 1u);
+	ring.EndWrite(slot1, 2u);
+	CPUREF_CHECK(slot0 != slot1);
+	CPUREF_CHECK_EQ(ring.BeginWrite(fence, 2u), ReadbackRing::InvalidSlot);
+	CPUREF_CHECK_EQ(ring.GetDroppedFrameCount(), 1ull);
+
+	ReadbackRingResult readback;
+	CPUREF_CHECK(!ring.GetLatestResult(fence, 2u, readback));
+
+	// The latest result keeps its slot, the other one is free again.
+	fence.SetCompletedValue(2u);
+	CPUREF_CHECK(ring.GetLatestResult(fence, 3u, readback));
+	CPUREF_CHECK_EQ(readback.slotIndex, slot1);
+	CPUREF_CHECK_EQ(readback.frameIndex, 1ull);
+	CPUREF_CHECK_EQ(readback.frameAge, 2ull);
+	CPUREF_CHECK_EQ(ring.BeginWrite(fence, 3u), slot0);
+}
+
+// The profiler resolves timestamps into the slot of each frame, see GPUProfiler. A frame whose resolve has not completed yet, and a
+// profile that was not resolved in the frame a slot holds, must keep the previous sample instead of reading whatever the slot holds.
+CPUREF_TEST(ReadbackProfileSamplesKeepLastSample)
+{
+	constexpr uint32_t SlotCount = 3u;
+	constexpr uint32_t ProfileCount = 2u;
+	constexpr double TimestampFrequency = 1000.0;
+
+	ManualReadbackFence fence;
+	ReadbackRing ring;
+	ring.Reset(SlotCount);
+	ReadbackProfileSamples samples;
+	samples.Reset(SlotCount);
+
+	// Start and end timestamp of every profile per slot, in ticks of 1 ms. Slots start out zeroed like a fresh readback buffer.
+	std::vector<uint64_t> slotTimestamps(SlotCount * ProfileCount * 2u, 0u);
+	float sampleMs = 0.0f;
+	CPUREF_CHECK(!samples.GetLastSample(0u, sampleMs));
+
+	// Frame 0 resolves both profiles and completes.
+	const uint32_t slot0 = ring.BeginWrite(fence, 0u);
+	samples.BeginFrame(0u);
+	samples.MarkResolved(0u);
+	samples.MarkResolved(1u);
+	const uint64_t frame0Timestamps[] = { 10u, 14u, 20u, 22u };
+	std::copy(std::begin(frame0Timestamps), std::end(frame0Timestamps), &slotTimestamps[slot0 * ProfileCount * 2u]);
+	ring.EndWrite(slot0, 1u);
+	fence.SetCompletedValue(1u);
+
+	ReadbackRingResult readback;
+	CPUREF_CHECK(ring.GetLatestResult(fence, 1u, readback));
+	CPUREF_CHECK_EQ(samples.ReadFrame(readback.frameIndex, &slotTimestamps[readback.slotIndex * ProfileCount * 2u], ProfileCount, TimestampFrequency), 3u);
+	CPUREF_CHECK(samples.GetLastSample(0u, sampleMs));
+	CPUREF_CHECK_NEAR(sampleMs, 4.0f, 1.0e-4f);
+
+	// Frame 1 resolves into a zeroed slot that the GPU has not written yet. The latest result is still frame 0, which was already read.
+	const uint32_t slot1 = ring.BeginWrite(fence, 1u);
+	samples.BeginFrame(1u);
+	samples.MarkResolved(0u);
+	ring.EndWrite(slot1, 2u);
+
+	CPUREF_CHECK(ring.GetLatestResult(fence, 2u, readback));
+	CPUREF_CHECK_EQ(readback.frameIndex, 0ull);
+	CPUREF_CHECK_EQ(samples.ReadFrame(readback.frameIndex, &slotTimestamps[readback.slotIndex * ProfileCount * 2u], ProfileCount, TimestampFrequency), 0u);
+	CPUREF_CHECK(samples.GetLastSample(0u, sampleMs));
+	CPUREF_CHECK_NEAR(sampleMs, 4.0f, 1.0e-4f);
+
+	// Once frame 1 completes only profile 0 gets a sample. Profile 1 was not resolved, its zeroed timestamps are never read.
+	const uint64_t frame1Timestamps[] = { 30u, 36u };
+	std::copy(std::begin(frame1Timestamps), std::end(frame1Timestamps), &slotTimestamps[slot1 * ProfileCount * 2u]);
+	fence.SetCompletedValue(2u);
+
+	CPUREF_CHECK(ring.GetLatestResult(fence, 2u, readback));
+	CPUREF_CHECK_EQ(readback.frameIndex, 1ull);
+	CPUREF_CHECK_EQ(samples.ReadFrame(readback.frameIndex, &slotTimestamps[readback.slotIndex * ProfileCount * 2u], ProfileCount, TimestampFrequency), 1u);
+	CPUREF_CHECK(samples.GetLastSample(0u, sampleMs));
+	CPUREF_CHECK_NEAR(sampleMs, 6.0f, 1.0e-4f);
+	CPUREF_CHECK(samples.GetLastSample(1u, sampleMs));
+	CPUREF_CHECK_NEAR(sampleMs, 2.0f, 1.0e-4f);
+}
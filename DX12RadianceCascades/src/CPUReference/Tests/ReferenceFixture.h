@@ -0,0 +1,84 @@
+#pragma once
+
+// Scene, camera and depth buffer shared by the tests that run the reference pipeline. The screen is small so that the Debug tests stay fast.
+
+#include "TestFramework.h"
+
+#include "ReferencePipeline.h"
+#include "ReferenceScene.h"
+#include "TaskPool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace CPUReference::Tests
+{
+	struct ReferenceFixture
+	{
+		static constexpr uint32_t Width = 192u;
+		static constexpr uint32_t Height = 108u;
+
+		TaskPool taskPool;
+		ReferenceScene scene;
+		ReferenceCamera camera;
+		DepthTexture depth;
+
+		ReferenceFixture() : taskPool(4u)
+		{
+			CreateDefaultScene(scene, camera, float(Height) / float(Width));
+			depth.Create(Width, Height);
+			RenderDepth(camera, scene, taskPool, depth);
+		}
+
+		ReferenceSettings GetSettings() const
+		{
+			ReferenceSettings settings;
+			settings.layoutDesc.width = Width;
+			settings.layoutDesc.height = Height;
+			return settings;
+		}
+	};
+
+	// Random radiance with a visibility of 0 or 1 in every texel of every cascade, so the merge can be checked without a gather.
+	inline void FillRandomCascadeIntervals(ReferencePipeline& pipeline, uint32_t seed)
+	{
+		TestRandom random(seed);
+		for (uint32_t i = 0; i < pipeline.GetLayout().GetCascadeCount(); i++)
+		{
+			RadianceTexture& cascadeInterval = pipeline.GetCascadeInterval(i);
+			for (size_t texelIndex = 0; texelIndex < cascadeInterval.GetTexelCount(); texelIndex++)
+			{
+				cascadeInterval.GetData()[texelIndex] = float4(random.NextFloat(0.0f, 4.0f), random.NextFloat(0.0f, 4.0f), random.NextFloat(0.0f, 4.0f), random.NextFloat() < 0.5f ? 0.0f : 1.0f);
+			}
+		}
+	}
+
+	// Compared bitwise, depth aware merging can produce NaN which then has to be NaN in both.
+	inline uint64_t CountMismatchedTexels(const RadianceTexture& actual, const RadianceTexture& expected)
+	{
+		if (actual.GetWidth() != expected.GetWidth() || actual.GetHeight() != expected.GetHeight())
+		{
+			return (std::max)(actual.GetTexelCount(), expected.GetTexelCount());
+		}
+
+		uint64_t mismatchedTexelCount = 0u;
+		for (size_t i = 0; i < actual.GetTexelCount(); i++)
+		{
+			mismatchedTexelCount += std::memcmp(&actual.GetData()[i], &expected.GetData()[i], sizeof(float4)) != 0 ? 1u : 0u;
+		}
+
+		return mismatchedTexelCount;
+	}
+
+	// Checks the coalesced result and the cascades from firstCascade up.
+	inline void CheckSameOutputs(const ReferencePipeline& actual, const ReferencePipeline& expected, uint32_t firstCascade = 0u)
+	{
+		CPUREF_CHECK_EQ(actual.GetLayout().GetCascadeCount(), expected.GetLayout().GetCascadeCount());
+		for (uint32_t i = firstCascade; i < actual.GetLayout().GetCascadeCount(); i++)
+		{
+			CPUREF_CHECK_EQ(CountMismatchedTexels(actual.GetCascadeInterval(i), expected.GetCascadeInterval(i)), 0ull);
+		}
+
+		CPUREF_CHECK_EQ(CountMismatchedTexels(actual.GetCoalescedResult(), expected.GetCoalescedResult()), 0ull);
+	}
+}
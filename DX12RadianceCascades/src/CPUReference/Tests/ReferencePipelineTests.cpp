@@ -0,0 +1,166 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "IntervalEncoding.h"
+
+#include <string>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	ReferenceSettings GetPermutationSettings(const ReferenceFixture& fixture, uint32_t permutationIndex, bool isUsingPreAveragedIntervals)
+	{
+		ReferenceSettings settings = fixture.GetSettings();
+		settings.layoutDesc.probeScalingFactor = GetPermutationProbeScalingFactor(permutationIndex);
+		settings.layoutDesc.rayScalingFactor = GetPermutationRayScalingFactor(permutationIndex);
+		settings.layoutDesc.isUsingPreAveragedIntervals = isUsingPreAveragedIntervals;
+		settings.layoutDesc.raysPerProbe0 = GetValidRayCount0(4u, settings.layoutDesc.rayScalingFactor, isUsingPreAveragedIntervals);
+		// Enough for a merge that reads an already merged cascade, without the ray counts of the upper cascades of the large scaling factors.
+		// The lowest valid ray count and the wider probe spacing keep the cascades of the scaling factors without pre-averaging small.
+		settings.layoutDesc.maxCascadeCount = 3u;
+		settings.layoutDesc.probeSpacing0 = 4u;
+		return settings;
+	}
+
+	// Merges the same random cascades as Run() would after the gather, coalescing separately unless it is fused into the merge.
+	void MergeRandomCascades(ReferencePipeline& pipeline, const ReferenceSettings& settings, const ReferenceFixture& fixture, uint32_t seed)
+	{
+		pipeline.Generate(settings);
+		FillRandomCascadeIntervals(pipeline, seed);
+		pipeline.RunMerge(fixture.camera, fixture.depth);
+		if (!pipeline.UsesFusedMergeCoalesce())
+		{
+			pipeline.RunCoalesce();
+		}
+	}
+}
+
+CPUREF_TEST(PrecomputedMergeWeightsMatchInlineWeights)
+{
+	ReferenceFixture fixture;
+
+	for (uint32_t permutationIndex = 0; permutationIndex < ScalingPermutationCount; permutationIndex++)
+	{
+		for (bool useFusedMergeCoalesce : { true, false })
+		{
+			ReferenceSettings settings = GetPermutationSettings(fixture, permutationIndex, true);
+			settings.useDepthAwareMerging = true;
+			settings.useFusedMergeCoalesce = useFusedMergeCoalesce;
+
+			settings.usePrecomputedMergeWeights = true;
+			ReferencePipeline precomputedPipeline(fixture.taskPool);
+			MergeRandomCascades(precomputedPipeline, settings, fixture, permutationIndex + 1u);
+
+			settings.usePrecomputedMergeWeights = false;
+			ReferencePipeline inlinePipeline(fixture.taskPool);
+			MergeRandomCascades(inlinePipeline, settings, fixture, permutationIndex + 1u);
+
+			CPUREF_CHECK(precomputedPipeline.GetLayout().GetCascadeCount() > 1u);
+			CheckSameOutputs(precomputedPipeline, inlinePipeline);
+		}
+	}
+}
+
+CPUREF_TEST(FusedMergeCoalesceMatchesSeparateCoalesce)
+{
+	ReferenceFixture fixture;
+
+	for (uint32_t permutationIndex = 0; permutationIndex < ScalingPermutationCount; permutationIndex++)
+	{
+		for (bool isUsingPreAveragedIntervals : { true, false })
+		{
+			for (bool useDepthAwareMerging : { false, true })
+			{
+				ReferenceSettings settings = GetPermutationSettings(fixture, permutationIndex, isUsingPreAveragedIntervals);
+				settings.useDepthAwareMerging = useDepthAwareMerging;
+
+				const uint32_t seed = permutationIndex * 4u + (isUsingPreAveragedIntervals ? 2u : 0u) + (useDepthAwareMerging ? 1u : 0u) + 1u;
+
+				settings.useFusedMergeCoalesce = true;
+				ReferencePipeline fusedPipeline(fixture.taskPool);
+				MergeRandomCascades(fusedPipeline, settings, fixture, seed);
+				CPUREF_CHECK(fusedPipeline.UsesFusedMergeCoalesce());
+
+				settings.useFusedMergeCoalesce = false;
+				ReferencePipeline separatePipeline(fixture.taskPool);
+				MergeRandomCascades(separatePipeline, settings, fixture, seed);
+
+				// Both add the rays of a probe in the same interleaved partial sums, so the results are bitwise equal. Cascade 0 itself
+				// is not written by the fused merge.
+				CheckSameOutputs(fusedPipeline, separatePipeline, 1u);
+			}
+		}
+	}
+}
+
+CPUREF_TEST(SpecializedMergeMatchesRuntimeScaling)
+{
+	ReferenceFixture fixture;
+
+	for (uint32_t permutationIndex = 0; permutationIndex < ScalingPermutationCount; permutationIndex++)
+	{
+		for (bool isUsingPreAveragedIntervals : { true, false })
+		{
+			for (bool useDepthAwareMerging : { false, true })
+			{
+				for (bool useFusedMergeCoalesce : { true, false })
+				{
+					ReferenceSettings settings = GetPermutationSettings(fixture, permutationIndex, isUsingPreAveragedIntervals);
+					settings.useDepthAwareMerging = useDepthAwareMerging;
+					settings.useFusedMergeCoalesce = useFusedMergeCoalesce;
+
+					const uint32_t seed = permutationIndex * 4u + (isUsingPreAveragedIntervals ? 2u : 0u) + (useDepthAwareMerging ? 1u : 0u) + 1u;
+
+					settings.useSpecializedMerge = true;
+					ReferencePipeline specializedPipeline(fixture.taskPool);
+					MergeRandomCascades(specializedPipeline, settings, fixture, seed);
+					CPUREF_CHECK_EQ(specializedPipeline.GetMergeScalingPermutation(), permutationIndex);
+
+					settings.useSpecializedMerge = false;
+					ReferencePipeline runtimePipeline(fixture.taskPool);
+					MergeRandomCascades(runtimePipeline, settings, fixture, seed);
+					CPUREF_CHECK_EQ(runtimePipeline.GetMergeScalingPermutation(), InvalidScalingPermutation);
+
+					CheckSameOutputs(specializedPipeline, runtimePipeline, useFusedMergeCoalesce ? 1u : 0u);
+				}
+			}
+		}
+	}
+}
+
+// The coalesced result of the default scene against Tests/Golden, so that a change to the shader code mirrored in RCShaderFunctions.h
+// shows up as a changed output. Compilers may round differently, so it only has to be close.
+CPUREF_TEST(ReferencePipelineMatchesGolden)
+{
+	ReferenceFixture fixture;
+
+	ReferenceSettings settings = fixture.GetSettings();
+	settings.layoutDesc.maxCascadeCount = 4u;
+	settings.layoutDesc.raysPerProbe0 = 4u;
+	settings.layoutDesc.probeSpacing0 = 2u;
+
+	ReferencePipeline pipeline(fixture.taskPool);
+	pipeline.Generate(settings);
+	pipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+	const RadianceTexture& coalescedResult = pipeline.GetCoalescedResult();
+
+	const std::string goldenFilePath = GetGoldenFilePath("ReferencePipelineCoalesced.pfm");
+	if (IsUpdatingGoldenFiles())
+	{
+		CPUREF_CHECK(WritePFM(goldenFilePath, coalescedResult));
+		return;
+	}
+
+	RadianceTexture golden;
+	CPUREF_CHECK(ReadPFM(goldenFilePath, golden));
+	CPUREF_CHECK_EQ(golden.GetWidth(), coalescedResult.GetWidth());
+	CPUREF_CHECK_EQ(golden.GetHeight(), coalescedResult.GetHeight());
+	if (golden.GetTexelCount() != coalescedResult.GetTexelCount())
+	{
+		return;
+	}
+
+	CPUREF_CHECK(ComputePSNR(golden.GetData(), coalescedResult.GetData(), golden.GetTexelCount()) > 60.0);
+}
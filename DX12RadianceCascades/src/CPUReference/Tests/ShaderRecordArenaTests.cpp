@@ -0,0 +1,325 @@
+#include "TestFramework.h"
+
+#include "ShaderRecordArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	enum ShaderExport : uint32_t
+	{
+		ShaderExportRayGen = 0,
+		ShaderExportMiss,
+		ShaderExportHitGroup,
+
+		ShaderExportCount // Keep last!
+	};
+
+	struct FakeDispatch
+	{
+		uint32_t psoIndex = 0u;
+		std::vector<uint32_t> modelIndices;
+		uint32_t tables[ShaderExportCount] = { ShaderRecordArena::InvalidTable, ShaderRecordArena::InvalidTable, ShaderRecordArena::InvalidTable };
+	};
+
+	struct ArenaTestDesc
+	{
+		uint32_t psoCount = 2u;
+		uint32_t modelCount = 8u;
+		uint32_t maxMeshesPerModel = 64u;
+		// Fraction of the meshes with the same local data as the mesh before them.
+		float duplicateMeshFraction = 0.1f;
+		uint32_t dispatchCount = 8u;
+		uint32_t rebuildCount = 32u;
+		uint32_t recompileCount = 8u;
+		// LocalHitData is 24 bytes.
+		uint32_t localDataSize = 24u;
+	};
+
+	ShaderIdentifier GetFakeIdentifier(TestRandom& random)
+	{
+		ShaderIdentifier identifier;
+		for (uint8_t& byte : identifier.data)
+		{
+			byte = uint8_t(random.NextUint());
+		}
+
+		return identifier;
+	}
+
+	// Models in ascending order like the std::set<ModelID> of the app, at least one.
+	std::vector<uint32_t> GetRandomModelSet(uint32_t modelCount, TestRandom& random)
+	{
+		std::vector<uint32_t> modelIndices;
+		for (uint32_t modelIndex = 0; modelIndex < modelCount; modelIndex++)
+		{
+			if (random.NextUint() % 2u == 0u)
+			{
+				modelIndices.push_back(modelIndex);
+			}
+		}
+
+		if (modelIndices.empty())
+		{
+			modelIndices.push_back(random.NextUint() % modelCount);
+		}
+
+		return modelIndices;
+	}
+
+	// Uses the arena the way RuntimeResourceManager does. Every PSO has a ray generation, miss and hit group identifier slot, every
+	// model has a local data record per mesh and a dispatch is the three tables of one PSO over a set of models.
+	class FakeScene
+	{
+	public:
+		FakeScene(const ArenaTestDesc& desc, ShaderRecordArena& arena, TestRandom& random)
+			: m_arena(arena), m_localDataSize(desc.localDataSize)
+		{
+			m_slots.resize(desc.psoCount * ShaderExportCount);
+			for (uint32_t& slot : m_slots)
+			{
+				slot = m_arena.AddIdentifierSlot(GetFakeIdentifier(random));
+			}
+
+			m_modelLocalData.resize(desc.modelCount);
+			for (std::vector<uint8_t>& localData : m_modelLocalData)
+			{
+				const uint32_t meshCount = 1u + random.NextUint() % desc.maxMeshesPerModel;
+				localData.resize(meshCount * desc.localDataSize);
+				for (uint32_t meshIndex = 0; meshIndex < meshCount && !localData.empty(); meshIndex++)
+				{
+					uint8_t* meshData = &localData[meshIndex * desc.localDataSize];
+					if (meshIndex > 0u && random.NextFloat() < desc.duplicateMeshFraction)
+					{
+						std::memcpy(meshData, meshData - desc.localDataSize, desc.localDataSize);
+						continue;
+					}
+
+					for (uint32_t byteIndex = 0; byteIndex < desc.localDataSize; byteIndex++)
+					{
+						meshData[byteIndex] = uint8_t(random.NextUint());
+					}
+				}
+			}
+		}
+
+		uint32_t GetSlot(uint32_t psoIndex, ShaderExport shaderExport) const { return m_slots[psoIndex * ShaderExportCount + shaderExport]; }
+
+		std::vector<ShaderRecordDesc> GetRecords(const FakeDispatch& dispatch, ShaderExport shaderExport) const
+		{
+			const uint32_t slot = GetSlot(dispatch.psoIndex, shaderExport);
+			if (shaderExport != ShaderExportHitGroup)
+			{
+				return { { slot, nullptr } };
+			}
+
+			std::vector<ShaderRecordDesc> records;
+			for (uint32_t modelIndex : dispatch.modelIndices)
+			{
+				const std::vector<uint8_t>& localData = m_modelLocalData[modelIndex];
+				for (size_t offset = 0; offset < localData.size(); offset += m_localDataSize)
+				{
+					records.push_back({ slot, &localData[offset] });
+				}
+			}
+
+			return records;
+		}
+
+		void Build(FakeDispatch& dispatch) const
+		{
+			for (uint32_t shaderExport = 0; shaderExport < ShaderExportCount; shaderExport++)
+			{
+				dispatch.tables[shaderExport] = m_arena.AddTable(GetRecords(dispatch, (ShaderExport)shaderExport));
+			}
+		}
+
+		void Release(FakeDispatch& dispatch) const
+		{
+			for (uint32_t& table : dispatch.tables)
+			{
+				m_arena.ReleaseTable(table);
+				table = ShaderRecordArena::InvalidTable;
+			}
+		}
+
+	private:
+		ShaderRecordArena& m_arena;
+		uint32_t m_localDataSize = 0u;
+		std::vector<uint32_t> m_slots;
+		// Every mesh of a model one after another.
+		std::vector<std::vector<uint8_t>> m_modelLocalData;
+	};
+
+	// Every record of the tables has to hold the identifier of its slot, its local data and zeros up to the stride.
+	void CheckTables(const FakeScene& scene, const ShaderRecordArena& arena, const std::vector<FakeDispatch>& dispatches)
+	{
+		uint64_t alignmentErrorCount = 0u;
+		uint64_t recordMismatchCount = 0u;
+		std::vector<uint8_t> expectedRecord(arena.GetRecordStride());
+		for (const FakeDispatch& dispatch : dispatches)
+		{
+			for (uint32_t shaderExport = 0; shaderExport < ShaderExportCount; shaderExport++)
+			{
+				const uint32_t table = dispatch.tables[shaderExport];
+				const uint64_t tableOffset = arena.GetTableOffset(table);
+				if (tableOffset % ShaderTableAlignment != 0u || tableOffset + arena.GetTableByteCount(table) > arena.GetByteCount())
+				{
+					alignmentErrorCount++;
+					continue;
+				}
+
+				const std::vector<ShaderRecordDesc> records = scene.GetRecords(dispatch, (ShaderExport)shaderExport);
+				if (records.size() != arena.GetTableRecordCount(table))
+				{
+					recordMismatchCount += records.size();
+					continue;
+				}
+
+				for (size_t recordIndex = 0; recordIndex < records.size(); recordIndex++)
+				{
+					std::fill(expectedRecord.begin(), expectedRecord.end(), uint8_t(0u));
+					std::memcpy(expectedRecord.data(), arena.GetIdentifier(records[recordIndex].identifierSlot).data, ShaderIdentifierSize);
+					if (records[recordIndex].localData != nullptr)
+					{
+						std::memcpy(expectedRecord.data() + ShaderIdentifierSize, records[recordIndex].localData, arena.GetLocalDataSize());
+					}
+
+					const uint8_t* recordData = arena.GetData() + tableOffset + recordIndex * arena.GetRecordStride();
+					recordMismatchCount += std::memcmp(recordData, expectedRecord.data(), expectedRecord.size()) != 0 ? 1u : 0u;
+				}
+			}
+		}
+
+		CPUREF_CHECK_EQ(alignmentErrorCount, 0ull);
+		CPUREF_CHECK_EQ(recordMismatchCount, 0ull);
+	}
+
+	// Copies the dirty ranges into gpuCopy like ShaderTableArena::Upload(), joining ranges up to a record apart.
+	void UploadDirtyRanges(ShaderRecordArena& arena, std::vector<uint8_t>& gpuCopy, std::vector<ShaderRecordByteRange>& dirtyRanges)
+	{
+		gpuCopy.resize((std::max)((uint64_t)gpuCopy.size(), arena.GetByteCount()), 0xCDu);
+
+		arena.TakeDirtyRanges(dirtyRanges, arena.GetRecordStride());
+		for (const ShaderRecordByteRange& range : dirtyRanges)
+		{
+			std::memcpy(&gpuCopy[range.offset], arena.GetData() + range.offset, range.byteCount);
+		}
+	}
+
+	// Only the bytes of live tables have to match, the rest of the copy is never read.
+	void CheckGPUCopy(const ShaderRecordArena& arena, const std::vector<FakeDispatch>& dispatches, const std::vector<uint8_t>& gpuCopy)
+	{
+		uint64_t staleByteCount = 0u;
+		for (const FakeDispatch& dispatch : dispatches)
+		{
+			for (uint32_t table : dispatch.tables)
+			{
+				const uint64_t tableOffset = arena.GetTableOffset(table);
+				for (uint64_t byteIndex = tableOffset; byteIndex < tableOffset + arena.GetTableByteCount(table) && byteIndex < gpuCopy.size(); byteIndex++)
+				{
+					staleByteCount += gpuCopy[byteIndex] != arena.GetData()[byteIndex] ? 1u : 0u;
+				}
+			}
+		}
+
+		CPUREF_CHECK_EQ(staleByteCount, 0ull);
+	}
+
+	// Dispatches are rebuilt over other model sets and PSOs are recompiled, which gives their slots new identifiers. After every step
+	// the tables are compared against the records they were built from, and a copy of the arena that only receives the dirty ranges,
+	// like the GPU buffer, has to match it.
+	void CheckArena(const ArenaTestDesc& desc)
+	{
+		TestRandom random(desc.psoCount * 100u + desc.modelCount + desc.localDataSize);
+
+		ShaderRecordArena arena(desc.localDataSize);
+		const FakeScene scene(desc, arena, random);
+
+		std::vector<FakeDispatch> dispatches(desc.dispatchCount);
+		for (uint32_t dispatchIndex = 0; dispatchIndex < desc.dispatchCount; dispatchIndex++)
+		{
+			FakeDispatch& dispatch = dispatches[dispatchIndex];
+			dispatch.psoIndex = dispatchIndex % desc.psoCount;
+			dispatch.modelIndices = GetRandomModelSet(desc.modelCount, random);
+			scene.Build(dispatch);
+		}
+
+		std::vector<uint8_t> gpuCopy;
+		std::vector<ShaderRecordByteRange> dirtyRanges;
+		UploadDirtyRanges(arena, gpuCopy, dirtyRanges);
+		CheckTables(scene, arena, dispatches);
+		CheckGPUCopy(arena, dispatches, gpuCopy);
+
+		// Rebuilds and recompiles interleaved.
+		const uint32_t stepCount = desc.rebuildCount + desc.recompileCount;
+		uint32_t rebuildsLeft = desc.rebuildCount;
+		uint32_t recompilesLeft = desc.recompileCount;
+		for (uint32_t stepIndex = 0; stepIndex < stepCount; stepIndex++)
+		{
+			const bool isRecompile = recompilesLeft > 0u && (rebuildsLeft == 0u || random.NextUint() % stepCount < desc.recompileCount);
+			if (isRecompile)
+			{
+				recompilesLeft--;
+
+				const uint32_t psoIndex = random.NextUint() % desc.psoCount;
+				for (uint32_t shaderExport = 0; shaderExport < ShaderExportCount; shaderExport++)
+				{
+					arena.SetIdentifier(scene.GetSlot(psoIndex, (ShaderExport)shaderExport), GetFakeIdentifier(random));
+				}
+				UploadDirtyRanges(arena, gpuCopy, dirtyRanges);
+			}
+			else
+			{
+				rebuildsLeft--;
+
+				// Built before the old tables are released so a rebuild over the same models shares them, like the app does.
+				FakeDispatch& dispatch = dispatches[random.NextUint() % desc.dispatchCount];
+				FakeDispatch rebuiltDispatch;
+				rebuiltDispatch.psoIndex = dispatch.psoIndex;
+				rebuiltDispatch.modelIndices = stepIndex % 4u == 0u ? dispatch.modelIndices : GetRandomModelSet(desc.modelCount, random);
+				scene.Build(rebuiltDispatch);
+				scene.Release(dispatch);
+				dispatch = rebuiltDispatch;
+				UploadDirtyRanges(arena, gpuCopy, dirtyRanges);
+			}
+
+			CheckTables(scene, arena, dispatches);
+			CheckGPUCopy(arena, dispatches, gpuCopy);
+		}
+	}
+}
+
+CPUREF_TEST(ShaderRecordArenaTables)
+{
+	for (uint32_t psoCount : { 2u, 8u })
+	{
+		for (uint32_t modelCount : { 8u, 64u })
+		{
+			for (float duplicateMeshFraction : { 0.0f, 0.25f })
+			{
+				ArenaTestDesc desc;
+				desc.psoCount = psoCount;
+				desc.modelCount = modelCount;
+				desc.duplicateMeshFraction = duplicateMeshFraction;
+				desc.dispatchCount = psoCount * 4u;
+				CheckArena(desc);
+			}
+		}
+	}
+
+	// Records of 96 bytes, tables can only share every other record.
+	ArenaTestDesc wideDesc;
+	wideDesc.localDataSize = 40u;
+	CheckArena(wideDesc);
+
+	// Records of 32 bytes.
+	ArenaTestDesc identifierOnlyDesc;
+	identifierOnlyDesc.localDataSize = 0u;
+	CheckArena(identifierOnlyDesc);
+}
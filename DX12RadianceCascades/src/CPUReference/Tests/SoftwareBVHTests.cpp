@@ -0,0 +1,259 @@
+#include "TestFramework.h"
+
+#include "SoftwareBVH.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Position, normal and UV like the vertices MiniEngine loads, only the position is filled in.
+	constexpr uint32_t VertexStride = 32u;
+
+	struct TestModel
+	{
+		std::vector<uint8_t> geometryData;
+		std::vector<BVHMeshDesc> meshes;
+		SoftwareBLAS blas;
+	};
+
+	// Appends a grid of (columns + 1) x (rows + 1) vertices with 16 bit indices as a mesh of the model. positionFunc maps [0, 1]^2 to a position.
+	template<typename PositionFunc>
+	void AddGridMesh(TestModel& model, uint32_t columns, uint32_t rows, const InstanceTransform& transform, const float3& emissive, PositionFunc&& positionFunc)
+	{
+		BVHMeshDesc mesh;
+		mesh.vbOffset = (uint32_t)model.geometryData.size();
+		mesh.vbStride = VertexStride;
+		mesh.vertexCount = (columns + 1u) * (rows + 1u);
+		mesh.ibOffset = mesh.vbOffset + mesh.vertexCount * VertexStride;
+		mesh.indexCount = columns * rows * 6u;
+		mesh.transform = transform;
+		mesh.emissive = emissive;
+
+		model.geometryData.resize(size_t(mesh.ibOffset) + size_t(mesh.indexCount) * sizeof(uint16_t), 0u);
+
+		for (uint32_t row = 0; row <= rows; row++)
+		{
+			for (uint32_t column = 0; column <= columns; column++)
+			{
+				const float3 position = positionFunc(float(column) / float(columns), float(row) / float(rows));
+				const float positionData[3] = { position.x, position.y, position.z };
+				std::memcpy(model.geometryData.data() + mesh.vbOffset + size_t(row * (columns + 1u) + column) * VertexStride, positionData, sizeof(positionData));
+			}
+		}
+
+		uint16_t* indexData = reinterpret_cast<uint16_t*>(model.geometryData.data() + mesh.ibOffset);
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				const uint16_t v0 = uint16_t(row * (columns + 1u) + column);
+				const uint16_t v2 = uint16_t(v0 + columns + 1u);
+				const uint16_t quad[6] = { v0, v2, uint16_t(v0 + 1u), uint16_t(v0 + 1u), v2, uint16_t(v2 + 1u) };
+				std::memcpy(indexData, quad, sizeof(quad));
+				indexData += 6;
+			}
+		}
+
+		model.meshes.push_back(mesh);
+	}
+
+	// Bumpy sphere of radius ~1 on a plate that is placed with its mesh transform.
+	void CreateModel(uint32_t modelIndex, TestModel& model)
+	{
+		const float bumpFrequency = 3.0f + float(modelIndex);
+		AddGridMesh(model, 24u, 12u, GetIdentityInstanceTransform(), float3(1.0f, 0.5f, float(modelIndex)), [&](float u, float v)
+			{
+				const float phi = u * 2.0f * Pi;
+				const float theta = v * Pi;
+				const float radius = 1.0f + 0.15f * std::sin(bumpFrequency * theta) * std::sin(bumpFrequency * phi);
+				return float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius;
+			});
+
+		InstanceTransform plateTransform = GetIdentityInstanceTransform();
+		plateTransform.rows[1][3] = -1.2f;
+		AddGridMesh(model, 4u, 4u, plateTransform, float3(0.1f, 0.2f, 0.3f), [](float u, float v)
+			{
+				return float3(u * 3.0f - 1.5f, 0.0f, v * 3.0f - 1.5f);
+			});
+
+		for (BVHMeshDesc& mesh : model.meshes)
+		{
+			mesh.geometryData = model.geometryData.data();
+		}
+
+		model.blas.Build(model.meshes);
+	}
+
+	InstanceTransform GetInstanceTransform(const float3& position, float rotation, float scale)
+	{
+		InstanceTransform transform = GetIdentityInstanceTransform();
+		transform.rows[0][0] = std::cos(rotation) * scale;
+		transform.rows[0][2] = std::sin(rotation) * scale;
+		transform.rows[2][0] = -std::sin(rotation) * scale;
+		transform.rows[2][2] = std::cos(rotation) * scale;
+		transform.rows[1][1] = scale;
+		transform.rows[0][3] = position.x;
+		transform.rows[1][3] = position.y;
+		transform.rows[2][3] = position.z;
+		return transform;
+	}
+
+	// Every triangle of the instance in world space, which ReferenceScene tests one by one.
+	void AddToReferenceScene(const TestModel& model, const InstanceTransform& instanceTransform, ReferenceScene& sceneOut)
+	{
+		for (const BVHMeshDesc& mesh : model.meshes)
+		{
+			auto getVertex = [&](uint32_t i)
+				{
+					uint16_t vertexIndex = 0u;
+					std::memcpy(&vertexIndex, mesh.geometryData + mesh.ibOffset + size_t(i) * sizeof(uint16_t), sizeof(uint16_t));
+
+					float position[3];
+					std::memcpy(position, mesh.geometryData + mesh.vbOffset + size_t(vertexIndex) * mesh.vbStride, sizeof(position));
+					return TransformPoint(instanceTransform, TransformPoint(mesh.transform, float3(position[0], position[1], position[2])));
+				};
+
+			for (uint32_t i = 0; i + 2u < mesh.indexCount; i += 3u)
+			{
+				sceneOut.AddTriangle(getVertex(i), getVertex(i + 1u), getVertex(i + 2u), mesh.emissive);
+			}
+		}
+	}
+
+	float3 NextRandomDirection(TestRandom& random)
+	{
+		const float z = random.NextFloat(-1.0f, 1.0f);
+		const float phi = random.NextFloat(0.0f, 2.0f * Pi);
+		const float r = std::sqrt((std::max)(1.0f - z * z, 0.0f));
+		return float3(r * std::cos(phi), r * std::sin(phi), z);
+	}
+}
+
+// A grid of rotated and scaled instances of three models traced through the two level BVH has to find the same closest hits as
+// ReferenceScene testing every triangle in world space. Rays grazing a shared edge can land on either triangle, which only changes
+// the normal, so the t and emissive of every hit are compared and normals only have to agree for most of them.
+CPUREF_TEST(SoftwareBVHMatchesBruteForce)
+{
+	std::vector<TestModel> models(3u);
+	for (uint32_t i = 0; i < (uint32_t)models.size(); i++)
+	{
+		CreateModel(i, models[i]);
+	}
+
+	TestRandom random(3u);
+
+	std::vector<SoftwareInstanceDesc> instances;
+	ReferenceScene referenceScene;
+	for (uint32_t i = 0; i < 27u; i++)
+	{
+		SoftwareInstanceDesc& instance = instances.emplace_back();
+		const TestModel& model = models[i % models.size()];
+		instance.blas = &model.blas;
+		instance.transform = GetInstanceTransform(float3(float(i % 3u), float((i / 3u) % 3u), float(i / 9u)) * 3.0f, random.NextFloat(0.0f, 2.0f * Pi), random.NextFloat(0.5f, 1.5f));
+		AddToReferenceScene(model, instance.transform, referenceScene);
+	}
+
+	SoftwareTLAS tlas;
+	tlas.Build(instances);
+	CPUREF_CHECK_EQ(tlas.GetInstanceCount(), 27u);
+
+	uint32_t hitCount = 0u;
+	uint32_t normalMismatchCount = 0u;
+	constexpr uint32_t RayCount = 2048u;
+	for (uint32_t i = 0; i < RayCount; i++)
+	{
+		// Origins inside and around the grid, so rays start inside instance bounds and outside of the scene.
+		const float3 origin = float3(random.NextFloat(-3.0f, 9.0f), random.NextFloat(-3.0f, 9.0f), random.NextFloat(-3.0f, 9.0f));
+		const float3 direction = NextRandomDirection(random);
+
+		RayHit hit;
+		RayHit referenceHit;
+		const bool isHit = tlas.TraceClosest(origin, direction, 0.0f, FloatMax, hit);
+		const bool isReferenceHit = referenceScene.TraceClosest(origin, direction, 0.0f, FloatMax, referenceHit);
+
+		CPUREF_CHECK_EQ(isHit, isReferenceHit);
+		if (!isHit || !isReferenceHit)
+		{
+			continue;
+		}
+
+		hitCount++;
+		CPUREF_CHECK_NEAR(hit.t, referenceHit.t, 1.0e-4f * (std::max)(referenceHit.t, 1.0f));
+		CPUREF_CHECK_EQ(hit.emissive.x, referenceHit.emissive.x);
+		CPUREF_CHECK_EQ(hit.emissive.y, referenceHit.emissive.y);
+		CPUREF_CHECK_EQ(hit.emissive.z, referenceHit.emissive.z);
+		normalMismatchCount += dot(hit.normal, referenceHit.normal) < 0.999f ? 1u : 0u;
+
+		// The hit is the closest one, so a ray that ends just before it hits nothing closer.
+		RayHit shortHit;
+		CPUREF_CHECK(!tlas.TraceClosest(origin, direction, 0.0f, referenceHit.t * 0.999f, shortHit));
+	}
+
+	// Rays have to both hit and miss for the comparison to mean anything.
+	CPUREF_CHECK(hitCount > RayCount / 8u);
+	CPUREF_CHECK(hitCount < RayCount);
+	CPUREF_CHECK(normalMismatchCount * 100u < hitCount);
+}
+
+// Packets trace the same rays as TraceClosest() one at a time, down to the bit.
+CPUREF_TEST(SoftwareBVHPacketsMatchSingleRays)
+{
+	std::vector<TestModel> models(2u);
+	for (uint32_t i = 0; i < (uint32_t)models.size(); i++)
+	{
+		CreateModel(i, models[i]);
+	}
+
+	TestRandom random(5u);
+
+	std::vector<SoftwareInstanceDesc> instances;
+	for (uint32_t i = 0; i < 16u; i++)
+	{
+		SoftwareInstanceDesc& instance = instances.emplace_back();
+		instance.blas = &models[i % models.size()].blas;
+		instance.transform = GetInstanceTransform(float3(float(i % 4u), 0.0f, float(i / 4u)) * 3.0f, random.NextFloat(0.0f, 2.0f * Pi), random.NextFloat(0.5f, 1.5f));
+	}
+
+	SoftwareTLAS tlas;
+	tlas.Build(instances);
+
+	for (bool isCoherent : { true, false })
+	{
+		for (uint32_t packetIndex = 0; packetIndex < 256u; packetIndex++)
+		{
+			RayPacket packet;
+			// The last packet of a batch is usually not full.
+			packet.rayCount = packetIndex % 16u == 15u ? 5u : RayPacketSize;
+
+			const float3 probeOrigin = float3(random.NextFloat(-2.0f, 11.0f), random.NextFloat(-1.0f, 3.0f), random.NextFloat(-2.0f, 11.0f));
+			const float3 probeDirection = NextRandomDirection(random);
+			for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+			{
+				packet.origins[rayIndex] = isCoherent ? probeOrigin : float3(random.NextFloat(-2.0f, 11.0f), random.NextFloat(-1.0f, 3.0f), random.NextFloat(-2.0f, 11.0f));
+				packet.directions[rayIndex] = isCoherent ? normalize(probeDirection + NextRandomDirection(random) * 0.1f) : NextRandomDirection(random);
+				packet.tMin[rayIndex] = 0.0f;
+				packet.tMax[rayIndex] = random.NextFloat() < 0.25f ? random.NextFloat(0.5f, 4.0f) : FloatMax;
+			}
+
+			RayHit packetHits[RayPacketSize];
+			const uint32_t hitMask = tlas.TraceClosestPacket(packet, packetHits);
+			CPUREF_CHECK_EQ(hitMask >> packet.rayCount, 0u);
+
+			for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+			{
+				RayHit hit;
+				const bool isHit = tlas.TraceClosest(packet.origins[rayIndex], packet.directions[rayIndex], packet.tMin[rayIndex], packet.tMax[rayIndex], hit);
+				CPUREF_CHECK_EQ(((hitMask >> rayIndex) & 1u) != 0u, isHit);
+				if (isHit)
+				{
+					CPUREF_CHECK_EQ(packetHits[rayIndex].t, hit.t);
+				}
+			}
+		}
+	}
+}
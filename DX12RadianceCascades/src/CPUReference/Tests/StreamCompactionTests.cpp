@@ -0,0 +1,114 @@
+#include "TestFramework.h"
+
+#include "StreamCompaction.h"
+#include "TaskPool.h"
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	std::vector<uint32_t> FilterBruteForce(const PackedGatherFilter& filter)
+	{
+		std::vector<uint32_t> activeTexels;
+		for (uint32_t y = 0; y < filter.GetHeight(); y++)
+		{
+			for (uint32_t x = 0; x < filter.GetWidth(); x++)
+			{
+				if (filter.Test((int32_t)x, (int32_t)y))
+				{
+					activeTexels.push_back(y * filter.GetWidth() + x);
+				}
+			}
+		}
+
+		return activeTexels;
+	}
+
+	void CheckCompaction(const PackedGatherFilter& filter, TaskPool& taskPool)
+	{
+		const std::vector<uint32_t> expected = FilterBruteForce(filter);
+
+		std::vector<uint32_t> activeTexels;
+		CompactGatherFilter(filter, activeTexels);
+		CPUREF_CHECK(activeTexels == expected);
+
+		// Stale contents of the output have to be replaced, not appended to.
+		std::vector<uint32_t> taskPoolActiveTexels(7u, ~0u);
+		CompactGatherFilter(filter, taskPool, taskPoolActiveTexels);
+		CPUREF_CHECK(taskPoolActiveTexels == expected);
+		CPUREF_CHECK_EQ((uint64_t)taskPoolActiveTexels.size(), filter.PopCount());
+	}
+}
+
+CPUREF_TEST(ExclusivePrefixSum)
+{
+	const uint32_t values[] = { 3u, 0u, 5u, 1u, 0u };
+	uint32_t sums[5] = {};
+	CPUREF_CHECK_EQ(ExclusivePrefixSum(values, sums, 5u), 9u);
+	CPUREF_CHECK_EQ(sums[0], 0u);
+	CPUREF_CHECK_EQ(sums[1], 3u);
+	CPUREF_CHECK_EQ(sums[2], 3u);
+	CPUREF_CHECK_EQ(sums[3], 8u);
+	CPUREF_CHECK_EQ(sums[4], 9u);
+
+	uint32_t inPlace[] = { 3u, 0u, 5u, 1u, 0u };
+	CPUREF_CHECK_EQ(ExclusivePrefixSum(inPlace, inPlace, 5u), 9u);
+	for (uint32_t i = 0; i < 5u; i++)
+	{
+		CPUREF_CHECK_EQ(inPlace[i], sums[i]);
+	}
+
+	CPUREF_CHECK_EQ(ExclusivePrefixSum(values, sums, 0u), 0u);
+}
+
+CPUREF_TEST(CompactGatherFilterMatchesBruteForce)
+{
+	TaskPool taskPool(4u);
+
+	// Texel counts below a word, with a partial last word, a partial last wave of 32 and 64 texels, and word counts just above and
+	// below a multiple of the words a task compacts, which leaves the last task with a partial range.
+	const uint32_t dims[][2] = { { 1u, 1u }, { 31u, 1u }, { 33u, 3u }, { 64u, 64u }, { 95u, 17u }, { 1024u, 128u }, { 1000u, 263u }, { 1021u, 385u } };
+	for (const uint32_t* dim : dims)
+	{
+		const uint32_t width = dim[0];
+		const uint32_t height = dim[1];
+
+		PackedGatherFilter filter(width, height);
+		CheckCompaction(filter, taskPool);
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				filter.Set((int32_t)x, (int32_t)y);
+			}
+		}
+
+		CheckCompaction(filter, taskPool);
+
+		// Only the last texel, which sits in the tail of the last word.
+		filter.Clear();
+		filter.Set((int32_t)width - 1, (int32_t)height - 1);
+		CheckCompaction(filter, taskPool);
+
+		for (float density : { 0.01f, 0.5f })
+		{
+			TestRandom random(width * 7919u + height);
+
+			filter.Clear();
+			for (uint32_t y = 0; y < height; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					if (random.NextFloat() < density)
+					{
+						filter.Set((int32_t)x, (int32_t)y);
+					}
+				}
+			}
+
+			CheckCompaction(filter, taskPool);
+		}
+	}
+}
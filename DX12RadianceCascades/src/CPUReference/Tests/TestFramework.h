@@ -0,0 +1,104 @@
+#pragma once
+
+// Minimal test registry of CPUReferenceTests. Every CPUREF_TEST registers itself before main() runs. A failed check is reported and
+// the test keeps going, so a single run lists every broken check. The executable returns non zero if any check failed.
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace CPUReference::Tests
+{
+	typedef void (*TestFunc)();
+
+	struct TestRegistration
+	{
+		TestRegistration(const char* name, TestFunc func);
+	};
+
+	// Counts the failure against the running test. Only the first few messages of a test are printed.
+	void ReportFailure(const char* file, int line, const std::string& message);
+
+	// Path of a file in Tests/Golden. Running with --update-golden rewrites the golden files from the current output instead of
+	// comparing against them, for changes that are meant to change the output.
+	std::string GetGoldenFilePath(const char* fileName);
+	bool IsUpdatingGoldenFiles();
+
+	// xorshift32, so that every run and every platform sees the same random data.
+	class TestRandom
+	{
+	public:
+		explicit TestRandom(uint32_t seed = 1u) : m_state(seed != 0u ? seed : 1u) {}
+
+		uint32_t NextUint()
+		{
+			m_state ^= m_state << 13u;
+			m_state ^= m_state >> 17u;
+			m_state ^= m_state << 5u;
+			return m_state;
+		}
+
+		// [0, 1)
+		float NextFloat() { return float(NextUint() >> 8u) / float(1u << 24u); }
+		float NextFloat(float minValue, float maxValue) { return minValue + (maxValue - minValue) * NextFloat(); }
+
+	private:
+		uint32_t m_state;
+	};
+
+	template<typename T>
+	std::string ToTestString(const T& value)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			return value ? "true" : "false";
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			return std::to_string((std::underlying_type_t<T>)value);
+		}
+		else
+		{
+			return std::to_string(value);
+		}
+	}
+}
+
+#define CPUREF_TEST(name) \
+	static void name(); \
+	static const CPUReference::Tests::TestRegistration name##Registration(#name, &name); \
+	static void name()
+
+#define CPUREF_CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			CPUReference::Tests::ReportFailure(__FILE__, __LINE__, #expr); \
+		} \
+	} while (false)
+
+#define CPUREF_CHECK_EQ(actual, expected) \
+	do \
+	{ \
+		const auto actualValue = (actual); \
+		const auto expectedValue = (expected); \
+		if (!(actualValue == expectedValue)) \
+		{ \
+			CPUReference::Tests::ReportFailure(__FILE__, __LINE__, std::string(#actual " == " #expected ", got ") + \
+				CPUReference::Tests::ToTestString(actualValue) + " and " + CPUReference::Tests::ToTestString(expectedValue)); \
+		} \
+	} while (false)
+
+#define CPUREF_CHECK_NEAR(actual, expected, tolerance) \
+	do \
+	{ \
+		const double actualValue = (double)(actual); \
+		const double expectedValue = (double)(expected); \
+		if (!(std::abs(actualValue - expectedValue) <= (double)(tolerance))) \
+		{ \
+			CPUReference::Tests::ReportFailure(__FILE__, __LINE__, std::string(#actual " ~= " #expected ", got ") + \
+				std::to_string(actualValue) + " and " + std::to_string(expectedValue)); \
+		} \
+	} while (false)
@@ -0,0 +1,112 @@
+// Runs every registered test, or only the ones whose name contains the first argument that is not a flag.
+// Example: CPUReferenceTests GatherFilter
+// --update-golden rewrites the golden files instead of comparing against them, see GetGoldenFilePath().
+
+#include "TestFramework.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace CPUReference::Tests
+{
+	namespace
+	{
+		struct RegisteredTest
+		{
+			const char* name;
+			TestFunc func;
+		};
+
+		constexpr uint32_t MaxPrintedFailuresPerTest = 10u;
+
+		// Function local so that it exists before the registrations of other translation units run.
+		std::vector<RegisteredTest>& GetRegisteredTests()
+		{
+			static std::vector<RegisteredTest> registeredTests;
+			return registeredTests;
+		}
+
+		uint32_t s_failureCount = 0u;
+		bool s_isUpdatingGoldenFiles = false;
+	}
+
+	TestRegistration::TestRegistration(const char* name, TestFunc func)
+	{
+		GetRegisteredTests().push_back({ name, func });
+	}
+
+	void ReportFailure(const char* file, int line, const std::string& message)
+	{
+		s_failureCount++;
+		if (s_failureCount <= MaxPrintedFailuresPerTest)
+		{
+			std::printf("%s(%d): check failed: %s\n", file, line, message.c_str());
+		}
+	}
+
+	std::string GetGoldenFilePath(const char* fileName)
+	{
+		// Next to this file, which the compilers are given with its full path.
+		const std::string sourcePath = __FILE__;
+		const size_t separatorPos = sourcePath.find_last_of("/\\");
+		const std::string testsDirectory = separatorPos != std::string::npos ? sourcePath.substr(0, separatorPos + 1u) : std::string();
+		return testsDirectory + "Golden/" + fileName;
+	}
+
+	bool IsUpdatingGoldenFiles()
+	{
+		return s_isUpdatingGoldenFiles;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace CPUReference::Tests;
+
+	const char* nameFilter = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--update-golden") == 0)
+		{
+			s_isUpdatingGoldenFiles = true;
+		}
+		else if (nameFilter == nullptr)
+		{
+			nameFilter = argv[i];
+		}
+	}
+
+	uint32_t runCount = 0u;
+	uint32_t failedCount = 0u;
+	for (const RegisteredTest& test : GetRegisteredTests())
+	{
+		if (nameFilter != nullptr && std::strstr(test.name, nameFilter) == nullptr)
+		{
+			continue;
+		}
+
+		std::printf("[ RUN    ] %s\n", test.name);
+		std::fflush(stdout);
+
+		s_failureCount = 0u;
+		const auto start = std::chrono::steady_clock::now();
+		test.func();
+		const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		runCount++;
+		if (s_failureCount == 0u)
+		{
+			std::printf("[     OK ] %s (%.1f ms)\n", test.name, elapsedMs);
+		}
+		else
+		{
+			failedCount++;
+			std::printf("[ FAILED ] %s (%u failed checks)\n", test.name, s_failureCount);
+		}
+	}
+
+	std::printf("%u of %u tests passed.\n", runCount - failedCount, runCount);
+	return failedCount == 0u ? 0 : 1;
+}
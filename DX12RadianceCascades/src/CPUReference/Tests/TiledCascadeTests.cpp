@@ -0,0 +1,94 @@
+#include "TestFramework.h"
+#include "ReferenceFixture.h"
+
+#include "TiledReferencePipeline.h"
+
+#include <vector>
+
+using namespace CPUReference;
+using namespace CPUReference::Tests;
+
+namespace
+{
+	// Every screen pixel has to be in the core of exactly one tile, and every tile has to contain its core.
+	void CheckTileCores(const CascadeTiling& tiling, uint32_t width, uint32_t height)
+	{
+		std::vector<uint32_t> coreCounts(size_t(width) * height, 0u);
+		for (uint32_t tileIndex = 0; tileIndex < tiling.GetTileCount(); tileIndex++)
+		{
+			const CascadeTile& tile = tiling.GetTile(tileIndex);
+			CPUREF_CHECK(tile.coreX >= tile.x && tile.coreX + tile.coreWidth <= tile.x + tile.width);
+			CPUREF_CHECK(tile.coreY >= tile.y && tile.coreY + tile.coreHeight <= tile.y + tile.height);
+			CPUREF_CHECK(tile.x + tile.width <= width && tile.y + tile.height <= height);
+			CPUREF_CHECK_EQ(tile.x % tiling.GetAlignment(), 0u);
+			CPUREF_CHECK_EQ(tile.y % tiling.GetAlignment(), 0u);
+
+			for (uint32_t y = tile.coreY; y < (std::min)(tile.coreY + tile.coreHeight, height); y++)
+			{
+				for (uint32_t x = tile.coreX; x < (std::min)(tile.coreX + tile.coreWidth, width); x++)
+				{
+					coreCounts[size_t(y) * width + x]++;
+				}
+			}
+		}
+
+		uint64_t wrongCoverageCount = 0u;
+		for (uint32_t coreCount : coreCounts)
+		{
+			wrongCoverageCount += coreCount != 1u ? 1u : 0u;
+		}
+
+		CPUREF_CHECK_EQ(wrongCoverageCount, 0ull);
+	}
+}
+
+// Tiling only changes which cascades hold a probe at a time, so the coalesced result of every tile size has to be bit exact with
+// the untiled pipeline.
+CPUREF_TEST(TiledCascadesMatchScreenCascades)
+{
+	ReferenceFixture fixture;
+
+	for (bool useGatherFiltering : { true, false })
+	{
+		for (bool useDepthAwareMerging : { false, true })
+		{
+			ReferenceSettings settings = fixture.GetSettings();
+			settings.layoutDesc.maxCascadeCount = 3u;
+			settings.layoutDesc.raysPerProbe0 = 4u;
+			settings.layoutDesc.probeSpacing0 = 4u;
+			settings.useGatherFiltering = useGatherFiltering;
+			settings.useDepthAwareMerging = useDepthAwareMerging;
+			settings.useStaggeredUpdates = false;
+
+			ReferencePipeline screenPipeline(fixture.taskPool);
+			screenPipeline.Generate(settings);
+			screenPipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+
+			CascadeTilingDesc tilingDesc;
+			tilingDesc.useGatherFiltering = useGatherFiltering;
+			tilingDesc.useDepthAwareMerging = useDepthAwareMerging;
+
+			uint32_t generatedTilingCount = 0u;
+			for (uint32_t tileSize : { 32u, 64u })
+			{
+				tilingDesc.tileSize = tileSize;
+
+				TiledReferencePipeline tiledPipeline(fixture.taskPool);
+				if (!tiledPipeline.Generate(settings, tilingDesc))
+				{
+					CPUREF_CHECK(tiledPipeline.GetTiling().IsEmpty());
+					continue;
+				}
+
+				generatedTilingCount++;
+				CheckTileCores(tiledPipeline.GetTiling(), ReferenceFixture::Width, ReferenceFixture::Height);
+
+				tiledPipeline.Run(fixture.scene, fixture.camera, fixture.depth);
+				CPUREF_CHECK_EQ(CountMismatchedTexels(tiledPipeline.GetCoalescedResult(), screenPipeline.GetCoalescedResult()), 0ull);
+			}
+
+			// Both are large enough for the halo of three cascades, with 24 and 6 tiles on the screen of the fixture.
+			CPUREF_CHECK_EQ(generatedTilingCount, 2u);
+		}
+	}
+}
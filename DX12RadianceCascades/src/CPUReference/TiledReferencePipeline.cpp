@@ -0,0 +1,90 @@
+#include "TiledReferencePipeline.h"
+
+#include <cassert>
+
+namespace CPUReference
+{
+	TiledReferencePipeline::TiledReferencePipeline(TaskPool& taskPool) : m_tilePipeline(taskPool)
+	{
+	}
+
+	bool TiledReferencePipeline::Generate(const ReferenceSettings& settings, const CascadeTilingDesc& tilingDesc)
+	{
+		assert(!settings.useStaggeredUpdates);
+
+		m_settings = settings;
+		m_settings.tileOriginX = 0u;
+		m_settings.tileOriginY = 0u;
+
+		m_screenLayout.Generate(settings.layoutDesc);
+		m_coalescedResult.Create(m_screenLayout.GetProbeCount0X(), m_screenLayout.GetProbeCount0Y());
+		m_tracedRayCount = 0u;
+
+		if (!m_tiling.Generate(m_screenLayout, tilingDesc))
+		{
+			return false;
+		}
+
+		// Allocated once for the largest tile, the smaller tiles reuse the same storage.
+		ReferenceSettings tileSettings = m_settings;
+		tileSettings.layoutDesc = m_tiling.GetMaxTileLayoutDesc();
+		m_tilePipeline.Generate(tileSettings);
+
+		return true;
+	}
+
+	void TiledReferencePipeline::Run(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth)
+	{
+		assert(!m_tiling.IsEmpty());
+
+		m_tracedRayCount = 0u;
+
+		for (uint32_t tileIndex = 0; tileIndex < m_tiling.GetTileCount(); tileIndex++)
+		{
+			const CascadeTile& tile = m_tiling.GetTile(tileIndex);
+
+			ReferenceSettings tileSettings = m_settings;
+			tileSettings.layoutDesc = m_tiling.GetTileLayoutDesc(tileIndex);
+			tileSettings.tileOriginX = tile.x;
+			tileSettings.tileOriginY = tile.y;
+
+			m_tilePipeline.Generate(tileSettings);
+			m_tilePipeline.Run(tracer, camera, depth);
+
+			for (uint32_t i = 0; i < m_tilePipeline.GetLayout().GetCascadeCount(); i++)
+			{
+				m_tracedRayCount += m_tilePipeline.GetTracedRayCount(i);
+			}
+
+			uint32_t beginX, beginY, endX, endY;
+			m_tiling.GetTileCoreProbes0(tileIndex, beginX, beginY, endX, endY);
+
+			const uint32_t probeOffsetX = tile.x / m_settings.layoutDesc.probeSpacing0;
+			const uint32_t probeOffsetY = tile.y / m_settings.layoutDesc.probeSpacing0;
+
+			const RadianceTexture& tileCoalescedResult = m_tilePipeline.GetCoalescedResult();
+			for (uint32_t y = beginY; y < endY; y++)
+			{
+				for (uint32_t x = beginX; x < endX; x++)
+				{
+					m_coalescedResult.At(x + probeOffsetX, y + probeOffsetY) = tileCoalescedResult.At(x, y);
+				}
+			}
+		}
+	}
+
+	uint64_t TiledReferencePipeline::GetCascadeTexelCount() const
+	{
+		CascadeLayout maxTileLayout;
+		maxTileLayout.Generate(m_tiling.GetMaxTileLayoutDesc());
+
+		uint64_t texelCount = 0u;
+		for (uint32_t i = 0; i < maxTileLayout.GetCascadeCount(); i++)
+		{
+			const CascadeLevel& level = maxTileLayout.GetLevel(i);
+			texelCount += uint64_t(level.textureWidth) * level.textureHeight;
+		}
+
+		return texelCount;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Runs the reference pipeline one screen tile at a time, see CascadeTiling.h. Every tile reuses the cascades of a single
+// ReferencePipeline allocated for the largest tile, and the core of each tile is copied into a screen sized coalesced result.
+
+#include "CascadeTiling.h"
+#include "ReferencePipeline.h"
+
+namespace CPUReference
+{
+	class TaskPool;
+
+	class TiledReferencePipeline
+	{
+	public:
+		explicit TiledReferencePipeline(TaskPool& taskPool);
+
+		// Returns false if the tiles cannot hold the cascades of the screen layout, see CascadeTiling::Generate().
+		// Staggered updates are not supported, as the history of every tile would have to be kept.
+		bool Generate(const ReferenceSettings& settings, const CascadeTilingDesc& tilingDesc);
+
+		// Same as ReferencePipeline::Run() for every tile, the depth buffer covers the whole screen.
+		void Run(const RayTracer& tracer, const ReferenceCamera& camera, const DepthTexture& depth);
+
+		const CascadeLayout& GetScreenLayout() const { return m_screenLayout; }
+		const CascadeTiling& GetTiling() const { return m_tiling; }
+		const RadianceTexture& GetCoalescedResult() const { return m_coalescedResult; }
+
+		// Rays traced during the last run over every tile, the halos trace the rays of their probes again.
+		uint64_t GetTracedRayCount() const { return m_tracedRayCount; }
+		// Texels of the shared cascades.
+		uint64_t GetCascadeTexelCount() const;
+
+	private:
+		ReferencePipeline m_tilePipeline;
+
+		ReferenceSettings m_settings;
+		CascadeLayout m_screenLayout;
+		CascadeTiling m_tiling;
+
+		RadianceTexture m_coalescedResult;
+		uint64_t m_tracedRayCount = 0u;
+	};
+}
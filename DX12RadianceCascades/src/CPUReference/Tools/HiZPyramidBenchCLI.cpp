@@ -0,0 +1,277 @@
+// Checks the single pass Hi-Z build against the per mip build on a set of depth buffer sizes and times both, see HiZPyramid.h.
+// Odd sizes are where the two can differ, as the odd size rule has to carry across the tiles of the single pass build.
+// Built by HiZPyramidBenchCLI.vcxproj.
+//
+// Returns 1 if any mip differs or the last mip does not hold the min and max of the whole buffer, so it can run on CI.
+// Example: HiZPyramidBenchCLI --iterations 20 --csv hiz.csv
+
+#include "../HiZPyramid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace CPUReference;
+
+namespace
+{
+	// Tile width of HiZSinglePassCS.hlsl.
+	constexpr uint32_t HiZShaderTileSize = 64u;
+
+	struct HiZPyramidResult
+	{
+		uint32_t width = 0u;
+		uint32_t height = 0u;
+		uint32_t mipCount = 0u;
+		// First mip where the single pass build differs from the per mip build, mipCount if every mip matches.
+		// Checked for full width tiles and for the 64x64 tiles of HiZSinglePassCS.hlsl.
+		uint32_t firstMismatchMip = 0u;
+		// Whether the last mip of the single pass build holds the min and max of every depth texel.
+		bool coversAllTexels = false;
+		// Single threaded, best of the timed iterations. The single pass build is timed with full width tiles.
+		double perMipMs = 0.0;
+		double singlePassMs = 0.0;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: HiZPyramidBenchCLI [options]\n"
+			"  --iterations <count>         Timed builds per size, the best is kept, default 10.\n"
+			"  --width <pixels>             Only run this size instead of the default set, needs --height.\n"
+			"  --height <pixels>            Only run this size instead of the default set, needs --width.\n"
+			"  --csv <path>                 Write every result.\n");
+	}
+
+	// Odd, even, single texel wide and tall sizes, plus the display resolutions of the app.
+	std::vector<int2> GetDefaultSizes()
+	{
+		return {
+			int2(1, 1), int2(1, 77), int2(77, 1), int2(3, 5),
+			int2(63, 65), int2(64, 64), int2(65, 63), int2(127, 129),
+			int2(191, 67), int2(321, 181), int2(1023, 575), int2(1001, 999),
+			int2(1920, 1080), int2(2560, 1440), int2(3840, 2160)
+		};
+	}
+
+	double GetElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	bool MipsMatch(const MinMaxDepthTexture& a, const MinMaxDepthTexture& b)
+	{
+		if (a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight())
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < a.GetTexelCount(); i++)
+		{
+			if (a.GetData()[i].x != b.GetData()[i].x || a.GetData()[i].y != b.GetData()[i].y)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Fixed pseudo random pattern with far plane (zero depth) texels mixed in.
+	void FillDepth(uint32_t seed, DepthTexture& depth)
+	{
+		uint32_t state = seed * 747796405u + 2891336453u;
+		for (size_t i = 0; i < depth.GetTexelCount(); i++)
+		{
+			// xorshift32, about one in eight texels is on the far plane.
+			state ^= state << 13u;
+			state ^= state >> 17u;
+			state ^= state << 5u;
+			depth.GetData()[i] = (state & 7u) == 0u ? 0.0f : float(state >> 8u) / float(1u << 24u);
+		}
+	}
+
+	template<typename BuildFunc>
+	double TimeBuild(const DepthTexture& depth, uint32_t iterationCount, std::vector<MinMaxDepthTexture>& mipsOut, BuildFunc buildFunc)
+	{
+		double bestMs = std::numeric_limits<double>::max();
+		for (uint32_t i = 0; i < (std::max)(iterationCount, 1u); i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			buildFunc(depth, mipsOut);
+			bestMs = (std::min)(bestMs, GetElapsedMs(start));
+		}
+
+		return bestMs;
+	}
+
+	HiZPyramidResult RunHiZPyramidBench(const DepthTexture& depth, uint32_t iterationCount)
+	{
+		HiZPyramidResult result;
+		result.width = depth.GetWidth();
+		result.height = depth.GetHeight();
+		result.mipCount = GetHiZMipCount(result.width, result.height);
+
+		std::vector<MinMaxDepthTexture> perMipMips;
+		std::vector<MinMaxDepthTexture> singlePassMips;
+		std::vector<MinMaxDepthTexture> shaderTileMips;
+		result.perMipMs = TimeBuild(depth, iterationCount, perMipMips, [](const DepthTexture& source, std::vector<MinMaxDepthTexture>& mips) { BuildHiZPyramidPerMip(source, mips); });
+		result.singlePassMs = TimeBuild(depth, iterationCount, singlePassMips, [](const DepthTexture& source, std::vector<MinMaxDepthTexture>& mips) { BuildHiZPyramid(source, mips); });
+		BuildHiZPyramid(depth, shaderTileMips, HiZShaderTileSize);
+
+		result.firstMismatchMip = result.mipCount;
+		for (uint32_t i = 0; i < result.mipCount; i++)
+		{
+			if (!MipsMatch(perMipMips[i], singlePassMips[i]) || !MipsMatch(perMipMips[i], shaderTileMips[i]))
+			{
+				result.firstMismatchMip = i;
+				break;
+			}
+		}
+
+		if (result.mipCount > 0u)
+		{
+			float2 expectedMinMax = float2(std::numeric_limits<float>::max(), 0.0f);
+			for (size_t i = 0; i < depth.GetTexelCount(); i++)
+			{
+				expectedMinMax.x = (std::min)(expectedMinMax.x, depth.GetData()[i]);
+				expectedMinMax.y = (std::max)(expectedMinMax.y, depth.GetData()[i]);
+			}
+
+			const float2 lastMinMax = singlePassMips.back().At(0u, 0u);
+			result.coversAllTexels = lastMinMax.x == expectedMinMax.x && lastMinMax.y == expectedMinMax.y;
+		}
+
+		return result;
+	}
+
+	bool WriteResultsCSV(const std::string& filePath, const std::vector<HiZPyramidResult>& results)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Width,Height,Mips,First Mismatch Mip,Covers All Texels,Per Mip (ms),Single Pass (ms)\n";
+		for (const HiZPyramidResult& result : results)
+		{
+			file << result.width << ","
+				<< result.height << ","
+				<< result.mipCount << ","
+				<< result.firstMismatchMip << ","
+				<< (result.coversAllTexels ? 1 : 0) << ","
+				<< result.perMipMs << ","
+				<< result.singlePassMs << "\n";
+		}
+
+		return file.good();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t iterationCount = 10u;
+	uint32_t width = 0u;
+	uint32_t height = 0u;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--iterations") == 0) { iterationCount = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--width") == 0) { width = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--height") == 0) { height = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if ((width == 0u) != (height == 0u))
+	{
+		std::fprintf(stderr, "--width and --height have to be given together.\n");
+		return 1;
+	}
+
+	const std::vector<int2> sizes = width > 0u ? std::vector<int2>{ int2(width, height) } : GetDefaultSizes();
+
+	std::printf("%11s | %4s | %8s %6s | %12s %16s %7s\n", "Size", "Mips", "Mismatch", "Covers", "Per mip (ms)", "Single pass (ms)", "Speedup");
+
+	std::vector<HiZPyramidResult> results;
+	bool hasMismatches = false;
+	for (uint32_t i = 0; i < (uint32_t)sizes.size(); i++)
+	{
+		DepthTexture depth((uint32_t)sizes[i].x, (uint32_t)sizes[i].y);
+		FillDepth(i + 1u, depth);
+
+		const HiZPyramidResult& result = results.emplace_back(RunHiZPyramidBench(depth, iterationCount));
+		hasMismatches |= result.firstMismatchMip < result.mipCount || !result.coversAllTexels;
+
+		char sizeText[32];
+		std::snprintf(sizeText, sizeof(sizeText), "%ux%u", result.width, result.height);
+
+		char mismatchText[16];
+		if (result.firstMismatchMip < result.mipCount)
+		{
+			std::snprintf(mismatchText, sizeof(mismatchText), "mip %u", result.firstMismatchMip);
+		}
+		else
+		{
+			std::snprintf(mismatchText, sizeof(mismatchText), "none");
+		}
+
+		std::printf("%11s | %4u | %8s %6s | %12.3f %16.3f %6.2fx\n",
+			sizeText,
+			result.mipCount,
+			mismatchText,
+			result.coversAllTexels ? "yes" : "no",
+			result.perMipMs,
+			result.singlePassMs,
+			result.perMipMs / (std::max)(result.singlePassMs, 1e-6));
+	}
+
+	std::printf("Single threaded, best of %u builds per size.\n", iterationCount);
+
+	if (!csvPath.empty() && !WriteResultsCSV(csvPath, results))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	if (hasMismatches)
+	{
+		std::fprintf(stderr, "The single pass build differs from the per mip build.\n");
+		return 1;
+	}
+
+	return 0;
+}
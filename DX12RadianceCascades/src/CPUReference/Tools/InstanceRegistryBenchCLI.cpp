@@ -0,0 +1,382 @@
+// Times InstanceRegistry, see InstanceRegistry.h, against rebuilding the instance descs every frame, which is what the app did before:
+// group the transforms of every scene instance by model into a map and encode every desc. A fraction of the instances moves every frame,
+// the registry is handed every transform and only writes the descs that changed. Built by InstanceRegistryBenchCLI.vcxproj.
+//
+// Runs 10k, 30k and 100k instances moving 0%, 1%, 10% and 100%, plus one run with churn per count.
+// Returns 1 if a desc the registry wrote differs from encoding its slot, so it can run on CI.
+// Example: InstanceRegistryBenchCLI --instances 50000 --frames 120 --csv instances.csv
+
+#include "../InstanceRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace CPUReference;
+
+namespace
+{
+	struct InstanceRegistryBenchDesc
+	{
+		uint32_t instanceCount = 10000u;
+		// Instances are spread over this many BLASes.
+		uint32_t modelCount = 16u;
+		// Fraction of the instances, picked at random, that move every frame.
+		float movingFraction = 0.01f;
+		// Instances removed and added again every frame, which reuses their slots.
+		uint32_t churnCount = 0u;
+		// Dirty ranges closer than this are written as one.
+		uint32_t maxRangeGap = 0u;
+		uint32_t frameCount = 60u;
+		uint32_t seed = 1u;
+	};
+
+	struct InstanceRegistryBenchResult
+	{
+		InstanceRegistryBenchDesc desc;
+
+		// Per frame averages.
+		double rebuildMs = 0.0;
+		double registryMs = 0.0;
+		float meanDirtyCount = 0.0f;
+		float meanRangeCount = 0.0f;
+		float meanWrittenDescCount = 0.0f;
+		// Frames where nothing changed and the TLAS update would be skipped.
+		uint32_t skippedFrameCount = 0u;
+		// Frames that need a full TLAS build instead of an update.
+		uint32_t rebuildFrameCount = 0u;
+		// Descs that differ from encoding every slot, has to be 0.
+		uint64_t mismatchCount = 0u;
+	};
+
+	struct SceneInstance
+	{
+		uint32_t modelIndex = 0u;
+		InstanceTransform transform = {};
+		uint32_t slot = InstanceRegistry::InvalidSlot;
+		bool isMoving = false;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: InstanceRegistryBenchCLI [options]\n"
+			"  --instances <count>          Only run this instance count instead of 10k, 30k and 100k.\n"
+			"  --models <count>             BLASes the instances are spread over, default 16.\n"
+			"  --frames <count>             Frames per run, default 60.\n"
+			"  --seed <seed>                Seed of the scene, default 1.\n"
+			"  --csv <path>                 Write every result.\n");
+	}
+
+	double GetElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// xorshift32.
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13u;
+		state ^= state >> 17u;
+		state ^= state << 5u;
+		return state;
+	}
+
+	float NextRandomFloat(uint32_t& state)
+	{
+		return float(NextRandom(state) >> 8u) / float(1u << 24u);
+	}
+
+	InstanceTransform GetTranslation(float x, float y, float z)
+	{
+		InstanceTransform transform = {};
+		transform.rows[0][0] = 1.0f;
+		transform.rows[1][1] = 1.0f;
+		transform.rows[2][2] = 1.0f;
+		transform.rows[0][3] = x;
+		transform.rows[1][3] = y;
+		transform.rows[2][3] = z;
+		return transform;
+	}
+
+	// Made up BLAS addresses, only compared and never dereferenced.
+	uint64_t GetBLASAddress(uint32_t modelIndex)
+	{
+		return 0x10000000ull + uint64_t(modelIndex) * 0x10000ull;
+	}
+
+	// Every model has as many geometries as its index + 1, the hit groups of the models follow each other.
+	uint32_t GetHitGroupOffset(uint32_t modelIndex)
+	{
+		return modelIndex * (modelIndex + 1u) / 2u;
+	}
+
+	// Grouping by model into a map and encoding every desc, what RadianceCascades::Update() did every frame before the registry.
+	void RebuildInstanceDescs(const std::vector<SceneInstance>& sceneInstances, std::vector<RaytracingInstanceDesc>& descsOut)
+	{
+		std::unordered_map<uint32_t, std::vector<InstanceTransform>> groupedInstances;
+		for (const SceneInstance& sceneInstance : sceneInstances)
+		{
+			groupedInstances[sceneInstance.modelIndex].push_back(sceneInstance.transform);
+		}
+
+		uint32_t instanceCount = 0u;
+		for (const auto& [modelIndex, transforms] : groupedInstances)
+		{
+			for (const InstanceTransform& transform : transforms)
+			{
+				RaytracingInstanceDesc& desc = descsOut[instanceCount++];
+				std::memcpy(desc.transform, transform.rows, sizeof(desc.transform));
+				desc.instanceID = 0u;
+				desc.instanceMask = 1u;
+				desc.instanceContributionToHitGroupIndex = GetHitGroupOffset(modelIndex);
+				desc.flags = 0u;
+				desc.accelerationStructure = GetBLASAddress(modelIndex);
+			}
+		}
+	}
+
+	std::vector<InstanceRegistryBenchDesc> GetBenchDescs(const std::vector<uint32_t>& instanceCounts, const InstanceRegistryBenchDesc& baseDesc)
+	{
+		std::vector<InstanceRegistryBenchDesc> descs;
+		for (uint32_t instanceCount : instanceCounts)
+		{
+			for (float movingFraction : { 0.0f, 0.01f, 0.1f, 1.0f })
+			{
+				InstanceRegistryBenchDesc desc = baseDesc;
+				desc.instanceCount = instanceCount;
+				desc.movingFraction = movingFraction;
+				descs.push_back(desc);
+			}
+
+			InstanceRegistryBenchDesc churnDesc = baseDesc;
+			churnDesc.instanceCount = instanceCount;
+			churnDesc.churnCount = instanceCount / 100u;
+			churnDesc.maxRangeGap = 4u;
+			descs.push_back(churnDesc);
+		}
+
+		return descs;
+	}
+
+	InstanceRegistryBenchResult RunInstanceRegistryBench(const InstanceRegistryBenchDesc& desc)
+	{
+		InstanceRegistryBenchResult result;
+		result.desc = desc;
+
+		uint32_t randomState = desc.seed != 0u ? desc.seed : 1u;
+
+		InstanceRegistry registry;
+		std::vector<SceneInstance> sceneInstances(desc.instanceCount);
+		for (uint32_t i = 0; i < desc.instanceCount; i++)
+		{
+			SceneInstance& sceneInstance = sceneInstances[i];
+			sceneInstance.modelIndex = NextRandom(randomState) % (std::max)(desc.modelCount, 1u);
+			sceneInstance.transform = GetTranslation(NextRandomFloat(randomState) * 1000.0f, 0.0f, NextRandomFloat(randomState) * 1000.0f);
+			sceneInstance.isMoving = NextRandomFloat(randomState) < desc.movingFraction;
+			sceneInstance.slot = registry.Add(sceneInstance.transform, GetBLASAddress(sceneInstance.modelIndex), GetHitGroupOffset(sceneInstance.modelIndex));
+		}
+
+		std::vector<RaytracingInstanceDesc> rebuiltDescs(desc.instanceCount);
+		std::vector<RaytracingInstanceDesc> registryDescs(registry.GetSlotCount());
+		registry.WriteAllDescs(registryDescs.data());
+
+		std::vector<InstanceRange> dirtyRanges;
+		uint64_t dirtyCountSum = 0u;
+		uint64_t rangeCountSum = 0u;
+		uint64_t writtenDescCountSum = 0u;
+
+		for (uint32_t frameIndex = 0; frameIndex < desc.frameCount; frameIndex++)
+		{
+			for (uint32_t i = 0; i < desc.instanceCount; i++)
+			{
+				SceneInstance& sceneInstance = sceneInstances[i];
+				if (sceneInstance.isMoving)
+				{
+					sceneInstance.transform.rows[1][3] = std::sin(float(frameIndex) * 0.1f + float(i));
+				}
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			RebuildInstanceDescs(sceneInstances, rebuiltDescs);
+			result.rebuildMs += GetElapsedMs(start);
+
+			start = std::chrono::steady_clock::now();
+			{
+				for (uint32_t churnIndex = 0; churnIndex < desc.churnCount; churnIndex++)
+				{
+					SceneInstance& sceneInstance = sceneInstances[NextRandom(randomState) % desc.instanceCount];
+					registry.Remove(sceneInstance.slot);
+					sceneInstance.slot = registry.Add(sceneInstance.transform, GetBLASAddress(sceneInstance.modelIndex), GetHitGroupOffset(sceneInstance.modelIndex));
+				}
+
+				// Every transform is pushed, only the ones that changed dirty their slot.
+				for (const SceneInstance& sceneInstance : sceneInstances)
+				{
+					registry.SetTransform(sceneInstance.slot, sceneInstance.transform);
+				}
+
+				if (!registry.HasChanges())
+				{
+					result.skippedFrameCount++;
+				}
+				else
+				{
+					if (registry.HasActivationChanges())
+					{
+						result.rebuildFrameCount++;
+					}
+
+					dirtyCountSum += registry.GetDirtyCount();
+					registry.GetDirtyRanges(dirtyRanges, desc.maxRangeGap);
+					rangeCountSum += dirtyRanges.size();
+
+					registryDescs.resize(registry.GetSlotCount());
+					writtenDescCountSum += registry.WriteDirtyDescs(registryDescs.data(), desc.maxRangeGap);
+				}
+			}
+			result.registryMs += GetElapsedMs(start);
+
+			for (uint32_t slot = 0; slot < registry.GetSlotCount(); slot++)
+			{
+				RaytracingInstanceDesc expectedDesc;
+				registry.EncodeInstanceDesc(slot, expectedDesc);
+				if (std::memcmp(&expectedDesc, &registryDescs[slot], sizeof(RaytracingInstanceDesc)) != 0)
+				{
+					result.mismatchCount++;
+				}
+			}
+		}
+
+		if (desc.frameCount > 0u)
+		{
+			result.rebuildMs /= double(desc.frameCount);
+			result.registryMs /= double(desc.frameCount);
+			result.meanDirtyCount = float(double(dirtyCountSum) / double(desc.frameCount));
+			result.meanRangeCount = float(double(rangeCountSum) / double(desc.frameCount));
+			result.meanWrittenDescCount = float(double(writtenDescCountSum) / double(desc.frameCount));
+		}
+
+		return result;
+	}
+
+	bool WriteResultsCSV(const std::string& filePath, const std::vector<InstanceRegistryBenchResult>& results)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Instances,Models,Moving Fraction,Churn,Max Range Gap,Frames,Rebuild Ms,Registry Ms,Mean Dirty,Mean Ranges,Mean Written Descs,Skipped Frames,Rebuild Frames,Mismatches\n";
+		for (const InstanceRegistryBenchResult& result : results)
+		{
+			file << result.desc.instanceCount << ","
+				<< result.desc.modelCount << ","
+				<< result.desc.movingFraction << ","
+				<< result.desc.churnCount << ","
+				<< result.desc.maxRangeGap << ","
+				<< result.desc.frameCount << ","
+				<< result.rebuildMs << ","
+				<< result.registryMs << ","
+				<< result.meanDirtyCount << ","
+				<< result.meanRangeCount << ","
+				<< result.meanWrittenDescCount << ","
+				<< result.skippedFrameCount << ","
+				<< result.rebuildFrameCount << ","
+				<< result.mismatchCount << "\n";
+		}
+
+		return file.good();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint32_t> instanceCounts = { 10000u, 30000u, 100000u };
+	InstanceRegistryBenchDesc baseDesc;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--instances") == 0) { instanceCounts = { (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u) }; }
+		else if (std::strcmp(arg, "--models") == 0) { baseDesc.modelCount = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--frames") == 0) { baseDesc.frameCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--seed") == 0) { baseDesc.seed = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::printf("%9s %7s %6s | %12s %13s %7s | %10s %8s %10s | %7s %7s %10s\n",
+		"Instances", "Moving", "Churn", "Rebuild (ms)", "Registry (ms)", "Speedup", "Dirty", "Ranges", "Written", "Skipped", "Rebuilt", "Mismatches");
+
+	std::vector<InstanceRegistryBenchResult> results;
+	bool hasMismatches = false;
+	for (const InstanceRegistryBenchDesc& desc : GetBenchDescs(instanceCounts, baseDesc))
+	{
+		const InstanceRegistryBenchResult& result = results.emplace_back(RunInstanceRegistryBench(desc));
+		hasMismatches |= result.mismatchCount > 0u;
+
+		std::printf("%9u %6.0f%% %6u | %12.3f %13.3f %6.1fx | %10.1f %8.1f %10.1f | %7u %7u %10llu\n",
+			result.desc.instanceCount,
+			result.desc.movingFraction * 100.0f,
+			result.desc.churnCount,
+			result.rebuildMs,
+			result.registryMs,
+			result.rebuildMs / (std::max)(result.registryMs, 1e-6),
+			result.meanDirtyCount,
+			result.meanRangeCount,
+			result.meanWrittenDescCount,
+			result.skippedFrameCount,
+			result.rebuildFrameCount,
+			(unsigned long long)result.mismatchCount);
+	}
+
+	std::printf("Per frame means over %u frames, %u models.\n", baseDesc.frameCount, baseDesc.modelCount);
+
+	if (!csvPath.empty() && !WriteResultsCSV(csvPath, results))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	if (hasMismatches)
+	{
+		std::fprintf(stderr, "The registry wrote descs that differ from encoding their slots.\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,248 @@
+// Compares the cascade interval storage formats of IntervalEncoding.h on the default scene. Every format runs the whole reference pipeline
+// with its cascades quantized to that format, and is compared to the run with fp16 cascades which is what the GPU stores by default.
+// Prints the error, the memory and the texel traffic of a frame of every format. Built by IntervalFormatBenchCLI.vcxproj.
+//
+// Returns 1 if decoding and encoding a quantized cascade again changes it, so it can run on CI.
+// Example: IntervalFormatBenchCLI --width 1920 --height 1080 --csv formats.csv
+
+#include "../IntervalEncoding.h"
+#include "../ReferencePipeline.h"
+#include "../ReferenceScene.h"
+#include "../TaskPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace CPUReference;
+
+namespace
+{
+	struct IntervalFormatResult
+	{
+		IntervalFormat format = IntervalFormatFP16;
+		// Over every texel of every cascade after the merge, and over the coalesced result. Infinite for the fp16 run itself.
+		double cascadePSNR = 0.0;
+		double coalescedPSNR = 0.0;
+		// Memory of all cascades, see GetIntervalFrameBytes() for the frame traffic.
+		uint64_t cascadeBytes = 0u;
+		uint64_t frameBytes = 0u;
+		// Single threaded batch encode and decode of every cascade texel once.
+		double encodeMs = 0.0;
+		double decodeMs = 0.0;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: IntervalFormatBenchCLI [options]\n"
+			"  --threads <count>            Threads of the task pool, default 0 for every hardware thread.\n"
+			"  --width <pixels>             Screen width, default 960.\n"
+			"  --height <pixels>            Screen height, default 540.\n"
+			"  --probe-spacing <spacing>    Probe spacing of cascade 0, default 2.\n"
+			"  --rays <count>               Rays per probe of cascade 0, default 16.\n"
+			"  --csv <path>                 Write every result.\n");
+	}
+
+	// Every cascade texel one after another, so that errors are weighted per texel over all cascades.
+	std::vector<float4> GatherCascadeTexels(const ReferencePipeline& pipeline)
+	{
+		std::vector<float4> texels;
+		for (uint32_t i = 0; i < pipeline.GetLayout().GetCascadeCount(); i++)
+		{
+			const RadianceTexture& cascadeInterval = pipeline.GetCascadeInterval(i);
+			texels.insert(texels.end(), cascadeInterval.GetData(), cascadeInterval.GetData() + cascadeInterval.GetTexelCount());
+		}
+
+		return texels;
+	}
+
+	double GetElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Texel traffic of one frame without gather filtering: every texel is written by the gather, read and written by the merge of its cascade
+	// and reads rayScalingFactor x 4 texels of cascade N + 1 during it. Caches are ignored.
+	uint64_t GetIntervalFrameBytes(const CascadeLayout& layout, IntervalFormat format)
+	{
+		const uint32_t cascadeCount = layout.GetCascadeCount();
+
+		uint64_t texelAccessCount = 0u;
+		for (uint32_t i = 0; i < cascadeCount; i++)
+		{
+			const CascadeLevel& level = layout.GetLevel(i);
+			const uint64_t texelCount = uint64_t(level.textureWidth) * level.textureHeight;
+
+			// Gather write.
+			texelAccessCount += texelCount;
+
+			// The last cascade has nothing to merge with.
+			if (i < cascadeCount - 1u)
+			{
+				texelAccessCount += texelCount * (2u + layout.GetDesc().rayScalingFactor * 4u);
+			}
+		}
+
+		return texelAccessCount * GetIntervalTexelBytes(format);
+	}
+
+	bool WriteResultsCSV(const std::string& filePath, const std::vector<IntervalFormatResult>& results)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Format,Cascade PSNR (dB),Coalesced PSNR (dB),Cascade Bytes,Frame Bytes,Encode (ms),Decode (ms)\n";
+		for (const IntervalFormatResult& result : results)
+		{
+			file << GetIntervalFormatName(result.format) << ","
+				<< result.cascadePSNR << ","
+				<< result.coalescedPSNR << ","
+				<< result.cascadeBytes << ","
+				<< result.frameBytes << ","
+				<< result.encodeMs << ","
+				<< result.decodeMs << "\n";
+		}
+
+		return file.good();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threadCount = 0u;
+	ReferenceSettings settings;
+	settings.layoutDesc.width = 960u;
+	settings.layoutDesc.height = 540u;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--threads") == 0) { threadCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--width") == 0) { settings.layoutDesc.width = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--height") == 0) { settings.layoutDesc.height = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--probe-spacing") == 0) { settings.layoutDesc.probeSpacing0 = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--rays") == 0) { settings.layoutDesc.raysPerProbe0 = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	TaskPool taskPool(threadCount);
+
+	ReferenceScene scene;
+	ReferenceCamera camera;
+	CreateDefaultScene(scene, camera, float(settings.layoutDesc.height) / float(settings.layoutDesc.width));
+
+	DepthTexture depth;
+	depth.Create(settings.layoutDesc.width, settings.layoutDesc.height);
+	RenderDepth(camera, scene, taskPool, depth);
+
+	std::printf("%10s | %12s %14s | %12s %12s | %11s %11s\n", "Format", "Cascade PSNR", "Coalesced PSNR", "Cascade MB", "Frame MB", "Encode (ms)", "Decode (ms)");
+
+	std::vector<IntervalFormatResult> results;
+	std::vector<float4> baselineCascadeTexels;
+	RadianceTexture baselineCoalescedResult;
+	bool hasUnstableFormats = false;
+
+	for (uint32_t i = 0; i < IntervalFormatCount; i++)
+	{
+		const IntervalFormat format = (IntervalFormat)i;
+
+		ReferenceSettings formatSettings = settings;
+		formatSettings.quantizeIntervals = true;
+		formatSettings.intervalFormat = format;
+
+		ReferencePipeline pipeline(taskPool);
+		pipeline.Generate(formatSettings);
+		pipeline.Run(scene, camera, depth);
+
+		std::vector<float4> cascadeTexels = GatherCascadeTexels(pipeline);
+		if (format == IntervalFormatFP16)
+		{
+			baselineCascadeTexels = cascadeTexels;
+			baselineCoalescedResult = pipeline.GetCoalescedResult();
+		}
+
+		// The cascades are already in the format, storing them in it again must not change them.
+		std::vector<float4> requantizedTexels = cascadeTexels;
+		QuantizeIntervals(format, requantizedTexels.data(), requantizedTexels.size());
+		hasUnstableFormats |= std::memcmp(requantizedTexels.data(), cascadeTexels.data(), cascadeTexels.size() * sizeof(float4)) != 0;
+
+		IntervalFormatResult& result = results.emplace_back();
+		result.format = format;
+		result.cascadePSNR = ComputePSNR(baselineCascadeTexels.data(), cascadeTexels.data(), cascadeTexels.size());
+		result.coalescedPSNR = ComputePSNR(baselineCoalescedResult.GetData(), pipeline.GetCoalescedResult().GetData(), baselineCoalescedResult.GetTexelCount());
+		result.cascadeBytes = uint64_t(cascadeTexels.size()) * GetIntervalTexelBytes(format);
+		result.frameBytes = GetIntervalFrameBytes(pipeline.GetLayout(), format);
+
+		// Timed on the fp16 cascades so that every format converts the same texels.
+		std::vector<uint8_t> color(baselineCascadeTexels.size() * GetIntervalColorBytes(format));
+		std::vector<uint8_t> visibility(baselineCascadeTexels.size());
+
+		const auto encodeStart = std::chrono::steady_clock::now();
+		EncodeIntervals(format, baselineCascadeTexels.data(), baselineCascadeTexels.size(), color.data(), visibility.data());
+		result.encodeMs = GetElapsedMs(encodeStart);
+
+		const auto decodeStart = std::chrono::steady_clock::now();
+		DecodeIntervals(format, color.data(), visibility.data(), cascadeTexels.size(), cascadeTexels.data());
+		result.decodeMs = GetElapsedMs(decodeStart);
+
+		std::printf("%10s | %12.2f %14.2f | %12.2f %12.2f | %11.3f %11.3f\n",
+			GetIntervalFormatName(result.format),
+			result.cascadePSNR,
+			result.coalescedPSNR,
+			double(result.cascadeBytes) / (1024.0 * 1024.0),
+			double(result.frameBytes) / (1024.0 * 1024.0),
+			result.encodeMs,
+			result.decodeMs);
+	}
+
+	std::printf("PSNR in dB against the fp16 run, frame traffic without gather filtering at %ux%u.\n", settings.layoutDesc.width, settings.layoutDesc.height);
+
+	if (!csvPath.empty() && !WriteResultsCSV(csvPath, results))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	if (hasUnstableFormats)
+	{
+		std::fprintf(stderr, "Quantizing a quantized cascade changed it.\n");
+		return 1;
+	}
+
+	return 0;
+}
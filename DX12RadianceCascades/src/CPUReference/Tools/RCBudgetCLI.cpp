@@ -0,0 +1,239 @@
+// Command line front end of SolveCascadeBudget(), see CascadeCostModel.h. Built by RCBudgetCLI.vcxproj.
+//
+// Example: RCBudgetCLI --target 1440p --max-rays 4000000 --max-vram-mb 256 --min-ray-length0 2 --top 5 --cascades
+
+#include "../CascadeCostModel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace CPUReference;
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: RCBudgetCLI [options]\n"
+			"  --width <px> --height <px>   Screen resolution, default 1920x1080.\n"
+			"  --target <1080p|1440p|2160p> Shorthand for the resolution.\n"
+			"  --max-rays <count>           Rays traced per full update of every cascade, 0 for no limit.\n"
+			"  --max-vram-mb <MiB>          Bytes of every cascade resource, 0 for no limit.\n"
+			"  --min-ray-length0 <length>   Shortest ray length of cascade 0.\n"
+			"  --ray-length0 <length>       Ray length of cascade 0 before the minimum, default 5.\n"
+			"  --max-cascades <count>       Default 8.\n"
+			"  --max-rays0 <count>          Largest ray count of cascade 0 to try, default 256.\n"
+			"  --probe-scaling <factor>     Default 2.\n"
+			"  --ray-scaling <factor>       Default 4.\n"
+			"  --no-pre-averaging           Full size intervals.\n"
+			"  --formats <fp16,r11g11b10>   Interval formats to try.\n"
+			"  --atlas                      Intervals in one atlas texture.\n"
+			"  --staggered                  Staggered updates, adds history.\n"
+			"  --active-lists               Active probe direction lists.\n"
+			"  --top <count>                Candidates to print, default 10.\n"
+			"  --cascades                   Print every cascade of the printed candidates.\n"
+			"  --csv <path>                 Write every candidate, and <path>.cascades.csv with every cascade.\n");
+	}
+
+	bool ParseFormats(const char* formats, std::vector<IntervalFormat>& outFormats)
+	{
+		outFormats.clear();
+
+		std::string list = formats;
+		size_t start = 0u;
+		while (start <= list.size())
+		{
+			size_t end = list.find(',', start);
+			if (end == std::string::npos)
+			{
+				end = list.size();
+			}
+
+			const std::string name = list.substr(start, end - start);
+			if (name == "fp16")
+			{
+				outFormats.push_back(IntervalFormatFP16);
+			}
+			else if (name == "r11g11b10")
+			{
+				outFormats.push_back(IntervalFormatR11G11B10);
+			}
+			else
+			{
+				return false;
+			}
+
+			start = end + 1u;
+		}
+
+		return !outFormats.empty();
+	}
+
+	double ToMiB(uint64_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	void PrintCandidate(size_t rank, const CascadeBudgetCandidate& candidate)
+	{
+		const CascadeLayoutDesc& layout = candidate.desc.layout;
+		const CascadeCost& cost = candidate.cost;
+
+		std::printf("%4zu %7u %6u %9.2f %9s %8zu %12.2f %10.2f %10.2f %10.2f %10.2f %9.2f %s\n",
+			rank,
+			layout.probeSpacing0,
+			layout.raysPerProbe0,
+			candidate.rayDensity0,
+			GetIntervalFormatName(candidate.desc.intervalFormat),
+			cost.levels.size(),
+			cost.tracedRays / 1000000.0,
+			ToMiB(cost.totalBytes),
+			ToMiB(cost.intervalBytes),
+			ToMiB(cost.gatherFilterBytes),
+			ToMiB(cost.mergeReadBytes),
+			cost.reach,
+			cost.isAtlasFallback ? "(atlas fallback)" : "");
+	}
+
+	void PrintCascades(const CascadeBudgetCandidate& candidate)
+	{
+		std::printf("     %7s %11s %6s %11s %10s %10s %10s %10s %10s %9s %9s\n",
+			"Cascade", "Probes", "Rays", "Texture", "Rays (M)", "Int. (MiB)", "Gath. (KiB)", "Hist. (MiB)", "Merge (MiB)", "Start", "Length");
+
+		for (size_t i = 0; i < candidate.cost.levels.size(); i++)
+		{
+			const CascadeLevelCost& levelCost = candidate.cost.levels[i];
+			const CascadeLevel& level = levelCost.level;
+
+			std::printf("     %7zu %5ux%-5u %6u %5ux%-5u %10.3f %10.2f %10.2f %10.2f %10.2f %9.2f %9.2f\n",
+				i,
+				level.probesX, level.probesY,
+				level.raysPerProbe,
+				level.textureWidth, level.textureHeight,
+				levelCost.tracedRays / 1000000.0,
+				ToMiB(levelCost.intervalBytes),
+				levelCost.gatherFilterBytes / 1024.0,
+				ToMiB(levelCost.historyBytes),
+				ToMiB(levelCost.mergeReadBytes),
+				level.startT,
+				level.rayLength);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CascadeCostDesc baseDesc;
+	CascadeBudgetConstraints constraints;
+	CascadeBudgetSearchSpace searchSpace;
+	size_t topCount = 10u;
+	bool printCascades = false;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--width") == 0) { baseDesc.layout.width = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--height") == 0) { baseDesc.layout.height = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--target") == 0)
+		{
+			const std::string target = consumeValue();
+			if (target == "1080p") { baseDesc.layout.width = 1920u; baseDesc.layout.height = 1080u; }
+			else if (target == "1440p") { baseDesc.layout.width = 2560u; baseDesc.layout.height = 1440u; }
+			else if (target == "2160p") { baseDesc.layout.width = 3840u; baseDesc.layout.height = 2160u; }
+			else
+			{
+				std::fprintf(stderr, "Unknown target %s.\n", target.c_str());
+				return 1;
+			}
+		}
+		else if (std::strcmp(arg, "--max-rays") == 0) { constraints.maxTracedRays = std::strtoull(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--max-vram-mb") == 0) { constraints.maxBytes = uint64_t(std::strtod(consumeValue(), nullptr) * 1024.0 * 1024.0); }
+		else if (std::strcmp(arg, "--min-ray-length0") == 0) { constraints.minRayLength0 = std::strtof(consumeValue(), nullptr); }
+		else if (std::strcmp(arg, "--ray-length0") == 0) { baseDesc.layout.rayLength0 = std::strtof(consumeValue(), nullptr); }
+		else if (std::strcmp(arg, "--max-cascades") == 0) { baseDesc.layout.maxCascadeCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--max-rays0") == 0) { searchSpace.maxRaysPerProbe0 = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--probe-scaling") == 0) { baseDesc.layout.probeScalingFactor = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--ray-scaling") == 0) { baseDesc.layout.rayScalingFactor = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--no-pre-averaging") == 0) { baseDesc.layout.isUsingPreAveragedIntervals = false; }
+		else if (std::strcmp(arg, "--formats") == 0)
+		{
+			if (!ParseFormats(consumeValue(), searchSpace.intervalFormats))
+			{
+				std::fprintf(stderr, "Formats have to be a comma separated list of fp16 and r11g11b10.\n");
+				return 1;
+			}
+		}
+		else if (std::strcmp(arg, "--atlas") == 0) { baseDesc.useCascadeAtlas = true; }
+		else if (std::strcmp(arg, "--staggered") == 0) { baseDesc.useStaggeredUpdates = true; }
+		else if (std::strcmp(arg, "--active-lists") == 0) { baseDesc.useActiveProbeDirectionLists = true; }
+		else if (std::strcmp(arg, "--top") == 0) { topCount = std::strtoull(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--cascades") == 0) { printCascades = true; }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (baseDesc.layout.width == 0u || baseDesc.layout.height == 0u || baseDesc.layout.probeScalingFactor == 0u || baseDesc.layout.rayScalingFactor == 0u)
+	{
+		std::fprintf(stderr, "Resolution and scaling factors have to be larger than 0.\n");
+		return 1;
+	}
+
+	const std::vector<CascadeBudgetCandidate> candidates = SolveCascadeBudget(baseDesc, constraints, searchSpace);
+
+	std::printf("%ux%u, %zu candidates fit the budget.\n", baseDesc.layout.width, baseDesc.layout.height, candidates.size());
+	if (!candidates.empty())
+	{
+		std::printf("%4s %7s %6s %9s %9s %8s %12s %10s %10s %10s %10s %9s\n",
+			"Rank", "Spacing", "Rays0", "Rays/px", "Format", "Cascades", "Rays (M)", "VRAM (MiB)", "Int. (MiB)", "Gath. (MiB)", "Merge (MiB)", "Reach");
+	}
+
+	const size_t printCount = (std::min)(topCount, candidates.size());
+	for (size_t rank = 0; rank < printCount; rank++)
+	{
+		PrintCandidate(rank, candidates[rank]);
+
+		if (printCascades)
+		{
+			PrintCascades(candidates[rank]);
+		}
+	}
+
+	if (!csvPath.empty())
+	{
+		if (!WriteCascadeBudgetCSV(csvPath, candidates, false) || !WriteCascadeBudgetCSV(csvPath + ".cascades.csv", candidates, true))
+		{
+			std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+			return 1;
+		}
+	}
+
+	return candidates.empty() ? 2 : 0;
+}
@@ -0,0 +1,288 @@
+// Times lookups and accumulates of the world space radiance cache, see RadianceHashCache.h, on one thread and on every thread of the
+// task pool. The table is filled to several load factors first, the timed operations pick cells at random from twice as many cells
+// as there are slots, so lookups of cells that were never inserted search their whole probe window. Built by RadianceCacheBenchCLI.vcxproj.
+//
+// Returns 1 if a cell inserted before the timed operations cannot be found after them, so it can run on CI.
+// Example: RadianceCacheBenchCLI --threads 8 --capacity 1048576 --lookup-fraction 0.9
+
+#include "../RadianceHashCache.h"
+#include "../TaskPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace CPUReference;
+
+namespace
+{
+	// Tasks per thread, so that threads finishing early steal work and the operations of different tasks interleave.
+	constexpr uint32_t TasksPerThread = 4u;
+
+	struct CacheCell
+	{
+		RadianceCacheKey key;
+		float3 radiance;
+	};
+
+	struct RadianceCacheBenchResult
+	{
+		uint32_t capacity = 0u;
+		// Occupied slots over the capacity before the timed operations.
+		float loadFactor = 0.0f;
+		uint32_t threadCount = 0u;
+		uint64_t operationCount = 0u;
+		// Lookups that found their cell with enough samples.
+		float hitRate = 0.0f;
+		double singleThreadedOpsPerSecond = 0.0;
+		double multiThreadedOpsPerSecond = 0.0;
+		// Cells inserted before the timed operations that are not in the table after them.
+		uint32_t lostCellCount = 0u;
+	};
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: RadianceCacheBenchCLI [options]\n"
+			"  --threads <count>            Threads of the task pool, default 0 for every hardware thread.\n"
+			"  --capacity <slots>           Slots of the table, rounded up to a power of two. Default 262144.\n"
+			"  --lookup-fraction <share>    Share of the operations that are lookups, the rest are accumulates. Default 0.5.\n"
+			"  --operations <count>         Timed operations per load factor, default 4194304.\n"
+			"  --csv <path>                 Write every result.\n");
+	}
+
+	double GetElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// xorshift32.
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13u;
+		state ^= state >> 17u;
+		state ^= state << 5u;
+		return state;
+	}
+
+	// Cells of three cascades on a grid around the origin, so that negative cells and the cascade in the hash are covered.
+	std::vector<CacheCell> CreateCacheCells(const RadianceHashCache& cache, uint32_t cellCount)
+	{
+		std::vector<CacheCell> cells(cellCount);
+		for (uint32_t i = 0; i < cellCount; i++)
+		{
+			const uint32_t cascadeIndex = i % 3u;
+			const uint32_t gridIndex = i / 3u;
+			const float cellSize = GetRadianceCacheCellSize(cache.GetInfo(), cascadeIndex);
+
+			const float3 cellCenter = float3(
+				float(int32_t(gridIndex % 128u) - 64) + 0.5f,
+				float(int32_t((gridIndex / 128u) % 128u) - 64) + 0.5f,
+				float(int32_t(gridIndex / 16384u) - 4) + 0.5f
+			) * cellSize;
+
+			cells[i].key = cache.GetKey(cellCenter, cascadeIndex);
+			cells[i].radiance = float3(float(i % 251u) * 0.25f, float((i / 251u) % 241u) * 0.5f, 1.0f + float(i % 7u));
+		}
+
+		return cells;
+	}
+
+	RadianceCacheBenchResult RunRadianceCacheBench(TaskPool& taskPool, uint32_t capacity, float loadFactor, float lookupFraction, uint64_t operationCount)
+	{
+		RadianceCacheInfo info = {};
+		info.capacity = capacity;
+		info.maxAge = UINT32_MAX;
+		info.minSampleCount = 1u;
+		info.cellSize0 = 1.0f;
+		info.cellScalingFactor = 2.0f;
+
+		RadianceHashCache cache;
+		cache.Create(info);
+
+		// Twice as many cells as slots, the ones that are not inserted are the lookups that miss.
+		const std::vector<CacheCell> cells = CreateCacheCells(cache, cache.GetCapacity() * 2u);
+		const uint32_t targetSlotCount = uint32_t(std::clamp(loadFactor, 0.0f, 1.0f) * cache.GetCapacity());
+
+		std::vector<uint32_t> insertedCells;
+		for (uint32_t cellIndex = 0; cellIndex < (uint32_t)cells.size() && (uint32_t)insertedCells.size() < targetSlotCount; cellIndex++)
+		{
+			if (cache.Accumulate(cells[cellIndex].key, cells[cellIndex].radiance))
+			{
+				insertedCells.push_back(cellIndex);
+			}
+		}
+
+		const uint32_t lookupThreshold = uint32_t(std::clamp(lookupFraction, 0.0f, 1.0f) * 65536.0f);
+		const uint32_t taskCount = taskPool.GetThreadCount() * TasksPerThread;
+		const uint64_t operationsPerTask = (operationCount + taskCount - 1u) / taskCount;
+
+		RadianceCacheBenchResult result;
+		result.capacity = cache.GetCapacity();
+		result.loadFactor = float(cache.GetOccupiedSlotCount()) / float(cache.GetCapacity());
+		result.threadCount = taskPool.GetThreadCount();
+		result.operationCount = operationsPerTask * taskCount;
+
+		std::atomic<uint64_t> lookupCount = 0u;
+		std::atomic<uint64_t> lookupHitCount = 0u;
+
+		auto runOperations = [&](uint32_t taskIndex)
+			{
+				uint32_t state = RadianceCacheHash(taskIndex) | 1u;
+				uint64_t taskLookupCount = 0u;
+				uint64_t taskLookupHitCount = 0u;
+
+				for (uint64_t i = 0; i < operationsPerTask; i++)
+				{
+					const CacheCell& cell = cells[NextRandom(state) % cells.size()];
+					if ((NextRandom(state) & 0xFFFFu) < lookupThreshold)
+					{
+						float3 radiance;
+						taskLookupHitCount += cache.Lookup(cell.key, radiance) ? 1u : 0u;
+						taskLookupCount++;
+					}
+					else
+					{
+						cache.Accumulate(cell.key, cell.radiance);
+					}
+				}
+
+				lookupCount.fetch_add(taskLookupCount, std::memory_order_relaxed);
+				lookupHitCount.fetch_add(taskLookupHitCount, std::memory_order_relaxed);
+			};
+
+		// Same operations in both runs, inserts of the first run turn some misses of the second into hits.
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t taskIndex = 0; taskIndex < taskCount; taskIndex++)
+		{
+			runOperations(taskIndex);
+		}
+		result.singleThreadedOpsPerSecond = double(result.operationCount) / (GetElapsedMs(start) / 1000.0);
+
+		result.hitRate = lookupCount.load() > 0u ? float(lookupHitCount.load()) / float(lookupCount.load()) : 0.0f;
+
+		start = std::chrono::steady_clock::now();
+		taskPool.ParallelFor(taskCount, runOperations);
+		result.multiThreadedOpsPerSecond = double(result.operationCount) / (GetElapsedMs(start) / 1000.0);
+
+		// Nothing ages out, so every inserted cell has to keep its slot.
+		for (uint32_t cellIndex : insertedCells)
+		{
+			result.lostCellCount += cache.FindSlot(cells[cellIndex].key) == RadianceHashCache::InvalidSlot ? 1u : 0u;
+		}
+
+		return result;
+	}
+
+	bool WriteResultsCSV(const std::string& filePath, const std::vector<RadianceCacheBenchResult>& results, float lookupFraction)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Capacity,Load Factor,Lookup Fraction,Threads,Operations,Hit Rate,Single Threaded Ops/s,Multi Threaded Ops/s,Lost Cells\n";
+		for (const RadianceCacheBenchResult& result : results)
+		{
+			file << result.capacity << ","
+				<< result.loadFactor << ","
+				<< lookupFraction << ","
+				<< result.threadCount << ","
+				<< result.operationCount << ","
+				<< result.hitRate << ","
+				<< result.singleThreadedOpsPerSecond << ","
+				<< result.multiThreadedOpsPerSecond << ","
+				<< result.lostCellCount << "\n";
+		}
+
+		return file.good();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threadCount = 0u;
+	uint32_t capacity = 1u << 18;
+	float lookupFraction = 0.5f;
+	uint64_t operationCount = 1ull << 22;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--threads") == 0) { threadCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--capacity") == 0) { capacity = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--lookup-fraction") == 0) { lookupFraction = std::strtof(consumeValue(), nullptr); }
+		else if (std::strcmp(arg, "--operations") == 0) { operationCount = std::strtoull(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	TaskPool taskPool(threadCount);
+
+	std::printf("%10s %11s | %8s | %16s %16s | %10s\n", "Capacity", "Load factor", "Hit rate", "1 thread (Mop/s)", "Pool (Mop/s)", "Lost cells");
+
+	std::vector<RadianceCacheBenchResult> results;
+	bool hasLostCells = false;
+	for (float loadFactor : { 0.25f, 0.5f, 0.75f, 0.9f })
+	{
+		const RadianceCacheBenchResult& result = results.emplace_back(RunRadianceCacheBench(taskPool, capacity, loadFactor, lookupFraction, operationCount));
+		hasLostCells |= result.lostCellCount > 0u;
+
+		std::printf("%10u %11.2f | %8.3f | %16.2f %16.2f | %10u\n",
+			result.capacity,
+			result.loadFactor,
+			result.hitRate,
+			result.singleThreadedOpsPerSecond / 1e6,
+			result.multiThreadedOpsPerSecond / 1e6,
+			result.lostCellCount);
+	}
+
+	std::printf("%llu operations per load factor, %.0f%% lookups, %u threads in the pool.\n",
+		(unsigned long long)(results.empty() ? 0u : results[0].operationCount), lookupFraction * 100.0f, taskPool.GetThreadCount());
+
+	if (!csvPath.empty() && !WriteResultsCSV(csvPath, results, lookupFraction))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	if (hasLostCells)
+	{
+		std::fprintf(stderr, "Cells were lost from the table.\n");
+		return 1;
+	}
+
+	return 0;
+}
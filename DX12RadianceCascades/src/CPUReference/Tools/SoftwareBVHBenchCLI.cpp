@@ -0,0 +1,638 @@
+// Measures the ray throughput of the software BVH, see SoftwareBVH.h, and checks it against brute force. The scene is a grid of instances
+// of a few procedural models, every model is a bumpy sphere on a plate as two meshes laid out like Model::m_DataBuffer. Coherent rays come
+// in packets that share an origin and point into a narrow cone, like the rays of one probe. Incoherent rays have a random origin and
+// direction each. Every ray is traced one at a time and in packets, both have to agree, and a subset is checked against ReferenceScene
+// holding every triangle in world space. Built by SoftwareBVHBenchCLI.vcxproj.
+//
+// Returns 1 if packet and single ray tracing disagree on any ray, or the BVH disagrees with brute force, so it can run on CI.
+// Example: SoftwareBVHBenchCLI --threads 1 --rays 1000000 --csv bvh.csv
+
+#include "../SoftwareBVH.h"
+#include "../TaskPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace CPUReference;
+
+namespace
+{
+	struct SoftwareBVHBenchDesc
+	{
+		// Distinct BLASes, instances pick one at random.
+		uint32_t modelCount = 4u;
+		uint32_t trianglesPerModel = 20000u;
+		uint32_t instanceCount = 256u;
+		uint32_t rayCount = 1u << 18;
+		// Half angle of the cone of a coherent packet, in radians.
+		float coherentConeAngle = 0.1f;
+		// Rays checked against brute force, which is slow. 0 skips building the brute force scene.
+		uint32_t referenceRayCount = 256u;
+		BVHBuildDesc blasBuildDesc;
+		BVHBuildDesc tlasBuildDesc = { 16u, 1u, 1.0f };
+		uint32_t seed = 1u;
+	};
+
+	struct SoftwareBVHBenchResult
+	{
+		SoftwareBVHBenchDesc desc;
+		uint32_t threadCount = 0u;
+
+		// Triangles of every instance.
+		uint64_t sceneTriangleCount = 0u;
+		double blasBuildMs = 0.0;
+		double tlasBuildMs = 0.0;
+		float meanBLASSAHCost = 0.0f;
+		float tlasSAHCost = 0.0f;
+		uint32_t maxBLASDepth = 0u;
+		uint32_t tlasDepth = 0u;
+
+		// Millions of rays per second over every thread.
+		double coherentSingleMrays = 0.0;
+		double coherentPacketMrays = 0.0;
+		double incoherentSingleMrays = 0.0;
+		double incoherentPacketMrays = 0.0;
+		float coherentHitFraction = 0.0f;
+		float incoherentHitFraction = 0.0f;
+
+		// Has to be 0. Rays where packet and single ray tracing disagree on the hit or its t.
+		uint64_t packetMismatchCount = 0u;
+		// Has to be 0. Rays that hit in only one of the BVH and ReferenceScene, or hit more than 0.1% apart.
+		uint64_t referenceMismatchCount = 0u;
+	};
+
+	// Position, normal and UV like the vertices MiniEngine loads, only the position is filled in.
+	constexpr uint32_t VertexStride = 32u;
+
+	// Packets of rays are traced by one task.
+	constexpr uint32_t PacketsPerTask = 64u;
+
+	struct BenchModel
+	{
+		std::vector<uint8_t> geometryData;
+		std::vector<BVHMeshDesc> meshes;
+		SoftwareBLAS blas;
+	};
+
+	struct BenchRays
+	{
+		std::vector<RayPacket> packets;
+		std::vector<RayHit> singleHits;
+		std::vector<RayHit> packetHits;
+		std::vector<uint8_t> isSingleHit;
+		std::vector<uint8_t> isPacketHit;
+	};
+
+	double GetElapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// xorshift32.
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13u;
+		state ^= state >> 17u;
+		state ^= state << 5u;
+		return state;
+	}
+
+	float NextRandomFloat(uint32_t& state)
+	{
+		return float(NextRandom(state) >> 8u) / float(1u << 24u);
+	}
+
+	float3 NextRandomDirection(uint32_t& state)
+	{
+		const float z = NextRandomFloat(state) * 2.0f - 1.0f;
+		const float phi = NextRandomFloat(state) * 2.0f * Pi;
+		const float r = std::sqrt((std::max)(1.0f - z * z, 0.0f));
+		return float3(r * std::cos(phi), r * std::sin(phi), z);
+	}
+
+	// Appends a grid of (columns + 1) x (rows + 1) vertices and its triangles as a mesh of the model. positionFunc maps [0, 1]^2 to a position.
+	template<typename PositionFunc>
+	void AddGridMesh(BenchModel& model, uint32_t columns, uint32_t rows, const InstanceTransform& transform, const float3& emissive, PositionFunc&& positionFunc)
+	{
+		const uint32_t vertexCount = (columns + 1u) * (rows + 1u);
+		const bool uses32BitIndices = vertexCount > UINT16_MAX;
+		const uint32_t indexCount = columns * rows * 6u;
+		const uint32_t indexSize = uses32BitIndices ? sizeof(uint32_t) : sizeof(uint16_t);
+
+		BVHMeshDesc mesh;
+		mesh.vbOffset = (uint32_t)model.geometryData.size();
+		mesh.vbStride = VertexStride;
+		mesh.vertexCount = vertexCount;
+		mesh.ibOffset = mesh.vbOffset + vertexCount * VertexStride;
+		mesh.indexCount = indexCount;
+		mesh.uses32BitIndices = uses32BitIndices;
+		mesh.transform = transform;
+		mesh.emissive = emissive;
+
+		model.geometryData.resize(size_t(mesh.ibOffset) + size_t(indexCount) * indexSize, 0u);
+
+		uint8_t* vertexData = model.geometryData.data() + mesh.vbOffset;
+		for (uint32_t row = 0; row <= rows; row++)
+		{
+			for (uint32_t column = 0; column <= columns; column++)
+			{
+				const float3 position = positionFunc(float(column) / float(columns), float(row) / float(rows));
+				const float positionData[3] = { position.x, position.y, position.z };
+				std::memcpy(vertexData + size_t(row * (columns + 1u) + column) * VertexStride, positionData, sizeof(positionData));
+			}
+		}
+
+		uint8_t* indexData = model.geometryData.data() + mesh.ibOffset;
+		uint32_t index = 0u;
+		auto writeIndex = [&](uint32_t vertexIndex)
+			{
+				if (uses32BitIndices)
+				{
+					std::memcpy(indexData + size_t(index++) * sizeof(uint32_t), &vertexIndex, sizeof(uint32_t));
+				}
+				else
+				{
+					const uint16_t vertexIndex16 = (uint16_t)vertexIndex;
+					std::memcpy(indexData + size_t(index++) * sizeof(uint16_t), &vertexIndex16, sizeof(uint16_t));
+				}
+			};
+
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				const uint32_t v0 = row * (columns + 1u) + column;
+				const uint32_t v1 = v0 + 1u;
+				const uint32_t v2 = v0 + columns + 1u;
+				const uint32_t v3 = v2 + 1u;
+
+				writeIndex(v0);
+				writeIndex(v2);
+				writeIndex(v1);
+				writeIndex(v1);
+				writeIndex(v2);
+				writeIndex(v3);
+			}
+		}
+
+		model.meshes.push_back(mesh);
+	}
+
+	// Bumpy sphere of radius ~1 on a plate, 1/8th of the triangles go to the plate.
+	void CreateModel(uint32_t modelIndex, uint32_t triangleCount, const BVHBuildDesc& buildDesc, uint32_t& randomState, BenchModel& model)
+	{
+		const uint32_t sphereRows = (std::max)((uint32_t)std::sqrt(float(triangleCount) * 7.0f / 8.0f / 4.0f), 2u);
+		const uint32_t plateRows = (std::max)((uint32_t)std::sqrt(float(triangleCount) / 8.0f / 2.0f), 1u);
+		const float bumpFrequency = 3.0f + float(modelIndex % 5u);
+		const float bumpPhase = NextRandomFloat(randomState) * 2.0f * Pi;
+
+		const float3 sphereEmissive = float3(NextRandomFloat(randomState), NextRandomFloat(randomState), NextRandomFloat(randomState));
+		AddGridMesh(model, sphereRows * 2u, sphereRows, GetIdentityInstanceTransform(), sphereEmissive, [&](float u, float v)
+			{
+				const float phi = u * 2.0f * Pi;
+				const float theta = v * Pi;
+				const float radius = 1.0f + 0.15f * std::sin(bumpFrequency * theta) * std::sin(bumpFrequency * phi + bumpPhase);
+				return float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius;
+			});
+
+		// Placed with the mesh transform, like a node of the scene graph.
+		InstanceTransform plateTransform = GetIdentityInstanceTransform();
+		plateTransform.rows[1][3] = -1.2f;
+		AddGridMesh(model, plateRows, plateRows, plateTransform, float3(0.1f, 0.1f, 0.1f), [&](float u, float v)
+			{
+				return float3(u * 3.0f - 1.5f, 0.0f, v * 3.0f - 1.5f);
+			});
+
+		for (BVHMeshDesc& mesh : model.meshes)
+		{
+			mesh.geometryData = model.geometryData.data();
+		}
+
+		model.blas.Build(model.meshes, buildDesc);
+	}
+
+	InstanceTransform GetInstanceTransform(const float3& position, float rotation, float scale)
+	{
+		InstanceTransform transform = GetIdentityInstanceTransform();
+		transform.rows[0][0] = std::cos(rotation) * scale;
+		transform.rows[0][2] = std::sin(rotation) * scale;
+		transform.rows[2][0] = -std::sin(rotation) * scale;
+		transform.rows[2][2] = std::cos(rotation) * scale;
+		transform.rows[1][1] = scale;
+		transform.rows[0][3] = position.x;
+		transform.rows[1][3] = position.y;
+		transform.rows[2][3] = position.z;
+		return transform;
+	}
+
+	void AddToReferenceScene(const BenchModel& model, const InstanceTransform& instanceTransform, ReferenceScene& sceneOut)
+	{
+		for (const BVHMeshDesc& mesh : model.meshes)
+		{
+			auto getVertex = [&](uint32_t i)
+				{
+					uint32_t vertexIndex = 0u;
+					if (mesh.uses32BitIndices)
+					{
+						std::memcpy(&vertexIndex, mesh.geometryData + mesh.ibOffset + size_t(i) * sizeof(uint32_t), sizeof(uint32_t));
+					}
+					else
+					{
+						uint16_t vertexIndex16 = 0u;
+						std::memcpy(&vertexIndex16, mesh.geometryData + mesh.ibOffset + size_t(i) * sizeof(uint16_t), sizeof(uint16_t));
+						vertexIndex = vertexIndex16;
+					}
+
+					float position[3];
+					std::memcpy(position, mesh.geometryData + mesh.vbOffset + size_t(vertexIndex) * mesh.vbStride, sizeof(position));
+					return TransformPoint(instanceTransform, TransformPoint(mesh.transform, float3(position[0], position[1], position[2])));
+				};
+
+			for (uint32_t i = 0; i + 2u < mesh.indexCount; i += 3u)
+			{
+				sceneOut.AddTriangle(getVertex(i), getVertex(i + 1u), getVertex(i + 2u), mesh.emissive);
+			}
+		}
+	}
+
+	void CreateRays(const BVHBounds& sceneBounds, uint32_t rayCount, bool isCoherent, float coneAngle, uint32_t& randomState, BenchRays& raysOut)
+	{
+		const uint32_t packetCount = (rayCount + RayPacketSize - 1u) / RayPacketSize;
+		raysOut.packets.assign(packetCount, RayPacket());
+
+		const float3 sceneExtent = sceneBounds.boundsMax - sceneBounds.boundsMin;
+		for (uint32_t packetIndex = 0; packetIndex < packetCount; packetIndex++)
+		{
+			RayPacket& packet = raysOut.packets[packetIndex];
+			packet.rayCount = (std::min)(RayPacketSize, rayCount - packetIndex * RayPacketSize);
+
+			const float3 probeOrigin = sceneBounds.boundsMin + sceneExtent * float3(NextRandomFloat(randomState), NextRandomFloat(randomState), NextRandomFloat(randomState));
+			const float3 probeDirection = NextRandomDirection(randomState);
+			for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+			{
+				if (isCoherent)
+				{
+					packet.origins[rayIndex] = probeOrigin;
+					packet.directions[rayIndex] = normalize(probeDirection + NextRandomDirection(randomState) * std::tan(coneAngle) * NextRandomFloat(randomState));
+				}
+				else
+				{
+					packet.origins[rayIndex] = sceneBounds.boundsMin + sceneExtent * float3(NextRandomFloat(randomState), NextRandomFloat(randomState), NextRandomFloat(randomState));
+					packet.directions[rayIndex] = NextRandomDirection(randomState);
+				}
+
+				packet.tMin[rayIndex] = 0.0f;
+				packet.tMax[rayIndex] = FloatMax;
+			}
+		}
+
+		raysOut.singleHits.assign(size_t(packetCount) * RayPacketSize, RayHit());
+		raysOut.packetHits.assign(size_t(packetCount) * RayPacketSize, RayHit());
+		raysOut.isSingleHit.assign(size_t(packetCount) * RayPacketSize, 0u);
+		raysOut.isPacketHit.assign(size_t(packetCount) * RayPacketSize, 0u);
+	}
+
+	// Returns Mrays/s of tracing every ray one at a time and as packets.
+	void TraceRays(TaskPool& taskPool, const SoftwareTLAS& tlas, uint32_t rayCount, BenchRays& rays, double& singleMraysOut, double& packetMraysOut)
+	{
+		const uint32_t packetCount = (uint32_t)rays.packets.size();
+		const uint32_t taskCount = (packetCount + PacketsPerTask - 1u) / PacketsPerTask;
+
+		auto start = std::chrono::steady_clock::now();
+		taskPool.ParallelFor(taskCount, [&](uint32_t taskIndex)
+			{
+				const uint32_t packetEnd = (std::min)((taskIndex + 1u) * PacketsPerTask, packetCount);
+				for (uint32_t packetIndex = taskIndex * PacketsPerTask; packetIndex < packetEnd; packetIndex++)
+				{
+					const RayPacket& packet = rays.packets[packetIndex];
+					for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+					{
+						const size_t hitIndex = size_t(packetIndex) * RayPacketSize + rayIndex;
+						rays.isSingleHit[hitIndex] = tlas.TraceClosest(packet.origins[rayIndex], packet.directions[rayIndex], packet.tMin[rayIndex], packet.tMax[rayIndex], rays.singleHits[hitIndex]) ? 1u : 0u;
+					}
+				}
+			});
+		singleMraysOut = double(rayCount) / (GetElapsedMs(start) * 1000.0);
+
+		start = std::chrono::steady_clock::now();
+		taskPool.ParallelFor(taskCount, [&](uint32_t taskIndex)
+			{
+				const uint32_t packetEnd = (std::min)((taskIndex + 1u) * PacketsPerTask, packetCount);
+				for (uint32_t packetIndex = taskIndex * PacketsPerTask; packetIndex < packetEnd; packetIndex++)
+				{
+					const size_t firstHitIndex = size_t(packetIndex) * RayPacketSize;
+					const uint32_t hitMask = tlas.TraceClosestPacket(rays.packets[packetIndex], &rays.packetHits[firstHitIndex]);
+					for (uint32_t rayIndex = 0; rayIndex < RayPacketSize; rayIndex++)
+					{
+						rays.isPacketHit[firstHitIndex + rayIndex] = (hitMask >> rayIndex) & 1u;
+					}
+				}
+			});
+		packetMraysOut = double(rayCount) / (GetElapsedMs(start) * 1000.0);
+	}
+
+	bool IsHitMismatch(bool isHitA, const RayHit& hitA, bool isHitB, const RayHit& hitB, float tolerance)
+	{
+		if (isHitA != isHitB)
+		{
+			return true;
+		}
+
+		return isHitA && std::fabs(hitA.t - hitB.t) > tolerance * (std::max)(hitB.t, 1.0f);
+	}
+
+	void CheckRays(const BenchRays& rays, const ReferenceScene& referenceScene, uint32_t referenceRayCount, float& hitFractionOut, SoftwareBVHBenchResult& result)
+	{
+		// Spread over every packet.
+		const uint64_t referenceStride = referenceRayCount > 0u ? (std::max)(uint64_t(rays.packets.size()) * RayPacketSize / referenceRayCount, uint64_t(1u)) : UINT64_MAX;
+
+		uint64_t hitCount = 0u;
+		uint64_t rayCount = 0u;
+		for (uint32_t packetIndex = 0; packetIndex < (uint32_t)rays.packets.size(); packetIndex++)
+		{
+			const RayPacket& packet = rays.packets[packetIndex];
+			for (uint32_t rayIndex = 0; rayIndex < packet.rayCount; rayIndex++)
+			{
+				const size_t hitIndex = size_t(packetIndex) * RayPacketSize + rayIndex;
+				const bool isSingleHit = rays.isSingleHit[hitIndex] != 0u;
+				hitCount += isSingleHit ? 1u : 0u;
+
+				if (IsHitMismatch(rays.isPacketHit[hitIndex] != 0u, rays.packetHits[hitIndex], isSingleHit, rays.singleHits[hitIndex], 0.0f))
+				{
+					result.packetMismatchCount++;
+				}
+
+				if (referenceRayCount > 0u && rayCount % referenceStride == 0u)
+				{
+					RayHit referenceHit;
+					const bool isReferenceHit = referenceScene.TraceClosest(packet.origins[rayIndex], packet.directions[rayIndex], packet.tMin[rayIndex], packet.tMax[rayIndex], referenceHit);
+					if (IsHitMismatch(isSingleHit, rays.singleHits[hitIndex], isReferenceHit, referenceHit, 1.0e-3f))
+					{
+						result.referenceMismatchCount++;
+					}
+				}
+
+				rayCount++;
+			}
+		}
+
+		hitFractionOut = rayCount > 0u ? float(double(hitCount) / double(rayCount)) : 0.0f;
+	}
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: SoftwareBVHBenchCLI [options]\n"
+			"  --threads <count>            Threads tracing rays, default 0 for every hardware thread.\n"
+			"  --rays <count>               Rays of every test, default 262144.\n"
+			"  --models <count>             Run one test with this many models instead of the default tests.\n"
+			"  --triangles <count>          Triangles per model of that test.\n"
+			"  --instances <count>          Instances of that test.\n"
+			"  --reference-rays <count>     Rays checked against brute force, 0 to skip.\n"
+			"  --leaf-size <count>          Max triangles per BLAS leaf, default 4.\n"
+			"  --csv <path>                 Write every result.\n");
+	}
+
+	// 4 to 16 models with 5k to 50k triangles, 64 to 1024 instances.
+	std::vector<SoftwareBVHBenchDesc> GetBenchDescs()
+	{
+		std::vector<SoftwareBVHBenchDesc> descs;
+
+		SoftwareBVHBenchDesc smallDesc;
+		smallDesc.trianglesPerModel = 5000u;
+		smallDesc.instanceCount = 64u;
+		smallDesc.referenceRayCount = 2048u;
+		descs.push_back(smallDesc);
+
+		descs.push_back(SoftwareBVHBenchDesc());
+
+		SoftwareBVHBenchDesc largeDesc;
+		largeDesc.modelCount = 16u;
+		largeDesc.trianglesPerModel = 50000u;
+		largeDesc.instanceCount = 1024u;
+		// Every triangle in world space would not fit in memory.
+		largeDesc.referenceRayCount = 0u;
+		descs.push_back(largeDesc);
+
+		return descs;
+	}
+
+	SoftwareBVHBenchResult RunSoftwareBVHBench(TaskPool& taskPool, const SoftwareBVHBenchDesc& desc)
+	{
+		SoftwareBVHBenchResult result;
+		result.desc = desc;
+		result.threadCount = taskPool.GetThreadCount();
+
+		uint32_t randomState = desc.seed != 0u ? desc.seed : 1u;
+
+		std::vector<BenchModel> models((std::max)(desc.modelCount, 1u));
+		for (uint32_t modelIndex = 0; modelIndex < (uint32_t)models.size(); modelIndex++)
+		{
+			BenchModel& model = models[modelIndex];
+			CreateModel(modelIndex, desc.trianglesPerModel, desc.blasBuildDesc, randomState, model);
+
+			const BVHStats& blasStats = model.blas.GetStats();
+			result.blasBuildMs += blasStats.buildMs;
+			result.meanBLASSAHCost += blasStats.sahCost / float(models.size());
+			result.maxBLASDepth = (std::max)(result.maxBLASDepth, blasStats.maxDepth);
+		}
+
+		// Square grid with 4 units between instances.
+		const uint32_t gridSize = (uint32_t)std::ceil(std::sqrt(float(desc.instanceCount)));
+		std::vector<SoftwareInstanceDesc> instances(desc.instanceCount);
+		std::vector<uint32_t> instanceModels(desc.instanceCount);
+		for (uint32_t i = 0; i < desc.instanceCount; i++)
+		{
+			instanceModels[i] = NextRandom(randomState) % (uint32_t)models.size();
+
+			const float3 position = float3(float(i % gridSize) * 4.0f, NextRandomFloat(randomState), float(i / gridSize) * 4.0f);
+			instances[i].blas = &models[instanceModels[i]].blas;
+			instances[i].transform = GetInstanceTransform(position, NextRandomFloat(randomState) * 2.0f * Pi, 0.5f + NextRandomFloat(randomState));
+			result.sceneTriangleCount += instances[i].blas->GetTriangleCount();
+		}
+
+		SoftwareTLAS tlas;
+		const auto start = std::chrono::steady_clock::now();
+		tlas.Build(instances, desc.tlasBuildDesc);
+		result.tlasBuildMs = GetElapsedMs(start);
+		result.tlasSAHCost = tlas.GetStats().sahCost;
+		result.tlasDepth = tlas.GetStats().maxDepth;
+
+		ReferenceScene referenceScene;
+		BVHBounds sceneBounds;
+		for (uint32_t i = 0; i < desc.instanceCount; i++)
+		{
+			if (desc.referenceRayCount > 0u)
+			{
+				AddToReferenceScene(models[instanceModels[i]], instances[i].transform, referenceScene);
+			}
+
+			sceneBounds.Grow(TransformPoint(instances[i].transform, float3(0.0f, 0.0f, 0.0f)));
+		}
+
+		BenchRays rays;
+		CreateRays(sceneBounds, desc.rayCount, true, desc.coherentConeAngle, randomState, rays);
+		TraceRays(taskPool, tlas, desc.rayCount, rays, result.coherentSingleMrays, result.coherentPacketMrays);
+		CheckRays(rays, referenceScene, desc.referenceRayCount / 2u, result.coherentHitFraction, result);
+
+		CreateRays(sceneBounds, desc.rayCount, false, desc.coherentConeAngle, randomState, rays);
+		TraceRays(taskPool, tlas, desc.rayCount, rays, result.incoherentSingleMrays, result.incoherentPacketMrays);
+		CheckRays(rays, referenceScene, desc.referenceRayCount / 2u, result.incoherentHitFraction, result);
+
+		return result;
+	}
+
+	bool WriteResultsCSV(const std::string& filePath, const std::vector<SoftwareBVHBenchResult>& results)
+	{
+		std::ofstream file(filePath);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file << "Models,Triangles Per Model,Instances,Rays,Threads,Scene Triangles,BLAS Build Ms,TLAS Build Ms,Mean BLAS SAH,TLAS SAH,Max BLAS Depth,TLAS Depth,"
+			"Coherent Single Mrays,Coherent Packet Mrays,Incoherent Single Mrays,Incoherent Packet Mrays,Coherent Hit Fraction,Incoherent Hit Fraction,"
+			"Packet Mismatches,Reference Mismatches\n";
+
+		for (const SoftwareBVHBenchResult& result : results)
+		{
+			file << result.desc.modelCount << ","
+				<< result.desc.trianglesPerModel << ","
+				<< result.desc.instanceCount << ","
+				<< result.desc.rayCount << ","
+				<< result.threadCount << ","
+				<< result.sceneTriangleCount << ","
+				<< result.blasBuildMs << ","
+				<< result.tlasBuildMs << ","
+				<< result.meanBLASSAHCost << ","
+				<< result.tlasSAHCost << ","
+				<< result.maxBLASDepth << ","
+				<< result.tlasDepth << ","
+				<< result.coherentSingleMrays << ","
+				<< result.coherentPacketMrays << ","
+				<< result.incoherentSingleMrays << ","
+				<< result.incoherentPacketMrays << ","
+				<< result.coherentHitFraction << ","
+				<< result.incoherentHitFraction << ","
+				<< result.packetMismatchCount << ","
+				<< result.referenceMismatchCount << "\n";
+		}
+
+		return file.good();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threadCount = 0u;
+	uint32_t rayCount = 0u;
+	SoftwareBVHBenchDesc customDesc;
+	bool useCustomDesc = false;
+	bool hasReferenceRayCount = false;
+	uint32_t leafSize = 0u;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--threads") == 0) { threadCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--rays") == 0) { rayCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--models") == 0) { customDesc.modelCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); useCustomDesc = true; }
+		else if (std::strcmp(arg, "--triangles") == 0) { customDesc.trianglesPerModel = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); useCustomDesc = true; }
+		else if (std::strcmp(arg, "--instances") == 0) { customDesc.instanceCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); useCustomDesc = true; }
+		else if (std::strcmp(arg, "--reference-rays") == 0) { customDesc.referenceRayCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); hasReferenceRayCount = true; }
+		else if (std::strcmp(arg, "--leaf-size") == 0) { leafSize = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<SoftwareBVHBenchDesc> descs = useCustomDesc ? std::vector<SoftwareBVHBenchDesc>{ customDesc } : GetBenchDescs();
+	for (SoftwareBVHBenchDesc& desc : descs)
+	{
+		desc.rayCount = rayCount > 0u ? rayCount : desc.rayCount;
+		desc.referenceRayCount = hasReferenceRayCount ? customDesc.referenceRayCount : desc.referenceRayCount;
+		desc.blasBuildDesc.maxLeafSize = leafSize > 0u ? leafSize : desc.blasBuildDesc.maxLeafSize;
+	}
+
+	TaskPool taskPool(threadCount);
+
+	std::printf("%12s %10s %9s %9s %7s | %11s %11s %11s %11s | %8s %8s\n",
+		"Triangles", "Instances", "BLAS (ms)", "TLAS (ms)", "SAH",
+		"Coh. single", "Coh. packet", "Inc. single", "Inc. packet", "Pkt. err", "Ref. err");
+
+	std::vector<SoftwareBVHBenchResult> results;
+	bool hasPacketMismatches = false;
+	bool hasReferenceMismatches = false;
+	for (const SoftwareBVHBenchDesc& desc : descs)
+	{
+		const SoftwareBVHBenchResult& result = results.emplace_back(RunSoftwareBVHBench(taskPool, desc));
+		std::printf("%12llu %10u %9.1f %9.2f %7.2f | %11.2f %11.2f %11.2f %11.2f | %8llu %8llu\n",
+			(unsigned long long)result.sceneTriangleCount,
+			result.desc.instanceCount,
+			result.blasBuildMs,
+			result.tlasBuildMs,
+			result.meanBLASSAHCost,
+			result.coherentSingleMrays,
+			result.coherentPacketMrays,
+			result.incoherentSingleMrays,
+			result.incoherentPacketMrays,
+			(unsigned long long)result.packetMismatchCount,
+			(unsigned long long)result.referenceMismatchCount);
+
+		hasPacketMismatches |= result.packetMismatchCount > 0u;
+		hasReferenceMismatches |= result.referenceMismatchCount > 0u;
+	}
+
+	std::printf("Rays in Mrays/s over %u threads.\n", taskPool.GetThreadCount());
+
+	if (!csvPath.empty() && !WriteResultsCSV(csvPath, results))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	if (hasPacketMismatches)
+	{
+		std::fprintf(stderr, "Packet and single ray tracing disagree.\n");
+		return 1;
+	}
+
+	if (hasReferenceMismatches)
+	{
+		std::fprintf(stderr, "The BVH disagrees with brute force.\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+// Times CompactGatherFilter(), see StreamCompaction.h, on the gather filters of cascade 1 at several resolutions and filter densities.
+// Compares the serial and the task pool compaction with testing every texel of the filter, what the gather does without
+// active probe-direction lists. Built by StreamCompactionBenchCLI.vcxproj.
+//
+// Returns 1 if the compactions disagree with each other, so it can run on CI.
+// Example: StreamCompactionBenchCLI --threads 8 --iterations 50
+
+#include "../CascadeLayout.h"
+#include "../StreamCompaction.h"
+#include "../TaskPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace CPUReference;
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: StreamCompactionBenchCLI [options]\n"
+			"  --threads <count>            Threads of the task pool, default 0 for every hardware thread.\n"
+			"  --iterations <count>         Timed runs per filter, the mean is printed. Default 20.\n"
+			"  --probe-spacing <spacing>    Probe spacing of cascade 0, default 2.\n"
+			"  --rays <count>               Rays per probe of cascade 0, default 16.\n");
+	}
+
+	// xorshift32.
+	uint32_t NextRandom(uint32_t& state)
+	{
+		state ^= state << 13u;
+		state ^= state >> 17u;
+		state ^= state << 5u;
+		return state;
+	}
+
+	template<typename Func>
+	double GetMeanMs(uint32_t iterationCount, const Func& func)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterationCount; i++)
+		{
+			func();
+		}
+
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / double(iterationCount);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threadCount = 0u;
+	uint32_t iterationCount = 20u;
+	CascadeLayoutDesc layoutDesc;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--threads") == 0) { threadCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--iterations") == 0) { iterationCount = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--probe-spacing") == 0) { layoutDesc.probeSpacing0 = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--rays") == 0) { layoutDesc.raysPerProbe0 = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	TaskPool taskPool(threadCount);
+
+	std::printf("%11s %11s %8s | %10s %10s %10s\n", "Resolution", "Filter", "Density", "Test (ms)", "Serial", "Task pool");
+
+	bool hasMismatches = false;
+	const uint32_t resolutions[][2] = { { 1920u, 1080u }, { 2560u, 1440u }, { 3840u, 2160u } };
+	for (const uint32_t* resolution : resolutions)
+	{
+		layoutDesc.width = resolution[0];
+		layoutDesc.height = resolution[1];
+
+		CascadeLayout cascadeLayout;
+		cascadeLayout.Generate(layoutDesc);
+		if (cascadeLayout.GetCascadeCount() < 2u)
+		{
+			continue;
+		}
+
+		const CascadeLevel& level = cascadeLayout.GetLevel(1u);
+		PackedGatherFilter filter(level.textureWidth, level.textureHeight);
+
+		for (float density : { 0.01f, 0.1f, 0.5f, 1.0f })
+		{
+			uint32_t randomState = 1u;
+			const uint32_t threshold = uint32_t(double(density) * double(UINT32_MAX));
+
+			filter.Clear();
+			for (uint32_t y = 0; y < filter.GetHeight(); y++)
+			{
+				for (uint32_t x = 0; x < filter.GetWidth(); x++)
+				{
+					if (density >= 1.0f || NextRandom(randomState) < threshold)
+					{
+						filter.Set((int32_t)x, (int32_t)y);
+					}
+				}
+			}
+
+			// What the gather does without lists: test the filter for every probe-direction.
+			uint64_t testedActiveCount = 0u;
+			const double testMs = GetMeanMs(iterationCount, [&]()
+				{
+					testedActiveCount = 0u;
+					for (uint32_t y = 0; y < filter.GetHeight(); y++)
+					{
+						for (uint32_t x = 0; x < filter.GetWidth(); x++)
+						{
+							testedActiveCount += filter.Test((int32_t)x, (int32_t)y) ? 1u : 0u;
+						}
+					}
+				});
+
+			std::vector<uint32_t> serialActiveTexels;
+			const double serialMs = GetMeanMs(iterationCount, [&]() { CompactGatherFilter(filter, serialActiveTexels); });
+
+			std::vector<uint32_t> taskPoolActiveTexels;
+			const double taskPoolMs = GetMeanMs(iterationCount, [&]() { CompactGatherFilter(filter, taskPool, taskPoolActiveTexels); });
+
+			hasMismatches |= serialActiveTexels != taskPoolActiveTexels || serialActiveTexels.size() != testedActiveCount;
+
+			const std::string filterSize = std::to_string(filter.GetWidth()) + "x" + std::to_string(filter.GetHeight());
+			std::printf("%5ux%-5u %11s %8.2f | %10.3f %10.3f %10.3f\n",
+				resolution[0], resolution[1], filterSize.c_str(), density, testMs, serialMs, taskPoolMs);
+		}
+	}
+
+	std::printf("Mean over %u iterations, task pool with %u threads.\n", iterationCount, taskPool.GetThreadCount());
+
+	if (hasMismatches)
+	{
+		std::fprintf(stderr, "Compactions disagree.\n");
+		return 1;
+	}
+
+	return 0;
+}
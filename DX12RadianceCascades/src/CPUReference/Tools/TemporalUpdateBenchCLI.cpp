@@ -0,0 +1,151 @@
+// Command line front end of RunTemporalUpdateSimulation(), see TemporalUpdateSimulation.h. Replays a camera path through the default scene
+// and prints the rays traced per frame with staggered cascade updates and the PSNR against a full refresh. Built by TemporalUpdateBenchCLI.vcxproj.
+//
+// Without --path the camera orbits the center of the scene, starting at the camera of CreateDefaultScene().
+// Example: TemporalUpdateBenchCLI --frames 64 --degrees-per-frame 1 --round-robin --csv staggered.csv
+
+#include "../ReferenceScene.h"
+#include "../TaskPool.h"
+#include "../TemporalUpdateSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace CPUReference;
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: TemporalUpdateBenchCLI [options]\n"
+			"  --threads <count>            Threads of the task pool, default 0 for every hardware thread.\n"
+			"  --width <pixels>             Screen width, default 480.\n"
+			"  --height <pixels>            Screen height, default 270.\n"
+			"  --frames <count>             Frames of the orbit, default 32.\n"
+			"  --degrees-per-frame <angle>  Rotation of the orbit per frame, default 0.5.\n"
+			"  --path <path>                Camera path to replay instead of the orbit, see ReadCameraPathCSV().\n"
+			"  --period-step <log2>         Cascade N is refreshed every 2^(N * step) frames, default 1.\n"
+			"  --max-period <log2>          Longest refresh period, default 3.\n"
+			"  --round-robin                Gather a band of rows every frame instead of whole cascades.\n"
+			"  --csv <path>                 Write every frame.\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t threadCount = 0u;
+	ReferenceSettings settings;
+	settings.layoutDesc.width = 480u;
+	settings.layoutDesc.height = 270u;
+	uint32_t frameCount = 32u;
+	float degreesPerFrame = 0.5f;
+	std::string pathFilePath;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		auto consumeValue = [&]() -> const char*
+		{
+			if (value == nullptr)
+			{
+				std::fprintf(stderr, "Missing value for %s.\n", arg);
+				std::exit(1);
+			}
+
+			i++;
+			return value;
+		};
+
+		if (std::strcmp(arg, "--threads") == 0) { threadCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--width") == 0) { settings.layoutDesc.width = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--height") == 0) { settings.layoutDesc.height = (std::max)((uint32_t)std::strtoul(consumeValue(), nullptr, 10), 1u); }
+		else if (std::strcmp(arg, "--frames") == 0) { frameCount = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--degrees-per-frame") == 0) { degreesPerFrame = std::strtof(consumeValue(), nullptr); }
+		else if (std::strcmp(arg, "--path") == 0) { pathFilePath = consumeValue(); }
+		else if (std::strcmp(arg, "--period-step") == 0) { settings.updateSchedule.periodLog2Step = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--max-period") == 0) { settings.updateSchedule.maxPeriodLog2 = (uint32_t)std::strtoul(consumeValue(), nullptr, 10); }
+		else if (std::strcmp(arg, "--round-robin") == 0) { settings.updateSchedule.useRoundRobinRows = true; }
+		else if (std::strcmp(arg, "--csv") == 0) { csvPath = consumeValue(); }
+		else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else
+		{
+			std::fprintf(stderr, "Unknown option %s.\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	TaskPool taskPool(threadCount);
+
+	ReferenceScene scene;
+	ReferenceCamera lensCamera;
+	CreateDefaultScene(scene, lensCamera, float(settings.layoutDesc.height) / float(settings.layoutDesc.width));
+
+	std::vector<CameraPathKey> path;
+	if (!pathFilePath.empty())
+	{
+		if (!ReadCameraPathCSV(pathFilePath, path))
+		{
+			std::fprintf(stderr, "Could not read %s.\n", pathFilePath.c_str());
+			return 1;
+		}
+	}
+	else
+	{
+		// Same eye and target as CreateDefaultScene().
+		const float3 eye = float3(0.0f, 7.0f, 18.0f);
+		const float3 target = float3(0.0f, 1.0f, -4.0f);
+		const float radius = std::sqrt((eye.x - target.x) * (eye.x - target.x) + (eye.z - target.z) * (eye.z - target.z));
+		path = CreateOrbitCameraPath(target, radius, eye.y - target.y, degreesPerFrame, frameCount);
+	}
+
+	const std::vector<TemporalUpdateFrameResult> results = RunTemporalUpdateSimulation(taskPool, settings, scene, lensCamera, path);
+
+	std::printf("%6s | %12s %12s %7s | %10s\n", "Frame", "Traced rays", "Full rays", "Ratio", "PSNR (dB)");
+
+	uint64_t tracedRayCount = 0u;
+	uint64_t fullRefreshRayCount = 0u;
+	double minPSNR = INFINITY;
+	for (const TemporalUpdateFrameResult& result : results)
+	{
+		std::printf("%6u | %12llu %12llu %7.3f | %10.2f\n",
+			result.frameIndex,
+			(unsigned long long)result.tracedRayCount,
+			(unsigned long long)result.fullRefreshRayCount,
+			double(result.tracedRayCount) / double((std::max)(result.fullRefreshRayCount, uint64_t(1u))),
+			result.coalescedPSNR);
+
+		tracedRayCount += result.tracedRayCount;
+		fullRefreshRayCount += result.fullRefreshRayCount;
+		minPSNR = (std::min)(minPSNR, result.coalescedPSNR);
+	}
+
+	if (!results.empty())
+	{
+		std::printf("Mean of %.0f rays per frame against %.0f with full refreshes (%.3f), lowest PSNR %.2f dB.\n",
+			double(tracedRayCount) / double(results.size()),
+			double(fullRefreshRayCount) / double(results.size()),
+			double(tracedRayCount) / double((std::max)(fullRefreshRayCount, uint64_t(1u))),
+			minPSNR);
+	}
+
+	if (!csvPath.empty() && !WriteTemporalUpdateResultsCSV(csvPath, results))
+	{
+		std::fprintf(stderr, "Could not write %s.\n", csvPath.c_str());
+		return 1;
+	}
+
+	return 0;
+}
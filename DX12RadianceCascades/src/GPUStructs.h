@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Utils.h"
+#include "..\Assets\shaders\RCCascadeDispatch.hlsli"
+
+constexpr uint32_t RCMaxCascadeCount = RC_MAX_CASCADE_COUNT;
 
 __declspec(align(16)) struct DebugRenderCameraInfo
 {
@@ -13,6 +16,7 @@ __declspec(align(16)) struct GlobalInfo
 	Utils::GPUMatrix invViewProjMatrix;
 	Utils::GPUMatrix invViewMatrix;
 	Utils::GPUMatrix invProjMatrix;
+	Utils::GPUMatrix prevViewProjMatrix;
 	Math::Vector3 cameraPos;
 	BOOL useSkybox;
 };
@@ -32,6 +36,18 @@ __declspec(align(16)) struct SourceInfo
 	uint32_t sourceHeight;
 };
 
+// Same as HIZ_MAX_MIP_COUNT and TILE_SIZE in HiZSinglePassCS.hlsl.
+constexpr uint32_t HiZMaxMipCount = 12;
+constexpr uint32_t HiZTileSize = 64;
+
+__declspec(align(16)) struct HiZInfo
+{
+	uint32_t sourceWidth;
+	uint32_t sourceHeight;
+	uint32_t mipCount;
+	uint32_t groupCount;
+};
+
 __declspec(align(16)) struct RCGlobals
 {
 	uint32_t probeScalingFactor; // Per dim.
@@ -46,12 +62,23 @@ __declspec(align(16)) struct RCGlobals
 	uint32_t probeCount0X; 
 	uint32_t probeCount0Y;
 	uint32_t probeSpacing0; // Spacing between probes in pixels.
+	BOOL useCascadeAtlas;
+	BOOL usePrecomputedMergeWeights;
+	BOOL useVisibilityPlane;
+	uint32_t tileOriginX; // Screen pixel of the top left corner of the cascades with tiled processing, see CPUReference/CascadeTiling.h.
+	uint32_t tileOriginY;
+	uint32_t padding[3]; // HLSL arrays start on a new 16 byte register.
+	DirectX::XMUINT4 cascadeAtlasRects[RCMaxCascadeCount]; // Offset (xy) and extent (zw) of each cascade inside the atlas.
 };
 
 __declspec(align(16)) struct CascadeInfo
 {
 	uint32_t cascadeIndex;
-	float padding[3];
+	BOOL useCascadeDispatchTable;
+	BOOL useActiveProbeDirectionLists;
+	uint32_t mergeWeightsOffset;
+	BOOL ignoreGatherFilter;
+	uint32_t dispatchOffsetY;
 };
 
 __declspec(align(16)) struct CascadeVisInfo
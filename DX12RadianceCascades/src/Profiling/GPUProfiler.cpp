@@ -1,4 +1,6 @@
 #include "rcpch.h"
+#include "Core\CommandListManager.h"
+#include "Core\Display.h"
 #include "GPUProfiler.h"
 
 #include <unordered_map>
@@ -30,8 +32,9 @@ GPUProfiler::GPUProfiler()
 	));
 
 	// Each entry is a 64 bit timestamp value.
-	m_queryResultBuffer.Create(L"GPUProfiler Readback buffer", MaxQueries, sizeof(uint64_t));
-	m_queryHeapMemory = reinterpret_cast<uint64_t*>(m_queryResultBuffer.Map());
+	m_queryResultRing.Create(L"GPUProfiler Readback Ring", MaxQueries * sizeof(uint64_t));
+	m_profileSamples.Reset(ReadbackRingBuffer::DefaultSlotCount);
+	BeginQueryResultWrite(Graphics::GetFrameCount());
 
 	// Create root of memory profile tree.
 	MemoryProfileNode memProfileRoot = {};
@@ -43,8 +46,13 @@ void GPUProfiler::DestroyImpl()
 {
 	m_vramAdapter = nullptr;
 	m_queryHeap = nullptr;
-	m_queryResultBuffer.Unmap();
-	m_queryResultBuffer.Destroy();
+	m_queryResultRing.Destroy();
+}
+
+void GPUProfiler::BeginQueryResultWrite(uint64_t frameIndex)
+{
+	m_isResolvingQueries = m_queryResultRing.BeginWrite(frameIndex, m_queryResultOffset);
+	m_profileSamples.BeginFrame(frameIndex);
 }
 
 uint64_t GPUProfiler::GetCurrentVRAMUsageBytes()
@@ -141,15 +149,20 @@ void GPUProfiler::EndPerformanceProfile(ID3D12GraphicsCommandList* commandList,
 	const uint32_t startQueryIndex = profileIndex * 2;
 	commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, startQueryIndex + 1);
 
-	// Resolve data into readback buffer.
-	commandList->ResolveQueryData(
-		m_queryHeap.Get(),
-		D3D12_QUERY_TYPE_TIMESTAMP,
-		startQueryIndex,
-		2,
-		m_queryResultBuffer.GetResource(),
-		startQueryIndex * sizeof(uint64_t) // Offset in bytes
-	);
+	// Resolve data into the readback slot of this frame.
+	if (m_isResolvingQueries)
+	{
+		commandList->ResolveQueryData(
+			m_queryHeap.Get(),
+			D3D12_QUERY_TYPE_TIMESTAMP,
+			startQueryIndex,
+			2,
+			m_queryResultRing.GetBuffer().GetResource(),
+			m_queryResultOffset + startQueryIndex * sizeof(uint64_t) // Offset in bytes
+		);
+
+		m_profileSamples.MarkResolved(profileIndex);
+	}
 
 	m_profiles[profileIndex].isQuerying = false;
 
@@ -194,26 +207,55 @@ float GPUProfiler::GetCurrentVRAMUsage(MemoryUnit memoryUnit /* = MegaByte */)
 
 void GPUProfiler::UpdatePerformanceProfiles(uint64_t timestampFrequency)
 {
-	ASSERT(m_queryHeapMemory != nullptr);
+	const uint64_t currentFrameIndex = Graphics::GetFrameCount();
 
+	uint64_t frameAge = 0u;
+	const uint64_t* queryResults = reinterpret_cast<const uint64_t*>(m_queryResultRing.GetLatest(currentFrameIndex, &frameAge));
+	if (queryResults == nullptr)
+	{
+		return;
+	}
+
+	const uint32_t sampledMask = m_profileSamples.ReadFrame(currentFrameIndex - frameAge, queryResults, m_profileCount, (double)timestampFrequency);
 	for (uint32_t i = 0u; i < m_profileCount; i++)
 	{
-		const uint32_t queryStartIndex = i * 2;
 		PerfProfile& perfProfile = m_profiles[i];
 
 		ASSERT(perfProfile.isQuerying == false);
 
-		uint64_t startTime = m_queryHeapMemory[queryStartIndex];
-		uint64_t endTime = m_queryHeapMemory[queryStartIndex + 1];
+		float frameTimeMS = 0.0f;
+		if ((sampledMask & (1u << i)) != 0u && m_profileSamples.GetLastSample(i, frameTimeMS))
+		{
+			perfProfile.timeSamples[perfProfile.currentSampleCount++ % MaxFrametimeSampleCount] = frameTimeMS;
+		}
+	}
+}
+
+bool GPUProfiler::GetLastSample(const char* name, float& sampleMsOut) const
+{
+	ASSERT(name != nullptr);
 
-		double frameTimeMS = double(endTime - startTime) / timestampFrequency * 1000.0;
-		perfProfile.timeSamples[perfProfile.currentSampleCount++ % MaxFrametimeSampleCount] = (float)frameTimeMS;
+	// Compared by contents, callers outside the profiled code do not share its string literals.
+	for (uint32_t i = 0u; i < m_profileCount; i++)
+	{
+		if (strcmp(m_profiles[i].name, name) == 0)
+		{
+			return m_profileSamples.GetLastSample(i, sampleMsOut);
+		}
 	}
+
+	return false;
 }
 
 void GPUProfiler::UpdateData(uint64_t timestampFrequency)
 {
+	// Every pass of the frame has been submitted, so the next signal on the graphics queue follows all of its resolves.
+	m_queryResultRing.EndWrite(Graphics::g_CommandManager.GetGraphicsQueue().IncrementFence());
+
 	UpdatePerformanceProfiles(timestampFrequency);
+
+	// Passes recorded after this, like the UI, land in the next frame.
+	BeginQueryResultWrite(Graphics::GetFrameCount() + 1u);
 }
 
 void GPUProfiler::DrawProfilerUI()
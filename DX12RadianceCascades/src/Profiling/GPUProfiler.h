@@ -3,13 +3,14 @@
 #include <array>
 #include <stack>
 
-#include "Core\ReadbackBuffer.h"
+#include "ReadbackRingBuffer.h"
 #include "Core\CommandContext.h"
 
 //TODO: These variables should be under a namespace probably.
 
 constexpr uint32_t MaxProfiles = 16u;
 constexpr uint32_t MaxQueries = MaxProfiles * 2; // Two queries per profile.
+static_assert(MaxProfiles <= CPUReference::ReadbackProfileSamples::MaxProfileCount, "Resolved profiles of a frame are tracked in a 32 bit mask.");
 
 #if defined(RUN_TESTS)
 constexpr uint32_t MaxFrametimeSampleCount = 128u;
@@ -87,6 +88,8 @@ public:
 	uint32_t StartPerformanceProfile(ID3D12GraphicsCommandList* commandList, const char* name);
 	void EndPerformanceProfile(ID3D12GraphicsCommandList* commandList, uint32_t profileIndex);
 	const std::array<PerfProfile, MaxProfiles>& GetProfiles() const { return m_profiles; }
+	// Last sample of the profile with the given name, false if it has not been profiled yet.
+	bool GetLastSample(const char* name, float& sampleMsOut) const;
 
 	// Returns just created profile.
 	std::shared_ptr<MemoryProfileNode> PushMemoryProfile(const char* name);
@@ -94,8 +97,10 @@ public:
 
 	float GetCurrentVRAMUsage(MemoryUnit memoryUnit = MemoryUnit::MegaByte);
 
+	// Adds a sample to every profile resolved in the most recent frame whose queries the GPU is done with, if it has not been read yet.
 	void UpdatePerformanceProfiles(uint64_t timestampFrequency);
 
+	// Call once per frame after the last profiled pass has been submitted. Never waits on the GPU, samples are a few frames old.
 	void UpdateData(uint64_t timestampFrequency);
 
 	// Profiles that has not been updated this frame are not rendered.
@@ -111,6 +116,9 @@ private:
 
 	uint64_t GetCurrentVRAMUsageBytes();
 
+	// Queries of the frame are resolved into the ring slot handed out here, none are if the frame is dropped.
+	void BeginQueryResultWrite(uint64_t frameIndex);
+
 	void DrawMemoryProfileTree(std::shared_ptr<MemoryProfileNode> root, MemoryUnit defaultMemoryUnit = MemoryUnit::MegaByte);
 
 public:
@@ -129,9 +137,12 @@ private:
 	Microsoft::WRL::ComPtr<IDXGIAdapter3> m_vramAdapter = nullptr;
 	// Each query profile reserves two consecutive entries. One for start and one for end.
 	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_queryHeap = nullptr;
-	ReadbackBuffer m_queryResultBuffer;
-	// Mapped memoryptr to result buffer.
-	uint64_t* m_queryHeapMemory = nullptr;
+	// One slot of MaxQueries timestamps per frame in flight.
+	ReadbackRingBuffer m_queryResultRing;
+	uint64_t m_queryResultOffset = 0u;
+	bool m_isResolvingQueries = false;
+	// Which profiles were resolved in each frame and the last sample of every profile.
+	CPUReference::ReadbackProfileSamples m_profileSamples;
 
 	std::shared_ptr<MemoryProfileNode> m_memoryRoot = nullptr;
 	std::shared_ptr<MemoryProfileNode> m_memoryRootHead = nullptr;
@@ -3,9 +3,18 @@
 #include "Core\CommandListManager.h"
 #include "Core\CommandContext.h"
 #include "Core\ColorBuffer.h"
-#include "Core\ReadbackBuffer.h"
+
+#include "CPUReference\CascadeAtlasLayout.h"
+#include "CPUReference\CascadeCostModel.h"
+#include "CPUReference\CascadeUpdateScheduler.h"
+#include "CPUReference\DeferredReleaseQueue.h"
+#include "CPUReference\IntervalEncoding.h"
+#include "CPUReference\ScalingPermutations.h"
+
+#include "ReadbackRingBuffer.h"
 
 struct RCGlobals;
+namespace RCShaderShared { struct CascadeDispatchTable; }
 
 struct ProbeDims
 {
@@ -17,6 +26,17 @@ struct RC3DSettings
 {
 	bool useGatherFiltering = true;
 	bool useDepthAwareMerging = false;
+	// Computes the depth aware merge weights once per probe in a pre-pass instead of once per probe-direction during the merge.
+	bool usePrecomputedMergeWeights = true;
+	// Writes the coalesced result while merging cascade 0 instead of reading all of cascade 0 again in a separate coalesce pass.
+	bool useFusedMergeCoalesce = true;
+	// Merges with the kernel permutation compiled for the current scaling factors instead of reading them at runtime.
+	bool useSpecializedMergeKernels = true;
+	// Gathers every cascade with a single DispatchRays. Only applies to the cascade atlas without gather filtering,
+	// as cascade N + 1 reads the gather filter written by cascade N.
+	bool useSingleGatherDispatch = false;
+	// How often each cascade is gathered with staggered updates, the other frames it is reprojected from its history.
+	CPUReference::CascadeUpdateScheduleDesc updateSchedule;
 	
 	float rayLength0 = 5.0f;
 	
@@ -27,8 +47,23 @@ struct RC3DSettings
 		int raysPerProbe0 = 16;
 		int maxCascadeCount = 8;
 
+		// Storage of the cascade intervals. The packed formats keep visibility in a separate R8 texture per cascade (or atlas).
+		// RGB9E5 cannot be written through a UAV and falls back to FP16, it is only compared on the CPU (see CPUReference/Tests/IntervalEncodingTests.cpp).
+		CPUReference::IntervalFormat intervalFormat = CPUReference::IntervalFormatFP16;
+
 		// Signifies that the cascade textures will be 1 / rayscalingfactor of the original size.
 		bool isUsingPreAveragedIntervals = true;
+
+		// Packs all cascade intervals into a single texture. Falls back to one texture per cascade if the atlas does not fit.
+		bool useCascadeAtlas = false;
+
+		// With gather filtering, each cascade appends the probe-directions it flags to a list for the next cascade,
+		// which is then gathered with an indirect DispatchRays over only those. Requires raytracing tier 1.1.
+		bool useActiveProbeDirectionLists = false;
+
+		// Keeps a copy of every cascade above 0 from the last frame, so that the upper cascades only have to be gathered every few frames.
+		// See RC3DSettings::updateSchedule.
+		bool useStaggeredUpdates = false;
 	} staticParams;
 };
 
@@ -37,11 +72,15 @@ class RadianceCascadeManager3D
 public:
 	RadianceCascadeManager3D() = default;
 
+	// Does not wait for the GPU, the resources of the frames in flight are released by ReleaseRetiredResources() once they are done.
 	void Generate(uint32_t raysPerProbe0, uint32_t probeSpacing0, uint32_t swapchainWidth, uint32_t swapchainHeight, uint32_t maxAllowedCascadeLevels = 8u);
+	// Called once per frame.
+	void ReleaseRetiredResources();
 	// Calls Generate() using internal values with other width and height parameters.
 	void Resize(uint32_t width, uint32_t height);
 
 	void FillRCGlobalInfo(RCGlobals& rcGlobalInfo);
+	void FillCascadeDispatchTable(RCShaderShared::CascadeDispatchTable& cascadeDispatchTable);
 
 	void ClearBuffers(GraphicsContext& gfxContext);
 	uint32_t GetRaysPerProbe(uint32_t cascadeIndex);
@@ -53,26 +92,82 @@ public:
 	float GetStartT(uint32_t cascadeIndex);
 	float GetRayLength(uint32_t cascadeIndex);
 
-	uint32_t GetCascadeIntervalCount() { return (uint32_t)m_cascadeIntervals.size(); }
+	uint32_t GetCascadeIntervalCount() { return (uint32_t)m_cascadeExtents.size(); }
+	// Cascades that are gathered and merged, the last one samples the sky on a miss. See SetActiveCascadeLimit().
+	uint32_t GetActiveCascadeCount() const { return (std::max)((std::min)(m_activeCascadeLimit, (uint32_t)m_cascadeExtents.size()), 1u); }
 	// Always one less than cascade interval count.
-	uint32_t GetGatherFilterCount() { return (uint32_t)m_cascadeGatherFilters.size(); }
+	uint32_t GetGatherFilterCount() { return (uint32_t)m_resources->cascadeGatherFilters.size(); }
+	// Returns the cascade atlas for every cascade if it is used, GetCascadeIntervalRect() gives the region of the cascade.
 	ColorBuffer& GetCascadeIntervalBuffer(uint32_t cascadeIndex);
-	ColorBuffer& GetCascadeGatherFilterBuffer(uint32_t filterIndex);
-	ByteAddressBuffer& GetGatherFilterByteAddressBuffer() { return m_gatherFilterByteAddressBuffer; }
-	ReadbackBuffer& GetGatherFilterReadbackBuffer() { return m_gatherFilterReadbackBuffer; }
+	D3D12_RECT GetCascadeIntervalRect(uint32_t cascadeIndex);
+	uint32_t GetCascadeIntervalWidth(uint32_t cascadeIndex);
+	uint32_t GetCascadeIntervalHeight(uint32_t cascadeIndex);
+	ColorBuffer& GetCascadeAtlasBuffer() { ASSERT(UsesCascadeAtlas()); return m_resources->cascadeAtlas; }
+	// Same layout as GetCascadeIntervalBuffer(), only allocated if UsesVisibilityPlane().
+	ColorBuffer& GetCascadeVisibilityBuffer(uint32_t cascadeIndex);
+	// Cascade intervals of the last frame before they were merged, only allocated if UsesStaggeredUpdates(). Returns the history atlas if the cascade atlas is used.
+	ColorBuffer& GetCascadeHistoryBuffer(uint32_t cascadeIndex);
+	ColorBuffer& GetCascadeVisibilityHistoryBuffer(uint32_t cascadeIndex);
+	ByteAddressBuffer& GetCascadeGatherFilterBuffer(uint32_t filterIndex);
+	// Dimensions of the probe-direction texels a gather filter covers, the buffer itself is bit packed.
+	uint32_t GetGatherFilterWidth(uint32_t filterIndex);
+	uint32_t GetGatherFilterHeight(uint32_t filterIndex);
+	ByteAddressBuffer& GetGatherFilterByteAddressBuffer() { return m_resources->gatherFilterByteAddressBuffer; }
+	ReadbackRingBuffer& GetGatherFilterReadbackRing() { return m_resources->gatherFilterReadbackRing; }
+	ByteAddressBuffer& GetActiveProbeDirectionBuffer() { ASSERT(UsesActiveProbeDirectionLists()); return m_resources->activeProbeDirections; }
+	ByteAddressBuffer& GetActiveProbeDirectionCountBuffer() { ASSERT(UsesActiveProbeDirectionLists()); return m_resources->activeProbeDirectionCounts; }
+	IndirectArgsBuffer& GetGatherDispatchArgsBuffer() { ASSERT(UsesActiveProbeDirectionLists()); return m_resources->gatherDispatchArgs; }
+	StructuredBuffer& GetMergeWeightsBuffer() { ASSERT(UsesPrecomputedMergeWeights()); return m_resources->mergeWeights; }
+	// Index of the first probe of a cascade in the merge weights buffer.
+	uint32_t GetMergeWeightsOffset(uint32_t cascadeIndex);
 	uint32_t GetProbeScalingFactor() const { return m_scalingFactor.probeScalingFactor; }
 	uint32_t GetRayScalingFactor() const { return m_scalingFactor.rayScalingFactor; }
+	// Index of the merge kernel permutation to use, CPUReference::InvalidScalingPermutation for the kernels that read the scaling factors at runtime.
+	uint32_t GetMergeScalingPermutation() const;
+	// Format the cascades were allocated with, which can differ from the one in the settings if it is not supported.
+	CPUReference::IntervalFormat GetIntervalFormat() const { return m_intervalFormat; }
+	bool UsesVisibilityPlane() const { return CPUReference::HasVisibilityPlane(m_intervalFormat); }
 	bool UsesPreAveragedIntervals() const { return m_rcSettings.staticParams.isUsingPreAveragedIntervals; }
 	bool UsesGatherFiltering() const { return m_rcSettings.useGatherFiltering; }
+	bool UsesCascadeAtlas() const { return !m_cascadeAtlasLayout.IsEmpty(); }
+	bool UsesSingleGatherDispatch();
+	bool UsesActiveProbeDirectionLists() const { return m_hasActiveProbeDirectionLists && UsesGatherFiltering(); }
+	// Needs at least two cascades, a single cascade is never merged.
+	bool UsesFusedMergeCoalesce() const { return m_rcSettings.useFusedMergeCoalesce && m_cascadeExtents.size() > 1; }
+	bool UsesStaggeredUpdates() const { return m_hasCascadeHistory; }
+	bool UsesPrecomputedMergeWeights() const { return m_rcSettings.useDepthAwareMerging && m_rcSettings.usePrecomputedMergeWeights && m_cascadeExtents.size() > 1; }
 
 	void SetGatherFiltering(bool useGatherFiltering) { m_rcSettings.useGatherFiltering = useGatherFiltering; }
-
-	ColorBuffer& GetCoalesceBuffer() { return m_coalescedResult; }
+	float GetRayLength0() const { return m_rcSettings.rayLength0; }
+	void SetRayLength0(float rayLength0) { m_rcSettings.rayLength0 = rayLength0; }
+	// Leaves the cascades above the limit out without regenerating. Their history is stale once they come back, so it is reset on a change.
+	void SetActiveCascadeLimit(uint32_t activeCascadeLimit);
+	const CPUReference::CascadeUpdateScheduleDesc& GetCascadeUpdateSchedule() const { return m_rcSettings.updateSchedule; }
+	void SetCascadeUpdateSchedule(const CPUReference::CascadeUpdateScheduleDesc& updateSchedule);
+	uint32_t GetRaysPerProbe0() const { return (uint32_t)m_rcSettings.staticParams.raysPerProbe0; }
+	uint32_t GetProbeSpacing0() const { return (uint32_t)m_rcSettings.staticParams.probeSpacing0; }
+	// Generate() with new cascade 0 parameters and everything else as it is.
+	void Regenerate(uint32_t raysPerProbe0, uint32_t probeSpacing0);
+
+	// Always a full update without staggered updates.
+	CPUReference::CascadeUpdate GetCascadeUpdate(uint32_t cascadeIndex);
+	uint32_t GetCascadeRefreshPeriod(uint32_t cascadeIndex) { return UsesStaggeredUpdates() ? m_updateScheduler.GetRefreshPeriod(cascadeIndex) : 1u; }
+	// Called once the history has been written for the frame.
+	void AdvanceCascadeUpdateFrame() { m_updateScheduler.AdvanceFrame(); }
+	// Every cascade is gathered in the next frame, for when the history is no longer valid.
+	void ResetCascadeHistory() { m_updateScheduler.Reset(); }
+
+	ColorBuffer& GetCoalesceBuffer() { return m_resources->coalescedResult; }
 
 	uint64_t GetTotalVRAMUsage();
+	// Analytic cost of the current settings, see CPUReference/CascadeCostModel.h. Its bytes leave out the padding GetTotalVRAMUsage() includes.
+	CPUReference::CascadeCost GetCascadeCost() const;
 
-	// Will return the amount of rays that were filtered by a specific gather filter.
+	// Will return the amount of rays that were filtered by a specific gather filter in the most recent reduction the GPU is done with.
+	// Returns 0 if there is none yet.
 	uint32_t GetFilteredRayCount(uint32_t filterIndex);
+	// How many frames old the counts of GetFilteredRayCount() are, false if there is no reduction to read yet.
+	bool GetFilteredRayCountFrameAge(uint64_t& frameAgeOut);
 
 	void DrawRCSettingsUI();
 
@@ -80,23 +175,68 @@ private:
 
 	// Will update resource managers descriptors of RC resources.
 	void UpdateResourceDescriptors();
+	// Retires the current resource set and switches to the other one, waiting for the GPU only if that one is still retired.
+	void SwapResourceSets();
 
 private:
+	// Changed from the settings UI, which only lists factors with a specialized merge kernel (see CPUReference/ScalingPermutations.h).
 	struct ScalingFactor
 	{
-		uint32_t probeScalingFactor = 2u;
+		uint32_t probeScalingFactor = 2u; // Per dim.
 		uint32_t rayScalingFactor = 4u; // This needs to be a perfect square.
 	} m_scalingFactor;
 
-	std::vector<ColorBuffer> m_cascadeIntervals;
-	// Will have same dimensions for color buffers for all but cascade level 0.
-	std::vector<ColorBuffer> m_cascadeGatherFilters;
-	ColorBuffer m_coalescedResult;
-
-	// TODO: Move this to rcmanager3d as these resources heavily depend on its state. They should be re-generated if rc is re-generated.
-	ByteAddressBuffer m_gatherFilterByteAddressBuffer;
-	ReadbackBuffer m_gatherFilterReadbackBuffer;
-	uint32_t* m_gatherFilterReadbackBufferMappedPtr = nullptr;
+	// Every GPU resource that is rebuilt by Generate().
+	struct CascadeResources
+	{
+		// Empty if the cascade atlas is used.
+		std::vector<ColorBuffer> cascadeIntervals;
+		ColorBuffer cascadeAtlas;
+		// Visibility of the cascade intervals if the interval format has no alpha, one per cascade interval or one for the atlas.
+		std::vector<ColorBuffer> cascadeVisibility;
+		ColorBuffer cascadeAtlasVisibility;
+		// Only allocated with staggered updates. History index i belongs to cascade i + 1, one atlas sized history instead if the cascade atlas is used.
+		std::vector<ColorBuffer> cascadeHistory;
+		std::vector<ColorBuffer> cascadeVisibilityHistory;
+		ColorBuffer cascadeAtlasHistory;
+		ColorBuffer cascadeAtlasVisibilityHistory;
+		// One bit per texel of every cascade interval but cascade level 0.
+		std::vector<ByteAddressBuffer> cascadeGatherFilters;
+		ColorBuffer coalescedResult;
+
+		// Only allocated if active probe-direction lists are used. Lists of cascade 1 and up share one buffer, see GetActiveProbeDirectionListOffset().
+		ByteAddressBuffer activeProbeDirections;
+		// One counter per cascade, copied into the Width of the matching dispatch args before each indirect dispatch.
+		ByteAddressBuffer activeProbeDirectionCounts;
+		// One D3D12_DISPATCH_RAYS_DESC per cascade.
+		IndirectArgsBuffer gatherDispatchArgs;
+
+		// One float4 of depth aware merge weights per probe of every cascade but the last one, see RCMergeWeights3DCS.hlsl.
+		// Only allocated if there is more than one cascade.
+		StructuredBuffer mergeWeights;
+
+		ByteAddressBuffer gatherFilterByteAddressBuffer;
+		// One uint32_t per gather filter per slot.
+		ReadbackRingBuffer gatherFilterReadbackRing;
+	};
+
+	// Generate() builds the set the GPU is done with, so the frames in flight keep using the current one along with the descriptors
+	// that were copied for it. The current set is retired and released once the GPU is done with it.
+	static constexpr uint32_t ResourceSetCount = 2u;
+	std::array<CascadeResources, ResourceSetCount> m_resourceSets;
+	CascadeResources* m_resources = &m_resourceSets[0];
+	uint32_t m_resourceSetIndex = 0u;
+	std::array<uint64_t, ResourceSetCount> m_resourceSetRetireFences = {};
+	CPUReference::DeferredReleaseQueue m_releaseQueue;
+	CommandQueueReadbackFence m_releaseFence;
+
+	std::vector<CPUReference::CascadeExtent> m_cascadeExtents;
+	CPUReference::CascadeAtlasLayout m_cascadeAtlasLayout;
+	CPUReference::IntervalFormat m_intervalFormat = CPUReference::IntervalFormatFP16;
+	CPUReference::CascadeUpdateScheduler m_updateScheduler;
+	bool m_hasCascadeHistory = false;
+	uint32_t m_activeCascadeLimit = UINT32_MAX; // No limit.
+	bool m_hasActiveProbeDirectionLists = false;
 
 	uint32_t m_probeCount0X = 0u;
 	uint32_t m_probeCount0Y = 0u;
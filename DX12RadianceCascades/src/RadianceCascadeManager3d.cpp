@@ -1,19 +1,17 @@
 #include "rcpch.h"
 #include "Core\DepthBuffer.h"
 #include "Core\GraphicsCore.h"
+#include "Core\Display.h"
 
 #include "GPUStructs.h"
 #include "RadianceCascadeManager3D.h"
 #include "RuntimeResourceManager.h"
 
 #include "AppGUI\AppGUI.h"
+#include "CPUReference\GatherFilterBits.h"
 
 constexpr DXGI_FORMAT DefaultFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
-// Using R8_UINT instead of R8_UNORM for these textures (and corrected shader code) has the same performance (down to 0.01 ms).
-// I chose R8_UNORM to better work with shaders that expect floating point texel samples, like my debug visualziation shaders.
-// TODO: Because gather filtering only checks for 0 or 1, there could exist a solution where only certain bits is modified of each texel but I worry for
-// data races as I am doubtful that concurrently modifying bits inside of the same word is possible.
-constexpr DXGI_FORMAT DefaultGatherFilterFormat = DXGI_FORMAT_R8_UNORM;
+constexpr DXGI_FORMAT VisibilityFormat = DXGI_FORMAT_R8_UNORM;
 
 namespace
 {
@@ -34,12 +32,31 @@ namespace
 
 		return allocInfo.SizeInBytes;
 	}
+
+	DXGI_FORMAT GetIntervalDXGIFormat(CPUReference::IntervalFormat intervalFormat)
+	{
+		switch (intervalFormat)
+		{
+		case CPUReference::IntervalFormatR11G11B10:
+			return DXGI_FORMAT_R11G11B10_FLOAT;
+		case CPUReference::IntervalFormatRGB9E5:
+			return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+		default:
+			return DefaultFormat;
+		}
+	}
 }
 
 void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSpacing0, uint32_t swapchainWidth, uint32_t swapchainHeight, uint32_t maxAllowedCascadeLevels /*= 8*/)
 {
-	// Make sure no work is on the GPU before generating.
-	Graphics::g_CommandManager.IdleGPU();
+	SwapResourceSets();
+
+	if (!CPUReference::IsValidRayCount0(raysPerProbe0, m_scalingFactor.rayScalingFactor, m_rcSettings.staticParams.isUsingPreAveragedIntervals))
+	{
+		const uint32_t validRaysPerProbe0 = CPUReference::GetValidRayCount0(raysPerProbe0, m_scalingFactor.rayScalingFactor, m_rcSettings.staticParams.isUsingPreAveragedIntervals);
+		LOG_WARNING(L"{} rays per probe does not work with a ray scaling factor of {}, using {} instead.", raysPerProbe0, m_scalingFactor.rayScalingFactor, validRaysPerProbe0);
+		raysPerProbe0 = validRaysPerProbe0;
+	}
 
 	// Probe counts are rounded down to the nearest integer.
 	// If they are rounded up, probes in higher cascades would be placed far outside the screen.
@@ -55,15 +72,15 @@ void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSp
 		maxCalculatedCascadeLevels = maxAllowedCascadeLevels;
 	}
 
-	m_cascadeIntervals.resize(maxCalculatedCascadeLevels);
-	m_cascadeGatherFilters.resize(maxCalculatedCascadeLevels - 1);
+	m_cascadeExtents.resize(maxCalculatedCascadeLevels);
+	m_resources->cascadeGatherFilters.resize(maxCalculatedCascadeLevels - 1);
 
 	uint32_t raysPerProbe = raysPerProbe0;
+	uint32_t mergeWeightCount = 0;
 	ProbeDims probeDims = { probeCount0X, probeCount0Y };
 	for (uint32_t i = 0; i < maxCalculatedCascadeLevels; i++)
 	{
-		std::wstring cascadeName = std::wstring(L"Cascade Interval ") + std::to_wstring(i);
-		std::wstring cascadeFilterName = cascadeName + L" Gather Filter";
+		std::wstring cascadeFilterName = std::wstring(L"Cascade Interval ") + std::to_wstring(i) + L" Gather Filter";
 
 		// If pre averaged intervals are used, each original ray will average the rays that would be averaged into the lower cascades.
 		// This means that each dispatched pixel, representing a probe and a direciton, will already account for the information of rays equal to rayScalingFactor.
@@ -72,16 +89,21 @@ void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSp
 		const uint32_t probeBufferWidth = probeDims.probesX * raysPerProbeDim;
 		const uint32_t probeBufferHeight = probeDims.probesY * raysPerProbeDim;
 
-		// Clear color has alpha of 0.0, indicating that each cascade assumes that its rays are obscured.
-		m_cascadeIntervals[i].SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
-		m_cascadeIntervals[i].Create(cascadeName, probeBufferWidth, probeBufferHeight, 1, DefaultFormat);
+		m_cascadeExtents[i] = { probeBufferWidth, probeBufferHeight };
 
 		if (i > 0)
 		{
 			uint32_t filterIndex = i - 1;
 
-			m_cascadeGatherFilters[filterIndex].SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
-			m_cascadeGatherFilters[filterIndex].Create(cascadeFilterName, probeBufferWidth, probeBufferHeight, 1, DefaultGatherFilterFormat);
+			// One bit per texel of the cascade interval. Bits are set with InterlockedOr so concurrent writes to the same word are safe.
+			const uint32_t filterWordCount = CPUReference::GetGatherFilterWordCount(probeBufferWidth, probeBufferHeight);
+			m_resources->cascadeGatherFilters[filterIndex].Create(cascadeFilterName, filterWordCount, sizeof(uint32_t));
+		}
+
+		// The last cascade has nothing to merge with.
+		if (i < maxCalculatedCascadeLevels - 1)
+		{
+			mergeWeightCount += probeDims.probesX * probeDims.probesY;
 		}
 
 		probeDims.probesX /= m_scalingFactor.probeScalingFactor;
@@ -89,8 +111,148 @@ void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSp
 		raysPerProbe *= m_scalingFactor.rayScalingFactor;
 	}
 
+	m_cascadeAtlasLayout = {};
+	if (m_rcSettings.staticParams.useCascadeAtlas && !m_cascadeAtlasLayout.Generate(m_cascadeExtents))
+	{
+		LOG_WARNING(L"Cascades do not fit inside a single atlas, falling back to one texture per cascade.");
+	}
+
+	m_intervalFormat = m_rcSettings.staticParams.intervalFormat;
+	if (m_intervalFormat == CPUReference::IntervalFormatRGB9E5)
+	{
+		LOG_WARNING(L"RGB9E5 is not a UAV format, falling back to FP16 cascade intervals.");
+		m_intervalFormat = CPUReference::IntervalFormatFP16;
+	}
+
+	const DXGI_FORMAT intervalFormat = GetIntervalDXGIFormat(m_intervalFormat);
+	const bool useVisibilityPlane = UsesVisibilityPlane();
+
+	// Clear color has alpha of 0.0, indicating that each cascade assumes that its rays are obscured.
+	// The same goes for the visibility planes, which hold the alpha instead if the interval format has none.
+	if (UsesCascadeAtlas())
+	{
+		ASSERT(m_cascadeAtlasLayout.Validate());
+
+		m_resources->cascadeIntervals.clear();
+		m_resources->cascadeVisibility.clear();
+
+		m_resources->cascadeAtlas.SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+		m_resources->cascadeAtlas.Create(L"Cascade Atlas", m_cascadeAtlasLayout.GetWidth(), m_cascadeAtlasLayout.GetHeight(), 1, intervalFormat);
+
+		if (useVisibilityPlane)
+		{
+			m_resources->cascadeAtlasVisibility.SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+			m_resources->cascadeAtlasVisibility.Create(L"Cascade Atlas Visibility", m_cascadeAtlasLayout.GetWidth(), m_cascadeAtlasLayout.GetHeight(), 1, VisibilityFormat);
+		}
+		else
+		{
+			m_resources->cascadeAtlasVisibility.Destroy();
+		}
+	}
+	else
+	{
+		m_resources->cascadeAtlas.Destroy();
+		m_resources->cascadeAtlasVisibility.Destroy();
+
+		m_resources->cascadeIntervals.resize(maxCalculatedCascadeLevels);
+		m_resources->cascadeVisibility.resize(useVisibilityPlane ? maxCalculatedCascadeLevels : 0);
+		for (uint32_t i = 0; i < maxCalculatedCascadeLevels; i++)
+		{
+			std::wstring cascadeName = std::wstring(L"Cascade Interval ") + std::to_wstring(i);
+
+			m_resources->cascadeIntervals[i].SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+			m_resources->cascadeIntervals[i].Create(cascadeName, m_cascadeExtents[i].width, m_cascadeExtents[i].height, 1, intervalFormat);
+
+			if (useVisibilityPlane)
+			{
+				m_resources->cascadeVisibility[i].SetClearColor(Color(0.0f, 0.0f, 0.0f, 0.0f));
+				m_resources->cascadeVisibility[i].Create(cascadeName + L" Visibility", m_cascadeExtents[i].width, m_cascadeExtents[i].height, 1, VisibilityFormat);
+			}
+		}
+	}
+
+	// History is a copy of the cascades before they are merged, so it has the same format and layout. Cascade 0 is gathered every frame and has none.
+	m_hasCascadeHistory = m_rcSettings.staticParams.useStaggeredUpdates && maxCalculatedCascadeLevels > 1;
+	// Resized instead of cleared, so that the buffers that are kept reuse their descriptor handles.
+	const uint32_t cascadeHistoryCount = m_hasCascadeHistory && !UsesCascadeAtlas() ? maxCalculatedCascadeLevels - 1 : 0;
+	m_resources->cascadeHistory.resize(cascadeHistoryCount);
+	m_resources->cascadeVisibilityHistory.resize(useVisibilityPlane ? cascadeHistoryCount : 0);
+	m_resources->cascadeAtlasHistory.Destroy();
+	m_resources->cascadeAtlasVisibilityHistory.Destroy();
+	if (m_hasCascadeHistory)
+	{
+		if (UsesCascadeAtlas())
+		{
+			m_resources->cascadeAtlasHistory.Create(L"Cascade Atlas History", m_cascadeAtlasLayout.GetWidth(), m_cascadeAtlasLayout.GetHeight(), 1, intervalFormat);
+
+			if (useVisibilityPlane)
+			{
+				m_resources->cascadeAtlasVisibilityHistory.Create(L"Cascade Atlas Visibility History", m_cascadeAtlasLayout.GetWidth(), m_cascadeAtlasLayout.GetHeight(), 1, VisibilityFormat);
+			}
+		}
+		else
+		{
+			for (uint32_t i = 1; i < maxCalculatedCascadeLevels; i++)
+			{
+				std::wstring historyName = std::wstring(L"Cascade Interval ") + std::to_wstring(i) + L" History";
+
+				m_resources->cascadeHistory[i - 1].Create(historyName, m_cascadeExtents[i].width, m_cascadeExtents[i].height, 1, intervalFormat);
+
+				if (useVisibilityPlane)
+				{
+					m_resources->cascadeVisibilityHistory[i - 1].Create(historyName + L" Visibility", m_cascadeExtents[i].width, m_cascadeExtents[i].height, 1, VisibilityFormat);
+				}
+			}
+		}
+	}
+
+	// History is empty after a rebuild, so every cascade is gathered in the next frame.
+	m_updateScheduler.SetDesc(m_rcSettings.updateSchedule);
+	m_updateScheduler.Reset();
+
+	m_hasActiveProbeDirectionLists = false;
+	if (m_rcSettings.staticParams.useActiveProbeDirectionLists && maxCalculatedCascadeLevels > 1)
+	{
+		if (Utils::SupportsIndirectDispatchRays(Graphics::g_Device))
+		{
+			// Worst case every probe-direction of every cascade but cascade 0 is active.
+			uint32_t listElementCount = 0;
+			for (uint32_t i = 1; i < maxCalculatedCascadeLevels; i++)
+			{
+				listElementCount += m_cascadeExtents[i].width * m_cascadeExtents[i].height;
+			}
+
+			m_resources->activeProbeDirections.Create(L"Active Probe-Direction Lists", listElementCount, sizeof(uint32_t));
+			m_resources->activeProbeDirectionCounts.Create(L"Active Probe-Direction Counts", RCMaxCascadeCount, sizeof(uint32_t));
+			m_resources->gatherDispatchArgs.Create(L"Gather Dispatch Args", RCMaxCascadeCount, sizeof(D3D12_DISPATCH_RAYS_DESC));
+
+			m_hasActiveProbeDirectionLists = true;
+		}
+		else
+		{
+			LOG_WARNING(L"Active probe-direction lists require raytracing tier 1.1 for indirect DispatchRays, falling back to full gather dispatches.");
+		}
+	}
+
+	if (!m_hasActiveProbeDirectionLists)
+	{
+		m_resources->activeProbeDirections.Destroy();
+		m_resources->activeProbeDirectionCounts.Destroy();
+		m_resources->gatherDispatchArgs.Destroy();
+	}
+
+	// Only allocated while it is read, toggling the setting regenerates the cascades (see DrawRCSettingsUI()).
+	if (UsesPrecomputedMergeWeights())
+	{
+		m_resources->mergeWeights.Create(L"Merge Weights", mergeWeightCount, sizeof(DirectX::XMFLOAT4));
+	}
+	else
+	{
+		m_resources->mergeWeights.Destroy();
+	}
+
 	// Coalesced result has one pixel per probe0.
-	m_coalescedResult.Create(
+	m_resources->coalescedResult.Create(
 		L"Coalesced Result",
 		probeCount0X,
 		probeCount0Y,
@@ -100,9 +262,8 @@ void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSp
 
 	uint32_t numElements = GetGatherFilterCount();
 	uint32_t elementSize = sizeof(uint32_t);
-	m_gatherFilterByteAddressBuffer.Create(L"Gather Filter Reduction Sum Byte Buffer", numElements, elementSize);
-	m_gatherFilterReadbackBuffer.Create(L"Gather Filter Reduction Sum Readback Buffer", numElements, elementSize);
-	m_gatherFilterReadbackBufferMappedPtr = reinterpret_cast<uint32_t*>(m_gatherFilterReadbackBuffer.Map());
+	m_resources->gatherFilterByteAddressBuffer.Create(L"Gather Filter Reduction Sum Byte Buffer", numElements, elementSize);
+	m_resources->gatherFilterReadbackRing.Create(L"Gather Filter Reduction Sum Readback Ring", numElements * elementSize);
 
 	UpdateResourceDescriptors();
 
@@ -116,11 +277,81 @@ void RadianceCascadeManager3D::Generate(uint32_t raysPerProbe0, uint32_t probeSp
 	m_swapchainHeight = swapchainHeight;
 }
 
+void RadianceCascadeManager3D::ReleaseRetiredResources()
+{
+	m_releaseQueue.ReleaseCompleted(m_releaseFence);
+}
+
+void RadianceCascadeManager3D::SwapResourceSets()
+{
+	const uint32_t nextResourceSetIndex = (m_resourceSetIndex + 1u) % ResourceSetCount;
+
+	// Only still in flight if Generate() is called again within a few frames.
+	const uint64_t nextRetireFence = m_resourceSetRetireFences[nextResourceSetIndex];
+	if (m_releaseQueue.IsPending(nextRetireFence))
+	{
+		Graphics::g_CommandManager.WaitForFence(nextRetireFence);
+		m_releaseQueue.ReleaseCompleted(m_releaseFence);
+	}
+
+	// All the work that can use the current set has been submitted, everything in the RC passes runs on the graphics queue.
+	const uint64_t retireFence = Graphics::g_CommandManager.GetGraphicsQueue().IncrementFence();
+	CascadeResources& retiredResources = m_resourceSets[m_resourceSetIndex];
+	m_resourceSetRetireFences[m_resourceSetIndex] = retireFence;
+	m_releaseQueue.Retire(retireFence, [&retiredResources]()
+	{
+		// Only the resources are released. The buffer objects keep their descriptor handles, which are reused once the set is built again.
+		for (ColorBuffer& buffer : retiredResources.cascadeIntervals) { buffer.Destroy(); }
+		for (ColorBuffer& buffer : retiredResources.cascadeVisibility) { buffer.Destroy(); }
+		for (ColorBuffer& buffer : retiredResources.cascadeHistory) { buffer.Destroy(); }
+		for (ColorBuffer& buffer : retiredResources.cascadeVisibilityHistory) { buffer.Destroy(); }
+		for (ByteAddressBuffer& buffer : retiredResources.cascadeGatherFilters) { buffer.Destroy(); }
+
+		retiredResources.cascadeAtlas.Destroy();
+		retiredResources.cascadeAtlasVisibility.Destroy();
+		retiredResources.cascadeAtlasHistory.Destroy();
+		retiredResources.cascadeAtlasVisibilityHistory.Destroy();
+		retiredResources.coalescedResult.Destroy();
+		retiredResources.activeProbeDirections.Destroy();
+		retiredResources.activeProbeDirectionCounts.Destroy();
+		retiredResources.gatherDispatchArgs.Destroy();
+		retiredResources.mergeWeights.Destroy();
+		retiredResources.gatherFilterByteAddressBuffer.Destroy();
+		retiredResources.gatherFilterReadbackRing.Destroy();
+	});
+
+	m_resourceSetIndex = nextResourceSetIndex;
+	m_resources = &m_resourceSets[m_resourceSetIndex];
+}
+
 void RadianceCascadeManager3D::Resize(uint32_t width, uint32_t height)
 {
 	Generate(m_rcSettings.staticParams.raysPerProbe0, m_rcSettings.staticParams.probeSpacing0, width, height, GetCascadeIntervalCount());
 }
 
+void RadianceCascadeManager3D::Regenerate(uint32_t raysPerProbe0, uint32_t probeSpacing0)
+{
+	Generate(raysPerProbe0, probeSpacing0, m_swapchainWidth, m_swapchainHeight, (uint32_t)m_rcSettings.staticParams.maxCascadeCount);
+}
+
+void RadianceCascadeManager3D::SetActiveCascadeLimit(uint32_t activeCascadeLimit)
+{
+	const uint32_t oldActiveCascadeCount = GetActiveCascadeCount();
+	m_activeCascadeLimit = activeCascadeLimit;
+
+	if (GetActiveCascadeCount() != oldActiveCascadeCount)
+	{
+		ResetCascadeHistory();
+	}
+}
+
+void RadianceCascadeManager3D::SetCascadeUpdateSchedule(const CPUReference::CascadeUpdateScheduleDesc& updateSchedule)
+{
+	// Only changes which cascades are gathered from the next frame on, the history stays valid.
+	m_rcSettings.updateSchedule = updateSchedule;
+	m_updateScheduler.SetDesc(updateSchedule);
+}
+
 void RadianceCascadeManager3D::FillRCGlobalInfo(RCGlobals& rcGlobalInfo)
 {
 	rcGlobalInfo.rayCount0 = m_rcSettings.staticParams.raysPerProbe0;
@@ -129,41 +360,111 @@ void RadianceCascadeManager3D::FillRCGlobalInfo(RCGlobals& rcGlobalInfo)
 	rcGlobalInfo.probeScalingFactor = m_scalingFactor.probeScalingFactor;
 	rcGlobalInfo.rayScalingFactor = m_scalingFactor.rayScalingFactor;
 	
-	rcGlobalInfo.cascadeCount = GetCascadeIntervalCount();
+	rcGlobalInfo.cascadeCount = GetActiveCascadeCount();
 	rcGlobalInfo.gatherFilterCount = rcGlobalInfo.cascadeCount - 1; // By definition.
 	
 
 	rcGlobalInfo.usePreAveraging = m_rcSettings.staticParams.isUsingPreAveragedIntervals;
 	rcGlobalInfo.depthAwareMerging = m_rcSettings.useDepthAwareMerging;
+	rcGlobalInfo.usePrecomputedMergeWeights = UsesPrecomputedMergeWeights();
 
 	rcGlobalInfo.probeCount0X = m_probeCount0X;
 	rcGlobalInfo.probeCount0Y = m_probeCount0Y;
 	rcGlobalInfo.probeSpacing0 = m_rcSettings.staticParams.probeSpacing0;
 
 	rcGlobalInfo.useGatherFiltering = m_rcSettings.useGatherFiltering;
+
+	rcGlobalInfo.useCascadeAtlas = UsesCascadeAtlas();
+	rcGlobalInfo.useVisibilityPlane = UsesVisibilityPlane();
+	for (uint32_t i = 0; i < m_cascadeAtlasLayout.GetCascadeCount(); i++)
+	{
+		const CPUReference::CascadeAtlasRect& atlasRect = m_cascadeAtlasLayout.GetRect(i);
+		rcGlobalInfo.cascadeAtlasRects[i] = DirectX::XMUINT4(atlasRect.offsetX, atlasRect.offsetY, atlasRect.width, atlasRect.height);
+	}
+}
+
+void RadianceCascadeManager3D::FillCascadeDispatchTable(RCShaderShared::CascadeDispatchTable& cascadeDispatchTable)
+{
+	RCShaderShared::uint2 cascadeDims[RCMaxCascadeCount] = {};
+	for (uint32_t i = 0; i < GetActiveCascadeCount(); i++)
+	{
+		cascadeDims[i] = { GetCascadeIntervalWidth(i), GetCascadeIntervalHeight(i) };
+	}
+
+	cascadeDispatchTable = RCShaderShared::BuildCascadeDispatchTable(cascadeDims, GetActiveCascadeCount());
+}
+
+uint32_t RadianceCascadeManager3D::GetMergeScalingPermutation() const
+{
+	if (!m_rcSettings.useSpecializedMergeKernels)
+	{
+		return CPUReference::InvalidScalingPermutation;
+	}
+
+	return CPUReference::GetScalingPermutationIndex(m_scalingFactor.probeScalingFactor, m_scalingFactor.rayScalingFactor);
+}
+
+bool RadianceCascadeManager3D::UsesSingleGatherDispatch()
+{
+	if (!m_rcSettings.useSingleGatherDispatch || !UsesCascadeAtlas() || UsesGatherFiltering())
+	{
+		return false;
+	}
+
+	uint64_t texelCount = 0;
+	for (uint32_t i = 0; i < GetCascadeIntervalCount(); i++)
+	{
+		texelCount += uint64_t(GetCascadeIntervalWidth(i)) * GetCascadeIntervalHeight(i);
+	}
+
+	return texelCount <= D3D12_RAYTRACING_MAX_RAY_GENERATION_SHADER_THREADS;
 }
 
 void RadianceCascadeManager3D::ClearBuffers(GraphicsContext& gfxContext)
 {
-	for (ColorBuffer& cascadeInterval : m_cascadeIntervals)
+	for (ColorBuffer& cascadeInterval : m_resources->cascadeIntervals)
 	{
 		gfxContext.TransitionResource(cascadeInterval, D3D12_RESOURCE_STATE_RENDER_TARGET);
 		gfxContext.ClearColor(cascadeInterval);
 	}
 
-	for (ColorBuffer& cascadeGatherFilter : m_cascadeGatherFilters)
+	for (ColorBuffer& cascadeVisibility : m_resources->cascadeVisibility)
+	{
+		gfxContext.TransitionResource(cascadeVisibility, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		gfxContext.ClearColor(cascadeVisibility);
+	}
+
+	if (UsesCascadeAtlas())
 	{
-		gfxContext.TransitionResource(cascadeGatherFilter, D3D12_RESOURCE_STATE_RENDER_TARGET);
-		gfxContext.ClearColor(cascadeGatherFilter);
+		gfxContext.TransitionResource(m_resources->cascadeAtlas, D3D12_RESOURCE_STATE_RENDER_TARGET);
+		gfxContext.ClearColor(m_resources->cascadeAtlas);
+
+		if (UsesVisibilityPlane())
+		{
+			gfxContext.TransitionResource(m_resources->cascadeAtlasVisibility, D3D12_RESOURCE_STATE_RENDER_TARGET);
+			gfxContext.ClearColor(m_resources->cascadeAtlasVisibility);
+		}
 	}
 
-	gfxContext.TransitionResource(m_coalescedResult, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	gfxContext.ClearColor(m_coalescedResult);
+	for (ByteAddressBuffer& cascadeGatherFilter : m_resources->cascadeGatherFilters)
+	{
+		gfxContext.TransitionResource(cascadeGatherFilter, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+		gfxContext.ClearUAV(cascadeGatherFilter);
+	}
+
+	if (m_hasActiveProbeDirectionLists)
+	{
+		gfxContext.TransitionResource(m_resources->activeProbeDirectionCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+		gfxContext.ClearUAV(m_resources->activeProbeDirectionCounts);
+	}
+
+	gfxContext.TransitionResource(m_resources->coalescedResult, D3D12_RESOURCE_STATE_RENDER_TARGET);
+	gfxContext.ClearColor(m_resources->coalescedResult);
 
 	std::vector<uint32_t> zeroVec = std::vector<uint32_t>(GetGatherFilterCount(), 0u);
 
-	gfxContext.TransitionResource(m_gatherFilterByteAddressBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
-	gfxContext.WriteBuffer(m_gatherFilterByteAddressBuffer, 0u, zeroVec.data(), sizeof(zeroVec[0]) * zeroVec.size());
+	gfxContext.TransitionResource(m_resources->gatherFilterByteAddressBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+	gfxContext.WriteBuffer(m_resources->gatherFilterByteAddressBuffer, 0u, zeroVec.data(), sizeof(zeroVec[0]) * zeroVec.size());
 }
 
 uint32_t RadianceCascadeManager3D::GetRaysPerProbe(uint32_t cascadeIndex)
@@ -188,6 +489,19 @@ ProbeDims RadianceCascadeManager3D::GetProbeDims(uint32_t cascadeIndex)
 	return probeDims;
 }
 
+uint32_t RadianceCascadeManager3D::GetMergeWeightsOffset(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex < GetGatherFilterCount());
+
+	uint32_t offset = 0;
+	for (uint32_t i = 0; i < cascadeIndex; i++)
+	{
+		offset += GetProbeCount(i);
+	}
+
+	return offset;
+}
+
 uint32_t RadianceCascadeManager3D::GetTotalRays(uint32_t cascadeIndex)
 {
 	return GetProbeCount(cascadeIndex) * GetRaysPerProbe(cascadeIndex);
@@ -206,57 +520,243 @@ float RadianceCascadeManager3D::GetRayLength(uint32_t cascadeIndex)
 
 ColorBuffer& RadianceCascadeManager3D::GetCascadeIntervalBuffer(uint32_t cascadeIndex) 
 { 
-	ASSERT(cascadeIndex < GetCascadeIntervalCount()); return m_cascadeIntervals[cascadeIndex]; 
+	ASSERT(cascadeIndex < GetCascadeIntervalCount()); return UsesCascadeAtlas() ? m_resources->cascadeAtlas : m_resources->cascadeIntervals[cascadeIndex]; 
+}
+
+ColorBuffer& RadianceCascadeManager3D::GetCascadeVisibilityBuffer(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex < GetCascadeIntervalCount() && UsesVisibilityPlane()); return UsesCascadeAtlas() ? m_resources->cascadeAtlasVisibility : m_resources->cascadeVisibility[cascadeIndex];
+}
+
+ColorBuffer& RadianceCascadeManager3D::GetCascadeHistoryBuffer(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex > 0 && cascadeIndex < GetCascadeIntervalCount() && UsesStaggeredUpdates()); return UsesCascadeAtlas() ? m_resources->cascadeAtlasHistory : m_resources->cascadeHistory[cascadeIndex - 1];
+}
+
+ColorBuffer& RadianceCascadeManager3D::GetCascadeVisibilityHistoryBuffer(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex > 0 && cascadeIndex < GetCascadeIntervalCount() && UsesStaggeredUpdates() && UsesVisibilityPlane()); return UsesCascadeAtlas() ? m_resources->cascadeAtlasVisibilityHistory : m_resources->cascadeVisibilityHistory[cascadeIndex - 1];
 }
 
-ColorBuffer& RadianceCascadeManager3D::GetCascadeGatherFilterBuffer(uint32_t filterIndex) 
+D3D12_RECT RadianceCascadeManager3D::GetCascadeIntervalRect(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex < GetCascadeIntervalCount());
+
+	if (UsesCascadeAtlas())
+	{
+		const CPUReference::CascadeAtlasRect& atlasRect = m_cascadeAtlasLayout.GetRect(cascadeIndex);
+		return { (LONG)atlasRect.offsetX, (LONG)atlasRect.offsetY, LONG(atlasRect.offsetX + atlasRect.width), LONG(atlasRect.offsetY + atlasRect.height) };
+	}
+
+	return { 0, 0, (LONG)m_cascadeExtents[cascadeIndex].width, (LONG)m_cascadeExtents[cascadeIndex].height };
+}
+
+uint32_t RadianceCascadeManager3D::GetCascadeIntervalWidth(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex < GetCascadeIntervalCount()); return m_cascadeExtents[cascadeIndex].width;
+}
+
+uint32_t RadianceCascadeManager3D::GetCascadeIntervalHeight(uint32_t cascadeIndex)
+{
+	ASSERT(cascadeIndex < GetCascadeIntervalCount()); return m_cascadeExtents[cascadeIndex].height;
+}
+
+ByteAddressBuffer& RadianceCascadeManager3D::GetCascadeGatherFilterBuffer(uint32_t filterIndex) 
 { 
-	ASSERT(filterIndex < GetGatherFilterCount()); return m_cascadeGatherFilters[filterIndex]; 
+	ASSERT(filterIndex < GetGatherFilterCount()); return m_resources->cascadeGatherFilters[filterIndex]; 
+}
+
+uint32_t RadianceCascadeManager3D::GetGatherFilterWidth(uint32_t filterIndex)
+{
+	// Filter i has the same dimensions as cascade interval i + 1.
+	ASSERT(filterIndex < GetGatherFilterCount()); return GetCascadeIntervalWidth(filterIndex + 1);
+}
+
+uint32_t RadianceCascadeManager3D::GetGatherFilterHeight(uint32_t filterIndex)
+{
+	ASSERT(filterIndex < GetGatherFilterCount()); return GetCascadeIntervalHeight(filterIndex + 1);
+}
+
+CPUReference::CascadeUpdate RadianceCascadeManager3D::GetCascadeUpdate(uint32_t cascadeIndex)
+{
+	if (!UsesStaggeredUpdates())
+	{
+		return { CPUReference::CascadeUpdateFull, 0u, GetCascadeIntervalHeight(cascadeIndex) };
+	}
+
+	return m_updateScheduler.GetCascadeUpdate(cascadeIndex, GetCascadeIntervalHeight(cascadeIndex));
 }
 
 uint64_t RadianceCascadeManager3D::GetTotalVRAMUsage()
 {
 	uint64_t totalSize = 0;
 
-	for (ColorBuffer& cascadeInterval : m_cascadeIntervals)
+	for (ColorBuffer& cascadeInterval : m_resources->cascadeIntervals)
 	{
 		totalSize += GetResourceVRAMSize(cascadeInterval, Graphics::g_Device);
 	}
 
-	totalSize += GetResourceVRAMSize(m_coalescedResult, Graphics::g_Device);
+	for (ColorBuffer& cascadeVisibility : m_resources->cascadeVisibility)
+	{
+		totalSize += GetResourceVRAMSize(cascadeVisibility, Graphics::g_Device);
+	}
+
+	if (UsesCascadeAtlas())
+	{
+		totalSize += GetResourceVRAMSize(m_resources->cascadeAtlas, Graphics::g_Device);
+
+		if (UsesVisibilityPlane())
+		{
+			totalSize += GetResourceVRAMSize(m_resources->cascadeAtlasVisibility, Graphics::g_Device);
+		}
+	}
+
+	for (ColorBuffer& cascadeHistory : m_resources->cascadeHistory)
+	{
+		totalSize += GetResourceVRAMSize(cascadeHistory, Graphics::g_Device);
+	}
+
+	for (ColorBuffer& cascadeVisibilityHistory : m_resources->cascadeVisibilityHistory)
+	{
+		totalSize += GetResourceVRAMSize(cascadeVisibilityHistory, Graphics::g_Device);
+	}
+
+	if (UsesCascadeAtlas() && UsesStaggeredUpdates())
+	{
+		totalSize += GetResourceVRAMSize(m_resources->cascadeAtlasHistory, Graphics::g_Device);
+
+		if (UsesVisibilityPlane())
+		{
+			totalSize += GetResourceVRAMSize(m_resources->cascadeAtlasVisibilityHistory, Graphics::g_Device);
+		}
+	}
+
+	for (ByteAddressBuffer& cascadeGatherFilter : m_resources->cascadeGatherFilters)
+	{
+		totalSize += GetResourceVRAMSize(cascadeGatherFilter, Graphics::g_Device);
+	}
+
+	if (m_hasActiveProbeDirectionLists)
+	{
+		totalSize += GetResourceVRAMSize(m_resources->activeProbeDirections, Graphics::g_Device);
+		totalSize += GetResourceVRAMSize(m_resources->activeProbeDirectionCounts, Graphics::g_Device);
+		totalSize += GetResourceVRAMSize(m_resources->gatherDispatchArgs, Graphics::g_Device);
+	}
+
+	if (UsesPrecomputedMergeWeights())
+	{
+		totalSize += GetResourceVRAMSize(m_resources->mergeWeights, Graphics::g_Device);
+	}
+
+	totalSize += GetResourceVRAMSize(m_resources->coalescedResult, Graphics::g_Device);
+	totalSize += GetResourceVRAMSize(m_resources->gatherFilterByteAddressBuffer, Graphics::g_Device);
+	totalSize += GetResourceVRAMSize(m_resources->gatherFilterReadbackRing.GetBuffer(), Graphics::g_Device);
 
 	return totalSize;
 }
 
+CPUReference::CascadeCost RadianceCascadeManager3D::GetCascadeCost() const
+{
+	CPUReference::CascadeCostDesc desc;
+	desc.layout.width = m_swapchainWidth;
+	desc.layout.height = m_swapchainHeight;
+	desc.layout.probeSpacing0 = (uint32_t)m_rcSettings.staticParams.probeSpacing0;
+	desc.layout.raysPerProbe0 = (uint32_t)m_rcSettings.staticParams.raysPerProbe0;
+	desc.layout.maxCascadeCount = (uint32_t)m_rcSettings.staticParams.maxCascadeCount;
+	desc.layout.rayLength0 = m_rcSettings.rayLength0;
+	desc.layout.probeScalingFactor = m_scalingFactor.probeScalingFactor;
+	desc.layout.rayScalingFactor = m_scalingFactor.rayScalingFactor;
+	desc.layout.isUsingPreAveragedIntervals = m_rcSettings.staticParams.isUsingPreAveragedIntervals;
+	desc.intervalFormat = m_intervalFormat;
+	desc.useCascadeAtlas = m_rcSettings.staticParams.useCascadeAtlas;
+	desc.useStaggeredUpdates = m_rcSettings.staticParams.useStaggeredUpdates;
+	desc.useActiveProbeDirectionLists = m_hasActiveProbeDirectionLists;
+
+	return CPUReference::ComputeCascadeCost(desc);
+}
+
 uint32_t RadianceCascadeManager3D::GetFilteredRayCount(uint32_t filterIndex)
 {
-	ASSERT(m_gatherFilterReadbackBufferMappedPtr != nullptr && filterIndex < GetGatherFilterCount());
+	ASSERT(filterIndex < GetGatherFilterCount());
+
+	const uint32_t* unfilteredRayCounts = reinterpret_cast<const uint32_t*>(m_resources->gatherFilterReadbackRing.GetLatest(Graphics::GetFrameCount()));
+	if (unfilteredRayCounts == nullptr)
+	{
+		return 0u;
+	}
 
-	const ColorBuffer& filterBuffer = GetCascadeGatherFilterBuffer(filterIndex);
-	const uint32_t totalRays = filterBuffer.GetWidth() * filterBuffer.GetHeight();
+	const uint32_t totalRays = GetGatherFilterWidth(filterIndex) * GetGatherFilterHeight(filterIndex);
 
 	// The reduction gives how many rays were NOT filtered so they are removed from total to get actual filtered rays.
-	uint32_t filteredRayCount = totalRays - m_gatherFilterReadbackBufferMappedPtr[filterIndex];
+	uint32_t filteredRayCount = totalRays - unfilteredRayCounts[filterIndex];
 
-	// Each ray generation shader dispatches 4 rays if pre averaged intervals is on.
+	// Each ray generation shader dispatches as many rays as the ray scaling factor if pre averaged intervals is on.
 	if (m_rcSettings.staticParams.isUsingPreAveragedIntervals)
 	{
-		filteredRayCount *= 4;
+		filteredRayCount *= m_scalingFactor.rayScalingFactor;
 	}
 
 	return filteredRayCount;
 }
 
+bool RadianceCascadeManager3D::GetFilteredRayCountFrameAge(uint64_t& frameAgeOut)
+{
+	return m_resources->gatherFilterReadbackRing.GetLatest(Graphics::GetFrameCount(), &frameAgeOut) != nullptr;
+}
+
 void RadianceCascadeManager3D::DrawRCSettingsUI()
 {
 	RC3DSettings::StaticParameters oldStaticParams = m_rcSettings.staticParams;
+	const bool usedPrecomputedMergeWeights = UsesPrecomputedMergeWeights();
 
 	ImGui::Separator();
 
 	ImGui::Checkbox("Use Depth Aware Merging (WIP)", &m_rcSettings.useDepthAwareMerging);
+	if (m_rcSettings.useDepthAwareMerging)
+	{
+		ImGui::Checkbox("Use Precomputed Merge Weights", &m_rcSettings.usePrecomputedMergeWeights);
+	}
 	ImGui::Checkbox("Use Gather Filtering (toggle with 'o')", &m_rcSettings.useGatherFiltering);
+	ImGui::Checkbox("Use Fused Merge And Coalesce", &m_rcSettings.useFusedMergeCoalesce);
+	ImGui::Checkbox("Use Specialized Merge Kernels", &m_rcSettings.useSpecializedMergeKernels);
+	ImGui::Checkbox("Use Single Gather Dispatch", &m_rcSettings.useSingleGatherDispatch);
+	if (m_rcSettings.useSingleGatherDispatch && !UsesSingleGatherDispatch())
+	{
+		ImGui::TextDisabled("Requires the cascade atlas and no gather filtering.");
+	}
 
 	ImGui::Checkbox("Use Pre Average Intervals", &m_rcSettings.staticParams.isUsingPreAveragedIntervals);
+	ImGui::Checkbox("Use Cascade Atlas", &m_rcSettings.staticParams.useCascadeAtlas);
+	ImGui::Checkbox("Use Active Probe-Direction Lists", &m_rcSettings.staticParams.useActiveProbeDirectionLists);
+	ImGui::Checkbox("Use Staggered Cascade Updates", &m_rcSettings.staticParams.useStaggeredUpdates);
+	if (m_rcSettings.staticParams.useStaggeredUpdates)
+	{
+		CPUReference::CascadeUpdateScheduleDesc& updateSchedule = m_rcSettings.updateSchedule;
+
+		int periodLog2Step = (int)updateSchedule.periodLog2Step;
+		int maxPeriodLog2 = (int)updateSchedule.maxPeriodLog2;
+		ImGui::SliderInt("Period Log2 Per Cascade", &periodLog2Step, 0, 3);
+		ImGui::SliderInt("Max Period Log2", &maxPeriodLog2, 0, 4);
+		ImGui::Checkbox("Update Rows Round Robin", &updateSchedule.useRoundRobinRows);
+
+		updateSchedule.periodLog2Step = (uint32_t)periodLog2Step;
+		updateSchedule.maxPeriodLog2 = (uint32_t)maxPeriodLog2;
+
+		SetCascadeUpdateSchedule(updateSchedule);
+	}
+
+	// Interval format settings, RGB9E5 is left out as it cannot be used for the cascades.
+	{
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Interval format:");
+		ImGui::SameLine();
+
+		int intervalFormat = (int)m_rcSettings.staticParams.intervalFormat;
+		ImGui::RadioButton("FP16", &intervalFormat, CPUReference::IntervalFormatFP16); ImGui::SameLine();
+		ImGui::RadioButton("R11G11B10 + Visibility", &intervalFormat, CPUReference::IntervalFormatR11G11B10);
+
+		m_rcSettings.staticParams.intervalFormat = (CPUReference::IntervalFormat)intervalFormat;
+	}
 
 	ImGui::SliderFloat("Ray Length", &m_rcSettings.rayLength0, 0.1f, 250.0f);
 
@@ -273,6 +773,31 @@ void RadianceCascadeManager3D::DrawRCSettingsUI()
 		ImGui::RadioButton("64", &raysperProbe0, 64);
 	}
 
+	// Scaling factor settings, wider branching gives fewer cascades for the same amount of probes and rays.
+	ScalingFactor oldScalingFactor = m_scalingFactor;
+	{
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Probe scaling factor:");
+		ImGui::SameLine();
+
+		int probeScalingFactor = (int)m_scalingFactor.probeScalingFactor;
+		ImGui::RadioButton("2##ProbeScaling", &probeScalingFactor, 2); ImGui::SameLine();
+		ImGui::RadioButton("3##ProbeScaling", &probeScalingFactor, 3); ImGui::SameLine();
+		ImGui::RadioButton("4##ProbeScaling", &probeScalingFactor, 4);
+
+		ImGui::AlignTextToFramePadding();
+		ImGui::Text("Ray scaling factor:");
+		ImGui::SameLine();
+
+		int rayScalingFactor = (int)m_scalingFactor.rayScalingFactor;
+		ImGui::RadioButton("4##RayScaling", &rayScalingFactor, 4); ImGui::SameLine();
+		ImGui::RadioButton("9##RayScaling", &rayScalingFactor, 9); ImGui::SameLine();
+		ImGui::RadioButton("16##RayScaling", &rayScalingFactor, 16);
+
+		m_scalingFactor.probeScalingFactor = (uint32_t)probeScalingFactor;
+		m_scalingFactor.rayScalingFactor = (uint32_t)rayScalingFactor;
+	}
+
 	// Probe spacing settings
 	{
 		ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x * 0.2f);
@@ -289,12 +814,13 @@ void RadianceCascadeManager3D::DrawRCSettingsUI()
 		int& maxCascadeCount = m_rcSettings.staticParams.maxCascadeCount;
 		if (ImGui::InputInt("Max Cascade Count [1 - 10]", &maxCascadeCount, 1, 0))
 		{
-			maxCascadeCount = int(Math::Clamp(float(maxCascadeCount), 1.0f, 10.0f));
+			maxCascadeCount = int(Math::Clamp(float(maxCascadeCount), 1.0f, float(RCMaxCascadeCount)));
 		}
 	}
 
-	// If static parameters change, a rebuild is required.
-	if (memcmp(&oldStaticParams, &m_rcSettings.staticParams, sizeof(oldStaticParams)) != 0)
+	// If static parameters or scaling factors change, a rebuild is required. So does allocating or freeing the merge weights.
+	if (memcmp(&oldStaticParams, &m_rcSettings.staticParams, sizeof(oldStaticParams)) != 0 || memcmp(&oldScalingFactor, &m_scalingFactor, sizeof(oldScalingFactor)) != 0 ||
+		UsesPrecomputedMergeWeights() != usedPrecomputedMergeWeights)
 	{
 		Generate(
 			m_rcSettings.staticParams.raysPerProbe0,
@@ -305,14 +831,31 @@ void RadianceCascadeManager3D::DrawRCSettingsUI()
 		);
 	}
 
-	const ColorBuffer& cascade0Buffer = GetCascadeIntervalBuffer(0);
-	const uint32_t cascadeResolutionWidth = cascade0Buffer.GetWidth();
-	const uint32_t cascadeResolutionHeight = cascade0Buffer.GetHeight();
-
 	ImGui::Text("Cascade Count: %u", GetCascadeIntervalCount());
+	if (GetActiveCascadeCount() < GetCascadeIntervalCount())
+	{
+		ImGui::Text("Active Cascade Count: %u", GetActiveCascadeCount());
+	}
 	ImGui::Text("Using pre-averaging: %s", UsesPreAveragedIntervals() ? "Yes" : "No");
+	if (UsesCascadeAtlas())
+	{
+		uint64_t atlasTexelCount = uint64_t(m_cascadeAtlasLayout.GetWidth()) * m_cascadeAtlasLayout.GetHeight();
+		ImGui::Text("Cascade atlas: %u x %u (%.1f%% unused)", m_cascadeAtlasLayout.GetWidth(), m_cascadeAtlasLayout.GetHeight(), 100.0f * m_cascadeAtlasLayout.GetUnusedTexelCount() / atlasTexelCount);
+	}
+	else if (m_rcSettings.staticParams.useCascadeAtlas)
+	{
+		ImGui::Text("Cascade atlas: does not fit, using one texture per cascade");
+	}
 	uint64_t rcVRAMUsage = GetTotalVRAMUsage();
 	ImGui::Text("Vram usage: %.1f MB", rcVRAMUsage / (float)(1024 * 1024));
+	const CPUReference::CascadeCost cascadeCost = GetCascadeCost();
+	ImGui::Text("Modelled vram usage: %.1f MB (%.2f M rays per full update)", cascadeCost.totalBytes / (float)(1024 * 1024), cascadeCost.tracedRays / 1000000.0f);
+
+	uint64_t filteredRayCountFrameAge = 0u;
+	if (m_rcSettings.useGatherFiltering && GetFilteredRayCountFrameAge(filteredRayCountFrameAge))
+	{
+		ImGui::Text("Filtered rays are %llu frames old", filteredRayCountFrameAge);
+	}
 
 	// Create a table with 6 columns: Cascade, Buffer Resolution, Probe Count, Ray Count, Start Dist, Length
 	uint32_t cascadeTableHeaderCount = 6;
@@ -339,9 +882,8 @@ void RadianceCascadeManager3D::DrawRCSettingsUI()
 			ImGui::Text("%u", i);
 
 			// Cascade Resolution column
-			const ColorBuffer& cascadeBuffer = GetCascadeIntervalBuffer(i);
 			ImGui::TableSetColumnIndex(1);
-			ImGui::Text("%u x %u", cascadeBuffer.GetWidth(), cascadeBuffer.GetHeight());
+			ImGui::Text("%u x %u", GetCascadeIntervalWidth(i), GetCascadeIntervalHeight(i));
 
 			// Probe Count column
 			//uint32_t cascadeCountPerDim = m_rcManager3D.GetProbeCountPerDim(i);
@@ -384,20 +926,71 @@ void RadianceCascadeManager3D::DrawRCSettingsUI()
 
 void RadianceCascadeManager3D::UpdateResourceDescriptors()
 {
-	for (size_t i = 0; i < m_cascadeIntervals.size(); i++)
+	for (size_t i = 0; i < m_resources->cascadeIntervals.size(); i++)
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeIntervals[i].GetSRV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeIntervals[i].GetUAV());
+	}
+
+	for (size_t i = 0; i < m_resources->cascadeVisibility.size(); i++)
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeVisibility[i].GetSRV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeVisibility[i].GetUAV());
+	}
+
+	if (UsesCascadeAtlas())
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlas.GetSRV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlas.GetUAV());
+
+		if (UsesVisibilityPlane())
+		{
+			RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlasVisibility.GetSRV());
+			RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlasVisibility.GetUAV());
+		}
+	}
+
+	// History is only ever read.
+	for (size_t i = 0; i < m_resources->cascadeHistory.size(); i++)
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeHistory[i].GetSRV());
+	}
+
+	for (size_t i = 0; i < m_resources->cascadeVisibilityHistory.size(); i++)
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeVisibilityHistory[i].GetSRV());
+	}
+
+	if (UsesCascadeAtlas() && UsesStaggeredUpdates())
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlasHistory.GetSRV());
+
+		if (UsesVisibilityPlane())
+		{
+			RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeAtlasVisibilityHistory.GetSRV());
+		}
+	}
+
+	for (size_t i = 0; i < m_resources->cascadeGatherFilters.size(); i++)
+	{
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeGatherFilters[i].GetSRV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->cascadeGatherFilters[i].GetUAV());
+	}
+
+	if (m_hasActiveProbeDirectionLists)
 	{
-		RuntimeResourceManager::UpdateDescriptor(m_cascadeIntervals[i].GetSRV());
-		RuntimeResourceManager::UpdateDescriptor(m_cascadeIntervals[i].GetUAV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->activeProbeDirections.GetUAV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->activeProbeDirectionCounts.GetUAV());
 	}
 
-	for (size_t i = 0; i < m_cascadeGatherFilters.size(); i++)
+	if (UsesPrecomputedMergeWeights())
 	{
-		RuntimeResourceManager::UpdateDescriptor(m_cascadeGatherFilters[i].GetSRV());
-		RuntimeResourceManager::UpdateDescriptor(m_cascadeGatherFilters[i].GetUAV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->mergeWeights.GetSRV());
+		RuntimeResourceManager::UpdateDescriptor(m_resources->mergeWeights.GetUAV());
 	}
 
-	RuntimeResourceManager::UpdateDescriptor(m_coalescedResult.GetSRV());
-	RuntimeResourceManager::UpdateDescriptor(m_coalescedResult.GetUAV());
+	RuntimeResourceManager::UpdateDescriptor(m_resources->coalescedResult.GetSRV());
+	RuntimeResourceManager::UpdateDescriptor(m_resources->coalescedResult.GetUAV());
 
-	RuntimeResourceManager::UpdateDescriptor(m_gatherFilterByteAddressBuffer.GetUAV());
+	RuntimeResourceManager::UpdateDescriptor(m_resources->gatherFilterByteAddressBuffer.GetUAV());
 }
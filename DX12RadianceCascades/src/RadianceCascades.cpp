@@ -73,6 +73,9 @@ namespace
 		globalInfo.invProjMatrix = Math::Matrix4(DirectX::XMMatrixInverse(nullptr, camera.GetProjMatrix()));
 		globalInfo.invViewMatrix = Math::Matrix4(DirectX::XMMatrixInverse(nullptr, camera.GetViewMatrix()));
 
+		// Overwritten where a history from an earlier frame is read.
+		globalInfo.prevViewProjMatrix = camera.GetViewProjMatrix();
+
 		globalInfo.cameraPos = camera.GetPosition();
 
 		globalInfo.useSkybox = useSkybox;
@@ -95,6 +98,14 @@ namespace
 		rtCommandList->DispatchRays(&rayDispatchDesc);
 	}
 
+	// The argument buffer has to be in D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT.
+	void DispatchRaysIndirect(RayDispatchID rayDispatchID, CommandSignature& commandSignature, GpuBuffer& argumentBuffer, uint64_t argumentOffset, RaytracingContext& rtContext, ComPtr<ID3D12GraphicsCommandList4>& rtCommandList)
+	{
+		const RaytracingDispatchRayInputs& rayDispatch = RuntimeResourceManager::GetRaytracingDispatch(rayDispatchID);
+		rtCommandList->SetPipelineState1(rayDispatch.m_stateObject.Get());
+		rtContext.ExecuteIndirect(commandSignature, argumentBuffer, argumentOffset);
+	}
+
 	void AddModelsForRender(std::vector<InternalModelInstance>& modelInstances, Renderer::MeshSorter& meshSorter)
 	{
 		for (auto& modelInstance : modelInstances)
@@ -105,6 +116,18 @@ namespace
 		meshSorter.Sort();
 	}
 
+	// Defines that specialize RCMerge3D.hlsli on the scaling factors of a permutation.
+	std::vector<DxcDefine> GetMergePermutationDefines(uint32_t permutationIndex)
+	{
+		// String literals, the compilation package does not copy the defines. Indexed by the factor.
+		static const wchar_t* const s_ScalingDefineValues[] = { L"0", L"1", L"2", L"3", L"4" };
+
+		return {
+			{ L"RC_PROBE_SCALING_FACTOR", s_ScalingDefineValues[CPUReference::GetPermutationProbeScalingFactor(permutationIndex)] },
+			{ L"RC_RAY_SCALING_DIM", s_ScalingDefineValues[CPUReference::GetPermutationRayScalingDim(permutationIndex)] },
+		};
+	}
+
 	void SetComputePSOAndRootSig(ComputeContext& cmptContext, PSOID psoID)
 	{
 		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(psoID);
@@ -249,10 +272,16 @@ void RadianceCascades::Startup()
 			m_depthBufferCopy.Create(L"Depth Copy", width, height, 1, DXGI_FORMAT_R32_FLOAT);
 			RegisterDisplayDependentTexture(&m_depthBufferCopy, TextureTypeColor);
 
+			m_rcHistoryDepthBuffer.Create(L"RC History Depth", width, height, 1, DXGI_FORMAT_R32_FLOAT);
+			RegisterDisplayDependentTexture(&m_rcHistoryDepthBuffer, TextureTypeColor);
+
 			m_hiZBuffer.Create(L"Hi-Z Buffer", width, height, 0, DXGI_FORMAT_R32G32_FLOAT);
 			RegisterDisplayDependentTexture(&m_hiZBuffer, TextureTypeColor);
 
-			m_hiZReadbackBuffer.Create(L"Hi-z Readback Buffer", 2, sizeof(float));
+			m_hiZReadbackRing.Create(L"Hi-Z Readback Ring", 2 * sizeof(float));
+			m_hiZGroupCounter.Create(L"Hi-Z Group Counter", 1, sizeof(uint32_t));
+			m_dummyMergeWeights.Create(L"Dummy Merge Weights", 1, sizeof(DirectX::XMFLOAT4));
+			m_dummyVisibilityBuffer.Create(L"Dummy Visibility", 1, 1, 1, DXGI_FORMAT_R8_UNORM);
 		}
 	}
 	
@@ -284,6 +313,8 @@ void RadianceCascades::Cleanup()
 void RadianceCascades::Update(float deltaT)
 {
 	RuntimeResourceManager::CheckAndUpdatePSOs();
+	UpdateRCMergeShaders();
+	m_rcManager3D.ReleaseRetiredResources();
 	static double sTime = 0.0;
 	sTime += deltaT;
 
@@ -374,10 +405,16 @@ void RadianceCascades::Update(float deltaT)
 		for (InternalModelInstance& modelInstance : m_sceneModels)
 		{
 			modelInstance.UpdateInstance(gfxContext, deltaT, sTime);
+
+			// Only dirties the slot if the instance moved.
+			Utils::GPUMatrix instanceMatrix = Math::Matrix4(modelInstance.GetTransform());
+			m_instanceRegistry.SetTransform(modelInstance.instanceSlot, TLASBuffers::ToInstanceTransform(instanceMatrix));
 		}
 
-		std::vector<TLASInstanceGroup> tlasInstances = GetTLASInstanceGroups();
-		m_sceneTLAS.UpdateTLASInstances(gfxContext, tlasInstances);
+		// Also only dirties the slots whose mask changed.
+		UpdateInstanceMasks();
+
+		m_sceneTLAS.UpdateTLASInstances(gfxContext, m_instanceRegistry);
 	}
 
 
@@ -410,15 +447,17 @@ void RadianceCascades::RenderScene()
 
 		if (m_settings.rcRenderSettings.renderRC3D)
 		{
+			const uint32_t cascadeVisIndex = (uint32_t)m_settings.rcRenderSettings.cascadeVisIndex;
+
 			RunRCGather(renderCamera, Graphics::g_SceneDepthBuffer);
 
 			if (m_settings.rcRenderSettings.currentTextureVis == RCRenderSettings::CascadeTextureVisGather)
 			{
-				FullScreenCopyCompute(m_rcManager3D.GetCascadeIntervalBuffer(m_settings.rcRenderSettings.cascadeVisIndex), Graphics::g_SceneColorBuffer);
+				FullScreenCopyCompute(m_rcManager3D.GetCascadeIntervalBuffer(cascadeVisIndex), m_rcManager3D.GetCascadeIntervalRect(cascadeVisIndex), Graphics::g_SceneColorBuffer);
 			}
 			else if (m_settings.rcRenderSettings.currentTextureVis == RCRenderSettings::CascadeTextureVisGatherFilter)
 			{
-				FullScreenCopyCompute(m_rcManager3D.GetCascadeGatherFilterBuffer(m_settings.rcRenderSettings.cascadeFilterIndex), Graphics::g_SceneColorBuffer);
+				VisualizeGatherFilter(m_settings.rcRenderSettings.cascadeFilterIndex, Graphics::g_SceneColorBuffer);
 			}
 			else
 			{
@@ -426,11 +465,15 @@ void RadianceCascades::RenderScene()
 
 				if (m_settings.rcRenderSettings.currentTextureVis == RCRenderSettings::CascadeTextureVisMerge)
 				{
-					FullScreenCopyCompute(m_rcManager3D.GetCascadeIntervalBuffer(m_settings.rcRenderSettings.cascadeVisIndex), Graphics::g_SceneColorBuffer);
+					FullScreenCopyCompute(m_rcManager3D.GetCascadeIntervalBuffer(cascadeVisIndex), m_rcManager3D.GetCascadeIntervalRect(cascadeVisIndex), Graphics::g_SceneColorBuffer);
 				}
 				else
 				{
-					RunRCCoalesce();
+					// Otherwise written by the merge of cascade 0.
+					if (!m_rcManager3D.UsesFusedMergeCoalesce())
+					{
+						RunRCCoalesce();
+					}
 
 					if (m_settings.rcRenderSettings.seeCoalesceResult)
 					{
@@ -484,6 +527,8 @@ void RadianceCascades::RenderScene()
 		GPUProfiler::Get().UpdateData(timestampFrequency);
 	}
 
+	UpdateDynamicQuality();
+
 #if defined(RUN_TESTS)
 	
 	if (sNeedMoreOptimizationFrames)
@@ -764,11 +809,16 @@ void RadianceCascades::InitializePSOs()
 		RuntimeResourceManager::RegisterPSO(PSOIDComputeRCGatherPSO,		&m_rcGatherPSO,					PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDComputeFlatlandScenePSO,	&m_flatlandScenePSO,			PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDGatherFilterReductionPSO,	&m_gatherFilterReductionPSO,	PSOTypeCompute);
+		RuntimeResourceManager::RegisterPSO(PSOIDGatherFilterVisPSO,		&m_gatherFilterVisPSO,			PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDComputeFullScreenCopyPSO,	&m_fullScreenCopyComputePSO,	PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDRaytracingTestPSO,			&m_rtTestPSO,					PSOTypeRaytracing);
 		RuntimeResourceManager::RegisterPSO(PSOIDComputeHiZBufferPSO,		&m_HiZGenerationPSO,			PSOTypeCompute);
+		RuntimeResourceManager::RegisterPSO(PSOIDComputeHiZSinglePassPSO,	&m_hiZSinglePassPSO,			PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDRCRaytracingPSO,			&m_rcRaytracePSO,				PSOTypeRaytracing);
 		RuntimeResourceManager::RegisterPSO(PSOIDRC3DMergePSO,				&m_rc3dMergePSO,				PSOTypeCompute);
+		RuntimeResourceManager::RegisterPSO(PSOIDRC3DMergeWeightsPSO,		&m_rc3dMergeWeightsPSO,			PSOTypeCompute);
+		RuntimeResourceManager::RegisterPSO(PSOIDRC3DMergeCoalescePSO,		&m_rc3dMergeCoalescePSO,		PSOTypeCompute);
+		RuntimeResourceManager::RegisterPSO(PSOIDRC3DReprojectPSO,			&m_rc3dReprojectPSO,			PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDRC3DCoalescePSO,			&m_rc3dCoalescePSO,				PSOTypeCompute);
 		RuntimeResourceManager::RegisterPSO(PSOIDDeferredLightingPSO,		&m_deferredLightingPSO,			PSOTypeGraphics);
 		RuntimeResourceManager::RegisterPSO(PSOIDSkyboxPSO,					&m_skyboxPSO,					PSOTypeGraphics);
@@ -889,7 +939,7 @@ void RadianceCascades::InitializePSOs()
 		);
 		rootSig[RootEntryFullScreenCopyComputeSource].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
 		rootSig[RootEntryFullScreenCopyComputeDest].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
-		rootSig[RootEntryFullScreenCopyComputeDestInfo].InitAsConstants(0, 2);
+		rootSig[RootEntryFullScreenCopyComputeDestInfo].InitAsConstants(0, 6);
 
 		{
 			SamplerDesc pointSampler = Graphics::SamplerPointBorderDesc;
@@ -934,6 +984,22 @@ void RadianceCascades::InitializePSOs()
 		pso.Finalize();
 	}
 
+	{
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDComputeHiZSinglePassPSO);
+		RuntimeResourceManager::SetShaderForPSO(PSOIDComputeHiZSinglePassPSO, ShaderIDHiZSinglePassCS);
+
+		RootSignature& rootSig = m_hiZSinglePassRootSig;
+		rootSig.Reset(RootEntryHiZSinglePassCount);
+		rootSig[RootEntryHiZSinglePassInfo].InitAsConstantBuffer(0);
+		rootSig[RootEntryHiZSinglePassDepthSRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+		rootSig[RootEntryHiZSinglePassMipsUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, HiZMaxMipCount);
+		rootSig[RootEntryHiZSinglePassGroupCounterUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, HiZMaxMipCount, 1);
+		rootSig.Finalize(L"Hi-Z Single Pass");
+
+		pso.SetRootSignature(rootSig);
+		pso.Finalize();
+	}
+
 	{
 		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergePSO);
 		RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DMergePSO, ShaderIDRCMerge3DCS);
@@ -946,6 +1012,10 @@ void RadianceCascades::InitializePSOs()
 		rootSig[RootEntryRC3DMergeCascadeInfoCB].InitAsConstantBuffer(1);
 		rootSig[RootEntryRC3DMergeHiZSRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 		rootSig[RootEntryRC3DMergeGlobalInfoCB].InitAsConstantBuffer(2);
+		rootSig[RootEntryRC3DMergeWeightsSRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 1);
+		rootSig[RootEntryRC3DMergeCoalesceOutputUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1);
+		rootSig[RootEntryRC3DMergeCascadeN1VisibilitySRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 1);
+		rootSig[RootEntryRC3DMergeCascadeNVisibilityUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 1);
 		{
 			SamplerDesc sampler = Graphics::SamplerLinearBorderDesc;
 			sampler.SetBorderColor(Color(0.0f, 0.0f, 0.0f, 1.0f)); // Alpha of 1 to set visibility term.
@@ -957,6 +1027,52 @@ void RadianceCascades::InitializePSOs()
 		pso.Finalize();
 	}
 
+	{
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergeCoalescePSO);
+		RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DMergeCoalescePSO, ShaderIDRCMergeCoalesce3DCS);
+
+		pso.SetRootSignature(m_rc3dMergeRootSig);
+		pso.Finalize();
+	}
+
+	{
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergeWeightsPSO);
+		RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DMergeWeightsPSO, ShaderIDRCMergeWeights3DCS);
+
+		RootSignature& rootSig = m_rc3dMergeWeightsRootSig;
+		rootSig.Reset(RootEntryRC3DMergeWeightsCount);
+		rootSig[RootEntryRC3DMergeWeightsOutputUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
+		rootSig[RootEntryRC3DMergeWeightsRCGlobalsCB].InitAsConstantBuffer(0);
+		rootSig[RootEntryRC3DMergeWeightsCascadeInfoCB].InitAsConstantBuffer(1);
+		rootSig[RootEntryRC3DMergeWeightsDepthSRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+		rootSig[RootEntryRC3DMergeWeightsGlobalInfoCB].InitAsConstantBuffer(2);
+		rootSig.Finalize(L"RC 3D Merge Weights");
+
+		pso.SetRootSignature(rootSig);
+		pso.Finalize();
+	}
+
+	{
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DReprojectPSO);
+		RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DReprojectPSO, ShaderIDRCReproject3DCS);
+
+		RootSignature& rootSig = m_rc3dReprojectRootSig;
+		rootSig.Reset(RootEntryRC3DReprojectCount);
+		rootSig[RootEntryRC3DReprojectHistorySRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+		rootSig[RootEntryRC3DReprojectOutputUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
+		rootSig[RootEntryRC3DReprojectDepthSRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
+		rootSig[RootEntryRC3DReprojectDepthHistorySRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 1);
+		rootSig[RootEntryRC3DReprojectVisibilityHistorySRV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 1);
+		rootSig[RootEntryRC3DReprojectVisibilityOutputUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 1);
+		rootSig[RootEntryRC3DReprojectRCGlobalsCB].InitAsConstantBuffer(0);
+		rootSig[RootEntryRC3DReprojectCascadeInfoCB].InitAsConstantBuffer(1);
+		rootSig[RootEntryRC3DReprojectGlobalInfoCB].InitAsConstantBuffer(2);
+		rootSig.Finalize(L"RC 3D Reproject");
+
+		pso.SetRootSignature(rootSig);
+		pso.Finalize();
+	}
+
 	{
 		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DCoalescePSO);
 		RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DCoalescePSO, ShaderIDRCCoalesce3DCS);
@@ -979,13 +1095,28 @@ void RadianceCascades::InitializePSOs()
 		RootSignature& rootSig = m_gatherFilterReductionRootSig;
 		rootSig.Reset(RootEntryGatherFilterReductionCount, 0);
 		rootSig[RootEntryGatherFilterReductionInfo].InitAsConstantBuffer(0);
-		rootSig[RootEntryGatherFilterReductionTexture].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+		rootSig[RootEntryGatherFilterReductionSource].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
 		rootSig[RootEntryGatherFilterReductionByteBuffer].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
 		rootSig.Finalize(L"Gather Filter Reduction");
 
 		pso.SetRootSignature(rootSig);
 		pso.Finalize();
 	}
+
+	{
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDGatherFilterVisPSO);
+		RuntimeResourceManager::SetShaderForPSO(PSOIDGatherFilterVisPSO, ShaderIDGatherFilterVisCS);
+
+		RootSignature& rootSig = m_gatherFilterVisRootSig;
+		rootSig.Reset(RootEntryGatherFilterVisCount, 0);
+		rootSig[RootEntryGatherFilterVisInfo].InitAsConstants(0, 4);
+		rootSig[RootEntryGatherFilterVisSource].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1);
+		rootSig[RootEntryGatherFilterVisDest].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
+		rootSig.Finalize(L"Gather Filter Vis");
+
+		pso.SetRootSignature(rootSig);
+		pso.Finalize();
+	}
 #pragma endregion
 
 #pragma region RaytracingPSOs
@@ -1054,10 +1185,14 @@ void RadianceCascades::InitializePSOs()
 		globalRootSig[RootEntryRCRaytracingRTGGlobalInfoCB].InitAsConstantBufferView(0);
 		globalRootSig[RootEntryRCRaytracingRTGRCGlobalsCB].InitAsConstantBufferView(1);
 		globalRootSig[RootEntryRCRaytracingRTGCascadeInfoCB].InitAsConstantBufferView(2);
+		globalRootSig[RootEntryRCRaytracingRTGCascadeDispatchCB].InitAsConstantBufferView(3);
 #if defined(_DEBUG)
 		globalRootSig[RootEntryRCRaytracingRTGRCVisCB].InitAsConstantBufferView(127);
 #endif
 		globalRootSig[RootEntryRCRaytracingRTGDepthTextureUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 3, 1);
+		globalRootSig[RootEntryRCRaytracingRTGActiveProbeDirectionsUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 4, 1);
+		globalRootSig[RootEntryRCRaytracingRTGActiveProbeDirectionCountsUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 5, 1);
+		globalRootSig[RootEntryRCRaytracingRTGOutputVisibilityUAV].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 6, 1);
 		{
 			SamplerDesc sampler = Graphics::SamplerLinearWrapDesc;
 			globalRootSig.InitStaticSampler(0, sampler);
@@ -1077,8 +1212,8 @@ void RadianceCascades::InitializePSOs()
 		localRootSig.Finalize(L"Local Root Signature", D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE);
 		pso.SetLocalRootSignature(&localRootSig);
 
-		// Payload: int2 probeIndex, float4 result
-		pso.SetPayloadAndAttributeSize(8 + 4 * 4, 8);
+		// Payload: int2 probeIndex, float4 result, uint cascadeIndex
+		pso.SetPayloadAndAttributeSize(8 + 4 * 4 + 4, 8);
 
 		pso.SetHitGroup(s_HitGroupName, D3D12_HIT_GROUP_TYPE_TRIANGLES);
 		pso.SetClosestHitShader(L"ClosestHitShader");
@@ -1116,24 +1251,24 @@ void RadianceCascades::InitializeRT()
 {
 	GPU_MEMORY_BLOCK("RT Resources");
 
-	// Initialize TLASes.
-	std::unordered_map<ModelID, std::vector<Utils::GPUMatrix>> blasInstances = GetGroupedModelInstances();
+	std::set<ModelID> modelIDs = GetSceneModelIDs();
 
 	// Initialize RT dispatch inputs.
 	{
-		std::set<ModelID> modelIDs = {};
-		for (auto& [key, _] : blasInstances)
-		{
-			modelIDs.insert(key);
-		}
-
 		RuntimeResourceManager::BuildRaytracingDispatchInputs(PSOIDRaytracingTestPSO, modelIDs, RayDispatchIDTest);
 		RuntimeResourceManager::BuildRaytracingDispatchInputs(PSOIDRCRaytracingPSO, modelIDs, RayDispatchIDRCRaytracing);
 	}
 
+	if (Utils::SupportsIndirectDispatchRays(Graphics::g_Device))
+	{
+		m_dispatchRaysCommandSignature[0].DispatchRays();
+		m_dispatchRaysCommandSignature.Finalize();
+	}
+
+	// Initialize TLAS.
 	{
-		std::vector<TLASInstanceGroup> tlasInstances = GetTLASInstanceGroups();
 		m_sceneTLAS.Init();
+		RegisterSceneInstances(modelIDs);
 	}
 }
 
@@ -1215,7 +1350,7 @@ void RadianceCascades::RenderRaster(ColorBuffer& targetColor, DepthBuffer& targe
 		gfxContext.DrawInstanced(36, 1);
 	}
 
-	gfxContext.Finish(true);
+	gfxContext.Finish();
 }
 
 void RadianceCascades::RenderRaytracing(ColorBuffer& targetColor, Camera& camera)
@@ -1257,7 +1392,7 @@ void RadianceCascades::RenderRaytracing(ColorBuffer& targetColor, Camera& camera
 		::DispatchRays(RayDispatchIDTest, targetColor.GetWidth(), targetColor.GetHeight(), rtCommandList);
 	}
 
-	rtContext.Finish(true);
+	rtContext.Finish();
 }
 
 void RadianceCascades::RunRCGather(Camera& camera, DepthBuffer& sourceDepthBuffer)
@@ -1283,6 +1418,108 @@ void RadianceCascades::RunRCGather(Camera& camera, DepthBuffer& sourceDepthBuffe
 			rtContext.CopySubresource(destDepthBuffer, 0, sourceDepthBuffer, 0);
 		}
 
+		uint32_t baseCascade = 0;
+		uint32_t maxCascade = m_rcManager3D.GetActiveCascadeCount();
+
+		int cascdeVisResultIndex = m_settings.rcRenderSettings.cascadeVisResultIndex;
+		if (cascdeVisResultIndex > -1 && (uint32_t)cascdeVisResultIndex < maxCascade)
+		{
+			baseCascade = m_settings.rcRenderSettings.cascadeVisResultIndex;
+			maxCascade = baseCascade + 1;
+		}
+
+		const bool gathersAllCascades = baseCascade == 0 && maxCascade == m_rcManager3D.GetActiveCascadeCount();
+		const bool useCascadeAtlas = m_rcManager3D.UsesCascadeAtlas();
+		const bool useVisibilityPlane = m_rcManager3D.UsesVisibilityPlane();
+
+		// The history only stays valid if every cascade is stored each frame.
+		const bool useStaggeredUpdates = m_rcManager3D.UsesStaggeredUpdates() && gathersAllCascades;
+		if (m_rcManager3D.UsesStaggeredUpdates() && !gathersAllCascades)
+		{
+			m_rcManager3D.ResetCascadeHistory();
+		}
+
+		std::array<CPUReference::CascadeUpdate, RCMaxCascadeCount> cascadeUpdates = {};
+		bool isFullUpdate = true;
+		for (uint32_t cascadeIndex = baseCascade; cascadeIndex < maxCascade; cascadeIndex++)
+		{
+			cascadeUpdates[cascadeIndex] = m_rcManager3D.GetCascadeUpdate(cascadeIndex);
+			isFullUpdate &= cascadeUpdates[cascadeIndex].type == CPUReference::CascadeUpdateFull;
+		}
+
+		// Cascades that are not fully gathered this frame are reprojected from their history first, row updates are gathered on top.
+		if (!isFullUpdate)
+		{
+			GlobalInfo reprojectGlobalInfo = globalInfo;
+			reprojectGlobalInfo.prevViewProjMatrix = m_rcHistoryViewProjMatrix;
+
+			::SetComputePSOAndRootSig(rtContext, PSOIDRC3DReprojectPSO);
+
+			rtContext.SetDynamicConstantBufferView(RootEntryRC3DReprojectRCGlobalsCB, sizeof(RCGlobals), &rcGlobalInfo);
+			rtContext.SetDynamicConstantBufferView(RootEntryRC3DReprojectGlobalInfoCB, sizeof(GlobalInfo), &reprojectGlobalInfo);
+
+			rtContext.TransitionResource(destDepthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectDepthSRV, 0, destDepthBuffer.GetSRV());
+
+			rtContext.TransitionResource(m_rcHistoryDepthBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectDepthHistorySRV, 0, m_rcHistoryDepthBuffer.GetSRV());
+
+			// Visibility planes are only read and written if the interval format has one, the slots are always bound with valid descriptors.
+			if (!useVisibilityPlane)
+			{
+				rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectVisibilityHistorySRV, 0, Graphics::GetDefaultTexture(Graphics::kBlackTransparent2D));
+				rtContext.TransitionResource(m_dummyVisibilityBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+				rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectVisibilityOutputUAV, 0, m_dummyVisibilityBuffer.GetUAV());
+			}
+
+			// Cascade 0 is gathered every frame. Cascades write to disjoint rects of the atlas, so no barriers are needed between them.
+			for (uint32_t cascadeIndex = 1; cascadeIndex < maxCascade; cascadeIndex++)
+			{
+				if (cascadeUpdates[cascadeIndex].type == CPUReference::CascadeUpdateFull)
+				{
+					continue;
+				}
+
+				CascadeInfo cascadeInfo = {};
+				cascadeInfo.cascadeIndex = cascadeIndex;
+				rtContext.SetDynamicConstantBufferView(RootEntryRC3DReprojectCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
+
+				ColorBuffer& cascadeHistory = m_rcManager3D.GetCascadeHistoryBuffer(cascadeIndex);
+				ColorBuffer& cascadeBuffer = m_rcManager3D.GetCascadeIntervalBuffer(cascadeIndex);
+				rtContext.TransitionResource(cascadeHistory, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				rtContext.TransitionResource(cascadeBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+				rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectHistorySRV, 0, cascadeHistory.GetSRV());
+				rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectOutputUAV, 0, cascadeBuffer.GetUAV());
+
+				if (useVisibilityPlane)
+				{
+					ColorBuffer& visibilityHistory = m_rcManager3D.GetCascadeVisibilityHistoryBuffer(cascadeIndex);
+					ColorBuffer& visibilityBuffer = m_rcManager3D.GetCascadeVisibilityBuffer(cascadeIndex);
+					rtContext.TransitionResource(visibilityHistory, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					rtContext.TransitionResource(visibilityBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+					rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectVisibilityHistorySRV, 0, visibilityHistory.GetSRV());
+					rtContext.SetDynamicDescriptor(RootEntryRC3DReprojectVisibilityOutputUAV, 0, visibilityBuffer.GetUAV());
+				}
+
+				rtContext.Dispatch2D(m_rcManager3D.GetCascadeIntervalWidth(cascadeIndex), m_rcManager3D.GetCascadeIntervalHeight(cascadeIndex));
+			}
+
+			// Row updates write on top of the reprojected intervals.
+			for (uint32_t cascadeIndex = 1; cascadeIndex < maxCascade; cascadeIndex++)
+			{
+				if (cascadeUpdates[cascadeIndex].type == CPUReference::CascadeUpdateRows)
+				{
+					rtContext.InsertUAVBarrier(m_rcManager3D.GetCascadeIntervalBuffer(cascadeIndex));
+					if (useVisibilityPlane)
+					{
+						rtContext.InsertUAVBarrier(m_rcManager3D.GetCascadeVisibilityBuffer(cascadeIndex));
+					}
+				}
+			}
+		}
+
 		ID3D12DescriptorHeap* pDescriptorHeaps[] = { RuntimeResourceManager::GetDescriptorHeapPtr() };
 		rtCommandList->SetDescriptorHeaps(1, pDescriptorHeaps);
 
@@ -1317,63 +1554,198 @@ void RadianceCascades::RunRCGather(Camera& camera, DepthBuffer& sourceDepthBuffe
 			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGDepthTextureUAV, depthUAV);
 		}
 
-		uint32_t baseCascade = 0;
-		uint32_t maxCascade = uint32_t(m_rcManager3D.GetCascadeIntervalCount());
+		// Cascades write to disjoint rects of the atlas, so it only needs to be bound once and no barriers are needed between cascades.
+		if (useCascadeAtlas)
+		{
+			ColorBuffer& cascadeAtlas = m_rcManager3D.GetCascadeAtlasBuffer();
+			rtContext.TransitionResource(cascadeAtlas, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
 
-		int cascdeVisResultIndex = m_settings.rcRenderSettings.cascadeVisResultIndex;
-		if (cascdeVisResultIndex > -1 && (uint32_t)cascdeVisResultIndex < maxCascade)
+			const DescriptorHandle& rcAtlasUAV = RuntimeResourceManager::GetDescCopy(cascadeAtlas.GetUAV());
+			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputUAV, rcAtlasUAV);
+
+			if (useVisibilityPlane)
+			{
+				ColorBuffer& atlasVisibility = m_rcManager3D.GetCascadeVisibilityBuffer(0);
+				rtContext.TransitionResource(atlasVisibility, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+				const DescriptorHandle& rcAtlasVisibilityUAV = RuntimeResourceManager::GetDescCopy(atlasVisibility.GetUAV());
+				rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputVisibilityUAV, rcAtlasVisibilityUAV);
+			}
+		}
+
+		// Every root parameter has to be set, the visibility plane is only written if the interval format has one.
+		if (!useVisibilityPlane)
 		{
-			baseCascade = m_settings.rcRenderSettings.cascadeVisResultIndex;
-			maxCascade = baseCascade + 1;
+			rtContext.TransitionResource(m_dummyVisibilityBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputVisibilityUAV, RuntimeResourceManager::GetDescCopy(m_dummyVisibilityBuffer.GetUAV()));
 		}
 
-		for (uint32_t cascadeIndex = baseCascade; cascadeIndex < maxCascade; cascadeIndex++)
+		// Always bound as every root parameter has to be set, only read by the shader when CascadeInfo says so.
+		RCShaderShared::CascadeDispatchTable cascadeDispatchTable = {};
+		m_rcManager3D.FillCascadeDispatchTable(cascadeDispatchTable);
+		rtContext.SetDynamicConstantBufferView(RootEntryRCRaytracingRTGCascadeDispatchCB, sizeof(RCShaderShared::CascadeDispatchTable), &cascadeDispatchTable);
+
+		// Cascade N appends the probe-directions it flags to the list of cascade N + 1, which is then dispatched indirectly over only those.
+		const bool useActiveProbeDirectionLists = m_rcManager3D.UsesActiveProbeDirectionLists();
+		if (useActiveProbeDirectionLists)
 		{
-			CascadeInfo cascadeInfo = {};
-			cascadeInfo.cascadeIndex = cascadeIndex;
+			// Shader tables change when shaders are reloaded, so the args are rebuilt every frame. Widths are copied from the counters before each dispatch.
+			__declspec(align(16)) D3D12_DISPATCH_RAYS_DESC dispatchArgs[RCMaxCascadeCount] = {};
+			for (D3D12_DISPATCH_RAYS_DESC& cascadeDispatchArgs : dispatchArgs)
+			{
+				cascadeDispatchArgs = RuntimeResourceManager::GetRaytracingDispatch(RayDispatchIDRCRaytracing).BuildDispatchRaysDesc(0, 1);
+			}
 
-			rtContext.SetDynamicConstantBufferView(RootEntryRCRaytracingRTGCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
+			rtContext.WriteBuffer(m_rcManager3D.GetGatherDispatchArgsBuffer(), 0, dispatchArgs, sizeof(dispatchArgs));
 
-			ColorBuffer& cascadeBuffer = m_rcManager3D.GetCascadeIntervalBuffer(cascadeIndex);
-			rtContext.InsertUAVBarrier(cascadeBuffer);
-			rtContext.TransitionResource(cascadeBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+			ByteAddressBuffer& activeProbeDirections = m_rcManager3D.GetActiveProbeDirectionBuffer();
+			ByteAddressBuffer& activeProbeDirectionCounts = m_rcManager3D.GetActiveProbeDirectionCountBuffer();
+			rtContext.TransitionResource(activeProbeDirections, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			rtContext.TransitionResource(activeProbeDirectionCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
 
-			const DescriptorHandle& rcBufferUAV = RuntimeResourceManager::GetDescCopy(cascadeBuffer.GetUAV());
-			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputUAV, rcBufferUAV);
+			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGActiveProbeDirectionsUAV, RuntimeResourceManager::GetDescCopy(activeProbeDirections.GetUAV()));
+			rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGActiveProbeDirectionCountsUAV, RuntimeResourceManager::GetDescCopy(activeProbeDirectionCounts.GetUAV()));
+		}
 
-			if (m_rcManager3D.UsesGatherFiltering())
+		// Without gather filtering no cascade depends on another during gathering, so all of them can share one dispatch.
+		// Linear dispatch indices are mapped to a cascade and texel with the prefix sums in the dispatch table.
+		// Staggered updates dispatch each cascade on its own, as they skip cascades and gather bands of rows.
+		if (gathersAllCascades && isFullUpdate && m_rcManager3D.UsesSingleGatherDispatch())
+		{
+			CascadeInfo cascadeInfo = {};
+			cascadeInfo.useCascadeDispatchTable = TRUE;
+			rtContext.SetDynamicConstantBufferView(RootEntryRCRaytracingRTGCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
+
+			::DispatchRays(RayDispatchIDRCRaytracing, cascadeDispatchTable.texelCount, 1, rtCommandList);
+		}
+		else
+		{
+			for (uint32_t cascadeIndex = baseCascade; cascadeIndex < maxCascade; cascadeIndex++)
 			{
-				// Last cascade has no higher cascade to filter.
-				if (cascadeIndex < m_rcManager3D.GetCascadeIntervalCount() - 1)
+				const CPUReference::CascadeUpdate& cascadeUpdate = cascadeUpdates[cascadeIndex];
+				if (cascadeUpdate.type == CPUReference::CascadeUpdateReproject)
+				{
+					continue;
+				}
+
+				// Same rules as CPUReference::ReferencePipeline::RunStaggered(). The gather filter is only complete if the cascade below was fully gathered,
+				// and cascades that are reprojected in later frames gather every probe-direction. Lists are built from the filter, so they follow it.
+				const bool isPreviousCascadeFull = cascadeIndex == 0 || cascadeUpdates[cascadeIndex - 1].type == CPUReference::CascadeUpdateFull;
+				const bool ignoreGatherFilter = !isPreviousCascadeFull || m_rcManager3D.GetCascadeRefreshPeriod(cascadeIndex) > 1u;
+				const bool useCascadeActiveProbeDirectionList = useActiveProbeDirectionLists && !ignoreGatherFilter;
+
+				CascadeInfo cascadeInfo = {};
+				cascadeInfo.cascadeIndex = cascadeIndex;
+				cascadeInfo.useActiveProbeDirectionLists = useCascadeActiveProbeDirectionList;
+				cascadeInfo.ignoreGatherFilter = ignoreGatherFilter;
+				cascadeInfo.dispatchOffsetY = cascadeUpdate.rowOffset;
+
+				rtContext.SetDynamicConstantBufferView(RootEntryRCRaytracingRTGCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
+
+				if (!useCascadeAtlas)
+				{
+					ColorBuffer& cascadeBuffer = m_rcManager3D.GetCascadeIntervalBuffer(cascadeIndex);
+					rtContext.InsertUAVBarrier(cascadeBuffer);
+					rtContext.TransitionResource(cascadeBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+					const DescriptorHandle& rcBufferUAV = RuntimeResourceManager::GetDescCopy(cascadeBuffer.GetUAV());
+					rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputUAV, rcBufferUAV);
+
+					if (useVisibilityPlane)
+					{
+						ColorBuffer& visibilityBuffer = m_rcManager3D.GetCascadeVisibilityBuffer(cascadeIndex);
+						rtContext.InsertUAVBarrier(visibilityBuffer);
+						rtContext.TransitionResource(visibilityBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+						const DescriptorHandle& rcVisibilityUAV = RuntimeResourceManager::GetDescCopy(visibilityBuffer.GetUAV());
+						rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGOutputVisibilityUAV, rcVisibilityUAV);
+					}
+				}
+
+				if (m_rcManager3D.UsesGatherFiltering())
 				{
-					ColorBuffer& gatherFilterBufferN1 = m_rcManager3D.GetCascadeGatherFilterBuffer(cascadeIndex);
-					rtContext.InsertUAVBarrier(gatherFilterBufferN1);
-					rtContext.TransitionResource(gatherFilterBufferN1, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+					// Last cascade has no higher cascade to filter.
+					if (cascadeIndex < m_rcManager3D.GetActiveCascadeCount() - 1)
+					{
+						ByteAddressBuffer& gatherFilterBufferN1 = m_rcManager3D.GetCascadeGatherFilterBuffer(cascadeIndex);
+						rtContext.InsertUAVBarrier(gatherFilterBufferN1);
+						rtContext.TransitionResource(gatherFilterBufferN1, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+						const DescriptorHandle& rcFilterBufferN1UAV = RuntimeResourceManager::GetDescCopy(gatherFilterBufferN1.GetUAV());
+						rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGGatherFilterN1UAV, rcFilterBufferN1UAV);
+					}
 
-					const DescriptorHandle& rcFilterBufferN1UAV = RuntimeResourceManager::GetDescCopy(gatherFilterBufferN1.GetUAV());
-					rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGGatherFilterN1UAV, rcFilterBufferN1UAV);
+					// First cascade has no prior cascade to be filtered by.
+					if (cascadeIndex > 0)
+					{
+						ByteAddressBuffer& gatherFilterBufferN = m_rcManager3D.GetCascadeGatherFilterBuffer(cascadeIndex - 1);
+
+						const DescriptorHandle& rcFilterBufferNUAV = RuntimeResourceManager::GetDescCopy(gatherFilterBufferN.GetUAV());
+						rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGGatherFilterNUAV, rcFilterBufferNUAV);
+					}
 				}
 
-				// First cascade has no prior cascade to be filtered by.
-				if (cascadeIndex > 0)
+				// Cascade 0 has no previous cascade to build its list.
+				if (useCascadeActiveProbeDirectionList && cascadeIndex > 0)
 				{
-					ColorBuffer& gatherFilterBufferN = m_rcManager3D.GetCascadeGatherFilterBuffer(cascadeIndex - 1);
+					IndirectArgsBuffer& gatherDispatchArgs = m_rcManager3D.GetGatherDispatchArgsBuffer();
+					ByteAddressBuffer& activeProbeDirectionCounts = m_rcManager3D.GetActiveProbeDirectionCountBuffer();
+					const uint64_t argsOffset = cascadeIndex * sizeof(D3D12_DISPATCH_RAYS_DESC);
+
+					rtContext.TransitionResource(activeProbeDirectionCounts, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					rtContext.CopyBufferRegion(gatherDispatchArgs, argsOffset + offsetof(D3D12_DISPATCH_RAYS_DESC, Width), activeProbeDirectionCounts, cascadeIndex * sizeof(uint32_t), sizeof(uint32_t));
+
+					rtContext.TransitionResource(gatherDispatchArgs, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+					rtContext.TransitionResource(activeProbeDirectionCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					rtContext.InsertUAVBarrier(m_rcManager3D.GetActiveProbeDirectionBuffer(), true);
+
+					::DispatchRaysIndirect(RayDispatchIDRCRaytracing, m_dispatchRaysCommandSignature, gatherDispatchArgs, argsOffset, rtContext, rtCommandList);
+				}
+				else
+				{
+					::DispatchRays(
+						RayDispatchIDRCRaytracing,
+						m_rcManager3D.GetCascadeIntervalWidth(cascadeIndex),
+						cascadeUpdate.rowCount,
+						rtCommandList
+					);
+				}
+			}
+		}
 
-					const DescriptorHandle& rcFilterBufferNUAV = RuntimeResourceManager::GetDescCopy(gatherFilterBufferN.GetUAV());
-					rtCommandList->SetComputeRootDescriptorTable(RootEntryRCRaytracingRTGGatherFilterNUAV, rcFilterBufferNUAV);
+		// Stored before the merge, so that later frames reproject the intervals of each cascade on its own.
+		if (useStaggeredUpdates)
+		{
+			// The atlas is copied as a whole, cascade 0 is copied along but never read.
+			const uint32_t historyCascadeCount = useCascadeAtlas ? 2u : maxCascade;
+			for (uint32_t cascadeIndex = 1; cascadeIndex < historyCascadeCount; cascadeIndex++)
+			{
+				ColorBuffer& cascadeHistory = m_rcManager3D.GetCascadeHistoryBuffer(cascadeIndex);
+				ColorBuffer& cascadeBuffer = m_rcManager3D.GetCascadeIntervalBuffer(cascadeIndex);
+				rtContext.TransitionResource(cascadeBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+				rtContext.TransitionResource(cascadeHistory, D3D12_RESOURCE_STATE_COPY_DEST);
+				rtContext.CopySubresource(cascadeHistory, 0, cascadeBuffer, 0);
+
+				if (useVisibilityPlane)
+				{
+					ColorBuffer& visibilityHistory = m_rcManager3D.GetCascadeVisibilityHistoryBuffer(cascadeIndex);
+					ColorBuffer& visibilityBuffer = m_rcManager3D.GetCascadeVisibilityBuffer(cascadeIndex);
+					rtContext.TransitionResource(visibilityBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					rtContext.TransitionResource(visibilityHistory, D3D12_RESOURCE_STATE_COPY_DEST);
+					rtContext.CopySubresource(visibilityHistory, 0, visibilityBuffer, 0);
 				}
 			}
 
-			::DispatchRays(
-				RayDispatchIDRCRaytracing,
-				cascadeBuffer.GetWidth(),
-				cascadeBuffer.GetHeight(),
-				rtCommandList
-			);
+			rtContext.TransitionResource(destDepthBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+			rtContext.TransitionResource(m_rcHistoryDepthBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+			rtContext.CopySubresource(m_rcHistoryDepthBuffer, 0, destDepthBuffer, 0);
+
+			m_rcHistoryViewProjMatrix = camera.GetViewProjMatrix();
+			m_rcManager3D.AdvanceCascadeUpdateFrame();
 		}
 	}
 
-	rtContext.Finish(true);
+	rtContext.Finish();
 }
 
 void RadianceCascades::RunRCMerge(Math::Camera& cam, ColorBuffer& hiZBuffer)
@@ -1385,48 +1757,340 @@ void RadianceCascades::RunRCMerge(Math::Camera& cam, ColorBuffer& hiZBuffer)
 	{
 		GPU_PROFILE_BLOCK("RC Merge Pass", cmptContext);
 
-		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergePSO);
-		cmptContext.SetPipelineState(pso);
-		cmptContext.SetRootSignature(pso.GetRootSignature());
-
 		RCGlobals rcGlobals = {};
 		m_rcManager3D.FillRCGlobalInfo(rcGlobals);
 
 		GlobalInfo globalInfo = {};
 		::FillGlobalInfo(globalInfo, cam, m_settings.globalSettings.useSkybox);
 
+		cmptContext.TransitionResource(m_depthBufferCopy, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+		// Merge weights only depend on depth and not on any merge result, so the weights of every cascade are written up front.
+		const bool usePrecomputedMergeWeights = m_rcManager3D.UsesPrecomputedMergeWeights();
+		if (usePrecomputedMergeWeights)
+		{
+			StructuredBuffer& mergeWeights = m_rcManager3D.GetMergeWeightsBuffer();
+
+			::SetComputePSOAndRootSig(cmptContext, PSOIDRC3DMergeWeightsPSO);
+
+			cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeWeightsRCGlobalsCB, sizeof(RCGlobals), &rcGlobals);
+			cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeWeightsGlobalInfoCB, sizeof(GlobalInfo), &globalInfo);
+
+			cmptContext.TransitionResource(mergeWeights, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeWeightsDepthSRV, 0, m_depthBufferCopy.GetSRV());
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeWeightsOutputUAV, 0, mergeWeights.GetUAV());
+
+			// Each cascade writes its own range of the buffer, no barriers are needed in between.
+			for (uint32_t i = 0; i < m_rcManager3D.GetActiveCascadeCount() - 1; i++)
+			{
+				CascadeInfo cascadeInfo = {};
+				cascadeInfo.cascadeIndex = i;
+				cascadeInfo.mergeWeightsOffset = m_rcManager3D.GetMergeWeightsOffset(i);
+
+				cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeWeightsCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
+
+				ProbeDims probeDims = m_rcManager3D.GetProbeDims(i);
+				cmptContext.Dispatch2D(probeDims.probesX, probeDims.probesY);
+			}
+
+			cmptContext.TransitionResource(mergeWeights, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		}
+
+		ComputePSO& pso = RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergePSO);
+		cmptContext.SetPipelineState(pso);
+		cmptContext.SetRootSignature(pso.GetRootSignature());
+
 		cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeRCGlobalsCB, sizeof(RCGlobals), &rcGlobals);
 		cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeGlobalInfoCB, sizeof(GlobalInfo), &globalInfo);
 
-		cmptContext.TransitionResource(m_depthBufferCopy, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 		cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeHiZSRV, 0, m_depthBufferCopy.GetSRV());
 
+		// Only written to by the fused merge and coalesce but always bound, it is a valid UAV either way.
+		ColorBuffer& coalesceBuffer = m_rcManager3D.GetCoalesceBuffer();
+		cmptContext.TransitionResource(coalesceBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCoalesceOutputUAV, 0, coalesceBuffer.GetUAV());
+
+		// The weights SRV is only read with precomputed merge weights but always needs a valid descriptor.
+		if (usePrecomputedMergeWeights)
+		{
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeWeightsSRV, 0, m_rcManager3D.GetMergeWeightsBuffer().GetSRV());
+		}
+		else
+		{
+			cmptContext.TransitionResource(m_dummyMergeWeights, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeWeightsSRV, 0, m_dummyMergeWeights.GetSRV());
+		}
+
 #if defined(_DEBUGDRAWING)
 		DebugDrawer::BindDebugBuffers(cmptContext, RootEntryRC3DMergeCount);
 #endif
 
-		for (uint32_t i = m_rcManager3D.GetCascadeIntervalCount() - 1; i >= 1; i--)
+		// Cascade N1 is read through the atlas UAV in the shader, the SRV slot only needs a valid descriptor.
+		const bool useCascadeAtlas = m_rcManager3D.UsesCascadeAtlas();
+		const bool useVisibilityPlane = m_rcManager3D.UsesVisibilityPlane();
+		if (useCascadeAtlas)
+		{
+			ColorBuffer& cascadeAtlas = m_rcManager3D.GetCascadeAtlasBuffer();
+			cmptContext.TransitionResource(cascadeAtlas, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1SRV, 0, Graphics::GetDefaultTexture(Graphics::kBlackTransparent2D));
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNUAV, 0, cascadeAtlas.GetUAV());
+
+			if (useVisibilityPlane)
+			{
+				ColorBuffer& atlasVisibility = m_rcManager3D.GetCascadeVisibilityBuffer(0);
+				cmptContext.TransitionResource(atlasVisibility, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+				cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1VisibilitySRV, 0, Graphics::GetDefaultTexture(Graphics::kBlackTransparent2D));
+				cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNVisibilityUAV, 0, atlasVisibility.GetUAV());
+			}
+		}
+
+		// Visibility planes are only read and written if the interval format has one, the slots are always bound with valid descriptors.
+		if (!useVisibilityPlane)
+		{
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1VisibilitySRV, 0, Graphics::GetDefaultTexture(Graphics::kBlackTransparent2D));
+			cmptContext.TransitionResource(m_dummyVisibilityBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNVisibilityUAV, 0, m_dummyVisibilityBuffer.GetUAV());
+		}
+
+		for (uint32_t i = m_rcManager3D.GetActiveCascadeCount() - 1; i >= 1; i--)
 		{
 			CascadeInfo cascadeInfo = {};
 			cascadeInfo.cascadeIndex = i - 1;
+			if (usePrecomputedMergeWeights)
+			{
+				cascadeInfo.mergeWeightsOffset = m_rcManager3D.GetMergeWeightsOffset(i - 1);
+			}
 
 			cmptContext.SetDynamicConstantBufferView(RootEntryRC3DMergeCascadeInfoCB, sizeof(CascadeInfo), &cascadeInfo);
 
-			ColorBuffer& cascadeN1 = m_rcManager3D.GetCascadeIntervalBuffer(i);
-			ColorBuffer& cascadeN = m_rcManager3D.GetCascadeIntervalBuffer(i - 1);
+			if (useCascadeAtlas)
+			{
+				// Cascade N1 was written by the previous merge.
+				if (useVisibilityPlane)
+				{
+					cmptContext.InsertUAVBarrier(m_rcManager3D.GetCascadeVisibilityBuffer(0));
+				}
+				cmptContext.InsertUAVBarrier(m_rcManager3D.GetCascadeAtlasBuffer(), true);
+			}
+			else
+			{
+				ColorBuffer& cascadeN1 = m_rcManager3D.GetCascadeIntervalBuffer(i);
+				ColorBuffer& cascadeN = m_rcManager3D.GetCascadeIntervalBuffer(i - 1);
+
+				cmptContext.TransitionResource(cascadeN1, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				cmptContext.TransitionResource(cascadeN, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+				if (useVisibilityPlane)
+				{
+					ColorBuffer& visibilityN1 = m_rcManager3D.GetCascadeVisibilityBuffer(i);
+					ColorBuffer& visibilityN = m_rcManager3D.GetCascadeVisibilityBuffer(i - 1);
+
+					cmptContext.TransitionResource(visibilityN1, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					cmptContext.TransitionResource(visibilityN, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+					cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1VisibilitySRV, 0, visibilityN1.GetSRV());
+					cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNVisibilityUAV, 0, visibilityN.GetUAV());
+				}
+
+				cmptContext.FlushResourceBarriers();
+
+				cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1SRV, 0, cascadeN1.GetSRV());
+				cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNUAV, 0, cascadeN.GetUAV());
+			}
+
+			if (i == 1 && m_rcManager3D.UsesFusedMergeCoalesce())
+			{
+				// Same root signature, all bindings stay valid.
+				cmptContext.SetPipelineState(RuntimeResourceManager::GetComputePSO(PSOIDRC3DMergeCoalescePSO));
+
+				// One thread group per 8 x 8 probes of cascade 0, the rays of each probe are handled within the group.
+				ProbeDims probeDims = m_rcManager3D.GetProbeDims(0);
+				cmptContext.Dispatch2D(probeDims.probesX, probeDims.probesY);
+			}
+			else
+			{
+				cmptContext.Dispatch2D(m_rcManager3D.GetCascadeIntervalWidth(i - 1), m_rcManager3D.GetCascadeIntervalHeight(i - 1));
+			}
+		}
+	}
+
+	cmptContext.Finish();
+}
+
+void RadianceCascades::UpdateRCMergeShaders()
+{
+	const uint32_t permutation = m_rcManager3D.GetMergeScalingPermutation();
+	if (permutation == m_rc3dMergePermutation)
+	{
+		return;
+	}
+
+	ShaderID mergeShaderID = ShaderIDRCMerge3DCS;
+	ShaderID mergeCoalesceShaderID = ShaderIDRCMergeCoalesce3DCS;
+	if (permutation != CPUReference::InvalidScalingPermutation)
+	{
+		if (m_rc3dMergePermutationShaders[permutation] == ShaderIDNone)
+		{
+			const std::vector<DxcDefine> defines = ::GetMergePermutationDefines(permutation);
+			m_rc3dMergePermutationShaders[permutation] = RuntimeResourceManager::RegisterShaderPermutation(ShaderIDRCMerge3DCS, defines);
+			m_rc3dMergeCoalescePermutationShaders[permutation] = RuntimeResourceManager::RegisterShaderPermutation(ShaderIDRCMergeCoalesce3DCS, defines);
+		}
+
+		mergeShaderID = m_rc3dMergePermutationShaders[permutation];
+		mergeCoalesceShaderID = m_rc3dMergeCoalescePermutationShaders[permutation];
+	}
+
+	RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DMergePSO, mergeShaderID, true);
+	RuntimeResourceManager::SetShaderForPSO(PSOIDRC3DMergeCoalescePSO, mergeCoalesceShaderID, true);
+
+	m_rc3dMergePermutation = permutation;
+}
+
+void RadianceCascades::UpdateDynamicQuality()
+{
+	const RCRenderSettings& rcrs = m_settings.rcRenderSettings;
+	const bool useDynamicQuality = rcrs.useDynamicQuality && rcrs.renderRC3D && m_settings.globalSettings.renderMode == GlobalSettings::RenderModeRaster;
+
+	if (!useDynamicQuality)
+	{
+		if (m_isDynamicQualityActive)
+		{
+			m_isDynamicQualityActive = false;
+
+			if (m_rcManager3D.GetRaysPerProbe0() != m_qualityMaxStaticParams.raysPerProbe0 || m_rcManager3D.GetProbeSpacing0() != m_qualityMaxStaticParams.probeSpacing0)
+			{
+				m_rcManager3D.Regenerate(m_qualityMaxStaticParams.raysPerProbe0, m_qualityMaxStaticParams.probeSpacing0);
+			}
+
+			ApplyQualityKnobs(m_qualityMaxKnobs);
+			m_rcManager3D.SetActiveCascadeLimit(UINT32_MAX);
+		}
+
+		return;
+	}
+
+	if (!m_isDynamicQualityActive)
+	{
+		m_isDynamicQualityActive = true;
+
+		m_qualityMaxKnobs.useGatherFiltering = m_rcManager3D.UsesGatherFiltering();
+		m_qualityMaxKnobs.rayLength0 = m_rcManager3D.GetRayLength0();
+		m_qualityMaxKnobs.activeCascadeCount = m_rcManager3D.GetCascadeIntervalCount();
+		m_qualityMaxStaticParams.raysPerProbe0 = m_rcManager3D.GetRaysPerProbe0();
+		m_qualityMaxStaticParams.probeSpacing0 = m_rcManager3D.GetProbeSpacing0();
+		m_qualityMaxUpdateSchedule = m_rcManager3D.GetCascadeUpdateSchedule();
+		m_qualityMaxKnobs.updatePeriodLog2 = m_rcManager3D.UsesStaggeredUpdates() ? m_qualityMaxUpdateSchedule.maxPeriodLog2 : 0u;
+
+		// Forces the controller to be built below.
+		m_qualityBudgetMs = 0.0f;
+	}
+
+	if (m_qualityBudgetMs != rcrs.rcBudgetMs || m_qualityAllowsRegeneration != rcrs.allowDynamicRegeneration)
+	{
+		m_qualityBudgetMs = rcrs.rcBudgetMs;
+		m_qualityAllowsRegeneration = rcrs.allowDynamicRegeneration;
+
+		uint32_t staticStep = 0u;
+		const CPUReference::QualityControllerDesc desc = GetQualityControllerDesc(staticStep);
+		m_qualityController.SetDesc(desc, staticStep);
+
+		// Only if the step the cascades were regenerated with is no longer one of the steps.
+		const CPUReference::QualityStaticParams& staticParams = m_qualityController.GetStaticParams();
+		if (m_rcManager3D.GetRaysPerProbe0() != staticParams.raysPerProbe0 || m_rcManager3D.GetProbeSpacing0() != staticParams.probeSpacing0)
+		{
+			m_rcManager3D.Regenerate(staticParams.raysPerProbe0, staticParams.probeSpacing0);
+		}
+
+		ApplyQualityKnobs(m_qualityController.GetKnobs());
+
+		return;
+	}
+
+	// Only gathered and merged with PROFILE_GPU.
+	float gatherMs = 0.0f;
+	float mergeMs = 0.0f;
+	if (!GPUProfiler::Get().GetLastSample("RC Gather", gatherMs) || !GPUProfiler::Get().GetLastSample("RC Merge Pass", mergeMs))
+	{
+		return;
+	}
+
+	const CPUReference::QualityUpdate update = m_qualityController.Update(gatherMs, mergeMs);
+	if (update.staticParamsChanged)
+	{
+		const CPUReference::QualityStaticParams& staticParams = m_qualityController.GetStaticParams();
+		m_rcManager3D.Regenerate(staticParams.raysPerProbe0, staticParams.probeSpacing0);
+	}
+
+	if (update.knobsChanged || update.staticParamsChanged)
+	{
+		ApplyQualityKnobs(m_qualityController.GetKnobs());
+	}
+}
 
-			cmptContext.TransitionResource(cascadeN1, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			cmptContext.TransitionResource(cascadeN, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			cmptContext.FlushResourceBarriers();
+CPUReference::QualityControllerDesc RadianceCascades::GetQualityControllerDesc(uint32_t& staticStepOut)
+{
+	CPUReference::QualityControllerDesc desc;
+	desc.budgetMs = m_qualityBudgetMs;
+	desc.maxKnobs = m_qualityMaxKnobs;
+	desc.canStaggerUpdates = m_rcManager3D.UsesStaggeredUpdates();
+	desc.maxUpdatePeriodLog2 = (std::max)(desc.maxUpdatePeriodLog2, m_qualityMaxKnobs.updatePeriodLog2);
+	desc.minActiveCascadeCount = (std::min)(desc.minActiveCascadeCount, m_qualityMaxKnobs.activeCascadeCount);
+
+	// The settings from before are the most expensive step, followed by the cheaper ones of these.
+	const CPUReference::QualityStaticParams cheaperStaticSteps[] = {
+		{ 36u, 2u },
+		{ 16u, 2u },
+		{ 16u, 3u },
+		{ 4u, 2u },
+		{ 4u, 4u }
+	};
 
-			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeN1SRV, 0, cascadeN1.GetSRV());
-			cmptContext.SetDynamicDescriptor(RootEntryRC3DMergeCascadeNUAV, 0, cascadeN.GetUAV());
+	auto getStaticCost = [](const CPUReference::QualityStaticParams& staticParams)
+	{
+		return staticParams.raysPerProbe0 / float(staticParams.probeSpacing0 * staticParams.probeSpacing0);
+	};
 
-			cmptContext.Dispatch2D(cascadeN.GetWidth(), cascadeN.GetHeight());
+	desc.staticSteps = { m_qualityMaxStaticParams };
+	if (m_qualityAllowsRegeneration)
+	{
+		for (const CPUReference::QualityStaticParams& staticParams : cheaperStaticSteps)
+		{
+			if (getStaticCost(staticParams) < getStaticCost(desc.staticSteps.back()))
+			{
+				desc.staticSteps.push_back(staticParams);
+			}
+		}
+	}
+
+	// Continues from the current cascades if the controller regenerated them before, otherwise from the settings from before.
+	staticStepOut = 0u;
+	for (uint32_t i = 0; i < (uint32_t)desc.staticSteps.size(); i++)
+	{
+		if (desc.staticSteps[i].raysPerProbe0 == m_rcManager3D.GetRaysPerProbe0() && desc.staticSteps[i].probeSpacing0 == m_rcManager3D.GetProbeSpacing0())
+		{
+			staticStepOut = i;
 		}
 	}
 
-	cmptContext.Finish(true);
+	return desc;
+}
+
+void RadianceCascades::ApplyQualityKnobs(const CPUReference::QualityKnobs& knobs)
+{
+	m_rcManager3D.SetGatherFiltering(knobs.useGatherFiltering);
+	m_rcManager3D.SetRayLength0(knobs.rayLength0);
+	m_rcManager3D.SetActiveCascadeLimit(knobs.activeCascadeCount);
+
+	if (m_rcManager3D.UsesStaggeredUpdates())
+	{
+		// Longer periods than the ones from before only gather a subset of the probe rows each frame, so the cost is spread evenly.
+		CPUReference::CascadeUpdateScheduleDesc updateSchedule = m_qualityMaxUpdateSchedule;
+		updateSchedule.maxPeriodLog2 = knobs.updatePeriodLog2;
+		updateSchedule.useRoundRobinRows |= knobs.updatePeriodLog2 > m_qualityMaxUpdateSchedule.maxPeriodLog2;
+		m_rcManager3D.SetCascadeUpdateSchedule(updateSchedule);
+	}
 }
 
 void RadianceCascades::RenderDepthOnly(Camera& camera, DepthBuffer& targetDepth, D3D12_VIEWPORT viewPort, D3D12_RECT scissor, bool clearDepth)
@@ -1450,7 +2114,7 @@ void RadianceCascades::RenderDepthOnly(Camera& camera, DepthBuffer& targetDepth,
 	GlobalConstants globals = {}; // Empty because depth pass fills its own global info.
 	meshSorter.RenderMeshes(Renderer::MeshSorter::kZPass, gfxContext, globals);
 
-	gfxContext.Finish(true);
+	gfxContext.Finish();
 }
 
 void RadianceCascades::BuildHiZBuffer(DepthBuffer& sourceDepthBuffer)
@@ -1463,10 +2127,6 @@ void RadianceCascades::BuildHiZBuffer(DepthBuffer& sourceDepthBuffer)
 	{
 		GPU_PROFILE_BLOCK("Hi-Z Pass", cmptContext);
 
-		const ComputePSO& cmptPSO = RuntimeResourceManager::GetComputePSO(PSOIDComputeHiZBufferPSO);
-		cmptContext.SetPipelineState(cmptPSO);
-		cmptContext.SetRootSignature(cmptPSO.GetRootSignature());
-
 		// Copy the depth buffer to a color buffer that can be read from as a UAV.
 		{
 			cmptContext.TransitionResource(sourceDepthBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
@@ -1474,67 +2134,134 @@ void RadianceCascades::BuildHiZBuffer(DepthBuffer& sourceDepthBuffer)
 			cmptContext.CopySubresource(depthBufferCopy, 0, sourceDepthBuffer, 0);
 		}
 
-		cmptContext.TransitionResource(hiZBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		cmptContext.TransitionResource(depthBufferCopy, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		cmptContext.TransitionResource(hiZBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+		// Has to be the same resolution.
+		ASSERT(depthBufferCopy.GetWidth() == hiZBuffer.GetWidth() && depthBufferCopy.GetHeight() == hiZBuffer.GetHeight());
 
-		// The first pass of min max depth uses the full resolution copy and writes to the first mip. 
+		if (m_settings.globalSettings.useSinglePassHiZ)
 		{
-			SourceInfo depthSourceInfo = {};
-			depthSourceInfo.isFirstDepth = true;
-			depthSourceInfo.sourceWidth = depthBufferCopy.GetWidth();
-			depthSourceInfo.sourceHeight = depthBufferCopy.GetHeight();
-
-			// Has to be the same resolution.
-			ASSERT(depthSourceInfo.sourceWidth == hiZBuffer.GetWidth() && depthSourceInfo.sourceHeight == hiZBuffer.GetHeight());
-
-			cmptContext.SetDynamicConstantBufferView(RootEntryHiZSourceInfo, sizeof(depthSourceInfo), &depthSourceInfo);
-			cmptContext.SetDynamicDescriptors(RootEntryHiZSourceDepthUAV, 0, 1, &depthBufferCopy.GetUAV());
-			cmptContext.SetDynamicDescriptors(RootEntryHiZTargetDepthUAV, 0, 1, &hiZBuffer.GetUAV());
-
-			cmptContext.Dispatch2D(depthSourceInfo.sourceWidth, depthSourceInfo.sourceHeight);
+			BuildHiZBufferSinglePass(cmptContext);
 		}
-
-		const D3D12_CPU_DESCRIPTOR_HANDLE* startUAV = &hiZBuffer.GetUAV();
-		const uint32_t numMipMaps = hiZBuffer.GetNumMipMaps();
-		for (uint32_t i = 0; i < numMipMaps; i++)
+		else
 		{
-			SourceInfo depthSourceInfo = {};
-			depthSourceInfo.isFirstDepth = false;
-			depthSourceInfo.sourceWidth = hiZBuffer.GetWidth() >> i;
-			depthSourceInfo.sourceHeight = hiZBuffer.GetHeight() >> i;
-
-			cmptContext.SetDynamicConstantBufferView(RootEntryHiZSourceInfo, sizeof(depthSourceInfo), &depthSourceInfo);
-			cmptContext.SetDynamicDescriptors(RootEntryHiZSourceDepthUAV, 0, 1, startUAV + i);
-			cmptContext.SetDynamicDescriptors(RootEntryHiZTargetDepthUAV, 0, 1, startUAV + i + 1);
-
-			// Must insert resource barrier between each dispatch as the output will otherwise be undefined.
-			// TODO: Find why this is necessary when the same resource is being used? Each dispatch needs to be executed before the next can start, no?
-			cmptContext.InsertUAVBarrier(hiZBuffer);
-			cmptContext.Dispatch2D(depthSourceInfo.sourceWidth >> 1, depthSourceInfo.sourceHeight >> 1);
+			BuildHiZBufferPerMip(cmptContext);
 		}
 
-		// Copy min max info into readback buffer.
+		// Copy min max info into readback buffer, skipped if every slot is still being copied into or read.
+		uint64_t readbackOffset = 0u;
+		if (m_hiZReadbackRing.BeginWrite(Graphics::GetFrameCount(), readbackOffset))
 		{
+			ReadbackBuffer& readbackBuffer = m_hiZReadbackRing.GetBuffer();
+
 			cmptContext.TransitionResource(hiZBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
-			cmptContext.TransitionResource(m_hiZReadbackBuffer, D3D12_RESOURCE_STATE_COPY_DEST, true);
+			cmptContext.TransitionResource(readbackBuffer, D3D12_RESOURCE_STATE_COPY_DEST, true);
 
 			D3D12_TEXTURE_COPY_LOCATION sourceLocation = CD3DX12_TEXTURE_COPY_LOCATION(hiZBuffer.GetResource(), hiZBuffer.GetNumMipMaps());
 
 			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+			footprint.Offset = readbackOffset;
 			footprint.Footprint.Format = DXGI_FORMAT_R32G32_FLOAT;
 			footprint.Footprint.Width = 1;
 			footprint.Footprint.Height = 1;
 			footprint.Footprint.Depth = 1;
 			footprint.Footprint.RowPitch = D3D12_TEXTURE_DATA_PITCH_ALIGNMENT; // Required minium pitch.
 
-			D3D12_TEXTURE_COPY_LOCATION destLocation = CD3DX12_TEXTURE_COPY_LOCATION(m_hiZReadbackBuffer.GetResource(), footprint);
+			D3D12_TEXTURE_COPY_LOCATION destLocation = CD3DX12_TEXTURE_COPY_LOCATION(readbackBuffer.GetResource(), footprint);
 
 			cmptContext.GetCommandList()->CopyTextureRegion(&destLocation, 0, 0, 0, &sourceLocation, nullptr);
 		}
 	}
 
-	cmptContext.Finish(true);
+	// The readback is picked up frames later by GetSceneMinMaxDepth(), so there is no need to wait for it here.
+	m_hiZReadbackRing.EndWrite(cmptContext.Finish());
+}
+
+void RadianceCascades::BuildHiZBufferPerMip(ComputeContext& cmptContext)
+{
+	ColorBuffer& depthBufferCopy = m_depthBufferCopy;
+	ColorBuffer& hiZBuffer = m_hiZBuffer;
+
+	::SetComputePSOAndRootSig(cmptContext, PSOIDComputeHiZBufferPSO);
+
+	cmptContext.TransitionResource(depthBufferCopy, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	cmptContext.TransitionResource(hiZBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+	// The first pass of min max depth uses the full resolution copy and writes to the first mip. 
+	{
+		SourceInfo depthSourceInfo = {};
+		depthSourceInfo.isFirstDepth = true;
+		depthSourceInfo.sourceWidth = depthBufferCopy.GetWidth();
+		depthSourceInfo.sourceHeight = depthBufferCopy.GetHeight();
+
+		cmptContext.SetDynamicConstantBufferView(RootEntryHiZSourceInfo, sizeof(depthSourceInfo), &depthSourceInfo);
+		cmptContext.SetDynamicDescriptors(RootEntryHiZSourceDepthUAV, 0, 1, &depthBufferCopy.GetUAV());
+		cmptContext.SetDynamicDescriptors(RootEntryHiZTargetDepthUAV, 0, 1, &hiZBuffer.GetUAV());
+
+		cmptContext.Dispatch2D(depthSourceInfo.sourceWidth, depthSourceInfo.sourceHeight);
+	}
+
+	const D3D12_CPU_DESCRIPTOR_HANDLE* startUAV = &hiZBuffer.GetUAV();
+	const uint32_t numMipMaps = hiZBuffer.GetNumMipMaps();
+	for (uint32_t i = 0; i < numMipMaps; i++)
+	{
+		SourceInfo depthSourceInfo = {};
+		depthSourceInfo.isFirstDepth = false;
+		depthSourceInfo.sourceWidth = (std::max)(hiZBuffer.GetWidth() >> i, 1u);
+		depthSourceInfo.sourceHeight = (std::max)(hiZBuffer.GetHeight() >> i, 1u);
+
+		cmptContext.SetDynamicConstantBufferView(RootEntryHiZSourceInfo, sizeof(depthSourceInfo), &depthSourceInfo);
+		cmptContext.SetDynamicDescriptors(RootEntryHiZSourceDepthUAV, 0, 1, startUAV + i);
+		cmptContext.SetDynamicDescriptors(RootEntryHiZTargetDepthUAV, 0, 1, startUAV + i + 1);
+
+		// Must insert resource barrier between each dispatch as the output will otherwise be undefined.
+		// TODO: Find why this is necessary when the same resource is being used? Each dispatch needs to be executed before the next can start, no?
+		cmptContext.InsertUAVBarrier(hiZBuffer);
+		// Mips stop halving at 1 texel, the other dimension can still have texels left to reduce.
+		cmptContext.Dispatch2D((std::max)(depthSourceInfo.sourceWidth >> 1, 1u), (std::max)(depthSourceInfo.sourceHeight >> 1, 1u));
+	}
+}
+
+void RadianceCascades::BuildHiZBufferSinglePass(ComputeContext& cmptContext)
+{
+	ColorBuffer& depthBufferCopy = m_depthBufferCopy;
+	ColorBuffer& hiZBuffer = m_hiZBuffer;
+
+	::SetComputePSOAndRootSig(cmptContext, PSOIDComputeHiZSinglePassPSO);
+
+	const uint32_t mipCount = hiZBuffer.GetNumMipMaps() + 1u;
+	ASSERT(mipCount <= HiZMaxMipCount);
+
+	// The last group of a row or column also takes the texels past the last full tile.
+	const uint32_t groupCountX = (std::max)(hiZBuffer.GetWidth() / HiZTileSize, 1u);
+	const uint32_t groupCountY = (std::max)(hiZBuffer.GetHeight() / HiZTileSize, 1u);
+
+	HiZInfo hiZInfo = {};
+	hiZInfo.sourceWidth = hiZBuffer.GetWidth();
+	hiZInfo.sourceHeight = hiZBuffer.GetHeight();
+	hiZInfo.mipCount = mipCount;
+	hiZInfo.groupCount = groupCountX * groupCountY;
+
+	cmptContext.TransitionResource(depthBufferCopy, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	cmptContext.TransitionResource(hiZBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	cmptContext.TransitionResource(m_hiZGroupCounter, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+	// The last group to finish is found by counting finished groups.
+	cmptContext.ClearUAV(m_hiZGroupCounter);
+	cmptContext.InsertUAVBarrier(m_hiZGroupCounter);
+
+	// Every slot has to hold a valid descriptor, mips past the last one are bound to the last mip and never written.
+	std::array<D3D12_CPU_DESCRIPTOR_HANDLE, HiZMaxMipCount> mipUAVs = {};
+	const D3D12_CPU_DESCRIPTOR_HANDLE* startUAV = &hiZBuffer.GetUAV();
+	for (uint32_t i = 0; i < HiZMaxMipCount; i++)
+	{
+		mipUAVs[i] = startUAV[(std::min)(i, mipCount - 1u)];
+	}
+
+	cmptContext.SetDynamicConstantBufferView(RootEntryHiZSinglePassInfo, sizeof(hiZInfo), &hiZInfo);
+	cmptContext.SetDynamicDescriptor(RootEntryHiZSinglePassDepthSRV, 0, depthBufferCopy.GetSRV());
+	cmptContext.SetDynamicDescriptors(RootEntryHiZSinglePassMipsUAV, 0, HiZMaxMipCount, mipUAVs.data());
+	cmptContext.SetDynamicDescriptor(RootEntryHiZSinglePassGroupCounterUAV, 0, m_hiZGroupCounter.GetUAV());
+
+	cmptContext.Dispatch(groupCountX, groupCountY, 1);
 }
 
 void RadianceCascades::RunRCCoalesce()
@@ -1563,7 +2290,7 @@ void RadianceCascades::RunRCCoalesce()
 		cmptContext.Dispatch2D(coalesceBuffer.GetWidth(), coalesceBuffer.GetHeight());
 	}
 
-	cmptContext.Finish(true);
+	cmptContext.Finish();
 }
 
 void RadianceCascades::RunComputeRCGatherFilterReduction()
@@ -1571,7 +2298,7 @@ void RadianceCascades::RunComputeRCGatherFilterReduction()
 	ComputeContext& cmptContext = ComputeContext::Begin(L"Gather Filter Reduction");
 
 	ByteAddressBuffer& gatherFilterByteAddresBuffer = m_rcManager3D.GetGatherFilterByteAddressBuffer();
-	ReadbackBuffer& gatherFilterReadbackBuffer = m_rcManager3D.GetGatherFilterReadbackBuffer();
+	ReadbackRingBuffer& gatherFilterReadbackRing = m_rcManager3D.GetGatherFilterReadbackRing();
 
 	{
 		GPU_PROFILE_BLOCK("Gather Filter Reduction", cmptContext);
@@ -1583,15 +2310,15 @@ void RadianceCascades::RunComputeRCGatherFilterReduction()
 
 		for (uint32_t i = 0; i < m_rcManager3D.GetGatherFilterCount(); i++)
 		{
-			ColorBuffer& gatherFilterTexture = m_rcManager3D.GetCascadeGatherFilterBuffer(i);
+			ByteAddressBuffer& gatherFilterBuffer = m_rcManager3D.GetCascadeGatherFilterBuffer(i);
 
-			cmptContext.TransitionResource(gatherFilterTexture, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			cmptContext.SetDynamicDescriptor(RootEntryGatherFilterReductionTexture, 0, gatherFilterTexture.GetSRV());
+			cmptContext.TransitionResource(gatherFilterBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			cmptContext.SetDynamicDescriptor(RootEntryGatherFilterReductionSource, 0, gatherFilterBuffer.GetSRV());
 
 			// All data will be copied so ptr will not be invalid when executing the context at the end.
 			FilterInfo filterInfo = {
-				.width = gatherFilterTexture.GetWidth(),
-				.height = gatherFilterTexture.GetHeight(),
+				.width = m_rcManager3D.GetGatherFilterWidth(i),
+				.height = m_rcManager3D.GetGatherFilterHeight(i),
 				.filterIndex = i
 			};
 
@@ -1600,17 +2327,49 @@ void RadianceCascades::RunComputeRCGatherFilterReduction()
 			cmptContext.TransitionResource(gatherFilterByteAddresBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
 			// Group size matches shader.
-			// Each thread is responsible in a 4x4 area.
-			cmptContext.Dispatch2D(filterInfo.width / 4u, filterInfo.height / 4u, 16u, 16u);
+			// Each thread counts the set bits of 4 words.
+			cmptContext.Dispatch1D(Math::DivideByMultiple(gatherFilterBuffer.GetElementCount(), 4u), 256u);
 		}
 
-		
-		cmptContext.TransitionResource(gatherFilterByteAddresBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
-		cmptContext.TransitionResource(gatherFilterReadbackBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
-		cmptContext.CopyBuffer(gatherFilterReadbackBuffer, gatherFilterByteAddresBuffer);
+		// Skipped if every slot is still being copied into or read, the counts shown are then a frame older.
+		uint64_t readbackOffset = 0u;
+		if (gatherFilterReadbackRing.BeginWrite(Graphics::GetFrameCount(), readbackOffset))
+		{
+			cmptContext.TransitionResource(gatherFilterByteAddresBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
+			cmptContext.TransitionResource(gatherFilterReadbackRing.GetBuffer(), D3D12_RESOURCE_STATE_COPY_DEST);
+			cmptContext.CopyBufferRegion(gatherFilterReadbackRing.GetBuffer(), readbackOffset, gatherFilterByteAddresBuffer, 0, gatherFilterReadbackRing.GetSlotSize());
+		}
 	}
 
-	cmptContext.Finish(true);
+	// Read frames later through GetFilteredRayCount(), so there is no need to wait for the copy here.
+	gatherFilterReadbackRing.EndWrite(cmptContext.Finish());
+}
+
+void RadianceCascades::VisualizeGatherFilter(uint32_t filterIndex, ColorBuffer& dest)
+{
+	ComputeContext& cmptContext = ComputeContext::Begin(L"Gather Filter Vis");
+
+	ByteAddressBuffer& gatherFilterBuffer = m_rcManager3D.GetCascadeGatherFilterBuffer(filterIndex);
+
+	cmptContext.SetPipelineState(m_gatherFilterVisPSO);
+	cmptContext.SetRootSignature(m_gatherFilterVisRootSig);
+
+	cmptContext.TransitionResource(dest, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	cmptContext.InsertUAVBarrier(dest);
+	cmptContext.TransitionResource(gatherFilterBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+	cmptContext.SetConstants(
+		RootEntryGatherFilterVisInfo, 
+		dest.GetWidth(), 
+		dest.GetHeight(), 
+		m_rcManager3D.GetGatherFilterWidth(filterIndex), 
+		m_rcManager3D.GetGatherFilterHeight(filterIndex)
+	);
+	cmptContext.SetDynamicDescriptor(RootEntryGatherFilterVisSource, 0, gatherFilterBuffer.GetSRV());
+	cmptContext.SetDynamicDescriptor(RootEntryGatherFilterVisDest, 0, dest.GetUAV());
+
+	cmptContext.Dispatch2D(dest.GetWidth(), dest.GetHeight());
+	cmptContext.Finish();
 }
 
 void RadianceCascades::RunDeferredLightingPass(ColorBuffer& albedoBuffer, ColorBuffer& normalBuffer, ColorBuffer& diffuseRadianceBuffer, ColorBuffer& outputBuffer)
@@ -1662,7 +2421,7 @@ void RadianceCascades::RunDeferredLightingPass(ColorBuffer& albedoBuffer, ColorB
 		gfxContext.Draw(4, 0);
 	}
 
-	gfxContext.Finish(true);
+	gfxContext.Finish();
 }
 
 void RadianceCascades::UpdateViewportAndScissor()
@@ -1746,6 +2505,9 @@ void RadianceCascades::DrawSettingsUI()
 		ImGui::RadioButton("Raster", renderMode, GlobalSettings::RenderModeRaster); ImGui::SameLine();
 		ImGui::RadioButton("Raytracing", renderMode, GlobalSettings::RenderModeRT);
 
+		ImGui::SeparatorText("Hi-Z");
+		ImGui::Checkbox("Build Hi-Z In A Single Pass", &gs.useSinglePassHiZ);
+
 		ImGui::SeparatorText("Skybox");
 		ImGui::Checkbox("Render Skybox", &gs.useSkybox);
 		std::array<const char*, SkyboxIDCount> skyboxNames = {};
@@ -1779,6 +2541,32 @@ void RadianceCascades::DrawSettingsUI()
 		{
 			m_rcManager3D.DrawRCSettingsUI();
 
+			{
+				RCRenderSettings& rcrs = m_settings.rcRenderSettings;
+
+				ImGui::SeparatorText("Dynamic Quality");
+
+				ImGui::Checkbox("Use Dynamic Quality", &rcrs.useDynamicQuality);
+				ImGui::SliderFloat("RC Budget (ms)", &rcrs.rcBudgetMs, 0.5f, 16.0f, "%.1f");
+				ImGui::Checkbox("Allow Regeneration", &rcrs.allowDynamicRegeneration);
+
+				if (m_isDynamicQualityActive)
+				{
+					ImGui::Text("Quality level: %u / %u", m_qualityController.GetLevel(), m_qualityController.GetLevelCount() - 1u);
+					ImGui::Text("Static step: %u / %u", m_qualityController.GetStaticStep(), (uint32_t)m_qualityController.GetDesc().staticSteps.size() - 1u);
+					ImGui::Text("Smoothed RC time: %.2f ms", m_qualityController.GetSmoothedMs());
+				}
+			}
+
+			{
+				RCRenderSettings& rcrs = m_settings.rcRenderSettings;
+
+				ImGui::SeparatorText("Instance Culling");
+
+				ImGui::Checkbox("Use Instance Culling", &rcrs.useInstanceCulling);
+				ImGui::SliderFloat("Small Instance Ratio", &rcrs.smallInstanceRatio, 0.0f, 0.1f, "%.3f");
+			}
+
 			{
 				RCRenderSettings& rcrs = m_settings.rcRenderSettings;
 				int maxCascadeIntervalIndex = m_rcManager3D.GetCascadeIntervalCount() - 1;
@@ -1857,14 +2645,34 @@ void RadianceCascades::ClearBuffers()
 		m_rcManager3D.ClearBuffers(gfxContext);
 	}
 
-	gfxContext.Finish(true);
+	gfxContext.Finish();
 }
 
 void RadianceCascades::FullScreenCopyCompute(PixelBuffer& source, D3D12_CPU_DESCRIPTOR_HANDLE sourceSRV, ColorBuffer& dest)
+{
+	D3D12_RECT sourceRect = { 0, 0, (LONG)source.GetWidth(), (LONG)source.GetHeight() };
+	FullScreenCopyCompute(source, sourceSRV, sourceRect, dest);
+}
+
+void RadianceCascades::FullScreenCopyCompute(PixelBuffer& source, D3D12_CPU_DESCRIPTOR_HANDLE sourceSRV, const D3D12_RECT& sourceRect, ColorBuffer& dest)
 {
 	uint32_t destWidth = dest.GetWidth();
 	uint32_t destHeight = dest.GetHeight();
 
+	// Matches DestInfo in DirectCopyCS.
+	struct
+	{
+		uint32_t destWidth;
+		uint32_t destHeight;
+		float sourceUVOffset[2];
+		float sourceUVScale[2];
+	} destInfo = {
+		destWidth,
+		destHeight,
+		{ sourceRect.left / (float)source.GetWidth(), sourceRect.top / (float)source.GetHeight() },
+		{ (sourceRect.right - sourceRect.left) / (float)source.GetWidth(), (sourceRect.bottom - sourceRect.top) / (float)source.GetHeight() }
+	};
+
 	ComputeContext& cmptContext = ComputeContext::Begin(L"Full Screen Copy Compute");
 
 	cmptContext.SetPipelineState(m_fullScreenCopyComputePSO);
@@ -1874,12 +2682,12 @@ void RadianceCascades::FullScreenCopyCompute(PixelBuffer& source, D3D12_CPU_DESC
 	cmptContext.InsertUAVBarrier(dest);
 	cmptContext.TransitionResource(source, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 
-	cmptContext.SetConstants(RootEntryFullScreenCopyComputeDestInfo, destWidth, destHeight);
+	cmptContext.SetConstantArray(RootEntryFullScreenCopyComputeDestInfo, sizeof(destInfo) / sizeof(uint32_t), &destInfo);
 	cmptContext.SetDynamicDescriptor(RootEntryFullScreenCopyComputeDest, 0, dest.GetUAV());
 	cmptContext.SetDynamicDescriptor(RootEntryFullScreenCopyComputeSource, 0, sourceSRV);
 
 	cmptContext.Dispatch2D(destWidth, destHeight);
-	cmptContext.Finish(true);
+	cmptContext.Finish();
 }
 
 void RadianceCascades::FullScreenCopyCompute(ColorBuffer& source, ColorBuffer& dest)
@@ -1887,6 +2695,11 @@ void RadianceCascades::FullScreenCopyCompute(ColorBuffer& source, ColorBuffer& d
 	FullScreenCopyCompute(source, source.GetSRV(), dest);
 }
 
+void RadianceCascades::FullScreenCopyCompute(ColorBuffer& source, const D3D12_RECT& sourceRect, ColorBuffer& dest)
+{
+	FullScreenCopyCompute(source, source.GetSRV(), sourceRect, dest);
+}
+
 void RadianceCascades::EquilateralToCubemapCompute(TextureRef equilateralTexture, ColorBuffer cubemapTexture)
 {
 	// NOT IMPLEMENTED
@@ -1918,35 +2731,105 @@ void RadianceCascades::AddSceneModel(ModelID modelID, const ModelInstanceDesc& m
 	modelInstance->updateScript = modelInstanceDesc.updateScript;
 }
 
-std::unordered_map<ModelID, std::vector<Utils::GPUMatrix>> RadianceCascades::GetGroupedModelInstances()
+std::set<ModelID> RadianceCascades::GetSceneModelIDs()
 {
-	std::unordered_map<ModelID, std::vector<Utils::GPUMatrix>> groupedModelInsances = {};
+	std::set<ModelID> modelIDs = {};
+	for (const InternalModelInstance& modelInstance : m_sceneModels)
+	{
+		modelIDs.insert(modelInstance.underlyingModelID);
+	}
 
-	for (InternalModelInstance& modelInstance : m_sceneModels)
+	return modelIDs;
+}
+
+void RadianceCascades::RegisterSceneInstances(const std::set<ModelID>& modelIDs)
+{
+	// Each model has a shader table entry per geometry, in the same order as the model IDs the dispatch inputs were built from.
+	// Every instance of a model starts at the same entry.
+	std::unordered_map<ModelID, uint32_t> hitGroupOffsets = {};
+	uint32_t hitGroupOffset = 0u;
+	for (ModelID modelID : modelIDs)
 	{
-		ModelID modelID = modelInstance.underlyingModelID;
-		Math::Matrix4 mat = Math::Matrix4(modelInstance.GetTransform());
-		groupedModelInsances[modelID].push_back(mat);
+		hitGroupOffsets[modelID] = hitGroupOffset;
+		hitGroupOffset += RuntimeResourceManager::GetModelBLAS(modelID).GetNumGeometries();
 	}
 
-	return groupedModelInsances;
+	m_instanceRegistry.Clear();
+	for (InternalModelInstance& modelInstance : m_sceneModels)
+	{
+		const ModelID modelID = modelInstance.underlyingModelID;
+		Utils::GPUMatrix instanceMatrix = Math::Matrix4(modelInstance.GetTransform());
+
+		modelInstance.instanceSlot = m_instanceRegistry.Add(
+			TLASBuffers::ToInstanceTransform(instanceMatrix),
+			RuntimeResourceManager::GetModelBLAS(modelID).GetBVH(),
+			hitGroupOffsets[modelID],
+			CPUReference::InstanceMaskAll // Until UpdateInstanceMasks() culls it.
+		);
+	}
 }
 
-std::vector<TLASInstanceGroup> RadianceCascades::GetTLASInstanceGroups()
+void RadianceCascades::UpdateInstanceMasks()
 {
-	std::unordered_map<ModelID, std::vector<Utils::GPUMatrix>> groupedModelInstances = GetGroupedModelInstances();
+	auto toFloat3 = [](Math::Vector3 v) { return CPUReference::float3((float)v.GetX(), (float)v.GetY(), (float)v.GetZ()); };
+
+	m_instanceMaskInputs.clear();
+	CPUReference::BoxBounds sceneBounds;
+	for (const InternalModelInstance& modelInstance : m_sceneModels)
+	{
+		const Math::BoundingSphere boundingSphere = modelInstance.GetBoundingSphere();
+
+		CPUReference::InstanceMaskInput& maskInput = m_instanceMaskInputs.emplace_back();
+		maskInput.bounds.center = toFloat3(boundingSphere.GetCenter());
+		maskInput.bounds.radius = (float)boundingSphere.GetRadius();
+		maskInput.isEmissive = RuntimeResourceManager::GetInternalModel(modelInstance.underlyingModelID).isEmissive;
+
+		sceneBounds.AddSphere(maskInput.bounds);
+	}
+
+	// Probes are pulled a little towards the camera off the surfaces they are placed on.
+	const float probeOffset = m_rcManager3D.GetRayLength(0);
+	sceneBounds.AddPoint(sceneBounds.minPos - CPUReference::float3(probeOffset));
+	sceneBounds.AddPoint(sceneBounds.maxPos + CPUReference::float3(probeOffset));
+
+	// Probes are placed on the depth buffer of the main camera, so they are inside both its frustum and the scene. Probes on sky pixels are
+	// on the far plane and only light the sky, they are left out. The debug camera renders from elsewhere, so it keeps the whole scene.
+	CPUReference::BoxBounds probeVolume = sceneBounds;
+	if (!m_settings.globalSettings.useDebugCam)
+	{
+		const Math::Frustum& frustum = m_camera.GetWorldSpaceFrustum();
 
-	std::vector<TLASInstanceGroup> instanceGroups = {};
-	for (auto& [modelID, transforms] : groupedModelInstances)
+		CPUReference::BoxBounds frustumBounds;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			frustumBounds.AddPoint(toFloat3(frustum.GetFrustumCorner((Math::Frustum::CornerID)corner)));
+		}
+
+		probeVolume = CPUReference::IntersectBounds(frustumBounds, sceneBounds);
+	}
+
+	m_instanceMasks.assign(m_instanceMaskInputs.size(), CPUReference::InstanceMaskAll);
+
+	const RCRenderSettings& rcrs = m_settings.rcRenderSettings;
+	if (rcrs.useInstanceCulling && !probeVolume.IsEmpty())
 	{
-		TLASInstanceGroup instanceGroup = {};
-		instanceGroup.blasBuffer = &RuntimeResourceManager::GetModelBLAS(modelID);
-		instanceGroup.instanceTransforms = transforms;
+		std::vector<CPUReference::CascadeInterval> intervals(m_rcManager3D.GetCascadeIntervalCount());
+		for (uint32_t cascadeIndex = 0; cascadeIndex < (uint32_t)intervals.size(); cascadeIndex++)
+		{
+			intervals[cascadeIndex].startT = m_rcManager3D.GetStartT(cascadeIndex);
+			intervals[cascadeIndex].range = m_rcManager3D.GetRayLength(cascadeIndex);
+		}
+
+		CPUReference::InstanceMaskDesc maskDesc = {};
+		maskDesc.smallInstanceRatio = rcrs.smallInstanceRatio;
 
-		instanceGroups.push_back(instanceGroup);
+		CPUReference::ComputeInstanceMasks(m_instanceMaskInputs, probeVolume, intervals, maskDesc, m_instanceMasks);
 	}
 
-	return instanceGroups;
+	for (size_t i = 0; i < m_sceneModels.size(); i++)
+	{
+		m_instanceRegistry.SetInstanceMask(m_sceneModels[i].instanceSlot, m_instanceMasks[i]);
+	}
 }
 
 void RadianceCascades::RegisterDisplayDependentTexture(PixelBuffer* pixelBuffer, TextureType textureType)
@@ -1954,12 +2837,16 @@ void RadianceCascades::RegisterDisplayDependentTexture(PixelBuffer* pixelBuffer,
 	m_displayDependentTextures.emplace_back(textureType, pixelBuffer);
 }
 
-void RadianceCascades::GetSceneMinMaxDepth(float& minDepth, float& maxDepth)
+bool RadianceCascades::GetSceneMinMaxDepth(float& minDepth, float& maxDepth, uint64_t* frameAgeOut /*= nullptr*/)
 {
-	float* hiZMinMax = reinterpret_cast<float*>(m_hiZReadbackBuffer.Map());
+	const float* hiZMinMax = reinterpret_cast<const float*>(m_hiZReadbackRing.GetLatest(Graphics::GetFrameCount(), frameAgeOut));
+	if (hiZMinMax == nullptr)
+	{
+		return false;
+	}
 
 	minDepth = hiZMinMax[0];
 	maxDepth = hiZMinMax[1];
 
-	m_hiZReadbackBuffer.Unmap();
+	return true;
 }
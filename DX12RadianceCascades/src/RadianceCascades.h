@@ -8,6 +8,7 @@
 #include "Core\GpuBuffer.h"
 #include "Core\ReadbackBuffer.h"
 #include "Core\Camera.h"
+#include "Core\CommandSignature.h"
 #include "Core\CameraController.h"
 #include "Model\Model.h"
 
@@ -15,8 +16,11 @@
 #include "ShaderTable.h"
 #include "RaytracingDispatchRayInputs.h"
 #include "RuntimeResourceManager.h"
+#include "ReadbackRingBuffer.h"
 
 #include "RadianceCascadeManager3D.h"
+#include "CPUReference\QualityController.h"
+#include "CPUReference\InstanceMasks.h"
 
 #if defined(_DEBUGDRAWING)
 	#define ENABLE_DEBUG_DRAW 1
@@ -108,6 +112,8 @@ public:
 
 	ModelID underlyingModelID;
 	UpdateScript updateScript;
+	// Slot in the scene instance registry, set once the TLAS is initialized.
+	uint32_t instanceSlot = CPUReference::InstanceRegistry::InvalidSlot;
 };
 
 struct ModelInstanceDesc
@@ -140,6 +146,8 @@ struct GlobalSettings
 	bool renderUI = true;
 	bool useLargerUIFontScale = false;
 	bool useSkybox = true;
+	// Builds every Hi-Z mip in one dispatch instead of one dispatch per mip, see HiZSinglePassCS.hlsl.
+	bool useSinglePassHiZ = true;
 };
 
 struct RCRenderSettings
@@ -164,6 +172,17 @@ struct RCRenderSettings
 	bool enableCascadeProbeVis = false;
 	int cascadeVisProbeIntervalIndex = 0;
 	int cascadeVisProbeSubset = 256;
+
+	// Holds the GPU time of the gather and merge passes to rcBudgetMs by lowering the runtime settings of the cascades,
+	// see CPUReference/QualityController.h. The settings from before it was enabled are the highest it goes and are restored after.
+	bool useDynamicQuality = false;
+	float rcBudgetMs = 4.0f;
+	// Also lets it regenerate the cascades with fewer rays or probes, which idles the GPU.
+	bool allowDynamicRegeneration = true;
+
+	// Leaves instances out of the TLAS traversal of the cascades that can not hit them, see CPUReference/InstanceMasks.h.
+	bool useInstanceCulling = true;
+	float smallInstanceRatio = 0.02f;
 };
 
 struct AppSettings
@@ -189,10 +208,15 @@ private:
 		RootEntryFlatlandCount,
 
 		RootEntryGatherFilterReductionInfo = 0,
-		RootEntryGatherFilterReductionTexture,
+		RootEntryGatherFilterReductionSource,
 		RootEntryGatherFilterReductionByteBuffer,
 		RootEntryGatherFilterReductionCount,
 
+		RootEntryGatherFilterVisInfo = 0,
+		RootEntryGatherFilterVisSource,
+		RootEntryGatherFilterVisDest,
+		RootEntryGatherFilterVisCount,
+
 		RootEntryFullScreenCopySource = 0,
 		RootEntryFullScreenCopyCount,
 
@@ -217,6 +241,12 @@ private:
 		RootEntryHiZTargetDepthUAV,
 		RootEntryHiZCount,
 
+		RootEntryHiZSinglePassInfo = 0,
+		RootEntryHiZSinglePassDepthSRV,
+		RootEntryHiZSinglePassMipsUAV,
+		RootEntryHiZSinglePassGroupCounterUAV,
+		RootEntryHiZSinglePassCount,
+
 		RootEntryRCRaytracingRTGSceneSRV = 0,
 		RootEntryRCRaytracingRTGSkyboxSRV,
 		RootEntryRCRaytracingRTGOutputUAV,
@@ -225,7 +255,11 @@ private:
 		RootEntryRCRaytracingRTGGlobalInfoCB,
 		RootEntryRCRaytracingRTGRCGlobalsCB,
 		RootEntryRCRaytracingRTGCascadeInfoCB,
+		RootEntryRCRaytracingRTGCascadeDispatchCB,
 		RootEntryRCRaytracingRTGDepthTextureUAV,
+		RootEntryRCRaytracingRTGActiveProbeDirectionsUAV,
+		RootEntryRCRaytracingRTGActiveProbeDirectionCountsUAV,
+		RootEntryRCRaytracingRTGOutputVisibilityUAV, // Only bound if the interval format has a visibility plane.
 #if defined(_DEBUG)
 		RootEntryRCRaytracingRTGRCVisCB,
 #endif
@@ -242,8 +276,30 @@ private:
 		RootEntryRC3DMergeCascadeInfoCB,
 		RootEntryRC3DMergeHiZSRV,
 		RootEntryRC3DMergeGlobalInfoCB,
+		RootEntryRC3DMergeWeightsSRV,
+		RootEntryRC3DMergeCoalesceOutputUAV, // Only written by the fused merge and coalesce of cascade 0.
+		RootEntryRC3DMergeCascadeN1VisibilitySRV,
+		RootEntryRC3DMergeCascadeNVisibilityUAV,
 		RootEntryRC3DMergeCount,
 
+		RootEntryRC3DMergeWeightsOutputUAV = 0,
+		RootEntryRC3DMergeWeightsRCGlobalsCB,
+		RootEntryRC3DMergeWeightsCascadeInfoCB,
+		RootEntryRC3DMergeWeightsDepthSRV,
+		RootEntryRC3DMergeWeightsGlobalInfoCB,
+		RootEntryRC3DMergeWeightsCount,
+
+		RootEntryRC3DReprojectHistorySRV = 0,
+		RootEntryRC3DReprojectOutputUAV,
+		RootEntryRC3DReprojectDepthSRV,
+		RootEntryRC3DReprojectDepthHistorySRV,
+		RootEntryRC3DReprojectVisibilityHistorySRV,
+		RootEntryRC3DReprojectVisibilityOutputUAV,
+		RootEntryRC3DReprojectRCGlobalsCB,
+		RootEntryRC3DReprojectCascadeInfoCB,
+		RootEntryRC3DReprojectGlobalInfoCB,
+		RootEntryRC3DReprojectCount,
+
 		RootEntryRC3DCoalesceCascade0SRV = 0,
 		RootEntryRC3DCoalesceOutputTexUAV,
 		RootEntryRC3DCoalesceRCGlobalsCB,
@@ -293,10 +349,21 @@ private:
 	void RenderRaytracing(ColorBuffer& targetColor, Camera& camera);
 	void RunRCGather(Camera& camera, DepthBuffer& sourceDepthBuffer);
 	void RunRCMerge(Math::Camera& cam, ColorBuffer& hiZBuffer);
+	// Sets the merge PSOs to the kernel permutation of the current scaling factors if it changed, see RadianceCascadeManager3D::GetMergeScalingPermutation().
+	void UpdateRCMergeShaders();
+	// Feeds the last RC gather and merge times to the quality controller and applies its settings, see RCRenderSettings::useDynamicQuality.
+	void UpdateDynamicQuality();
+	// Controller description for the settings of the cascades when dynamic quality was enabled.
+	CPUReference::QualityControllerDesc GetQualityControllerDesc(uint32_t& staticStepOut);
+	void ApplyQualityKnobs(const CPUReference::QualityKnobs& knobs);
 	void RenderDepthOnly(Camera& camera, DepthBuffer& targetDepth, D3D12_VIEWPORT viewPort, D3D12_RECT scissor, bool clearDepth = false);
 	void BuildHiZBuffer(DepthBuffer& sourceDepthBuffer);
+	void BuildHiZBufferPerMip(ComputeContext& cmptContext);
+	void BuildHiZBufferSinglePass(ComputeContext& cmptContext);
 	void RunRCCoalesce();
 	void RunComputeRCGatherFilterReduction();
+	// Unpacks a bit packed gather filter into dest.
+	void VisualizeGatherFilter(uint32_t filterIndex, ColorBuffer& dest);
 	void RunDeferredLightingPass(ColorBuffer& albedoBuffer, ColorBuffer& normalBuffer, ColorBuffer& diffuseRadianceBuffer, ColorBuffer& outputBuffer);
 	void UpdateViewportAndScissor();
 
@@ -307,7 +374,10 @@ private:
 	// Will run a compute shader that samples the source and writes to dest.
 	// TODO: Take in a sampler type and change PSO to have a binding for a dynamic sampler state that is bound at runtime.
 	void FullScreenCopyCompute(PixelBuffer& source, D3D12_CPU_DESCRIPTOR_HANDLE sourceSRV, ColorBuffer& dest);
+	// Only copies the source rect (in texels) of the source.
+	void FullScreenCopyCompute(PixelBuffer& source, D3D12_CPU_DESCRIPTOR_HANDLE sourceSRV, const D3D12_RECT& sourceRect, ColorBuffer& dest);
 	void FullScreenCopyCompute(ColorBuffer& source, ColorBuffer& dest);
+	void FullScreenCopyCompute(ColorBuffer& source, const D3D12_RECT& sourceRect, ColorBuffer& dest);
 
 	void EquilateralToCubemapCompute(TextureRef equilateralTexture, ColorBuffer cubemapTexture);
 
@@ -328,14 +398,18 @@ private:
 	
 	TextureRef& GetCurrentSkybox() { return m_skyboxTextures[m_currentSkybox]; }
 
-	// EXTREMELY wasteful but it gets the job done for how much energy I have currently.
-	std::unordered_map<ModelID, std::vector<Utils::GPUMatrix>> GetGroupedModelInstances();
-	std::vector<TLASInstanceGroup> GetTLASInstanceGroups();
+	// Sorted, which is also the order the models have their hit groups in the shader tables.
+	std::set<ModelID> GetSceneModelIDs();
+	// Adds every scene model to the instance registry, the TLAS instance descs are written from it.
+	void RegisterSceneInstances(const std::set<ModelID>& modelIDs);
+	// Sets the instance mask of every scene instance from its bounds against the cascade intervals around the probes of the main camera.
+	void UpdateInstanceMasks();
 
 	void RegisterDisplayDependentTexture(PixelBuffer* pixelBuffer, TextureType textureType);
 
-	// This should only be called after rendering or at least after BuildHiZBuffer() has been called.
-	void GetSceneMinMaxDepth(float& minDepth, float& maxDepth);
+	// Min and max depth of the most recent Hi-Z buffer the GPU is done with, does not wait on the GPU.
+	// False if there is none yet, frameAgeOut is how many frames old the depth is.
+	bool GetSceneMinMaxDepth(float& minDepth, float& maxDepth, uint64_t* frameAgeOut = nullptr);
 
 private:
 	bool m_shouldQuit = false;
@@ -369,20 +443,47 @@ private:
 	RootSignature1 m_rtTestGlobalRootSig;
 	RootSignature1 m_rtTestLocalRootSig;
 	TLASBuffers m_sceneTLAS;
+	CPUReference::InstanceRegistry m_instanceRegistry;
+	// Kept between frames to not allocate them every update.
+	std::vector<CPUReference::InstanceMaskInput> m_instanceMaskInputs;
+	std::vector<uint8_t> m_instanceMasks;
 
 	ComputePSO m_HiZGenerationPSO = ComputePSO(L"Min Max Depth Compute");
 	RootSignature m_hiZRootSig;
 
+	ComputePSO m_hiZSinglePassPSO = ComputePSO(L"Hi-Z Single Pass Compute");
+	RootSignature m_hiZSinglePassRootSig;
+
 	RaytracingPSO m_rcRaytracePSO = RaytracingPSO(L"RC Raytrace PSO");
 	RootSignature1 m_rcRaytraceGlobalRootSig;
 	RootSignature1 m_rcRaytraceLocalRootSig;
+	// Only finalized if indirect DispatchRays is supported, see Utils::SupportsIndirectDispatchRays().
+	CommandSignature m_dispatchRaysCommandSignature = CommandSignature(1);
 
 	ComputePSO m_rc3dMergePSO = ComputePSO(L"RC 3D Merge PSO");
 	RootSignature m_rc3dMergeRootSig;
 
+	// Shares the root signature of the merge.
+	ComputePSO m_rc3dMergeCoalescePSO = ComputePSO(L"RC 3D Merge Coalesce PSO");
+
+	// Merge kernel permutations, one per supported pair of scaling factors. Compiled the first time they are used.
+	std::array<ShaderID, CPUReference::ScalingPermutationCount> m_rc3dMergePermutationShaders = {};
+	std::array<ShaderID, CPUReference::ScalingPermutationCount> m_rc3dMergeCoalescePermutationShaders = {};
+	// Permutation the merge PSOs are currently set to. Starts out with the kernels that read the scaling factors at runtime.
+	uint32_t m_rc3dMergePermutation = CPUReference::InvalidScalingPermutation;
+
+	ComputePSO m_rc3dMergeWeightsPSO = ComputePSO(L"RC 3D Merge Weights PSO");
+	RootSignature m_rc3dMergeWeightsRootSig;
+
+	ComputePSO m_rc3dReprojectPSO = ComputePSO(L"RC 3D Reproject PSO");
+	RootSignature m_rc3dReprojectRootSig;
+
 	ComputePSO m_gatherFilterReductionPSO = ComputePSO(L"Gather Filter Reduction PSO");
 	RootSignature m_gatherFilterReductionRootSig;
 
+	ComputePSO m_gatherFilterVisPSO = ComputePSO(L"Gather Filter Vis PSO");
+	RootSignature m_gatherFilterVisRootSig;
+
 	ComputePSO m_rc3dCoalescePSO = ComputePSO(L"RC 3D Coalesce PSO");
 	RootSignature m_rc3dCoalesceRootSig;
 
@@ -393,13 +494,34 @@ private:
 	RootSignature m_skyboxRootSig;
 
 	RadianceCascadeManager3D m_rcManager3D;
+	// View projection the cascade history was gathered with, see RCReproject3DCS.hlsl.
+	Math::Matrix4 m_rcHistoryViewProjMatrix;
+	// Depth the cascade history was gathered with, reprojection rejects history probes of other surfaces with it.
+	ColorBuffer m_rcHistoryDepthBuffer;
+
+	CPUReference::QualityController m_qualityController;
+	bool m_isDynamicQualityActive = false;
+	// Settings from before dynamic quality was enabled.
+	CPUReference::QualityKnobs m_qualityMaxKnobs;
+	CPUReference::QualityStaticParams m_qualityMaxStaticParams;
+	CPUReference::CascadeUpdateScheduleDesc m_qualityMaxUpdateSchedule;
+	// Settings the controller was built with, it starts over if they change.
+	float m_qualityBudgetMs = 0.0f;
+	bool m_qualityAllowsRegeneration = false;
 
 	ColorBuffer m_albedoBuffer;
 
 	ColorBuffer m_depthBufferCopy;
 	// Hierarchical Z buffer. Each mip stores min and max depth values.
 	ColorBuffer m_hiZBuffer;
-	ReadbackBuffer m_hiZReadbackBuffer;
+	// Min and max depth of the last mip, one slot per frame in flight.
+	ReadbackRingBuffer m_hiZReadbackRing;
+	// Finished group count of the single pass Hi-Z build.
+	ByteAddressBuffer m_hiZGroupCounter;
+	// Bound to the merge weights slot when they are not precomputed, a buffer SRV has to be bound to a buffer slot.
+	StructuredBuffer m_dummyMergeWeights;
+	// Bound to the visibility plane UAV slots when the interval format has none, same format as a visibility plane.
+	ColorBuffer m_dummyVisibilityBuffer;
 
 	DepthBuffer m_debugCamDepthBuffer;
 
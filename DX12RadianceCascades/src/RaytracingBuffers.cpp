@@ -2,6 +2,7 @@
 #include "Model\Model.h"
 #include "Core\GpuBuffer.h"
 #include "Core\UploadBuffer.h"
+#include "Core\ReadbackBuffer.h"
 #include "RaytracingBuffers.h"
 
 using namespace Microsoft::WRL;
@@ -12,10 +13,21 @@ struct alignas(D3D12_RAYTRACING_TRANSFORM3X4_BYTE_ALIGNMENT) AffineRowMaj3x4
 };
 
 constexpr uint32_t MaxInstanceDescriptions = 512u;
+
+// Compacted after the build, see BLASPool.
+constexpr D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS DefaultBLASBuildFlags =
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION |
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+
 constexpr D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS DefaultTLASBuildFlags =
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE | 
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
+// The instance registry encodes descs straight into the instance buffer.
+static_assert(sizeof(CPUReference::RaytracingInstanceDesc) == sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+static_assert(offsetof(CPUReference::RaytracingInstanceDesc, accelerationStructure) == offsetof(D3D12_RAYTRACING_INSTANCE_DESC, AccelerationStructure));
+static_assert(CPUReference::AccelerationStructureAlignment == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+
 
 BLASBuffer::BLASBuffer(std::shared_ptr<Model> modelPtr)
 {
@@ -31,9 +43,8 @@ void BLASBuffer::Init(std::shared_ptr<Model> modelPtr)
 	const uint32_t numMeshes = model.m_NumMeshes;
 	const Mesh* meshPtr = (const Mesh*)model.m_MeshData.get();
 
-	UploadBuffer matrixBuffer = UploadBuffer();
-	matrixBuffer.Create(L"BLAS Matrix Buffer", sizeof(AffineRowMaj3x4) * model.m_NumNodes);
-	AffineRowMaj3x4* matrixBufferPtr = (AffineRowMaj3x4*)matrixBuffer.Map();
+	m_matrixBuffer.Create(L"BLAS Matrix Buffer", sizeof(AffineRowMaj3x4) * model.m_NumNodes);
+	AffineRowMaj3x4* matrixBufferPtr = (AffineRowMaj3x4*)m_matrixBuffer.Map();
 	
 	const GraphNode* sceneGraph = m_modelPtr->m_SceneGraph.get();
 
@@ -77,10 +88,10 @@ void BLASBuffer::Init(std::shared_ptr<Model> modelPtr)
 		}
 	}
 
-	matrixBuffer.Unmap();
+	m_matrixBuffer.Unmap();
 
 	// Fill geometry description information per submesh.
-	std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs(numMeshes);
+	m_geometryDescs.assign(numMeshes, {});
 	const D3D12_GPU_VIRTUAL_ADDRESS modelDataBuffer = model.m_DataBuffer.GetGpuVirtualAddress();
 	for (uint32_t i = 0; i < numMeshes; i++)
 	{
@@ -89,7 +100,7 @@ void BLASBuffer::Init(std::shared_ptr<Model> modelPtr)
 		// Only support meshes that require 1 draw per submesh. This has to do with index count data.
 		ASSERT(mesh.numDraws == 1);
 
-		D3D12_RAYTRACING_GEOMETRY_DESC& geomDesc = geometryDescs[i];
+		D3D12_RAYTRACING_GEOMETRY_DESC& geomDesc = m_geometryDescs[i];
 
 		geomDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
 		geomDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
@@ -105,41 +116,202 @@ void BLASBuffer::Init(std::shared_ptr<Model> modelPtr)
 		triangleDesc.IndexBuffer = modelDataBuffer + mesh.ibOffset;
 		triangleDesc.IndexCount = mesh.draw[0].primCount;
 
-		triangleDesc.Transform3x4 = matrixBuffer.GetGpuVirtualAddress() + sizeof(AffineRowMaj3x4) * mesh.meshCBV;
+		triangleDesc.Transform3x4 = m_matrixBuffer.GetGpuVirtualAddress() + sizeof(AffineRowMaj3x4) * mesh.meshCBV;
 	}
 
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blasDesc = {};
-	auto& blasInputs = blasDesc.Inputs;
+	m_bvhAddress = 0;
+}
+
+D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS BLASBuffer::GetBuildInputs() const
+{
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS blasInputs = {};
 	blasInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
 	blasInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-	blasInputs.NumDescs = (UINT)geometryDescs.size();
-	blasInputs.pGeometryDescs = geometryDescs.data();
-	blasInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	blasInputs.NumDescs = (UINT)m_geometryDescs.size();
+	blasInputs.pGeometryDescs = m_geometryDescs.data();
+	blasInputs.Flags = DefaultBLASBuildFlags;
 
-	m_asData.CreateBuffers(blasDesc);
-	blasDesc.DestAccelerationStructureData = m_asData.bvhBuffer.GetGpuVirtualAddress();
-	blasDesc.ScratchAccelerationStructureData = m_asData.scratchBuffer.GetGpuVirtualAddress();
+	return blasInputs;
+}
 
-	GraphicsContext& gfxContext = GraphicsContext::Begin(L"BLAS Build");
-	ComPtr<ID3D12GraphicsCommandList4> rtCommandList;
-	ThrowIfFailedHR(gfxContext.GetCommandList()->QueryInterface(rtCommandList.GetAddressOf()));
+void BLASPool::Add(BLASBuffer& blasBuffer, const std::wstring& name)
+{
+	ASSERT(!blasBuffer.m_geometryDescs.empty(), "BLAS has to be initialized before it is added.");
+	m_pendingBLASes.push_back({ &blasBuffer, name });
+}
 
-	rtCommandList->BuildRaytracingAccelerationStructure(&blasDesc, 0, nullptr);
+void BLASPool::BuildPending()
+{
+	if (m_pendingBLASes.empty())
+	{
+		return;
+	}
 
-	gfxContext.Finish(true);
+	const uint32_t blasCount = (uint32_t)m_pendingBLASes.size();
+
+	std::vector<CPUReference::BLASPrebuildSizes> prebuildSizes(blasCount);
+	for (uint32_t i = 0; i < blasCount; i++)
+	{
+		const D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS blasInputs = m_pendingBLASes[i].blasBuffer->GetBuildInputs();
+
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO prebuildInfo = {};
+		Graphics::g_Device5->GetRaytracingAccelerationStructurePrebuildInfo(&blasInputs, &prebuildInfo);
+
+		prebuildSizes[i] = { prebuildInfo.ResultDataMaxSizeInBytes, prebuildInfo.ScratchDataSizeInBytes };
+	}
+
+	const CPUReference::BLASBuildPlan buildPlan = CPUReference::PlanBLASBuilds(prebuildSizes, m_buildDesc);
+
+	ByteAddressBuffer scratchBuffer;
+	scratchBuffer.Create(L"BLAS Pool Scratch Buffer", 1, (uint32_t)buildPlan.scratchBytes);
+	AccelerationStructureBuffer resultBuffer;
+	resultBuffer.Create(L"BLAS Pool Uncompacted Buffer", 1, (uint32_t)buildPlan.resultBytes);
+	constexpr uint32_t compactedSizeStride = (uint32_t)sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+	ByteAddressBuffer compactedSizeBuffer;
+	compactedSizeBuffer.Create(L"BLAS Pool Compacted Size Buffer", blasCount, compactedSizeStride);
+	ReadbackBuffer compactedSizeReadback;
+	compactedSizeReadback.Create(L"BLAS Pool Compacted Size Readback", blasCount, compactedSizeStride);
+
+	// Build every BLAS and read back their compacted sizes.
+	{
+		GraphicsContext& gfxContext = GraphicsContext::Begin(L"BLAS Batched Build");
+		ComPtr<ID3D12GraphicsCommandList4> rtCommandList;
+		ThrowIfFailedHR(gfxContext.GetCommandList()->QueryInterface(rtCommandList.GetAddressOf()));
+
+		gfxContext.TransitionResource(scratchBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		gfxContext.TransitionResource(compactedSizeBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+
+		for (uint32_t batchIndex = 0; batchIndex < buildPlan.batchCount; batchIndex++)
+		{
+			// Batches reuse the same scratch.
+			if (batchIndex > 0u)
+			{
+				gfxContext.InsertUAVBarrier(scratchBuffer, true);
+			}
+
+			for (uint32_t i = 0; i < blasCount; i++)
+			{
+				const CPUReference::BLASBuildEntry& buildEntry = buildPlan.entries[i];
+				if (buildEntry.batchIndex != batchIndex)
+				{
+					continue;
+				}
+
+				D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC blasDesc = {};
+				blasDesc.Inputs = m_pendingBLASes[i].blasBuffer->GetBuildInputs();
+				blasDesc.DestAccelerationStructureData = resultBuffer.GetGpuVirtualAddress() + buildEntry.resultOffset;
+				blasDesc.ScratchAccelerationStructureData = scratchBuffer.GetGpuVirtualAddress() + buildEntry.scratchOffset;
+
+				D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildInfoDesc = {};
+				postbuildInfoDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+				postbuildInfoDesc.DestBuffer = compactedSizeBuffer.GetGpuVirtualAddress() + i * compactedSizeStride;
+
+				rtCommandList->BuildRaytracingAccelerationStructure(&blasDesc, 1, &postbuildInfoDesc);
+			}
+		}
+
+		gfxContext.InsertUAVBarrier(resultBuffer);
+		gfxContext.CopyBuffer(compactedSizeReadback, compactedSizeBuffer);
+		gfxContext.Finish(true);
+	}
+
+	std::vector<uint64_t> compactedBytes(blasCount);
+	{
+		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC* compactedSizes =
+			(const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC*)compactedSizeReadback.Map();
+
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			compactedBytes[i] = compactedSizes[i].CompactedSizeInBytes;
+		}
+
+		compactedSizeReadback.Unmap();
+	}
+
+	const CPUReference::BLASPoolPlan poolPlan = CPUReference::PackBLASPool(compactedBytes, m_poolDesc);
+
+	const size_t firstPageIndex = m_pages.size();
+	m_pages.resize(firstPageIndex + poolPlan.pageBytes.size());
+	for (size_t pageIndex = 0; pageIndex < poolPlan.pageBytes.size(); pageIndex++)
+	{
+		m_pages[firstPageIndex + pageIndex].Create(L"BLAS Pool Page", 1, (uint32_t)poolPlan.pageBytes[pageIndex]);
+		m_pooledBytes += poolPlan.pageBytes[pageIndex];
+	}
+
+	// Copy every BLAS compacted into its page.
+	{
+		GraphicsContext& gfxContext = GraphicsContext::Begin(L"BLAS Compaction");
+		ComPtr<ID3D12GraphicsCommandList4> rtCommandList;
+		ThrowIfFailedHR(gfxContext.GetCommandList()->QueryInterface(rtCommandList.GetAddressOf()));
+
+		for (uint32_t i = 0; i < blasCount; i++)
+		{
+			const CPUReference::BLASPoolEntry& poolEntry = poolPlan.entries[i];
+			const D3D12_GPU_VIRTUAL_ADDRESS compactedAddress = m_pages[firstPageIndex + poolEntry.pageIndex].GetGpuVirtualAddress() + poolEntry.offset;
+
+			rtCommandList->CopyRaytracingAccelerationStructure(
+				compactedAddress,
+				resultBuffer.GetGpuVirtualAddress() + buildPlan.entries[i].resultOffset,
+				D3D12_RAYTRACING_ACCELERATION_STRUCTURE_COPY_MODE_COMPACT
+			);
+
+			m_pendingBLASes[i].blasBuffer->m_bvhAddress = compactedAddress;
+		}
+
+		gfxContext.Finish(true);
+	}
+
+	// Scratch and the uncompacted results are released when they go out of scope, the matrices are not read anymore either.
+	for (uint32_t i = 0; i < blasCount; i++)
+	{
+		PendingBLAS& pendingBLAS = m_pendingBLASes[i];
+		pendingBLAS.blasBuffer->m_matrixBuffer.Destroy();
+
+		CPUReference::BLASMemoryReport memoryReport;
+		memoryReport.uncompactedBytes = CPUReference::AlignAccelerationStructureBytes(prebuildSizes[i].resultBytes);
+		memoryReport.scratchBytes = CPUReference::AlignAccelerationStructureBytes(prebuildSizes[i].scratchBytes);
+		memoryReport.compactedBytes = CPUReference::AlignAccelerationStructureBytes(compactedBytes[i]);
+
+		LOG_INFO(L"BLAS {}: {} KiB uncompacted + {} KiB scratch -> {} KiB compacted, {} KiB saved.",
+			pendingBLAS.name,
+			memoryReport.uncompactedBytes / 1024u,
+			memoryReport.scratchBytes / 1024u,
+			memoryReport.compactedBytes / 1024u,
+			memoryReport.GetSavedBytes() / 1024u
+		);
+	}
+
+	LOG_INFO(L"Built {} BLASes in {} batches over {} KiB of scratch, pool is {} KiB in {} pages.",
+		blasCount,
+		buildPlan.batchCount,
+		buildPlan.scratchBytes / 1024u,
+		m_pooledBytes / 1024u,
+		m_pages.size()
+	);
+
+	m_pendingBLASes.clear();
 }
 
-D3D12_GPU_VIRTUAL_ADDRESS BLASBuffer::GetBVH() const
+void BLASPool::Destroy()
 {
-	return m_asData.bvhBuffer.GetGpuVirtualAddress();
+	m_pendingBLASes.clear();
+	m_pages.clear();
+	m_pooledBytes = 0u;
 }
 
 void TLASBuffers::Init()
 {
 	m_instanceDataBuffer.Create(L"Instance Data Buffer", MaxInstanceDescriptions * sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
-	
+
+	// Zeroed descs are inactive, slots the registry never used stay that way.
+	m_instanceDescs = reinterpret_cast<CPUReference::RaytracingInstanceDesc*>(m_instanceDataBuffer.Map());
+	ASSERT(m_instanceDescs != nullptr);
+	ZeroMemory(m_instanceDescs, MaxInstanceDescriptions * sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
+
+	// Sized for every desc, later builds use as many as the registry has slots.
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasDesc = BuildDesc(
 		DefaultTLASBuildFlags,
+		MaxInstanceDescriptions,
 		false
 	);
 
@@ -153,6 +325,8 @@ void TLASBuffers::Init()
 	rtCommandList->BuildRaytracingAccelerationStructure(&tlasDesc, 0, nullptr);
 
 	gfxContext.Finish(true);
+
+	m_builtInstanceCount = MaxInstanceDescriptions;
 }
 
 D3D12_GPU_VIRTUAL_ADDRESS TLASBuffers::GetBVH() const
@@ -160,78 +334,63 @@ D3D12_GPU_VIRTUAL_ADDRESS TLASBuffers::GetBVH() const
 	return m_asData.bvhBuffer.GetGpuVirtualAddress();
 }
 
-void TLASBuffers::UpdateTLASInstances(GraphicsContext& gfxContext, const std::vector<TLASInstanceGroup>& tlasInstanceGroups)
+void TLASBuffers::UpdateTLASInstances(GraphicsContext& gfxContext, CPUReference::InstanceRegistry& instanceRegistry)
 {
-	auto instanceDescs = reinterpret_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(m_instanceDataBuffer.Map());
-	ASSERT(instanceDescs != nullptr);
-
-	// Each instance of a BLAS is offset in the shader table the same amount, i.e, starting at the same index. 
-	// This is because it is assumed that there is a shader entry per geometry description.
-	uint32_t instanceContributionOffset = 0u;
-	uint32_t instanceCount = 0u;
-	for (const TLASInstanceGroup& instanceGroup : tlasInstanceGroups)
-	{
-		if (instanceGroup.blasBuffer == nullptr)
-		{
-			LOG_ERROR(L"BLAS buffer is null.");
-			continue;
-		}
-
-		const D3D12_GPU_VIRTUAL_ADDRESS blasBVH = instanceGroup.blasBuffer->GetBVH();
-		for (const Utils::GPUMatrix& instanceMatrix : instanceGroup.instanceTransforms)
-		{
-			D3D12_RAYTRACING_INSTANCE_DESC& instanceDesc = instanceDescs[instanceCount++];
-			
-			instanceDesc.AccelerationStructure = blasBVH;
-			instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-			instanceDesc.InstanceID = 0;
-			instanceDesc.InstanceMask = 1;
-			instanceDesc.InstanceContributionToHitGroupIndex = instanceContributionOffset;
-
-			const DirectX::XMFLOAT4X4& transformMat = instanceMatrix.gpuMat;
-
-			// Initialize data.
-			ZeroMemory(instanceDesc.Transform, sizeof(instanceDesc.Transform));
-
-			// Copy 3 first rows to desc.
-			memcpy(instanceDesc.Transform[0], transformMat.m[0], sizeof(float) * 4);
-			memcpy(instanceDesc.Transform[1], transformMat.m[1], sizeof(float) * 4);
-			memcpy(instanceDesc.Transform[2], transformMat.m[2], sizeof(float) * 4);
-		}
+	ASSERT(m_instanceDescs != nullptr);
 
-		instanceContributionOffset += instanceGroup.blasBuffer->GetNumGeometries();
+	if (!instanceRegistry.HasChanges())
+	{
+		return;
 	}
 
-	m_instanceDataBuffer.Unmap();
+	const uint32_t instanceCount = instanceRegistry.GetSlotCount();
+	ASSERT(instanceCount <= MaxInstanceDescriptions, "Instance registry has more slots than there are instance descriptions.");
+
+	// Slot counts only change together with an activation change.
+	const bool canUpdate = !instanceRegistry.HasActivationChanges() && instanceCount == m_builtInstanceCount;
+	instanceRegistry.WriteDirtyDescs(m_instanceDescs);
 
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasBuildDesc = BuildDesc(DefaultTLASBuildFlags, true);
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasBuildDesc = BuildDesc(DefaultTLASBuildFlags, instanceCount, canUpdate);
 
 	ComPtr<ID3D12GraphicsCommandList4> rtCommandList;
 	ThrowIfFailedHR(gfxContext.GetCommandList()->QueryInterface(rtCommandList.GetAddressOf()));
 	rtCommandList->BuildRaytracingAccelerationStructure(&tlasBuildDesc, 0, nullptr);
 
 	gfxContext.InsertUAVBarrier(m_asData.bvhBuffer, true);
+
+	m_builtInstanceCount = instanceCount;
+}
+
+CPUReference::InstanceTransform TLASBuffers::ToInstanceTransform(const Utils::GPUMatrix& transform)
+{
+	// The GPU matrix is already transposed to row major, its first 3 rows are the instance transform.
+	CPUReference::InstanceTransform instanceTransform = {};
+	memcpy(instanceTransform.rows, transform.gpuMat.m, sizeof(instanceTransform.rows));
+	return instanceTransform;
 }
 
-D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC TLASBuffers::BuildDesc(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, bool update)
+D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC TLASBuffers::BuildDesc(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, uint32_t numDescs, bool update)
 {
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC tlasDesc = {};
 	{
 		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& tlasInputs = tlasDesc.Inputs;
 		tlasInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 		tlasInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		tlasInputs.NumDescs = MaxInstanceDescriptions;
+		tlasInputs.NumDescs = numDescs;
 		tlasInputs.pGeometryDescs = nullptr;
-		tlasInputs.Flags = flags;
+		tlasInputs.Flags = update ? flags | D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE : flags;
 		tlasInputs.InstanceDescs = m_instanceDataBuffer.GetGpuVirtualAddress();
 		tlasInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	}
 
 	if (update)
 	{
-		tlasDesc.DestAccelerationStructureData = m_asData.bvhBuffer.GetGpuVirtualAddress();
-		tlasDesc.ScratchAccelerationStructureData = m_asData.scratchBuffer.GetGpuVirtualAddress();
+		// Refit in place.
+		tlasDesc.SourceAccelerationStructureData = m_asData.bvhBuffer.GetGpuVirtualAddress();
 	}
 
+	tlasDesc.DestAccelerationStructureData = m_asData.bvhBuffer.GetGpuVirtualAddress();
+	tlasDesc.ScratchAccelerationStructureData = m_asData.scratchBuffer.GetGpuVirtualAddress();
+
 	return tlasDesc;
 }
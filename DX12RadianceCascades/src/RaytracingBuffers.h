@@ -1,5 +1,8 @@
 #pragma once
 
+#include "CPUReference\BLASBuildPlan.h"
+#include "CPUReference\InstanceRegistry.h"
+
 class AccelerationStructureBuffer : public ByteAddressBuffer
 {
 public:
@@ -31,22 +34,62 @@ public:
 	BLASBuffer() = default;
 	BLASBuffer(std::shared_ptr<Model> modelPtr);
 
+	// Only fills in the geometry descs, the BLAS is built when BuildPending() is called on the BLASPool it was added to.
 	void Init(std::shared_ptr<Model> modelPtr);
 
-	D3D12_GPU_VIRTUAL_ADDRESS GetBVH() const;
+	// 0 until built.
+	D3D12_GPU_VIRTUAL_ADDRESS GetBVH() const { return m_bvhAddress; }
 	uint32_t GetNumGeometries() const { return m_modelPtr->m_NumMeshes; }
 	std::shared_ptr<const Model> GetModelPtr() const { return m_modelPtr; }
 
 private:
-	AccelerationStructureData m_asData;
-	StructuredBuffer m_geometryInstanceData;
+	friend class BLASPool;
+
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS GetBuildInputs() const;
+
+private:
+	std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> m_geometryDescs;
+	// Transforms of every mesh, read by the build and released after it.
+	UploadBuffer m_matrixBuffer;
+	// Compacted BLAS inside a page of the pool that built it.
+	D3D12_GPU_VIRTUAL_ADDRESS m_bvhAddress = 0;
 	std::shared_ptr<const Model> m_modelPtr; // This can probably be removed.
 };
 
-struct TLASInstanceGroup
+// Builds BLASes in batches and keeps them compacted in pages, see CPUReference/BLASBuildPlan.h. Instead of building every BLAS in 
+// its own command list, waiting on it and keeping its uncompacted result and scratch forever, every pending BLAS is built in one 
+// command list over a pooled scratch, copied compacted into the pool and everything but the pool is released.
+class BLASPool
 {
-	const BLASBuffer* blasBuffer;
-	std::vector<Utils::GPUMatrix> instanceTransforms;
+public:
+	BLASPool() = default;
+
+	// The BLAS has to stay where it is until BuildPending() is called.
+	void Add(BLASBuffer& blasBuffer, const std::wstring& name);
+	// Waits on the GPU twice no matter how many BLASes are pending, once for the compacted sizes and once for the compaction.
+	void BuildPending();
+
+	void Destroy();
+
+	void SetBuildDesc(const CPUReference::BLASBuildPlanDesc& buildDesc) { m_buildDesc = buildDesc; }
+	void SetPoolDesc(const CPUReference::BLASPoolDesc& poolDesc) { m_poolDesc = poolDesc; }
+
+	uint64_t GetPooledBytes() const { return m_pooledBytes; }
+
+private:
+	struct PendingBLAS
+	{
+		BLASBuffer* blasBuffer = nullptr;
+		std::wstring name;
+	};
+
+	std::vector<PendingBLAS> m_pendingBLASes;
+	// BLASes of a model that is loaded again stay in their page until the pool is destroyed.
+	std::vector<AccelerationStructureBuffer> m_pages;
+	uint64_t m_pooledBytes = 0u;
+
+	CPUReference::BLASBuildPlanDesc m_buildDesc;
+	CPUReference::BLASPoolDesc m_poolDesc;
 };
 
 class TLASBuffers
@@ -59,13 +102,21 @@ public:
 
 	D3D12_GPU_VIRTUAL_ADDRESS GetBVH() const;
 
-	void UpdateTLASInstances(GraphicsContext& gfxContext, const std::vector<TLASInstanceGroup>& tlasInstanceGroups);
+	// Only writes the descs of the instances that changed since the last call, see CPUReference/InstanceRegistry.h.
+	// Refits the TLAS if only instances changed, rebuilds it if any were added or removed and does nothing if nothing changed.
+	void UpdateTLASInstances(GraphicsContext& gfxContext, CPUReference::InstanceRegistry& instanceRegistry);
+
+	static CPUReference::InstanceTransform ToInstanceTransform(const Utils::GPUMatrix& transform);
 
 private:
 
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC BuildDesc(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, bool update);
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC BuildDesc(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, uint32_t numDescs, bool update);
 
 private:
 	AccelerationStructureData m_asData;
 	UploadBuffer m_instanceDataBuffer;
+	// Persistently mapped, descs that did not change keep what was written in an earlier frame.
+	CPUReference::RaytracingInstanceDesc* m_instanceDescs = nullptr;
+	// Descs the TLAS was last built over, an update has to use the same count.
+	uint32_t m_builtInstanceCount = 0u;
 };
\ No newline at end of file
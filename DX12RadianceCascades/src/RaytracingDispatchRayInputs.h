@@ -1,66 +1,54 @@
 #pragma once
 
 #include "RaytracingPSO.h"
-#include "ShaderTable.h"
+#include "ShaderTableArena.h"
 
 // This struct is adapted from the RaytracingDispatchRayInputs struct in ModelViewer.cpp.
+// The shader tables live in a ShaderTableArena and are only turned into addresses when the dispatch is built, as the arena can move them.
 struct RaytracingDispatchRayInputs
 {
-	RaytracingDispatchRayInputs() : m_hitGroupStride(0) {}
+	RaytracingDispatchRayInputs() = default;
 
-	template<typename T>
-	RaytracingDispatchRayInputs(RaytracingPSO& rtPSO, ShaderTable<T>& hitShaderTable, const std::wstring& rayGenExport, const std::wstring& missShaderExport)
+	// Takes over the tables, which are released from the arena by Release().
+	void Init(RaytracingPSO& rtPSO, const ShaderTableArena& shaderTableArena, uint32_t rayGenTable, uint32_t missTable, uint32_t hitGroupTable)
 	{
-		Init(rtPSO, hitShaderTable, rayGenExport, missShaderExport);
+		m_stateObject = rtPSO.GetStateObject();
+		m_shaderTableArena = &shaderTableArena;
+		m_rayGenTable = rayGenTable;
+		m_missTable = missTable;
+		m_hitGroupTable = hitGroupTable;
 	}
 
-	template<typename T>
-	void Init(RaytracingPSO& rtPSO, ShaderTable<T>& hitShaderTable, const std::wstring& rayGenExport, const std::wstring& missShaderExport)
+	void Release(ShaderTableArena& shaderTableArena)
 	{
-		m_stateObject = rtPSO.GetStateObject();
-		m_hitGroupStride = GetShaderTableEntrySize(hitShaderTable);
-
-		m_hitGroupShaderTable.Create(
-			L"Hit Shader Table",
-			1,
-			GetShaderTableSize(hitShaderTable),
-			hitShaderTable.data()
-		);
-
-		ShaderTableEntrySimple rayGenShaderIdentifier = ShaderTableEntrySimple(rtPSO.GetShaderIdentifier(rayGenExport));
-		ShaderTableSimple rayGenShaderTable = { {rayGenShaderIdentifier} };
-		m_rayGenShaderTable.Create(
-			L"Ray Gen Shader Table",
-			1,
-			GetShaderTableSimpleSize(rayGenShaderTable),
-			rayGenShaderTable.data()
-		);
-
-		ShaderTableEntrySimple missShaderIdentifier = ShaderTableEntrySimple(rtPSO.GetShaderIdentifier(missShaderExport));
-		ShaderTableSimple missShaderTable = { {missShaderIdentifier} };
-		m_missShaderTable.Create(
-			L"Miss Shader Table",
-			1,
-			GetShaderTableSimpleSize(missShaderTable),
-			missShaderTable.data()
-		);
-
+		for (uint32_t* table : { &m_rayGenTable, &m_missTable, &m_hitGroupTable })
+		{
+			if (*table != CPUReference::ShaderRecordArena::InvalidTable)
+			{
+				shaderTableArena.GetRecords().ReleaseTable(*table);
+				*table = CPUReference::ShaderRecordArena::InvalidTable;
+			}
+		}
+
+		m_shaderTableArena = nullptr;
 	}
 
 	D3D12_DISPATCH_RAYS_DESC BuildDispatchRaysDesc(UINT width, UINT height) const
 	{
+		ASSERT(m_shaderTableArena != nullptr);
+
 		D3D12_DISPATCH_RAYS_DESC desc = {};
 
-		desc.HitGroupTable.StartAddress = m_hitGroupShaderTable.GetGpuVirtualAddress();
-		desc.HitGroupTable.SizeInBytes = m_hitGroupShaderTable.GetBufferSize();
-		desc.HitGroupTable.StrideInBytes = m_hitGroupStride;
+		desc.HitGroupTable.StartAddress = m_shaderTableArena->GetTableAddress(m_hitGroupTable);
+		desc.HitGroupTable.SizeInBytes = m_shaderTableArena->GetTableByteCount(m_hitGroupTable);
+		desc.HitGroupTable.StrideInBytes = m_shaderTableArena->GetRecordStride();
 
-		desc.MissShaderTable.StartAddress = m_missShaderTable.GetGpuVirtualAddress();
-		desc.MissShaderTable.SizeInBytes = m_missShaderTable.GetBufferSize();
-		desc.MissShaderTable.StrideInBytes = desc.MissShaderTable.SizeInBytes; // Assumes only a single entry for miss ST.
+		desc.MissShaderTable.StartAddress = m_shaderTableArena->GetTableAddress(m_missTable);
+		desc.MissShaderTable.SizeInBytes = m_shaderTableArena->GetTableByteCount(m_missTable);
+		desc.MissShaderTable.StrideInBytes = m_shaderTableArena->GetRecordStride();
 
-		desc.RayGenerationShaderRecord.StartAddress = m_rayGenShaderTable.GetGpuVirtualAddress();
-		desc.RayGenerationShaderRecord.SizeInBytes = m_rayGenShaderTable.GetBufferSize();
+		desc.RayGenerationShaderRecord.StartAddress = m_shaderTableArena->GetTableAddress(m_rayGenTable);
+		desc.RayGenerationShaderRecord.SizeInBytes = m_shaderTableArena->GetTableByteCount(m_rayGenTable);
 
 		desc.Width = width;
 		desc.Height = height;
@@ -70,9 +58,8 @@ struct RaytracingDispatchRayInputs
 	}
 
 	Microsoft::WRL::ComPtr<ID3D12StateObject> m_stateObject;
-	uint32_t m_hitGroupStride;
-	ByteAddressBuffer m_rayGenShaderTable;
-	ByteAddressBuffer m_missShaderTable;
-	ByteAddressBuffer m_hitGroupShaderTable;
+	const ShaderTableArena* m_shaderTableArena = nullptr;
+	uint32_t m_rayGenTable = CPUReference::ShaderRecordArena::InvalidTable;
+	uint32_t m_missTable = CPUReference::ShaderRecordArena::InvalidTable;
+	uint32_t m_hitGroupTable = CPUReference::ShaderRecordArena::InvalidTable;
 };
-
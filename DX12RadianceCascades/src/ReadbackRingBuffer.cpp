@@ -0,0 +1,80 @@
+#include "rcpch.h"
+#include "Core\GraphicsCore.h"
+#include "Core\CommandListManager.h"
+#include "ReadbackRingBuffer.h"
+
+bool CommandQueueReadbackFence::IsFenceComplete(uint64_t fenceValue) const
+{
+	return Graphics::g_CommandManager.IsFenceComplete(fenceValue);
+}
+
+void ReadbackRingBuffer::Create(const std::wstring& name, uint32_t slotSize, uint32_t slotCount /*= DefaultSlotCount*/)
+{
+	Destroy();
+
+	m_slotSize = slotSize;
+	m_slotStride = Math::AlignUp(slotSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	m_buffer.Create(name, slotCount, m_slotStride);
+	m_mappedPtr = reinterpret_cast<uint8_t*>(m_buffer.Map());
+
+	m_ring.Reset(slotCount);
+	m_writeSlot = CPUReference::ReadbackRing::InvalidSlot;
+}
+
+void ReadbackRingBuffer::Destroy()
+{
+	if (m_mappedPtr != nullptr)
+	{
+		m_buffer.Unmap();
+		m_mappedPtr = nullptr;
+	}
+
+	m_buffer.Destroy();
+}
+
+bool ReadbackRingBuffer::BeginWrite(uint64_t frameIndex, uint64_t& destOffsetOut)
+{
+	ASSERT(m_mappedPtr != nullptr && m_writeSlot == CPUReference::ReadbackRing::InvalidSlot);
+
+	m_writeSlot = m_ring.BeginWrite(m_fence, frameIndex);
+	if (m_writeSlot == CPUReference::ReadbackRing::InvalidSlot)
+	{
+		return false;
+	}
+
+	destOffsetOut = uint64_t(m_writeSlot) * m_slotStride;
+	return true;
+}
+
+void ReadbackRingBuffer::EndWrite(uint64_t fenceValue)
+{
+	if (m_writeSlot == CPUReference::ReadbackRing::InvalidSlot)
+	{
+		return;
+	}
+
+	m_ring.EndWrite(m_writeSlot, fenceValue);
+	m_writeSlot = CPUReference::ReadbackRing::InvalidSlot;
+}
+
+const void* ReadbackRingBuffer::GetLatest(uint64_t currentFrameIndex, uint64_t* frameAgeOut /*= nullptr*/)
+{
+	if (m_mappedPtr == nullptr)
+	{
+		return nullptr;
+	}
+
+	CPUReference::ReadbackRingResult result;
+	if (!m_ring.GetLatestResult(m_fence, currentFrameIndex, result))
+	{
+		return nullptr;
+	}
+
+	if (frameAgeOut != nullptr)
+	{
+		*frameAgeOut = result.frameAge;
+	}
+
+	return m_mappedPtr + uint64_t(result.slotIndex) * m_slotStride;
+}
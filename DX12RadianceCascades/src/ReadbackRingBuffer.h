@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Core\ReadbackBuffer.h"
+
+#include "CPUReference\ReadbackRing.h"
+
+// Fence values as returned by CommandContext::Finish(), which also encode the queue they were signaled on.
+class CommandQueueReadbackFence : public CPUReference::ReadbackFence
+{
+public:
+	bool IsFenceComplete(uint64_t fenceValue) const override;
+};
+
+// Persistently mapped readback buffer with one slot per frame in flight, see CPUReference/ReadbackRing.h.
+// Copies go into the slot returned by BeginWrite() and the CPU reads the most recent slot the GPU is done with, without waiting on it.
+class ReadbackRingBuffer
+{
+public:
+	// Enough for the frames the swap chain keeps in flight.
+	static constexpr uint32_t DefaultSlotCount = 4u;
+
+	ReadbackRingBuffer() = default;
+
+	// Slots are aligned so that they can be the destination of texture copies. Both have to wait until the GPU is done with the old buffer.
+	void Create(const std::wstring& name, uint32_t slotSize, uint32_t slotCount = DefaultSlotCount);
+	void Destroy();
+
+	// Byte offset of the slot to copy the results of frameIndex into, false if the frame is dropped because every slot is busy.
+	bool BeginWrite(uint64_t frameIndex, uint64_t& destOffsetOut);
+	// Fence value of the context the copy was recorded in. Does nothing if the frame was dropped.
+	void EndWrite(uint64_t fenceValue);
+
+	// Data of the most recent completed copy, nullptr if there is none yet. frameAgeOut is how many frames before currentFrameIndex it was written.
+	const void* GetLatest(uint64_t currentFrameIndex, uint64_t* frameAgeOut = nullptr);
+
+	ReadbackBuffer& GetBuffer() { return m_buffer; }
+	uint32_t GetSlotSize() const { return m_slotSize; }
+	uint64_t GetDroppedFrameCount() const { return m_ring.GetDroppedFrameCount(); }
+
+private:
+	CommandQueueReadbackFence m_fence;
+	CPUReference::ReadbackRing m_ring;
+
+	ReadbackBuffer m_buffer;
+	uint8_t* m_mappedPtr = nullptr;
+	uint32_t m_slotSize = 0u;
+	uint32_t m_slotStride = 0u;
+
+	uint32_t m_writeSlot = CPUReference::ReadbackRing::InvalidSlot;
+};
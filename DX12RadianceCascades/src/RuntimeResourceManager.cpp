@@ -32,9 +32,10 @@ void RuntimeResourceManager::SetShadersForPSO(PSOID psoID, std::vector<ShaderID>
 	}
 }
 
-void RuntimeResourceManager::AddModel(ModelID modelID, const std::wstring& modelPath, bool createBLAS)
+void RuntimeResourceManager::AddModel(ModelID modelID, const std::wstring& modelPath, bool createBLAS, bool isEmissive)
 {
-	Get().AddModelImpl(modelID, modelPath, createBLAS);
+	Get().AddModelImpl(modelID, modelPath, createBLAS, isEmissive);
+	Get().m_blasPool.BuildPending();
 }
 
 InternalModel& RuntimeResourceManager::GetInternalModel(ModelID modelID)
@@ -57,19 +58,6 @@ D3D12_SHADER_BYTECODE RuntimeResourceManager::GetShader(ShaderID shaderID)
 	return ShaderCompilationManager::Get().GetShaderByteCode(shaderID);
 }
 
-void RuntimeResourceManager::BuildCombinedShaderTable(PSOID psoID, std::set<ModelID> models, ShaderTable<LocalHitData>& outShaderTable)
-{
-	outShaderTable.clear();
-
-	for (ModelID modelID : models)
-	{
-		HitShaderTablePackage& hitShaderTablePackage = GetOrCreateHitShaderTablePackage(psoID, modelID);
-
-		const ShaderTable<LocalHitData>& modelHitTable = hitShaderTablePackage.hitShaderTable;
-		outShaderTable.insert(outShaderTable.end(), modelHitTable.begin(), modelHitTable.end());
-	}
-}
-
 RaytracingDispatchRayInputs& RuntimeResourceManager::GetRaytracingDispatch(RayDispatchID rayDispatchID)
 {
 	return Get().GetRaytracingDispatchImpl(rayDispatchID);
@@ -84,6 +72,10 @@ RuntimeResourceManager::RuntimeResourceManager() : m_psoMap({})
 {
 	m_descHeap.Create(L"Runtime Resource Manager Desc Heap", D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2048);
 
+	// Records keep the layout of ShaderTableEntry<LocalHitData>, which the local root signatures were written against.
+	m_shaderTableArena.Create(L"Shader Table Arena", sizeof(LocalHitData));
+	ASSERT(m_shaderTableArena.GetRecordStride() == sizeof(ShaderTableEntry<LocalHitData>));
+
 	// Load and compile shaders.
 	{
 		auto& shaderCM = ShaderCompilationManager::Get();
@@ -95,10 +87,13 @@ RuntimeResourceManager::RuntimeResourceManager() : m_psoMap({})
 
 	// Initialize Models
 	{
-		AddModelImpl(ModelIDSponza, L"models\\Sponza\\PBR\\sponza2.gltf", true);
-		AddModelImpl(ModelIDSphereTest, L"models\\Testing\\SphereTest.gltf", true);
-		AddModelImpl(ModelIDLantern, L"models\\Lantern\\Lantern.gltf", true);
-		AddModelImpl(ModelIDBeautifulGame, L"models\\ABeautifulGame\\ABeautifulGame.gltf", true);
+		AddModelImpl(ModelIDSponza, L"models\\Sponza\\PBR\\sponza2.gltf", true, false);
+		AddModelImpl(ModelIDSphereTest, L"models\\Testing\\SphereTest.gltf", true, true);
+		AddModelImpl(ModelIDLantern, L"models\\Lantern\\Lantern.gltf", true, true);
+		AddModelImpl(ModelIDBeautifulGame, L"models\\ABeautifulGame\\ABeautifulGame.gltf", true, false);
+
+		// Every BLAS in one batched build.
+		m_blasPool.BuildPending();
 	}
 }
 
@@ -131,60 +126,66 @@ HitShaderTablePackage& RuntimeResourceManager::GetOrCreateHitShaderTablePackage(
 {
 	HitShaderTablePackage& package = m_shaderTablePSOMap[psoID][modelID];
 
-	if (package.hitShaderTable.empty())
+	if (package.localHitData.empty())
 	{
-		BuildHitShaderTablePackage(psoID, modelID, package);
+		BuildHitShaderTablePackage(modelID, package);
 	}
 
 	return package;
 }
 
-void RuntimeResourceManager::BuildHitShaderTablePackage(PSOID psoID, ModelID modelID, HitShaderTablePackage& outPackage)
+void RuntimeResourceManager::BuildHitShaderTablePackage(ModelID modelID, HitShaderTablePackage& outPackage)
 {
-	RaytracingPSO& rtPSO = GetRaytracingPSOImpl(psoID);
-
 	InternalModel& internalModel = GetInternalModelImpl(modelID);
 	ASSERT(internalModel.IsValid());
 
 	const Model& model = *internalModel.modelPtr;
 
-	ShaderTable<LocalHitData>& hitShaderTable = outPackage.hitShaderTable;
-	hitShaderTable.clear();
-	hitShaderTable.resize(model.m_NumMeshes);
+	std::vector<LocalHitData>& localHitData = outPackage.localHitData;
+	localHitData.clear();
+	localHitData.resize(model.m_NumMeshes);
 
 	const Mesh* meshPtr = (const Mesh*)model.m_MeshData.get();
-	void* shaderIdentifier = rtPSO.GetShaderIdentifier(outPackage.hitGroupShaderExport);
 	for (int i = 0; i < (int)model.m_NumMeshes; i++)
 	{
 		const Mesh& mesh = meshPtr[i];
 		ASSERT(mesh.numDraws == 1);
 
-		auto& entry = hitShaderTable[i];
-		entry.entryData.materialSRVs = Renderer::s_TextureHeap[mesh.srvTable]; // Start of descriptor table.
-		entry.entryData.geometrySRV = internalModel.geometryDataSRVHandle;
-		entry.entryData.indexByteOffset = mesh.ibOffset;
-		entry.entryData.vertexByteOffset = mesh.vbOffset;
-
-		entry.SetShaderIdentifier(shaderIdentifier);
+		LocalHitData& hitData = localHitData[i];
+		hitData.materialSRVs = Renderer::s_TextureHeap[mesh.srvTable]; // Start of descriptor table.
+		hitData.geometrySRV = internalModel.geometryDataSRVHandle;
+		hitData.indexByteOffset = mesh.ibOffset;
+		hitData.vertexByteOffset = mesh.vbOffset;
 	}
 }
 
-void RuntimeResourceManager::ForceBuildHitShaderTables(PSOID psoID)
+uint32_t RuntimeResourceManager::GetShaderIdentifierSlot(PSOID psoID, const std::wstring& exportName)
 {
-	RaytracingPSO& rtPSO = GetRaytracingPSOImpl(psoID);
+	std::unordered_map<std::wstring, uint32_t>& slots = m_shaderIdentifierSlots[psoID];
 
-	auto& hitShaderTableModelMap = m_shaderTablePSOMap[psoID];
-	
-	if (hitShaderTableModelMap.empty())
+	auto it = slots.find(exportName);
+	if (it == slots.end())
 	{
-		LOG_INFO(L"PSO does not have any associated models for shader tables.");
-		return;
+		const CPUReference::ShaderIdentifier shaderIdentifier = ShaderTableArena::GetShaderIdentifier(GetRaytracingPSOImpl(psoID), exportName);
+		it = slots.emplace(exportName, m_shaderTableArena.GetRecords().AddIdentifierSlot(shaderIdentifier)).first;
 	}
 
-	for (auto& [rtModelID, hitShaderTablePackage] : hitShaderTableModelMap)
+	return it->second;
+}
+
+void RuntimeResourceManager::PatchShaderIdentifiers(PSOID psoID)
+{
+	RaytracingPSO& rtPSO = GetRaytracingPSOImpl(psoID);
+
+	uint32_t patchedRecordCount = 0u;
+	for (const auto& [exportName, slot] : m_shaderIdentifierSlots[psoID])
 	{
-		BuildHitShaderTablePackage(psoID, rtModelID, hitShaderTablePackage);
+		patchedRecordCount += m_shaderTableArena.GetRecords().SetIdentifier(slot, ShaderTableArena::GetShaderIdentifier(rtPSO, exportName));
 	}
+
+	m_shaderTableArena.Upload();
+
+	LOG_DEBUG(L"Patched the shader identifiers of {} shader records.", patchedRecordCount);
 }
 
 void RuntimeResourceManager::SetShaderForPSOImpl(PSOID psoID, ShaderID shaderID, bool updatePSO)
@@ -256,6 +257,26 @@ void RuntimeResourceManager::SetShaderForPSOImpl(PSOID psoID, ShaderID shaderID,
 	}
 }
 
+ShaderID RuntimeResourceManager::RegisterShaderPermutationImpl(ShaderID baseShaderID, const std::vector<DxcDefine>& defines)
+{
+	ShaderCompilationManager& compManager = ShaderCompilationManager::Get();
+
+	const ShaderData* baseShaderData = compManager.GetShaderData(baseShaderID);
+	ASSERT(baseShaderData != nullptr);
+
+	ShaderCompilationPackage compPackage = {};
+	compPackage.shaderFilename = baseShaderData->shaderCompPackage.shaderFilename;
+	compPackage.entryPoint = baseShaderData->shaderCompPackage.entryPoint;
+	compPackage.shaderType = baseShaderData->shaderCompPackage.shaderType;
+	compPackage.shaderModel = baseShaderData->shaderCompPackage.shaderModel;
+	compPackage.defines = defines;
+
+	ShaderID permutationShaderID = ShaderID(ShaderIDCount + m_shaderPermutationCount++);
+	compManager.RegisterShader(permutationShaderID, compPackage, true);
+
+	return permutationShaderID;
+}
+
 void RuntimeResourceManager::UpdatePSOImpl(PSOID psoID)
 {
 	// Wait for all work to be done before changing any PSO.
@@ -274,21 +295,16 @@ void RuntimeResourceManager::UpdatePSOImpl(PSOID psoID)
 	}
 	else if (psoType == PSOTypeRaytracing)
 	{
-		psoPackage.AsRaytracingPSO().Finalize();
-
-		LOG_DEBUG(L"Updating all hit shader tables with new shader identifier data.");
-		ForceBuildHitShaderTables(psoID);
+		RaytracingPSO& rtPSO = psoPackage.AsRaytracingPSO();
+		rtPSO.Finalize();
 
-		std::set<ModelID> dependantModels = {};
-		for (auto& [modelID, _] : m_shaderTablePSOMap[psoID])
-		{
-			dependantModels.insert(modelID);
-		}
+		// Only the identifiers change, the tables of every dispatch stay where they are.
+		PatchShaderIdentifiers(psoID);
 
-		LOG_DEBUG(L"Updating all raytracing dispatch inputs with new shader tables.");
+		LOG_DEBUG(L"Updating all raytracing dispatch inputs with the new state object.");
 		for (const RayDispatchID rayDispatchID : m_psoRayDispatchDependencyMap[psoID])
 		{
-			BuildRaytracingDispatchInputsImpl(psoID, dependantModels, rayDispatchID);
+			m_rayDispatchInputs[rayDispatchID].m_stateObject = rtPSO.GetStateObject();
 		}
 	}
 	else
@@ -299,8 +315,18 @@ void RuntimeResourceManager::UpdatePSOImpl(PSOID psoID)
 
 void RuntimeResourceManager::AddShaderDependencyToPSOImpl(ShaderID shaderID, psoid_t psoID)
 {
-	// TODO: 
-	// Check for the given PSO if it exist for any other shader. If that shader is the same type, remove the PSO as a dependency. There can only be a single shader for a given PSO and Shader type.
+	// There can only be a single shader for a given PSO and shader type, so the PSO no longer depends on a previous shader of the same type.
+	// Otherwise recompiling a shader that was swapped out (e.g. another permutation of the same file) would set it on the PSO again.
+	ShaderCompilationManager& compManager = ShaderCompilationManager::Get();
+	const ShaderType shaderType = compManager.GetShaderType(shaderID);
+	for (auto& [dependencyShaderID, psoIDs] : m_shaderPSODependencyMap)
+	{
+		if (dependencyShaderID != shaderID && compManager.GetShaderType(dependencyShaderID) == shaderType)
+		{
+			psoIDs.erase(psoID);
+		}
+	}
+
 	m_shaderPSODependencyMap[shaderID].insert(psoID);
 }
 
@@ -322,7 +348,7 @@ PSOPackage& RuntimeResourceManager::GetPSOImpl(PSOID psoID)
 	return m_psoMap[psoID];
 }
 
-void RuntimeResourceManager::AddModelImpl(ModelID modelID, const std::wstring& modelPath, bool createBLAS)
+void RuntimeResourceManager::AddModelImpl(ModelID modelID, const std::wstring& modelPath, bool createBLAS, bool isEmissive)
 {
 	std::shared_ptr<Model> modelPtr = Renderer::LoadModel(modelPath, false);
 	ASSERT(modelPtr != nullptr);
@@ -330,6 +356,7 @@ void RuntimeResourceManager::AddModelImpl(ModelID modelID, const std::wstring& m
 	// Will overwrite any existing internal models.
 	InternalModel& internalModel = GetInternalModelImpl(modelID);
 	internalModel.modelPtr = modelPtr;
+	internalModel.isEmissive = isEmissive;
 
 	// Copy the SRV handle to geometry data for binding in shader table. 
 	// If the handle already exists it will be overwritten instead.
@@ -347,6 +374,7 @@ void RuntimeResourceManager::AddModelImpl(ModelID modelID, const std::wstring& m
 	if (createBLAS)
 	{
 		internalModel.modelBLAS.Init(modelPtr);
+		m_blasPool.Add(internalModel.modelBLAS, modelPath);
 	}
 }
 
@@ -382,11 +410,31 @@ ComputePSO& RuntimeResourceManager::GetComputePSOImpl(PSOID cmptPSOID)
 
 void RuntimeResourceManager::BuildRaytracingDispatchInputsImpl(PSOID psoID, std::set<ModelID>& models, RayDispatchID rayDispatchID)
 {
-	ShaderTable<LocalHitData> combinedShaderTable = {};
-	BuildCombinedShaderTable(psoID, models, combinedShaderTable);
+	CPUReference::ShaderRecordArena& shaderRecords = m_shaderTableArena.GetRecords();
+
+	// The hit groups of every model one after another, in the order of the hit group offsets given to the TLAS instances.
+	std::vector<CPUReference::ShaderRecordDesc> hitGroupRecords;
+	for (ModelID modelID : models)
+	{
+		const HitShaderTablePackage& hitShaderTablePackage = GetOrCreateHitShaderTablePackage(psoID, modelID);
+		const uint32_t hitGroupSlot = GetShaderIdentifierSlot(psoID, hitShaderTablePackage.hitGroupShaderExport);
+
+		for (const LocalHitData& localHitData : hitShaderTablePackage.localHitData)
+		{
+			hitGroupRecords.push_back({ hitGroupSlot, &localHitData });
+		}
+	}
+
+	// The new tables are added before the old ones are released, so building a dispatch again over the same models reuses its records.
+	const uint32_t rayGenTable = shaderRecords.AddTable({ { GetShaderIdentifierSlot(psoID, L"RayGenerationShader"), nullptr } });
+	const uint32_t missTable = shaderRecords.AddTable({ { GetShaderIdentifierSlot(psoID, L"MissShader"), nullptr } });
+	const uint32_t hitGroupTable = shaderRecords.AddTable(hitGroupRecords);
 
 	RaytracingDispatchRayInputs& rayDispatchInputs = m_rayDispatchInputs[rayDispatchID];
-	rayDispatchInputs.Init(GetRaytracingPSOImpl(psoID), combinedShaderTable, L"RayGenerationShader", L"MissShader");
+	rayDispatchInputs.Release(m_shaderTableArena);
+	rayDispatchInputs.Init(GetRaytracingPSOImpl(psoID), m_shaderTableArena, rayGenTable, missTable, hitGroupTable);
+
+	m_shaderTableArena.Upload();
 
 	// Add dependency.
 	m_psoRayDispatchDependencyMap[psoID].insert(rayDispatchID);
@@ -445,7 +493,10 @@ void RuntimeResourceManager::DestroyImpl()
 	Graphics::g_CommandManager.IdleGPU();
 
 	m_internalModels.clear();
+	m_blasPool.Destroy();
 	m_rayDispatchInputs.clear();
+	m_shaderTableArena.Destroy();
+	m_shaderIdentifierSlots.clear();
 	m_descHeap.Destroy();
 }
 
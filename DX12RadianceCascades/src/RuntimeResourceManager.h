@@ -36,13 +36,18 @@ enum PSOID : psoid_t
 	PSOIDComputeRCGatherPSO,
 	PSOIDComputeFlatlandScenePSO,
 	PSOIDGatherFilterReductionPSO,
+	PSOIDGatherFilterVisPSO,
 	PSOIDComputeFullScreenCopyPSO,
 	PSOIDRaytracingTestPSO,
 	PSOIDDebugDrawNoDepthPSO,
 	PSOIDDebugDrawDepthPSO,
 	PSOIDComputeHiZBufferPSO,
+	PSOIDComputeHiZSinglePassPSO,
 	PSOIDRCRaytracingPSO,
 	PSOIDRC3DMergePSO,
+	PSOIDRC3DMergeWeightsPSO,
+	PSOIDRC3DMergeCoalescePSO,
+	PSOIDRC3DReprojectPSO,
 	PSOIDRC3DCoalescePSO,
 	PSOIDDeferredLightingPSO,
 	PSOIDSkyboxPSO,
@@ -75,6 +80,8 @@ struct InternalModel
 	DescriptorHandle geometryDataSRVHandle;
 
 	BLASBuffer modelBLAS; // Must be created explicitly when adding a model.
+	// Materials are not kept on the CPU, so this is given when the model is added. Emissive instances are never culled for being small.
+	bool isEmissive = true;
 
 	bool IsValid() { return modelPtr != nullptr; }
 };
@@ -82,7 +89,8 @@ struct InternalModel
 struct HitShaderTablePackage
 {
 	std::wstring hitGroupShaderExport = s_HitGroupName;
-	ShaderTable<LocalHitData> hitShaderTable;
+	// One per mesh, the shader identifier is patched in by the shader table arena.
+	std::vector<LocalHitData> localHitData;
 };
 
 class RuntimeResourceManager
@@ -102,8 +110,12 @@ public:
 	static void SetShaderForPSO(PSOID psoID, ShaderID shaderID, bool updatePSO = false) { Get().SetShaderForPSOImpl(psoID, shaderID, updatePSO); }
 	// Optional argument for updating the PSO after shader has been set.
 	static void SetShadersForPSO(PSOID psoID, std::vector<ShaderID> shaderIDs, bool updatePSO = false);
+	// Registers and compiles the shader file of baseShaderID again with extra defines (see ShaderCompilationPackage::defines). 
+	// The returned ID is placed after every shader file ID and works like any other shader ID, also for live recompilation.
+	static ShaderID RegisterShaderPermutation(ShaderID baseShaderID, const std::vector<DxcDefine>& defines) { return Get().RegisterShaderPermutationImpl(baseShaderID, defines); }
 
-	static void AddModel(ModelID modelID, const std::wstring& modelPath, bool createBLAS = false);
+	// The BLAS, if created, is built before this returns. Use the constructor to load many models with their BLASes built together.
+	static void AddModel(ModelID modelID, const std::wstring& modelPath, bool createBLAS = false, bool isEmissive = true);
 	static InternalModel& GetInternalModel(ModelID  modelID);
 	static std::shared_ptr<Model> GetModelPtr(ModelID modelID);
 	static BLASBuffer& GetModelBLAS(ModelID modelID);
@@ -140,14 +152,18 @@ private:
 	// Will create the shader table if it doesnt exist.
 	HitShaderTablePackage& GetOrCreateHitShaderTablePackage(PSOID psoID, ModelID modelID);
 
-	void ForceBuildHitShaderTables(PSOID psoID);
-	void BuildHitShaderTablePackage(PSOID psoID, ModelID modelID, HitShaderTablePackage& outPackage);
-	void BuildCombinedShaderTable(PSOID psoID, std::set<ModelID> models, ShaderTable<LocalHitData>& outShaderTable);
+	void BuildHitShaderTablePackage(ModelID modelID, HitShaderTablePackage& outPackage);
+
+	// Will add the slot if it doesnt exist, with the current identifier of the export.
+	uint32_t GetShaderIdentifierSlot(PSOID psoID, const std::wstring& exportName);
+	// Writes the identifiers of a finalized PSO into every shader record using them, nothing else is rebuilt.
+	void PatchShaderIdentifiers(PSOID psoID);
 
 private:
 	// Intelligently checks pso types with compatible shader types and sets the shader if valid. Optionally update the PSO object.
 	// This method always updates shader dependencies accordingly.
 	void SetShaderForPSOImpl(PSOID psoID, ShaderID shaderID, bool forceUpdate = false);
+	ShaderID RegisterShaderPermutationImpl(ShaderID baseShaderID, const std::vector<DxcDefine>& defines);
 	// Updates (finalizes) the specified PSO and updates any dependencies if they exist.
 	void UpdatePSOImpl(PSOID psoID);
 
@@ -156,7 +172,7 @@ private:
 	void RegisterPSOImpl(PSOID psoID, void* psoPtr, PSOType psoType);
 	PSOPackage& GetPSOImpl(PSOID psoID);
 
-	void AddModelImpl(ModelID modelID, const std::wstring& modelPath, bool createBLAS);
+	void AddModelImpl(ModelID modelID, const std::wstring& modelPath, bool createBLAS, bool isEmissive);
 	InternalModel& GetInternalModelImpl(ModelID modelID);
 	std::shared_ptr<Model> GetModelPtrImpl(ModelID modelID);
 	BLASBuffer& GetModelBLASImpl(ModelID modelID);
@@ -182,9 +198,16 @@ private:
 	// When a shader is updated, all PSOs that use it can be fetched for any modification or checks.
 	std::unordered_map<UUID64, std::set<psoid_t>> m_shaderPSODependencyMap;
 	std::array<PSOPackage, PSOIDCount> m_psoMap;
+	uint64_t m_shaderPermutationCount = 0;
 
 	std::unordered_map<ModelID, InternalModel> m_internalModels;
+	// Builds the BLASes of added models, which stay where they are in m_internalModels as it never moves its values.
+	BLASPool m_blasPool;
 	std::unordered_map<PSOID, std::unordered_map<ModelID, HitShaderTablePackage>> m_shaderTablePSOMap;
+	// Every shader table of every ray dispatch. Identical tables, like a dispatch built again over the same models, share their records.
+	ShaderTableArena m_shaderTableArena;
+	// Identifier slot in the shader table arena of every export of a PSO used in a shader table.
+	std::unordered_map<PSOID, std::unordered_map<std::wstring, uint32_t>> m_shaderIdentifierSlots;
 	std::unordered_map<RayDispatchID, RaytracingDispatchRayInputs> m_rayDispatchInputs;
 	std::unordered_map<PSOID, std::unordered_set<RayDispatchID>> m_psoRayDispatchDependencyMap;
 
@@ -264,6 +264,11 @@ ShaderCompilationArgs BuildArgsFromShaderPackage(const ShaderCompilationPackage&
 	{
 		AddArgDefine(args, def);
 	}
+
+	for (const DxcDefine& def : compPackage.defines)
+	{
+		AddArgDefine(args, def.Value != nullptr ? std::wstring(def.Name) + L"=" + def.Value : std::wstring(def.Name));
+	}
 	
 	return args;
 }
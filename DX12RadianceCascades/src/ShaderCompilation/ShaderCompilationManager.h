@@ -69,9 +69,9 @@ struct ShaderCompilationPackage
     ShaderType shaderType = ShaderTypeNone;
     ShaderModel shaderModel = ShaderModel6_3;
 
-    // Holds macro defines inserted into the shader.
-    // NOTE: Null terminator for these will be added automatically.
-    // TODO: Make use of this instead of current way of adding defines.
+    // Holds macro defines inserted into the shader, added after the defines of every shader.
+    // Lets several shader IDs compile permutations of the same file. Value can be null.
+    // NOTE: Name and value are not copied, they need to outlive the package (e.g. string literals).
     std::vector<DxcDefine> defines = {};
 
     // Files that are included in the shader. Is overwritten every compilation.
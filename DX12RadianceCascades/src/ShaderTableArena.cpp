@@ -0,0 +1,75 @@
+#include "rcpch.h"
+#include "Core\CommandContext.h"
+#include "RaytracingPSO.h"
+#include "ShaderTableArena.h"
+
+static_assert(CPUReference::ShaderIdentifierSize == D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+static_assert(CPUReference::ShaderRecordAlignment == D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
+static_assert(CPUReference::ShaderTableAlignment == D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT);
+
+void ShaderTableArena::Create(const std::wstring& name, uint32_t localDataSize)
+{
+	Destroy();
+
+	m_name = name;
+	m_records = CPUReference::ShaderRecordArena(localDataSize);
+}
+
+void ShaderTableArena::Destroy()
+{
+	m_records = CPUReference::ShaderRecordArena(m_records.GetLocalDataSize());
+	m_buffer.Destroy();
+	m_dirtyRanges.clear();
+}
+
+void ShaderTableArena::Upload()
+{
+	if (!m_records.HasDirtyRanges())
+	{
+		return;
+	}
+
+	// Records next to each other are copied together, patching an identifier dirties every record it is used in.
+	m_records.TakeDirtyRanges(m_dirtyRanges, m_records.GetRecordStride());
+
+	const uint64_t byteCount = m_records.GetByteCount();
+	if (byteCount > m_buffer.GetBufferSize())
+	{
+		// Grows at least twice as large so that adding tables one dispatch at a time does not recreate it every time.
+		const uint64_t bufferSize = (std::max)(byteCount, uint64_t(m_buffer.GetBufferSize()) * 2u);
+		m_buffer.Create(m_name, 1, (uint32_t)bufferSize);
+
+		m_dirtyRanges = { { 0u, byteCount } };
+	}
+
+	GraphicsContext& gfxContext = GraphicsContext::Begin(L"Shader Table Upload");
+	gfxContext.TransitionResource(m_buffer, D3D12_RESOURCE_STATE_COPY_DEST, true);
+
+	// Ranges start on a record and cover whole records, so the source stays 16 byte aligned.
+	for (const CPUReference::ShaderRecordByteRange& range : m_dirtyRanges)
+	{
+		gfxContext.WriteBuffer(m_buffer, (size_t)range.offset, m_records.GetData() + range.offset, (size_t)range.byteCount);
+	}
+
+	gfxContext.TransitionResource(m_buffer, D3D12_RESOURCE_STATE_GENERIC_READ, true);
+	gfxContext.Finish();
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS ShaderTableArena::GetTableAddress(uint32_t table) const
+{
+	return m_buffer.GetGpuVirtualAddress() + m_records.GetTableOffset(table);
+}
+
+CPUReference::ShaderIdentifier ShaderTableArena::GetShaderIdentifier(RaytracingPSO& rtPSO, const std::wstring& exportName)
+{
+	CPUReference::ShaderIdentifier shaderIdentifier = {};
+
+	// Errors are logged by the PSO.
+	const void* shaderIdentifierData = rtPSO.GetShaderIdentifier(exportName);
+	if (shaderIdentifierData != nullptr)
+	{
+		memcpy(shaderIdentifier.data, shaderIdentifierData, D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES);
+	}
+
+	return shaderIdentifier;
+}
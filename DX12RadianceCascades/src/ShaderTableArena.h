@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Core\GpuBuffer.h"
+
+#include "CPUReference\ShaderRecordArena.h"
+
+class RaytracingPSO;
+
+// Every shader table in one GPU buffer, see CPUReference/ShaderRecordArena.h. Tables are added and identifiers patched on the 
+// records, Upload() then only copies the bytes that were written since the last upload.
+class ShaderTableArena
+{
+public:
+	ShaderTableArena() = default;
+
+	// Local data is the local root arguments of every record, records without any have it zeroed.
+	void Create(const std::wstring& name, uint32_t localDataSize);
+	void Destroy();
+
+	CPUReference::ShaderRecordArena& GetRecords() { return m_records; }
+	const CPUReference::ShaderRecordArena& GetRecords() const { return m_records; }
+
+	// Recreates the buffer if the records outgrew it, which moves every table. The GPU can not be using the buffer, 
+	// which holds when dispatches are built and when PSOs are finalized after a recompile.
+	void Upload();
+
+	D3D12_GPU_VIRTUAL_ADDRESS GetTableAddress(uint32_t table) const;
+	uint64_t GetTableByteCount(uint32_t table) const { return m_records.GetTableByteCount(table); }
+	uint32_t GetRecordStride() const { return m_records.GetRecordStride(); }
+
+	// Zeroed if the PSO has not been finalized or does not have the export.
+	static CPUReference::ShaderIdentifier GetShaderIdentifier(RaytracingPSO& rtPSO, const std::wstring& exportName);
+
+private:
+	std::wstring m_name;
+	CPUReference::ShaderRecordArena m_records;
+	ByteAddressBuffer m_buffer;
+	std::vector<CPUReference::ShaderRecordByteRange> m_dirtyRanges;
+};
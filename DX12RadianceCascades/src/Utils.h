@@ -76,6 +76,18 @@ namespace Utils
 		return 2.0f * atan(tan(verticalFov * 0.5f) / widthOverHeight);
 	}
 
+	// Indirect DispatchRays (D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH_RAYS) was added in raytracing tier 1.1.
+	static bool SupportsIndirectDispatchRays(ID3D12Device* device)
+	{
+		D3D12_FEATURE_DATA_D3D12_OPTIONS5 featureSupport = {};
+		if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS5, &featureSupport, sizeof(featureSupport))))
+		{
+			return false;
+		}
+
+		return featureSupport.RaytracingTier >= D3D12_RAYTRACING_TIER_1_1;
+	}
+
 	// A structure that automatically constructs a matrix that is the transpose of its input.
 	struct GPUMatrix
 	{
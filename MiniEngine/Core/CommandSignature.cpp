@@ -39,6 +39,9 @@ void CommandSignature::Finalize( const RootSignature* RootSignature )
             case D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH:
                 ByteStride += sizeof(D3D12_DISPATCH_ARGUMENTS);
                 break;
+            case D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH_RAYS:
+                ByteStride += sizeof(D3D12_DISPATCH_RAYS_DESC);
+                break;
             case D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT:
                 ByteStride += m_ParamArray[i].GetDesc().Constant.Num32BitValuesToSet * 4;
                 RequiresRootSignature = true;
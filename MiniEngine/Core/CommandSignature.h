@@ -43,6 +43,12 @@ public:
         m_IndirectParam.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
     }
 
+    // Requires D3D12_RAYTRACING_TIER_1_1. The argument buffer holds complete D3D12_DISPATCH_RAYS_DESCs, shader tables included.
+    void DispatchRays(void)
+    {
+        m_IndirectParam.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH_RAYS;
+    }
+
     void VertexBufferView(UINT Slot)
     {
         m_IndirectParam.Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;